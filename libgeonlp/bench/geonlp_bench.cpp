@@ -0,0 +1,280 @@
+///
+/// @file
+/// @brief 地名語抽出の性能測定プログラム。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+/// base_data の辞書からインデックスを作成し、次の負荷で MA を測定する。
+///   - cold:     MA の作成から最初の解析が終わるまで（キャッシュなし）
+///   - single:   一文の繰り返し解析のレイテンシ
+///   - corpus:   複数の文の解析スループット（parseNode と parseNodeBatch）
+///   - address:  住所が長く連なる文（地名語候補の探索の最悪ケース）
+///   - lookup:   表記による地名語検索（darts と地名語の取得）
+///   - warm:     一巡した後、キャッシュが効いた状態での corpus
+/// それぞれ p50/p99 レイテンシ（マイクロ秒）、1 秒あたりの文数、
+/// 1 回あたりのヒープ確保回数を表示する。
+///
+/// ビルド例（リポジトリのトップディレクトリで実行）:
+///   g++ -O2 -std=gnu++17 -I libgeonlp/include -o geonlp_bench libgeonlp/bench/geonlp_bench.cpp libgeonlp/lib/*.cpp -lmecab -lsqlite3 -lboost_regex -lboost_system -lboost_filesystem -lpthread
+///
+/// 実行例:
+///   ./geonlp_bench -d base_data -w /tmp/geonlp_bench [-n 1000] [-c corpus.txt] [-b]
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <boost/filesystem.hpp>
+#include "GeonlpMA.h"
+
+/// プログラム全体のヒープ確保回数
+static std::atomic<unsigned long> allocation_count(0);
+
+void* operator new(size_t size) {
+  allocation_count++;
+  void* p = malloc(size ? size : 1);
+  if (p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  /// 標準のコーパス
+  const char* default_corpus[] = {
+    "今日は国会議事堂前まで歩きました。",
+    "千代田区一ツ橋２－１－２",
+    "和歌山市は晴れ。",
+    "東京都千代田区永田町",
+    "新宿駅から渋谷駅まで",
+    "神奈川県横浜市中区",
+    "大阪府と京都府と奈良県",
+    "本部に行く。月が綺麗。",
+    "東京駅から新大阪駅まで新幹線で移動した。",
+    "北海道札幌市北区北8西5",
+    "福島県南相馬市原町区本町",
+    "静岡県静岡市葵区追手町9番6号",
+    "大阪市北区梅田3丁目の大阪駅前で待ち合わせ",
+    "福岡県北九州市小倉北区から山口県下関市へ向かう",
+    NULL
+  };
+
+  /// 住所が長く連なる文の部品
+  const char* address_parts[] = {
+    "東京都千代田区永田町", "神奈川県横浜市中区", "静岡県静岡市葵区追手町",
+    "京都府京都市左京区下鴨泉川町", "北海道札幌市中央区北一条西", NULL
+  };
+
+  /// 基本辞書（DictManager.setupBasicDatabase と同じ）
+  const char* basic_dictionaries[] = {
+    "geoshape-city", "geoshape-pref", "ksj-station-N02", NULL
+  };
+
+  /// 一つの負荷の測定結果
+  struct BenchResult {
+    std::string name;
+    std::vector<double> latencies;  ///< 1 回あたりのマイクロ秒
+    size_t sentences;               ///< 処理した文の数
+    double elapsed;                 ///< 全体の秒数
+    unsigned long allocations;      ///< ヒープ確保回数
+
+    BenchResult(const std::string& n): name(n), sentences(0), elapsed(0), allocations(0) {}
+  };
+
+  /// @brief 昇順に並べた値の百分位数を得る
+  double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.size() == 0) return 0;
+    size_t i = size_t(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)];
+  }
+
+  /// @brief 結果を 1 行で表示する
+  void report(BenchResult& r) {
+    std::sort(r.latencies.begin(), r.latencies.end());
+    size_t calls = r.latencies.size() > 0 ? r.latencies.size() : 1;
+    printf("%-16s %8zu %12.1f %12.1f %14.1f %12.1f\n",
+           r.name.c_str(), r.latencies.size(),
+           percentile(r.latencies, 50), percentile(r.latencies, 99),
+           r.elapsed > 0 ? r.sentences / r.elapsed : 0.0,
+           double(r.allocations) / calls);
+  }
+
+  /// @brief 関数を iterations 回実行し、1 回ごとのレイテンシを測る
+  /// @arg @c sentences_per_call 1 回で処理する文の数
+  BenchResult measure(const std::string& name, size_t iterations, size_t sentences_per_call, const std::function<void(size_t)>& f) {
+    BenchResult r(name);
+    r.latencies.reserve(iterations);
+    unsigned long allocations = allocation_count.load();
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+      Clock::time_point t0 = Clock::now();
+      f(i);
+      r.latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+    }
+    r.elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    r.allocations = allocation_count.load() - allocations;
+    r.sentences = iterations * sentences_per_call;
+    return r;
+  }
+
+  /// @brief 辞書ディレクトリからインデックスを作成する
+  void buildIndex(const std::string& dict_dir, const std::string& work_dir) {
+    boost::filesystem::remove_all(work_dir);
+    boost::filesystem::create_directories(work_dir);
+    picojson::object settings;
+    settings["data_dir"] = picojson::value(work_dir);
+    geonlp::MAPtr ma = geonlp::createMA(picojson::value(settings));
+    for (int i = 0; basic_dictionaries[i]; i++) {
+      std::string base = dict_dir + "/" + basic_dictionaries[i];
+      ma->addDictionary(base + ".json", base + ".csv");
+    }
+    ma->updateIndex();
+  }
+
+  /// @brief MA を作成する
+  geonlp::MAPtr openMA(const std::string& work_dir, const std::string& bundle) {
+    picojson::object settings;
+    settings["data_dir"] = picojson::value(work_dir);
+    if (bundle.length() > 0) settings["bundle"] = picojson::value(bundle);
+    return geonlp::createMA(picojson::value(settings));
+  }
+
+  void usage(const char* prog) {
+    fprintf(stderr, "usage: %s -d <base_data dir> -w <work dir> [-n iterations] [-c corpus file] [-b] [-s]\n", prog);
+    fprintf(stderr, "  -b  also measure the dictionary bundle backend\n");
+    fprintf(stderr, "  -s  skip building the index (reuse the work dir)\n");
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  std::string dict_dir = "base_data";
+  std::string work_dir;
+  std::string corpus_file;
+  size_t iterations = 1000;
+  bool with_bundle = false;
+  bool skip_build = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:w:n:c:bsh")) != -1) {
+    switch (opt) {
+    case 'd': dict_dir = optarg; break;
+    case 'w': work_dir = optarg; break;
+    case 'n': iterations = size_t(atol(optarg)); break;
+    case 'c': corpus_file = optarg; break;
+    case 'b': with_bundle = true; break;
+    case 's': skip_build = true; break;
+    default: usage(argv[0]); return 1;
+    }
+  }
+  if (work_dir.empty() || iterations == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // コーパス
+  std::vector<std::string> corpus;
+  if (corpus_file.length() > 0) {
+    std::ifstream ifs(corpus_file.c_str());
+    std::string line;
+    while (std::getline(ifs, line)) {
+      if (line.length() > 0) corpus.push_back(line);
+    }
+  }
+  if (corpus.size() == 0) {
+    for (int i = 0; default_corpus[i]; i++) corpus.push_back(default_corpus[i]);
+  }
+  std::string address_chain;
+  for (int n = 0; n < 4; n++) {
+    for (int i = 0; address_parts[i]; i++) address_chain += address_parts[i];
+  }
+
+  try {
+    if (!skip_build) {
+      Clock::time_point t0 = Clock::now();
+      buildIndex(dict_dir, work_dir);
+      printf("index build: %.2f s\n", std::chrono::duration<double>(Clock::now() - t0).count());
+    }
+    std::string bundle;
+    if (with_bundle) {
+      bundle = work_dir + "/geonlp.bundle";
+      Clock::time_point t0 = Clock::now();
+      openMA(work_dir, "")->exportBundle(bundle);
+      printf("bundle export: %.2f s\n", std::chrono::duration<double>(Clock::now() - t0).count());
+    }
+
+    std::vector<std::string> backends;
+    backends.push_back("");
+    if (with_bundle) backends.push_back(bundle);
+
+    for (std::vector<std::string>::const_iterator b = backends.begin(); b != backends.end(); b++) {
+      printf("\n[%s]\n", b->empty() ? "sqlite" : "bundle");
+      printf("%-16s %8s %12s %12s %14s %12s\n", "workload", "calls", "p50(us)", "p99(us)", "sentences/s", "allocs/call");
+      std::vector<geonlp::Node> nodes;
+
+      // 作成直後の解析、インスタンスごとにキャッシュは空
+      size_t cold_iterations = std::min<size_t>(iterations, 20);
+      BenchResult cold = measure("cold", cold_iterations, 1, [&](size_t) {
+          geonlp::MAPtr fresh = openMA(work_dir, *b);
+          fresh->parseNode(corpus[0], nodes);
+        });
+      report(cold);
+
+      geonlp::MAPtr ma = openMA(work_dir, *b);
+      BenchResult corpus_first = measure("corpus (first)", corpus.size(), 1, [&](size_t i) {
+          ma->parseNode(corpus[i], nodes);
+        });
+      report(corpus_first);
+
+      BenchResult single = measure("single", iterations, 1, [&](size_t) {
+          ma->parseNode(corpus[0], nodes);
+        });
+      report(single);
+
+      BenchResult warm = measure("corpus (warm)", iterations, 1, [&](size_t i) {
+          ma->parseNode(corpus[i % corpus.size()], nodes);
+        });
+      report(warm);
+
+      std::vector<std::string> batch;
+      for (size_t i = 0; i < iterations; i++) batch.push_back(corpus[i % corpus.size()]);
+      std::vector<std::vector<geonlp::Node> > batch_results;
+      BenchResult batched = measure("corpus (batch)", 1, batch.size(), [&](size_t) {
+          ma->parseNodeBatch(batch, batch_results);
+        });
+      report(batched);
+
+      size_t address_iterations = std::max<size_t>(iterations / 10, 1);
+      BenchResult address = measure("address", address_iterations, 1, [&](size_t) {
+          ma->parseNode(address_chain, nodes);
+        });
+      report(address);
+
+      const char* keys[] = { "東京", "千代田区", "新宿", "横浜市", "静岡", "存在しない" };
+      const size_t num_keys = sizeof(keys) / sizeof(keys[0]);
+      std::map<std::string, geonlp::Geoword> geowords;
+      BenchResult lookup = measure("lookup", iterations, 1, [&](size_t i) {
+          ma->getGeowordEntries(keys[i % num_keys], geowords);
+        });
+      report(lookup);
+    }
+  } catch (std::exception& e) {
+    fprintf(stderr, "error: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
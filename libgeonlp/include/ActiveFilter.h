@@ -0,0 +1,237 @@
+///
+/// @file
+/// @brief アクティブな辞書/固有名クラス/期間の判定クラス ActiveFilter の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _ACTIVE_FILTER_H
+#define _ACTIVE_FILTER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <string_view>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <boost/regex.hpp>
+#include "Dictionary.h"
+#include "Geoword.h"
+
+/// 固有名クラスの判定結果の表の大きさ（2 の累乗）、記憶する最大数はこの半分
+#define ACTIVE_CLASS_TABLE_SIZE  4096
+
+namespace geonlp
+{
+  ///
+  /// @brief 地名語がアクティブな辞書/固有名クラスに含まれるかを判定するクラス。
+  ///
+  /// 辞書IDのビットセットとコンパイル済みのクラス正規表現を保持し、
+  /// 設定変更時に一度だけ作り直す。
+  /// 期間を設定した場合は、有効期間が期間と重ならない地名語もアクティブでないものとする。
+  /// 固有名クラス文字列ごとの判定結果は表に記憶しておき、二回目以降は正規表現を評価しない。
+  /// 表の要素は登録後に変更しないため、判定はロックもメモリ確保もせずに表を参照する。
+  /// クラスの設定を変更した場合は、それまでに登録されたクラスの判定結果を全て計算し直した表に置き換える。
+  ///
+  /// また、見出し語ID（wordlist の ID）ごとに、アクティブな地名語を含むかどうかを
+  /// 初めて調べた時点で記録しておき、設定が変更されるまで再利用する。
+  /// 設定やインデックスが変更されるたびに世代番号を進めるので、
+  /// 利用側で見出し語IDごとの派生データを記憶する場合は世代番号と共に記憶すること。
+  /// 世代番号は全ての ActiveFilter で重複しないため、複数の ActiveFilter の
+  /// 派生データを一つの表に記憶してもよい。
+  ///
+  class ActiveFilter {
+  private:
+    /// @brief コンパイル済みのクラス正規表現
+    struct ClassPattern {
+      bool exclude;          ///< '-' から始まる除外パターンの場合 true
+      boost::regex pattern;  ///< 正規表現
+    };
+
+    /// 辞書IDをインデックスとするビットセット
+    std::vector<bool> dictionaries;
+
+    /// 指定順のクラス正規表現
+    std::vector<ClassPattern> patterns;
+
+    /// 期間の開始日と終了日、 has_period が false の場合は期間を問わない
+    int period_from;
+    int period_to;
+    bool has_period;
+
+    /// @brief 固有名クラス文字列の判定結果、登録後は変更しない
+    struct ClassVerdict {
+      std::string ne_class;  ///< 固有名クラス
+      size_t hash;           ///< ne_class のハッシュ値
+      bool active;           ///< アクティブかどうか
+    };
+
+    /// @brief 固有名クラス文字列ごとの判定結果の表
+    ///
+    /// ハッシュ値による開番地法の表で、空きスロットは NULL。
+    /// スロットへの登録は class_mutex を取得して行い、参照はロックを取得しない。
+    struct ClassTable {
+      std::unique_ptr<std::atomic<const ClassVerdict*>[]> slots;
+      std::vector<std::unique_ptr<ClassVerdict> > verdicts;  ///< 登録順の判定結果、スロットが指す実体
+      ClassTable(): slots(new std::atomic<const ClassVerdict*>[ACTIVE_CLASS_TABLE_SIZE]) {
+        for (size_t i = 0; i < ACTIVE_CLASS_TABLE_SIZE; i++) slots[i].store(NULL, std::memory_order_relaxed);
+      }
+    };
+
+    /// 固有名クラスの判定結果の表、クラスの正規表現が無い場合は空
+    std::unique_ptr<ClassTable> class_table;
+    mutable std::mutex class_mutex;
+
+    /// @brief 見出し語IDごとの判定状態のビット
+    enum {
+      WORDLIST_CHECKED         = 0x01,  ///< 判定済み
+      WORDLIST_ACTIVE          = 0x02,  ///< アクティブな地名語を含む
+      WORDLIST_SURFACE_CHECKED = 0x04,  ///< 表記一致の判定済み
+      WORDLIST_SURFACE_ACTIVE  = 0x08   ///< 表記が一致するアクティブな地名語を含む
+    };
+
+    /// 見出し語IDをインデックスとする判定状態
+    std::unique_ptr<std::atomic<unsigned char>[]> wordlist_states;
+    size_t num_wordlists;
+
+    /// 世代番号
+    std::atomic<unsigned long> generation;
+
+    // 見出し語IDごとの判定状態を未判定に戻し、新しい世代番号を割り当てる
+    void clearWordlistStates(void);
+
+    // コピー禁止
+    ActiveFilter(const ActiveFilter&);
+    ActiveFilter& operator=(const ActiveFilter&);
+
+    // 正規表現を評価して判定する
+    bool matchClass(std::string_view ne_class) const;
+
+    // 判定結果を表に登録する
+    bool registerClass(std::string_view ne_class, size_t hash) const;
+
+    // 判定結果を表に格納する
+    static void storeVerdict(ClassTable& table, const ClassVerdict* verdict);
+
+  public:
+    /// @brief コンストラクタ、全ての辞書が非アクティブな状態になる
+    ActiveFilter(): period_from(GEOWORD_DATE_MIN), period_to(GEOWORD_DATE_MAX), has_period(false),
+                    num_wordlists(0), generation(0) {}
+
+    // アクティブな辞書を設定する
+    void setDictionaries(const std::map<int, Dictionary>& dics);
+
+    // アクティブな固有名クラスの正規表現リストを設定する
+    void setClasses(const std::vector<std::string>& ne_classes);
+
+    /// @brief 辞書がアクティブかどうか
+    /// @arg @c dictionary_id 辞書の内部 ID
+    inline bool isActiveDictionary(int dictionary_id) const {
+      return dictionary_id >= 0 && size_t(dictionary_id) < this->dictionaries.size()
+        && this->dictionaries[dictionary_id];
+    }
+
+    /// @brief 固有名クラスがアクティブかどうか
+    ///
+    /// 判定結果の表を参照し、未登録のクラスの場合のみ正規表現を評価して登録する。
+    /// @arg @c ne_class 固有名クラス
+    /// @return アクティブなクラスの正規表現に一致し、除外パターンに一致しない場合 true
+    inline bool isActiveClass(std::string_view ne_class) const {
+      if (!this->class_table) return true;
+      const size_t hash = std::hash<std::string_view>()(ne_class);
+      for (size_t n = 0, i = hash; n < ACTIVE_CLASS_TABLE_SIZE; n++, i++) {
+        const ClassVerdict* v = this->class_table->slots[i & (ACTIVE_CLASS_TABLE_SIZE - 1)].load(std::memory_order_acquire);
+        if (!v) break;
+        if (v->hash == hash && v->ne_class == ne_class) return v->active;
+      }
+      return this->registerClass(ne_class, hash);
+    }
+
+    // 地名語の有効期間が重なるべき期間を設定する
+    void setPeriod(int from, int to);
+
+    /// @brief 期間が設定されているかどうか
+    inline bool hasPeriod(void) const { return this->has_period; }
+
+    /// @brief 有効期間が設定された期間と重なるかどうか
+    /// @arg @c valid_from 有効期間の開始日
+    /// @arg @c valid_to   有効期間の終了日
+    inline bool isInPeriod(int valid_from, int valid_to) const {
+      return !this->has_period || (valid_from <= this->period_to && valid_to >= this->period_from);
+    }
+
+    // 見出し語IDの数を設定し、判定状態を未判定に戻す
+    void setWordlistCount(size_t n);
+
+    /// @brief 見出し語IDの数を取得する
+    inline size_t getWordlistCount(void) const {
+      return this->num_wordlists;
+    }
+
+    /// @brief 世代番号を取得する
+    /// @return 設定またはインデックスが変更されるたびに変わる、全ての ActiveFilter で重複しない値
+    inline unsigned long getGeneration(void) const {
+      return this->generation.load();
+    }
+
+    /// @brief 見出し語IDに対する記録済みの判定結果を取得する
+    /// @arg @c wordlist_id  見出し語ID
+    /// @arg @c surface_only true の場合、表記が一致する地名語に限定した判定結果
+    /// @return アクティブな地名語を含む場合 1, 含まない場合 0, 未判定の場合 -1
+    inline int getWordlistState(unsigned int wordlist_id, bool surface_only) const {
+      if (wordlist_id >= this->num_wordlists) return -1;
+      unsigned char state = this->wordlist_states[wordlist_id].load(std::memory_order_relaxed);
+      if (surface_only) {
+        if (!(state & WORDLIST_SURFACE_CHECKED)) return -1;
+        return (state & WORDLIST_SURFACE_ACTIVE) ? 1 : 0;
+      }
+      if (!(state & WORDLIST_CHECKED)) return -1;
+      return (state & WORDLIST_ACTIVE) ? 1 : 0;
+    }
+
+    /// @brief 見出し語IDに対する判定結果を記録する
+    /// @arg @c wordlist_id    見出し語ID
+    /// @arg @c active         アクティブな地名語を含むかどうか
+    /// @arg @c surface_active 表記が一致するアクティブな地名語を含むかどうか
+    inline void setWordlistState(unsigned int wordlist_id, bool active, bool surface_active) const {
+      if (wordlist_id >= this->num_wordlists) return;
+      unsigned char state = WORDLIST_CHECKED | WORDLIST_SURFACE_CHECKED;
+      if (active) state |= WORDLIST_ACTIVE;
+      if (surface_active) state |= WORDLIST_SURFACE_ACTIVE;
+      this->wordlist_states[wordlist_id].store(state, std::memory_order_relaxed);
+    }
+
+    /// @brief 地名語がアクティブな辞書とクラスに含まれ、有効期間が期間と重なるかどうか
+    /// @arg @c geo 地名語
+    inline bool isActive(const Geoword& geo) const {
+      if (!this->isActiveDictionary(geo.get_dictionary_id())) return false;
+      if (this->has_period) {
+        int valid_from, valid_to;
+        geo.getValidPeriod(valid_from, valid_to);
+        if (!this->isInPeriod(valid_from, valid_to)) return false;
+      }
+      return this->isActiveClass(geo.get_ne_class_view());
+    }
+
+    /// @brief 辞書と固有名クラスで指定した地名語がアクティブかどうか
+    /// @arg @c dictionary_id 辞書の内部 ID
+    /// @arg @c ne_class      固有名クラス
+    inline bool isActive(int dictionary_id, std::string_view ne_class) const {
+      if (!this->isActiveDictionary(dictionary_id)) return false;
+      return this->isActiveClass(ne_class);
+    }
+
+    /// @brief 辞書と固有名クラス、有効期間で指定した地名語がアクティブかどうか
+    /// @arg @c dictionary_id 辞書の内部 ID
+    /// @arg @c ne_class      固有名クラス
+    /// @arg @c valid_from    有効期間の開始日
+    /// @arg @c valid_to      有効期間の終了日
+    inline bool isActive(int dictionary_id, std::string_view ne_class, int valid_from, int valid_to) const {
+      return this->isInPeriod(valid_from, valid_to) && this->isActive(dictionary_id, ne_class);
+    }
+  };
+}
+#endif
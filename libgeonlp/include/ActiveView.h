@@ -0,0 +1,92 @@
+///
+/// @file
+/// @brief 解析ごとに指定できるアクティブな辞書/固有名クラス/期間の組 ActiveView の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _ACTIVE_VIEW_H
+#define _ACTIVE_VIEW_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/shared_ptr.hpp>
+#include "ActiveFilter.h"
+#include "Dictionary.h"
+
+namespace geonlp
+{
+  ///
+  /// @brief 解析や検索の呼び出しごとに指定する、アクティブな辞書と固有名クラスの組。
+  ///
+  /// 期間を指定した場合は、有効期間が期間と重ならない地名語も候補から除く。
+  /// MA::createActiveView() で作成し、作成後は変更しない。
+  /// 辞書IDのビットセットとクラス正規表現は作成時にコンパイルしておき、
+  /// MA の共有設定を変更せずに、一つの MA を複数の設定で同時に利用できる。
+  /// 見出し語IDごとの判定結果は作成した MA の DB が更新されるまで再利用する。
+  /// DB の更新後も利用できるが、判定結果を記憶しないため作り直す方が速い。
+  ///
+  class ActiveView {
+  private:
+    /// アクティブな辞書
+    std::map<int, Dictionary> dictionaries;
+
+    /// アクティブな固有名クラスの正規表現リスト
+    std::vector<std::string> classes;
+
+    /// 期間の開始日と終了日（年 * 10000 + 月 * 100 + 日）
+    int date_from;
+    int date_to;
+
+    /// dictionaries と classes から作成した判定用データ
+    ActiveFilter filter;
+
+    /// 作成時の MA の DB の更新番号
+    unsigned long serial;
+
+    // コピー禁止
+    ActiveView(const ActiveView&);
+    ActiveView& operator=(const ActiveView&);
+
+  public:
+    /// @brief コンストラクタ
+    /// @arg @c dics          アクティブな辞書、key は辞書の内部 ID
+    /// @arg @c ne_classes    クラス名の正規表現リスト、- から始まる場合は除外する
+    /// @arg @c date_from     期間の開始日、期間を問わない場合は GEOWORD_DATE_MIN
+    /// @arg @c date_to       期間の終了日、期間を問わない場合は GEOWORD_DATE_MAX
+    /// @arg @c num_wordlists 見出し語IDの数
+    /// @arg @c serial        作成時の MA の DB の更新番号
+    /// @exception boost::regex_error 正規表現が不正
+    ActiveView(const std::map<int, Dictionary>& dics, const std::vector<std::string>& ne_classes,
+               int date_from, int date_to, size_t num_wordlists, unsigned long serial):
+      dictionaries(dics), classes(ne_classes), date_from(date_from), date_to(date_to), serial(serial) {
+      this->filter.setDictionaries(this->dictionaries);
+      this->filter.setClasses(this->classes);
+      this->filter.setPeriod(this->date_from, this->date_to);
+      this->filter.setWordlistCount(num_wordlists);
+    }
+
+    /// @brief アクティブな辞書を取得する。
+    inline const std::map<int, Dictionary>& getDictionaries(void) const { return this->dictionaries; }
+
+    /// @brief アクティブな固有名クラスの正規表現リストを取得する。
+    inline const std::vector<std::string>& getClasses(void) const { return this->classes; }
+
+    /// @brief 期間の開始日を取得する。
+    inline int getDateFrom(void) const { return this->date_from; }
+
+    /// @brief 期間の終了日を取得する。
+    inline int getDateTo(void) const { return this->date_to; }
+
+    /// @brief 判定用データを取得する。
+    inline const ActiveFilter& getFilter(void) const { return this->filter; }
+
+    /// @brief 作成時の MA の DB の更新番号を取得する。
+    inline unsigned long getSerial(void) const { return this->serial; }
+  };
+
+  typedef boost::shared_ptr<const ActiveView> ActiveViewPtr;
+}
+#endif /* _ACTIVE_VIEW_H */
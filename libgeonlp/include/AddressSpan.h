@@ -0,0 +1,64 @@
+///
+/// @file
+/// @brief ラティス表現から住所表記になり得る範囲を求める関数の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _ADDRESS_SPAN_H
+#define _ADDRESS_SPAN_H
+
+#include <string>
+#include <vector>
+
+namespace geonlp
+{
+  /// @brief ラティスの一つの位置の形態素の特徴
+  struct AddressToken {
+    /// @brief 住所表記の先頭になり得る理由のビット
+    enum {
+      HEAD_NONE    = 0,       ///< 住所表記の先頭にならない
+      HEAD_GEOWORD = 1 << 0,  ///< 住所表記の固有名クラスを持つ地名語の候補がある
+      HEAD_REGION  = 1 << 1   ///< 「名詞,固有名詞,地域,一般」の非地名語の候補がある
+    };
+
+    std::string surface;             ///< 表層形
+    std::string partOfSpeech;        ///< 品詞
+    std::string subclassification1;  ///< 品詞細分類１
+    bool geoword;                    ///< 地名語の候補がある場合は true
+    int head;                        ///< 住所表記の先頭になり得る理由
+
+    AddressToken(): geoword(false), head(HEAD_NONE) {}
+    AddressToken(const std::string& surface, const std::string& pos, const std::string& subclass1, bool geoword, int head):
+      surface(surface), partOfSpeech(pos), subclassification1(subclass1), geoword(geoword), head(head) {}
+  };
+
+  /// @brief 住所表記になり得る範囲、 [begin, end) の位置
+  struct AddressSpan {
+    size_t begin;  ///< 先頭の位置
+    size_t end;    ///< 末尾の次の位置
+
+    AddressSpan(size_t begin, size_t end): begin(begin), end(end) {}
+  };
+
+  /// @brief 形態素が住所表記の先頭に続く部分になり得るか判定する。
+  ///
+  /// 地名語、数字・漢数字・ハイフンだけの表記、丁目・番地・番・号、
+  /// 名詞（代名詞や非自立を除く）、接頭詞、アルファベット、
+  /// 「の」「が」などの連体的な助詞は住所表記の一部とみなす。
+  /// 句読点・括弧・空白などの記号、その他の助詞、動詞、助動詞などで住所表記は終わる。
+  /// @arg @c token 形態素の特徴
+  /// @return 住所表記の一部になり得る場合は true
+  bool canBeAddressPart(const AddressToken& token);
+
+  /// @brief 住所ジオコーディングを試みる範囲を求める。
+  ///
+  /// 住所表記の先頭になり得る位置ごとに、続く住所表記の一部になり得る形態素の並びを範囲とする。
+  /// 地名語だけが先頭の理由で、後に続く形態素が無い範囲は地名語として扱われるので除く。
+  /// 計算量はラティスの長さに比例する。
+  /// @arg @c tokens 位置ごとの形態素の特徴
+  /// @arg @c spans  [out] 先頭の位置の昇順に並べた範囲
+  void findAddressSpans(const std::vector<AddressToken>& tokens, std::vector<AddressSpan>& spans);
+}
+#endif /* _ADDRESS_SPAN_H */
@@ -0,0 +1,61 @@
+///
+/// @file
+/// @brief インデックスに付属するバイナリファイルの読み書きに利用する関数の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _BINARY_FILE_H
+#define _BINARY_FILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+namespace geonlp
+{
+  /// @brief ファイルを閉じるためのクラス
+  class FileCloser {
+  private:
+    FILE* fp;
+  public:
+    FileCloser(FILE* fp): fp(fp) {}
+    ~FileCloser() { if (this->fp) fclose(this->fp); }
+  };
+
+  /// @brief 整数を書き出す
+  inline void writeUint32(FILE* fp, uint32_t v) {
+    fwrite(&v, sizeof(v), 1, fp);
+  }
+
+  /// @brief 実数を書き出す
+  inline void writeDouble(FILE* fp, double v) {
+    fwrite(&v, sizeof(v), 1, fp);
+  }
+
+  /// @brief 長さ付きの文字列を書き出す
+  inline void writeString(FILE* fp, const std::string& str) {
+    writeUint32(fp, uint32_t(str.length()));
+    if (str.length() > 0) fwrite(str.data(), 1, str.length(), fp);
+  }
+
+  /// @brief 整数を読み込む
+  inline bool readUint32(FILE* fp, uint32_t& v) {
+    return fread(&v, sizeof(v), 1, fp) == 1;
+  }
+
+  /// @brief 実数を読み込む
+  inline bool readDouble(FILE* fp, double& v) {
+    return fread(&v, sizeof(v), 1, fp) == 1;
+  }
+
+  /// @brief 長さ付きの文字列を読み込む
+  inline bool readString(FILE* fp, std::string& str) {
+    uint32_t len;
+    if (!readUint32(fp, len)) return false;
+    str.resize(len);
+    return len == 0 || fread(&str[0], 1, len, fp) == len;
+  }
+}
+#endif /* _BINARY_FILE_H */
@@ -0,0 +1,23 @@
+///
+/// @file
+/// @brief 例外の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _BUNDLE_EXCEPTION_H
+#define _BUNDLE_EXCEPTION_H
+
+#include <stdexcept>
+
+namespace geonlp
+{
+  /// 辞書バンドルファイルの読み書きでの例外
+  class BundleException : public std::runtime_error {
+  public:
+    BundleException(): runtime_error("Dictionary bundle access error.") {}
+    BundleException(const std::string& message): runtime_error(message.c_str()) {}
+  };
+}
+#endif
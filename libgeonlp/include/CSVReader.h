@@ -67,6 +67,15 @@ public:
 	 */
 	CSVReader(fstream& stream, const char sep, const char quo);
 
+	/**
+	 * RXgN^
+	 * @param data CSVf[^
+	 * @param size f[^̃oCg
+	 * @comment Zp[^(,), GNI[g(")
+	 * @comment f[^͓ǂݍ݂I܂ŉȂ
+	 */
+	CSVReader(const char* data, size_t size);
+
 	/**
 	 * fXgN^
 	 */
@@ -106,6 +115,12 @@ private:
 	char separator;
 	char quote;
 
+	// ̃f[^ǂݍޏꍇ̃f[^Ɠǂݍ݈ʒu
+	const char* pdata;
+	size_t dataSize;
+	size_t dataPos;
+	bool dataEof;
+
 };
 
 #endif
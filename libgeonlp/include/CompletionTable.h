@@ -0,0 +1,120 @@
+///
+/// @file
+/// @brief 前方一致補完に利用する見出し語ごとの候補表 CompletionTable の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _COMPLETION_TABLE_H
+#define _COMPLETION_TABLE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <boost/shared_ptr.hpp>
+#include "DartsException.h"
+#include "Geoword.h"
+
+/// 候補表ファイルの形式の版、形式を変更した場合は増やす
+#define COMPLETION_TABLE_VERSION  2
+
+/// 有効期間を持たない古い形式の版
+#define COMPLETION_TABLE_VERSION_V1  1
+
+namespace geonlp
+{
+  /// @brief 候補表に記録する地名語
+  struct CompletionEntry {
+    std::string geonlp_id;  ///< 地名語ID
+    int dictionary_id;      ///< 辞書の内部 ID
+    unsigned int ne_class;  ///< 固有名クラスの番号（CompletionTable::getClass() で文字列を得る）
+    int valid_from;         ///< 有効期間の開始日（Geoword::getValidPeriod による値）
+    int valid_to;           ///< 有効期間の終了日
+
+    CompletionEntry(): dictionary_id(0), ne_class(0), valid_from(GEOWORD_DATE_MIN), valid_to(GEOWORD_DATE_MAX) {}
+  };
+
+  /// @brief 候補表に記録する見出し語
+  struct CompletionRecord {
+    std::string surface;                  ///< 表記
+    unsigned int score;                   ///< 静的スコア（地名語の数）
+    std::vector<CompletionEntry> entries; ///< 見出し語に含まれる地名語
+
+    CompletionRecord(): score(0) {}
+  };
+
+  ///
+  /// @brief 見出し語IDをインデックスとする補完候補表。
+  ///
+  /// インデックスの全体を構築する際に DBAccessor が作成してファイルに保存し、
+  /// MA はインデックスを開く際にメモリに読み込む。
+  /// 候補の表記、静的スコア、地名語ID、辞書と固有名クラスを持つので、
+  /// 補完の際に SQLite を参照せずにアクティブな辞書/クラスで絞り込める。
+  /// 差分更新で変更された見出し語は古い内容なので、 setStaleIds() で除外して
+  /// 利用側で SQLite から読み込む。
+  ///
+  /// 読み込んだ後は変更しないため、複数のスレッドからロックなしで参照してよい。
+  ///
+  class CompletionTable {
+  private:
+    /// 固有名クラスの文字列、番号の順
+    std::vector<std::string> classes;
+
+    /// 固有名クラスの文字列から番号を得る表（構築時のみ利用）
+    std::map<std::string, unsigned int> class_ids;
+
+    /// 見出し語IDをインデックスとする見出し語、欠番は表記も地名語も空
+    std::vector<CompletionRecord> records;
+
+    /// 差分更新で変更された見出し語ID
+    std::set<unsigned int> stale_ids;
+
+    /// 地名語の有効期間を記録しているかどうか、古い形式のファイルから読み込んだ場合は false
+    bool has_periods;
+
+  public:
+    /// @brief コンストラクタ、空の表を作る
+    CompletionTable(): has_periods(true) {}
+
+    // 固有名クラスの番号を得る、新しいクラスの場合は番号を割り当てる
+    unsigned int internClass(const std::string& ne_class);
+
+    // 見出し語を記録する
+    void setRecord(unsigned int wordlist_id, const CompletionRecord& record);
+
+    // ファイルに保存する
+    void save(const std::string& filename) const;
+
+    // ファイルから読み込む
+    bool load(const std::string& filename);
+
+    /// @brief 地名語の有効期間を記録しているかどうか
+    inline bool hasPeriods(void) const { return this->has_periods; }
+
+    // 確保しているメモリのバイト数を見積もる
+    size_t estimateMemorySize(void) const;
+
+    /// @brief 差分更新で変更された見出し語IDを設定する
+    inline void setStaleIds(const std::set<unsigned int>& ids) { this->stale_ids = ids; }
+
+    /// @brief 見出し語を取得する
+    /// @arg @c wordlist_id 見出し語ID
+    /// @return 見出し語、表に無い場合や差分更新で変更された場合は NULL
+    inline const CompletionRecord* getRecord(unsigned int wordlist_id) const {
+      if (wordlist_id >= this->records.size()) return NULL;
+      const CompletionRecord& r = this->records[wordlist_id];
+      if (r.entries.empty()) return NULL;
+      if (!this->stale_ids.empty() && this->stale_ids.count(wordlist_id) > 0) return NULL;
+      return &r;
+    }
+
+    /// @brief 固有名クラスの文字列を取得する
+    /// @arg @c ne_class 固有名クラスの番号
+    inline const std::string& getClass(unsigned int ne_class) const { return this->classes[ne_class]; }
+  };
+
+  typedef boost::shared_ptr<const CompletionTable> CompletionTablePtr;
+}
+#endif /* _COMPLETION_TABLE_H */
@@ -9,38 +9,61 @@
 #ifndef _DBACCESSOR_H
 #define _DBACCESSOR_H
 
-#define GEOWORD_CACHE_SIZE  1000
-
 #include <string>
+#include <set>
+#include <functional>
 #include <boost/shared_ptr.hpp>
 #include "Profile.h"
 #include "Geoword.h"
 // #include "GeowordCore.h"
 #include "Dictionary.h"
 #include "Wordlist.h"
+#include "GeowordCache.h"
+#include "DictionaryReader.h"
+#include "Stats.h"
 #include "SqliteErrException.h"
 #include "SqliteNotInitializedException.h"
 #include "FormatException.h"
 #include "DartsException.h"
+#include "SpatialIndex.h"
 #ifdef DEBUG
 #include <stdio.h>
 #include "picojsonExt.h"
 #endif
 
 struct sqlite3;
+struct sqlite3_stmt;
 
 namespace geonlp
 {	
+  class DBAccessor;
+  typedef boost::shared_ptr<DBAccessor> DBAccessorPtr;
+
+  /// @brief 一括登録用に JSON に変換済みの地名語
+  struct GeowordImportRow {
+    std::string geonlp_id;    ///< 地名語ID
+    int dictionary_id;        ///< 辞書の内部 ID
+    std::string entry_id;     ///< 辞書内のエントリID
+    std::string json;         ///< 地名語の JSON 表現
+    std::string record;       ///< 主要項目のバイナリレコード、空の場合は保存しない
+
+    GeowordImportRow(): dictionary_id(0) {}
+  };
+
+  /// @brief 一括登録する地名語を取り出す関数
+  /// 地名語を追加した場合 true、全て取り出し終えた場合 false を返す
+  typedef std::function<bool(std::vector<GeowordImportRow>&)> GeowordImportSource;
+
   ///
   /// @brief SQLiteにアクセスするためのクラス。
   ///
-  class DBAccessor {
+  class DBAccessor: public DictionaryReader {
   private:
-    /// キャッシュ
-    static std::map<std::string, Geoword> geoword_cache;
-    static bool searchGeowordFromCache(const std::string& geonlp_id, Geoword& geoword);
-    static void addGeowordToCache(const Geoword& geoword);
-    static void clearGeowordCache(void);
+    /// 地名語キャッシュ
+    GeowordCachePtr geoword_cache;
+
+    /// 主要項目だけを持つ地名語のキャッシュ
+    GeowordCachePtr geoword_record_cache;
 
     /// DBファイルハンドル
     sqlite3* sqlitep;      // 地名語一覧
@@ -52,6 +75,37 @@ namespace geonlp
     /// darts ファイル名
     std::string darts_fname;
 
+    /// インデックス構築時に地名語を解析するスレッド数（0 の場合は CPU 数）
+    unsigned int index_build_threads;
+    /// インデックス構築時にメモリ上に保持する見出し語の上限（MB、0 の場合は無制限）
+    size_t index_build_memory;
+
+    /// 辞書 CSV の読み込み時に地名語を変換するスレッド数（0 の場合は CPU 数）
+    unsigned int import_threads;
+    /// 辞書の読み込み中はジャーナルと同期書き込みを止めるかどうか
+    bool import_fast;
+
+    /// 地名語の主要項目をバイナリレコードとしても保存するかどうか
+    bool geoword_record;
+
+    /// DB を変更しない参照専用のファイル (immutable) として開くかどうか
+    bool read_only;
+    /// 参照専用の場合に SQLite が mmap する大きさ（MB）
+    size_t sqlite_mmap_size;
+    /// 参照専用の場合の SQLite のページキャッシュの大きさ（MB）
+    size_t sqlite_cache_size;
+    /// キャッシュのメモリ予算（MB、0 の場合は制限しない）、接続ごとのページキャッシュも制限する
+    size_t memory_budget;
+
+    /// DB ファイルの内容をメモリに読み込んで参照するかどうか
+    bool in_memory;
+    /// メモリに読み込んだ DB ファイルの内容、 openReader() で作成した DBAccessor と共有する
+    boost::shared_ptr<const std::string> sqlite3_image;
+    boost::shared_ptr<const std::string> wordlist_image;
+
+    /// 計測値の集計先、計測しない場合は NULL
+    StatsCollector* stats;
+
 #ifdef DEBUG
     /// DB アクセスログのファイルポインタ
     FILE* fplog;
@@ -60,6 +114,55 @@ namespace geonlp
     /// @brief darts ファイル更新時の一時ファイル名を生成
     /// @return 'tmp_' + darts_fname
     inline std::string tmpDartsFilename(void) const { return this->darts_fname + ".tmp"; }
+
+    /// @brief 読みの darts ファイル更新時の一時ファイル名を生成
+    /// @return darts_fname + '.yomi.tmp'
+    inline std::string tmpYomiDartsFilename(void) const { return this->darts_fname + ".yomi.tmp"; }
+
+    /// @brief 補完候補表ファイル更新時の一時ファイル名を生成
+    /// @return darts_fname + '.cmp.tmp'
+    inline std::string tmpCompletionFilename(void) const { return this->darts_fname + ".cmp.tmp"; }
+
+    /// @brief 空間インデックスファイル更新時の一時ファイル名を生成
+    /// @return darts_fname + '.geo.tmp'
+    inline std::string tmpSpatialIndexFilename(void) const { return this->darts_fname + ".geo.tmp"; }
+
+    /// @brief openIndexBuilder() が次の世代のインデックスを構築するファイル名を生成
+    /// @return fname + '.next'
+    static inline std::string nextGenerationFilename(const std::string& fname) { return fname + ".next"; }
+
+    // 差分インデックスの見出し語から差分 darts ファイルを作り、一時ファイルに保存する
+    bool buildDeltaDarts(int base_size, const std::string& tmp_fname) const;
+
+    // 読みの見出し語テーブルを作成し、空にする
+    void resetYomiWordlists(void) const;
+
+    // 読みの見出し語テーブルから読みの darts ファイルを作り、一時ファイルに保存する
+    bool buildYomiDarts(bool delta, const std::string& tmp_fname) const;
+
+    // 見出し語テーブルから補完候補表を、地名語テーブルから空間インデックスを作り、一時ファイルに保存する
+    void buildGeowordTables(const std::string& tmp_completion_fname, const std::string& tmp_spatial_fname) const;
+
+    // 全体を再構築した時点の見出し語数を取得する、差分更新に対応しない場合は -1
+    int getWordlistBaseSize(void) const;
+
+    // 接続ごとの SQLite のページキャッシュの大きさ（KiB）
+    size_t getSqliteCacheKiB(void) const;
+
+    // 接続にページキャッシュの大きさを設定する
+    void setSqliteCacheSize(sqlite3* p) const;
+
+    // DB ファイルを読み込み専用で開く
+    void openReadOnlyDatabase(const std::string& fname, sqlite3** pp) const;
+
+    // メモリに読み込んだ DB ファイルの内容を読み込み専用で開く
+    void openMemoryDatabase(const std::string& fname, const std::string& image, sqlite3** pp) const;
+
+    // 地名語を並列に解析し、一時ファイルで併合しながら Wordlist を構築する
+    void buildWordlistsExternally(const IndexProgressCallback& progress) const;
+
+    // wordlist_tmp テーブルを wordlist テーブルと置き換え、一時 darts ファイルを正規ファイルにする
+    void replaceWordlists(const std::set<int>& dictionary_ids, size_t num_wordlists, const std::string& tmp_darts_fname) const;
     
     /// @brief wordlist 更新時の一時テーブル wordlist_tmp を生成
     void createTmpWordlistTable(void) const;
@@ -67,27 +170,132 @@ namespace geonlp
     /// @brief wordlist 更新時の一時テーブルを削除
     void dropTmpWordlistTable(void) const;
 
+    /// 再利用する prepared statement の種類
+    enum StatementType {
+      STMT_GEOWORD_BY_ID = 0,
+      STMT_GEOWORD_BY_DICTIONARY_AND_ENTRY,
+      STMT_DICTIONARY_BY_ID,
+      STMT_DICTIONARY_BY_IDENTIFIER,
+      STMT_DICTIONARY_INTERNAL_ID,
+      STMT_WORDLIST_BY_ID,
+      STMT_WORDLIST_BY_KEY,
+      STMT_WORDLIST_BY_YOMI,
+      STMT_GEOWORD_BY_ROWID,
+      STMT_ALL_WORDLISTS,
+      STMT_MAX_WORDLIST_ID,
+      STMT_GEOWORD_RECORD_BY_ROWID,
+      NUM_STATEMENTS
+    };
+
+    /// prepared statement のプール、接続ごとに初回利用時に prepare する
+    mutable sqlite3_stmt* statements[NUM_STATEMENTS];
+
+    /// @brief プールを空の状態に初期化する
+    inline void initStatements(void) {
+      for (int i = 0; i < NUM_STATEMENTS; i++) statements[i] = NULL;
+      wordlist_has_entries = false;
+      geoword_has_record = false;
+    }
+
+    // プールから prepared statement を取得する（未作成の場合は prepare する）
+    sqlite3_stmt* acquireStatement(StatementType type) const;
+
+    // プールの prepared statement を全て finalize する
+    void finalizeStatements(void) const;
+
+    /// wordlist テーブルがデコード済み地名語IDリスト（entries カラム）を持つかどうか
+    mutable bool wordlist_has_entries;
+
+    // wordlist テーブルのカラムを調べて wordlist_has_entries を設定する
+    void checkWordlistColumns(void) const;
+
+    // wordlist を閉じて開き直す
+    void reopenWordlist(void);
+
+    /// geoword テーブルが主要項目のバイナリレコード（record カラム）を持つかどうか
+    mutable bool geoword_has_record;
+
+    // geoword テーブルのカラムを調べて geoword_has_record を設定する
+    void checkGeowordColumns(void) const;
+
+    // geoword テーブルに record カラムを追加し、登録済みの地名語のバイナリレコードを保存する
+    void addGeowordRecords(void) const;
+
+    // デコード済みの地名語IDリストの要素に対応する地名語を取得する
+    bool findGeowordByEntry(const WordlistEntry& entry, Geoword& ret, bool record_only = false) const;
+
+    // statement を 1 ステップ実行する、行が得られた場合 true
+    bool stepStatement(sqlite3_stmt* stmt) const;
+
+    /// @brief プールの statement をスコープの間だけ借りるクラス。
+    ///        スコープを抜けると reset し、バインドを解除する。
+    class StatementLease {
+    private:
+      sqlite3_stmt* stmt;
+      StatementLease(const StatementLease&);
+      StatementLease& operator=(const StatementLease&);
+    public:
+      StatementLease(const DBAccessor& dba, StatementType type): stmt(dba.acquireStatement(type)) {}
+      ~StatementLease();
+      inline operator sqlite3_stmt*() const { return stmt; }
+    };
+
   public:
     /// @brief コンストラクタ。
     /// @arg @c profilename プロファイルのファイル名
-    DBAccessor(const std::string& profile_fname): sqlitep(NULL), wordlistp(NULL) {
+    DBAccessor(const std::string& profile_fname): sqlitep(NULL), wordlistp(NULL), stats(NULL) {
       Profile profile;
       profile.load(profile_fname.c_str());
       sqlite3_fname = profile.get_sqlite3_file();
       wordlist_fname = profile.get_wordlist_file();
       darts_fname = profile.get_darts_file();
+      geoword_cache = GeowordCachePtr(new GeowordCache(profile.get_geoword_cache_size()));
+      geoword_record_cache = GeowordCachePtr(new GeowordCache(profile.get_geoword_cache_size()));
+      index_build_threads = profile.get_index_build_threads();
+      index_build_memory = profile.get_index_build_memory();
+      import_threads = profile.get_import_threads();
+      import_fast = profile.get_import_fast();
+      geoword_record = profile.get_geoword_record();
+      read_only = profile.get_read_only();
+      sqlite_mmap_size = profile.get_sqlite_mmap_size();
+      sqlite_cache_size = profile.get_sqlite_cache_size();
+      memory_budget = profile.get_memory_budget();
+      in_memory = profile.get_in_memory();
+      initStatements();
     }
     /// @brief コンストラクタ。
     /// @arg @c profile Profile オブジェクト
-    DBAccessor(const Profile& profile): sqlitep(NULL), wordlistp(NULL) {
+    DBAccessor(const Profile& profile): sqlitep(NULL), wordlistp(NULL), stats(NULL) {
       sqlite3_fname = profile.get_sqlite3_file();
       wordlist_fname = profile.get_wordlist_file();
       darts_fname = profile.get_darts_file();
+      geoword_cache = GeowordCachePtr(new GeowordCache(profile.get_geoword_cache_size()));
+      geoword_record_cache = GeowordCachePtr(new GeowordCache(profile.get_geoword_cache_size()));
+      index_build_threads = profile.get_index_build_threads();
+      index_build_memory = profile.get_index_build_memory();
+      import_threads = profile.get_import_threads();
+      import_fast = profile.get_import_fast();
+      geoword_record = profile.get_geoword_record();
+      read_only = profile.get_read_only();
+      sqlite_mmap_size = profile.get_sqlite_mmap_size();
+      sqlite_cache_size = profile.get_sqlite_cache_size();
+      memory_budget = profile.get_memory_budget();
+      in_memory = profile.get_in_memory();
+      initStatements();
     }
 		
     // DBオープン
     void open();
 
+    // 同じ DB ファイルを読み込み専用で開いた DBAccessor を作成する
+    DBAccessorPtr openReader(void) const;
+
+    // 次の世代のインデックスを別のファイルに構築する DBAccessor を作成する
+    DBAccessorPtr openIndexBuilder(void) const;
+
+    // openIndexBuilder() で構築したインデックスに置き換える
+    void publishIndex(DBAccessor& builder);
+
     // DBクローズ
     int close();
 
@@ -116,6 +324,9 @@ namespace geonlp
     // 指定された identifier を持つ辞書の内部 ID を DB から取得する
     int getDictionaryInternalId(const std::string& identifier) const;
 
+    // 単語IDリストの最大 ID を取得する
+    int getMaxWordlistId(void) const;
+
     // 全ての単語IDリストの情報を取得する
     // geonlp_ma_makedic で利用
     bool findAllWordlist(std::vector<Wordlist>& wordlists) const;
@@ -137,6 +348,19 @@ namespace geonlp
     // geoword テーブルが無い場合にはテーブルの作成も行う
     void setGeowords(const std::vector<Geoword>& geowords) const;
 
+    // JSON に変換済みの地名語を少しずつ取り出しながら一括でDBにセットする
+    // 登録した件数を返す
+    size_t bulkInsertGeowords(const GeowordImportSource& source) const;
+
+    /// @brief 辞書 CSV の読み込み時に地名語を変換するスレッド数
+    inline unsigned int getImportThreads(void) const { return this->import_threads; }
+
+    /// @brief 辞書の読み込み中はジャーナルと同期書き込みを止めるかどうか
+    inline bool getImportFast(void) const { return this->import_fast; }
+
+    /// @brief geoword テーブルに主要項目のバイナリレコードを保存しているかどうか
+    inline bool hasGeowordRecord(void) const { return this->geoword_has_record; }
+
     // 辞書を一括でDBにセット（insert）する
     // dictionary テーブルが無い場合にはテーブルの作成も行う
     void setDictionaries(const std::vector<Dictionary>& dictionaries) const;
@@ -158,9 +382,56 @@ namespace geonlp
     // darts ファイルも更新される
     void updateWordlists() const;
 
+    // 地名語テーブルの内容から Wordlist を更新する（進捗を通知する）
+    // プロファイルの index_build_threads, index_build_memory に従って構築方法を選ぶ
+    void updateWordlists(const IndexProgressCallback& progress) const;
+
     // 地名語テーブルの内容から Wordlist を更新する（更新結果を取得する）
     // darts ファイルも更新される
-    void updateWordlists(std::vector<Wordlist>& wordlists) const;
+    void updateWordlists(std::vector<Wordlist>& wordlists, const IndexProgressCallback& progress = IndexProgressCallback()) const;
+
+    /// @brief 差分 darts ファイル名を取得する
+    /// @return darts_fname + '.delta'
+    inline std::string getDeltaDartsFilename(void) const { return this->darts_fname + ".delta"; }
+
+    /// @brief 読みの darts ファイル名を取得する
+    /// @return darts_fname + '.yomi'
+    inline std::string getYomiDartsFilename(void) const { return this->darts_fname + ".yomi"; }
+
+    /// @brief 差分更新で追加された読みの darts ファイル名を取得する
+    /// @return darts_fname + '.yomi.delta'
+    inline std::string getYomiDeltaDartsFilename(void) const { return this->darts_fname + ".yomi.delta"; }
+
+    /// @brief 補完候補表ファイル名を取得する
+    /// @return darts_fname + '.cmp'
+    inline std::string getCompletionFilename(void) const { return this->darts_fname + ".cmp"; }
+
+    // 補完候補表を作成した後の差分更新で変更された見出し語IDを取得する
+    void getCompletionStaleIds(std::set<unsigned int>& ids) const;
+
+    /// @brief 空間インデックスファイル名を取得する
+    /// @return darts_fname + '.geo'
+    inline std::string getSpatialIndexFilename(void) const { return this->darts_fname + ".geo"; }
+
+    // 空間インデックスを作成した後の差分更新で追加・削除された辞書の内部 ID を取得する
+    void getSpatialStaleDictionaries(std::set<int>& stale_ids, std::set<int>& indexed_ids) const;
+
+    // 辞書に含まれる地名語の地点を空間インデックスに追加する
+    void addSpatialPoints(int dictionary_id, SpatialIndex& index) const;
+
+    // インデックスに登録されていない辞書の内部 ID を取得する
+    bool getUnindexedDictionaries(std::vector<int>& dictionary_ids) const;
+
+    // 辞書に含まれる地名語の見出し語を Wordlist に追加する
+    // 新しい見出し語は差分 darts ファイルに登録される
+    void addDictionaryToWordlists(int dictionary_id) const;
+
+    // 辞書に含まれる地名語を Wordlist から取り除く
+    // 地名語テーブルから削除する前に実行すること
+    void removeDictionaryFromWordlists(int dictionary_id) const;
+
+    // 辞書、地名語、見出し語とインデックスを一つのバンドルファイルに書き出す
+    void exportBundle(const std::string& filename) const;
 
     // 辞書 CSV ファイルから地名語と辞書情報を読み込む
     // 読み込んだ件数を返す
@@ -170,7 +441,37 @@ namespace geonlp
     void removeDictionary(const std::string& identifier) const;
 
     // wordlist に含まれる ID を持つ Geoword をデータベースから取得する
-    int getGeowordListFromWordlist(const Wordlist& wordlist, std::vector<Geoword>& ret, int limit = 0) const;
+    // record_only が true の場合、可能であれば主要項目だけを取得する
+    int getGeowordListFromWordlist(const Wordlist& wordlist, std::vector<Geoword>& ret, int limit = 0, bool record_only = false, std::vector<size_t>* entry_indexes = NULL) const;
+
+    // 地名語キャッシュの利用状況を取得する
+    inline GeowordCache::Stats getGeowordCacheStats(void) const { return geoword_cache->getStats(); }
+
+    // 地名語キャッシュのヒット数、ミス数を 0 に戻す
+    inline void resetGeowordCacheStats(void) const { geoword_cache->resetStats(); }
+
+    // 主要項目だけを持つ地名語のキャッシュの利用状況を取得する
+    inline GeowordCache::Stats getGeowordRecordCacheStats(void) const { return geoword_record_cache->getStats(); }
+
+    /// @brief 地名語キャッシュが推定バイト数を計上するメモリ予算を設定する、NULL の場合は計上しない
+    /// 地名語キャッシュは openReader() で作成した DBAccessor と共有する
+    inline void setMemoryBudget(MemoryBudget* b) {
+      geoword_cache->setMemoryBudget(b);
+      geoword_record_cache->setMemoryBudget(b);
+    }
+
+    // メモリに読み込んだ DB ファイルの内容のバイト数、 in_memory でない場合は 0
+    size_t getInMemoryImageSize(void) const;
+
+    // 地名語 DB の接続に設定されたページキャッシュと mmap の上限のバイト数
+    void getSqliteLimits(size_t& cache_bytes, size_t& mmap_bytes) const;
+
+    // SQLite がプロセス全体で確保しているメモリのバイト数
+    static size_t getSqliteMemoryUsed(void);
+
+    /// @brief 計測値の集計先を設定する、NULL の場合は計測しない
+    /// openReader() で作成した DBAccessor にも引き継がれる
+    inline void setStatsCollector(StatsCollector* s) { stats = s; }
 
   private:
     // geowordテーブルから得られた情報が、期待する順序でカラムが並んでいることを確認する
@@ -184,18 +485,22 @@ namespace geonlp
 
     // geowordテーブルから得られた情報を地名語エントリクラスに変換する
     void resultToGeoword( char **azResult, Geoword& out) const;
+    void resultToGeoword(sqlite3_stmt* stmt, Geoword& out) const;
 		
     // dictionaryテーブルから得られた情報を辞書クラスに変換する
     void resultToDictionary(char** azResult, Dictionary& out) const;
+    void resultToDictionary(sqlite3_stmt* stmt, Dictionary& out) const;
 
     // wordlistテーブルから得られた情報を単語IDリストクラスに変換する
     void resultToWordlist(char** azResult, Wordlist& out) const;
+    void resultToWordlist(sqlite3_stmt* stmt, Wordlist& out) const;
 
     // geoword, dictionary, wordlist テーブルを作成する（もしなければ）
     void createTables() const;
 
     void beginTransaction(sqlite3*) const;
     void commit(sqlite3*) const;
+    void rollback(sqlite3*) const;
 
   };
 
@@ -0,0 +1,33 @@
+///
+/// @file
+/// @brief darts ファイル読み込み関数の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _DARTS_LOADER_H
+#define _DARTS_LOADER_H
+
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include "darts.h"
+#include "DartsException.h"
+
+namespace geonlp
+{
+  typedef boost::shared_ptr<Darts::DoubleArray> DoubleArrayPtr;
+
+  /// @brief darts ファイルを開いて DoubleArray を返す。
+  ///
+  /// use_mmap が true の場合はファイルを読み取り専用で mmap し、
+  /// 複数プロセス間でページキャッシュを共有する。
+  /// mmap 領域は返された DoubleArrayPtr の解放時に munmap される。
+  /// false の場合は従来通り Darts::DoubleArray::open() でヒープに読み込む。
+  /// @arg @c filename darts ファイル名
+  /// @arg @c use_mmap mmap で開く場合 true
+  /// @return DoubleArray へのポインタ、ファイルが存在しない場合は空ポインタ
+  /// @exception DartsException ファイルの読み込みに失敗した
+  DoubleArrayPtr openDartsFile(const std::string& filename, bool use_mmap);
+}
+#endif
@@ -0,0 +1,45 @@
+///
+/// @file
+/// @brief darts の部分木をたどる検索関数の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _DARTS_SEARCH_H
+#define _DARTS_SEARCH_H
+
+#include <string>
+#include <vector>
+#include "darts.h"
+
+namespace geonlp
+{
+  /// @brief fuzzySearch() が返す、近似一致した見出し語
+  struct FuzzyResult {
+    int value;              ///< darts の値（見出し語ID）
+    std::string key;        ///< 一致した見出し語
+    unsigned int distance;  ///< 検索文字列との編集距離（文字数）
+  };
+
+  /// @brief darts で前方一致する全ての見出し語の値を得る。
+  ///
+  /// Darts::DoubleArray は前方一致する見出し語の列挙を持たないので、
+  /// prefix に対応する節点から部分木を深さ優先でたどる。
+  /// @arg @c da     見出し語の darts
+  /// @arg @c prefix 前方一致文字列
+  /// @arg @c ret    [out] 見出し語の値のリスト、見出し語の文字コード順
+  void predictiveSearch(const Darts::DoubleArray& da, const std::string& prefix, std::vector<int>& ret);
+
+  /// @brief 検索文字列との編集距離が max_distance 以下の見出し語を全て得る。
+  ///
+  /// darts を根から深さ優先でたどりながら UTF-8 の文字単位で Levenshtein 距離の表を一行ずつ計算し、
+  /// 表の最小値が max_distance を超えた節点で打ち切る。
+  /// 置換、挿入、削除をそれぞれ距離 1 とする。
+  /// @arg @c da           見出し語の darts
+  /// @arg @c key          検索文字列（UTF-8）
+  /// @arg @c max_distance 許容する編集距離
+  /// @arg @c ret          [out] 一致した見出し語のリスト、見出し語の文字コード順
+  void fuzzySearch(const Darts::DoubleArray& da, const std::string& key, unsigned int max_distance, std::vector<FuzzyResult>& ret);
+}
+#endif /* _DARTS_SEARCH_H */
@@ -0,0 +1,179 @@
+///
+/// @file
+/// @brief 辞書バンドルファイルの読み書きクラス DictionaryBundle, DictionaryBundleWriter の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _DICTIONARY_BUNDLE_H
+#define _DICTIONARY_BUNDLE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <utility>
+#include <boost/shared_ptr.hpp>
+#include "darts.h"
+#include "DictionaryReader.h"
+#include "BundleException.h"
+
+/// バンドルファイルの形式の版、形式を変更した場合は増やす
+#define DICTIONARY_BUNDLE_VERSION  2
+
+namespace geonlp
+{
+  class DictionaryBundle;
+  typedef boost::shared_ptr<DictionaryBundle> DictionaryBundlePtr;
+
+  ///
+  /// @brief 参照専用の辞書バンドルファイルを mmap して参照するクラス。
+  ///
+  /// バンドルファイルは DBAccessor::exportBundle() で書き出す。
+  /// 見出し語の darts、デコード済みの地名語IDリストを持つ見出し語、
+  /// 地名語の主要項目のバイナリレコードと JSON、辞書情報を一つのファイルに持つ。
+  ///
+  /// ファイルの内容は変更されないため、開いた後は複数のスレッドから
+  /// ロックなしで同時に参照してよい。SQLite は利用しない。
+  ///
+  class DictionaryBundle: public DictionaryReader {
+  private:
+    /// バンドルファイル名
+    std::string filename;
+
+    /// mmap した領域
+    void* addr;
+    size_t length;
+
+    /// 地名語の領域、地名語IDの順に並ぶ
+    std::string_view geoword_data;
+    /// 地名語の位置（geoword_data 内のオフセット）、地名語IDの順
+    const uint64_t* geoword_index;
+    size_t num_geowords;
+
+    /// 見出し語の領域
+    std::string_view wordlist_data;
+    /// 見出し語IDごとの位置（wordlist_data 内のオフセット）、欠番は UINT64_MAX
+    const uint64_t* wordlist_index;
+    size_t num_wordlists;
+
+    /// 辞書の内部 ID をキーとする辞書情報
+    std::map<int, Dictionary> dictionaries;
+    /// 辞書の identifier をキーとする内部 ID
+    std::map<std::string, int> dictionary_ids;
+
+    /// 見出し語の darts、値は見出し語ID
+    Darts::DoubleArray da;
+
+    // 地名語 ID、辞書 ID、レコード、JSON を取り出す
+    void readGeoword(size_t index, std::string_view& geonlp_id, int& dictionary_id, std::string_view& record, std::string_view& json) const;
+
+    // 指定した位置の地名語を取得する
+    bool getGeowordAt(size_t index, Geoword& ret, bool record_only) const;
+
+    // 地名語IDから地名語の位置を探す、見つからない場合は -1
+    long findGeowordIndex(const std::string& geonlp_id) const;
+
+    // コピー禁止
+    DictionaryBundle(const DictionaryBundle&);
+    DictionaryBundle& operator=(const DictionaryBundle&);
+
+  public:
+    // バンドルファイルを開く
+    DictionaryBundle(const std::string& filename);
+
+    // デストラクタ、mmap した領域を解放する
+    ~DictionaryBundle();
+
+    /// @brief バンドルファイル名
+    inline const std::string& getFilename(void) const { return this->filename; }
+
+    /// @brief 見出し語の darts、見出し語が無い場合は NULL
+    /// 返す DoubleArray はこのオブジェクトと同じ寿命を持つ
+    inline Darts::DoubleArray* getDoubleArray(void) { return this->da.size() > 0 ? &this->da : NULL; }
+
+    /// @brief mmap したバンドルファイルのバイト数
+    inline size_t getMappedSize(void) const { return this->length; }
+
+    bool findGeowordById(const std::string& id, Geoword& ret) const;
+    int getDictionaryList(std::map<int, Dictionary>& ret) const;
+    bool getDictionaryById(int id, Dictionary& ret) const;
+    bool getDictionary(const std::string& identifier, Dictionary& ret) const;
+    int getMaxWordlistId(void) const;
+    bool findWordlistById(unsigned int id, Wordlist& ret) const;
+    bool findWordlistBySurface(const std::string& surface, Wordlist& ret) const;
+    int getGeowordListFromWordlist(const Wordlist& wordlist, std::vector<Geoword>& ret, int limit = 0, bool record_only = false, std::vector<size_t>* entry_indexes = NULL) const;
+  };
+
+  ///
+  /// @brief 辞書バンドルファイルを書き出すクラス。
+  ///
+  /// 地名語を地名語IDの昇順に追加し、続けて見出し語を追加してから close() を呼ぶ。
+  /// 辞書はいつ追加してもよい。
+  /// 一時ファイルに書き出し、close() で正規のファイル名に置き換えるため、
+  /// 書き出し中も既存のバンドルファイルを参照できる。
+  ///
+  class DictionaryBundleWriter {
+  private:
+    /// 書き出すファイル名
+    std::string filename;
+    /// 書き出し中の一時ファイル名
+    std::string tmp_fname;
+    FILE* fp;
+    /// 書き出したバイト数
+    uint64_t pos;
+
+    /// 辞書の内部 ID, identifier, JSON
+    std::vector<std::pair<int, std::pair<std::string, std::string> > > dictionaries;
+
+    /// 地名語の開始位置と、追加した地名語ID、辞書 ID
+    uint64_t geoword_start;
+    std::vector<uint64_t> geoword_offsets;
+    std::vector<std::string> geonlp_ids;
+    std::vector<int> geoword_dictionary_ids;
+
+    /// 見出し語の開始位置と、見出し語IDごとの位置
+    uint64_t wordlist_start;
+    std::vector<uint64_t> wordlist_offsets;
+    /// darts に登録する見出し語と見出し語ID
+    std::vector<std::pair<std::string, unsigned int> > keys;
+
+    /// 作業用のバッファ
+    std::string buf;
+
+    // バッファを書き出す
+    void write(const void* data, size_t size);
+
+    // 8 バイト境界まで 0 を書き出す
+    void align(void);
+
+    // コピー禁止
+    DictionaryBundleWriter(const DictionaryBundleWriter&);
+    DictionaryBundleWriter& operator=(const DictionaryBundleWriter&);
+
+  public:
+    // 一時ファイルを作成する
+    DictionaryBundleWriter(const std::string& filename);
+
+    // デストラクタ、close() していない場合は一時ファイルを削除する
+    ~DictionaryBundleWriter();
+
+    // 辞書を追加する
+    void addDictionary(int id, const std::string& identifier, const std::string& json);
+
+    // 地名語を追加する、地名語IDの昇順に追加すること
+    void addGeoword(const std::string& geonlp_id, int dictionary_id, const std::string& record, const std::string& json);
+
+    // 見出し語を追加する、全ての地名語を追加した後に追加すること
+    void addWordlist(const Wordlist& wordlist);
+
+    // 索引と darts を書き出し、正規のファイル名に置き換える
+    void close(void);
+  };
+
+}
+
+#endif /* _DICTIONARY_BUNDLE_H */
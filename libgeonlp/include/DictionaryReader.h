@@ -0,0 +1,60 @@
+///
+/// @file
+/// @brief 地名語辞書の参照インタフェース DictionaryReader の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _DICTIONARY_READER_H
+#define _DICTIONARY_READER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "Geoword.h"
+#include "Dictionary.h"
+#include "Wordlist.h"
+
+namespace geonlp
+{
+  ///
+  /// @brief 形態素解析と地名語検索が利用する、地名語辞書の参照系メソッドの定義。
+  ///
+  /// SQLite を参照する DBAccessor と、
+  /// 書き出し済みのバンドルファイルを参照する DictionaryBundle が実装する。
+  ///
+  class DictionaryReader {
+  public:
+    virtual ~DictionaryReader() {}
+
+    /// @brief 指定した GeonlpID を持つ地名語を取得する
+    virtual bool findGeowordById(const std::string& id, Geoword& ret) const = 0;
+
+    /// @brief 辞書一覧を取得する
+    virtual int getDictionaryList(std::map<int, Dictionary>& ret) const = 0;
+
+    /// @brief 内部 ID を持つ辞書の情報を取得する
+    virtual bool getDictionaryById(int id, Dictionary& ret) const = 0;
+
+    /// @brief identifier を持つ辞書の情報を取得する
+    virtual bool getDictionary(const std::string& identifier, Dictionary& ret) const = 0;
+
+    /// @brief 見出し語IDの最大値を取得する、見出し語が無い場合は -1
+    virtual int getMaxWordlistId(void) const = 0;
+
+    /// @brief 見出し語IDを持つ Wordlist を取得する
+    virtual bool findWordlistById(unsigned int id, Wordlist& ret) const = 0;
+
+    /// @brief 見出し語に完全一致する Wordlist を取得する
+    virtual bool findWordlistBySurface(const std::string& surface, Wordlist& ret) const = 0;
+
+    /// @brief Wordlist に含まれる地名語を取得する
+    /// record_only が true の場合、可能であれば主要項目だけを取得する
+    /// entry_indexes を指定した場合、 ret の各地名語に対応する Wordlist::get_entries() の位置を返す
+    virtual int getGeowordListFromWordlist(const Wordlist& wordlist, std::vector<Geoword>& ret, int limit = 0, bool record_only = false, std::vector<size_t>* entry_indexes = NULL) const = 0;
+  };
+
+}
+
+#endif /* _DICTIONARY_READER_H */
@@ -42,7 +42,8 @@ namespace geonlp
       DARTS,   ///< DARTS初期化失敗
       GDBM,    ///< GDBM初期化失敗
       DAMS,    ///< ジオコーダ
-      SERVICE  ///< 設定値不正等
+      SERVICE, ///< 設定値不正等
+      BUNDLE   ///< 辞書バンドル初期化失敗
     };
     /// 生成に失敗した原因
     TYPE type; 
@@ -21,6 +21,12 @@ namespace geonlp
   private:
     const DBAccessor* _dbap;
 
+    // 辞書データ (JSON) を読み込んで登録し、内部 ID を返す
+    int importDictionaryJSON(const std::string& jsonfilename, std::string& dic_id_str) const;
+
+    // 辞書 CSV ファイルから地名語を並列に変換しながら一括で読み込む
+    int importGeowordsBulk(const std::string& csvfilename, int dic_id, const std::string& dic_id_str) const;
+
   public:
     /// @brief コンストラクタ。
     FileAccessor(const DBAccessor& dba) { this->_dbap = &dba; } // リファレンスポインタを保持, 解放不要
@@ -10,6 +10,10 @@
 #define _GEONLP_MA_H
 
 #include <map>
+#include <istream>
+#include <ostream>
+#include <functional>
+#include <exception>
 #include <boost/shared_ptr.hpp>
 #include "config.h"
 #include "picojson.h"
@@ -17,6 +21,8 @@
 #include "Dictionary.h"
 #include "Wordlist.h"
 #include "Node.h"
+#include "Stats.h"
+#include "ActiveView.h"
 #include "Exception.h"
 #include "SqliteNotInitializedException.h"
 #include "SqliteErrException.h"
@@ -25,7 +31,58 @@
 /// 地名語抽出システム
 namespace geonlp
 {
+  /// @brief parseNodeStream() が文ごとに呼び出す関数の型。
+  /// 文の解析結果と、入力の先頭からの文の開始位置（文字数）を受け取る。
+  /// false を返すと解析を中止する。
+  typedef std::function<bool(const std::vector<Node>& nodes, size_t offset)> NodeStreamCallback;
+
+  /// @brief parseNodeAsync() が解析の終了時に呼び出す関数の型。
+  /// 解析結果と、解析に失敗した場合はその例外（成功した場合は空）を受け取る。
+  typedef std::function<void(const std::vector<Node>& nodes, std::exception_ptr error)> NodeAsyncCallback;
+
+  /// @brief getGeowordEntriesByYomiPrefix() が返す、前方一致した読みと地名語の組。
+  struct YomiMatch {
+    /// 一致した読み
+    std::string yomi;
+    /// 読みを持つ地名語のマップ、 key は geonlp_id
+    std::map<std::string, Geoword> geowords;
+  };
+
+  /// @brief getGeowordEntriesFuzzy() が返す、近似一致した見出し語と地名語の組。
+  struct FuzzyMatch {
+    /// 一致した見出し語（標準化済み）
+    std::string key;
+    /// 検索文字列との編集距離（文字数）
+    unsigned int distance;
+    /// 見出し語に含まれるアクティブな地名語のマップ、 key は geonlp_id
+    std::map<std::string, Geoword> geowords;
+
+    FuzzyMatch(): distance(0) {}
+  };
+
+  /// @brief getCompletions() が返す補完候補。
+  struct Completion {
+    /// 候補の表記
+    std::string surface;
+    /// 静的スコア（見出し語に含まれる地名語の数）
+    unsigned int score;
+    /// アクティブな辞書/クラスに含まれる地名語の geonlp_id
+    std::vector<std::string> geonlp_ids;
+
+    Completion(): score(0) {}
+  };
+
+  /// @brief parseNodeStream() で、区切り文字が見つからない場合に文を区切る長さ（バイト数）
+  const size_t STREAM_MAX_SENTENCE_BYTES = 65536;
+
+  /// @brief parseNodeStream() で入力ストリームから一度に読み込むバイト数
+  const size_t STREAM_READ_SIZE = 65536;
+
   /// @brief MAのインタフェース定義。
+  ///
+  /// 一つのインスタンスを複数のスレッドから同時に利用してもよい。
+  /// 解析や検索は並行に実行され、アクティブな辞書やクラスの変更、
+  /// 辞書の追加・削除、インデックスの更新は実行中の解析の終了を待って排他的に実行される。
   class MA {
   public:
 
@@ -39,6 +96,23 @@ namespace geonlp
     /// @exception SqliteErrException Sqlite3でエラー。
     /// @exception MeCabErrException MeCabでエラー。
     virtual std::string parse(const std::string & sentence) const = 0;
+
+    /// @brief 引数として渡された自然文を形態素解析し、解析結果のテキストをバッファの末尾に追加する。
+    ///
+    /// 同じバッファを再利用すれば、文ごとに結果の文字列を確保しない。
+    /// @arg @c sentence 解析対象の自然文。
+    /// @arg out 解析結果を追加するバッファ。
+    /// @exception SqliteErrException Sqlite3でエラー。
+    /// @exception MeCabErrException MeCabでエラー。
+    virtual void parse(const std::string & sentence, std::string & out) const = 0;
+
+    /// @brief 引数として渡された自然文を形態素解析し、解析結果のテキストをストリームに書き出す。
+    ///
+    /// @arg @c sentence 解析対象の自然文。
+    /// @arg os 解析結果を書き出すストリーム。
+    /// @exception SqliteErrException Sqlite3でエラー。
+    /// @exception MeCabErrException MeCabでエラー。
+    virtual void parse(const std::string & sentence, std::ostream & os) const = 0;
 		
     /// @brief 引数として渡された自然文を形態素解析し、解析結果の各行を要素とするノードの配列を返す。
     ///
@@ -50,6 +124,95 @@ namespace geonlp
     /// @exception SqliteErrException Sqlite3でエラー。
     /// @exception MeCabErrException MeCabでエラー。
     virtual int parseNode(const std::string & sentence, std::vector<Node>& ret) const = 0;
+
+    /// @brief 引数として渡された自然文を、共有のアクティブな辞書/クラスの代わりに
+    /// view の辞書/クラスを利用して形態素解析する。
+    ///
+    /// 共有の設定を変更しないため、異なる view を指定した解析を並行に実行できる。
+    /// @arg @c sentence 解析対象の自然文。
+    /// @arg ret 解析結果。形態素情報クラスの配列。
+    /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+    /// @return 結果のノード数
+    /// @exception SqliteErrException Sqlite3でエラー。
+    /// @exception MeCabErrException MeCabでエラー。
+    virtual int parseNode(const std::string & sentence, std::vector<Node>& ret, const ActiveView& view) const = 0;
+
+    /// @brief 引数として渡された自然文を形態素解析し、地名語ノードの候補の地名語エントリを合わせて返す。
+    ///
+    /// 形態素解析と候補の取得を同じロックの中で行うため、
+    /// ノードごとに getGeowordEntry() を呼び出す場合と異なり、途中で辞書が更新されても
+    /// ノードと候補が一致する。候補はノードの idlist と同じ順に並ぶ。
+    /// 接尾の地名語ノードと地名語以外のノードの候補は空になる。
+    /// @arg @c sentence 解析対象の自然文。
+    /// @arg nodes 解析結果。形態素情報クラスの配列。
+    /// @arg candidates nodes と同じ順に並んだ、ノードごとの地名語エントリの配列。
+    /// @return 結果のノード数
+    /// @exception SqliteErrException Sqlite3でエラー。
+    /// @exception MeCabErrException MeCabでエラー。
+    /// @exception std::runtime_error idlist に含まれる地名語が存在しない。
+    virtual int parseLattice(const std::string & sentence, std::vector<Node>& nodes, std::vector<std::vector<Geoword> >& candidates) const = 0;
+
+    /// @brief 引数として渡された自然文を view の辞書/クラスを利用して形態素解析し、
+    /// 地名語ノードの候補の地名語エントリを合わせて返す。
+    /// @arg @c sentence 解析対象の自然文。
+    /// @arg nodes 解析結果。形態素情報クラスの配列。
+    /// @arg candidates nodes と同じ順に並んだ、ノードごとの地名語エントリの配列。
+    /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+    /// @return 結果のノード数
+    virtual int parseLattice(const std::string & sentence, std::vector<Node>& nodes, std::vector<std::vector<Geoword> >& candidates, const ActiveView& view) const = 0;
+
+    /// @brief 引数として渡された複数の自然文を並列に形態素解析し、それぞれのノードの配列を返す。
+    ///
+    /// 共有の作業スレッドと呼び出したスレッドで解析し、それぞれスレッド専用の DB 接続を利用する。
+    /// 解析中にアクティブな辞書やクラスを変更した場合、
+    /// 変更後に解析を開始した自然文から新しい設定が適用される。
+    /// @arg @c sentences 解析対象の自然文の配列。
+    /// @arg ret 解析結果。sentences と同じ順に並んだ、形態素情報クラスの配列の配列。
+    /// @arg @c n_threads 呼び出したスレッドを含む並列数、0 以下の場合は CPU 数。
+    /// @return 解析した自然文の数
+    /// @exception SqliteErrException Sqlite3でエラー。
+    /// @exception MeCabErrException MeCabでエラー。
+    virtual int parseNodeBatch(const std::vector<std::string>& sentences, std::vector<std::vector<Node> >& ret, int n_threads = 0) const = 0;
+
+    /// @brief 入力ストリームを文に区切り、文ごとに形態素解析した結果を callback に渡す。
+    ///
+    /// 改行、「。」「！」「？」の直後で文を区切り（直後の改行は同じ文に含める）、区切り文字が無いまま
+    /// max_sentence_bytes を超えた場合は文字の境界で区切る。
+    /// 入力の読み込みと MeCab による解析は別スレッドで先行して実行し、
+    /// 地名語の変換と callback の呼び出しは呼び出したスレッドで入力順に行う。
+    /// 先行する文の数には上限があるため、入力全体をメモリに保持しない。
+    /// @arg @c in 解析対象の入力ストリーム（UTF-8）。
+    /// @arg @c callback 文ごとに解析結果と文の開始位置（文字数）を受け取る関数。
+    /// @arg @c max_sentence_bytes 一つの文の最大バイト数。
+    /// @arg @c read_size 入力ストリームから一度に読み込むバイト数。
+    /// @return 解析した文の数
+    /// @exception SqliteErrException Sqlite3でエラー。
+    /// @exception MeCabErrException MeCabでエラー。
+    virtual int parseNodeStream(std::istream& in, const NodeStreamCallback& callback, size_t max_sentence_bytes = STREAM_MAX_SENTENCE_BYTES, size_t read_size = STREAM_READ_SIZE) const = 0;
+
+    /// @brief 引数として渡された自然文をプロセス全体で共有する作業スレッドで形態素解析し、
+    /// 終了時に解析結果を callback に渡す。
+    ///
+    /// 呼び出しは解析の終了を待たずに戻る。
+    /// callback は作業スレッドから呼び出されるため、呼び出し元のスレッドに
+    /// 結果を戻す処理は callback の中で行うこと。
+    /// MA のデストラクタは実行中の解析の callback が終わるまで待つため、
+    /// callback の中で同じ MA を破棄してはならない。
+    /// @arg @c sentence 解析対象の自然文。
+    /// @arg @c callback 解析結果と例外を受け取る関数。
+    virtual void parseNodeAsync(const std::string& sentence, const NodeAsyncCallback& callback) const = 0;
+
+    /// @brief 入力ストリームを文に区切って形態素解析し、解析結果のテキストをストリームに書き出す。
+    ///
+    /// 文の区切り方は parseNodeStream() と同じ。
+    /// 解析結果の書式はプロファイルの formatter に従う。
+    /// @arg @c in 解析対象の入力ストリーム（UTF-8）。
+    /// @arg os 解析結果を書き出すストリーム。
+    /// @arg @c max_sentence_bytes 一つの文の最大バイト数。
+    /// @return 解析した文の数
+    /// @exception SqliteErrException Sqlite3でエラー。
+    /// @exception MeCabErrException MeCabでエラー。
+    virtual int parseStream(std::istream& in, std::ostream& os, size_t max_sentence_bytes = STREAM_MAX_SENTENCE_BYTES) const = 0;
     
     /// @brief 引数として渡されたIDを持つ地名語エントリの全ての情報を地名語辞書システムから取得する。
     ///
@@ -68,6 +231,15 @@ namespace geonlp
     /// @exception SqliteNotInitializedException Sqlite3が未初期化。
     /// @exception SqliteErrException Sqlite3でエラー。
     virtual int getGeowordEntries(const std::string & surface, std::map<std::string, Geoword>& ret) const = 0;
+
+    /// @brief 引数に与えられた文字列に一致し、 view の辞書/クラスに含まれる Geoword 候補を取得する。
+    ///
+    /// @arg @c surface
+    /// @arg ret 地名語エントリクラスのマップ。keyがgeonlp_id、valueがGeoword(地名語エントリクラス)オブジェクト。
+    /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+    /// @return 取得した地名語エントリの数
+    /// @exception SqliteErrException Sqlite3でエラー。
+    virtual int getGeowordEntries(const std::string & surface, std::map<std::string, Geoword>& ret, const ActiveView& view) const = 0;
 	  
     /// @brief Node が地名語の場合、地名語のリストを得る
     ///        地名語ではない場合は空のマップを返す
@@ -75,6 +247,133 @@ namespace geonlp
     /// @arg   ret  地名語の場合、 idlist を展開し、 keyがgeonlp_id、valueがGeowordオブジェクトのマップ
     /// @return 取得した地名語の数
     virtual int getGeowordEntries(const Node& node, std::map<std::string, Geoword>& ret) const = 0;
+
+    /// @brief 読みに完全一致する Geoword 候補を取得する。
+    ///
+    /// 読みの darts インデックスで検索し、表記にだけ一致する地名語は含めない。
+    /// 読みは登録されたまま比較し、かなの標準化は行わない。
+    /// @arg @c yomi 読み
+    /// @arg ret 地名語エントリクラスのマップ。keyがgeonlp_id、valueがGeoword(地名語エントリクラス)オブジェクト。
+    /// @return 取得した地名語エントリの数
+    /// @exception SqliteErrException Sqlite3でエラー。
+    /// @exception IndexNotExistsException インデックスが存在しない。
+    virtual int getGeowordEntriesByYomi(const std::string& yomi, std::map<std::string, Geoword>& ret) const = 0;
+
+    /// @brief 文字列の先頭に一致する読みを全て探し、その読みを持つ Geoword 候補を取得する。
+    ///
+    /// かな入力の補完や、かな書きの文からの地名語の検出に利用する。
+    /// @arg @c text 検索する文字列
+    /// @arg ret 一致した読みとアクティブな地名語の組のリスト、読みの短い順
+    /// @return 一致した読みの数
+    /// @exception SqliteErrException Sqlite3でエラー。
+    /// @exception IndexNotExistsException インデックスが存在しない。
+    virtual int getGeowordEntriesByYomiPrefix(const std::string& text, std::vector<YomiMatch>& ret) const = 0;
+
+    /// @brief 前方一致する見出し語を静的スコアの高い順に k 件まで取得する。
+    ///
+    /// 入力中の文字列から地名を補完する用途を想定している。
+    /// インデックスの構築時に作成した補完候補表を利用するので、 SQLite を参照しない。
+    /// ただし差分更新で変更された見出し語のみ SQLite から読み込む。
+    /// 同じ表記の候補は一つにまとめ、アクティブな地名語を含まない見出し語は返さない。
+    /// @arg @c prefix 入力中の文字列（表記または読みの先頭部分）
+    /// @arg @c k      取得する候補の最大数
+    /// @arg ret 補完候補のリスト、スコアの降順（同点の場合は見出し語の文字コード順）
+    /// @return 取得した候補の数
+    /// @exception SqliteErrException Sqlite3でエラー。
+    /// @exception IndexNotExistsException インデックスが存在しない。
+    virtual int getCompletions(const std::string& prefix, size_t k, std::vector<Completion>& ret) const = 0;
+
+    /// @brief 前方一致し、 view の辞書/クラスに含まれる見出し語をスコアの高い順に k 件まで取得する。
+    ///
+    /// @arg @c prefix 入力中の文字列（表記または読みの先頭部分）
+    /// @arg @c k      取得する候補の最大数
+    /// @arg ret 補完候補のリスト、スコアの降順
+    /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+    /// @return 取得した候補の数
+    /// @exception SqliteErrException Sqlite3でエラー。
+    /// @exception IndexNotExistsException インデックスが存在しない。
+    virtual int getCompletions(const std::string& prefix, size_t k, std::vector<Completion>& ret, const ActiveView& view) const = 0;
+
+    /// @brief 表記または読みとの編集距離が max_distance 以下の見出し語と、その Geoword 候補を取得する。
+    ///
+    /// OCR や音声認識の誤り、旧字体や小書き仮名の違いなど、標準化で吸収できない表記の揺れを許容して検索する。
+    /// 標準化した文字列と見出し語の間の文字単位の Levenshtein 距離を、 darts をたどりながら計算する。
+    /// 距離が大きいほど探索する節点が増えるので、通常は 1 か 2 を指定する。
+    /// @arg @c surface      検索する文字列
+    /// @arg @c max_distance 許容する編集距離
+    /// @arg ret 一致した見出し語とアクティブな地名語の組のリスト、距離の昇順（同じ距離では見出し語の文字コード順）
+    /// @return 一致した見出し語の数
+    /// @exception SqliteErrException Sqlite3でエラー。
+    /// @exception IndexNotExistsException インデックスが存在しない。
+    virtual int getGeowordEntriesFuzzy(const std::string& surface, unsigned int max_distance, std::vector<FuzzyMatch>& ret) const = 0;
+
+    /// @brief 編集距離が max_distance 以下の見出し語と、 view の辞書/クラスに含まれる Geoword 候補を取得する。
+    ///
+    /// @arg @c surface      検索する文字列
+    /// @arg @c max_distance 許容する編集距離
+    /// @arg ret 一致した見出し語とアクティブな地名語の組のリスト、距離の昇順
+    /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+    /// @return 一致した見出し語の数
+    /// @exception SqliteErrException Sqlite3でエラー。
+    /// @exception IndexNotExistsException インデックスが存在しない。
+    virtual int getGeowordEntriesFuzzy(const std::string& surface, unsigned int max_distance, std::vector<FuzzyMatch>& ret, const ActiveView& view) const = 0;
+
+    /// @brief 矩形に含まれる地点を持つ、アクティブな辞書/クラスの地名語IDを取得する。
+    ///
+    /// インデックスを構築する際に作成した空間インデックスを利用する。
+    /// @arg @c min_lat 南端の緯度
+    /// @arg @c min_lon 西端の経度
+    /// @arg @c max_lat 北端の緯度
+    /// @arg @c max_lon 東端の経度
+    /// @arg ret 地名語IDのリスト、地名語IDの順
+    /// @return 取得した地名語IDの数
+    /// @exception IndexNotExistsException 空間インデックスが存在しない。
+    virtual int getGeowordIdsInBox(double min_lat, double min_lon, double max_lat, double max_lon, std::vector<std::string>& ret) const = 0;
+
+    /// @brief 矩形に含まれる地点を持つ、 view の辞書/クラスの地名語IDを取得する。
+    /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+    virtual int getGeowordIdsInBox(double min_lat, double min_lon, double max_lat, double max_lon, std::vector<std::string>& ret, const ActiveView& view) const = 0;
+
+    /// @brief 中心からの距離が radius 以下の地点を持つ、アクティブな辞書/クラスの地名語IDを取得する。
+    ///
+    /// 距離は Util::latlonDist() で計算する。
+    /// @arg @c lat    中心の緯度
+    /// @arg @c lon    中心の経度
+    /// @arg @c radius 半径（単位：km）
+    /// @arg ret 地名語IDのリスト、中心に近い順
+    /// @return 取得した地名語IDの数
+    /// @exception IndexNotExistsException 空間インデックスが存在しない。
+    virtual int getGeowordIdsInRadius(double lat, double lon, double radius, std::vector<std::string>& ret) const = 0;
+
+    /// @brief 中心からの距離が radius 以下の地点を持つ、 view の辞書/クラスの地名語IDを取得する。
+    /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+    virtual int getGeowordIdsInRadius(double lat, double lon, double radius, std::vector<std::string>& ret, const ActiveView& view) const = 0;
+
+    /// @brief GeoJSON の範囲に含まれる地点を持つ、アクティブな辞書/クラスの地名語IDを取得する。
+    ///
+    /// @arg @c geojson Polygon または MultiPolygon を表す GeoJSON（Feature, FeatureCollection も可）
+    /// @arg ret 地名語IDのリスト、地名語IDの順
+    /// @return 取得した地名語IDの数
+    /// @exception ServiceRequestFormatException GeoJSON の形式が正しくない。
+    /// @exception IndexNotExistsException 空間インデックスが存在しない。
+    virtual int getGeowordIdsInGeometry(const picojson::value& geojson, std::vector<std::string>& ret) const = 0;
+
+    /// @brief GeoJSON の範囲に含まれる地点を持つ、 view の辞書/クラスの地名語IDを取得する。
+    /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+    virtual int getGeowordIdsInGeometry(const picojson::value& geojson, std::vector<std::string>& ret, const ActiveView& view) const = 0;
+
+    /// @brief 地名語IDのリストを、地点が GeoJSON の範囲に含まれるかどうかで絞り込む。
+    ///
+    /// 空間フィルタが候補ごとに空間演算を行う代わりに、候補の地名語IDをまとめて判定する。
+    /// 空間インデックスに無い地名語は地名語テーブルから経緯度を読み込む。
+    /// 経緯度を持たない地名語と、存在しない地名語IDは常に残す。
+    /// @arg @c geonlp_ids 地名語IDのリスト
+    /// @arg @c geojson    Polygon または MultiPolygon を表す GeoJSON（Feature, FeatureCollection も可）
+    /// @arg @c inside     true の場合は範囲に含まれる地名語、 false の場合は含まれない地名語を残す
+    /// @arg ret 残した地名語IDのリスト、 geonlp_ids の順
+    /// @return 残した地名語IDの数
+    /// @exception ServiceRequestFormatException GeoJSON の形式が正しくない。
+    virtual int filterGeowordIdsByGeometry(const std::vector<std::string>& geonlp_ids, const picojson::value& geojson, bool inside, std::vector<std::string>& ret) const = 0;
 	
     /// @brief 引数に与えられた文字列に対応する Wordlist を得る
     ///
@@ -101,7 +400,7 @@ namespace geonlp
     virtual void resetActiveDictionaries(void) = 0;
 
     /// @brief アクティブな辞書 ID のリストを取得する。
-    virtual const std::map<int, Dictionary>& getActiveDictionaries(void) const = 0;
+    virtual std::map<int, Dictionary> getActiveDictionaries(void) const = 0;
 
     /// @brief 利用する固有名クラスをクラス名正規表現のリストで指定する
     /// @arg @c ne_classes 利用するクラス名、複数指定した場合は OR、- から始まる場合は除外する
@@ -120,7 +419,30 @@ namespace geonlp
     virtual void resetActiveClasses(void) = 0;
 
     /// @brief アクティブな固有名クラスの正規表現リストを取得する。
-    virtual const std::vector<std::string>& getActiveClasses(void) const = 0;
+    virtual std::vector<std::string> getActiveClasses(void) const = 0;
+
+    /// @brief parseNode() や getGeowordEntries() に渡す、アクティブな辞書/クラスの組を作成する。
+    ///
+    /// 現在のアクティブな辞書/クラスとは独立に指定し、作成後は変更できない。
+    /// 作成した MA のインデックスでのみ利用できる。
+    /// @arg @c dictionary_ids 利用する辞書IDのリスト、登録されていない ID は無視する
+    /// @arg @c ne_classes 利用するクラス名の正規表現リスト、- から始まる場合は除外する、空の場合は全てのクラス
+    /// @return 作成した ActiveView
+    /// @exception boost::regex_error 正規表現が不正
+    virtual ActiveViewPtr createActiveView(const std::vector<int>& dictionary_ids, const std::vector<std::string>& ne_classes) const = 0;
+
+    /// @brief 有効期間で候補を絞り込む、アクティブな辞書/クラス/期間の組を作成する。
+    ///
+    /// 地名語の valid_from, valid_to が期間と重ならない地名語は、
+    /// 形態素解析や検索の候補にしない。 valid_from, valid_to が無い場合は無期限とみなす。
+    /// @arg @c dictionary_ids 利用する辞書IDのリスト、登録されていない ID は無視する
+    /// @arg @c ne_classes 利用するクラス名の正規表現リスト、- から始まる場合は除外する、空の場合は全てのクラス
+    /// @arg @c date_from 期間の開始日（年 * 10000 + 月 * 100 + 日）、開始日を問わない場合は GEOWORD_DATE_MIN
+    /// @arg @c date_to 期間の終了日、終了日を問わない場合は GEOWORD_DATE_MAX
+    /// @return 作成した ActiveView
+    /// @exception boost::regex_error 正規表現が不正
+    virtual ActiveViewPtr createActiveView(const std::vector<int>& dictionary_ids, const std::vector<std::string>& ne_classes,
+                                           int date_from, int date_to) const = 0;
 
     virtual ~MA() {}
 
@@ -146,14 +468,56 @@ namespace geonlp
     virtual int addDictionary(const std::string& jsonfile, const std::string& csvfile) const = 0;
 
     /// @brief 地名語辞書を削除する
-    /// 地名語も削除するがコンパイルはしない
+    /// 地名語も削除し、インデックスが差分更新に対応する場合はインデックスからも取り除く
     /// @arg @c identifier 辞書の identifier ("geonlp:japan_pref")
     /// @return 削除に成功した場合は True, 失敗した場合は False
     virtual bool removeDictionary(const std::string& identifier) = 0;
 
     /// @brief 地名語辞書をコンパイルしてインデックスを更新する
+    /// 全体を再構築し、差分更新で追加した見出し語も本体に統合する
     virtual void updateIndex(void) = 0;
 
+    /// @brief 地名語辞書をコンパイルしてインデックスを更新する（進捗を通知する）
+    /// @arg @c progress 段階名と処理済み件数、全体の件数を受け取る関数
+    virtual void updateIndex(const IndexProgressCallback& progress) = 0;
+
+    /// @brief インデックスに登録されていない地名語辞書だけをインデックスに追加する
+    /// 追加する辞書の地名語数に比例する時間で更新できる
+    /// 差分更新に対応しないインデックスの場合は updateIndex() と同じ
+    virtual void updateIndexIncrementally(void) = 0;
+
+    /// @brief 辞書、地名語、インデックスを参照専用の辞書バンドルファイルに書き出す
+    /// プロファイルの bundle にファイル名を指定すると、 SQLite の代わりにバンドルを参照する
+    /// @arg @c filename 書き出すファイル名
+    /// @exception BundleException 書き込みに失敗
+    virtual void exportBundle(const std::string& filename) const = 0;
+
+    /// @brief 処理ごとの計測値を取得する
+    /// プロファイルの stats が true の場合だけ計測する
+    /// @arg ret 処理の名前をキーとする計測値
+    /// @return 計測値の数、計測していない場合は 0
+    virtual int getStats(std::map<std::string, StatsEntry>& ret) const = 0;
+
+    /// @brief 処理ごとの計測値を 0 に戻す
+    virtual void resetStats(void) = 0;
+
+    /// @brief 全ての見出し語がアクティブな地名語を含むかどうかを事前に判定する
+    /// 判定結果と読み込んだ地名語は、解析中の見出し語ごとの判定に利用される
+    /// 作業プロセスを fork するサーバでは fork の前に呼び出すと、判定結果を共有できる
+    /// @return 判定した見出し語の数
+    virtual int warmup(void) const = 0;
+
+    /// @brief 辞書やインデックス、キャッシュが確保しているメモリのバイト数を得る
+    /// キャッシュの値は推定値、 mecab と in_memory_db, bundle はファイルのバイト数
+    /// memory_budget はプロファイルで指定したキャッシュのメモリ予算（0 は制限なし）
+    /// sqlite_cache_limit, sqlite_mmap_limit は地名語 DB の接続に設定されたページキャッシュと mmap の上限
+    /// @arg ret 項目の名前をキーとするバイト数
+    /// @return 項目の数
+    virtual int getMemoryUsage(std::map<std::string, size_t>& ret) const = 0;
+
+    /// @brief 計測値の集計先、計測していない場合は NULL
+    virtual StatsCollector* getStatsCollector(void) const = 0;
+
   };
 	
   /// MAのポインタ
@@ -13,7 +13,25 @@
 #include "MeCabAdapter.h"
 #include "PHBSDefs.h"
 #include <fstream>
-#include "darts.h"
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <shared_mutex>
+#include <condition_variable>
+#include "DartsLoader.h"
+#include "CompletionTable.h"
+#include "SpatialIndex.h"
+#include "ActiveFilter.h"
+#include "MemoryBudget.h"
+#include "ParseCache.h"
+#include "GeowordNodeCache.h"
+#include "StandardizedCache.h"
+
+/// getGeowordNode の結果を記憶する見出し語の最大数
+#define GEOWORD_NODE_CACHE_SIZE  10000
+
+/// standardize で標準化した結果を記憶する文字列の最大数
+#define STANDARDIZED_CACHE_SIZE  4096
 
 #ifdef GEOWORD_UNITTEST
 #define PUBLIC_IF_UNITTEST public:
@@ -26,6 +44,8 @@ namespace geonlp
 {
   class MeCabAdapter;
   class DBAccessor;
+  class DictionaryReader;
+  class DictionaryBundle;
   class Profile;
   class Suffix;
   //	class Prefix;
@@ -36,11 +56,23 @@ namespace geonlp
   class NodeExt;
   typedef boost::shared_ptr<MeCabAdapter> MeCabAdapterPtr;
   typedef boost::shared_ptr<DBAccessor> DBAccessorPtr;
+  typedef boost::shared_ptr<DictionaryBundle> DictionaryBundlePtr;
   typedef boost::shared_ptr<Profile> ProfilePtr;
   typedef boost::shared_ptr<AbstructGeowordFormatter> GeowordFormatterPtr;
-  typedef boost::shared_ptr<Darts::DoubleArray> DoubleArrayPtr;
 	
   /// @brief MAのインタフェース実装クラス。
+  ///
+  /// 解析や検索などの参照系メソッドは stateMutex の共有ロックを、
+  /// アクティブな辞書/クラスの変更や DB・インデックスの更新は排他ロックを取得する。
+  /// 参照系メソッドどうしは互いに呼び出さず、共有ロックを二重に取得しないこと。
+  ///
+  /// 参照に利用する DB 接続はスレッドごとに分ける。
+  /// インスタンスを作成したスレッドは dbap を、それ以外のスレッドは
+  /// DBAccessor::openReader() で作成した読み込み専用の接続を利用する（db() を参照）。
+  ///
+  /// プロファイルで辞書バンドルファイルを指定した場合は SQLite と darts ファイルを開かず、
+  /// 全てのスレッドが mmap したバンドルを参照する。この場合、辞書や
+  /// インデックスを更新するメソッドは std::runtime_error を投げる。
   class MAImpl: public MA {
   private:
     /// 初期設定 Profile へのポインタ。
@@ -52,9 +84,39 @@ namespace geonlp
     /// SQLiteにアクセスするためのクラスへのポインタ。
     DBAccessorPtr dbap;
 
+    /// 参照に利用する辞書バンドルへのポインタ、 SQLite を参照する場合は空。
+    DictionaryBundlePtr bundlep;
+
+    /// 処理ごとの計測値の集計先、計測しない場合は空。
+    StatsCollectorPtr statsp;
+
+    /// キャッシュが共有するメモリ予算、プロファイルの memory_budget から作成する。
+    MemoryBudgetPtr budgetp;
+
+    /// 文ごとの parseNode() の結果のキャッシュ、プロファイルの parse_cache_size が 0 の場合は空。
+    ParseCachePtr parseCachep;
+
     /// SQLite に登録されている地名語の darts クラスへのポインタ。
     DoubleArrayPtr dap;
 
+    /// 差分更新で追加された見出し語の darts クラスへのポインタ、差分が無い場合は空。
+    DoubleArrayPtr delta_dap;
+
+    /// 読みの darts クラスへのポインタ、読みのインデックスが無い場合は空。
+    DoubleArrayPtr yomi_dap;
+
+    /// 差分更新で追加された読みの darts クラスへのポインタ、差分が無い場合は空。
+    DoubleArrayPtr yomi_delta_dap;
+
+    /// 前方一致補完に利用する補完候補表、候補表が無い場合は空。
+    CompletionTablePtr completion_table;
+
+    /// 地名語の経緯度による空間インデックス、インデックスが無い場合は空。
+    SpatialIndexPtr spatial_index;
+
+    /// 空間インデックスを作成した後の差分更新で追加された辞書の地点、差分が無い場合は空。
+    SpatialIndexPtr spatial_delta;
+
     /// 形態素情報リストの出力形式定義クラスへのポインタ。
     GeowordFormatterPtr formatter;
 		
@@ -72,10 +134,72 @@ namespace geonlp
 
     /// 利用するクラスのリスト、高速化のため記憶
     std::vector<std::string> activeClasses;
+
+    /// activeDictionaries と activeClasses から作成した判定用データ
+    /// ActiveView を指定した解析では代わりに ActiveView の判定用データを利用する（filter() を参照）
+    ActiveFilter activeFilter;
+
+    /// filter() の世代番号と見出し語IDをキーとする、 getGeowordNode で作成した見出し語の情報
+    mutable GeowordNodeCache geowordNodeCache;
+
+    /// 表記をキーとする、標準化した文字列
+    mutable StandardizedCache standardizedCache;
+
+    /// 終了していない parseNodeAsync の数
+    mutable size_t asyncPending;
+    mutable std::mutex asyncMutex;
+    mutable std::condition_variable asyncDone;
+
+    // 破棄時に parseNodeAsync の終了を通知する
+    struct AsyncDoneNotifier;
+
+    /// アクティブな辞書/クラス、DB、インデックスを保護する読み書きロック
+    mutable std::shared_timed_mutex stateMutex;
+
+    /// 辞書の追加、削除、インデックスの構築など DB を更新する処理を直列化するロック
+    /// stateMutex より先に取得する
+    mutable std::mutex updateMutex;
+
+    /// インスタンスを作成したスレッド、このスレッドは参照にも dbap を利用する
+    std::thread::id ownerThread;
+
+    /// スレッドごとの読み込み専用 DB 接続の持ち主を識別するための値
+    boost::shared_ptr<int> readerToken;
+
+    /// DB を更新するたびに増加する値、これより古い読み込み専用 DB 接続は開き直す
+    mutable std::atomic<unsigned long> readerSerial;
     
     typedef MeCabAdapter::NodeList NodeList;
 		
-    typedef std::list<NodeExt> NodeExtList;
+    typedef std::vector<NodeExt> NodeExtList;
+
+    typedef Darts::DoubleArray::result_pair_type ResultPair;
+
+    /// @brief 地名語候補区間の表層形と Darts 検索結果。
+    ///
+    /// getLongestGeoword で区間の末尾を削りながら候補を探す際に、
+    /// 素性境界ごとの表層形の長さと Darts の最長一致結果を再利用するために利用する。
+    struct CandidateSpan {
+      /// 区間全体の表層形
+      std::string key;
+      /// 先頭から k 番目の素性までの表層形のバイト数
+      std::vector<size_t> lengths;
+      /// key に前方一致し、アクティブな地名語を含む見出し語（短い順）
+      std::vector<ResultPair> results;
+#ifdef HAVE_LIBDAMS
+      /// 区間全体の表層形を標準化した文字列
+      std::string standardized_key;
+      /// 素性ごとの標準化文字列を連結したものが standardized_key に一致するか
+      bool composable;
+      /// 先頭から k 番目の素性までの表層形を標準化した文字列のバイト数、未計算の場合は -1
+      /// composable の場合は素性ごとの標準化文字列の累積バイト数
+      std::vector<long> standardized_lengths;
+      /// 先頭から k 番目の素性までの表層形に対する最長一致結果
+      std::vector<ResultPair> longest_results;
+      /// longest_results が計算済みかどうか
+      std::vector<bool> has_longest_results;
+#endif /* HAVE_LIBDAMS */
+    };
 
   public:
     // コンストラクタ
@@ -99,15 +223,45 @@ namespace geonlp
     // 引数として渡された自然文を形態素解析し、解析結果をテキストとして返す。
     std::string parse(const std::string & sentence) const;
 
+    // 引数として渡された自然文を形態素解析し、解析結果のテキストをバッファの末尾に追加する。
+    void parse(const std::string & sentence, std::string & out) const;
+
+    // 引数として渡された自然文を形態素解析し、解析結果のテキストをストリームに書き出す。
+    void parse(const std::string & sentence, std::ostream & os) const;
+
     // 引数として渡された自然文を形態素解析し、解析結果の各行を要素とするノードの配列を返す。
     int parseNode(const std::string & sentence, std::vector<Node>& ret) const;
 
+    // view の辞書/クラスを利用して自然文を形態素解析する。
+    int parseNode(const std::string & sentence, std::vector<Node>& ret, const ActiveView& view) const;
+
+    // 引数として渡された自然文を形態素解析し、地名語ノードの候補の地名語エントリを合わせて返す。
+    int parseLattice(const std::string & sentence, std::vector<Node>& nodes, std::vector<std::vector<Geoword> >& candidates) const;
+
+    // view の辞書/クラスを利用して形態素解析し、地名語ノードの候補の地名語エントリを合わせて返す。
+    int parseLattice(const std::string & sentence, std::vector<Node>& nodes, std::vector<std::vector<Geoword> >& candidates, const ActiveView& view) const;
+
+    // 引数として渡された複数の自然文を並列に形態素解析し、それぞれのノードの配列を返す。
+    int parseNodeBatch(const std::vector<std::string>& sentences, std::vector<std::vector<Node> >& ret, int n_threads = 0) const;
+
+    // 入力ストリームを文に区切り、文ごとに形態素解析した結果を callback に渡す。
+    int parseNodeStream(std::istream& in, const NodeStreamCallback& callback, size_t max_sentence_bytes = STREAM_MAX_SENTENCE_BYTES, size_t read_size = STREAM_READ_SIZE) const;
+
+    // 引数として渡された自然文を作業スレッドで形態素解析し、終了時に解析結果を callback に渡す。
+    void parseNodeAsync(const std::string& sentence, const NodeAsyncCallback& callback) const;
+
+    // 入力ストリームを文に区切って形態素解析し、解析結果のテキストをストリームに書き出す。
+    int parseStream(std::istream& in, std::ostream& os, size_t max_sentence_bytes = STREAM_MAX_SENTENCE_BYTES) const;
+
     // 引数として渡されたIDを持つ地名語エントリの全ての情報を地名語辞書システムから取得する。
     bool getGeowordEntry(const std::string& geonlp_id, Geoword& ret) const;
 
     // 引数に与えられた（上位語）文字列からGeoword候補を取得する。
     // 戻り値は、「keyがgeonlp_id、valueがGeowordオブジェクト」のマップ。
     int getGeowordEntries(const std::string & geoword, std::map<std::string, Geoword>& ) const;
+
+    // 引数に与えられた文字列に一致し、 view の辞書/クラスに含まれる Geoword 候補を取得する。
+    int getGeowordEntries(const std::string & geoword, std::map<std::string, Geoword>& ret, const ActiveView& view) const;
 	  
     /// @brief Node が地名語の場合、地名語のリストを得る
     ///        地名語ではない場合は空のマップを返す
@@ -115,6 +269,45 @@ namespace geonlp
     /// @return 地名語の場合、 idlist を展開し、 keyがgeonlp_id、valueがGeowordオブジェクトのマップ
     int getGeowordEntries(const Node& node, std::map<std::string, Geoword>& ret) const;
 
+    // 読みに完全一致する Geoword 候補を取得する。
+    int getGeowordEntriesByYomi(const std::string& yomi, std::map<std::string, Geoword>& ret) const;
+
+    // 文字列の先頭に一致する読みを全て探し、その読みを持つ Geoword 候補を取得する。
+    int getGeowordEntriesByYomiPrefix(const std::string& text, std::vector<YomiMatch>& ret) const;
+
+    // 前方一致する見出し語を静的スコアの高い順に k 件まで取得する。
+    int getCompletions(const std::string& prefix, size_t k, std::vector<Completion>& ret) const;
+
+    // 前方一致し、 view の辞書/クラスに含まれる見出し語をスコアの高い順に k 件まで取得する。
+    int getCompletions(const std::string& prefix, size_t k, std::vector<Completion>& ret, const ActiveView& view) const;
+
+    // 表記または読みとの編集距離が max_distance 以下の見出し語と、その Geoword 候補を取得する。
+    int getGeowordEntriesFuzzy(const std::string& surface, unsigned int max_distance, std::vector<FuzzyMatch>& ret) const;
+
+    // 編集距離が max_distance 以下の見出し語と、 view の辞書/クラスに含まれる Geoword 候補を取得する。
+    int getGeowordEntriesFuzzy(const std::string& surface, unsigned int max_distance, std::vector<FuzzyMatch>& ret, const ActiveView& view) const;
+
+    // 矩形に含まれる地点を持つ、アクティブな辞書/クラスの地名語IDを取得する。
+    int getGeowordIdsInBox(double min_lat, double min_lon, double max_lat, double max_lon, std::vector<std::string>& ret) const;
+
+    // 矩形に含まれる地点を持つ、 view の辞書/クラスの地名語IDを取得する。
+    int getGeowordIdsInBox(double min_lat, double min_lon, double max_lat, double max_lon, std::vector<std::string>& ret, const ActiveView& view) const;
+
+    // 中心からの距離が radius 以下の地点を持つ、アクティブな辞書/クラスの地名語IDを取得する。
+    int getGeowordIdsInRadius(double lat, double lon, double radius, std::vector<std::string>& ret) const;
+
+    // 中心からの距離が radius 以下の地点を持つ、 view の辞書/クラスの地名語IDを取得する。
+    int getGeowordIdsInRadius(double lat, double lon, double radius, std::vector<std::string>& ret, const ActiveView& view) const;
+
+    // GeoJSON の範囲に含まれる地点を持つ、アクティブな辞書/クラスの地名語IDを取得する。
+    int getGeowordIdsInGeometry(const picojson::value& geojson, std::vector<std::string>& ret) const;
+
+    // GeoJSON の範囲に含まれる地点を持つ、 view の辞書/クラスの地名語IDを取得する。
+    int getGeowordIdsInGeometry(const picojson::value& geojson, std::vector<std::string>& ret, const ActiveView& view) const;
+
+    // 地名語IDのリストを、地点が GeoJSON の範囲に含まれるかどうかで絞り込む。
+    int filterGeowordIdsByGeometry(const std::vector<std::string>& geonlp_ids, const picojson::value& geojson, bool inside, std::vector<std::string>& ret) const;
+
     /// 引数に与えられた文字列からGeoword候補を取得する
     /// @return Wordlist オブジェクト
     /// @exception SqliteNotInitializedException Sqlite3が未初期化。
@@ -138,7 +331,7 @@ namespace geonlp
     void resetActiveDictionaries(void);
 
     /// @brief アクティブな辞書 ID のリストを取得する。
-    const std::map<int, Dictionary>& getActiveDictionaries(void) const;
+    std::map<int, Dictionary> getActiveDictionaries(void) const;
 
     /// @brief 利用する固有名クラスをクラス名正規表現のリストで指定する
     /// @arg @c ne_classes 利用するクラス名、複数指定した場合は OR、- から始まる場合は除外する
@@ -157,16 +350,53 @@ namespace geonlp
     void resetActiveClasses(void);
 
     /// @brief アクティブな固有名クラスの正規表現リストを取得する。
-    const std::vector<std::string>& getActiveClasses(void) const;
+    std::vector<std::string> getActiveClasses(void) const;
+
+    /// @brief parseNode() や getGeowordEntries() に渡す、アクティブな辞書/クラスの組を作成する。
+    ActiveViewPtr createActiveView(const std::vector<int>& dictionary_ids, const std::vector<std::string>& ne_classes) const;
+    ActiveViewPtr createActiveView(const std::vector<int>& dictionary_ids, const std::vector<std::string>& ne_classes,
+                                   int date_from, int date_to) const;
 
     void clearDatabase(void);
     int addDictionary(const std::string& jsonfile, const std::string& csvfile) const;
     bool removeDictionary(const std::string& identifier);
     void updateIndex(void);
+    void updateIndex(const IndexProgressCallback& progress);
+    void updateIndexIncrementally(void);
+    void exportBundle(const std::string& filename) const;
+    int getStats(std::map<std::string, StatsEntry>& ret) const;
+    void resetStats(void);
+    int warmup(void) const;
+    int getMemoryUsage(std::map<std::string, size_t>& ret) const;
+    inline StatsCollector* getStatsCollector(void) const { return this->statsp.get(); }
 
   private:
     PUBLIC_IF_UNITTEST
+
+      // 現在のスレッドで参照に利用する辞書を得る
+      const DictionaryReader* db(void) const;
+
+    // 辞書バンドルを参照している場合は例外を投げる
+    void assertWritable(void) const;
+
+    // 現在のスレッド専用の読み込み専用 DBAccessor を得る
+    DBAccessor* threadReader(void) const;
+
+    // 本体と差分の darts ファイルを開く
+    void openIndex(void);
+
+    // 空間インデックスを読み込み、差分更新で追加された辞書の地点を集める
+    void openSpatialIndex(void);
+
+    // 次の世代のインデックスを構築して置き換える（updateMutex を取得済みで呼び出す）
+    void rebuildIndex(const IndexProgressCallback& progress);
+
+    // 表記に完全一致する Wordlist を得る（ロックを取得しない）
+    bool findWordlistBySurface(const std::string& key, Wordlist& ret) const;
 		
+      // 改行コードをエスケープして MeCab で解析する
+      void tokenize(const std::string& sentence, NodeList& nodes) const;
+
       // MeCabによるパース結果を地名語辞書を参照して変換する
       void convertMeCabNodeToNodeList( NodeList& nodes, std::vector<Node>& nodelist) const;
 
@@ -181,14 +411,14 @@ namespace geonlp
     int getLongestGeoword( const NodeExtList::iterator& s, const NodeExtList::iterator& e, 
 			   NodeExtList::iterator& next, std::vector<Node>& ret) const;
 		
-    // 素性の表層形を連結した文字列を得る。
-    std::string joinGeowords( NodeExtList::iterator s, NodeExtList::iterator e) const;
-		
     // 地名語候補から、地名語Nodeを得る。
     bool findGeowordNode( const std::string& surface, Node& node) const;
 
     // 見出し語IDから地名語Nodeを得る。
     Node getGeowordNode(unsigned int id, std::string& alternative) const;
+
+    // 地名語Nodeの候補の地名語IDを得る。
+    static void getGeowordIds(const Node& node, std::vector<std::string>& ret);
 	  
     std::string removeSuffix( const std::string& surface, const std::string &suffix) const;
 		
@@ -198,11 +428,63 @@ namespace geonlp
     // DARTS で最長一致する候補を得る。
     Darts::DoubleArray::result_pair_type getLongestResultWithDarts(const std::string& key, bool bSurfaceOnly = true) const;
 
+    // DARTS で前方一致し、アクティブな地名語を含む候補を全て得る。
+    void getActiveResultsWithDarts(const std::string& key, std::vector<ResultPair>& results, bool bSurfaceOnly = true) const;
+
+    // 標準化済みの文字列に DARTS で前方一致し、アクティブな地名語を含む候補を全て得る。
+    void getActiveResultsWithStandardizedKey(const std::string& key_standardized, std::vector<ResultPair>& results, bool bSurfaceOnly = true) const;
+
+    // 表記を標準化した文字列を得る。
+    std::string standardize(const std::string& surface) const;
+
+    // 地名語候補区間の表層形と Darts 検索結果を準備する。
+    void initCandidateSpan(NodeExtList::iterator s, NodeExtList::iterator e, CandidateSpan& span) const;
+
+    // 地名語候補区間の先頭から k 番目の素性までを標準化した表層形の長さを得る。
+    size_t getStandardizedLength(CandidateSpan& span, int k) const;
+
+    // 地名語候補区間の先頭から k 番目の素性までの表層形に DARTS で最長一致する候補を得る。
+    ResultPair getLongestResultInSpan(CandidateSpan& span, int k) const;
+
+    // 現在のスレッドで判定に利用する ActiveFilter を得る
+    const ActiveFilter& filter(void) const;
+
+    // filter() の見出し語IDごとの判定結果が現在の DB に対応しているか
+    bool isFilterCurrent(void) const;
+
     // 指定した地名語がアクティブな辞書/クラスに含まれているかチェックする
     bool isInActiveDictionaryAndClass(const Geoword& geo) const;
 
+    /// @brief 文字列の先頭に一致する読みの darts の結果を探す。
+    /// @arg @c text [in] 検索する文字列
+    /// @arg results [out] 一致した result_pair のリスト（一致したバイト数の昇順）
+    void searchYomiDarts(const std::string& text, std::vector<ResultPair>& results) const;
+
+    /// @brief 読みの見出し語から、読みを持つアクティブな地名語を得る。
+    /// @arg @c yomi [in] 一致した読み
+    /// @arg @c wordlist_id [in] 読みの見出し語の ID
+    /// @arg ret [out] keyがgeonlp_id、valueがGeowordオブジェクトのマップ
+    void collectYomiGeowords(const std::string& yomi, int wordlist_id, std::map<std::string, Geoword>& ret) const;
+
+    /// @brief 空間インデックスと差分の地点から、矩形に含まれるアクティブな地点を得る。
+    /// @arg @c min_lat, min_lon, max_lat, max_lon [in] 矩形の南端、西端、北端、東端
+    /// @arg ret [out] 地点へのポインタのリスト、順序は不定
+    /// @exception IndexNotExistsException 空間インデックスが存在しない。
+    void searchSpatialBox(double min_lat, double min_lon, double max_lat, double max_lon, std::vector<const SpatialPoint*>& ret) const;
+
     // 指定した地名語の表記が検索表記と一致していれば true を返す
-    bool isSurfaceMatched(const Geoword& geo, const std::string& surface) const;
+    bool isSurfaceMatched(const Geoword& geo, const WordlistEntry* entry, const std::string& surface, unsigned long long surface_hash) const;
+
+    // 検索表記を標準化した文字列のハッシュ値を得る
+    unsigned long long getSurfaceHash(const std::vector<WordlistEntry>& entries, const std::string& surface) const;
+
+    // 地名語IDリストに期間内のアクティブな地名語があり得るかどうか
+    bool hasEntryInPeriod(const std::vector<WordlistEntry>& entries, const ActiveFilter& filter) const;
+
+    // 見出し語がアクティブな地名語、表記が一致するアクティブな地名語を含むかどうか判定する
+    void checkActiveWordlist(const Wordlist& wordlist, const std::string& surface,
+                             std::vector<Geoword>& geowords, std::vector<size_t>& entry_indexes,
+                             bool& has_active, bool& has_surface_active) const;
 
   };
 }
@@ -18,6 +18,10 @@
 // 地名語の最大長（バイト）
 #define MAX_GEOWORD_LENGTH  192
 
+// 有効期間の下限と上限、日付は年 * 10000 + 月 * 100 + 日の整数で表す
+#define GEOWORD_DATE_MIN  0
+#define GEOWORD_DATE_MAX  99999999
+
 namespace geonlp
 {
 
@@ -49,6 +53,15 @@ namespace geonlp
     /// JSON テキストを得る
     inline std::string toJson() const { return this->isValid() ? ext::toJson() : "{}"; }
 
+    /// 形態素解析で参照する主要項目だけをバイナリレコードに変換する
+    bool toRecord(std::string& record) const;
+
+    /// バイナリレコードから主要項目だけを持つオブジェクトを復元する
+    bool initByRecord(const void* data, size_t size);
+
+    /// バイナリレコードまたは JSON テキストから復元する
+    void initByRecordOrJson(const char* data, size_t size);
+
     /// GeoJSON 形式のオブジェクト表現を得る
     picojson::ext getGeoObject() const;
     inline std::string getGeoJson() const { return this->getGeoObject().toJson(); }
@@ -69,6 +82,9 @@ namespace geonlp
     /// 一致しない場合 false, 一致する組み合わせがあれば true を返す
     bool get_kana_parts_for_surface(const std::string& surface, std::string& prefix_kana, std::string& suffix_kana) const;
 
+    /// 接頭辞、語幹、接尾辞の組み合わせで、指定した表記に一致するものがあるかどうか
+    inline bool has_surface(const std::string& surface) const { int prefix_no, suffix_no; return this->get_prefix_and_suffix_no(surface, prefix_no, suffix_no); }
+
     /// 必須項目が揃っていることを確認する
     bool isValid(const std::string& err) const;
     inline bool isValid(void) const { std::string err; return this->isValid(err); }
@@ -77,9 +93,19 @@ namespace geonlp
     /// 正常な値であれば true, 空欄または範囲外の場合は false を返す
     bool getCoordinates(double& lat, double& lon) const;
 
+    /// 日付文字列を年 * 10000 + 月 * 100 + 日の整数に変換する
+    /// "YYYY-MM-DD", "YYYY/M/D" などの形式で始まる場合 true, それ以外は false を返す
+    static bool parseDate(std::string_view datestr, int& ymd);
+
+    /// 有効期間 valid_from, valid_to を整数として取得する
+    /// 空欄または日付として解析できない場合は無期限として GEOWORD_DATE_MIN, GEOWORD_DATE_MAX とする
+    void getValidPeriod(int& from, int& to) const;
+
     // 定義済み項目についてはメソッドを用意し、型のチェックを行う
+    // *_view は値を複製せずに参照する（オブジェクトを変更または破棄するまで有効）
     inline void set_geonlp_id(const std::string& v) { this->_set_string("geonlp_id", v); }
     const std::string get_geonlp_id() const;
+    std::string_view get_geonlp_id_view() const;
 
     inline void set_entry_id(const std::string& v) { this->_set_string("entry_id", v); }
     inline std::string get_entry_id() const { return this->_get_string("entry_id"); }
@@ -89,28 +115,35 @@ namespace geonlp
 
     inline void set_body(const std::string& v) { this->_set_string("body", v); }
     inline std::string get_body() const { return this->_get_string("body"); }
+    inline std::string_view get_body_view() const { return this->_get_string_view("body"); }
 
     inline void set_prefix(const std::string& v) { this->_set_string_list("prefix", v, Geoword::_sep); }
     inline void set_prefix(const std::vector<std::string>& v) { this->_set_string_list("prefix", v); }
     inline std::vector<std::string> get_prefix() const { return this->_get_string_list("prefix"); }
+    inline picojson::string_list_view get_prefix_view() const { return this->_get_string_list_view("prefix"); }
 
     inline void set_suffix(const std::string& v) { this->_set_string_list("suffix", v, Geoword::_sep); }
     inline void set_suffix(const std::vector<std::string>& v) { this->_set_string_list("suffix", v); }
     inline std::vector<std::string> get_suffix() const { return this->_get_string_list("suffix"); }
+    inline picojson::string_list_view get_suffix_view() const { return this->_get_string_list_view("suffix"); }
 
     inline void set_body_kana(const std::string& v) { this->_set_string("body_kana", v); }
     inline std::string get_body_kana() const { return this->_get_string("body_kana"); }
+    inline std::string_view get_body_kana_view() const { return this->_get_string_view("body_kana"); }
 
     inline void set_prefix_kana(const std::string& v) { this->_set_string_list("prefix_kana", v, Geoword::_sep); }
     inline void set_prefix_kana(const std::vector<std::string>& v) { this->_set_string_list("prefix_kana", v); }
     inline std::vector<std::string> get_prefix_kana() const { return this->_get_string_list("prefix_kana"); }
+    inline picojson::string_list_view get_prefix_kana_view() const { return this->_get_string_list_view("prefix_kana"); }
 
     inline void set_suffix_kana(const std::string& v) { this->_set_string_list("suffix_kana", v, Geoword::_sep); }
     inline void set_suffix_kana(const std::vector<std::string>& v) { this->_set_string_list("suffix_kana", v); }
     inline std::vector<std::string> get_suffix_kana() const { return this->_get_string_list("suffix_kana"); }
+    inline picojson::string_list_view get_suffix_kana_view() const { return this->_get_string_list_view("suffix_kana"); }
 
     inline void set_ne_class(const std::string& v) { this->_set_string("ne_class", v); }
     inline std::string get_ne_class() const { return this->_get_string("ne_class"); }
+    inline std::string_view get_ne_class_view() const { return this->_get_string_view("ne_class"); }
 
     inline void set_hypernym(const std::string& v) { this->_set_string_list("hypernym", v, Geoword::_sep); }
     inline void set_hypernym(const std::vector<std::string>& v) { this->_set_string_list("hypernym", v); }
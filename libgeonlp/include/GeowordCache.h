@@ -0,0 +1,137 @@
+///
+/// @file
+/// @brief 地名語キャッシュクラス GeowordCache の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _GEOWORD_CACHE_H
+#define _GEOWORD_CACHE_H
+
+#include <string>
+#include <list>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <boost/shared_ptr.hpp>
+#include "Geoword.h"
+#include "MemoryBudget.h"
+
+/// 地名語キャッシュのデフォルトの最大保持数
+#define GEOWORD_CACHE_SIZE  10000
+
+/// キャッシュのシャード数
+#define GEOWORD_CACHE_SHARDS  16
+
+namespace geonlp
+{
+  ///
+  /// @brief geonlp_id をキーとする地名語の LRU キャッシュ。
+  ///
+  /// geonlp_id のハッシュ値でシャードに分割し、シャードごとに排他制御を行うため
+  /// 複数スレッドから同時に参照してもよい。
+  /// 各シャードは容量を超えると最も長く参照されていない地名語から追い出す。
+  /// MemoryBudget を設定した場合、地名語の推定バイト数を計上し、
+  /// 予算を超えている間も同様に追い出す。
+  ///
+  class GeowordCache {
+  public:
+    /// @brief キャッシュの利用状況
+    struct Stats {
+      unsigned long hits;     ///< ヒット数
+      unsigned long misses;   ///< ミス数
+      size_t size;            ///< 保持している地名語数
+      size_t capacity;        ///< 最大保持数
+      size_t bytes;           ///< 保持している地名語の推定バイト数
+      Stats(): hits(0), misses(0), size(0), capacity(0), bytes(0) {}
+    };
+
+  private:
+    /// @brief 保持する地名語と推定バイト数
+    struct Entry {
+      Geoword geoword;
+      size_t bytes;
+      Entry(const Geoword& geoword, size_t bytes): geoword(geoword), bytes(bytes) {}
+    };
+
+    typedef std::list<Entry> LruList;
+    typedef std::unordered_map<std::string, LruList::iterator> LruIndex;
+
+    /// @brief シャード、先頭が最近参照された地名語
+    struct Shard {
+      std::mutex mutex;
+      LruList lru;
+      LruIndex index;
+      unsigned long hits;
+      unsigned long misses;
+      size_t bytes;
+      Shard(): hits(0), misses(0), bytes(0) {}
+    };
+
+    /// シャードごとの最大保持数
+    std::atomic<size_t> shard_capacity;
+
+    Shard shards[GEOWORD_CACHE_SHARDS];
+
+    /// 推定バイト数を計上するメモリ予算、計上しない場合は NULL
+    MemoryBudget* budget;
+
+    inline Shard& shardFor(const std::string& geonlp_id) {
+      return shards[std::hash<std::string>()(geonlp_id) % GEOWORD_CACHE_SHARDS];
+    }
+
+    // 地名語を保持する場合の推定バイト数
+    static size_t estimateEntrySize(const Geoword& geoword, const std::string& geonlp_id);
+
+    // シャードの最も長く参照されていない地名語を追い出す
+    void evictOldest(Shard& shard);
+
+    // シャードの指定した地名語を削除する
+    LruList::iterator erase(Shard& shard, LruList::iterator it);
+
+    // コピー禁止
+    GeowordCache(const GeowordCache&);
+    GeowordCache& operator=(const GeowordCache&);
+
+  public:
+    /// @brief コンストラクタ
+    /// @arg @c capacity 最大保持数、0 の場合はキャッシュしない
+    GeowordCache(size_t capacity);
+
+    // 最大保持数を変更する（超過分は追い出される）
+    void setCapacity(size_t capacity);
+
+    // 推定バイト数を計上するメモリ予算を設定する
+    void setMemoryBudget(MemoryBudget* budget);
+
+    // 地名語をキャッシュから取得する
+    bool get(const std::string& geonlp_id, Geoword& geoword);
+
+    // 地名語をキャッシュに登録する
+    void put(const Geoword& geoword);
+
+    // 既にキャッシュされている地名語だけを新しい内容で置き換える
+    void refresh(const Geoword& geoword);
+
+    // 指定した辞書に含まれる地名語をキャッシュから削除する
+    void removeDictionary(int dictionary_id);
+
+    // 指定した辞書以外に含まれる地名語をキャッシュから削除する
+    void retainDictionaries(const std::set<int>& dictionary_ids);
+
+    // キャッシュを空にする
+    void clear(void);
+
+    // 利用状況を取得する
+    Stats getStats(void);
+
+    // ヒット数、ミス数を 0 に戻す
+    void resetStats(void);
+  };
+
+  typedef boost::shared_ptr<GeowordCache> GeowordCachePtr;
+}
+#endif
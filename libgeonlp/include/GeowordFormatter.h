@@ -11,11 +11,16 @@
 
 #include <vector>
 #include <string>
+#include <ostream>
 #include "Node.h"
 
 namespace geonlp
 {
 	/// @brief 形態素情報リストの出力形式定義抽象クラス。
+	///
+	/// append で始まるメソッドは呼び出し側のバッファの末尾に追加するため、
+	/// バッファを再利用すれば文ごとに文字列を確保しない。
+	/// 状態を持たないので、複数のスレッドから同時に呼び出してよい。
 	class AbstructGeowordFormatter {
 	public:
 		/// @brief 形態素情報を整形して文字列として返す。
@@ -24,12 +29,30 @@ namespace geonlp
 		/// @return 整形された形態素情報
 		virtual std::string formatNode(const Node & node) = 0;
 
+		/// @brief 形態素情報を整形してバッファの末尾に追加する。
+		///
+		/// @arg @c node 形態素情報
+		/// @arg out 出力先のバッファ
+		virtual void appendNode(const Node & node, std::string & out) { out += formatNode(node); }
+
 		/// @brief 形態素情報リストを整形して文字列として返す。
 		///
 		/// @arg @c nodelist 形態素情報リスト
 		/// @return 整形された形態素情報
 		std::string formatNodeList(const std::vector<Node> & nodelist);
 
+		/// @brief 形態素情報リストを整形してバッファの末尾に追加する。
+		///
+		/// @arg @c nodelist 形態素情報リスト
+		/// @arg out 出力先のバッファ
+		virtual void appendNodeList(const std::vector<Node> & nodelist, std::string & out);
+
+		/// @brief 形態素情報リストを整形してストリームに書き出す。
+		///
+		/// @arg @c nodelist 形態素情報リスト
+		/// @arg os 出力先のストリーム
+		void writeNodeList(const std::vector<Node> & nodelist, std::ostream & os);
+
 		/// @brief BOSに対応する文字列を返す。
 		///
 		/// @return 整形されたBOS
@@ -52,6 +75,8 @@ namespace geonlp
 	public:
 		std::string formatNode(const Node & node);
 
+		void appendNode(const Node & node, std::string & out);
+
 		std::string BOS();
 		
 		std::string EOS();
@@ -64,10 +89,29 @@ namespace geonlp
 	class ChasenGeowordFormatter : public AbstructGeowordFormatter {
 	public:
 		std::string formatNode(const Node & node);
+
+		void appendNode(const Node & node, std::string & out);
 	
 		std::string BOS();
 		
 		std::string EOS();
 	};
+
+	/// @brief 形態素情報リストの出力形式定義クラス(JSON Lines)。
+	///
+	/// 一つの文を、BOS/EOS を除く形態素情報の JSON 配列として 1 行に出力する。
+	/// 形態素情報のキーと値は Node::toObject() を picojson で直列化したものと同じ。
+	class JsonLinesGeowordFormatter : public AbstructGeowordFormatter {
+	public:
+		std::string formatNode(const Node & node);
+
+		void appendNode(const Node & node, std::string & out);
+
+		void appendNodeList(const std::vector<Node> & nodelist, std::string & out);
+
+		std::string BOS();
+		
+		std::string EOS();
+	};
 }
 #endif
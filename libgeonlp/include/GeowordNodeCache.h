@@ -0,0 +1,126 @@
+///
+/// @file
+/// @brief 見出し語ごとの地名語ノードのキャッシュクラス GeowordNodeCache の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _GEOWORD_NODE_CACHE_H
+#define _GEOWORD_NODE_CACHE_H
+
+#include <string>
+#include <list>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <boost/shared_ptr.hpp>
+#include "Node.h"
+#include "MemoryBudget.h"
+
+/// キャッシュのシャード数
+#define GEOWORD_NODE_CACHE_SHARDS  16
+
+namespace geonlp
+{
+  ///
+  /// @brief ActiveFilter の世代番号と darts の見出し語IDをキーとする、
+  /// アクティブな地名語に限定した見出し語の情報の LRU キャッシュ。
+  ///
+  /// ActiveView ごとに世代番号が異なるため、複数の ActiveView の結果を同時に記憶できる。
+  /// アクティブな辞書/クラスの変更などで使われなくなった世代の要素は参照されないため
+  /// LRU リストの末尾に移り、容量や予算を超えた際に一つずつ追い出される。
+  /// キーのハッシュ値でシャードに分割し、シャードごとに排他制御を行うため
+  /// 複数スレッドから同時に参照してもよい。
+  /// MemoryBudget を設定した場合、要素の推定バイト数を計上し、
+  /// 予算を超えている間は最も長く参照されていない要素から追い出す。
+  ///
+  class GeowordNodeCache {
+  public:
+    /// @brief 見出し語の表記、読みとアクティブな地名語に限定した候補
+    struct Entry {
+      std::string surface;              ///< 表記
+      std::string yomi;                 ///< 読み
+      GeowordCandidatesPtr candidates;  ///< アクティブな地名語に限定した候補、ノードと共有する
+    };
+
+    /// @brief キャッシュの利用状況
+    struct Stats {
+      size_t size;      ///< 保持している見出し語の数
+      size_t capacity;  ///< 最大保持数
+      size_t bytes;     ///< 保持している要素の推定バイト数
+      Stats(): size(0), capacity(0), bytes(0) {}
+    };
+
+  private:
+    /// @brief キー、 ActiveFilter の世代番号と見出し語ID
+    typedef std::pair<unsigned long, unsigned int> Key;
+    struct KeyHash {
+      size_t operator()(const Key& key) const {
+        return std::hash<unsigned long long>()((static_cast<unsigned long long>(key.first) << 32) ^ key.second);
+      }
+    };
+
+    /// @brief 保持する要素と推定バイト数
+    struct Item {
+      Key key;
+      Entry entry;
+      size_t bytes;
+      Item(const Key& key, const Entry& entry): key(key), entry(entry), bytes(0) {}
+    };
+
+    typedef std::list<Item> LruList;
+    typedef std::unordered_map<Key, LruList::iterator, KeyHash> LruIndex;
+
+    /// @brief シャード、先頭が最近参照された要素
+    struct Shard {
+      std::mutex mutex;
+      LruList lru;
+      LruIndex index;
+      size_t bytes;
+      Shard(): bytes(0) {}
+    };
+
+    /// シャードごとの最大保持数
+    size_t shard_capacity;
+
+    Shard shards[GEOWORD_NODE_CACHE_SHARDS];
+
+    /// 推定バイト数を計上するメモリ予算、計上しない場合は NULL
+    MemoryBudget* budget;
+
+    inline Shard& shardFor(const Key& key) {
+      return shards[KeyHash()(key) % GEOWORD_NODE_CACHE_SHARDS];
+    }
+
+    // 要素を保持する場合の推定バイト数
+    static size_t estimateItemSize(const Item& item);
+
+    // シャードの最も長く参照されていない要素を追い出す
+    void evictOldest(Shard& shard);
+
+    // コピー禁止
+    GeowordNodeCache(const GeowordNodeCache&);
+    GeowordNodeCache& operator=(const GeowordNodeCache&);
+
+  public:
+    // コンストラクタ
+    GeowordNodeCache(size_t capacity);
+
+    /// @brief 推定バイト数を計上するメモリ予算を設定する、要素を登録する前に設定すること
+    inline void setMemoryBudget(MemoryBudget* b) { this->budget = b; }
+
+    // 要素をキャッシュから取得する
+    bool get(unsigned long generation, unsigned int id, Entry& ret);
+
+    // 要素をキャッシュに登録する
+    void put(unsigned long generation, unsigned int id, const Entry& entry);
+
+    // キャッシュを空にする
+    void clear(void);
+
+    // 利用状況を取得する
+    Stats getStats(void);
+  };
+}
+#endif /* _GEOWORD_NODE_CACHE_H */
@@ -9,12 +9,14 @@
 #ifndef _MECABADAPTER_H
 #define _MECABADAPTER_H
 
-#include <list>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 #include <mecab.h>
 #include "Exception.h"
+#include "Stats.h"
 
 namespace MeCab{
+	class Model;
 	class Tagger;
 }
 
@@ -24,14 +26,18 @@ namespace geonlp
 	class Node;
 
 	/// @brief MeCabにアクセスするためのクラス。
+	///
+	/// MeCab::Model と MeCab::Tagger を一つだけ持ち、
+	/// parse() の呼び出しごとに MeCab::Lattice を作成するため、
+	/// 複数スレッドから同時に parse() を呼び出してもよい。
 	class MeCabAdapter {
 
 	public:
-		/// @brief @link parse() @endlinkの戻り値型定義。
-		typedef std::list<Node> NodeList;
+		/// @brief @link parse() @endlinkの結果の型定義。
+		typedef std::vector<Node> NodeList;
 		
 		/// @brief コンストラクタ。
-		MeCabAdapter(): mecabp(NULL) {};
+		MeCabAdapter(): modelp(NULL), mecabp(NULL), stats(NULL) {};
 
 		// 初期化。
 		/// @arg @c userdic ユーザ辞書ファイル名
@@ -42,16 +48,27 @@ namespace geonlp
 		void terminate();
 	
 	private:
+		/// @brief MeCabの辞書モデル。
+		MeCab::Model* modelp;
+
 		/// @brief MeCabのハンドラ。
 		MeCab::Tagger* mecabp;
 		
 		/// @brief ユーザ辞書名
 		std::string userdic;
 
+		/// @brief 計測値の集計先、計測しない場合は NULL
+		StatsCollector* stats;
 
 	public:
 		// パースする。
-		NodeList parse(const std::string & sentence);
+		void parse(const std::string & sentence, NodeList & nodelist) const;
+
+		/// @brief 計測値の集計先を設定する、NULL の場合は計測しない
+		inline void setStatsCollector(StatsCollector* s) { stats = s; }
+
+		// 辞書ファイルの合計バイト数。
+		size_t getDictionarySize() const;
 
 	};
 	
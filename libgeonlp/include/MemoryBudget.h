@@ -0,0 +1,72 @@
+///
+/// @file
+/// @brief キャッシュが共有するメモリ予算 MemoryBudget の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _MEMORY_BUDGET_H
+#define _MEMORY_BUDGET_H
+
+#include <string>
+#include <atomic>
+#include <boost/shared_ptr.hpp>
+
+namespace geonlp
+{
+  ///
+  /// @brief 地名語キャッシュなどのキャッシュが共有するメモリ予算。
+  ///
+  /// 各キャッシュは保持する要素の推定バイト数を charge() で計上し、
+  /// 要素を追い出す際に release() で戻す。
+  /// isExceeded() はこの予算に計上したバイト数だけを上限と比べ、
+  /// 超えている場合はキャッシュが古い要素を追い出す。
+  /// SQLite のページキャッシュは計上せず、 DBAccessor が接続ごとの cache_size で制限する。
+  /// 上限が 0 の場合は計上だけを行い、制限しない。
+  ///
+  /// 複数スレッドから同時に利用してよい。
+  ///
+  class MemoryBudget {
+  private:
+    /// 上限のバイト数、0 の場合は制限しない
+    size_t limit;
+
+    /// キャッシュが計上したバイト数
+    std::atomic<size_t> charged;
+
+    // コピー禁止
+    MemoryBudget(const MemoryBudget&);
+    MemoryBudget& operator=(const MemoryBudget&);
+
+  public:
+    // コンストラクタ
+    MemoryBudget(size_t limit);
+
+    /// @brief 上限のバイト数、0 の場合は制限しない
+    inline size_t getLimit(void) const { return this->limit; }
+
+    /// @brief キャッシュが計上したバイト数
+    inline size_t getCharged(void) const { return this->charged.load(std::memory_order_relaxed); }
+
+    /// @brief キャッシュが保持する要素のバイト数を計上する
+    inline void charge(size_t bytes) { this->charged.fetch_add(bytes, std::memory_order_relaxed); }
+
+    /// @brief キャッシュから追い出した要素のバイト数を戻す
+    inline void release(size_t bytes) { this->charged.fetch_sub(bytes, std::memory_order_relaxed); }
+
+    // 計上したバイト数が上限を超えているかどうか
+    bool isExceeded(void) const;
+  };
+
+  typedef boost::shared_ptr<MemoryBudget> MemoryBudgetPtr;
+
+  /// @brief 文字列が確保しているメモリのバイト数を見積もる
+  ///
+  /// 短い文字列はオブジェクト内に格納されるため 0 とする。
+  inline size_t stringMemorySize(const std::string& s) {
+    static const size_t inline_capacity = std::string().capacity();
+    return s.capacity() > inline_capacity ? s.capacity() + 1 : 0;
+  }
+}
+#endif /* _MEMORY_BUDGET_H */
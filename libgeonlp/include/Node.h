@@ -10,11 +10,26 @@
 #define _NODE_H
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <boost/shared_ptr.hpp>
 #include "picojson.h"
 
 namespace geonlp
 {
+
+  /// @brief 地名語ノードの候補となる地名語
+  struct GeowordCandidate {
+    std::string geonlp_id;     ///< 地名語ID
+    std::string typical_name;  ///< 代表表記
+
+    GeowordCandidate() {}
+    GeowordCandidate(const std::string& geonlp_id, const std::string& typical_name):
+      geonlp_id(geonlp_id), typical_name(typical_name) {}
+  };
+
+  /// @brief 複数のノードで共有する、変更しない地名語候補の配列
+  typedef boost::shared_ptr<const std::vector<GeowordCandidate> > GeowordCandidatesPtr;
 	
   /// @brief 形態素情報クラス。
   ///
@@ -28,58 +43,81 @@ namespace geonlp
     std::string feature;
 
   private:
-    /// 品詞
-    std::string partOfSpeech;
+    /// MeCab::Nodeの持つ品詞ID、不明な場合は -1
+    int posid;
+
+    /// 素性情報のフィールドの番号
+    enum Field {
+      FIELD_POS = 0,            ///< 品詞
+      FIELD_SUBCLASS1,          ///< 品詞細分類１
+      FIELD_SUBCLASS2,          ///< 品詞細分類２
+      FIELD_SUBCLASS3,          ///< 品詞細分類３／地名語ID
+      FIELD_CONJUGATED_FORM,    ///< 活用形
+      FIELD_CONJUGATION_TYPE,   ///< 活用型
+      FIELD_ORIGINAL_FORM,      ///< 原形
+      FIELD_YOMI,               ///< 読み
+      FIELD_PRONUNCIATION,      ///< 発音
+      NUM_FIELDS
+    };
+
+    /// feature の中のフィールドの開始位置と長さ
+    struct FieldRange {
+      unsigned int offset;
+      unsigned int length;
+    };
+
+    /// feature を分割したフィールドの範囲、フィールドが無い場合は長さ 0
+    FieldRange ranges[NUM_FIELDS];
+
+    /// set_*() で設定したフィールドの値、 overridden のビットが立っているフィールドのみ有効
+    ///
+    /// 多くのノードはフィールドを変更しないため、値は feature から切り出して返し、
+    /// 文字列を確保しない。
+    mutable std::string values[NUM_FIELDS];
 
-    /// 品詞細分類１
-    std::string subclassification1;
+    /// values に値を持つフィールドのビット集合
+    mutable unsigned int overridden;
 
-    /// 品詞細分類２
-    std::string subclassification2;
+    /// 地名語候補、 set_geowordCandidates() で設定した場合のみ
+    GeowordCandidatesPtr geowordCandidates;
 
-    /// 品詞細分類３／地名語ID
-    std::string subclassification3;
+    /// 品詞細分類３を geowordCandidates から作成していない場合は true
+    mutable bool subclassification3Pending;
+	
+    static const std::string delim;
 
-    /// 活用形
-    std::string conjugatedForm;
+    // feature をフィールドに分割した位置を ranges に記録する
+    void splitFeature();
 
-    /// 活用型
-    std::string conjugationType;
+    // geowordCandidates から "ID:代表表記/ID:代表表記" 形式の品詞細分類３を作成する
+    void materializeSubclassification3() const;
 
-    /// 原形
-    std::string originalForm;
+    // フィールドの値を複製せずに参照する
+    inline std::string_view field_view(Field field) const {
+      if (field == FIELD_SUBCLASS3 && subclassification3Pending) materializeSubclassification3();
+      if (overridden & (1u << field)) return values[field];
+      return std::string_view(feature).substr(ranges[field].offset, ranges[field].length);
+    }
 
-    /// 読み
-    std::string yomi;
+    // フィールドの値を設定する
+    inline void set_field(Field field, const std::string& value) {
+      values[field] = value;
+      overridden |= (1u << field);
+    }
 
-    /// 発音
-    std::string pronunciation;
-	
-    static const std::string delim;
+  protected:
+    // 素性情報を置き換える。設定済みのフィールドの値は変更しない。
+    void replaceFeature(const std::string& value);
 
   public:
     /// @brief コンストラクタ。
     ///
-    /// 引数に与えられたfeatureを素性情報に分解し、各メンバに設定する。
+    /// 引数に与えられたfeatureを素性情報に分解する。
+    /// 各フィールドは参照するまで文字列として切り出さない。
     /// @arg @c surface 形態素の文字列情報(表層形)
     /// @arg @c feature MeCab::Nodeの持つfeature。CSV で表記された素性情報。
-    Node( const std::string& surface, const std::string& feature);
-
-    /// コピーコンストラクタ
-    Node(const Node& n) {
-      this->surface = n.surface;
-      this->feature = n.feature;
-      this->partOfSpeech = n.partOfSpeech;
-      this->subclassification1 = n.subclassification1;
-      this->subclassification2 = n.subclassification2;
-      this->subclassification3 = n.subclassification3;
-      this->conjugatedForm = n.conjugatedForm;
-      this->conjugationType = n.conjugationType;
-      this->originalForm = n.originalForm;
-      this->yomi = n.yomi;
-      this->pronunciation = n.pronunciation;
-    }
-
+    /// @arg @c posid MeCab::Nodeの持つ品詞ID、不明な場合は -1
+    Node( const std::string& surface, const std::string& feature, int posid = -1);
 
     /// 形態素の文字列情報(表層形)を得る。
     inline const std::string get_surface() const;
@@ -109,8 +147,33 @@ namespace geonlp
     inline const std::string get_subclassification3() const;
 
     /// 品詞細分類３／地名語IDを設定する。
+    ///
+    /// 設定した地名語候補は取り除く。
     inline void set_subclassification3(std::string value);
 
+    /// @brief MeCab の品詞IDを得る。
+    ///
+    /// 不明な場合や、素性情報を置き換えた場合は -1 を返す。
+    inline int get_posid() const { return this->posid; }
+
+    /// @brief MeCab の品詞IDを設定する。
+    inline void set_posid(int value) { this->posid = value; }
+
+    /// @brief 地名語候補を設定する。
+    ///
+    /// 品詞細分類３は "ID:代表表記/ID:代表表記" 形式で、最初に参照した時に作成する。
+    /// 候補の配列は複製せずに共有する。
+    /// @arg @c candidates 地名語候補の配列
+    inline void set_geowordCandidates(const GeowordCandidatesPtr& candidates);
+
+    /// @brief set_geowordCandidates() で地名語候補を設定した場合は true を返す。
+    inline bool has_geowordCandidates() const { return bool(this->geowordCandidates); }
+
+    /// @brief set_geowordCandidates() で設定した地名語候補を得る。
+    ///
+    /// 設定していない場合は空の配列を返す。
+    const std::vector<GeowordCandidate>& get_geowordCandidates() const;
+
     /// 活用形を得る。
     inline const std::string get_conjugatedForm() const;
 
@@ -141,12 +204,29 @@ namespace geonlp
     /// 発音を設定する。
     inline void set_pronunciation(std::string value);
 
+    // *_view は値を複製せずに参照する（オブジェクトを変更または破棄するまで有効）
+    inline std::string_view get_surface_view() const { return surface; }
+    inline std::string_view get_partOfSpeech_view() const { return field_view(FIELD_POS); }
+    inline std::string_view get_subclassification1_view() const { return field_view(FIELD_SUBCLASS1); }
+    inline std::string_view get_subclassification2_view() const { return field_view(FIELD_SUBCLASS2); }
+    inline std::string_view get_subclassification3_view() const { return field_view(FIELD_SUBCLASS3); }
+    inline std::string_view get_conjugatedForm_view() const { return field_view(FIELD_CONJUGATED_FORM); }
+    inline std::string_view get_conjugationType_view() const { return field_view(FIELD_CONJUGATION_TYPE); }
+    inline std::string_view get_originalForm_view() const { return field_view(FIELD_ORIGINAL_FORM); }
+    inline std::string_view get_yomi_view() const { return field_view(FIELD_YOMI); }
+    inline std::string_view get_pronunciation_view() const { return field_view(FIELD_PRONUNCIATION); }
+
     /// picojson::object を返す。
     virtual picojson::object toObject() const;
 
     /// デバグ用のテキスト表記を得る。
     virtual std::string toString() const;
 
+    /// @brief 確保しているメモリのバイト数を見積もる。
+    ///
+    /// 地名語候補の配列は他のノードと共有するため含めない。
+    size_t estimateMemorySize() const;
+
     virtual ~Node() {}
 		
   };
@@ -160,75 +240,83 @@ namespace geonlp
   }
 
   inline const std::string Node::get_partOfSpeech() const {
-    return partOfSpeech;
+    return std::string(field_view(FIELD_POS));
   }
 
   inline void Node::set_partOfSpeech(std::string value) {
-    partOfSpeech = value;
+    set_field(FIELD_POS, value);
   }
 
   inline const std::string Node::get_subclassification1() const {
-    return subclassification1;
+    return std::string(field_view(FIELD_SUBCLASS1));
   }
 
   inline void Node::set_subclassification1(std::string value) {
-    subclassification1 = value;
+    set_field(FIELD_SUBCLASS1, value);
   }
 
   inline const std::string Node::get_subclassification2() const {
-    return subclassification2;
+    return std::string(field_view(FIELD_SUBCLASS2));
   }
 
   inline void Node::set_subclassification2(std::string value) {
-    subclassification2 = value;
+    set_field(FIELD_SUBCLASS2, value);
   }
 
   inline const std::string Node::get_subclassification3() const {
-    return subclassification3;
+    return std::string(field_view(FIELD_SUBCLASS3));
   }
 
   inline void Node::set_subclassification3(std::string value) {
-    subclassification3 = value;
+    set_field(FIELD_SUBCLASS3, value);
+    geowordCandidates.reset();
+    subclassification3Pending = false;
+  }
+
+  inline void Node::set_geowordCandidates(const GeowordCandidatesPtr& candidates) {
+    geowordCandidates = candidates;
+    set_field(FIELD_SUBCLASS3, std::string());
+    subclassification3Pending = bool(candidates);
   }
 
   inline const std::string Node::get_conjugatedForm() const {
-    return conjugatedForm;
+    return std::string(field_view(FIELD_CONJUGATED_FORM));
   }
 
   inline void Node::set_conjugatedForm(std::string value) {
-    conjugatedForm = value;
+    set_field(FIELD_CONJUGATED_FORM, value);
   }
 
   inline const std::string Node::get_conjugationType() const {
-    return conjugationType;
+    return std::string(field_view(FIELD_CONJUGATION_TYPE));
   }
 
   inline void Node::set_conjugationType(std::string value) {
-    conjugationType = value;
+    set_field(FIELD_CONJUGATION_TYPE, value);
   }
 
   inline const std::string Node::get_originalForm() const {
-    return originalForm;
+    return std::string(field_view(FIELD_ORIGINAL_FORM));
   }
 
   inline void Node::set_originalForm(std::string value) {
-    originalForm = value;
+    set_field(FIELD_ORIGINAL_FORM, value);
   }
 
   inline const std::string Node::get_yomi() const {
-    return yomi;
+    return std::string(field_view(FIELD_YOMI));
   }
 
   inline void Node::set_yomi(std::string value) {
-    yomi = value;
+    set_field(FIELD_YOMI, value);
   }
 
   inline const std::string Node::get_pronunciation() const {
-    return pronunciation;
+    return std::string(field_view(FIELD_PRONUNCIATION));
   }
 
   inline void Node::set_pronunciation(std::string value) {
-    pronunciation = value;
+    set_field(FIELD_PRONUNCIATION, value);
   }
 
 }
@@ -11,6 +11,7 @@
 
 #include <string>
 #include <vector>
+#include <utility>
 #include "Node.h"
 #include "PHBSDefs.h"
 #include "Suffix.h"
@@ -48,12 +49,23 @@ namespace geonlp
 
                 /// 地名語に後続しない語となり得るか。
                 bool bStop;
+
+	  /// 表層形を標準化した文字列（bStandardized==trueの場合）
+	  std::string standardized_surface;
+
+	  /// 標準化した文字列を設定済みか。
+	  bool bStandardized;
 		
 	public:
 		/// @brief コンストラクタ。
 		/// 
 		/// @arg @c node 形態素情報
-		NodeExt( const Node& node): Node(node), bHead(false), bBody(false), bPrefix(false), bSuffix(false), bSingle(false), bStop(false) {};
+		NodeExt( const Node& node): Node(node), bHead(false), bBody(false), bPrefix(false), bSuffix(false), bAntileader(false), bSingle(false), bAlternative(false), bStop(false), bStandardized(false) {};
+
+		/// @brief コンストラクタ。形態素情報を複製せずに移動する。
+		/// 
+		/// @arg @c node 形態素情報
+		NodeExt( Node&& node): Node(std::move(node)), bHead(false), bBody(false), bPrefix(false), bSuffix(false), bAntileader(false), bSingle(false), bAlternative(false), bStop(false), bStandardized(false) {};
 		
 		// 形態素が地名語のどの部分になり得るか判定する。
 		void evaluatePossibility(const PHBSDefs& phbsdef, bool nextIsHead);
@@ -104,6 +116,17 @@ namespace geonlp
 	  /// @retval "人名"など、の併記する文字列。
 	  std::string getAlternativeValue(const PHBSDefs& phbsdef) const;
 		
+	  /// @brief 表層形を標準化した文字列を設定済みか。
+	  inline bool hasStandardizedSurface() const { return bStandardized; }
+
+	  /// @brief 表層形を標準化した文字列を得る。(hasStandardizedSurface()==trueの場合)
+	  inline const std::string& get_standardized_surface() const { return standardized_surface; }
+
+	  /// @brief 表層形を標準化した文字列を設定する。
+	  ///
+	  /// 形態素ごとに一度だけ標準化し、同じ形態素を含む地名語候補区間で再利用する。
+	  inline void set_standardized_surface(const std::string& s) { standardized_surface = s; bStandardized = true; }
+
 		/// @brief 対応する地名接尾辞を得る。(bSuffix==trueの場合)
 		inline const Suffix get_suffix() const { return suffix;};
 		
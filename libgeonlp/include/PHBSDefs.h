@@ -12,6 +12,8 @@
 #include <string>
 #include <vector>
 #include <stdexcept>
+#include <boost/shared_ptr.hpp>
+#include "darts.h"
 #include "Profile.h"
 #include "Suffix.h"
 
@@ -22,6 +24,22 @@ namespace geonlp
   /// @brief 地名接頭辞集合、地名語の先頭となり得る品詞集合、地名語の部分となり得る品詞集合等を定義するクラス。
   /// 
   struct PHBSDefs {
+
+    /// @brief 品詞集合による分類のビット
+    enum {
+      POS_HEAD        = 1 << 0,  ///< heads に含まれる
+      POS_BODY        = 1 << 1,  ///< bodies に含まれる
+      POS_EXTSINGLE   = 1 << 2,  ///< extsingle に含まれる
+      POS_ALTERNATIVE = 1 << 3,  ///< alternatives に含まれる
+      POS_STOPPER     = 1 << 4,  ///< stoppers に含まれる
+      POS_ANTILEADER  = 1 << 5   ///< antileaders に含まれる
+    };
+
+    /// @brief MeCab の品詞IDに対応する素性と分類
+    struct PosClass {
+      std::string prefix;   ///< 品詞から品詞細分類３までの素性と末尾の ","、表を利用できない場合は空文字列
+      unsigned int flags;   ///< 品詞集合による分類のビット
+    };
 		
     /// @brief 地名接尾辞集合
     /// プロファイルから読み込み
@@ -53,11 +71,56 @@ namespace geonlp
     /// @brief 地名語に先行しない品詞集合
     std::vector<std::string> antileaders;
 
+    /// @brief MeCab の品詞IDをインデックスとする、素性と分類の表
+    /// readProfile() で作成
+    std::vector<PosClass> posClasses;
+
     /// @brief コンストラクタ。
     PHBSDefs();
 		
     // プロファイルの読み込み。
     void readProfile(const Profile& profile);
+
+    // 素性を品詞集合と比較して分類する。
+    unsigned int classify(const std::string& feature) const;
+
+    // 品詞IDの表を利用して素性を分類する。
+    unsigned int classify(const std::string& feature, int posid) const;
+
+    // 表層形の末尾に一致する地名接尾辞を探す。
+    int findSuffix(const std::string& surface) const;
+
+    // 表層形が空間語に一致するか判定する。
+    bool isSpatial(const std::string& surface) const;
+
+    // 表層形が単独で地名語にならない語から始まるか判定する。
+    bool isNonGeoword(const std::string& surface) const;
+
+  private:
+    /// @brief 地名接尾辞の表層形をバイト単位で逆順にした darts、値は suffixes の添字
+    /// readProfile() で作成、接尾辞が無い場合は NULL
+    boost::shared_ptr<Darts::DoubleArray> suffixTrie;
+
+    /// @brief 空間語の darts、値は spatials の添字
+    boost::shared_ptr<Darts::DoubleArray> spatialTrie;
+
+    /// @brief 単独で地名語にならない語の darts、値は non_geowords の添字
+    boost::shared_ptr<Darts::DoubleArray> nonGeowordTrie;
+
+    /// 表層形が空文字列の地名接尾辞の添字、無い場合は -1
+    int emptySuffix;
+
+    /// 空間語に空文字列を含む場合は true
+    bool emptySpatial;
+
+    /// 単独で地名語にならない語に空文字列を含む場合は true
+    bool emptyNonGeoword;
+
+    // IPA 辞書の品詞IDから posClasses を作成する。
+    void buildPosClasses();
+
+    // 地名接尾辞、空間語、単独で地名語にならない語の darts を作成する。
+    void buildTries();
   };
 }
 #endif
@@ -0,0 +1,121 @@
+///
+/// @file
+/// @brief 文の解析結果のキャッシュクラス ParseCache の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _PARSE_CACHE_H
+#define _PARSE_CACHE_H
+
+#include <string>
+#include <list>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <boost/shared_ptr.hpp>
+#include "Node.h"
+#include "MemoryBudget.h"
+
+/// キャッシュのシャード数
+#define PARSE_CACHE_SHARDS  16
+
+namespace geonlp
+{
+  ///
+  /// @brief 文と ActiveFilter の世代番号をキーとする parseNode() の結果の LRU キャッシュ。
+  ///
+  /// 世代番号はアクティブな辞書/クラスや期間、インデックスを変更するたびに変わるため、
+  /// 古い設定での結果は参照されずに追い出される。
+  /// キーのハッシュ値でシャードに分割し、シャードごとに排他制御を行うため
+  /// 複数スレッドから同時に参照してもよい。
+  /// 結果はシャードのロックの中で複製して返すので、呼び出し側は自由に変更してよい。
+  /// MemoryBudget を設定した場合、結果の推定バイト数を計上し、
+  /// 予算を超えている間は最も長く参照されていない結果から追い出す。
+  ///
+  class ParseCache {
+  public:
+    /// @brief キャッシュの利用状況
+    struct Stats {
+      size_t size;      ///< 保持している文の数
+      size_t capacity;  ///< 最大保持数
+      size_t bytes;     ///< 保持している結果の推定バイト数
+      Stats(): size(0), capacity(0), bytes(0) {}
+    };
+
+  private:
+    /// @brief キー、 ActiveFilter の世代番号と文
+    typedef std::pair<unsigned long, std::string> Key;
+    struct KeyHash {
+      size_t operator()(const Key& key) const {
+        return std::hash<std::string>()(key.second) ^ (std::hash<unsigned long>()(key.first) * 31);
+      }
+    };
+
+    /// @brief 保持する結果と推定バイト数
+    struct Entry {
+      Key key;
+      std::vector<Node> nodes;
+      size_t bytes;
+      Entry(const Key& key, const std::vector<Node>& nodes): key(key), nodes(nodes), bytes(0) {}
+    };
+
+    typedef std::list<Entry> LruList;
+    typedef std::unordered_map<Key, LruList::iterator, KeyHash> LruIndex;
+
+    /// @brief シャード、先頭が最近参照された結果
+    struct Shard {
+      std::mutex mutex;
+      LruList lru;
+      LruIndex index;
+      size_t bytes;
+      Shard(): bytes(0) {}
+    };
+
+    /// シャードごとの最大保持数
+    size_t shard_capacity;
+
+    Shard shards[PARSE_CACHE_SHARDS];
+
+    /// 推定バイト数を計上するメモリ予算、計上しない場合は NULL
+    MemoryBudget* budget;
+
+    inline Shard& shardFor(const Key& key) {
+      return shards[KeyHash()(key) % PARSE_CACHE_SHARDS];
+    }
+
+    // 結果を保持する場合の推定バイト数
+    static size_t estimateEntrySize(const Entry& entry);
+
+    // シャードの最も長く参照されていない結果を追い出す
+    void evictOldest(Shard& shard);
+
+    // コピー禁止
+    ParseCache(const ParseCache&);
+    ParseCache& operator=(const ParseCache&);
+
+  public:
+    // コンストラクタ
+    ParseCache(size_t capacity);
+
+    /// @brief 推定バイト数を計上するメモリ予算を設定する、結果を登録する前に設定すること
+    inline void setMemoryBudget(MemoryBudget* b) { this->budget = b; }
+
+    // 結果をキャッシュから取得する
+    bool get(unsigned long generation, const std::string& sentence, std::vector<Node>& ret);
+
+    // 結果をキャッシュに登録する
+    void put(unsigned long generation, const std::string& sentence, const std::vector<Node>& nodes);
+
+    // キャッシュを空にする
+    void clear(void);
+
+    // 利用状況を取得する
+    Stats getStats(void);
+  };
+
+  typedef boost::shared_ptr<ParseCache> ParseCachePtr;
+}
+#endif /* _PARSE_CACHE_H */
@@ -0,0 +1,123 @@
+///
+/// @file
+/// @brief ラティス表現からスコアの高いパスをビームサーチで求める PathSearch の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _PATH_SEARCH_H
+#define _PATH_SEARCH_H
+
+#include <vector>
+#include <map>
+#include <functional>
+
+namespace geonlp
+{
+  /// @brief ラティスの一つの位置にあるノード候補の特徴
+  struct PathNode {
+    /// @brief ノードの種別、 pygeonlp.api.node.Node の定数と同じ値
+    enum {
+      NORMAL  = 0,  ///< 地名語でも住所でもないノード
+      GEOWORD = 1,  ///< 地名語ノード
+      ADDRESS = 2   ///< 住所ノード
+    };
+
+    int type;             ///< ノードの種別
+    size_t next;          ///< このノードを選んだ場合に次に選ぶ位置
+    int ne_class;         ///< 地名語の固有名クラスの番号、地名語以外は -1
+    int address_levels;   ///< 住所の階層数、住所以外は 0
+
+    PathNode(): type(NORMAL), next(0), ne_class(-1), address_levels(0) {}
+    PathNode(int type, size_t next, int ne_class, int address_levels):
+      type(type), next(next), ne_class(ne_class), address_levels(address_levels) {}
+  };
+
+  /// @brief 探索したパス
+  struct PathResult {
+    int score;                                        ///< パスのスコア
+    std::vector<std::pair<size_t, size_t> > nodes;    ///< 選んだノードの (位置, 候補の番号) の列
+
+    PathResult(): score(0) {}
+  };
+
+  /// @brief 二つのノード候補の関係によるスコアを計算する関数。
+  ///
+  /// (位置, 候補の番号) で指定した二つのノードを受け取り、スコアを返す。
+  typedef std::function<int(size_t pos0, size_t index0, size_t pos1, size_t index1)> RelationScoreFunc;
+
+  ///
+  /// @brief ラティス表現からスコアの高いパスをビームサーチで求めるクラス。
+  ///
+  /// pygeonlp.api.scoring.ScoringClass.path_score() と同じ規則でパスのスコアを計算する。
+  /// - 地名語でも住所でもないノードは +1 点
+  /// - 住所ノードは +階層数 × 10 点
+  /// - 2 回以上出現する地名語の固有名クラスは +出現回数 × 10 点
+  /// - 地名語・住所ノードの組のうち、先頭から nlookup 組と隣り合う組は関係によるスコアを加算
+  ///
+  /// 位置の昇順にパスを延ばし、位置ごとにスコアの高い beam_width 個の途中経過だけを残す。
+  /// ノード間のスコアは必要になった組についてのみ計算し、記憶して再利用する。
+  /// 計算量はラティスの長さ × beam_width × 候補数に比例する。
+  ///
+  class PathSearch {
+  private:
+    /// 探索中の途中経過
+    struct State;
+
+    /// パスを遡るための選択の記録
+    struct Step {
+      size_t pos;    ///< 位置
+      size_t index;  ///< 候補の番号
+      int parent;    ///< 一つ前の選択、先頭の場合は -1
+    };
+
+    /// ラティス
+    const std::vector<std::vector<PathNode> >& lattice;
+
+    /// ノード間のスコアを計算する関数
+    RelationScoreFunc relation;
+
+    /// 関係によるスコアを計算する組の数
+    int nlookup;
+
+    /// 位置ごとに残す途中経過の数
+    size_t beam_width;
+
+    /// 選択の記録
+    std::vector<Step> steps;
+
+    /// 計算済みのノード間のスコア
+    std::map<std::pair<std::pair<size_t, size_t>, std::pair<size_t, size_t> >, int> relation_memo;
+
+    // 途中経過をスコアの降順に並べる
+    static bool isBetterState(const State* a, const State* b);
+
+    // 記憶したスコアを利用してノード間のスコアを得る
+    int relationScore(const std::pair<size_t, size_t>& node0, const std::pair<size_t, size_t>& node1);
+
+    // 途中経過にノードを追加する
+    void extend(const State& state, size_t pos, size_t index, State& ret);
+
+    // パスの末尾で、残りの組の関係によるスコアを加算する
+    int finalScore(const State& state);
+
+    // コピー禁止
+    PathSearch(const PathSearch&);
+    PathSearch& operator=(const PathSearch&);
+
+  public:
+    /// @brief コンストラクタ
+    /// @arg @c lattice    位置ごとのノード候補の特徴
+    /// @arg @c relation   ノード間のスコアを計算する関数
+    /// @arg @c nlookup    関係によるスコアを計算する組の数（ScoringClass の options）
+    /// @arg @c beam_width 位置ごとに残す途中経過の数
+    PathSearch(const std::vector<std::vector<PathNode> >& lattice, RelationScoreFunc relation,
+               int nlookup, size_t beam_width):
+      lattice(lattice), relation(relation), nlookup(nlookup), beam_width(beam_width > 0 ? beam_width : 1) {}
+
+    // スコアの高いパスを求める
+    void search(size_t max_results, std::vector<PathResult>& results);
+  };
+}
+#endif /* _PATH_SEARCH_H */
@@ -15,6 +15,7 @@
 #include <stdexcept>
 #include <boost/regex.hpp>
 #include "Suffix.h"
+#include "GeowordCache.h"
 #include "picojson.h"
 
 #ifdef HAVE_LIBDAMS
@@ -24,6 +25,12 @@
 /// @brief プロファイル定義ファイルのファイル名は、プロファイル名にこの拡張子を付加したもの。
 #define PROFILE_FILE_EXT ".rc"
 
+/// @brief 参照専用の場合に SQLite が mmap するデフォルトの大きさ（MB）
+#define SQLITE_MMAP_SIZE  256
+
+/// @brief 参照専用の場合の SQLite のデフォルトのページキャッシュの大きさ（MB）
+#define SQLITE_CACHE_SIZE  64
+
 namespace geonlp {
 	
   class Profile {
@@ -45,6 +52,21 @@ namespace geonlp {
     std::string data_dir;
     std::string system_dic_dir;
     std::string log_dir;
+    bool darts_mmap;
+    size_t geoword_cache_size;
+    size_t parse_cache_size;
+    unsigned int index_build_threads;
+    size_t index_build_memory;
+    unsigned int import_threads;
+    bool import_fast;
+    bool geoword_record;
+    std::string bundle;
+    bool stats;
+    bool read_only;
+    bool in_memory;
+    size_t sqlite_mmap_size;
+    size_t sqlite_cache_size;
+    size_t memory_budget;
 #ifdef HAVE_LIBDAMS
     std::string dams_path;
 #endif /* HAVE_LIBDAMS */
@@ -54,7 +76,7 @@ namespace geonlp {
     // デフォルトプロファイルパスを探す
     static std::string searchProfile(const std::string& basename = PACKAGE_NAME);
 		
-    Profile() {}
+    Profile(): darts_mmap(true), geoword_cache_size(GEOWORD_CACHE_SIZE), parse_cache_size(0), index_build_threads(1), index_build_memory(0), import_threads(1), import_fast(false), geoword_record(false), bundle(""), stats(false), read_only(false), in_memory(false), sqlite_mmap_size(SQLITE_MMAP_SIZE), sqlite_cache_size(SQLITE_CACHE_SIZE), memory_budget(0) {}
     
     void load(const std::string& f);
     void load(const picojson::value& v);
@@ -133,6 +155,84 @@ namespace geonlp {
       return log_dir;
     }
 		
+    /// @brief darts ファイルを mmap で開くかどうか
+    inline bool get_darts_mmap() const {
+      return darts_mmap;
+    }
+
+    /// @brief 地名語キャッシュの最大保持数
+    inline size_t get_geoword_cache_size() const {
+      return geoword_cache_size;
+    }
+
+    /// @brief 解析結果を記憶する文の最大数（0 の場合は記憶しない）
+    inline size_t get_parse_cache_size() const {
+      return parse_cache_size;
+    }
+
+    /// @brief インデックス構築時に地名語を解析するスレッド数（0 の場合は CPU 数）
+    inline unsigned int get_index_build_threads() const {
+      return index_build_threads;
+    }
+
+    /// @brief インデックス構築時にメモリ上に保持する見出し語の上限（MB、0 の場合は無制限）
+    inline size_t get_index_build_memory() const {
+      return index_build_memory;
+    }
+
+    /// @brief 辞書 CSV の読み込み時に地名語を変換するスレッド数（0 の場合は CPU 数）
+    inline unsigned int get_import_threads() const {
+      return import_threads;
+    }
+
+    /// @brief 辞書の読み込み中はジャーナルと同期書き込みを止めるかどうか
+    inline bool get_import_fast() const {
+      return import_fast;
+    }
+
+    /// @brief 地名語の主要項目をバイナリレコードとしても保存するかどうか
+    inline bool get_geoword_record() const {
+      return geoword_record;
+    }
+
+    /// @brief 参照に利用する辞書バンドルファイル名、空の場合は SQLite を参照する
+    /// 相対パスの場合は data_dir からの相対パスとする
+    inline const std::string get_bundle_file() const {
+      if (bundle.empty() || bundle.at(0) == '/') return bundle;
+      return this->get_data_dir() + bundle;
+    }
+
+    /// @brief 処理ごとの呼び出し回数や時間を計測するかどうか
+    inline bool get_stats() const {
+      return stats;
+    }
+
+    /// @brief DB を変更しない参照専用のファイルとして開くかどうか
+    /// in_memory が true の場合も参照専用とする
+    inline bool get_read_only() const {
+      return read_only || in_memory;
+    }
+
+    /// @brief DB ファイルの内容をメモリに読み込み、ファイルの代わりに参照するかどうか
+    inline bool get_in_memory() const {
+      return in_memory;
+    }
+
+    /// @brief 参照専用の場合に SQLite が mmap する大きさ（MB、0 の場合は mmap しない）
+    inline size_t get_sqlite_mmap_size() const {
+      return sqlite_mmap_size;
+    }
+
+    /// @brief 参照専用の場合の SQLite のページキャッシュの大きさ（MB）
+    inline size_t get_sqlite_cache_size() const {
+      return sqlite_cache_size;
+    }
+
+    /// @brief キャッシュと SQLite が共有するメモリ予算（MB、0 の場合は制限しない）
+    inline size_t get_memory_budget() const {
+      return memory_budget;
+    }
+
     inline const std::string get_sqlite3_file() const {
       return this->get_data_dir() + "geodic.sq3";
     }
@@ -0,0 +1,178 @@
+///
+/// @file
+/// @brief 地名語の経緯度で空間検索する SpatialIndex と検索範囲 GeoRegion の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _SPATIAL_INDEX_H
+#define _SPATIAL_INDEX_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <boost/shared_ptr.hpp>
+#include "picojsonExt.h"
+#include "DartsException.h"
+#include "Geoword.h"
+
+/// 空間インデックスファイルの形式の版、形式を変更した場合は増やす
+#define SPATIAL_INDEX_VERSION  2
+
+/// 有効期間を持たない古い形式の版
+#define SPATIAL_INDEX_VERSION_V1  1
+
+namespace geonlp
+{
+  /// @brief 空間インデックスに記録する地名語の地点
+  struct SpatialPoint {
+    double latitude;        ///< 緯度
+    double longitude;       ///< 経度
+    int dictionary_id;      ///< 辞書の内部 ID
+    unsigned int ne_class;  ///< 固有名クラスの番号（SpatialIndex::getClass() で文字列を得る）
+    std::string geonlp_id;  ///< 地名語ID
+    int valid_from;         ///< 有効期間の開始日（Geoword::getValidPeriod による値）
+    int valid_to;           ///< 有効期間の終了日
+
+    SpatialPoint(): latitude(0.0), longitude(0.0), dictionary_id(0), ne_class(0),
+                    valid_from(GEOWORD_DATE_MIN), valid_to(GEOWORD_DATE_MAX) {}
+  };
+
+  // 地名語の緯度、経度の文字列を数値に変換する
+  bool parseLatLon(const std::string& latitude, const std::string& longitude, double& lat, double& lon);
+
+  ///
+  /// @brief GeoJSON の Polygon または MultiPolygon で表した検索範囲。
+  ///
+  /// 穴（内側のリング）を持つポリゴンにも対応する。
+  /// 点が範囲に含まれるかどうかは外接矩形で絞り込んでから even-odd 規則で判定する。
+  ///
+  class GeoRegion {
+  private:
+    /// (経度, 緯度) の列で表したリング
+    typedef std::vector<std::pair<double, double> > Ring;
+
+    /// ポリゴンのリスト、各ポリゴンは外側のリングと内側のリングの列
+    std::vector<std::vector<Ring> > polygons;
+
+    /// 外接矩形
+    double min_lat, min_lon, max_lat, max_lon;
+
+    // GeoJSON の座標配列からリングを読み込む
+    void addRing(const picojson::value& coordinates, std::vector<Ring>& polygon);
+
+    // GeoJSON の座標配列からポリゴンを読み込む
+    void addPolygon(const picojson::value& coordinates);
+
+  public:
+    /// @brief コンストラクタ、空の範囲を作る
+    GeoRegion(): min_lat(0.0), min_lon(0.0), max_lat(-1.0), max_lon(-1.0) {}
+
+    // GeoJSON の geometry, Feature, FeatureCollection から範囲を設定する
+    void setGeoJSON(const picojson::value& geojson);
+
+    // 点が範囲に含まれるかどうか
+    bool contains(double lat, double lon) const;
+
+    /// @brief 外接矩形の南端の緯度
+    inline double getMinLatitude(void) const { return this->min_lat; }
+
+    /// @brief 外接矩形の西端の経度
+    inline double getMinLongitude(void) const { return this->min_lon; }
+
+    /// @brief 外接矩形の北端の緯度
+    inline double getMaxLatitude(void) const { return this->max_lat; }
+
+    /// @brief 外接矩形の東端の経度
+    inline double getMaxLongitude(void) const { return this->max_lon; }
+  };
+
+  ///
+  /// @brief 地名語の経緯度による空間インデックス。
+  ///
+  /// 地点を経度と緯度で交互に分割する k-d 木の順に配列に並べて保持し、
+  /// 矩形に含まれる地点を木をたどって列挙する。
+  /// 地名語IDからも地点を引けるように、地名語IDの順の添字も保持する。
+  ///
+  /// インデックスの全体を構築する際に DBAccessor が作成してファイルに保存し、
+  /// MA はインデックスを開く際にメモリに読み込む。
+  /// 差分更新で追加・削除された辞書の地点は古い内容なので、
+  /// setStaleDictionaries() で除外して利用側で別に扱う。
+  ///
+  /// 読み込んだ後は変更しないため、複数のスレッドからロックなしで参照してよい。
+  ///
+  class SpatialIndex {
+  private:
+    /// 固有名クラスの文字列、番号の順
+    std::vector<std::string> classes;
+
+    /// 固有名クラスの文字列から番号を得る表（構築時のみ利用）
+    std::map<std::string, unsigned int> class_ids;
+
+    /// 地点、 build() の後は k-d 木の順
+    std::vector<SpatialPoint> points;
+
+    /// 地名語ID順に並べた points の添字
+    std::vector<unsigned int> id_order;
+
+    /// 差分更新で変更された辞書の内部 ID
+    std::set<int> stale_dictionaries;
+
+    /// 地名語の有効期間を記録しているかどうか、古い形式のファイルから読み込んだ場合は false
+    bool has_periods;
+
+    // k-d 木を構築する
+    void buildTree(size_t begin, size_t end, unsigned int depth);
+
+    // k-d 木をたどって矩形に含まれる地点を集める
+    void searchTree(size_t begin, size_t end, unsigned int depth,
+      double min_lat, double min_lon, double max_lat, double max_lon,
+      std::vector<const SpatialPoint*>& ret) const;
+
+  public:
+    /// @brief コンストラクタ、空のインデックスを作る
+    SpatialIndex(): has_periods(true) {}
+
+    // 固有名クラスの番号を得る、新しいクラスの場合は番号を割り当てる
+    unsigned int internClass(const std::string& ne_class);
+
+    /// @brief 地点を追加する、検索する前に build() を呼ぶこと
+    inline void addPoint(const SpatialPoint& point) { this->points.push_back(point); }
+
+    // k-d 木と地名語IDの添字を構築する
+    void build(void);
+
+    // ファイルに保存する
+    void save(const std::string& filename) const;
+
+    // ファイルから読み込む
+    bool load(const std::string& filename);
+
+    /// @brief 地名語の有効期間を記録しているかどうか
+    inline bool hasPeriods(void) const { return this->has_periods; }
+
+    /// @brief 差分更新で変更された辞書の内部 ID を設定する
+    inline void setStaleDictionaries(const std::set<int>& ids) { this->stale_dictionaries = ids; }
+
+    /// @brief 地点の数
+    inline size_t size(void) const { return this->points.size(); }
+
+    // 確保しているメモリのバイト数を見積もる
+    size_t estimateMemorySize(void) const;
+
+    // 矩形に含まれる地点を取得する
+    void searchBox(double min_lat, double min_lon, double max_lat, double max_lon, std::vector<const SpatialPoint*>& ret) const;
+
+    // 地名語IDから地点を取得する
+    const SpatialPoint* findPoint(const std::string& geonlp_id) const;
+
+    /// @brief 固有名クラスの文字列を取得する
+    /// @arg @c ne_class 固有名クラスの番号
+    inline const std::string& getClass(unsigned int ne_class) const { return this->classes[ne_class]; }
+  };
+
+  typedef boost::shared_ptr<const SpatialIndex> SpatialIndexPtr;
+}
+#endif /* _SPATIAL_INDEX_H */
@@ -0,0 +1,108 @@
+///
+/// @file
+/// @brief 表記を標準化した文字列のキャッシュクラス StandardizedCache の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _STANDARDIZED_CACHE_H
+#define _STANDARDIZED_CACHE_H
+
+#include <string>
+#include <string_view>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "MemoryBudget.h"
+
+/// キャッシュのシャード数
+#define STANDARDIZED_CACHE_SHARDS  16
+
+namespace geonlp
+{
+  ///
+  /// @brief 表記をキーとする、 DAMS で標準化した文字列の LRU キャッシュ。
+  ///
+  /// 標準化の結果は DB に依存しないため、世代番号を持たない。
+  /// キーのハッシュ値でシャードに分割し、シャードごとに排他制御を行うため
+  /// 複数スレッドから同時に参照してもよい。
+  /// MemoryBudget を設定した場合、要素の推定バイト数を計上し、
+  /// 予算を超えている間は最も長く参照されていない要素から追い出す。
+  ///
+  class StandardizedCache {
+  public:
+    /// @brief キャッシュの利用状況
+    struct Stats {
+      size_t size;      ///< 保持している表記の数
+      size_t capacity;  ///< 最大保持数
+      size_t bytes;     ///< 保持している要素の推定バイト数
+      Stats(): size(0), capacity(0), bytes(0) {}
+    };
+
+  private:
+    /// @brief 保持する要素と推定バイト数
+    struct Item {
+      std::string surface;
+      std::string standardized;
+      size_t bytes;
+      Item(const std::string& surface, const std::string& standardized):
+        surface(surface), standardized(standardized), bytes(0) {}
+    };
+
+    typedef std::list<Item> LruList;
+    /// 索引のキーは LRU リストの要素の surface を指す
+    typedef std::unordered_map<std::string_view, LruList::iterator> LruIndex;
+
+    /// @brief シャード、先頭が最近参照された要素
+    struct Shard {
+      std::mutex mutex;
+      LruList lru;
+      LruIndex index;
+      size_t bytes;
+      Shard(): bytes(0) {}
+    };
+
+    /// シャードごとの最大保持数
+    size_t shard_capacity;
+
+    Shard shards[STANDARDIZED_CACHE_SHARDS];
+
+    /// 推定バイト数を計上するメモリ予算、計上しない場合は NULL
+    MemoryBudget* budget;
+
+    inline Shard& shardFor(std::string_view surface) {
+      return shards[std::hash<std::string_view>()(surface) % STANDARDIZED_CACHE_SHARDS];
+    }
+
+    // 要素を保持する場合の推定バイト数
+    static size_t estimateItemSize(const Item& item);
+
+    // シャードの最も長く参照されていない要素を追い出す
+    void evictOldest(Shard& shard);
+
+    // コピー禁止
+    StandardizedCache(const StandardizedCache&);
+    StandardizedCache& operator=(const StandardizedCache&);
+
+  public:
+    // コンストラクタ
+    StandardizedCache(size_t capacity);
+
+    /// @brief 推定バイト数を計上するメモリ予算を設定する、要素を登録する前に設定すること
+    inline void setMemoryBudget(MemoryBudget* b) { this->budget = b; }
+
+    // 標準化した文字列をキャッシュから取得する
+    bool get(const std::string& surface, std::string& ret);
+
+    // 標準化した文字列をキャッシュに登録する
+    void put(const std::string& surface, const std::string& standardized);
+
+    // キャッシュを空にする
+    void clear(void);
+
+    // 利用状況を取得する
+    Stats getStats(void);
+  };
+}
+#endif /* _STANDARDIZED_CACHE_H */
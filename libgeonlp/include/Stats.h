@@ -0,0 +1,132 @@
+///
+/// @file
+/// @brief 処理ごとの計測値を集計するクラス StatsCollector の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <string>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <boost/shared_ptr.hpp>
+
+namespace geonlp
+{
+  /// @brief 計測する処理の種類
+  enum StatsCounter {
+    STATS_PARSE_NODE = 0,     ///< MAImpl::parseNode 全体、rows は出力したノード数
+    STATS_MECAB,              ///< MeCab による形態素解析、rows は形態素数
+    STATS_PHBS,               ///< NodeExt::evaluatePossibility による地名語候補の評価
+    STATS_DARTS,              ///< Darts の前方一致検索、rows は一致した見出し語数
+    STATS_SPATIAL,            ///< 空間インデックスの検索、rows はアクティブな地点数
+    STATS_SQLITE,             ///< SQLite の statement の実行、rows は取得した行数
+    STATS_JSON_DECODE,        ///< 地名語 JSON の解析
+    STATS_RECORD_DECODE,      ///< 地名語のバイナリレコードの復元
+    STATS_GEOWORD_CACHE,      ///< 地名語キャッシュの参照
+    STATS_GEOWORD_NODE_CACHE, ///< 見出し語ごとの地名語ノードのキャッシュの参照
+    STATS_PARSE_CACHE,        ///< 文ごとの解析結果のキャッシュの参照
+    STATS_PYTHON,             ///< 解析結果の Python オブジェクトへの変換、rows は変換したノード数
+    NUM_STATS_COUNTERS
+  };
+
+  /// @brief 一つの処理の計測値
+  struct StatsEntry {
+    unsigned long long calls;   ///< 呼び出し回数
+    unsigned long long ns;      ///< 累積時間（ナノ秒）
+    unsigned long long hits;    ///< キャッシュのヒット数
+    unsigned long long misses;  ///< キャッシュのミス数
+    unsigned long long rows;    ///< 処理した件数
+    StatsEntry(): calls(0), ns(0), hits(0), misses(0), rows(0) {}
+  };
+
+  ///
+  /// @brief 処理ごとの呼び出し回数、累積時間、キャッシュのヒット数などを集計するクラス。
+  ///
+  /// 値は std::atomic で保持するため、複数のスレッドから同時に加算してよい。
+  /// プロファイルの stats が false の場合は作成されず、
+  /// 計測箇所は StatsCollector へのポインタが NULL であることだけを確認する。
+  ///
+  class StatsCollector {
+  private:
+    enum { CALLS = 0, NS, HITS, MISSES, ROWS, NUM_FIELDS };
+
+    std::atomic<unsigned long long> values[NUM_STATS_COUNTERS][NUM_FIELDS];
+
+    inline void add(StatsCounter c, int field, unsigned long long v) {
+      values[c][field].fetch_add(v, std::memory_order_relaxed);
+    }
+
+    // コピー禁止
+    StatsCollector(const StatsCollector&);
+    StatsCollector& operator=(const StatsCollector&);
+
+  public:
+    StatsCollector() { this->reset(); }
+
+    /// @brief 呼び出し 1 回分の時間と処理件数を加算する
+    inline void addCall(StatsCounter c, unsigned long long ns, unsigned long long rows = 0) {
+      add(c, CALLS, 1);
+      add(c, NS, ns);
+      if (rows > 0) add(c, ROWS, rows);
+    }
+
+    /// @brief 処理件数を加算する
+    inline void addRows(StatsCounter c, unsigned long long rows) { add(c, ROWS, rows); }
+
+    /// @brief キャッシュのヒットまたはミスを加算する
+    inline void addCacheLookup(StatsCounter c, bool hit) { add(c, hit ? HITS : MISSES, 1); }
+
+    // 処理の名前
+    static const char* getName(StatsCounter c);
+
+    // 計測値を取得する
+    StatsEntry get(StatsCounter c) const;
+
+    // 全ての計測値を処理の名前をキーとするマップとして取得する
+    void getAll(std::map<std::string, StatsEntry>& ret) const;
+
+    // 全ての計測値を 0 に戻す
+    void reset(void);
+  };
+
+  typedef boost::shared_ptr<StatsCollector> StatsCollectorPtr;
+
+  ///
+  /// @brief スコープの間の時間を計測して StatsCollector に加算するクラス。
+  ///
+  /// StatsCollector が NULL の場合は時刻も取得しない。
+  ///
+  class StatsTimer {
+  private:
+    StatsCollector* stats;
+    StatsCounter counter;
+    unsigned long long rows;
+    std::chrono::steady_clock::time_point start;
+
+    StatsTimer(const StatsTimer&);
+    StatsTimer& operator=(const StatsTimer&);
+
+  public:
+    StatsTimer(StatsCollector* s, StatsCounter c): stats(s), counter(c), rows(0) {
+      if (stats) start = std::chrono::steady_clock::now();
+    }
+
+    ~StatsTimer() {
+      if (stats) {
+        std::chrono::steady_clock::duration d = std::chrono::steady_clock::now() - start;
+        stats->addCall(counter, std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(), rows);
+      }
+    }
+
+    /// @brief スコープを抜けるときに加算する処理件数を設定する
+    inline void setRows(unsigned long long n) { rows = n; }
+  };
+
+}
+
+#endif /* _STATS_H */
@@ -11,12 +11,53 @@
 #define _WORDLIST_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <sstream>
+#include <algorithm>
+#include <functional>
 #include "picojson.h"
+#include "Geoword.h"
 
 namespace geonlp
 {
+  /// @brief インデックス構築の進捗を受け取る関数。
+  ///
+  /// 段階名（"scan": 地名語の解析, "merge": 見出し語の併合, "darts": darts の構築）と
+  /// 処理済みの件数、全体の件数を受け取る。
+  typedef std::function<void(const std::string& phase, size_t done, size_t total)> IndexProgressCallback;
+
+  /// @brief 地名語IDリストの要素をデコードしたもの。
+  struct WordlistEntry {
+    long long rowid;        ///< geoword テーブルの rowid
+    int dictionary_id;      ///< 辞書の内部 ID
+    std::string geonlp_id;  ///< 地名語ID
+    /// 地名語の全ての表記（接頭辞、語幹、接尾辞の組み合わせ）を標準化した文字列の
+    /// Wordlist::hashSurface による値（昇順）、古い形式のデータベースから読み込んだ場合は空
+    std::vector<unsigned long long> surface_hashes;
+    /// 地名語の有効期間（Geoword::getValidPeriod による値）、
+    /// 古い形式のデータベースや辞書バンドルから読み込んだ場合は has_period が false
+    int valid_from;
+    int valid_to;
+    bool has_period;
+
+    WordlistEntry(): rowid(0), dictionary_id(0), geonlp_id(""),
+                     valid_from(GEOWORD_DATE_MIN), valid_to(GEOWORD_DATE_MAX), has_period(false) {}
+    WordlistEntry(long long r, int d, const std::string& g): rowid(r), dictionary_id(d), geonlp_id(g),
+                     valid_from(GEOWORD_DATE_MIN), valid_to(GEOWORD_DATE_MAX), has_period(false) {}
+
+    /// @brief 表記のハッシュ値を持つかどうか
+    inline bool hasSurfaceHashes(void) const { return !surface_hashes.empty(); }
+
+    /// @brief 地名語の有効期間を設定する
+    inline void setPeriod(int from, int to) { valid_from = from; valid_to = to; has_period = true; }
+
+    /// @brief 標準化した表記のハッシュ値が地名語の表記のいずれかに一致するかどうか
+    inline bool hasSurfaceHash(unsigned long long h) const {
+      return std::binary_search(surface_hashes.begin(), surface_hashes.end(), h);
+    }
+  };
+
   /// 地名語IDリストのエントリを表すクラス。
   class Wordlist {
 
@@ -38,6 +79,10 @@ namespace geonlp
     /// 読み
     std::string yomi;
 
+    /// デコード済みの地名語IDリスト、 idlist と同じ順序
+    /// 古い形式のデータベースから読み込んだ場合は空
+    std::vector<WordlistEntry> entries;
+
   public:
     /// コンストラクタ。
     Wordlist(): key(""), surface(""), idlist(""), yomi("") {}
@@ -77,6 +122,25 @@ namespace geonlp
     /// 読み を得る。
     inline const std::string get_yomi() const { return this->yomi; }
 
+    /// デコード済みの地名語IDリストを設定する。
+    inline void set_entries(const std::vector<WordlistEntry>& entries) { this->entries = entries; }
+
+    /// デコード済みの地名語IDリストを得る。
+    inline const std::vector<WordlistEntry>& get_entries() const { return this->entries; }
+
+    /// デコード済みの地名語IDリストをDB保存用のバイナリ表現に変換する
+    static void encodeEntries(const std::vector<WordlistEntry>& entries, std::string& blob);
+
+    /// DB保存用のバイナリ表現から地名語IDリストを復元する
+    /// 形式が正しくない場合は false を返す
+    static bool decodeEntries(const void* blob, size_t size, std::vector<WordlistEntry>& entries);
+
+    /// 標準化した表記のハッシュ値を得る（ファイルに保存するため、環境によらず同じ値を返す）
+    static unsigned long long hashSurface(std::string_view surface);
+
+    /// geonlp_id:代表表記/... 形式の文字列から geonlp_id を取り出す
+    static void parseIdlist(const std::string& idlist, std::vector<std::string>& geonlp_ids);
+
     /// デバグ用のテキスト表記を得る。
     inline std::string toString() const;
 
@@ -0,0 +1,121 @@
+///
+/// @file
+/// @brief 見出し語一覧の構築クラス WordlistBuilder の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _WORDLIST_BUILDER_H
+#define _WORDLIST_BUILDER_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <utility>
+#include <functional>
+#include "Geoword.h"
+#include "Wordlist.h"
+#include "GeowordCache.h"
+
+namespace geonlp
+{
+  /// @brief 地名語の表記一つ分の見出し語レコード。
+  ///
+  /// 見出し語, geoword テーブルの rowid, 地名語内の順序の順に並べると、
+  /// 同じ見出し語のレコードが全体を再構築した場合の idlist の順に並ぶ。
+  struct WordlistRecord {
+    std::string key;        ///< 見出し語（標準化した表記または読み）
+    std::string surface;    ///< 表記
+    std::string yomi;       ///< 読み
+    std::string id_name;    ///< geonlp_id:代表表記
+    WordlistEntry entry;    ///< 地名語IDリストの要素
+    unsigned int seq;       ///< 地名語内での順序
+
+    WordlistRecord(): seq(0) {}
+
+    /// @brief 見出し語が地名語の読みかどうか
+    ///
+    /// 読みのレコードと、標準化した表記が読みと一致する表記のレコードが該当する。
+    inline bool isYomi(void) const { return !yomi.empty() && key == yomi; }
+
+    /// @brief メモリ上で占めるおおよそのバイト数
+    inline size_t memorySize(void) const {
+      return sizeof(WordlistRecord) + key.capacity() + surface.capacity() + yomi.capacity() + id_name.capacity() + entry.geonlp_id.capacity()
+        + entry.surface_hashes.capacity() * sizeof(unsigned long long);
+    }
+  };
+
+  bool operator<(const WordlistRecord& a, const WordlistRecord& b);
+
+  // 地名語の全ての表記と読みを見出し語レコードとして追加する
+  void enumerateWordlistRecords(const Geoword& geo_in, const WordlistEntry& entry, std::vector<WordlistRecord>& records);
+
+  // 地名語がその読みを持つかどうか
+  bool hasGeowordYomi(const Geoword& geo_in, const std::string& yomi);
+
+  ///
+  /// @brief 地名語から見出し語一覧を作るクラス。
+  ///
+  /// 地名語 JSON （またはバイナリレコード）の解析は複数のスレッドで並列に行う。
+  /// 保持するレコードがメモリ上限を超えると、整列して一時ファイル（ラン）に書き出し、
+  /// 最後に全てのランを併合しながら見出し語を 1 件ずつ出力する。
+  /// そのため構築中のメモリ使用量は地名語数ではなくメモリ上限で決まる。
+  ///
+  class WordlistBuilder {
+  public:
+    /// 地名語の rowid と JSON またはバイナリレコードの組
+    typedef std::pair<long long, std::string> GeowordRow;
+
+  private:
+    /// 一時ファイル名の接頭辞
+    std::string tmp_prefix;
+
+    /// メモリ上に保持するレコードの上限バイト数、0 の場合は書き出さない
+    size_t memory_limit;
+
+    /// 解析に利用するスレッド数
+    unsigned int n_threads;
+
+    /// 書き出し前のレコード
+    std::vector<WordlistRecord> records;
+
+    /// records のおおよそのバイト数
+    size_t records_size;
+
+    /// 書き出したランのファイル名
+    std::vector<std::string> run_files;
+
+    /// 追加したレコード数
+    size_t num_records;
+
+    // 保持しているレコードを整列してランに書き出す
+    void spill(void);
+
+    // コピー禁止
+    WordlistBuilder(const WordlistBuilder&);
+    WordlistBuilder& operator=(const WordlistBuilder&);
+
+  public:
+    // コンストラクタ
+    WordlistBuilder(const std::string& tmp_prefix, size_t memory_limit, unsigned int n_threads);
+
+    // デストラクタ、ランの一時ファイルを削除する
+    ~WordlistBuilder();
+
+    // 地名語をまとめて解析し、見出し語レコードを追加する
+    void addGeowords(const std::vector<GeowordRow>& rows, GeowordCache* cache, std::set<int>& dictionary_ids);
+
+    /// @brief 追加したレコード数
+    inline size_t getNumRecords(void) const { return num_records; }
+
+    /// @brief 書き出したランの数
+    inline size_t getNumRuns(void) const { return run_files.size(); }
+
+    // 見出し語の順にレコードを併合し、見出し語ごとに Wordlist と読みかどうかを出力する
+    void merge(const std::function<void(const Wordlist&, bool is_yomi)>& emit, const IndexProgressCallback& progress);
+  };
+
+}
+
+#endif /* _WORDLIST_BUILDER_H */
@@ -0,0 +1,67 @@
+///
+/// @file
+/// @brief 非同期の解析を実行する作業スレッドのプール WorkerPool の定義。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+
+#ifndef _WORKER_POOL_H
+#define _WORKER_POOL_H
+
+#include <deque>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace geonlp
+{
+  ///
+  /// @brief 登録された処理を一定数の作業スレッドで順に実行するクラス。
+  ///
+  /// 処理は登録した順に取り出され、空いている作業スレッドで実行される。
+  /// 処理が送出した例外は無視するため、エラーは処理の中で通知すること。
+  ///
+  class WorkerPool {
+  private:
+    /// 作業スレッド
+    std::vector<std::thread> workers;
+
+    /// 実行を待っている処理
+    std::deque<std::function<void()> > tasks;
+
+    std::mutex mutex;
+    std::condition_variable not_empty;
+
+    /// デストラクタが呼ばれた場合 true
+    bool stopping;
+
+    // 作業スレッドの本体
+    void run(void);
+
+    // コピー禁止
+    WorkerPool(const WorkerPool&);
+    WorkerPool& operator=(const WorkerPool&);
+
+  public:
+    // 作業スレッドを起動する
+    WorkerPool(unsigned int n_threads = 0);
+
+    // 登録済みの処理を全て実行してから作業スレッドを終了する
+    ~WorkerPool();
+
+    // 処理を登録する
+    void submit(const std::function<void()>& task);
+
+    /// @brief 作業スレッドの数
+    inline size_t size(void) const { return workers.size(); }
+
+    // プロセス全体で共有するプール
+    static WorkerPool& shared(void);
+  };
+
+}
+
+#endif /* _WORKER_POOL_H */
@@ -13,6 +13,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <string_view>
 #include <boost/regex.hpp>
 #include "picojson.h"
 
@@ -28,6 +29,46 @@ namespace picojson
     ~PicojsonException() throw() {}
   };
 
+  /// @brief 文字列の配列（または単独の文字列）の要素を複製せずに参照するビュー
+  ///
+  /// 参照元の ext オブジェクトを変更または破棄するまで有効。
+  /// null, boolean 値の要素は "" として参照する。
+  class string_list_view {
+  private:
+    const picojson::value* single;   // 単独の文字列
+    const picojson::array* values;   // 文字列の配列
+
+  public:
+    string_list_view(): single(NULL), values(NULL) {}
+    explicit string_list_view(const picojson::value* single): single(single), values(NULL) {}
+    explicit string_list_view(const picojson::array* values): single(NULL), values(values) {}
+
+    /// 要素数
+    inline size_t size() const { return single ? 1 : (values ? values->size() : 0); }
+    inline bool empty() const { return this->size() == 0; }
+
+    /// i 番目の要素
+    inline std::string_view operator[](size_t i) const {
+      const picojson::value& v = single ? *single : (*values)[i];
+      return v.is<std::string>() ? std::string_view(v.get<std::string>()) : std::string_view();
+    }
+
+    /// 要素を順に参照するイテレータ
+    class const_iterator {
+    private:
+      const string_list_view* view;
+      size_t i;
+    public:
+      const_iterator(const string_list_view* view, size_t i): view(view), i(i) {}
+      inline std::string_view operator*() const { return (*view)[i]; }
+      inline const_iterator& operator++() { i++; return *this; }
+      inline bool operator==(const const_iterator& other) const { return i == other.i; }
+      inline bool operator!=(const const_iterator& other) const { return i != other.i; }
+    };
+    inline const_iterator begin() const { return const_iterator(this, 0); }
+    inline const_iterator end() const { return const_iterator(this, this->size()); }
+  };
+
   /// PicoJSON に文字列、ハッシュ、整数などの直接入出力を拡張
   class ext {
   protected:
@@ -64,8 +105,12 @@ namespace picojson
     bool _get_bool(const std::string& key) const ;
     // picojson オブジェクトの指定したキーの値を文字列として取得する
     std::string _get_string(const std::string& key) const ;
+    // picojson オブジェクトの指定したキーの値を文字列として複製せずに参照する
+    std::string_view _get_string_view(const std::string& key) const ;
     // picojson オブジェクトの指定したキーの値を文字列の配列として取得する
     std::vector<std::string> _get_string_list(const std::string& key) const ;
+    // picojson オブジェクトの指定したキーの値を文字列の配列として複製せずに参照する
+    string_list_view _get_string_list_view(const std::string& key) const ;
     // picojson オブジェクトの指定したキーの値を文字列のハッシュとして取得する
     std::map<std::string, std::string> _get_string_map(const std::string& key) const ;
     // picojson オブジェクトの指定したキーの値を整数値として取得する
@@ -110,10 +155,15 @@ namespace picojson
     // オブジェクトのキー一覧を取得する
     std::vector<std::string> get_keys() const;
     picojson::value get_value(const std::string& key) const ;
+    // 指定したキーの値を複製せずに参照する、キーが存在しない場合は null 値
+    const picojson::value& _get_value_ref(const std::string& key) const ;
 
     /// JSON テキストを得る。
     std::string toJson() const;
 
+    // オブジェクトが確保しているメモリのバイト数を見積もる
+    size_t estimateMemorySize() const;
+
     /// JSON からオブジェクトを復元する
     static ext fromJson(const std::string& json_str) ;
 	
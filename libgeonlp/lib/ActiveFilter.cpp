@@ -0,0 +1,159 @@
+///
+/// @file
+/// @brief アクティブな辞書/固有名クラス/期間の判定クラス ActiveFilter の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include <algorithm>
+#include "ActiveFilter.h"
+
+namespace geonlp
+{
+  /// @brief 最後に割り当てた世代番号、全ての ActiveFilter で共有する
+  static std::atomic<unsigned long> last_generation(0);
+
+  /// @brief アクティブな辞書を設定する
+  /// @arg @c dics アクティブな辞書、key は辞書の内部 ID
+  void ActiveFilter::setDictionaries(const std::map<int, Dictionary>& dics) {
+    this->clearWordlistStates();
+    this->dictionaries.clear();
+    if (dics.size() == 0) return;
+    int max_id = (*dics.rbegin()).first;
+    if (max_id < 0) return;
+    this->dictionaries.resize(max_id + 1, false);
+    for (std::map<int, Dictionary>::const_iterator it = dics.begin(); it != dics.end(); it++) {
+      if ((*it).first >= 0) this->dictionaries[(*it).first] = true;
+    }
+  }
+
+  /// @brief アクティブな固有名クラスの正規表現リストを設定する
+  ///
+  /// 正規表現はここでコンパイルするため、不正な正規表現は設定時に例外となる。
+  /// 空のリストを指定した場合、全てのクラスがアクティブになる。
+  /// それまでに判定したクラスは新しい正規表現で判定し直し、新しい表に置き換える。
+  /// 判定中の他スレッドが無い状態で呼び出すこと。
+  /// @arg @c ne_classes クラス名の正規表現リスト、- から始まる場合は除外する
+  /// @exception boost::regex_error 正規表現が不正
+  void ActiveFilter::setClasses(const std::vector<std::string>& ne_classes) {
+    std::vector<ClassPattern> compiled;
+    for (std::vector<std::string>::const_iterator it = ne_classes.begin(); it != ne_classes.end(); it++) {
+      ClassPattern cp;
+      cp.exclude = ((*it).c_str()[0] == '-');
+      cp.pattern = boost::regex(cp.exclude ? (*it).substr(1) : (*it), boost::regex_constants::egrep);
+      compiled.push_back(cp);
+    }
+    this->patterns.swap(compiled);
+
+    std::unique_ptr<ClassTable> table;
+    if (this->patterns.size() > 0) {
+      table.reset(new ClassTable());
+      if (this->class_table) {
+        const std::vector<std::unique_ptr<ClassVerdict> >& old_verdicts = this->class_table->verdicts;
+        table->verdicts.reserve(old_verdicts.size());
+        for (size_t i = 0; i < old_verdicts.size(); i++) {
+          std::unique_ptr<ClassVerdict> v(new ClassVerdict(*old_verdicts[i]));
+          v->active = this->matchClass(v->ne_class);
+          storeVerdict(*table, v.get());
+          table->verdicts.push_back(std::move(v));
+        }
+      }
+    }
+    std::lock_guard<std::mutex> lock(this->class_mutex);
+    this->class_table.swap(table);
+    this->clearWordlistStates();
+  }
+
+  /// @brief 地名語の有効期間が重なるべき期間を設定する
+  ///
+  /// 期間は両端を含む。 GEOWORD_DATE_MIN から GEOWORD_DATE_MAX までを指定した場合は期間を問わない。
+  /// @arg @c from 期間の開始日（年 * 10000 + 月 * 100 + 日）
+  /// @arg @c to   期間の終了日
+  void ActiveFilter::setPeriod(int from, int to) {
+    if (from > to) std::swap(from, to);
+    this->period_from = from;
+    this->period_to = to;
+    this->has_period = (from > GEOWORD_DATE_MIN || to < GEOWORD_DATE_MAX);
+    this->clearWordlistStates();
+  }
+
+  /// @brief 未登録の固有名クラスを判定し、判定結果を表に登録する
+  ///
+  /// 表が半分まで埋まっている場合は登録せずに判定結果だけを返す。
+  /// @arg @c ne_class 固有名クラス
+  /// @arg @c hash     ne_class のハッシュ値
+  /// @return アクティブなクラスの正規表現に一致し、除外パターンに一致しない場合 true
+  bool ActiveFilter::registerClass(std::string_view ne_class, size_t hash) const {
+    const bool is_in = this->matchClass(ne_class);
+    std::lock_guard<std::mutex> lock(this->class_mutex);
+    ClassTable& table = *this->class_table;
+    if (table.verdicts.size() >= ACTIVE_CLASS_TABLE_SIZE / 2) return is_in;
+    // 他のスレッドが先に登録した場合は何もしない
+    for (size_t n = 0, i = hash; n < ACTIVE_CLASS_TABLE_SIZE; n++, i++) {
+      const ClassVerdict* v = table.slots[i & (ACTIVE_CLASS_TABLE_SIZE - 1)].load(std::memory_order_relaxed);
+      if (!v) break;
+      if (v->hash == hash && v->ne_class == ne_class) return is_in;
+    }
+    std::unique_ptr<ClassVerdict> v(new ClassVerdict());
+    v->ne_class.assign(ne_class.data(), ne_class.length());
+    v->hash = hash;
+    v->active = is_in;
+    storeVerdict(table, v.get());
+    table.verdicts.push_back(std::move(v));
+    return is_in;
+  }
+
+  /// @brief 判定結果を表の空きスロットに格納する
+  ///
+  /// 判定結果の内容を書き終えてから公開するため、 release で格納する。
+  /// @arg @c table   表、 class_mutex を取得済みか他のスレッドから参照されていないこと
+  /// @arg @c verdict 判定結果、表が所有する
+  void ActiveFilter::storeVerdict(ClassTable& table, const ClassVerdict* verdict) {
+    for (size_t n = 0, i = verdict->hash; n < ACTIVE_CLASS_TABLE_SIZE; n++, i++) {
+      std::atomic<const ClassVerdict*>& slot = table.slots[i & (ACTIVE_CLASS_TABLE_SIZE - 1)];
+      if (slot.load(std::memory_order_relaxed) == NULL) {
+        slot.store(verdict, std::memory_order_release);
+        return;
+      }
+    }
+  }
+
+  /// @brief 正規表現を順に評価して固有名クラスを判定する
+  /// @arg @c ne_class 固有名クラス
+  bool ActiveFilter::matchClass(std::string_view ne_class) const {
+    bool is_in = false;
+    for (std::vector<ClassPattern>::const_iterator it = this->patterns.begin(); it != this->patterns.end(); it++) {
+      if ((*it).exclude) { // 除外パターン指定
+        if (boost::regex_match(ne_class.data(), ne_class.data() + ne_class.length(), (*it).pattern)) {
+          is_in = false; // 除外パターンに一致してもさらに調べる
+        }
+      } else if (!is_in) { // まだ一致するパターンが見つかっていない場合は探す
+        if (boost::regex_match(ne_class.data(), ne_class.data() + ne_class.length(), (*it).pattern)) {
+          is_in = true;
+        }
+      }
+    }
+    return is_in;
+  }
+
+  /// @brief 見出し語IDの数を設定し、判定状態を未判定に戻す
+  ///
+  /// インデックスを読み込み直した場合に呼び出す。
+  /// @arg @c n 見出し語IDの数（最大ID + 1）
+  void ActiveFilter::setWordlistCount(size_t n) {
+    if (n != this->num_wordlists) {
+      this->num_wordlists = 0;
+      this->wordlist_states.reset(n > 0 ? new std::atomic<unsigned char>[n] : NULL);
+      this->num_wordlists = n;
+    }
+    this->clearWordlistStates();
+  }
+
+  /// @brief 見出し語IDごとの判定状態を未判定に戻し、新しい世代番号を割り当てる
+  void ActiveFilter::clearWordlistStates(void) {
+    for (size_t i = 0; i < this->num_wordlists; i++) {
+      this->wordlist_states[i].store(0, std::memory_order_relaxed);
+    }
+    this->generation = ++last_generation;
+  }
+}
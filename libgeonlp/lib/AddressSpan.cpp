@@ -0,0 +1,112 @@
+///
+/// @file
+/// @brief ラティス表現から住所表記になり得る範囲を求める関数の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include <cstring>
+#include "AddressSpan.h"
+
+namespace geonlp
+{
+  /// @brief 番地などの数字部分に現れる文字（UTF-8）
+  static const char* addressNumberChars[] = {
+    "0", "1", "2", "3", "4", "5", "6", "7", "8", "9",
+    "０", "１", "２", "３", "４", "５", "６", "７", "８", "９",
+    "〇", "一", "二", "三", "四", "五", "六", "七", "八", "九", "十", "百", "千",
+    "-", "‐", "‑", "–", "—", "―", "−", "－", "ー", "ｰ",
+    "の", "ノ", "之", "ヶ", "ケ",
+  };
+
+  /// @brief 住所表記の区切りとなる単位
+  static const char* addressUnits[] = {
+    "丁目", "番地", "番", "号", "地割",
+  };
+
+  /// @brief 住所表記の中に現れる助詞
+  static const char* addressParticles[] = {
+    "の", "が", "ヶ", "ケ", "ノ",
+  };
+
+  /// @brief 住所表記の一部にならない名詞の品詞細分類１
+  static const char* nonAddressNouns[] = {
+    "代名詞", "非自立", "接続詞的", "動詞非自立的", "特殊",
+  };
+
+  /// @brief 文字列が配列の要素のいずれかと一致するか判定する。
+  static bool _isOneOf(const std::string& s, const char* const* list, size_t n)
+  {
+    for (size_t i = 0; i < n; i++) {
+      if (s == list[i]) return true;
+    }
+    return false;
+  }
+
+  /// @brief 表記が数字・漢数字・ハイフンなどだけからなるか判定する。
+  static bool _isAddressNumber(const std::string& surface)
+  {
+    const size_t n = sizeof(addressNumberChars) / sizeof(addressNumberChars[0]);
+    size_t pos = 0;
+    while (pos < surface.length()) {
+      size_t matched = 0;
+      for (size_t i = 0; i < n; i++) {
+        size_t len = std::strlen(addressNumberChars[i]);
+        if (0 == surface.compare(pos, len, addressNumberChars[i])) {
+          matched = len;
+          break;
+        }
+      }
+      if (matched == 0) return false;
+      pos += matched;
+    }
+    return pos > 0;
+  }
+
+  /// @brief 形態素が住所表記の先頭に続く部分になり得るか判定する。
+  /// @arg @c token 形態素の特徴
+  /// @return 住所表記の一部になり得る場合は true
+  bool canBeAddressPart(const AddressToken& token)
+  {
+    if (token.geoword) return true;
+    if (_isAddressNumber(token.surface)) return true;
+    if (_isOneOf(token.surface, addressUnits, sizeof(addressUnits) / sizeof(addressUnits[0]))) return true;
+
+    const std::string& pos = token.partOfSpeech;
+    if (pos == "名詞") {
+      return !_isOneOf(token.subclassification1, nonAddressNouns, sizeof(nonAddressNouns) / sizeof(nonAddressNouns[0]));
+    }
+    if (pos == "接頭詞") return true;
+    if (pos == "記号") return token.subclassification1 == "アルファベット";
+    if (pos == "助詞") {
+      return _isOneOf(token.surface, addressParticles, sizeof(addressParticles) / sizeof(addressParticles[0]));
+    }
+    return false;
+  }
+
+  /// @brief 住所ジオコーディングを試みる範囲を求める。
+  ///
+  /// 各位置から住所表記の一部にならない最初の位置を末尾から一度だけ計算しておき、
+  /// 先頭になり得る位置ごとに範囲を決める。
+  /// @arg @c tokens 位置ごとの形態素の特徴
+  /// @arg @c spans  [out] 先頭の位置の昇順に並べた範囲
+  void findAddressSpans(const std::vector<AddressToken>& tokens, std::vector<AddressSpan>& spans)
+  {
+    spans.clear();
+    const size_t n = tokens.size();
+
+    // stop[i] は i 以降で最初に住所表記の一部にならない位置
+    std::vector<size_t> stop(n + 1, n);
+    for (size_t i = n; i > 0; i--) {
+      stop[i - 1] = canBeAddressPart(tokens[i - 1]) ? stop[i] : i - 1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      const AddressToken& token = tokens[i];
+      if (token.head == AddressToken::HEAD_NONE) continue;
+      size_t end = stop[i + 1];
+      if (end - i < 2 && !(token.head & AddressToken::HEAD_REGION)) continue;
+      spans.push_back(AddressSpan(i, end));
+    }
+  }
+}
@@ -29,17 +29,26 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <string.h>
 #include "CSVReader.h"
 
 CSVReader::CSVReader(fstream& stream):
   pstream(&stream), separator(DEFAULT_SEPARATOR),
-  quote(DEFAULT_QUOTE_CHARACTER) {}
+  quote(DEFAULT_QUOTE_CHARACTER),
+  pdata(NULL), dataSize(0), dataPos(0), dataEof(true) {}
 
 CSVReader::CSVReader(fstream& stream, const char sep):
-  pstream(&stream), separator(sep), quote(DEFAULT_QUOTE_CHARACTER) {}
+  pstream(&stream), separator(sep), quote(DEFAULT_QUOTE_CHARACTER),
+  pdata(NULL), dataSize(0), dataPos(0), dataEof(true) {}
 
 CSVReader::CSVReader(fstream& stream, const char sep, const char quo):
-  pstream(&stream), separator(sep), quote(quo) {}
+  pstream(&stream), separator(sep), quote(quo),
+  pdata(NULL), dataSize(0), dataPos(0), dataEof(true) {}
+
+CSVReader::CSVReader(const char* data, size_t size):
+  pstream(NULL), separator(DEFAULT_SEPARATOR),
+  quote(DEFAULT_QUOTE_CHARACTER),
+  pdata(data), dataSize(size), dataPos(0), dataEof(false) {}
 
 CSVReader::~CSVReader(void) {}
 
@@ -56,6 +65,24 @@ int CSVReader::Read(vector<string>& tokens) {
 
 int CSVReader::GetNextLine(string& line) {
 
+	if( pdata ) {
+		// std::getline ƓAsŏIf[^̍Ōɂ͋sԂ
+		if( dataEof ) {
+			return -1;
+		}
+		const char* begin = pdata + dataPos;
+		const char* end = (const char*)memchr(begin, '\n', dataSize - dataPos);
+		if( end == NULL ) {
+			line.assign(begin, dataSize - dataPos);
+			dataPos = dataSize;
+			dataEof = true;
+		} else {
+			line.assign(begin, end - begin);
+			dataPos = (end - pdata) + 1;
+		}
+		return (int)line.length();
+	}
+
 	if( !pstream || pstream->eof() ) {
 		return -1;
 	}
@@ -114,6 +141,8 @@ int CSVReader::Close(void) {
 		pstream->close();
 		pstream = NULL;
 	}
+	pdata = NULL;
+	dataEof = true;
 	return 0;
 }
 
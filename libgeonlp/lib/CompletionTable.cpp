@@ -0,0 +1,165 @@
+///
+/// @file
+/// @brief 前方一致補完に利用する見出し語ごとの候補表 CompletionTable の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include <string.h>
+#include "CompletionTable.h"
+#include "BinaryFile.h"
+#include "MemoryBudget.h"
+
+namespace geonlp
+{
+  /// 候補表ファイルの先頭の識別子
+  const char COMPLETION_MAGIC[8] = { 'G', 'E', 'O', 'N', 'L', 'P', 'C', '\0' };
+
+  /// @brief 固有名クラスの番号を得る、新しいクラスの場合は番号を割り当てる
+  /// @arg @c ne_class 固有名クラス
+  /// @return 固有名クラスの番号
+  unsigned int CompletionTable::internClass(const std::string& ne_class)
+  {
+    std::map<std::string, unsigned int>::const_iterator it = this->class_ids.find(ne_class);
+    if (it != this->class_ids.end()) return (*it).second;
+    unsigned int id = this->classes.size();
+    this->classes.push_back(ne_class);
+    this->class_ids.insert(std::make_pair(ne_class, id));
+    return id;
+  }
+
+  /// @brief 見出し語を記録する
+  /// @arg @c wordlist_id 見出し語ID
+  /// @arg @c record      見出し語
+  void CompletionTable::setRecord(unsigned int wordlist_id, const CompletionRecord& record)
+  {
+    if (wordlist_id >= this->records.size()) this->records.resize(wordlist_id + 1);
+    this->records[wordlist_id] = record;
+  }
+
+  /// @brief ファイルに保存する
+  ///
+  /// バイト順はホストのものを使う。 darts ファイルと同じく、作成したホストで読み込むこと。
+  /// @arg @c filename 保存するファイル名
+  /// @exception DartsException ファイルに書き込めない
+  void CompletionTable::save(const std::string& filename) const
+  {
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (fp == NULL) throw DartsException(std::string("Cannot save completion table to '") + filename + "'.");
+    FileCloser closer(fp);
+
+    fwrite(COMPLETION_MAGIC, 1, sizeof(COMPLETION_MAGIC), fp);
+    writeUint32(fp, COMPLETION_TABLE_VERSION);
+    writeUint32(fp, this->classes.size());
+    for (std::vector<std::string>::const_iterator it = this->classes.begin(); it != this->classes.end(); it++) {
+      writeString(fp, *it);
+    }
+    uint32_t num_records = 0;
+    for (std::vector<CompletionRecord>::const_iterator it = this->records.begin(); it != this->records.end(); it++) {
+      if (!(*it).entries.empty()) num_records++;
+    }
+    writeUint32(fp, this->records.size());
+    writeUint32(fp, num_records);
+    for (size_t id = 0; id < this->records.size(); id++) {
+      const CompletionRecord& r = this->records[id];
+      if (r.entries.empty()) continue;
+      writeUint32(fp, id);
+      writeUint32(fp, r.score);
+      writeString(fp, r.surface);
+      writeUint32(fp, r.entries.size());
+      for (std::vector<CompletionEntry>::const_iterator it = r.entries.begin(); it != r.entries.end(); it++) {
+        writeString(fp, (*it).geonlp_id);
+        writeUint32(fp, uint32_t((*it).dictionary_id));
+        writeUint32(fp, (*it).ne_class);
+        writeUint32(fp, uint32_t((*it).valid_from));
+        writeUint32(fp, uint32_t((*it).valid_to));
+      }
+    }
+    if (ferror(fp)) throw DartsException(std::string("Cannot save completion table to '") + filename + "'.");
+  }
+
+  /// @brief ファイルから読み込む
+  /// @arg @c filename 候補表ファイル名
+  /// @return ファイルが存在しない場合は false
+  /// @exception DartsException ファイルの形式が正しくない
+  bool CompletionTable::load(const std::string& filename)
+  {
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (fp == NULL) return false;
+    FileCloser closer(fp);
+    const std::string errmsg = std::string("Completion table '") + filename + "' is broken.";
+
+    char magic[sizeof(COMPLETION_MAGIC)];
+    uint32_t version, num_classes, num_ids, num_records;
+    if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || memcmp(magic, COMPLETION_MAGIC, sizeof(magic)) != 0
+        || !readUint32(fp, version)) {
+      throw DartsException(errmsg);
+    }
+    if (version != COMPLETION_TABLE_VERSION && version != COMPLETION_TABLE_VERSION_V1) {
+      throw DartsException(std::string("The format version of completion table '") + filename + "' is not supported.");
+    }
+
+    this->has_periods = (version != COMPLETION_TABLE_VERSION_V1);
+
+    if (!readUint32(fp, num_classes)) throw DartsException(errmsg);
+    this->classes.resize(num_classes);
+    for (uint32_t i = 0; i < num_classes; i++) {
+      if (!readString(fp, this->classes[i])) throw DartsException(errmsg);
+    }
+
+    if (!readUint32(fp, num_ids) || !readUint32(fp, num_records)) throw DartsException(errmsg);
+    this->records.clear();
+    this->records.resize(num_ids);
+    for (uint32_t i = 0; i < num_records; i++) {
+      uint32_t id, num_entries;
+      if (!readUint32(fp, id) || id >= num_ids) throw DartsException(errmsg);
+      CompletionRecord& r = this->records[id];
+      if (!readUint32(fp, r.score) || !readString(fp, r.surface) || !readUint32(fp, num_entries)) {
+        throw DartsException(errmsg);
+      }
+      r.entries.resize(num_entries);
+      for (uint32_t j = 0; j < num_entries; j++) {
+        CompletionEntry& e = r.entries[j];
+        uint32_t dictionary_id;
+        if (!readString(fp, e.geonlp_id) || !readUint32(fp, dictionary_id) || !readUint32(fp, e.ne_class)
+            || e.ne_class >= num_classes) {
+          throw DartsException(errmsg);
+        }
+        e.dictionary_id = int(dictionary_id);
+        if (version != COMPLETION_TABLE_VERSION_V1) {
+          uint32_t valid_from, valid_to;
+          if (!readUint32(fp, valid_from) || !readUint32(fp, valid_to)) throw DartsException(errmsg);
+          e.valid_from = int(valid_from);
+          e.valid_to = int(valid_to);
+        }
+      }
+    }
+    return true;
+  }
+
+  /// @brief 確保しているメモリのバイト数を見積もる
+  ///
+  /// 見出し語と地名語の配列、文字列、固有名クラス、差分更新で変更された見出し語IDを数える。
+  /// std::map, std::set の要素は 1 件あたり要素とポインタ 4 個分とする。
+  /// @return 推定バイト数
+  size_t CompletionTable::estimateMemorySize(void) const
+  {
+    size_t bytes = sizeof(CompletionTable);
+    bytes += this->records.capacity() * sizeof(CompletionRecord);
+    for (std::vector<CompletionRecord>::const_iterator it = this->records.begin(); it != this->records.end(); it++) {
+      bytes += stringMemorySize((*it).surface);
+      bytes += (*it).entries.capacity() * sizeof(CompletionEntry);
+      for (std::vector<CompletionEntry>::const_iterator e = (*it).entries.begin(); e != (*it).entries.end(); e++) {
+        bytes += stringMemorySize((*e).geonlp_id);
+      }
+    }
+    bytes += this->classes.capacity() * sizeof(std::string);
+    for (std::vector<std::string>::const_iterator it = this->classes.begin(); it != this->classes.end(); it++) {
+      bytes += stringMemorySize(*it);
+    }
+    bytes += this->class_ids.size() * (sizeof(std::pair<const std::string, unsigned int>) + 4 * sizeof(void*));
+    bytes += this->stale_ids.size() * (sizeof(unsigned int) + 4 * sizeof(void*));
+    return bytes;
+  }
+
+}
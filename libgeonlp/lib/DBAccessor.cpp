@@ -7,20 +7,35 @@
 ///
 #include <iostream>
 #include <cstdlib>
+#include <cstdio>
+#include <sstream>
+#include <fstream>
+#include <set>
+#include <algorithm>
+#include <exception>
 #include <sqlite3.h>
 #include <cassert>
 #include <string.h>
-#include <boost/regex.hpp>
 #include <boost/filesystem.hpp>
 #include "config.h"
 #include "darts.h"
 #include "DBAccessor.h"
+#include "DartsLoader.h"
+#include "CompletionTable.h"
+#include "DictionaryBundle.h"
+#include "WordlistBuilder.h"
 #include "FileAccessor.h"
 #include "Util.h"
 #ifdef HAVE_LIBDAMS
 #include <dams.h>
 #endif /* HAVE_LIBDAMS */
 
+/// インデックス構築時に一度に読み込む地名語数
+#define WORDLIST_BUILD_BATCH_SIZE  16384
+
+/// 地名語を一括登録する場合に一つの INSERT 文で登録する件数
+#define GEOWORD_INSERT_BATCH_SIZE  64
+
 #ifndef UNUSED
 #define UNUSED(x) ((void)(x))
 #endif /* UNUSED */
@@ -35,6 +50,7 @@ public:
   std::string val;
   std::string surface;
   std::string yomi;
+  std::vector<geonlp::WordlistEntry> entries;
 public:
   tmp_wordlist(const std::string& k, const std::string& v, const std::string& s, const std::string& y):key(k), val(v), surface(s), yomi(y) {}
 };
@@ -47,6 +63,109 @@ bool operator>(const tmp_wordlist& kv0, const tmp_wordlist& kv1) {
 
 namespace geonlp
 {
+  /// @brief ファイルを rename で置き換える、置き換えるファイルが無い場合は置き換え先を削除する
+  /// @arg @c src  置き換えるファイル
+  /// @arg @c dest 置き換え先のファイル
+  static void _replaceFile(const std::string& src, const std::string& dest) {
+    if (boost::filesystem::exists(boost::filesystem::path(src))) {
+      boost::filesystem::rename(boost::filesystem::path(src), boost::filesystem::path(dest));
+    } else {
+      boost::filesystem::remove(boost::filesystem::path(dest));
+    }
+  }
+
+  /// @brief 複数のファイルを置き換え、失敗した場合は全て元に戻すクラス
+  ///
+  /// 置き換え先のファイルは「.old」を付けた名前に退避しておき、
+  /// rollback() で戻すか commit() で削除する。
+  class IndexFileSwap {
+  private:
+    struct Item {
+      boost::filesystem::path dest;
+      boost::filesystem::path backup;
+      bool backed_up;  ///< dest を backup に退避した
+      bool placed;     ///< 置き換えるファイルを dest に移動した
+    };
+    std::vector<Item> items;
+  public:
+    /// @brief src を dest に移動する、src が無い場合は dest を削除する
+    /// @arg @c src      置き換えるファイル、空の場合は dest を削除する
+    /// @arg @c dest     置き換え先のファイル
+    /// @arg @c required src が無い場合に std::runtime_error を投げる
+    void replace(const std::string& src, const std::string& dest, bool required) {
+      const bool has_src = src.length() > 0 && boost::filesystem::exists(boost::filesystem::path(src));
+      if (required && !has_src) throw std::runtime_error("The index file '" + src + "' is not found.");
+      Item item;
+      item.dest = boost::filesystem::path(dest);
+      item.backup = boost::filesystem::path(dest + ".old");
+      item.backed_up = item.placed = false;
+      this->items.push_back(item);
+      Item& added = this->items.back();
+      boost::filesystem::remove(added.backup);
+      if (boost::filesystem::exists(added.dest)) {
+        boost::filesystem::rename(added.dest, added.backup);
+        added.backed_up = true;
+      }
+      if (has_src) {
+        boost::filesystem::rename(boost::filesystem::path(src), added.dest);
+        added.placed = true;
+      }
+    }
+
+    /// @brief 退避したファイルを元に戻す、失敗は無視する
+    void rollback(void) {
+      boost::system::error_code ec;
+      for (std::vector<Item>::reverse_iterator it = this->items.rbegin(); it != this->items.rend(); it++) {
+        if ((*it).backed_up) {
+          boost::filesystem::rename((*it).backup, (*it).dest, ec);
+        } else if ((*it).placed) {
+          boost::filesystem::remove((*it).dest, ec);
+        }
+      }
+      this->items.clear();
+    }
+
+    /// @brief 退避したファイルを削除する、失敗は無視する
+    void commit(void) {
+      boost::system::error_code ec;
+      for (std::vector<Item>::iterator it = this->items.begin(); it != this->items.end(); it++) {
+        if ((*it).backed_up) boost::filesystem::remove((*it).backup, ec);
+      }
+      this->items.clear();
+    }
+  };
+
+  /// @brief 結果を返さない SQL を実行する
+  /// @exception SqliteErrException 実行に失敗。
+  static void _execSql(sqlite3* p, const char* sql) {
+    char *zErrMsg = NULL;
+    int rc = sqlite3_exec(p, sql, NULL, NULL, &zErrMsg);
+    if (zErrMsg || rc != SQLITE_OK) {
+      std::string errmsg = zErrMsg ? zErrMsg : sqlite3_errmsg(p);
+      sqlite3_free(zErrMsg);
+      throw SqliteErrException(rc, errmsg.c_str());
+    }
+  }
+
+  /// @brief スコープを抜けるときに statement を finalize するクラス
+  class StatementFinalizer {
+  private:
+    sqlite3_stmt* stmt;
+    StatementFinalizer(const StatementFinalizer&);
+    StatementFinalizer& operator=(const StatementFinalizer&);
+  public:
+    StatementFinalizer(sqlite3* p, const char* sql): stmt(NULL) {
+      int rc = sqlite3_prepare_v2(p, sql, -1, &stmt, NULL);
+      if (rc != SQLITE_OK || !stmt) {
+        std::string errmsg = std::string("Prepare failed (") + sql + "), " + sqlite3_errmsg(p);
+        sqlite3_finalize(stmt);
+        throw SqliteErrException(rc, errmsg.c_str());
+      }
+    }
+    ~StatementFinalizer() { sqlite3_finalize(stmt); }
+    inline operator sqlite3_stmt*() const { return stmt; }
+  };
+
   void DBAccessor::beginTransaction(sqlite3* p) const {
     int rc;
     char *zErrMsg;
@@ -60,6 +179,11 @@ namespace geonlp
     }
   }
 
+  void DBAccessor::rollback(sqlite3* p) const {
+    // エラー処理中に呼ばれるため、失敗しても例外は投げない
+    sqlite3_exec(p, "ROLLBACK;", NULL, NULL, NULL);
+  }
+
   void DBAccessor::commit(sqlite3* p) const {
     int rc;
     char *zErrMsg;
@@ -73,13 +197,299 @@ namespace geonlp
     }
   }
   
+  /// prepared statement の SQL と対象 DB（true: wordlist, false: geoword/dictionary）
+  /// legacy_sql は entries カラムを持たない古い wordlist テーブル用
+  /// DBAccessor::StatementType の順に並べる
+  static const struct {
+    const char* sql;
+    const char* legacy_sql;
+    bool on_wordlist;
+  } statement_defs[] = {
+    { "SELECT json FROM geoword WHERE geonlp_id = ?;", NULL, false },
+    { "SELECT json FROM geoword WHERE dictionary_id = ? AND entry_id = ?;", NULL, false },
+    { "SELECT id, identifier, json FROM dictionary WHERE id = ?;", NULL, false },
+    { "SELECT id, identifier, json FROM dictionary WHERE identifier = ?;", NULL, false },
+    { "SELECT id FROM dictionary WHERE identifier = ?;", NULL, false },
+    { "SELECT id, key, surface, idlist, yomi, entries FROM wordlist WHERE id = ?;",
+      "SELECT id, key, surface, idlist, yomi, NULL FROM wordlist WHERE id = ?;", true },
+    { "SELECT id, key, surface, idlist, yomi, entries FROM wordlist WHERE key = ?;",
+      "SELECT id, key, surface, idlist, yomi, NULL FROM wordlist WHERE key = ?;", true },
+    { "SELECT id, key, surface, idlist, yomi, entries FROM wordlist WHERE yomi = ?;",
+      "SELECT id, key, surface, idlist, yomi, NULL FROM wordlist WHERE yomi = ?;", true },
+    { "SELECT geonlp_id, json FROM geoword WHERE rowid = ?;", NULL, false },
+    { "SELECT id, key, surface, idlist, yomi, entries FROM wordlist;",
+      "SELECT id, key, surface, idlist, yomi, NULL FROM wordlist;", true },
+    { "SELECT MAX(id) FROM wordlist;", NULL, true },
+    { "SELECT geonlp_id, record FROM geoword WHERE rowid = ?;", NULL, false },
+  };
+
+  /// @brief プールから prepared statement を取得する。
+  ///
+  /// 初回は prepare してプールに保存し、以降は同じ statement を返す。
+  /// 利用後は StatementLease のデストラクタで reset される。
+  /// @arg @c type statement の種類
+  /// @exception SqliteErrException prepare に失敗。
+  sqlite3_stmt* DBAccessor::acquireStatement(StatementType type) const
+  {
+    sqlite3_stmt*& stmt = this->statements[type];
+    if (stmt) return stmt;
+    sqlite3* db = statement_defs[type].on_wordlist ? this->wordlistp : this->sqlitep;
+    const char* sql = statement_defs[type].sql;
+    if (!this->wordlist_has_entries && statement_defs[type].legacy_sql) sql = statement_defs[type].legacy_sql;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (rc != SQLITE_OK || !stmt) {
+      std::string errmsg = std::string("Prepare failed (") + sql + "), " + sqlite3_errmsg(db);
+      stmt = NULL;
+      throw SqliteErrException(rc, errmsg.c_str());
+    }
+    return stmt;
+  }
+
+  /// @brief プールの prepared statement を全て finalize する。
+  void DBAccessor::finalizeStatements(void) const
+  {
+    for (int i = 0; i < NUM_STATEMENTS; i++) {
+      if (this->statements[i]) sqlite3_finalize(this->statements[i]);
+      this->statements[i] = NULL;
+    }
+  }
+
+  /// @brief statement を 1 ステップ実行する。
+  /// @return 行が得られた場合 true, 終了した場合 false
+  /// @exception SqliteErrException 実行に失敗。
+  bool DBAccessor::stepStatement(sqlite3_stmt* stmt) const
+  {
+#ifdef DEBUG
+    fprintf(fplog, "sqlite3_step('%s')\n", sqlite3_sql(stmt));
+#endif /* DEBUG */
+    StatsTimer timer(this->stats, STATS_SQLITE);
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+      timer.setRows(1);
+      return true;
+    }
+    if (rc == SQLITE_DONE) return false;
+    throw SqliteErrException(rc, sqlite3_errmsg(sqlite3_db_handle(stmt)));
+  }
+
+  /// @brief wordlist テーブルが entries カラムを持つかどうか調べる。
+  ///
+  /// entries カラムが無い古い形式のデータベースでは、
+  /// 地名語IDリストを idlist 文字列から取得する。
+  /// updateWordlists() を実行すると新しい形式のテーブルに置き換わる。
+  void DBAccessor::checkWordlistColumns(void) const
+  {
+    sqlite3_stmt* stmt = NULL;
+    int rc = sqlite3_prepare_v2(this->wordlistp, "PRAGMA table_info(wordlist);", -1, &stmt, NULL);
+    if (rc != SQLITE_OK || !stmt) {
+      throw SqliteErrException(rc, sqlite3_errmsg(this->wordlistp));
+    }
+    bool has_entries = false;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      const char* name = (const char*)sqlite3_column_text(stmt, 1);
+      if (name && strcmp(name, "entries") == 0) has_entries = true;
+    }
+    sqlite3_finalize(stmt);
+    if (has_entries != this->wordlist_has_entries) {
+      // 形式が変わった場合は statement を作り直す
+      this->finalizeStatements();
+      this->wordlist_has_entries = has_entries;
+    }
+  }
+
+  /// @brief geoword テーブルが record カラムを持つかどうか調べる。
+  ///
+  /// record カラムを持つデータベースでは、地名語を登録するたびに
+  /// 主要項目のバイナリレコードも保存し、形態素解析中はそちらを参照する。
+  void DBAccessor::checkGeowordColumns(void) const
+  {
+    StatementFinalizer stmt(this->sqlitep, "PRAGMA table_info(geoword);");
+    bool has_record = false;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      const char* name = (const char*)sqlite3_column_text(stmt, 1);
+      if (name && strcmp(name, "record") == 0) has_record = true;
+    }
+    this->geoword_has_record = has_record;
+  }
+
+  DBAccessor::StatementLease::~StatementLease()
+  {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+  }
+
+  /// @brief SQLite のファイル名を URI に変換する
+  static std::string _sqliteFileUri(const std::string& fname) {
+    std::string uri("file:");
+    for (std::string::const_iterator it = fname.begin(); it != fname.end(); it++) {
+      if (*it == '%' || *it == '?' || *it == '#') {
+        char buf[4];
+        snprintf(buf, sizeof(buf), "%%%02X", (unsigned char)(*it));
+        uri += buf;
+      } else {
+        uri += *it;
+      }
+    }
+    return uri;
+  }
+
+  /// @brief 接続ごとの SQLite のページキャッシュの大きさ（KiB）。
+  ///
+  /// プロファイルの sqlite_cache_size とし、 memory_budget を指定した場合は
+  /// 地名語 DB と見出し語 DB の二つの接続の合計が予算を超えないよう、予算の半分以下にする。
+  /// @return cache_size プラグマに負の値で指定する KiB 数
+  size_t DBAccessor::getSqliteCacheKiB(void) const {
+    size_t kib = this->sqlite_cache_size * 1024;
+    if (this->memory_budget > 0) kib = std::min(kib, this->memory_budget * 1024 / 2);
+    return kib;
+  }
+
+  /// @brief 接続にページキャッシュの大きさを設定する。
+  ///
+  /// read_only と in_memory の場合は getSqliteCacheKiB() の値を常に設定し、
+  /// それ以外は memory_budget を指定した場合だけ設定する。
+  /// @arg @c p 接続
+  void DBAccessor::setSqliteCacheSize(sqlite3* p) const {
+    if (!this->read_only && !this->in_memory && this->memory_budget == 0) return;
+    std::ostringstream oss;
+    oss << "PRAGMA cache_size = -" << (unsigned long long)(this->getSqliteCacheKiB()) << ";";
+    _execSql(p, oss.str().c_str());
+  }
+
+  /// @brief DB ファイルを読み込み専用で開く。
+  ///
+  /// プロファイルの read_only が true の場合は変更されないファイル (immutable=1) として開き、
+  /// ファイルのロックと変更の確認を行わない。
+  /// さらに接続ごとに sqlite_mmap_size の mmap を設定し、
+  /// setSqliteCacheSize() でページキャッシュの大きさを設定する。
+  /// @arg @c fname DB ファイル名
+  /// @arg pp       開いた接続、失敗した場合も close() で閉じること
+  /// @exception std::runtime_error オープンに失敗。
+  void DBAccessor::openReadOnlyDatabase(const std::string& fname, sqlite3** pp) const {
+    int ret;
+    if (this->read_only) {
+      std::string uri = _sqliteFileUri(fname) + "?immutable=1";
+      ret = sqlite3_open_v2(uri.c_str(), pp, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, NULL);
+    } else {
+      ret = sqlite3_open_v2(fname.c_str(), pp, SQLITE_OPEN_READONLY, NULL);
+    }
+    if (SQLITE_OK != ret) {
+      std::string errmsg = std::string("sqlite3_open_v2(") +
+      fname + std::string(") failed, ") + sqlite3_errmsg(*pp);
+      throw std::runtime_error(errmsg);
+    }
+    if (this->read_only) {
+      std::ostringstream oss;
+      oss << "PRAGMA mmap_size = " << (unsigned long long)(this->sqlite_mmap_size) * 1024 * 1024 << ";";
+      _execSql(*pp, oss.str().c_str());
+    }
+    this->setSqliteCacheSize(*pp);
+  }
+
+  /// @brief WAL ファイルに残っている変更を DB ファイルに書き戻す。
+  ///
+  /// WAL ファイルが無いか空の場合は何もしない。
+  /// @arg @c fname DB ファイル名
+  /// @exception std::runtime_error WAL ファイルを空にできない。
+  static void _checkpointDatabase(const std::string& fname) {
+    boost::filesystem::path wal(fname + "-wal");
+    if (!boost::filesystem::exists(wal) || boost::filesystem::file_size(wal) == 0) return;
+
+    sqlite3* p = NULL;
+    int ret = sqlite3_open_v2(fname.c_str(), &p, SQLITE_OPEN_READWRITE, NULL);
+    if (SQLITE_OK == ret) ret = sqlite3_exec(p, "PRAGMA wal_checkpoint(TRUNCATE);", NULL, NULL, NULL);
+    sqlite3_close(p);
+    if (SQLITE_OK != ret || (boost::filesystem::exists(wal) && boost::filesystem::file_size(wal) > 0)) {
+      throw std::runtime_error(std::string("Cannot read the database '") + fname
+                               + "' in memory, its WAL file could not be checkpointed.");
+    }
+  }
+
+  /// @brief DB ファイルの内容をメモリに読み込む。
+  ///
+  /// WAL ファイルに残っている変更は _checkpointDatabase() で書き戻してから読み込む。
+  /// WAL モードのファイルはメモリ上では開けないため、
+  /// ヘッダの読み書きのバージョンをロールバックジャーナルのものに書き換える。
+  /// @arg @c fname DB ファイル名
+  /// @return 読み込んだ内容
+  /// @exception std::runtime_error ファイルを読み込めない、または WAL ファイルを書き戻せない。
+  static boost::shared_ptr<const std::string> _readDatabaseImage(const std::string& fname) {
+    _checkpointDatabase(fname);
+    std::ifstream ifs(fname.c_str(), std::ios::in | std::ios::binary);
+    if (!ifs) {
+      throw std::runtime_error(std::string("Cannot read the database '") + fname + "'.");
+    }
+    boost::shared_ptr<std::string> image(new std::string());
+    ifs.seekg(0, std::ios::end);
+    image->resize(size_t(ifs.tellg()));
+    ifs.seekg(0, std::ios::beg);
+    if (!ifs.read(&(*image)[0], image->size())) {
+      throw std::runtime_error(std::string("Cannot read the database '") + fname + "'.");
+    }
+    if (image->size() >= 20 && (*image)[18] == 2 && (*image)[19] == 2) {
+      (*image)[18] = (*image)[19] = 1;
+    }
+    return image;
+  }
+
+  /// @brief メモリに読み込んだ DB ファイルの内容を読み込み専用で開く。
+  ///
+  /// 内容はコピーせずに SQLite のメモリ上のデータベースとして参照するため、
+  /// 同じ内容を開いた全ての接続と、 fork した子プロセスでページを共有できる。
+  /// 内容全体を mmap_size とし、ページキャッシュへのコピーを行わない。
+  /// @arg @c fname DB ファイル名（エラーメッセージに利用）
+  /// @arg @c image _readDatabaseImage() で読み込んだ内容、接続を閉じるまで保持すること
+  /// @arg pp       開いた接続、失敗した場合も close() で閉じること
+  /// @exception std::runtime_error オープンに失敗、または SQLite がメモリ上のデータベースに対応しない。
+  void DBAccessor::openMemoryDatabase(const std::string& fname, const std::string& image, sqlite3** pp) const {
+#if SQLITE_VERSION_NUMBER >= 3036000 || defined(SQLITE_ENABLE_DESERIALIZE)
+    int ret = sqlite3_open_v2(":memory:", pp, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    if (SQLITE_OK == ret) {
+      // SQLITE_DESERIALIZE_READONLY を指定するので内容は書き換えられない
+      unsigned char* data = reinterpret_cast<unsigned char*>(const_cast<char*>(image.data()));
+      ret = sqlite3_deserialize(*pp, "main", data, image.size(), image.size(), SQLITE_DESERIALIZE_READONLY);
+    }
+    if (SQLITE_OK != ret) {
+      std::string errmsg = std::string("sqlite3_deserialize(") +
+      fname + std::string(") failed, ") + sqlite3_errmsg(*pp);
+      throw std::runtime_error(errmsg);
+    }
+    std::ostringstream oss;
+    oss << "PRAGMA mmap_size = " << (unsigned long long)(image.size()) << ";";
+    _execSql(*pp, oss.str().c_str());
+    this->setSqliteCacheSize(*pp);
+#else  /* SQLITE_VERSION_NUMBER */
+    throw std::runtime_error(std::string("Cannot open '") + fname + "' in memory, SQLite " SQLITE_VERSION " does not support sqlite3_deserialize().");
+#endif /* SQLITE_VERSION_NUMBER */
+  }
+
   /// @brief DBオープン。
   ///
   /// DBは読み込み専用でオープンされる。
+  /// プロファイルの in_memory が true の場合はファイルの内容をメモリに読み込んで openMemoryDatabase() で、
+  /// read_only が true の場合は openReadOnlyDatabase() で開き、
+  /// テーブルの作成やバイナリレコードの追加は行わない。
   /// @exception std::runtime_error オープンに失敗。例外オブジェクトはSqlite3のエラーメッセージを保持する。
   void DBAccessor::open() {
     bool create_tables_needed = false;
 
+    if (this->in_memory) {
+      this->sqlite3_image = _readDatabaseImage(this->sqlite3_fname);
+      this->wordlist_image = _readDatabaseImage(this->wordlist_fname);
+      this->openMemoryDatabase(this->sqlite3_fname, *this->sqlite3_image, &sqlitep);
+      this->openMemoryDatabase(this->wordlist_fname, *this->wordlist_image, &wordlistp);
+      this->checkWordlistColumns();
+      this->checkGeowordColumns();
+      return;
+    }
+    if (this->read_only) {
+      this->openReadOnlyDatabase(this->sqlite3_fname, &sqlitep);
+      this->openReadOnlyDatabase(this->wordlist_fname, &wordlistp);
+      this->checkWordlistColumns();
+      this->checkGeowordColumns();
+      return;
+    }
+
     // Check if the db file is existing
 #ifdef DEBUG
     std::cerr << std::string("sqlite3_fname:") + this->sqlite3_fname << std::endl;
@@ -109,11 +519,208 @@ namespace geonlp
       this->wordlist_fname + std::string(") failed, ") + sqlite3_errmsg(wordlistp);
       throw std::runtime_error(errmsg);
     }
+    this->setSqliteCacheSize(sqlitep);
+    this->setSqliteCacheSize(wordlistp);
 
     // テーブルがまだ存在しない場合は作成する
     if (create_tables_needed) {
       this->createTables();  // ここでロック
     }
+
+    // wordlist テーブルの形式を確認する
+    this->checkWordlistColumns();
+
+    // geoword テーブルの形式を確認し、指定されていればバイナリレコードを追加する
+    this->checkGeowordColumns();
+    if (this->geoword_record && !this->geoword_has_record) {
+      this->addGeowordRecords();
+    }
+  }
+
+  /// @brief メモリに読み込んだ DB ファイルの内容のバイト数
+  ///
+  /// openReader() で作成した DBAccessor と共有するので、一度だけ数える。
+  /// @return 地名語 DB と見出し語 DB の合計、 in_memory でない場合は 0
+  size_t DBAccessor::getInMemoryImageSize(void) const {
+    size_t bytes = 0;
+    if (this->sqlite3_image) bytes += this->sqlite3_image->size();
+    if (this->wordlist_image) bytes += this->wordlist_image->size();
+    return bytes;
+  }
+
+  /// @brief 地名語 DB の接続に設定されたページキャッシュと mmap の上限のバイト数
+  ///
+  /// 接続の cache_size, page_size, mmap_size プラグマの値から求める。
+  /// @arg cache_bytes [out] ページキャッシュの上限、DB を開いていない場合は 0
+  /// @arg mmap_bytes  [out] mmap の上限、DB を開いていない場合は 0
+  void DBAccessor::getSqliteLimits(size_t& cache_bytes, size_t& mmap_bytes) const {
+    sqlite3_int64 cache_size = 0, page_size = 0, mmap_size = 0;
+    cache_bytes = mmap_bytes = 0;
+    if (NULL == sqlitep) return;
+    {
+      StatementFinalizer stmt(this->sqlitep, "PRAGMA cache_size;");
+      if (sqlite3_step(stmt) == SQLITE_ROW) cache_size = sqlite3_column_int64(stmt, 0);
+    }
+    {
+      StatementFinalizer stmt(this->sqlitep, "PRAGMA page_size;");
+      if (sqlite3_step(stmt) == SQLITE_ROW) page_size = sqlite3_column_int64(stmt, 0);
+    }
+    {
+      StatementFinalizer stmt(this->sqlitep, "PRAGMA mmap_size;");
+      if (sqlite3_step(stmt) == SQLITE_ROW) mmap_size = sqlite3_column_int64(stmt, 0);
+    }
+    // 負の値は KiB 単位、正の値はページ数
+    cache_bytes = cache_size < 0 ? size_t(-cache_size) * 1024 : size_t(cache_size * page_size);
+    mmap_bytes = size_t(mmap_size);
+  }
+
+  /// @brief SQLite がプロセス全体で確保しているメモリのバイト数
+  ///
+  /// ページキャッシュ、 prepared statement、スキーマなどを含み、他の MA の接続の分も数える。
+  size_t DBAccessor::getSqliteMemoryUsed(void) {
+    return size_t(sqlite3_memory_used());
+  }
+
+  /// @brief 同じ DB ファイルを読み込み専用で開いた DBAccessor を作成する。
+  ///
+  /// SQLite の接続と prepared statement は作成した DBAccessor が個別に持ち、
+  /// 地名語キャッシュは共有する。
+  /// 作業スレッドごとに一つずつ作成して、スレッド間で接続を共有せずに参照するために利用する。
+  /// @return 読み込み専用で開いた DBAccessor
+  /// @exception std::runtime_error DB ファイルを開けない。
+  DBAccessorPtr DBAccessor::openReader(void) const {
+    DBAccessorPtr reader(new DBAccessor(*this));
+    reader->sqlitep = NULL;
+    reader->wordlistp = NULL;
+    reader->initStatements();
+
+    try {
+      if (reader->in_memory) {
+        reader->openMemoryDatabase(reader->sqlite3_fname, *reader->sqlite3_image, &reader->sqlitep);
+        reader->openMemoryDatabase(reader->wordlist_fname, *reader->wordlist_image, &reader->wordlistp);
+      } else {
+        reader->openReadOnlyDatabase(reader->sqlite3_fname, &reader->sqlitep);
+        reader->openReadOnlyDatabase(reader->wordlist_fname, &reader->wordlistp);
+      }
+
+      // wordlist, geoword テーブルの形式を確認する
+      reader->checkWordlistColumns();
+      reader->checkGeowordColumns();
+    } catch (...) {
+      reader->close();
+      throw;
+    }
+    return reader;
+  }
+
+  /// @brief 次の世代のインデックスを、現在のファイルとは別のファイルに構築する DBAccessor を作成する。
+  ///
+  /// 地名語 DB は読み込み専用で、 wordlist と darts は nextGenerationFilename() で開く。
+  /// 作成した DBAccessor の updateWordlists() は現在のインデックスを変更しないため、
+  /// 構築中も現在のインデックスで解析を続けられる。
+  /// 構築後に publishIndex() で現在のインデックスと置き換える。
+  /// 地名語キャッシュは現在の DBAccessor と共有する。
+  /// @return インデックスを構築する DBAccessor
+  /// @exception std::runtime_error DB ファイルを開けない。
+  /// @exception SqliteErrException Sqlite3でエラー。
+  DBAccessorPtr DBAccessor::openIndexBuilder(void) const {
+    DBAccessorPtr builder(new DBAccessor(*this));
+    builder->sqlitep = NULL;
+    builder->wordlistp = NULL;
+    builder->initStatements();
+    builder->wordlist_fname = nextGenerationFilename(this->wordlist_fname);
+    builder->darts_fname = nextGenerationFilename(this->darts_fname);
+
+    // 前回の構築に失敗したファイルが残っていれば削除する
+    boost::filesystem::remove(boost::filesystem::path(builder->wordlist_fname));
+    boost::filesystem::remove(boost::filesystem::path(builder->wordlist_fname + "-journal"));
+    boost::filesystem::remove(boost::filesystem::path(builder->tmpDartsFilename()));
+    boost::filesystem::remove(boost::filesystem::path(builder->tmpYomiDartsFilename()));
+    boost::filesystem::remove(boost::filesystem::path(builder->tmpCompletionFilename()));
+    boost::filesystem::remove(boost::filesystem::path(builder->tmpSpatialIndexFilename()));
+
+    int ret;
+    ret = sqlite3_open_v2(builder->sqlite3_fname.c_str(), &builder->sqlitep, SQLITE_OPEN_READONLY, NULL);
+    if (SQLITE_OK != ret) {
+      std::string errmsg = std::string("sqlite3_open_v2(") +
+      builder->sqlite3_fname + std::string(") failed, ") + sqlite3_errmsg(builder->sqlitep);
+      builder->close();
+      throw std::runtime_error(errmsg);
+    }
+    ret = sqlite3_open(builder->wordlist_fname.c_str(), &builder->wordlistp);
+    if (SQLITE_OK != ret) {
+      std::string errmsg = std::string("sqlite3_open(") +
+      builder->wordlist_fname + std::string(") failed, ") + sqlite3_errmsg(builder->wordlistp);
+      builder->close();
+      throw std::runtime_error(errmsg);
+    }
+    try {
+      _execSql(builder->wordlistp, "CREATE TABLE IF NOT EXISTS wordlist(id INTEGER PRIMARY KEY, key VARCHAR, surface VARCHAR, idlist VARCHAR, yomi VARCHAR, entries BLOB);");
+      builder->checkWordlistColumns();
+      builder->checkGeowordColumns();
+    } catch (...) {
+      builder->close();
+      throw;
+    }
+    return builder;
+  }
+
+  /// @brief openIndexBuilder() で構築した次の世代のインデックスに置き換える。
+  ///
+  /// builder を閉じ、 wordlist と darts のファイルを rename で置き換えてから
+  /// wordlist を開き直す。差分 darts ファイルは新しい世代に統合済みなので削除する。
+  /// 新しい世代に読みの darts ファイルが無い場合は現在のファイルも削除する。
+  /// 置き換えや開き直しに失敗した場合は全てのファイルを元に戻し、
+  /// 現在の wordlist を開き直してから例外を投げるため、現在のインデックスを使い続けられる。
+  /// 置き換え前のファイルを開いている他の接続や mmap は旧世代の内容を参照し続けるため、
+  /// 読み込み専用の DBAccessor は置き換えた後に開き直すこと。
+  /// @arg builder updateWordlists() を実行した openIndexBuilder() の DBAccessor
+  /// @exception std::runtime_error ファイルを置き換えられない、または wordlist を開き直せない。
+  void DBAccessor::publishIndex(DBAccessor& builder) {
+    builder.close();
+    this->finalizeStatements();
+    sqlite3_close(this->wordlistp);
+    this->wordlistp = NULL;
+
+    IndexFileSwap swap;
+    try {
+      swap.replace(builder.wordlist_fname, this->wordlist_fname, true);
+      swap.replace(builder.darts_fname, this->darts_fname, true);
+      swap.replace("", this->getDeltaDartsFilename(), false);
+      swap.replace(builder.getYomiDartsFilename(), this->getYomiDartsFilename(), false);
+      swap.replace(builder.getCompletionFilename(), this->getCompletionFilename(), false);
+      swap.replace(builder.getSpatialIndexFilename(), this->getSpatialIndexFilename(), false);
+      swap.replace("", this->getYomiDeltaDartsFilename(), false);
+      this->reopenWordlist();
+    } catch (...) {
+      swap.rollback();
+      try {
+        this->reopenWordlist();
+      } catch (...) {
+        // 元の例外を投げる
+      }
+      throw;
+    }
+    swap.commit();
+  }
+
+  /// @brief wordlist を閉じて開き直す。
+  /// @exception std::runtime_error wordlist を開けない。
+  /// @exception SqliteErrException Sqlite3でエラー。
+  void DBAccessor::reopenWordlist(void) {
+    this->finalizeStatements();
+    sqlite3_close(this->wordlistp);
+    this->wordlistp = NULL;
+    int ret = sqlite3_open(this->wordlist_fname.c_str(), &this->wordlistp);
+    if (SQLITE_OK != ret) {
+      std::string errmsg = std::string("sqlite3_open(") +
+      this->wordlist_fname + std::string(") failed, ") + sqlite3_errmsg(this->wordlistp);
+      sqlite3_close(this->wordlistp);
+      this->wordlistp = NULL;
+      throw std::runtime_error(errmsg);
+    }
+    this->setSqliteCacheSize(this->wordlistp);
+    this->checkWordlistColumns();
   }
 
   /// @brief DBクローズ。
@@ -122,6 +729,7 @@ namespace geonlp
   /// @note 戻り値が0以外の場合(SQLITE_BUSYなど)には、厳密にいうと再試行をすべきである。
   int DBAccessor::close() {
     int ret;
+    this->finalizeStatements();
     ret = sqlite3_close(sqlitep);
     sqlitep = NULL;
     ret = sqlite3_close(wordlistp);
@@ -140,42 +748,25 @@ namespace geonlp
   // Geoword DBAccessor::findGeowordById(const std::string& id) const
   bool DBAccessor::findGeowordById(const std::string& id, Geoword& ret) const
   {
-    char **azResult;
-    int row, column, rc;
-    char *zErrMsg;
-    std::ostringstream oss;
-    
     if ( NULL == sqlitep) throw SqliteNotInitializedException();
 
     // キャッシュチェック
-    if (DBAccessor::searchGeowordFromCache(id, ret)) {
-      return true;
-    }
+    bool hit = this->geoword_cache->get(id, ret);
+    if (this->stats) this->stats->addCacheLookup(STATS_GEOWORD_CACHE, hit);
+    if (hit) return true;
 
     // DB から検索
-    oss << "select * from geoword where geonlp_id = '" << id << "';";
-    std::string sql =  oss.str();
-    rc = sqlite3_get_table(sqlitep, sql.c_str(), &azResult, &row, &column, &zErrMsg);
-#ifdef DEBUG
-    fprintf(fplog, "sqlite3_get_table('%s')\n", sql.c_str());
-#endif /* DEBUG */
-    if( zErrMsg || rc != SQLITE_OK){
-      std::string errmsg = zErrMsg;
-      sqlite3_free(zErrMsg);
-      sqlite3_free_table(azResult);
-      throw SqliteErrException( rc, errmsg.c_str());
-    }
-    if ( row != 0){
-      assertGeowordColumns( azResult, column);
-      resultToGeoword( &azResult[column], ret);
+    StatementLease stmt(*this, STMT_GEOWORD_BY_ID);
+    sqlite3_bind_text(stmt, 1, id.c_str(), id.length(), SQLITE_STATIC);
+    if (this->stepStatement(stmt)) {
+      resultToGeoword(stmt, ret);
     } else {
       // 結果が０件の場合
       ret.initByJson("{\"geonlp_id\":\"\"}");
     }
-    sqlite3_free_table(azResult);
 
     // キャッシュに登録
-    DBAccessor::addGeowordToCache(ret);
+    this->geoword_cache->put(ret);
 
     return ret.isValid();
   }
@@ -191,32 +782,16 @@ namespace geonlp
   /// @exception SqliteErrException Sqlite3でエラー。
   bool DBAccessor::findGeowordByDictionaryIdAndEntryId(int dictionary_id, const std::string& entry_id, Geoword& ret) const
   {
-    char **azResult;
-    int row, column, rc;
-    char *zErrMsg;
-    std::ostringstream oss;
-    
     if ( NULL == sqlitep) throw SqliteNotInitializedException();
-    oss << "SELECT * FROM geoword WHERE dictionary_id = " << dictionary_id << " AND entry_id = '" << entry_id << "';";
-    std::string sql =  oss.str();
-    rc = sqlite3_get_table(sqlitep, sql.c_str(), &azResult, &row, &column, &zErrMsg);
-#ifdef DEBUG
-    fprintf(fplog, "sqlite3_get_table('%s')\n", sql.c_str());
-#endif /* DEBUG */
-    if( zErrMsg || rc != SQLITE_OK){
-      std::string errmsg = zErrMsg;
-      sqlite3_free(zErrMsg);
-      sqlite3_free_table(azResult);
-      throw SqliteErrException( rc, errmsg.c_str());
-    }
-    if ( row != 0){
-      assertGeowordColumns( azResult, column);
-      resultToGeoword( &azResult[column], ret);
+    StatementLease stmt(*this, STMT_GEOWORD_BY_DICTIONARY_AND_ENTRY);
+    sqlite3_bind_int(stmt, 1, dictionary_id);
+    sqlite3_bind_text(stmt, 2, entry_id.c_str(), entry_id.length(), SQLITE_STATIC);
+    if (this->stepStatement(stmt)) {
+      resultToGeoword(stmt, ret);
     } else {
       // 結果が０件の場合
       ret.initByJson("{\"geonlp_id\":\"\"}");
     }
-    sqlite3_free_table(azResult);
 
     return ret.isValid();
   }
@@ -278,34 +853,16 @@ namespace geonlp
   /// @exception SqliteErrException Sqlite3でエラー。
   bool DBAccessor::getDictionaryById(const int id, Dictionary& ret) const
   {
-    std::ostringstream oss;
-    char **azResult;
-    int row, column, rc;
-    char *zErrMsg;
-    
     if ( NULL == sqlitep) throw SqliteNotInitializedException();
-    oss.str("");
-    oss << "select * from dictionary where id = " << id << ";";
-    std::string sql = oss.str();
-    rc = sqlite3_get_table(sqlitep, sql.c_str(), &azResult, &row, &column, &zErrMsg);
-#ifdef DEBUG
-    fprintf(fplog, "sqlite3_get_table('%s')\n", sql.c_str());
-#endif /* DEBUG */
-    if( zErrMsg || rc != SQLITE_OK){
-      std::string errmsg = zErrMsg;
-      sqlite3_free(zErrMsg);
-      sqlite3_free_table(azResult);
-      throw SqliteErrException( rc, errmsg.c_str());
-    }
-    if ( row != 0){
-      assertDictionaryColumns( azResult, column);
-      resultToDictionary( &azResult[column], ret);
+    StatementLease stmt(*this, STMT_DICTIONARY_BY_ID);
+    sqlite3_bind_int(stmt, 1, id);
+    if (this->stepStatement(stmt)) {
+      resultToDictionary(stmt, ret);
     } else {
       // 結果が０件の場合
       ret.initByJson("{\"id\":0}");
     }
-    sqlite3_free_table(azResult);
-    
+
     return ret.isValid();
   }
   
@@ -318,23 +875,15 @@ namespace geonlp
   /// @exception SqliteErrException Sqlite3でエラー。
   bool DBAccessor::getDictionary(const std::string& identifier, Dictionary& ret) const
   {
-    int rc;
     if ( NULL == sqlitep) throw SqliteNotInitializedException();
-    sqlite3_stmt *stm = NULL;
-    rc = sqlite3_prepare(sqlitep, "SELECT id, json FROM dictionary WHERE identifier=?;", -1, &stm, NULL);
-    if (rc != SQLITE_OK || !stm) {
-      throw SqliteErrException(rc, "Prepare failed.");
-    }
-    sqlite3_bind_text(stm, 1, identifier.c_str(), identifier.length(), SQLITE_TRANSIENT);  // the first box = 1
-    if (sqlite3_step(stm) == SQLITE_ROW) {
-      ret.initByJson((char*)(sqlite3_column_text(stm, 1))); // the most left colum = 0
-      // ret.set_value("_internal_id", (sqlite3_column_int(stm, 0)));
-      sqlite3_finalize(stm);
+    StatementLease stmt(*this, STMT_DICTIONARY_BY_IDENTIFIER);
+    sqlite3_bind_text(stmt, 1, identifier.c_str(), identifier.length(), SQLITE_STATIC);  // the first box = 1
+    if (this->stepStatement(stmt)) {
+      resultToDictionary(stmt, ret);
       return true;
     }
     // 結果が０件の場合
     ret.initByJson("{\"id\":0}");
-    sqlite3_finalize(stm);
     return false;
   }
   
@@ -346,22 +895,32 @@ namespace geonlp
   /// @exception SqliteErrException Sqlite3でエラー。
   int DBAccessor::getDictionaryInternalId(const std::string& identifier) const
   {
-    int rc;
     int internal_id = -1;
     if ( NULL == sqlitep) throw SqliteNotInitializedException();
-    sqlite3_stmt *stm = NULL;
-    rc = sqlite3_prepare(sqlitep, "SELECT id FROM dictionary WHERE identifier=?;", -1, &stm, NULL);
-    if (rc != SQLITE_OK || !stm) {
-      throw SqliteErrException(rc, "Prepare failed.");
+    StatementLease stmt(*this, STMT_DICTIONARY_INTERNAL_ID);
+    sqlite3_bind_text(stmt, 1, identifier.c_str(), identifier.length(), SQLITE_STATIC);  // the first box = 1
+    if (this->stepStatement(stmt)) {
+      internal_id = sqlite3_column_int(stmt, 0);
     }
-    sqlite3_bind_text(stm, 1, identifier.c_str(), identifier.length(), SQLITE_TRANSIENT);  // the first box = 1
-    if (sqlite3_step(stm) == SQLITE_ROW) {
-      internal_id = sqlite3_column_int(stm, 0);
-    }
-    sqlite3_finalize(stm);
     return internal_id;
   }
   
+  /// @brief 単語IDリストの最大 ID を DB から取得する
+  ///
+  /// @return 最大 ID、単語IDリストが空の場合は -1
+  /// @exception SqliteNotInitializedException Sqlite3が未初期化。
+  /// @exception SqliteErrException Sqlite3でエラー。
+  int DBAccessor::getMaxWordlistId(void) const
+  {
+    int max_id = -1;
+    if ( NULL == wordlistp) throw SqliteNotInitializedException();
+    StatementLease stmt(*this, STMT_MAX_WORDLIST_ID);
+    if (this->stepStatement(stmt) && sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+      max_id = sqlite3_column_int(stmt, 0);
+    }
+    return max_id;
+  }
+
   /// @brief 全ての単語IDリストを DB から取得する
   ///
   /// @return 単語IDリストクラスのリスト
@@ -369,37 +928,17 @@ namespace geonlp
   /// @exception SqliteErrException Sqlite3でエラー。
   bool DBAccessor::findAllWordlist(std::vector<Wordlist>& wordlists) const
   {
-    std::ostringstream oss;
     Wordlist wordlist;
-    char **azResult;
-    int row, column, rc;
-    char *zErrMsg;
+    bool found = false;
     
     if ( NULL == wordlistp) throw SqliteNotInitializedException();
-    oss.str("");
-    oss << "select * from wordlist";
-    std::string sql = oss.str();
-    rc = sqlite3_get_table(wordlistp, sql.c_str(), &azResult, &row, &column, &zErrMsg);
-#ifdef DEBUG
-    fprintf(fplog, "sqlite3_get_table('%s')\n", sql.c_str());
-#endif /* DEBUG */
-    if( zErrMsg || rc != SQLITE_OK){
-      std::string errmsg = zErrMsg;
-      sqlite3_free(zErrMsg);
-      sqlite3_free_table(azResult);
-      throw SqliteErrException( rc, errmsg.c_str());
-    }
-    if ( row != 0){
-      assertWordlistColumns( azResult, column);
-      for (int i = 1, index = column; i <= row; i++) {
-  resultToWordlist( &azResult[index], wordlist);
-  wordlists.push_back(wordlist);
-  index += column;
-      }
+    StatementLease stmt(*this, STMT_ALL_WORDLISTS);
+    while (this->stepStatement(stmt)) {
+      resultToWordlist(stmt, wordlist);
+      wordlists.push_back(wordlist);
+      found = true;
     }
-    sqlite3_free_table(azResult);
-    if (row == 0) return false;
-    else return true;
+    return found;
   }
 
   /// @brief 引数として渡されたIDを持つ単語IDリストの情報を取得する。
@@ -411,33 +950,15 @@ namespace geonlp
   /// @exception SqliteErrException Sqlite3でエラー。
   bool DBAccessor::findWordlistById(const unsigned int id, Wordlist& ret) const
   {
-    std::ostringstream oss;
-    char **azResult;
-    int row, column, rc;
-    char *zErrMsg;
-    
     if ( NULL == wordlistp) throw SqliteNotInitializedException();
-    oss.str("");
-    oss << "select * from wordlist where id = " << id << ";";
-    std::string sql = oss.str();
-    rc = sqlite3_get_table(wordlistp, sql.c_str(), &azResult, &row, &column, &zErrMsg);
-#ifdef DEBUG
-    fprintf(fplog, "sqlite3_get_table('%s')\n", sql.c_str());
-#endif /* DEBUG */
-    if( zErrMsg || rc != SQLITE_OK){
-      std::string errmsg = zErrMsg;
-      sqlite3_free(zErrMsg);
-      sqlite3_free_table(azResult);
-      throw SqliteErrException( rc, errmsg.c_str());
-    }
-    if ( row != 0){
-      assertWordlistColumns( azResult, column);
-      resultToWordlist( &azResult[column], ret);
+    StatementLease stmt(*this, STMT_WORDLIST_BY_ID);
+    sqlite3_bind_int64(stmt, 1, (sqlite3_int64)id);
+    if (this->stepStatement(stmt)) {
+      resultToWordlist(stmt, ret);
     } else {
       // 結果が０件の場合
       ret.set_surface("");
     }
-    sqlite3_free_table(azResult);
 
     return ret.isValid();
   }
@@ -451,37 +972,22 @@ namespace geonlp
   /// @exception SqliteErrException Sqlite3でエラー。
   bool DBAccessor::findWordlistBySurface(const std::string& surface, Wordlist& ret) const
   {
-    char **azResult;
-    int row, column, rc;
-    char *zErrMsg;
-    
     if ( NULL == wordlistp) throw SqliteNotInitializedException();
 
 #ifdef HAVE_LIBDAMS
-    std::string standardized_surface(damswrapper::get_standardized_string(surface));
-    std::string sql = "select * from wordlist where key = '" + standardized_surface + "';";
+    std::string key(damswrapper::get_standardized_string(surface));
 #else
-    std::string sql = "select * from wordlist where key = '" + surface + "';";
+    const std::string& key = surface;
 #endif /* HAVE_LIBDAMS */
 
-    rc = sqlite3_get_table(wordlistp, sql.c_str(), &azResult, &row, &column, &zErrMsg);
-#ifdef DEBUG
-    fprintf(fplog, "sqlite3_get_table('%s')\n", sql.c_str());
-#endif /* DEBUG */
-    if( zErrMsg || rc != SQLITE_OK){
-      std::string errmsg = zErrMsg;
-      sqlite3_free(zErrMsg);
-      sqlite3_free_table(azResult);
-      throw SqliteErrException( rc, errmsg.c_str());
-    }
-    if ( row != 0){
-      assertWordlistColumns( azResult, column);
-      resultToWordlist( &azResult[column], ret);
+    StatementLease stmt(*this, STMT_WORDLIST_BY_KEY);
+    sqlite3_bind_text(stmt, 1, key.c_str(), key.length(), SQLITE_STATIC);
+    if (this->stepStatement(stmt)) {
+      resultToWordlist(stmt, ret);
     } else {
       // 結果が０件の場合
       ret.set_surface("");
     }
-    sqlite3_free_table(azResult);
     return ret.isValid();
   }
 
@@ -494,30 +1000,15 @@ namespace geonlp
   /// @exception SqliteErrException Sqlite3でエラー。
   bool DBAccessor::findWordlistByYomi(const std::string& yomi, Wordlist& ret) const
   {
-    char **azResult;
-    int row, column, rc;
-    char *zErrMsg;
-    
     if ( NULL == wordlistp) throw SqliteNotInitializedException();
-    std::string sql = "select * from wordlist where yomi = '" + yomi + "';";
-    rc = sqlite3_get_table(wordlistp, sql.c_str(), &azResult, &row, &column, &zErrMsg);
-#ifdef DEBUG
-    fprintf(fplog, "sqlite3_get_table('%s')\n", sql.c_str());
-#endif /* DEBUG */
-    if( zErrMsg || rc != SQLITE_OK){
-      std::string errmsg = zErrMsg;
-      sqlite3_free(zErrMsg);
-      sqlite3_free_table(azResult);
-      throw SqliteErrException( rc, errmsg.c_str());
-    }
-    if ( row != 0){
-      assertWordlistColumns( azResult, column);
-      resultToWordlist( &azResult[column], ret);
+    StatementLease stmt(*this, STMT_WORDLIST_BY_YOMI);
+    sqlite3_bind_text(stmt, 1, yomi.c_str(), yomi.length(), SQLITE_STATIC);
+    if (this->stepStatement(stmt)) {
+      resultToWordlist(stmt, ret);
     } else {
       // 結果が０件の場合
       ret.set_surface("");
     }
-    sqlite3_free_table(azResult);
     return ret.isValid();
   }
 
@@ -554,7 +1045,11 @@ namespace geonlp
     // 行の作成ループ
     sqlite3_stmt *stm = NULL;
 
-    rc = sqlite3_prepare(this->sqlitep, "INSERT OR REPLACE INTO geoword VALUES (?, ?, ?, ?);", -1, &stm, NULL);
+    const char* insert_sql = this->geoword_has_record ?
+      "INSERT OR REPLACE INTO geoword (geonlp_id, dictionary_id, entry_id, json, record) VALUES (?, ?, ?, ?, ?);" :
+      "INSERT OR REPLACE INTO geoword (geonlp_id, dictionary_id, entry_id, json) VALUES (?, ?, ?, ?);";
+    std::string record;
+    rc = sqlite3_prepare(this->sqlitep, insert_sql, -1, &stm, NULL);
     if (rc != SQLITE_OK || !stm) {
       std::string errmsg = "failed to prepare statement.";
       throw SqliteErrException(rc, errmsg.c_str());
@@ -569,6 +1064,9 @@ namespace geonlp
   sqlite3_bind_int(stm, 2, wp->get_dictionary_id());
   sqlite3_bind_text(stm, 3, wp->get_entry_id().c_str(), wp->get_entry_id().length(), SQLITE_TRANSIENT);
   sqlite3_bind_text(stm, 4, json.c_str(), json.length(), SQLITE_TRANSIENT);
+  if (this->geoword_has_record && wp->toRecord(record)) {
+    sqlite3_bind_blob(stm, 5, record.data(), record.length(), SQLITE_TRANSIENT);
+  }
 
   // 実行
   rc = sqlite3_step(stm);
@@ -604,18 +1102,224 @@ namespace geonlp
     // コミット
     this->commit(this->sqlitep);
 
+    // 登録した地名語を含む辞書のキャッシュを消す
+    std::set<int> dictionary_ids;
+    for (unsigned int i = 0; i < geowords.size(); i++) {
+      dictionary_ids.insert(geowords[i].get_dictionary_id());
+    }
+    for (std::set<int>::iterator it = dictionary_ids.begin(); it != dictionary_ids.end(); it++) {
+      this->geoword_cache->removeDictionary(*it);
+      this->geoword_record_cache->removeDictionary(*it);
+    }
+
     return;
   }
 
-  /// @brief 辞書を一括でDBにセットする
+  /// @brief ジャーナルと同期書き込みを止め、スコープを抜けると元の設定に戻すクラス
+  class FastImportPragmas {
+  private:
+    sqlite3* p;
+    bool enabled;
+    std::string journal_mode;
+    int synchronous;
+    FastImportPragmas(const FastImportPragmas&);
+    FastImportPragmas& operator=(const FastImportPragmas&);
+  public:
+    FastImportPragmas(sqlite3* p, bool enabled): p(p), enabled(enabled), journal_mode(""), synchronous(2) {
+      if (!this->enabled) return;
+      {
+        StatementFinalizer stmt(p, "PRAGMA journal_mode;");
+        if (sqlite3_step(stmt) == SQLITE_ROW) journal_mode = (const char*)sqlite3_column_text(stmt, 0);
+      }
+      {
+        StatementFinalizer stmt(p, "PRAGMA synchronous;");
+        if (sqlite3_step(stmt) == SQLITE_ROW) synchronous = sqlite3_column_int(stmt, 0);
+      }
+      _execSql(p, "PRAGMA journal_mode = OFF;");
+      _execSql(p, "PRAGMA synchronous = OFF;");
+    }
+    ~FastImportPragmas() {
+      if (!this->enabled) return;
+      std::ostringstream oss;
+      oss << "PRAGMA synchronous = " << synchronous << ";";
+      sqlite3_exec(p, oss.str().c_str(), NULL, NULL, NULL);
+      if (journal_mode.length() > 0) {
+        sqlite3_exec(p, (std::string("PRAGMA journal_mode = ") + journal_mode + ";").c_str(), NULL, NULL, NULL);
+      }
+    }
+  };
+
+  /// @brief 変換済みの地名語を INSERT 文のパラメータにバインドする
+  /// @arg @c stmt        INSERT OR REPLACE INTO geoword (...) VALUES (?, ?, ?, ?[, ?]), ...
+  /// @arg @c offset      先頭のパラメータ番号 - 1
+  /// @arg @c row         地名語、 statement を実行するまで破棄しないこと
+  /// @arg @c with_record バイナリレコードもバインドする場合 true
+  static void _bindGeowordImportRow(sqlite3_stmt* stmt, int offset, const GeowordImportRow& row, bool with_record)
+  {
+    sqlite3_bind_text(stmt, offset + 1, row.geonlp_id.c_str(), row.geonlp_id.length(), SQLITE_STATIC);
+    sqlite3_bind_int(stmt, offset + 2, row.dictionary_id);
+    sqlite3_bind_text(stmt, offset + 3, row.entry_id.c_str(), row.entry_id.length(), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, offset + 4, row.json.c_str(), row.json.length(), SQLITE_STATIC);
+    if (with_record && row.record.length() > 0) {
+      sqlite3_bind_blob(stmt, offset + 5, row.record.data(), row.record.length(), SQLITE_STATIC);
+    }
+  }
+
+  /// @brief INSERT 文を実行してリセットする
+  /// @exception SqliteErrException Sqlite3でエラー。
+  static void _stepInsert(sqlite3* p, sqlite3_stmt* stmt)
+  {
+    int rc = sqlite3_step(stmt);
+    if (rc != SQLITE_DONE) {
+      std::string errmsg = sqlite3_errmsg(p);
+      sqlite3_reset(stmt);
+      throw SqliteErrException(rc, errmsg.c_str());
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+  }
+
+  /// @brief JSON に変換済みの地名語を少しずつ取り出しながら一括でDBにセットする
   ///
-  /// @arg @c std::vector<Dictionary>& 辞書のセット
-  /// @return なし
+  /// source が false を返すまで取り出した地名語を、一つのトランザクションで
+  /// GEOWORD_INSERT_BATCH_SIZE 件ずつまとめた INSERT 文で登録する。
+  /// 登録順は取り出した順で、 setGeowords() で登録した場合と同じ結果になる。
+  /// import_fast が指定されている場合は登録中のジャーナルと同期書き込みを止め、
+  /// geoword テーブルの dictionary_id インデックスを登録後に作り直す。
+  /// この場合、登録中に失敗すると途中までの地名語が残ることがある。
+  /// 削除した索引も取り消しでは戻らないため、失敗した場合は例外を投げる前に作り直す。
+  /// @arg @c source  地名語を取り出す関数、例外を投げた場合は登録を取り消す
+  /// @return 登録した地名語の件数
   /// @exception SqliteNotInitializedException Sqlite3が未初期化。
   /// @exception SqliteErrException Sqlite3でエラー。
-  void DBAccessor::setDictionaries(const std::vector<Dictionary>& dictionaries) const
+  size_t DBAccessor::bulkInsertGeowords(const GeowordImportSource& source) const
   {
-    std::ostringstream oss;
+    std::set<int> dictionary_ids;
+    std::vector<GeowordImportRow> rows;
+    size_t count = 0;
+
+    if (NULL == sqlitep) throw SqliteNotInitializedException();
+
+    FastImportPragmas pragmas(this->sqlitep, this->import_fast);
+    this->beginTransaction(this->sqlitep);
+    try {
+      // 索引は登録後にまとめて作る
+      if (this->import_fast) _execSql(this->sqlitep, "DROP INDEX IF EXISTS geoword_dictionary_id;");
+
+      // record カラムを持つ場合はバイナリレコードも登録する
+      const bool with_record = this->geoword_has_record;
+      const int num_columns = with_record ? 5 : 4;
+      const std::string columns = with_record ?
+        "INSERT OR REPLACE INTO geoword (geonlp_id, dictionary_id, entry_id, json, record) VALUES " :
+        "INSERT OR REPLACE INTO geoword (geonlp_id, dictionary_id, entry_id, json) VALUES ";
+      const std::string values = with_record ? "(?, ?, ?, ?, ?)" : "(?, ?, ?, ?)";
+      std::ostringstream oss;
+      oss << columns << values;
+      for (int i = 1; i < GEOWORD_INSERT_BATCH_SIZE; i++) oss << ", " << values;
+      oss << ";";
+      StatementFinalizer batch_stmt(this->sqlitep, oss.str().c_str());
+      StatementFinalizer single_stmt(this->sqlitep, (columns + values + ";").c_str());
+
+      while (true) {
+        rows.clear();
+        if (!source(rows)) break;
+        size_t i = 0;
+        for (; i + GEOWORD_INSERT_BATCH_SIZE <= rows.size(); i += GEOWORD_INSERT_BATCH_SIZE) {
+          for (int j = 0; j < GEOWORD_INSERT_BATCH_SIZE; j++) {
+            _bindGeowordImportRow(batch_stmt, j * num_columns, rows[i + j], with_record);
+          }
+          _stepInsert(this->sqlitep, batch_stmt);
+        }
+        for (; i < rows.size(); i++) {
+          _bindGeowordImportRow(single_stmt, 0, rows[i], with_record);
+          _stepInsert(this->sqlitep, single_stmt);
+        }
+        for (i = 0; i < rows.size(); i++) dictionary_ids.insert(rows[i].dictionary_id);
+        count += rows.size();
+      }
+
+      if (this->import_fast) _execSql(this->sqlitep, "CREATE INDEX IF NOT EXISTS geoword_dictionary_id ON geoword(dictionary_id);");
+      this->commit(this->sqlitep);
+    } catch (...) {
+      this->rollback(this->sqlitep);
+      // ジャーナルが無いため削除した索引は戻らない、元の例外を投げるため失敗は無視して作り直す
+      if (this->import_fast) sqlite3_exec(this->sqlitep, "CREATE INDEX IF NOT EXISTS geoword_dictionary_id ON geoword(dictionary_id);", NULL, NULL, NULL);
+      throw;
+    }
+
+    // 登録した地名語を含む辞書のキャッシュを消す
+    for (std::set<int>::iterator it = dictionary_ids.begin(); it != dictionary_ids.end(); it++) {
+      this->geoword_cache->removeDictionary(*it);
+      this->geoword_record_cache->removeDictionary(*it);
+    }
+    return count;
+  }
+
+  /// @brief geoword テーブルに record カラムを追加し、登録済みの地名語のバイナリレコードを保存する。
+  ///
+  /// 一度追加したカラムはプロファイルの設定にかかわらず維持される。
+  /// @exception SqliteErrException Sqlite3でエラー。
+  void DBAccessor::addGeowordRecords(void) const
+  {
+    Geoword geo_in;
+    std::string record;
+
+    if (NULL == sqlitep) throw SqliteNotInitializedException();
+    this->createTables(); // テーブルが存在していなければ作成しておく
+
+    this->beginTransaction(this->sqlitep);
+    try {
+      _execSql(this->sqlitep, "ALTER TABLE geoword ADD COLUMN record BLOB;");
+
+      // 更新中の行を読み込まないよう rowid 順に少しずつ読み込む
+      StatementFinalizer select_stmt(this->sqlitep, "SELECT rowid, json FROM geoword WHERE rowid > ? ORDER BY rowid LIMIT ?;");
+      StatementFinalizer update_stmt(this->sqlitep, "UPDATE geoword SET record = ? WHERE rowid = ?;");
+      std::vector<std::pair<long long, std::string> > rows;
+      long long last_rowid = -1;
+      do {
+        rows.clear();
+        sqlite3_bind_int64(select_stmt, 1, (sqlite3_int64)last_rowid);
+        sqlite3_bind_int(select_stmt, 2, WORDLIST_BUILD_BATCH_SIZE);
+        int rc;
+        while ((rc = sqlite3_step(select_stmt)) == SQLITE_ROW) {
+          const char* json = (const char*)sqlite3_column_text(select_stmt, 1);
+          rows.push_back(std::make_pair((long long)sqlite3_column_int64(select_stmt, 0), std::string(json ? json : "{}")));
+        }
+        sqlite3_reset(select_stmt);
+        if (rc != SQLITE_DONE) throw SqliteErrException(rc, sqlite3_errmsg(this->sqlitep));
+
+        for (std::vector<std::pair<long long, std::string> >::const_iterator it = rows.begin(); it != rows.end(); it++) {
+          last_rowid = (*it).first;
+          // 解析できない地名語は JSON だけを利用する
+          try {
+            geo_in.initByJson((*it).second);
+          } catch (picojson::PicojsonException&) {
+            continue;
+          }
+          if (!geo_in.toRecord(record)) continue;
+          sqlite3_bind_blob(update_stmt, 1, record.data(), record.length(), SQLITE_STATIC);
+          sqlite3_bind_int64(update_stmt, 2, (sqlite3_int64)(*it).first);
+          _stepInsert(this->sqlitep, update_stmt);
+        }
+      } while (rows.size() > 0);
+
+      this->commit(this->sqlitep);
+    } catch (...) {
+      this->rollback(this->sqlitep);
+      throw;
+    }
+    this->checkGeowordColumns();
+  }
+
+  /// @brief 辞書を一括でDBにセットする
+  ///
+  /// @arg @c std::vector<Dictionary>& 辞書のセット
+  /// @return なし
+  /// @exception SqliteNotInitializedException Sqlite3が未初期化。
+  /// @exception SqliteErrException Sqlite3でエラー。
+  void DBAccessor::setDictionaries(const std::vector<Dictionary>& dictionaries) const
+  {
+    std::ostringstream oss;
     Dictionary dictionary;
     int rc;
     sqlite3_stmt *stmt;
@@ -717,7 +1421,11 @@ namespace geonlp
     // 行の作成ループ
     sqlite3_stmt *stm = NULL;
 
-    rc = sqlite3_prepare(wordlistp, "INSERT OR REPLACE INTO wordlist VALUES (?, ?, ?, ?, ?);", -1, &stm, NULL);
+    std::string blob;
+    const char* insert_sql = this->wordlist_has_entries ?
+      "INSERT OR REPLACE INTO wordlist (id, key, surface, idlist, yomi, entries) VALUES (?, ?, ?, ?, ?, ?);" :
+      "INSERT OR REPLACE INTO wordlist (id, key, surface, idlist, yomi) VALUES (?, ?, ?, ?, ?);";
+    rc = sqlite3_prepare(wordlistp, insert_sql, -1, &stm, NULL);
     if (rc != SQLITE_OK || !stm) {
       std::string errmsg = "failed to prepare statement.";
       throw SqliteErrException(rc, errmsg.c_str());
@@ -728,9 +1436,14 @@ namespace geonlp
         const Wordlist* wp = &(wordlists[i]);
         // パラメータのバインド
         sqlite3_bind_int(stm, 1, wp->get_id());
-        sqlite3_bind_text(stm, 2, wp->get_surface().c_str(), wp->get_surface().length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(stm, 3, wp->get_idlist().c_str(), wp->get_idlist().length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(stm, 4, wp->get_yomi().c_str(), wp->get_yomi().length(), SQLITE_TRANSIENT);
+        sqlite3_bind_text(stm, 2, wp->get_key().c_str(), wp->get_key().length(), SQLITE_TRANSIENT);
+        sqlite3_bind_text(stm, 3, wp->get_surface().c_str(), wp->get_surface().length(), SQLITE_TRANSIENT);
+        sqlite3_bind_text(stm, 4, wp->get_idlist().c_str(), wp->get_idlist().length(), SQLITE_TRANSIENT);
+        sqlite3_bind_text(stm, 5, wp->get_yomi().c_str(), wp->get_yomi().length(), SQLITE_TRANSIENT);
+        if (this->wordlist_has_entries && wp->get_entries().size() > 0) {
+          Wordlist::encodeEntries(wp->get_entries(), blob);
+          sqlite3_bind_blob(stm, 6, blob.data(), blob.length(), SQLITE_TRANSIENT);
+        }
 
         // 実行
         rc = sqlite3_step(stm);
@@ -789,6 +1502,8 @@ namespace geonlp
       sqlite3_free(zErrMsg);
       throw SqliteErrException(rc, errmsg.c_str());
     }
+    this->geoword_cache->clear();
+    this->geoword_record_cache->clear();
   }
 
   /// @brief 単語IDリストテーブルをクリアする
@@ -813,6 +1528,393 @@ namespace geonlp
       sqlite3_free(zErrMsg);
       throw SqliteErrException(rc, errmsg.c_str());
     }
+
+    // 差分更新用の記録も削除し、次回は全体を再構築させる
+    _execSql(wordlistp, "DROP TABLE IF EXISTS wordlist_dictionary;");
+    _execSql(wordlistp, "DROP TABLE IF EXISTS wordlist_info;");
+    _execSql(wordlistp, "DROP TABLE IF EXISTS wordlist_yomi;");
+    _execSql(wordlistp, "DROP TABLE IF EXISTS wordlist_completion_stale;");
+    _execSql(wordlistp, "DROP TABLE IF EXISTS wordlist_spatial_stale;");
+  }
+
+  typedef std::map<std::string, std::vector<std::string> > SurfaceIdlistMap;
+  typedef std::map<std::string, std::vector<WordlistEntry> > SurfaceEntriesMap;
+
+  /// @brief 見出し語の構築時に読み込む geoword テーブルのカラム
+  ///
+  /// record カラムを持つ場合はバイナリレコードを読み込み、
+  /// レコードが無い地名語は JSON を読み込む。
+  /// 値は Geoword::initByRecordOrJson で復元する。
+  static inline const char* _geowordSourceColumn(bool has_record) {
+    return has_record ? "COALESCE(record, json)" : "json";
+  }
+
+  /// @brief 地名語の全ての表記と読みを見出し語として登録する
+  ///
+  /// 見出し語（標準化した表記または読み）ごとに、 idlist, 表記, 読みと地名語IDリストを追加する。
+  /// @arg @c geo_in          地名語
+  /// @arg @c entry           地名語に対応する地名語IDリストの要素
+  /// @arg @c surface_idlist  [in/out] 見出し語をキーとする idlist, 表記, 読みの配列
+  /// @arg @c surface_entries [in/out] 見出し語をキーとする地名語IDリスト
+  /// @arg @c yomi_keys       [in/out] 地名語の読みである見出し語
+  static void _addGeowordSurfaces(const Geoword& geo_in, const WordlistEntry& entry, SurfaceIdlistMap& surface_idlist, SurfaceEntriesMap& surface_entries, std::set<std::string>& yomi_keys)
+  {
+    std::vector<WordlistRecord> records;
+    enumerateWordlistRecords(geo_in, entry, records);
+    for (std::vector<WordlistRecord>::const_iterator it = records.begin(); it != records.end(); it++) {
+      std::vector<std::string>& elem = surface_idlist[(*it).key];
+      if (elem.size() == 0) {
+        elem.push_back("");
+        elem.push_back((*it).surface);
+        elem.push_back((*it).yomi);
+      } else {
+        elem[0] += "/";
+      }
+      elem[0] += (*it).id_name;
+      surface_entries[(*it).key].push_back((*it).entry);
+      if ((*it).isYomi()) yomi_keys.insert((*it).key);
+    }
+  }
+
+  /// darts 構築中の進捗の通知先（darts の進捗関数は呼び出し元の情報を受け取らないため）
+  static thread_local const IndexProgressCallback* _darts_progress = NULL;
+  static thread_local std::exception_ptr _darts_progress_error;
+  static thread_local size_t _darts_progress_last = 0;
+
+  /// @brief darts の進捗を 1% ごとに通知する
+  ///
+  /// darts の構築中に例外を投げないよう、通知先の例外は構築後に投げ直す。
+  static int _notifyDartsProgress(size_t done, size_t total) {
+    if (_darts_progress == NULL || _darts_progress_error) return 0;
+    if (done != total && (done - _darts_progress_last) * 100 < total) return 0;
+    _darts_progress_last = done;
+    try {
+      (*_darts_progress)("darts", done, total);
+    } catch (...) {
+      _darts_progress_error = std::current_exception();
+    }
+    return 0;
+  }
+
+  /// @brief 整列済みの見出し語から darts を構築してファイルに保存する
+  /// @arg @c keys      見出し語（文字コード昇順）
+  /// @arg @c lengths   見出し語のバイト数
+  /// @arg @c fname     保存先のファイル名
+  /// @arg @c progress  進捗を受け取る関数（空でもよい）
+  /// @exception DartsException 構築または保存に失敗。
+  static void _buildDarts(const std::vector<const char*>& keys, const std::vector<size_t>& lengths, const std::string& fname, const IndexProgressCallback& progress)
+  {
+    Darts::DoubleArray da;
+    _darts_progress = progress ? &progress : NULL;
+    _darts_progress_error = std::exception_ptr();
+    _darts_progress_last = 0;
+    int rc = da.build(keys.size(), const_cast<const char**>(keys.data()), lengths.data(), 0, progress ? _notifyDartsProgress : 0);
+    _darts_progress = NULL;
+    if (_darts_progress_error) {
+      std::exception_ptr e = _darts_progress_error;
+      _darts_progress_error = std::exception_ptr();
+      std::rethrow_exception(e);
+    }
+    if (rc != 0) throw DartsException("Cannot build darts table.");
+    if (da.save(fname.c_str()) != 0) {
+      std::string errmsg = std::string("Cannot save darts index to temporary file (") + fname + ")";
+      throw DartsException(errmsg.c_str());
+    }
+  }
+
+  /// @brief Wordlist を 1 件 wordlist_tmp テーブルに登録する
+  /// @arg @c p     wordlist テーブルを持つ DB
+  /// @arg @c stmt  INSERT INTO wordlist_tmp VALUES (?,?,?,?,?,?)
+  /// @arg @c w     登録する Wordlist
+  /// @arg @c blob  作業用のバッファ
+  /// @exception SqliteErrException Sqlite3でエラー。
+  static void _insertTmpWordlist(sqlite3* p, sqlite3_stmt* stmt, const Wordlist& w, std::string& blob)
+  {
+    int rc;
+    const std::string key = w.get_key();
+    const std::string surface = w.get_surface();
+    const std::string idlist = w.get_idlist();
+    const std::string yomi = w.get_yomi();
+    sqlite3_bind_int(stmt, 1, w.get_id());
+    sqlite3_bind_text(stmt, 2, key.c_str(), key.length(), SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 3, surface.c_str(), surface.length(), SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 4, idlist.c_str(), idlist.length(), SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 5, yomi.c_str(), yomi.length(), SQLITE_TRANSIENT);
+    Wordlist::encodeEntries(w.get_entries(), blob);
+    sqlite3_bind_blob(stmt, 6, blob.data(), blob.length(), SQLITE_TRANSIENT);
+
+    rc = sqlite3_step(stmt);
+    if (rc != SQLITE_DONE) {
+      std::string errmsg = sqlite3_errmsg(p);
+      throw SqliteErrException(rc, errmsg.c_str());
+    }
+    rc = sqlite3_reset(stmt);
+    if (rc != SQLITE_OK) {
+      std::string errmsg = sqlite3_errmsg(p);
+      throw SqliteErrException(rc, errmsg.c_str());
+    }
+    rc = sqlite3_clear_bindings(stmt);
+    if (rc != SQLITE_OK) {
+      std::string errmsg = sqlite3_errmsg(p);
+      throw SqliteErrException(rc, errmsg.c_str());
+    }
+  }
+
+  /// @brief 読みの見出し語を 1 件 wordlist_yomi テーブルに登録する
+  /// @arg @c p     wordlist テーブルを持つ DB
+  /// @arg @c stmt  INSERT [OR IGNORE] INTO wordlist_yomi VALUES (?,?,?)
+  /// @arg @c key   読み
+  /// @arg @c id    読みを見出し語とする Wordlist の ID
+  /// @arg @c delta 差分更新で追加した場合 true
+  /// @return 登録した場合 true、 OR IGNORE で登録済みの場合 false
+  /// @exception SqliteErrException Sqlite3でエラー。
+  static bool _insertYomiWordlist(sqlite3* p, sqlite3_stmt* stmt, const std::string& key, int id, bool delta)
+  {
+    sqlite3_bind_text(stmt, 1, key.c_str(), key.length(), SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, id);
+    sqlite3_bind_int(stmt, 3, delta ? 1 : 0);
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    if (rc != SQLITE_DONE) {
+      throw SqliteErrException(rc, sqlite3_errmsg(p));
+    }
+    return sqlite3_changes(p) > 0;
+  }
+
+  /// @brief 差分更新で変更した見出し語IDを wordlist_completion_stale テーブルに登録する
+  /// @arg @c p     wordlist テーブルを持つ DB
+  /// @arg @c stmt  INSERT OR IGNORE INTO wordlist_completion_stale VALUES (?)
+  /// @arg @c id    変更した Wordlist の ID
+  /// @exception SqliteErrException Sqlite3でエラー。
+  static void _markCompletionStale(sqlite3* p, sqlite3_stmt* stmt, int id)
+  {
+    sqlite3_bind_int(stmt, 1, id);
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+      throw SqliteErrException(rc, sqlite3_errmsg(p));
+    }
+  }
+
+  /// @brief 差分更新で追加・削除した辞書を wordlist_spatial_stale テーブルに登録する
+  /// @arg @c p             wordlist テーブルを持つ DB
+  /// @arg @c dictionary_id 辞書の内部 ID
+  /// @exception SqliteErrException Sqlite3でエラー。
+  static void _markSpatialStale(sqlite3* p, int dictionary_id)
+  {
+    std::ostringstream oss;
+    oss << "INSERT OR IGNORE INTO wordlist_spatial_stale VALUES (" << dictionary_id << ");";
+    _execSql(p, "CREATE TABLE IF NOT EXISTS wordlist_spatial_stale(id INTEGER PRIMARY KEY);");
+    _execSql(p, oss.str().c_str());
+  }
+
+  /// @brief 読みの見出し語テーブル wordlist_yomi を作成し、空にする
+  ///
+  /// 全体を再構築するトランザクションの中で呼び出す。
+  /// @exception SqliteErrException Sqlite3でエラー。
+  void DBAccessor::resetYomiWordlists(void) const
+  {
+    _execSql(this->wordlistp, "CREATE TABLE IF NOT EXISTS wordlist_yomi(key VARCHAR PRIMARY KEY, id INTEGER, delta INTEGER);");
+    _execSql(this->wordlistp, "DELETE FROM wordlist_yomi;");
+  }
+
+  /// @brief wordlist_yomi テーブルの読みから読みの darts を作り、一時ファイルに保存する
+  ///
+  /// darts の値は読みを見出し語とする Wordlist の ID。
+  /// @arg @c delta     true の場合は差分更新で追加した読み、 false の場合は全体を再構築した時点の読み
+  /// @arg @c tmp_fname 保存する一時ファイル名
+  /// @return 読みが無い場合は false（ファイルは作成しない）
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception DartsException Darts の構築または保存でエラー。
+  bool DBAccessor::buildYomiDarts(bool delta, const std::string& tmp_fname) const
+  {
+    std::vector<std::string> keys;
+    std::vector<Darts::DoubleArray::value_type> values;
+
+    // sqlite の文字列比較はバイト順なので、 darts が必要とする順に並ぶ
+    StatementFinalizer stmt(this->wordlistp, "SELECT key, id FROM wordlist_yomi WHERE delta = ? ORDER BY key;");
+    sqlite3_bind_int(stmt, 1, delta ? 1 : 0);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      const char* key = (const char*)sqlite3_column_text(stmt, 0);
+      if (!key || !*key) continue;
+      keys.push_back(key);
+      values.push_back(sqlite3_column_int(stmt, 1));
+    }
+    if (keys.size() == 0) return false;
+
+    std::vector<const char*> key_ptrs;
+    for (std::vector<std::string>::const_iterator it = keys.begin(); it != keys.end(); it++) {
+      key_ptrs.push_back((*it).c_str());
+    }
+    Darts::DoubleArray da;
+    if (da.build(key_ptrs.size(), &key_ptrs[0], 0, &values[0], 0) != 0)
+      throw DartsException("Cannot build yomi darts table.");
+    if (da.save(tmp_fname.c_str()) != 0) {
+      std::string errmsg = std::string("Cannot save yomi darts index to temporary file (") + tmp_fname + ")";
+      throw DartsException(errmsg.c_str());
+    }
+    return true;
+  }
+
+  /// @brief 地名語が経緯度を持つ場合は空間インデックスに地点を追加する
+  /// @arg @c index 空間インデックス
+  /// @arg @c geo   地名語
+  static void _addSpatialPoint(SpatialIndex& index, const Geoword& geo)
+  {
+    SpatialPoint point;
+    if (!parseLatLon(geo.get_latitude(), geo.get_longitude(), point.latitude, point.longitude)) return;
+    point.dictionary_id = geo.get_dictionary_id();
+    point.ne_class = index.internClass(geo.get_ne_class());
+    point.geonlp_id = geo.get_geonlp_id();
+    geo.getValidPeriod(point.valid_from, point.valid_to);
+    index.addPoint(point);
+  }
+
+  /// @brief 見出し語テーブルから補完候補表を、地名語テーブルから空間インデックスを作り、一時ファイルに保存する
+  ///
+  /// 地名語テーブルを一度読んで地名語ごとの固有名クラスと経緯度、有効期間を調べ、
+  /// 見出し語ごとに表記、静的スコア（地名語の数）、地名語IDと辞書、固有名クラス、有効期間を記録する。
+  /// 補完候補表と空間インデックスは全体を再構築した時点の内容なので、差分更新の記録も空にする。
+  /// @arg @c tmp_completion_fname 補完候補表を保存する一時ファイル名
+  /// @arg @c tmp_spatial_fname    空間インデックスを保存する一時ファイル名
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception DartsException ファイルの保存でエラー。
+  void DBAccessor::buildGeowordTables(const std::string& tmp_completion_fname, const std::string& tmp_spatial_fname) const
+  {
+    CompletionTable table;
+    SpatialIndex spatial;
+    std::map<long long, CompletionEntry> geoword_entries;  // rowid, 固有名クラスの番号と有効期間
+    Geoword geo_in;
+
+    {
+      std::string select_sql = std::string("SELECT rowid, ") + _geowordSourceColumn(this->geoword_has_record) + " FROM geoword;";
+      StatementFinalizer stmt(this->sqlitep, select_sql.c_str());
+      while (sqlite3_step(stmt) == SQLITE_ROW) {
+        geo_in.initByRecordOrJson((const char*)sqlite3_column_blob(stmt, 1), sqlite3_column_bytes(stmt, 1));
+        CompletionEntry& e = geoword_entries[sqlite3_column_int64(stmt, 0)];
+        e.ne_class = table.internClass(geo_in.get_ne_class());
+        geo_in.getValidPeriod(e.valid_from, e.valid_to);
+        _addSpatialPoint(spatial, geo_in);
+      }
+    }
+    spatial.build();
+
+    {
+      const unsigned int no_class = table.internClass("");
+      std::vector<WordlistEntry> entries;
+      StatementFinalizer stmt(this->wordlistp, "SELECT id, surface, entries FROM wordlist;");
+      while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const void* blob = sqlite3_column_blob(stmt, 2);
+        entries.clear();
+        if (!blob || !Wordlist::decodeEntries(blob, sqlite3_column_bytes(stmt, 2), entries)) continue;
+        CompletionRecord record;
+        const char* surface = (const char*)sqlite3_column_text(stmt, 1);
+        if (surface) record.surface = surface;
+        record.score = entries.size();
+        for (std::vector<WordlistEntry>::const_iterator it = entries.begin(); it != entries.end(); it++) {
+          CompletionEntry e;
+          e.geonlp_id = (*it).geonlp_id;
+          e.dictionary_id = (*it).dictionary_id;
+          std::map<long long, CompletionEntry>::const_iterator c = geoword_entries.find((*it).rowid);
+          if (c == geoword_entries.end()) {
+            e.ne_class = no_class;
+          } else {
+            e.ne_class = (*c).second.ne_class;
+            e.valid_from = (*c).second.valid_from;
+            e.valid_to = (*c).second.valid_to;
+          }
+          record.entries.push_back(e);
+        }
+        table.setRecord(sqlite3_column_int(stmt, 0), record);
+      }
+    }
+
+    _execSql(this->wordlistp, "CREATE TABLE IF NOT EXISTS wordlist_completion_stale(id INTEGER PRIMARY KEY);");
+    _execSql(this->wordlistp, "DELETE FROM wordlist_completion_stale;");
+    _execSql(this->wordlistp, "CREATE TABLE IF NOT EXISTS wordlist_spatial_stale(id INTEGER PRIMARY KEY);");
+    _execSql(this->wordlistp, "DELETE FROM wordlist_spatial_stale;");
+    table.save(tmp_completion_fname);
+    try {
+      spatial.save(tmp_spatial_fname);
+    } catch (...) {
+      boost::system::error_code ec;
+      boost::filesystem::remove(boost::filesystem::path(tmp_completion_fname), ec);
+      throw;
+    }
+  }
+
+  /// @brief 補完候補表を作成した後の差分更新で変更された見出し語IDを取得する
+  ///
+  /// 補完候補表を持たないインデックスの場合は何もしない。
+  /// @arg @c ids [out] 見出し語IDの集合
+  void DBAccessor::getCompletionStaleIds(std::set<unsigned int>& ids) const
+  {
+    sqlite3_stmt* stmt = NULL;
+    ids.clear();
+    if (NULL == wordlistp) return;
+    if (sqlite3_prepare_v2(this->wordlistp, "SELECT id FROM wordlist_completion_stale;", -1, &stmt, NULL) != SQLITE_OK) {
+      if (stmt) sqlite3_finalize(stmt);
+      return;  // テーブルが存在しない
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      ids.insert(sqlite3_column_int(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+  }
+
+  /// @brief 空間インデックスを作成した後の差分更新で追加・削除された辞書の内部 ID を取得する
+  ///
+  /// 空間インデックスを持たないインデックスの場合は何もしない。
+  /// @arg @c stale_ids   [out] 差分更新で追加・削除された辞書の内部 ID の集合
+  /// @arg @c indexed_ids [out] stale_ids のうち、現在インデックスに含まれる辞書の内部 ID の集合
+  void DBAccessor::getSpatialStaleDictionaries(std::set<int>& stale_ids, std::set<int>& indexed_ids) const
+  {
+    sqlite3_stmt* stmt = NULL;
+    stale_ids.clear();
+    indexed_ids.clear();
+    if (NULL == wordlistp) return;
+    if (sqlite3_prepare_v2(this->wordlistp,
+        "SELECT s.id, d.id IS NOT NULL FROM wordlist_spatial_stale s LEFT JOIN wordlist_dictionary d ON s.id = d.id;",
+        -1, &stmt, NULL) != SQLITE_OK) {
+      if (stmt) sqlite3_finalize(stmt);
+      return;  // テーブルが存在しない
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      int id = sqlite3_column_int(stmt, 0);
+      stale_ids.insert(id);
+      if (sqlite3_column_int(stmt, 1)) indexed_ids.insert(id);
+    }
+    sqlite3_finalize(stmt);
+  }
+
+  /// @brief 辞書に含まれる地名語の地点を空間インデックスに追加する
+  ///
+  /// 差分更新で追加された辞書の地点を、インデックスを開く際に集めるために利用する。
+  /// 追加した後で SpatialIndex::build() を呼ぶこと。
+  /// @arg @c dictionary_id 辞書の内部 ID
+  /// @arg @c index         [out] 地点を追加する空間インデックス
+  /// @exception SqliteNotInitializedException Sqlite3が未初期化。
+  /// @exception SqliteErrException Sqlite3でエラー。
+  void DBAccessor::addSpatialPoints(int dictionary_id, SpatialIndex& index) const
+  {
+    if (NULL == sqlitep) throw SqliteNotInitializedException();
+    Geoword geo_in;
+    std::string select_sql = std::string("SELECT ") + _geowordSourceColumn(this->geoword_has_record) + " FROM geoword WHERE dictionary_id = ?;";
+    StatementFinalizer stmt(this->sqlitep, select_sql.c_str());
+    sqlite3_bind_int(stmt, 1, dictionary_id);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      geo_in.initByRecordOrJson((const char*)sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0));
+      _addSpatialPoint(index, geo_in);
+    }
+  }
+
+  /// @brief 地名語の数を数える
+  static size_t _countGeowords(sqlite3* p)
+  {
+    StatementFinalizer stmt(p, "SELECT count(*) FROM geoword;");
+    if (sqlite3_step(stmt) != SQLITE_ROW) return 0;
+    return size_t(sqlite3_column_int64(stmt, 0));
   }
 
   /// @brief 単語IDリストテーブルを更新する
@@ -825,24 +1927,47 @@ namespace geonlp
   /// @exception DartsException Darts ファイルへの書き込みでエラー。
   void DBAccessor::updateWordlists(void) const
   {
+    this->updateWordlists(IndexProgressCallback());
+  }
+
+  /// @brief 単語IDリストテーブルを更新する（進捗を通知する）
+  ///        darts ファイルも更新する
+  ///
+  /// プロファイルで index_build_threads に 1 以外、または index_build_memory に
+  /// 0 以外が指定されている場合は buildWordlistsExternally() で構築する。
+  /// @arg    progress  進捗を受け取る関数（空でもよい）
+  /// @return なし
+  /// @exception SqliteNotInitializedException Sqlite3が未初期化。
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception DartsException Darts ファイルへの書き込みでエラー。
+  void DBAccessor::updateWordlists(const IndexProgressCallback& progress) const
+  {
+    if (this->index_build_threads != 1 || this->index_build_memory > 0) {
+      this->buildWordlistsExternally(progress);
+      return;
+    }
     std::vector<Wordlist> wordlists;
-    this->updateWordlists(wordlists);
+    this->updateWordlists(wordlists, progress);
   }
 
   /// @brief 単語IDリストテーブルを更新する（更新結果も取得する）
   ///        darts ファイルも更新する
   ///
   /// @arg    wordlists   更新後の Wordlist を格納する配列
+  /// @arg    progress    進捗を受け取る関数（空でもよい）
   /// @return なし
   /// @exception SqliteNotInitializedException Sqlite3が未初期化。
   /// @exception SqliteErrException Sqlite3でエラー。
   /// @exception DartsException Darts ファイルへの書き込みでエラー。
-  void DBAccessor::updateWordlists(std::vector<Wordlist>& wordlists) const
+  void DBAccessor::updateWordlists(std::vector<Wordlist>& wordlists, const IndexProgressCallback& progress) const
   {
-    std::string empty_str("");
-    std::map<std::string, std::vector<std::string> > surface_idlist;
+    SurfaceIdlistMap surface_idlist;
+    SurfaceEntriesMap surface_entries;
+    std::set<std::string> yomi_keys;
+    std::set<int> dictionary_ids;
     sqlite3_stmt* stmt;
     Geoword geo_in;
+    std::string blob;
     int rc;
 
     if (NULL == sqlitep || NULL == wordlistp) throw SqliteNotInitializedException();
@@ -852,113 +1977,61 @@ namespace geonlp
     this->clearWordlists();
 
     // 地名語をスキャンして単語リストを構築する
-    const char* select_sql = "SELECT geonlp_id, json FROM geoword;";
+    size_t total = progress ? _countGeowords(sqlitep) : 0;
+    size_t done = 0;
+    // バイナリレコードから構築する場合、完全な地名語のキャッシュは置き換えられないので空にする
+    GeowordCache* refresh_cache = this->geoword_cache.get();
+    if (this->geoword_has_record) {
+      this->geoword_cache->clear();
+      refresh_cache = this->geoword_record_cache.get();
+    }
+    std::string select_str = std::string("SELECT rowid, geonlp_id, ") + _geowordSourceColumn(this->geoword_has_record) + " FROM geoword;";
+    const char* select_sql = select_str.c_str();
     rc = sqlite3_prepare_v2(sqlitep, select_sql, -1, &stmt, &select_sql);
     if (rc != SQLITE_OK || !stmt) {
       throw SqliteErrException(rc, "Failed to prepare statement.");
     }
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-      // std::string geonlp_id = sqlite3_column_text(stmt, 0);
-      std::string json_str = (const char*)(sqlite3_column_text(stmt, 1));
-      geo_in.initByJson(json_str);
+      // std::string geonlp_id = sqlite3_column_text(stmt, 1);
+      long long rowid = sqlite3_column_int64(stmt, 0);
+      geo_in.initByRecordOrJson((const char*)sqlite3_column_blob(stmt, 2), sqlite3_column_bytes(stmt, 2));
       std::string geonlp_id = geo_in.get_geonlp_id();
+      WordlistEntry entry(rowid, geo_in.get_dictionary_id(), geonlp_id);
 
-      // 可能な全ての表記を登録 
-      std::vector<std::string> prefixes = geo_in.get_prefix();
-      if (prefixes.size() == 0) prefixes.push_back(empty_str);
-      std::vector<std::string> suffixes = geo_in.get_suffix();
-      if (suffixes.size() == 0) suffixes.push_back(empty_str);
-      std::vector<std::string> prefixes_kana = geo_in.get_prefix_kana();
-      if (prefixes_kana.size() == 0) prefixes_kana.push_back(empty_str);
-      std::vector<std::string> suffixes_kana = geo_in.get_suffix_kana();
-      if (suffixes_kana.size() == 0) suffixes_kana.push_back(empty_str);
-      
-      const std::string body = geo_in.get_body();
-      const std::string body_kana = geo_in.get_body_kana();
-      const std::string typical_name = geo_in.get_typical_name();
-      int i_prefix = 0;
-      int i_suffix = 0;
-      for (std::vector<std::string>::iterator it_prefix = prefixes.begin(); it_prefix != prefixes.end(); it_prefix++) {
-        for (std::vector<std::string>::iterator it_suffix = suffixes.begin(); it_suffix != suffixes.end(); it_suffix++) {
-          std::string surface = (*it_prefix) + body + (*it_suffix);
-          std::string yomi  = "";
-          if (body_kana.length() > 0) {
-            if (i_prefix < int(prefixes_kana.size())) {
-              yomi += prefixes_kana[i_prefix];
-            } else {
-              yomi += "";
-            }
-            yomi += body_kana;
-            if (i_suffix < int(suffixes_kana.size())) {
-              yomi += suffixes_kana[i_suffix];
-            } else {
-              yomi += "";
-            }
-          }
-#ifdef HAVE_LIBDAMS
-          std::string standardized = std::string(damswrapper::get_standardized_string(surface));
-#else
-          std::string standardized = surface;
-#endif /* HAVE_LIBDAMS */
-          if (surface_idlist[standardized].size() == 0) {
-            surface_idlist[standardized].push_back("");
-            surface_idlist[standardized].push_back(surface);
-            surface_idlist[standardized].push_back(yomi);
-          } else {
-            surface_idlist[standardized][0] += "/";
-          }
-          surface_idlist[standardized][0] += geonlp_id + ":" + typical_name;
-
-          if (yomi.length() > 0) {
-            if (surface_idlist[yomi].size() == 0) {
-              surface_idlist[yomi].push_back("");
-              surface_idlist[yomi].push_back(surface);
-              surface_idlist[yomi].push_back(yomi);
-            } else {
-              surface_idlist[yomi][0] += "/";
-            }
-            surface_idlist[yomi][0] += geonlp_id + ":" + typical_name;
-          }
-          
-          i_suffix++;
-        }
-        i_prefix++;
-      }
+      // キャッシュ済みの地名語は最新の内容に置き換える
+      refresh_cache->refresh(geo_in);
+      dictionary_ids.insert(geo_in.get_dictionary_id());
+
+      _addGeowordSurfaces(geo_in, entry, surface_idlist, surface_entries, yomi_keys);
+      if (progress && ++done % WORDLIST_BUILD_BATCH_SIZE == 0) progress("scan", done, total);
     }
     // select 終了
     sqlite3_finalize(stmt);
+    if (progress) progress("scan", done, total);
 
     // 文字コード昇順に並べ替え（darts は文字コード順である必要があるので）
     std::vector<tmp_wordlist> tmp_wordlists;
-    for (std::map<std::string, std::vector<std::string> >::iterator it = surface_idlist.begin(); it != surface_idlist.end(); it++) {
+    for (SurfaceIdlistMap::iterator it = surface_idlist.begin(); it != surface_idlist.end(); it++) {
       const std::vector<std::string>& elem = (*it).second;
       tmp_wordlists.push_back(tmp_wordlist( (*it).first, elem[0], elem[1], elem[2]));  // 標準表記, idlist, 表記, 読み
+      tmp_wordlists.back().entries.swap(surface_entries[(*it).first]);
     }
     std::sort(tmp_wordlists.begin(), tmp_wordlists.end());
 
-    // darts 用テーブル作成
+    // darts 用テーブル作成（見出し語は複製せずに参照する）
     std::vector<const char*> keys;
+    std::vector<size_t> lengths;
     for (int seq_id = 0; seq_id < int(tmp_wordlists.size()); seq_id++) {
       tmp_wordlist& w = tmp_wordlists[seq_id];
-      char* tmp = new char[w.key.size() + 1];
-      std::strcpy(tmp, w.key.c_str());
-      keys.push_back(tmp);
+      keys.push_back(w.key.c_str());
+      lengths.push_back(w.key.length());
       wordlists.push_back(Wordlist(seq_id, w.key, w.surface, w.val, w.yomi));
+      wordlists.back().set_entries(w.entries);
     }
 
     // darts 構築とファイルへの保存
     std::string tmp_darts_fname = this->tmpDartsFilename();
-    Darts::DoubleArray da;
-    if (da.build(keys.size(), &keys[0], 0, 0, 0) != 0) 
-      throw DartsException("Cannot build darts table.");
-    if (da.save(tmp_darts_fname.c_str()) != 0) {
-    //    if (da.save(this->darts_fname.c_str()) != 0)
-      std::string errmsg = std::string("Cannot save darts index to temporary file (") + tmp_darts_fname + ")";
-      throw DartsException(errmsg.c_str());
-    }
-
-    // darts 用テーブル（オンメモリ）の削除
-    for (int i = 0; i < int(keys.size()); i++) delete[] keys[i];
+    _buildDarts(keys, lengths, tmp_darts_fname, progress);
 
     // Wordlist を DB に書き込むトランザクションの開始
     this->beginTransaction(this->wordlistp);
@@ -967,7 +2040,7 @@ namespace geonlp
     this->createTmpWordlistTable();
 
     // 単語リストを一時テーブルに登録
-    const char* insert_sql = "INSERT INTO wordlist_tmp VALUES (?,?,?,?,?)"; // id, surface, idlist, yomi
+    const char* insert_sql = "INSERT INTO wordlist_tmp VALUES (?,?,?,?,?,?)"; // id, key, surface, idlist, yomi, entries
     rc = sqlite3_prepare_v2(this->wordlistp, insert_sql, -1, &stmt, NULL);
     if (SQLITE_OK != rc) {
       throw SqliteErrException(rc, sqlite3_errmsg(this->wordlistp));
@@ -975,27 +2048,7 @@ namespace geonlp
 
     try {
       for (std::vector<Wordlist>::iterator it = wordlists.begin(); it != wordlists.end(); it++) {
-        sqlite3_bind_int(stmt, 1, (*it).get_id());
-        sqlite3_bind_text(stmt, 2, (*it).get_key().c_str(), (*it).get_key().length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 3, (*it).get_surface().c_str(), (*it).get_surface().length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 4, (*it).get_idlist().c_str(), (*it).get_idlist().length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 5, (*it).get_yomi().c_str(), (*it).get_yomi().length(), SQLITE_TRANSIENT);
-
-        rc = sqlite3_step(stmt);
-        if (rc != SQLITE_DONE) {
-          std::string errmsg = sqlite3_errmsg(this->wordlistp);
-          throw SqliteErrException(rc, errmsg.c_str());
-        }
-        rc = sqlite3_reset(stmt);
-        if (rc != SQLITE_OK) {
-          std::string errmsg = sqlite3_errmsg(this->wordlistp);
-          throw SqliteErrException(rc, errmsg.c_str());
-        }
-        rc = sqlite3_clear_bindings(stmt);
-        if (rc != SQLITE_OK) {
-          std::string errmsg = sqlite3_errmsg(this->wordlistp);
-          throw SqliteErrException(rc, errmsg.c_str());
-        }
+        _insertTmpWordlist(this->wordlistp, stmt, *it, blob);
       }
     } catch (SqliteErrException e) {
       sqlite3_finalize(stmt);
@@ -1003,7 +2056,140 @@ namespace geonlp
     }
     sqlite3_finalize(stmt);
 
+    // 読みの見出し語を登録
+    this->resetYomiWordlists();
+    {
+      StatementFinalizer yomi_stmt(this->wordlistp, "INSERT INTO wordlist_yomi VALUES (?,?,?)"); // key, id, delta
+      for (std::vector<Wordlist>::iterator it = wordlists.begin(); it != wordlists.end(); it++) {
+        if (yomi_keys.find((*it).get_key()) == yomi_keys.end()) continue;
+        _insertYomiWordlist(this->wordlistp, yomi_stmt, (*it).get_key(), (*it).get_id(), false);
+      }
+    }
+
+    this->replaceWordlists(dictionary_ids, wordlists.size(), tmp_darts_fname);
+  }
+
+  /// @brief 地名語を並列に解析し、一時ファイルで併合しながら単語IDリストテーブルを更新する
+  ///        darts ファイルも更新する
+  ///
+  /// 地名語 JSON の解析は index_build_threads のスレッドで並列に行う。
+  /// 見出し語レコードが index_build_memory (MB) を超えると整列して一時ファイルに書き出し、
+  /// 最後に併合しながら wordlist_tmp テーブルに登録する。
+  /// darts には併合済みの見出し語を一つのバッファに並べて渡す。
+  /// 結果は updateWordlists() で構築した場合と同じになる。
+  /// @arg    progress  進捗を受け取る関数（空でもよい）
+  /// @exception SqliteNotInitializedException Sqlite3が未初期化。
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception DartsException Darts ファイルへの書き込みでエラー。
+  void DBAccessor::buildWordlistsExternally(const IndexProgressCallback& progress) const
+  {
+    std::set<int> dictionary_ids;
+    std::string blob;
+    int rc;
+
+    if (NULL == sqlitep || NULL == wordlistp) throw SqliteNotInitializedException();
+
+    // 既存の wordlist テーブルは置き換えるまで残すので、
+    // 構築に失敗した場合も元のインデックスを使い続けられる
+    std::string tmp_darts_fname = this->tmpDartsFilename();
+    WordlistBuilder builder(tmp_darts_fname, this->index_build_memory * 1024 * 1024, this->index_build_threads);
+
+    // 地名語をまとめて読み込み、並列に解析する
+    // 同じ見出し語の地名語は rowid 順に並べるので、 rowid 順に読む
+    size_t total = progress ? _countGeowords(sqlitep) : 0;
+    {
+      // バイナリレコードから構築する場合、完全な地名語のキャッシュは置き換えられないので空にする
+      GeowordCache* refresh_cache = this->geoword_cache.get();
+      if (this->geoword_has_record) {
+        this->geoword_cache->clear();
+        refresh_cache = this->geoword_record_cache.get();
+      }
+      std::string select_sql = std::string("SELECT rowid, ") + _geowordSourceColumn(this->geoword_has_record) + " FROM geoword ORDER BY rowid;";
+      StatementFinalizer stmt(sqlitep, select_sql.c_str());
+      std::vector<WordlistBuilder::GeowordRow> rows;
+      size_t done = 0;
+      do {
+        rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW) {
+          const char* value = (const char*)sqlite3_column_blob(stmt, 1);
+          rows.push_back(WordlistBuilder::GeowordRow(sqlite3_column_int64(stmt, 0),
+                                                     value ? std::string(value, sqlite3_column_bytes(stmt, 1)) : std::string("{}")));
+        }
+        if (rows.size() >= WORDLIST_BUILD_BATCH_SIZE || (rc != SQLITE_ROW && rows.size() > 0)) {
+          builder.addGeowords(rows, refresh_cache, dictionary_ids);
+          done += rows.size();
+          rows.clear();
+          if (progress) progress("scan", done, total);
+        }
+      } while (rc == SQLITE_ROW);
+      if (rc != SQLITE_DONE) throw SqliteErrException(rc, sqlite3_errmsg(sqlitep));
+    }
+
+    // Wordlist を DB に書き込むトランザクションの開始
+    this->beginTransaction(this->wordlistp);
+    try {
+      // 一時 Wordlist テーブル作成
+      this->createTmpWordlistTable();
+      this->resetYomiWordlists();
+
+      // 併合した見出し語を一時テーブルに、読みの見出し語を wordlist_yomi に登録し、
+      // 見出し語を一つのバッファに並べる
+      std::vector<char> key_buffer;
+      std::vector<size_t> key_offsets;
+      {
+        StatementFinalizer stmt(this->wordlistp, "INSERT INTO wordlist_tmp VALUES (?,?,?,?,?,?)"); // id, key, surface, idlist, yomi, entries
+        StatementFinalizer yomi_stmt(this->wordlistp, "INSERT INTO wordlist_yomi VALUES (?,?,?)"); // key, id, delta
+        builder.merge([&](const Wordlist& w, bool is_yomi) {
+            _insertTmpWordlist(this->wordlistp, stmt, w, blob);
+            const std::string key = w.get_key();
+            if (is_yomi) _insertYomiWordlist(this->wordlistp, yomi_stmt, key, w.get_id(), false);
+            key_offsets.push_back(key_buffer.size());
+            key_buffer.insert(key_buffer.end(), key.begin(), key.end());
+            key_buffer.push_back('\0');
+          }, progress);
+      }
+
+      // darts 構築とファイルへの保存
+      size_t num_wordlists = key_offsets.size();
+      std::vector<const char*> keys(num_wordlists);
+      std::vector<size_t> lengths(num_wordlists);
+      for (size_t i = 0; i < num_wordlists; i++) {
+        size_t next = (i + 1 < num_wordlists) ? key_offsets[i + 1] : key_buffer.size();
+        keys[i] = &key_buffer[key_offsets[i]];
+        lengths[i] = next - key_offsets[i] - 1;
+      }
+      std::vector<size_t>().swap(key_offsets);
+      _buildDarts(keys, lengths, tmp_darts_fname, progress);
+
+      this->replaceWordlists(dictionary_ids, num_wordlists, tmp_darts_fname);
+    } catch (...) {
+      this->rollback(this->wordlistp);
+      boost::system::error_code ec;
+      boost::filesystem::remove(boost::filesystem::path(tmp_darts_fname), ec);
+      boost::filesystem::remove(boost::filesystem::path(this->tmpYomiDartsFilename()), ec);
+      boost::filesystem::remove(boost::filesystem::path(this->tmpCompletionFilename()), ec);
+      boost::filesystem::remove(boost::filesystem::path(this->tmpSpatialIndexFilename()), ec);
+      throw;
+    }
+  }
+
+  /// @brief wordlist_tmp テーブルを wordlist テーブルと置き換えてコミットし、
+  ///        一時 darts ファイルを正規ファイルに移動する
+  ///
+  /// beginTransaction() の後で、 wordlist_yomi テーブルに読みを登録してから呼び出す。
+  /// 読みの darts ファイルもここで構築する。
+  /// @arg    dictionary_ids   インデックスに含まれる辞書の内部 ID
+  /// @arg    num_wordlists    見出し語数
+  /// @arg    tmp_darts_fname  一時 darts ファイル名
+  /// @exception SqliteErrException Sqlite3でエラー。
+  void DBAccessor::replaceWordlists(const std::set<int>& dictionary_ids, size_t num_wordlists, const std::string& tmp_darts_fname) const
+  {
+    sqlite3_stmt* stmt;
+    int rc;
+
     // 一時テーブルを正規テーブルにコピー
+    // wordlist テーブルを参照する statement はテーブルの置き換え前に破棄する
+    this->finalizeStatements();
     rc = sqlite3_prepare_v2(this->wordlistp, "DROP TABLE wordlist", -1, &stmt, NULL);
     if (SQLITE_OK != rc) {
       throw SqliteErrException(rc, sqlite3_errmsg(this->wordlistp));
@@ -1024,17 +2210,387 @@ namespace geonlp
     }
     sqlite3_finalize(stmt);
 
+    // 差分更新のために、インデックスに含まれる辞書と見出し語数を記録する
+    _execSql(this->wordlistp, "CREATE TABLE IF NOT EXISTS wordlist_dictionary(id INTEGER PRIMARY KEY);");
+    _execSql(this->wordlistp, "CREATE TABLE IF NOT EXISTS wordlist_info(name VARCHAR PRIMARY KEY, value INTEGER);");
+    _execSql(this->wordlistp, "DELETE FROM wordlist_dictionary;");
+    rc = sqlite3_prepare_v2(this->wordlistp, "INSERT INTO wordlist_dictionary VALUES (?)", -1, &stmt, NULL);
+    if (SQLITE_OK != rc) {
+      throw SqliteErrException(rc, sqlite3_errmsg(this->wordlistp));
+    }
+    for (std::set<int>::const_iterator it = dictionary_ids.begin(); it != dictionary_ids.end(); it++) {
+      sqlite3_bind_int(stmt, 1, (*it));
+      rc = sqlite3_step(stmt);
+      sqlite3_reset(stmt);
+      if (rc != SQLITE_DONE) {
+        std::string errmsg = sqlite3_errmsg(this->wordlistp);
+        sqlite3_finalize(stmt);
+        throw SqliteErrException(rc, errmsg.c_str());
+      }
+    }
+    sqlite3_finalize(stmt);
+    std::ostringstream oss;
+    oss << "REPLACE INTO wordlist_info VALUES ('base_size', " << num_wordlists << ");";
+    _execSql(this->wordlistp, oss.str().c_str());
+
+    // 読みの darts と補完候補表、空間インデックスを構築する
+    const std::string tmp_yomi_fname = this->tmpYomiDartsFilename();
+    boost::filesystem::remove(boost::filesystem::path(tmp_yomi_fname));
+    this->buildYomiDarts(false, tmp_yomi_fname);
+    const std::string tmp_completion_fname = this->tmpCompletionFilename();
+    const std::string tmp_spatial_fname = this->tmpSpatialIndexFilename();
+    this->buildGeowordTables(tmp_completion_fname, tmp_spatial_fname);
+
     // コミット
     this->commit(this->wordlistp);
+    this->wordlist_has_entries = true;
 
-    // キャッシュを消す
-    this->clearGeowordCache();
+    // 登録されていない辞書の地名語をキャッシュから消す
+    this->geoword_cache->retainDictionaries(dictionary_ids);
+    this->geoword_record_cache->retainDictionaries(dictionary_ids);
 
     // 一時ファイルを正規ファイルに移動
     boost::filesystem::path tmppath(tmp_darts_fname);
     boost::filesystem::path regpath(this->darts_fname);
     boost::filesystem::remove(regpath);
     boost::filesystem::rename(tmppath, regpath);
+
+    // 差分 darts ファイルは全て本体に統合されたので削除する
+    boost::filesystem::remove(boost::filesystem::path(this->getDeltaDartsFilename()));
+    _replaceFile(tmp_yomi_fname, this->getYomiDartsFilename());
+    boost::filesystem::remove(boost::filesystem::path(this->getYomiDeltaDartsFilename()));
+    boost::filesystem::rename(boost::filesystem::path(tmp_completion_fname), boost::filesystem::path(this->getCompletionFilename()));
+    boost::filesystem::rename(boost::filesystem::path(tmp_spatial_fname), boost::filesystem::path(this->getSpatialIndexFilename()));
+  }
+
+  /// @brief 辞書に含まれる地名語の全ての見出し語を集める
+  /// @arg @c p               geoword テーブルを持つ DB
+  /// @arg @c has_record      geoword テーブルが record カラムを持つかどうか
+  /// @arg @c dictionary_id   辞書の内部 ID
+  /// @arg @c surface_idlist  [out] 見出し語をキーとする idlist, 表記, 読みの配列
+  /// @arg @c surface_entries [out] 見出し語をキーとする地名語IDリスト
+  /// @arg @c yomi_keys       [out] 地名語の読みである見出し語
+  static void _collectDictionarySurfaces(sqlite3* p, bool has_record, int dictionary_id, SurfaceIdlistMap& surface_idlist, SurfaceEntriesMap& surface_entries, std::set<std::string>& yomi_keys)
+  {
+    Geoword geo_in;
+    std::string select_sql = std::string("SELECT rowid, ") + _geowordSourceColumn(has_record) + " FROM geoword WHERE dictionary_id = ?;";
+    StatementFinalizer stmt(p, select_sql.c_str());
+    sqlite3_bind_int(stmt, 1, dictionary_id);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      long long rowid = sqlite3_column_int64(stmt, 0);
+      geo_in.initByRecordOrJson((const char*)sqlite3_column_blob(stmt, 1), sqlite3_column_bytes(stmt, 1));
+      WordlistEntry entry(rowid, geo_in.get_dictionary_id(), geo_in.get_geonlp_id());
+      _addGeowordSurfaces(geo_in, entry, surface_idlist, surface_entries, yomi_keys);
+    }
+  }
+
+  /// @brief 本体と差分の darts から見出し語の ID を探す
+  /// @return 見出し語 ID、登録されていない場合は -1
+  static int _findWordlistId(const DoubleArrayPtr& base_dap, const DoubleArrayPtr& delta_dap, const std::string& key)
+  {
+    int id = -1;
+    if (base_dap) id = base_dap->exactMatchSearch<Darts::DoubleArray::value_type>(key.c_str(), key.length());
+    if (id < 0 && delta_dap) id = delta_dap->exactMatchSearch<Darts::DoubleArray::value_type>(key.c_str(), key.length());
+    return id;
+  }
+
+  /// @brief 全体を再構築した時点の見出し語数を取得する
+  ///
+  /// 見出し語 ID がこの値以上の見出し語は、差分 darts ファイルに登録されている。
+  /// @return 見出し語数、古い形式のインデックスなど差分更新に対応しない場合は -1
+  /// @exception SqliteNotInitializedException Sqlite3が未初期化。
+  int DBAccessor::getWordlistBaseSize(void) const
+  {
+    sqlite3_stmt* stmt = NULL;
+    int base_size = -1;
+
+    if (NULL == wordlistp) throw SqliteNotInitializedException();
+    if (!this->wordlist_has_entries) return -1;
+
+    // 差分更新に対応する前に作成したインデックスには wordlist_info テーブルが無い
+    int rc = sqlite3_prepare_v2(this->wordlistp, "SELECT value FROM wordlist_info WHERE name = 'base_size';", -1, &stmt, NULL);
+    if (rc != SQLITE_OK || !stmt) {
+      sqlite3_finalize(stmt);
+      return -1;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) base_size = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    return base_size;
+  }
+
+  /// @brief インデックスに登録されていない辞書の内部 ID を取得する
+  /// @arg @c dictionary_ids [out] 辞書テーブルに登録されており、インデックスに含まれていない辞書の内部 ID
+  /// @return インデックスが差分更新に対応しない場合は false
+  /// @exception SqliteNotInitializedException Sqlite3が未初期化。
+  /// @exception SqliteErrException Sqlite3でエラー。
+  bool DBAccessor::getUnindexedDictionaries(std::vector<int>& dictionary_ids) const
+  {
+    std::set<int> indexed;
+
+    dictionary_ids.clear();
+    if (NULL == sqlitep || NULL == wordlistp) throw SqliteNotInitializedException();
+    if (this->getWordlistBaseSize() < 0) return false;
+
+    {
+      StatementFinalizer stmt(this->wordlistp, "SELECT id FROM wordlist_dictionary;");
+      while (sqlite3_step(stmt) == SQLITE_ROW) indexed.insert(sqlite3_column_int(stmt, 0));
+    }
+    StatementFinalizer stmt(this->sqlitep, "SELECT id FROM dictionary ORDER BY id;");
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      int id = sqlite3_column_int(stmt, 0);
+      if (indexed.find(id) == indexed.end()) dictionary_ids.push_back(id);
+    }
+    return true;
+  }
+
+  /// @brief 差分インデックスの見出し語から差分 darts を作り、一時ファイルに保存する
+  ///
+  /// 見出し語 ID が base_size 以上の見出し語を対象とする。
+  /// @arg @c base_size 全体を再構築した時点の見出し語数
+  /// @arg @c tmp_fname 保存する一時ファイル名
+  /// @return 差分の見出し語が無い場合は false（ファイルは作成しない）
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception DartsException Darts の構築または保存でエラー。
+  bool DBAccessor::buildDeltaDarts(int base_size, const std::string& tmp_fname) const
+  {
+    std::vector<std::string> keys;
+    std::vector<Darts::DoubleArray::value_type> values;
+
+    // sqlite の文字列比較はバイト順なので、 darts が必要とする順に並ぶ
+    StatementFinalizer stmt(this->wordlistp, "SELECT key, id FROM wordlist WHERE id >= ? ORDER BY key;");
+    sqlite3_bind_int(stmt, 1, base_size);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      const char* key = (const char*)sqlite3_column_text(stmt, 0);
+      if (!key || !*key) continue;
+      if (keys.size() > 0 && keys.back() == key) continue;
+      keys.push_back(key);
+      values.push_back(sqlite3_column_int(stmt, 1));
+    }
+    if (keys.size() == 0) return false;
+
+    std::vector<const char*> key_ptrs;
+    for (std::vector<std::string>::const_iterator it = keys.begin(); it != keys.end(); it++) {
+      key_ptrs.push_back((*it).c_str());
+    }
+    Darts::DoubleArray da;
+    if (da.build(key_ptrs.size(), &key_ptrs[0], 0, &values[0], 0) != 0)
+      throw DartsException("Cannot build delta darts table.");
+    if (da.save(tmp_fname.c_str()) != 0) {
+      std::string errmsg = std::string("Cannot save delta darts index to temporary file (") + tmp_fname + ")";
+      throw DartsException(errmsg.c_str());
+    }
+    return true;
+  }
+
+  /// @brief 辞書に含まれる地名語の見出し語を Wordlist に追加する
+  ///
+  /// 追加する辞書の地名語だけを読み込むため、辞書の地名語数に比例する時間で更新できる。
+  /// 既存の見出し語はその行の idlist と地名語IDリストに追加し、
+  /// 新しい見出し語は新しい ID を割り当てて差分 darts ファイルに登録する。
+  /// 地名語の読みである見出し語は wordlist_yomi テーブルに追加し、読みの差分 darts ファイルに登録する。
+  /// 差分は updateWordlists() で全体を再構築すると本体に統合される。
+  /// @arg @c dictionary_id 辞書の内部 ID
+  /// @exception SqliteNotInitializedException Sqlite3が未初期化。
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception DartsException Darts ファイルの読み込みまたは書き込みでエラー。
+  /// @exception std::runtime_error インデックスが差分更新に対応していない。
+  void DBAccessor::addDictionaryToWordlists(int dictionary_id) const
+  {
+    SurfaceIdlistMap surface_idlist;
+    SurfaceEntriesMap surface_entries;
+    std::set<std::string> yomi_keys;
+    Wordlist wordlist;
+    std::string blob;
+    int rc;
+
+    if (NULL == sqlitep || NULL == wordlistp) throw SqliteNotInitializedException();
+    int base_size = this->getWordlistBaseSize();
+    if (base_size < 0) {
+      throw std::runtime_error("The index does not support incremental update, rebuild it with updateIndex().");
+    }
+
+    _collectDictionarySurfaces(this->sqlitep, this->geoword_has_record, dictionary_id, surface_idlist, surface_entries, yomi_keys);
+
+    DoubleArrayPtr base_dap = openDartsFile(this->darts_fname, true);
+    DoubleArrayPtr delta_dap = openDartsFile(this->getDeltaDartsFilename(), true);
+    std::string tmp_darts_fname = this->tmpDartsFilename();
+    std::string tmp_yomi_fname = this->tmpYomiDartsFilename();
+    bool delta_updated = false;
+    bool yomi_updated = false;
+
+    this->beginTransaction(this->wordlistp);
+    try {
+      int next_id = this->getMaxWordlistId() + 1;
+      if (next_id < base_size) next_id = base_size;
+      _execSql(this->wordlistp, "CREATE TABLE IF NOT EXISTS wordlist_yomi(key VARCHAR PRIMARY KEY, id INTEGER, delta INTEGER);");
+      StatementFinalizer update_stmt(this->wordlistp, "UPDATE wordlist SET idlist = ?, entries = ? WHERE id = ?;");
+      StatementFinalizer insert_stmt(this->wordlistp, "INSERT INTO wordlist VALUES (?,?,?,?,?,?);"); // id, key, surface, idlist, yomi, entries
+      StatementFinalizer yomi_stmt(this->wordlistp, "INSERT OR IGNORE INTO wordlist_yomi VALUES (?,?,?);"); // key, id, delta
+      _execSql(this->wordlistp, "CREATE TABLE IF NOT EXISTS wordlist_completion_stale(id INTEGER PRIMARY KEY);");
+      StatementFinalizer stale_stmt(this->wordlistp, "INSERT OR IGNORE INTO wordlist_completion_stale VALUES (?);");
+
+      for (SurfaceIdlistMap::iterator it = surface_idlist.begin(); it != surface_idlist.end(); it++) {
+        const std::string& key = (*it).first;
+        const std::vector<std::string>& elem = (*it).second; // idlist, 表記, 読み
+        const std::vector<WordlistEntry>& entries = surface_entries[key];
+        if (key.length() == 0) continue;
+
+        int id = _findWordlistId(base_dap, delta_dap, key);
+        if (id >= 0 && this->findWordlistById(id, wordlist)) {
+          // 既存の見出し語に追加する
+          std::string idlist = wordlist.get_idlist();
+          if (idlist.length() > 0) idlist += "/";
+          idlist += elem[0];
+          std::vector<WordlistEntry> merged = wordlist.get_entries();
+          merged.insert(merged.end(), entries.begin(), entries.end());
+          Wordlist::encodeEntries(merged, blob);
+          sqlite3_bind_text(update_stmt, 1, idlist.c_str(), idlist.length(), SQLITE_TRANSIENT);
+          sqlite3_bind_blob(update_stmt, 2, blob.data(), blob.length(), SQLITE_TRANSIENT);
+          sqlite3_bind_int(update_stmt, 3, id);
+          rc = sqlite3_step(update_stmt);
+          sqlite3_reset(update_stmt);
+        } else {
+          // 新しい見出し語は差分として登録する
+          if (id < 0) {
+            id = next_id++;
+            delta_updated = true;
+          }
+          Wordlist::encodeEntries(entries, blob);
+          sqlite3_bind_int(insert_stmt, 1, id);
+          sqlite3_bind_text(insert_stmt, 2, key.c_str(), key.length(), SQLITE_TRANSIENT);
+          sqlite3_bind_text(insert_stmt, 3, elem[1].c_str(), elem[1].length(), SQLITE_TRANSIENT);
+          sqlite3_bind_text(insert_stmt, 4, elem[0].c_str(), elem[0].length(), SQLITE_TRANSIENT);
+          sqlite3_bind_text(insert_stmt, 5, elem[2].c_str(), elem[2].length(), SQLITE_TRANSIENT);
+          sqlite3_bind_blob(insert_stmt, 6, blob.data(), blob.length(), SQLITE_TRANSIENT);
+          rc = sqlite3_step(insert_stmt);
+          sqlite3_reset(insert_stmt);
+        }
+        if (rc != SQLITE_DONE) {
+          throw SqliteErrException(rc, sqlite3_errmsg(this->wordlistp));
+        }
+        if (yomi_keys.find(key) != yomi_keys.end()) {
+          if (_insertYomiWordlist(this->wordlistp, yomi_stmt, key, id, true)) yomi_updated = true;
+        }
+        _markCompletionStale(this->wordlistp, stale_stmt, id);
+      }
+
+      std::ostringstream oss;
+      oss << "INSERT OR REPLACE INTO wordlist_dictionary VALUES (" << dictionary_id << ");";
+      _execSql(this->wordlistp, oss.str().c_str());
+      _markSpatialStale(this->wordlistp, dictionary_id);
+
+      if (delta_updated) this->buildDeltaDarts(base_size, tmp_darts_fname);
+      if (yomi_updated) this->buildYomiDarts(true, tmp_yomi_fname);
+      this->commit(this->wordlistp);
+    } catch (...) {
+      this->rollback(this->wordlistp);
+      boost::system::error_code ec;
+      if (delta_updated) boost::filesystem::remove(boost::filesystem::path(tmp_darts_fname), ec);
+      if (yomi_updated) boost::filesystem::remove(boost::filesystem::path(tmp_yomi_fname), ec);
+      throw;
+    }
+
+    // 一時ファイルを差分 darts ファイルに移動
+    if (delta_updated) {
+      boost::filesystem::rename(boost::filesystem::path(tmp_darts_fname), boost::filesystem::path(this->getDeltaDartsFilename()));
+    }
+    if (yomi_updated) {
+      boost::filesystem::rename(boost::filesystem::path(tmp_yomi_fname), boost::filesystem::path(this->getYomiDeltaDartsFilename()));
+    }
+  }
+
+  /// @brief 辞書に含まれる地名語を Wordlist から取り除く
+  ///
+  /// 辞書の地名語から見出し語を求めるため、地名語テーブルから削除する前に実行すること。
+  /// 見出し語の行は残し、 idlist と地名語IDリストから辞書の地名語だけを取り除く。
+  /// 読みの見出し語も残し、検索時に読みを持つ地名語だけを返す。
+  /// インデックスが差分更新に対応しない場合や、辞書がインデックスに含まれていない場合は何もしない。
+  /// @arg @c dictionary_id 辞書の内部 ID
+  /// @exception SqliteNotInitializedException Sqlite3が未初期化。
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception DartsException Darts ファイルの読み込みでエラー。
+  void DBAccessor::removeDictionaryFromWordlists(int dictionary_id) const
+  {
+    SurfaceIdlistMap surface_idlist;
+    SurfaceEntriesMap surface_entries;
+    std::set<std::string> yomi_keys;
+    Wordlist wordlist;
+    std::string blob;
+    int rc;
+
+    if (NULL == sqlitep || NULL == wordlistp) throw SqliteNotInitializedException();
+    if (this->getWordlistBaseSize() < 0) return;
+    {
+      StatementFinalizer stmt(this->wordlistp, "SELECT id FROM wordlist_dictionary WHERE id = ?;");
+      sqlite3_bind_int(stmt, 1, dictionary_id);
+      if (sqlite3_step(stmt) != SQLITE_ROW) return;
+    }
+
+    _collectDictionarySurfaces(this->sqlitep, this->geoword_has_record, dictionary_id, surface_idlist, surface_entries, yomi_keys);
+
+    DoubleArrayPtr base_dap = openDartsFile(this->darts_fname, true);
+    DoubleArrayPtr delta_dap = openDartsFile(this->getDeltaDartsFilename(), true);
+
+    this->beginTransaction(this->wordlistp);
+    try {
+      StatementFinalizer update_stmt(this->wordlistp, "UPDATE wordlist SET idlist = ?, entries = ? WHERE id = ?;");
+      _execSql(this->wordlistp, "CREATE TABLE IF NOT EXISTS wordlist_completion_stale(id INTEGER PRIMARY KEY);");
+      StatementFinalizer stale_stmt(this->wordlistp, "INSERT OR IGNORE INTO wordlist_completion_stale VALUES (?);");
+      for (SurfaceIdlistMap::iterator it = surface_idlist.begin(); it != surface_idlist.end(); it++) {
+        int id = _findWordlistId(base_dap, delta_dap, (*it).first);
+        if (id < 0 || !this->findWordlistById(id, wordlist)) continue;
+
+        // 辞書の地名語の要素を除き、残す地名語の ID を集める
+        std::vector<WordlistEntry> entries;
+        std::set<std::string> removed_ids, kept_ids;
+        const std::vector<WordlistEntry>& old_entries = wordlist.get_entries();
+        for (std::vector<WordlistEntry>::const_iterator it2 = old_entries.begin(); it2 != old_entries.end(); it2++) {
+          if ((*it2).dictionary_id == dictionary_id) {
+            removed_ids.insert((*it2).geonlp_id);
+          } else {
+            entries.push_back(*it2);
+            kept_ids.insert((*it2).geonlp_id);
+          }
+        }
+
+        // geonlp_id:代表表記 の要素のうち、他の辞書にも残る地名語と
+        // 辞書の地名語ではないものを残す
+        const std::string& old_idlist = wordlist.get_idlist();
+        std::string idlist;
+        size_t pos = 0;
+        while (pos < old_idlist.length()) {
+          size_t next = old_idlist.find('/', pos);
+          if (next == std::string::npos) next = old_idlist.length();
+          std::string item = old_idlist.substr(pos, next - pos);
+          std::string geonlp_id = item.substr(0, item.find(':'));
+          if (removed_ids.find(geonlp_id) == removed_ids.end() || kept_ids.find(geonlp_id) != kept_ids.end()) {
+            if (idlist.length() > 0) idlist += "/";
+            idlist += item;
+          }
+          pos = next + 1;
+        }
+
+        Wordlist::encodeEntries(entries, blob);
+        sqlite3_bind_text(update_stmt, 1, idlist.c_str(), idlist.length(), SQLITE_TRANSIENT);
+        sqlite3_bind_blob(update_stmt, 2, blob.data(), blob.length(), SQLITE_TRANSIENT);
+        sqlite3_bind_int(update_stmt, 3, id);
+        rc = sqlite3_step(update_stmt);
+        sqlite3_reset(update_stmt);
+        if (rc != SQLITE_DONE) {
+          throw SqliteErrException(rc, sqlite3_errmsg(this->wordlistp));
+        }
+        _markCompletionStale(this->wordlistp, stale_stmt, id);
+      }
+
+      std::ostringstream oss;
+      oss << "DELETE FROM wordlist_dictionary WHERE id = " << dictionary_id << ";";
+      _execSql(this->wordlistp, oss.str().c_str());
+      _markSpatialStale(this->wordlistp, dictionary_id);
+      this->commit(this->wordlistp);
+    } catch (...) {
+      this->rollback(this->wordlistp);
+      throw;
+    }
   }
 
   /// @brief geowordテーブルから得られた情報が、期待する順序でカラムが並んでいることを確認する
@@ -1091,6 +2647,17 @@ namespace geonlp
     out.initByJson(azResult[3]); // "json" フィールドを parse する
   }
 
+  /// @brief SELECT json FROM geoword の結果を地名語エントリクラスに変換する
+  ///
+  /// @arg @c stmt [in] 実行中の statement
+  /// @arg @c out [out] 地名語エントリクラス
+  void DBAccessor::resultToGeoword(sqlite3_stmt* stmt, Geoword& out) const
+  {
+    StatsTimer timer(this->stats, STATS_JSON_DECODE);
+    const char* json = (const char*)sqlite3_column_text(stmt, 0);
+    out.initByJson(json ? json : "{}");
+  }
+
   /// @brief dictionaryテーブルから得られた情報を辞書オブジェクトに変換する
   ///
   /// @arg @c azResult [in] Sqlite3から得られた情報
@@ -1105,6 +2672,16 @@ namespace geonlp
     // out.set_value("_internal_id", internal_id);
   }
 
+  /// @brief SELECT id, identifier, json FROM dictionary の結果を辞書オブジェクトに変換する
+  ///
+  /// @arg @c stmt [in] 実行中の statement
+  /// @arg @c out [out] 辞書オブジェクト
+  void DBAccessor::resultToDictionary(sqlite3_stmt* stmt, Dictionary& out) const
+  {
+    const char* json = (const char*)sqlite3_column_text(stmt, 2);
+    out.initByJson(json ? json : "{}");
+  }
+
   /// @brief wordlistテーブルから得られた情報を単語IDリストクラスに変換する。
   ///
   /// @arg @c azResult [in] Sqlite3から得られた情報
@@ -1118,6 +2695,28 @@ namespace geonlp
     out.set_yomi( *azResult ? *azResult : ""); azResult++;
   }
 
+  /// @brief SELECT id, key, surface, idlist, yomi, entries FROM wordlist の結果を単語IDリストクラスに変換する。
+  ///
+  /// @arg @c stmt [in] 実行中の statement
+  /// @arg @c out [out] 単語IDリストクラス
+  void DBAccessor::resultToWordlist(sqlite3_stmt* stmt, Wordlist& out) const
+  {
+    const char* p;
+    out.set_id((unsigned int)sqlite3_column_int64(stmt, 0));
+    p = (const char*)sqlite3_column_text(stmt, 1);
+    out.set_key(p ? p : "");
+    p = (const char*)sqlite3_column_text(stmt, 2);
+    out.set_surface(p ? p : "");
+    p = (const char*)sqlite3_column_text(stmt, 3);
+    out.set_idlist(p ? p : "");
+    p = (const char*)sqlite3_column_text(stmt, 4);
+    out.set_yomi(p ? p : "");
+    std::vector<WordlistEntry> entries;
+    const void* blob = sqlite3_column_blob(stmt, 5);
+    if (blob) Wordlist::decodeEntries(blob, sqlite3_column_bytes(stmt, 5), entries);
+    out.set_entries(entries);
+  }
+
   /// @breaf geoword, dictionary, wordlist テーブルを作成する
   /// 既にテーブルが存在すれば何もしない
   void DBAccessor::createTables() const
@@ -1135,6 +2734,14 @@ namespace geonlp
       throw SqliteErrException(rc, errmsg.c_str());
     }
 
+    // 辞書単位の削除やインデックスの差分更新で利用する
+    rc = sqlite3_exec(sqlitep, "CREATE INDEX IF NOT EXISTS geoword_dictionary_id ON geoword(dictionary_id);", NULL, NULL, &zErrMsg);
+    if (zErrMsg || rc != SQLITE_OK) {
+      std::string errmsg = zErrMsg;
+      sqlite3_free(zErrMsg);
+      throw SqliteErrException(rc, errmsg.c_str());
+    }
+
     rc = sqlite3_exec(sqlitep, "CREATE TABLE IF NOT EXISTS dictionary(id INTEGER PRIMARY KEY, identifier VARCHAR UNIQUE, json VARCHAR);", NULL, NULL, &zErrMsg);
     if (zErrMsg || rc != SQLITE_OK) {
       std::string errmsg = zErrMsg;
@@ -1142,7 +2749,7 @@ namespace geonlp
       throw SqliteErrException(rc, errmsg.c_str());
     }
 
-    rc = sqlite3_exec(wordlistp, "CREATE TABLE IF NOT EXISTS wordlist(id INTEGER PRIMARY KEY, key VARCHAR, surface VARCHAR, idlist VARCHAR, yomi VARCHAR);", NULL, NULL, &zErrMsg);
+    rc = sqlite3_exec(wordlistp, "CREATE TABLE IF NOT EXISTS wordlist(id INTEGER PRIMARY KEY, key VARCHAR, surface VARCHAR, idlist VARCHAR, yomi VARCHAR, entries BLOB);", NULL, NULL, &zErrMsg);
     if (zErrMsg || rc != SQLITE_OK) {
       std::string errmsg = zErrMsg;
       sqlite3_free(zErrMsg);
@@ -1191,7 +2798,7 @@ namespace geonlp
 
     // wordlist と同じスキーマを持つテーブルを作成する
     // create table .. as select は PRIMARY KEY がコピーされないので不可
-    rc = sqlite3_exec(wordlistp, "CREATE TABLE wordlist_tmp(id INTEGER PRIMARY KEY, key VARCHAR, surface VARCHAR, idlist VARCHAR, yomi VARCHAR);", NULL, NULL, &zErrMsg);
+    rc = sqlite3_exec(wordlistp, "CREATE TABLE wordlist_tmp(id INTEGER PRIMARY KEY, key VARCHAR, surface VARCHAR, idlist VARCHAR, yomi VARCHAR, entries BLOB);", NULL, NULL, &zErrMsg);
     if (zErrMsg || rc != SQLITE_OK) {
       std::string errmsg = zErrMsg;
       sqlite3_free(zErrMsg);
@@ -1200,26 +2807,161 @@ namespace geonlp
   }
 
   /// @brief wordlist に含まれる ID を持つ Geoword をデータベースから取得する
+  ///
+  /// record_only が true で geoword テーブルがバイナリレコードを持つ場合、
+  /// JSON を解析せずに主要項目（表記、読み、辞書、固有名クラス、経緯度など）だけを持つ
+  /// Geoword を返す。形態素解析中のアクティブ判定や代表表記の生成に利用する。
   /// @arg @c wordlist  ID リストを含む wordlist
   /// @arg ret          地名語エントリのリスト
   /// @arg limit        取得する Geoword 件数の上限、0 の場合全件
+  /// @arg record_only  主要項目だけでよい場合 true
+  /// @arg entry_indexes [out] NULL でなければ、 ret の各地名語に対応する wordlist.get_entries() の位置
+  ///                    （デコード済みの地名語IDリストを持たない場合は空）
   /// @return           取得した件数
-  int DBAccessor::getGeowordListFromWordlist(const Wordlist& wordlist, std::vector<Geoword>& ret, int limit) const {
-    const std::string& idlist = wordlist.get_idlist();
+  int DBAccessor::getGeowordListFromWordlist(const Wordlist& wordlist, std::vector<Geoword>& ret, int limit, bool record_only, std::vector<size_t>* entry_indexes) const {
     Geoword geoword;
 
     ret.clear();
-    boost::regex pattern = boost::regex("([^\\/:]+):([^\\/:]*)", boost::regex_constants::egrep);
+    if (entry_indexes) entry_indexes->clear();
+    const std::vector<WordlistEntry>& entries = wordlist.get_entries();
+    if (entries.size() > 0) {
+      // デコード済みの地名語IDリストを利用する
+      for (size_t i = 0; i < entries.size(); i++) {
+        if (this->findGeowordByEntry(entries[i], geoword, record_only)) {
+          ret.push_back(geoword);
+          if (entry_indexes) entry_indexes->push_back(i);
+        }
+        if (limit > 0 && int(ret.size()) >= limit) break;
+      }
+      return ret.size();
+    }
 
-    for (boost::sregex_iterator it = boost::make_regex_iterator(idlist, pattern); it != boost::sregex_iterator(); it++) {
-      std::string geonlp_id = (*it)[1]; // geonlp_id
-      // (*it)[2]; // typical name
-      if (this->findGeowordById(geonlp_id, geoword)) ret.push_back(geoword);
+    // 古い形式のデータベースの場合は idlist 文字列から取得する
+    std::vector<std::string> geonlp_ids;
+    Wordlist::parseIdlist(wordlist.get_idlist(), geonlp_ids);
+    for (std::vector<std::string>::iterator it = geonlp_ids.begin(); it != geonlp_ids.end(); it++) {
+      if (this->findGeowordById(*it, geoword)) ret.push_back(geoword);
       if (limit > 0 && int(ret.size()) >= limit) break;
     }
     return ret.size();
   }
 
+  /// @brief デコード済みの地名語IDリストの要素に対応する地名語を取得する
+  ///
+  /// キャッシュに無い場合は rowid で geoword テーブルを検索する。
+  /// wordlist 作成後に地名語が登録し直されて rowid が一致しない場合は geonlp_id で検索する。
+  /// record_only が true の場合は完全な地名語のキャッシュに無ければ
+  /// バイナリレコードを参照し、レコードが無い場合は JSON から取得する。
+  /// @arg @c entry       地名語IDリストの要素
+  /// @arg ret            地名語
+  /// @arg @c record_only 主要項目だけでよい場合 true
+  /// @return 見つかった場合 true
+  bool DBAccessor::findGeowordByEntry(const WordlistEntry& entry, Geoword& ret, bool record_only) const {
+    if (entry.geonlp_id.empty()) return false;
+    if ( NULL == sqlitep) throw SqliteNotInitializedException();
+
+    // キャッシュチェック
+    bool hit = this->geoword_cache->get(entry.geonlp_id, ret);
+    if (this->stats) this->stats->addCacheLookup(STATS_GEOWORD_CACHE, hit);
+    if (hit) return true;
+    record_only = record_only && this->geoword_has_record;
+    if (record_only && this->geoword_record_cache->get(entry.geonlp_id, ret)) {
+      return true;
+    }
+
+    bool found = false;
+    {
+      StatementLease stmt(*this, record_only ? STMT_GEOWORD_RECORD_BY_ROWID : STMT_GEOWORD_BY_ROWID);
+      sqlite3_bind_int64(stmt, 1, (sqlite3_int64)entry.rowid);
+      if (this->stepStatement(stmt)) {
+        const char* geonlp_id = (const char*)sqlite3_column_text(stmt, 0);
+        if (geonlp_id && entry.geonlp_id == geonlp_id) {
+          if (record_only) {
+            StatsTimer timer(this->stats, STATS_RECORD_DECODE);
+            const void* record = sqlite3_column_blob(stmt, 1);
+            found = record && ret.initByRecord(record, sqlite3_column_bytes(stmt, 1));
+          } else {
+            StatsTimer timer(this->stats, STATS_JSON_DECODE);
+            const char* json = (const char*)sqlite3_column_text(stmt, 1);
+            ret.initByJson(json ? json : "{}");
+            found = true;
+          }
+        }
+      }
+    }
+    if (!found) return this->findGeowordById(entry.geonlp_id, ret);
+
+    // キャッシュに登録
+    if (record_only) {
+      this->geoword_record_cache->put(ret);
+    } else {
+      this->geoword_cache->put(ret);
+    }
+    return ret.isValid();
+  }
+
+  /// @brief 辞書、地名語、見出し語とインデックスを一つのバンドルファイルに書き出す
+  ///
+  /// 書き出したファイルは DictionaryBundle で mmap して参照する。
+  /// 地名語はバイナリレコードを持たない場合もここで作成して保存し、
+  /// 差分更新で追加された見出し語は本体と一つの darts にまとめる。
+  /// @arg @c filename バンドルファイル名
+  /// @exception SqliteNotInitializedException Sqlite3が未初期化。
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception BundleException ファイルの書き込みに失敗。
+  void DBAccessor::exportBundle(const std::string& filename) const
+  {
+    if ( NULL == sqlitep) throw SqliteNotInitializedException();
+    if ( NULL == wordlistp) throw SqliteNotInitializedException();
+    this->createTables(); // テーブルが存在していなければ作成しておく
+
+    DictionaryBundleWriter writer(filename);
+
+    // 辞書
+    {
+      StatementFinalizer stmt(this->sqlitep, "SELECT id, identifier, json FROM dictionary;");
+      while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* identifier = (const char*)sqlite3_column_text(stmt, 1);
+        const char* json = (const char*)sqlite3_column_text(stmt, 2);
+        writer.addDictionary(sqlite3_column_int(stmt, 0), identifier ? identifier : "", json ? json : "{}");
+      }
+    }
+
+    // 地名語、 sqlite の文字列比較はバイト順なので地名語IDの昇順に並ぶ
+    {
+      StatementFinalizer stmt(this->sqlitep, this->geoword_has_record ?
+                              "SELECT geonlp_id, dictionary_id, json, record FROM geoword ORDER BY geonlp_id;" :
+                              "SELECT geonlp_id, dictionary_id, json, NULL FROM geoword ORDER BY geonlp_id;");
+      Geoword geoword;
+      std::string record;
+      while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* geonlp_id = (const char*)sqlite3_column_text(stmt, 0);
+        if (!geonlp_id || !*geonlp_id) continue;
+        const char* json = (const char*)sqlite3_column_text(stmt, 2);
+        const void* blob = sqlite3_column_blob(stmt, 3);
+        if (blob) {
+          record.assign((const char*)blob, sqlite3_column_bytes(stmt, 3));
+        } else {
+          geoword.initByJson(json ? json : "{}");
+          if (!geoword.toRecord(record)) record.clear();
+        }
+        writer.addGeoword(geonlp_id, sqlite3_column_int(stmt, 1), record, json ? json : "{}");
+      }
+    }
+
+    // 見出し語
+    {
+      Wordlist wordlist;
+      StatementLease stmt(*this, STMT_ALL_WORDLISTS);
+      while (this->stepStatement(stmt)) {
+        resultToWordlist(stmt, wordlist);
+        writer.addWordlist(wordlist);
+      }
+    }
+
+    writer.close();
+  }
+
   /// 辞書管理関連メソッド
 
   /// @brief 辞書テーブルをクリアする
@@ -1288,27 +3030,10 @@ namespace geonlp
     }
 
     this->commit(this->sqlitep);
-  }
-
-  /// キャッシュ関連メソッド
-  std::map<std::string, Geoword> DBAccessor::geoword_cache;
-
-  bool DBAccessor::searchGeowordFromCache(const std::string& geonlp_id, Geoword& geoword) {
-    std::map<std::string, Geoword>::iterator it = DBAccessor::geoword_cache.find(geonlp_id);
-    if (it == DBAccessor::geoword_cache.end()) return false;
-    geoword = (*it).second;
-    return true;
-  }
-
-  void DBAccessor::addGeowordToCache(const Geoword& geoword) {
-    if (!geoword.isValid()) return;
-    if (DBAccessor::geoword_cache.size() > GEOWORD_CACHE_SIZE) DBAccessor::clearGeowordCache();
-    const std::string& geonlp_id = geoword.get_geonlp_id();
-    DBAccessor::geoword_cache[geonlp_id] = geoword;
-  }
 
-  void DBAccessor::clearGeowordCache(void) {
-    DBAccessor::geoword_cache.clear();
+    // 削除した辞書の地名語をキャッシュから消す
+    this->geoword_cache->removeDictionary(dic_id);
+    this->geoword_record_cache->removeDictionary(dic_id);
   }
 
 }
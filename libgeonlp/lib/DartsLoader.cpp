@@ -0,0 +1,84 @@
+///
+/// @file
+/// @brief darts ファイル読み込み関数の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include "DartsLoader.h"
+
+namespace
+{
+  /// mmap した領域を DoubleArray と共に解放するデリータ
+  struct MmapDoubleArrayDeleter {
+    void* addr;
+    size_t length;
+    MmapDoubleArrayDeleter(void* a, size_t l): addr(a), length(l) {}
+    void operator()(Darts::DoubleArray* p) const {
+      delete p; // set_array で渡した領域は DoubleArray 側では解放されない
+      if (addr != MAP_FAILED) munmap(addr, length);
+    }
+  };
+}
+
+namespace geonlp
+{
+  /// @brief darts ファイルを開いて DoubleArray を返す。
+  /// @arg @c filename darts ファイル名
+  /// @arg @c use_mmap mmap で開く場合 true
+  /// @return DoubleArray へのポインタ、ファイルが存在しない場合は空ポインタ
+  /// @exception DartsException ファイルの読み込みに失敗した
+  DoubleArrayPtr openDartsFile(const std::string& filename, bool use_mmap) {
+    if (filename.length() == 0) return DoubleArrayPtr();
+
+    if (!use_mmap) {
+      FILE* fp = fopen(filename.c_str(), "r");
+      if (fp == NULL) return DoubleArrayPtr();
+      fclose(fp);
+      DoubleArrayPtr dap = DoubleArrayPtr(new Darts::DoubleArray());
+      dap->open(filename.c_str());
+      return dap;
+    }
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return DoubleArrayPtr();
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw DartsException(std::string("Can't stat darts file '") + filename + "'.");
+    }
+    size_t length = static_cast<size_t>(st.st_size);
+    if (length == 0) {
+      ::close(fd);
+      return DoubleArrayPtr();
+    }
+
+    void* addr = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // マップ後はファイルディスクリプタは不要
+    if (addr == MAP_FAILED) {
+      throw DartsException(std::string("Can't mmap darts file '") + filename + "'.");
+    }
+#ifdef MADV_WILLNEED
+    madvise(addr, length, MADV_WILLNEED);
+#endif /* MADV_WILLNEED */
+
+    Darts::DoubleArray* p = NULL;
+    try {
+      p = new Darts::DoubleArray();
+    } catch (...) {
+      munmap(addr, length);
+      throw;
+    }
+    DoubleArrayPtr dap(p, MmapDoubleArrayDeleter(addr, length));
+    // PROT_READ でマップした領域だが、検索時に darts が書き込むことはない
+    dap->set_array(addr, length / dap->unit_size());
+    return dap;
+  }
+}
@@ -0,0 +1,154 @@
+///
+/// @file
+/// @brief darts の部分木をたどる検索関数の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include <algorithm>
+#include "DartsSearch.h"
+
+namespace geonlp
+{
+  /// @brief darts の要素、 Darts::DoubleArray の unit_t と同じ配置
+  ///
+  /// 子の節点は base + 文字コード + 1 の位置にあり、 check に親の base を持つ。
+  /// 終端（文字コード 0）は base の位置にあり、 base に -(値 + 1) を持つ。
+  struct DartsUnit {
+    Darts::DoubleArray::value_type base;
+    unsigned int check;
+  };
+
+  /// @brief UTF-8 の先頭バイトから文字のバイト数を得る
+  static inline size_t _utf8Length(unsigned char c) {
+    if (c < 0x80) return 1;
+    if ((c & 0xe0) == 0xc0) return 2;
+    if ((c & 0xf0) == 0xe0) return 3;
+    if ((c & 0xf8) == 0xf0) return 4;
+    return 1;
+  }
+
+  /// @brief darts で前方一致する全ての見出し語の値を得る。
+  ///
+  /// prefix に対応する節点まで traverse() で進み、その下の部分木を深さ優先でたどる。
+  /// @arg @c da     見出し語の darts
+  /// @arg @c prefix 前方一致文字列
+  /// @arg @c ret    [out] 見出し語の値のリスト、見出し語の文字コード順
+  void predictiveSearch(const Darts::DoubleArray& da, const std::string& prefix, std::vector<int>& ret)
+  {
+    size_t node_pos = 0, key_pos = 0;
+    ret.clear();
+    if (da.size() == 0 || da.unit_size() != sizeof(DartsUnit)) return;
+    if (da.traverse(prefix.c_str(), node_pos, key_pos, prefix.length()) == -2) return;
+
+    const DartsUnit* units = reinterpret_cast<const DartsUnit*>(da.array());
+    const size_t size = da.size();
+    std::vector<Darts::DoubleArray::value_type> stack;
+    stack.push_back(units[node_pos].base);
+    while (!stack.empty()) {
+      const Darts::DoubleArray::value_type b = stack.back();
+      stack.pop_back();
+      if (b <= 0 || size_t(b) >= size) continue;  // 使用中の節点の base は 1 以上
+      if (units[b].check == static_cast<unsigned int>(b) && units[b].base < 0) {
+        ret.push_back(-units[b].base - 1);
+      }
+      // 文字コードの降順に積み、昇順に取り出す
+      for (int c = 255; c >= 0; c--) {
+        size_t p = size_t(b) + c + 1;
+        if (p >= size) continue;
+        if (units[p].check == static_cast<unsigned int>(b)) stack.push_back(units[p].base);
+      }
+    }
+  }
+
+  /// @brief fuzzySearch() で darts をたどる状態
+  class FuzzyWalker {
+  private:
+    const DartsUnit* units;
+    size_t size;
+    std::vector<std::string> chars;  ///< 検索文字列の文字
+    unsigned int max_distance;
+    std::vector<FuzzyResult>& ret;
+    std::string key;                 ///< たどっている節点までの見出し語
+
+  public:
+    FuzzyWalker(const Darts::DoubleArray& da, const std::string& str, unsigned int max_distance, std::vector<FuzzyResult>& ret)
+      : units(reinterpret_cast<const DartsUnit*>(da.array())), size(da.size()), max_distance(max_distance), ret(ret) {
+      for (size_t i = 0; i < str.length(); ) {
+        size_t len = std::min(_utf8Length(str[i]), str.length() - i);
+        this->chars.push_back(str.substr(i, len));
+        i += len;
+      }
+    }
+
+    /// @brief 根から探索する
+    void run(void) {
+      std::vector<unsigned int> row(this->chars.size() + 1);
+      for (size_t j = 0; j < row.size(); j++) row[j] = j;
+      this->walk(this->units[0].base, row, 0, 0);
+    }
+
+    /// @brief 節点 b の下をたどる
+    /// @arg @c b          節点の base
+    /// @arg @c row        最後に読み終えた文字までの編集距離の表の行
+    /// @arg @c pending    読み途中の文字の残りバイト数
+    /// @arg @c char_start 読み途中の文字の key 内の開始位置
+    void walk(Darts::DoubleArray::value_type b, const std::vector<unsigned int>& row, size_t pending, size_t char_start) {
+      if (b <= 0 || size_t(b) >= this->size) return;
+      if (pending == 0 && this->units[b].check == static_cast<unsigned int>(b) && this->units[b].base < 0
+          && row.back() <= this->max_distance) {
+        FuzzyResult r;
+        r.value = -this->units[b].base - 1;
+        r.key = this->key;
+        r.distance = row.back();
+        this->ret.push_back(r);
+      }
+      // 文字の途中では継続バイト (0x80-0xbf) だけを調べる
+      const int first = (pending > 0) ? 0x80 : 0x00;
+      const int last = (pending > 0) ? 0xbf : 0xff;
+      std::vector<unsigned int> next_row(row.size());
+      for (int c = first; c <= last; c++) {
+        if (pending == 0 && c >= 0x80 && c <= 0xbf) continue;
+        size_t p = size_t(b) + c + 1;
+        if (p >= this->size) break;
+        if (this->units[p].check != static_cast<unsigned int>(b)) continue;
+
+        const size_t start = (pending == 0) ? this->key.length() : char_start;
+        const size_t rest = (pending == 0) ? _utf8Length(c) - 1 : pending - 1;
+        this->key.push_back(char(c));
+        if (rest > 0) {
+          this->walk(this->units[p].base, row, rest, start);
+        } else {
+          // 一文字読み終えたので表の行を進める
+          const std::string_view ch = std::string_view(this->key).substr(start);
+          unsigned int min_distance = next_row[0] = row[0] + 1;
+          for (size_t j = 1; j < row.size(); j++) {
+            unsigned int d = row[j - 1] + ((ch == this->chars[j - 1]) ? 0 : 1);
+            d = std::min(d, row[j] + 1);
+            d = std::min(d, next_row[j - 1] + 1);
+            next_row[j] = d;
+            min_distance = std::min(min_distance, d);
+          }
+          if (min_distance <= this->max_distance) {
+            this->walk(this->units[p].base, next_row, 0, 0);
+          }
+        }
+        this->key.pop_back();
+      }
+    }
+  };
+
+  /// @brief 検索文字列との編集距離が max_distance 以下の見出し語を全て得る。
+  /// @arg @c da           見出し語の darts
+  /// @arg @c key          検索文字列（UTF-8）
+  /// @arg @c max_distance 許容する編集距離
+  /// @arg @c ret          [out] 一致した見出し語のリスト、見出し語の文字コード順
+  void fuzzySearch(const Darts::DoubleArray& da, const std::string& key, unsigned int max_distance, std::vector<FuzzyResult>& ret)
+  {
+    ret.clear();
+    if (da.size() == 0 || da.unit_size() != sizeof(DartsUnit)) return;
+    FuzzyWalker walker(da, key, max_distance, ret);
+    walker.run();
+  }
+
+}
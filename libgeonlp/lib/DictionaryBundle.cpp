@@ -0,0 +1,669 @@
+///
+/// @file
+/// @brief 辞書バンドルファイルの読み書きクラス DictionaryBundle, DictionaryBundleWriter の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#include "config.h"
+#include "DictionaryBundle.h"
+#include "DartsException.h"
+#ifdef HAVE_LIBDAMS
+#include <dams.h>
+#endif /* HAVE_LIBDAMS */
+
+namespace
+{
+  /// バンドルファイルの先頭の識別子
+  const char BUNDLE_MAGIC[8] = { 'G', 'E', 'O', 'N', 'L', 'P', 'B', '\0' };
+
+  /// 書き出したホストと同じバイト順かどうかを確認するための値
+  const uint32_t BUNDLE_BYTE_ORDER = 0x01020304;
+
+  /// 見出し語IDの欠番を表す位置
+  const uint64_t BUNDLE_NO_ENTRY = UINT64_MAX;
+
+  /// バンドルファイル内の領域
+  enum BundleSectionType {
+    SECTION_GEOWORD_DATA = 0,   ///< 地名語（地名語IDの順）
+    SECTION_WORDLIST_DATA,      ///< 見出し語
+    SECTION_GEOWORD_INDEX,      ///< 地名語の位置の配列
+    SECTION_WORDLIST_INDEX,     ///< 見出し語IDごとの見出し語の位置の配列
+    SECTION_DICTIONARY_DATA,    ///< 辞書
+    SECTION_DARTS,              ///< 見出し語の darts
+    NUM_BUNDLE_SECTIONS
+  };
+
+  /// 領域の位置とバイト数
+  struct BundleSection {
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  /// @brief バンドルファイルのヘッダ。
+  ///
+  /// 数値はすべて書き出したホストのバイト順で、各領域は 8 バイト境界から始まる。
+  /// 地名語は 地名語ID, 辞書ID(int32), レコード, JSON の順、
+  /// 見出し語は 見出し語, 表記, idlist, 読み, 地名語数(uint32) に続けて、地名語ごとに
+  /// 地名語の位置(uint32), 表記のハッシュ値の数(uint32), ハッシュ値(uint64)の配列 の順、
+  /// 辞書は 内部ID(int32), identifier, JSON の順に並べる。
+  /// 文字列は uint32 のバイト数に続けて内容を置く。
+  struct BundleHeader {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t version;
+    uint64_t file_size;
+    uint64_t num_geowords;
+    uint64_t num_wordlists;
+    uint64_t num_dictionaries;
+    BundleSection sections[NUM_BUNDLE_SECTIONS];
+  };
+
+  /// @brief バンドルファイル内の領域を先頭から順に読むクラス。
+  /// 領域の外を読もうとした場合は BundleException を投げる。
+  class BundleCursor {
+  private:
+    const char* p;
+    const char* end;
+
+  public:
+    BundleCursor(std::string_view area, uint64_t offset): p(area.data()), end(area.data() + area.size()) {
+      if (offset > area.size()) throw geonlp::BundleException("The dictionary bundle is broken.");
+      p += offset;
+    }
+
+    /// @brief 残りが size バイト未満の場合は BundleException を投げる
+    /// ファイルから読んだ要素数で領域を確保する前に、要素の大きさの合計で呼び出すこと。
+    inline void require(uint64_t size) const {
+      if (uint64_t(end - p) < size) throw geonlp::BundleException("The dictionary bundle is broken.");
+    }
+
+    inline uint32_t u32(void) {
+      uint32_t v;
+      require(sizeof(v));
+      memcpy(&v, p, sizeof(v));
+      p += sizeof(v);
+      return v;
+    }
+
+    inline int32_t i32(void) {
+      int32_t v;
+      require(sizeof(v));
+      memcpy(&v, p, sizeof(v));
+      p += sizeof(v);
+      return v;
+    }
+
+    inline uint64_t u64(void) {
+      uint64_t v;
+      require(sizeof(v));
+      memcpy(&v, p, sizeof(v));
+      p += sizeof(v);
+      return v;
+    }
+
+    inline std::string_view str(void) {
+      uint32_t len = this->u32();
+      require(len);
+      std::string_view v(p, len);
+      p += len;
+      return v;
+    }
+  };
+
+  /// @brief 数値をバッファに追加する
+  template <typename T>
+  inline void _append(std::string& buf, T v) {
+    buf.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+
+  /// @brief 長さ付きの文字列をバッファに追加する
+  inline void _appendString(std::string& buf, const std::string& str) {
+    _append(buf, uint32_t(str.length()));
+    buf.append(str);
+  }
+}
+
+namespace geonlp
+{
+  /// @brief バンドルファイルを開く。
+  ///
+  /// ファイルを読み取り専用で mmap し、形式と各領域の範囲を確認する。
+  /// 辞書情報だけはここで解析して保持する。
+  /// @arg @c filename バンドルファイル名
+  /// @exception BundleException ファイルが開けない、または形式が正しくない
+  DictionaryBundle::DictionaryBundle(const std::string& filename):
+    filename(filename), addr(MAP_FAILED), length(0),
+    geoword_index(NULL), num_geowords(0), wordlist_index(NULL), num_wordlists(0)
+  {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw BundleException(std::string("Can't open dictionary bundle '") + filename + "'.");
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw BundleException(std::string("Can't stat dictionary bundle '") + filename + "'.");
+    }
+    this->length = static_cast<size_t>(st.st_size);
+    if (this->length < sizeof(BundleHeader)) {
+      ::close(fd);
+      throw BundleException(std::string("'") + filename + "' is not a dictionary bundle.");
+    }
+    this->addr = mmap(NULL, this->length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // マップ後はファイルディスクリプタは不要
+    if (this->addr == MAP_FAILED) {
+      throw BundleException(std::string("Can't mmap dictionary bundle '") + filename + "'.");
+    }
+#ifdef MADV_WILLNEED
+    madvise(this->addr, this->length, MADV_WILLNEED);
+#endif /* MADV_WILLNEED */
+
+    const char* base = static_cast<const char*>(this->addr);
+    try {
+      BundleHeader header;
+      memcpy(&header, base, sizeof(header));
+      if (memcmp(header.magic, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) != 0) {
+        throw BundleException(std::string("'") + filename + "' is not a dictionary bundle.");
+      }
+      if (header.byte_order != BUNDLE_BYTE_ORDER) {
+        throw BundleException(std::string("The byte order of dictionary bundle '") + filename + "' differs from this host.");
+      }
+      if (header.version != DICTIONARY_BUNDLE_VERSION) {
+        throw BundleException(std::string("The format version of dictionary bundle '") + filename + "' is not supported.");
+      }
+      if (header.file_size != this->length) {
+        throw BundleException(std::string("Dictionary bundle '") + filename + "' is truncated.");
+      }
+      for (int i = 0; i < NUM_BUNDLE_SECTIONS; i++) {
+        const BundleSection& s = header.sections[i];
+        if (s.offset < sizeof(BundleHeader) || s.offset % 8 != 0 || s.offset > this->length || s.size > this->length - s.offset) {
+          throw BundleException(std::string("Dictionary bundle '") + filename + "' is broken.");
+        }
+      }
+      const BundleSection& gi = header.sections[SECTION_GEOWORD_INDEX];
+      const BundleSection& wi = header.sections[SECTION_WORDLIST_INDEX];
+      const BundleSection& ds = header.sections[SECTION_DARTS];
+      if (gi.size != header.num_geowords * sizeof(uint64_t)
+          || wi.size != header.num_wordlists * sizeof(uint64_t)
+          || ds.size % this->da.unit_size() != 0) {
+        throw BundleException(std::string("Dictionary bundle '") + filename + "' is broken.");
+      }
+
+      const BundleSection& gd = header.sections[SECTION_GEOWORD_DATA];
+      const BundleSection& wd = header.sections[SECTION_WORDLIST_DATA];
+      this->geoword_data = std::string_view(base + gd.offset, gd.size);
+      this->geoword_index = reinterpret_cast<const uint64_t*>(base + gi.offset);
+      this->num_geowords = header.num_geowords;
+      this->wordlist_data = std::string_view(base + wd.offset, wd.size);
+      this->wordlist_index = reinterpret_cast<const uint64_t*>(base + wi.offset);
+      this->num_wordlists = header.num_wordlists;
+
+      // 辞書情報は少ないので解析しておく
+      const BundleSection& dd = header.sections[SECTION_DICTIONARY_DATA];
+      BundleCursor cursor(std::string_view(base + dd.offset, dd.size), 0);
+      for (uint64_t i = 0; i < header.num_dictionaries; i++) {
+        int id = cursor.i32();
+        std::string identifier(cursor.str());
+        std::string_view json = cursor.str();
+        Dictionary dictionary;
+        dictionary.initByJson(std::string(json));
+        this->dictionaries[id] = dictionary;
+        this->dictionary_ids[identifier] = id;
+      }
+
+      // PROT_READ でマップした領域だが、検索時に darts が書き込むことはない
+      if (ds.size > 0) {
+        this->da.set_array(const_cast<char*>(base + ds.offset), ds.size / this->da.unit_size());
+      }
+    } catch (...) {
+      munmap(this->addr, this->length);
+      this->addr = MAP_FAILED;
+      throw;
+    }
+  }
+
+  /// @brief デストラクタ、mmap した領域を解放する
+  DictionaryBundle::~DictionaryBundle()
+  {
+    this->da.clear(); // set_array で渡した領域は DoubleArray 側では解放されない
+    if (this->addr != MAP_FAILED) munmap(this->addr, this->length);
+  }
+
+  /// @brief 指定した位置の地名語の各項目を取り出す。
+  ///
+  /// 取り出した文字列は mmap した領域を指す。
+  /// @arg @c index          地名語の位置
+  /// @arg @c geonlp_id      [out] 地名語ID
+  /// @arg @c dictionary_id  [out] 辞書の内部 ID
+  /// @arg @c record         [out] 主要項目のバイナリレコード、無い場合は空
+  /// @arg @c json           [out] JSON
+  /// @exception BundleException ファイルが壊れている
+  void DictionaryBundle::readGeoword(size_t index, std::string_view& geonlp_id, int& dictionary_id, std::string_view& record, std::string_view& json) const
+  {
+    if (index >= this->num_geowords) throw BundleException("The dictionary bundle is broken.");
+    BundleCursor cursor(this->geoword_data, this->geoword_index[index]);
+    geonlp_id = cursor.str();
+    dictionary_id = cursor.i32();
+    record = cursor.str();
+    json = cursor.str();
+  }
+
+  /// @brief 指定した位置の地名語を取得する。
+  ///
+  /// record_only が true でバイナリレコードがある場合は JSON を解析しない。
+  /// @arg @c index        地名語の位置
+  /// @arg ret             地名語
+  /// @arg @c record_only  主要項目だけでよい場合 true
+  /// @return 地名語が有効な場合 true
+  bool DictionaryBundle::getGeowordAt(size_t index, Geoword& ret, bool record_only) const
+  {
+    std::string_view geonlp_id, record, json;
+    int dictionary_id;
+    this->readGeoword(index, geonlp_id, dictionary_id, record, json);
+    if (record_only && record.size() > 0 && ret.initByRecord(record.data(), record.size())) return true;
+    ret.initByJson(std::string(json));
+    return ret.isValid();
+  }
+
+  /// @brief 地名語IDから地名語の位置を二分探索する。
+  /// @arg @c geonlp_id 地名語ID
+  /// @return 地名語の位置、見つからない場合は -1
+  long DictionaryBundle::findGeowordIndex(const std::string& geonlp_id) const
+  {
+    size_t lo = 0, hi = this->num_geowords;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      BundleCursor cursor(this->geoword_data, this->geoword_index[mid]);
+      int c = cursor.str().compare(geonlp_id);
+      if (c == 0) return long(mid);
+      if (c < 0) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return -1;
+  }
+
+  /// @brief 指定した GeonlpID を持つ地名語を取得する。
+  ///
+  /// 一致する地名語が無い場合は ret.get_geonlp_id() が空文字列となる。
+  /// @arg @c id 地名語ID
+  /// @arg ret   地名語
+  /// @return 見つかった場合 true
+  bool DictionaryBundle::findGeowordById(const std::string& id, Geoword& ret) const
+  {
+    long index = this->findGeowordIndex(id);
+    if (index < 0) {
+      ret.initByJson("{\"geonlp_id\":\"\"}");
+      return false;
+    }
+    return this->getGeowordAt(size_t(index), ret, false);
+  }
+
+  /// @brief 辞書一覧を取得する
+  /// @arg ret 内部 ID をキー、辞書を値とするマップ
+  /// @return 件数
+  int DictionaryBundle::getDictionaryList(std::map<int, Dictionary>& ret) const
+  {
+    ret = this->dictionaries;
+    return ret.size();
+  }
+
+  /// @brief 内部 ID を持つ辞書の情報を取得する
+  /// @arg @c id 内部 ID
+  /// @arg ret   辞書
+  /// @return 見つかった場合 true
+  bool DictionaryBundle::getDictionaryById(int id, Dictionary& ret) const
+  {
+    std::map<int, Dictionary>::const_iterator it = this->dictionaries.find(id);
+    if (it == this->dictionaries.end()) {
+      ret.initByJson("{\"id\":0}");
+    } else {
+      ret = it->second;
+    }
+    return ret.isValid();
+  }
+
+  /// @brief identifier を持つ辞書の情報を取得する
+  /// @arg @c identifier 辞書の identifier
+  /// @arg ret           辞書
+  /// @return 見つかった場合 true
+  bool DictionaryBundle::getDictionary(const std::string& identifier, Dictionary& ret) const
+  {
+    std::map<std::string, int>::const_iterator it = this->dictionary_ids.find(identifier);
+    if (it == this->dictionary_ids.end()) {
+      ret.initByJson("{\"id\":0}");
+      return false;
+    }
+    ret = this->dictionaries.find(it->second)->second;
+    return true;
+  }
+
+  /// @brief 見出し語IDの最大値を取得する
+  /// @return 最大 ID、見出し語が無い場合は -1
+  int DictionaryBundle::getMaxWordlistId(void) const
+  {
+    return int(this->num_wordlists) - 1;
+  }
+
+  /// @brief 見出し語IDを持つ Wordlist を取得する。
+  ///
+  /// デコード済みの地名語IDリストの rowid にはバンドル内の地名語の位置を設定する。
+  /// @arg @c id 見出し語ID
+  /// @arg ret   Wordlist、見つからない場合は get_surface() == ""
+  /// @return 見つかった場合 true
+  bool DictionaryBundle::findWordlistById(unsigned int id, Wordlist& ret) const
+  {
+    if (id >= this->num_wordlists || this->wordlist_index[id] == BUNDLE_NO_ENTRY) {
+      ret.set_surface("");
+      return false;
+    }
+    BundleCursor cursor(this->wordlist_data, this->wordlist_index[id]);
+    ret.set_id(id);
+    ret.set_key(std::string(cursor.str()));
+    ret.set_surface(std::string(cursor.str()));
+    ret.set_idlist(std::string(cursor.str()));
+    ret.set_yomi(std::string(cursor.str()));
+    uint32_t n = cursor.u32();
+    // 各地名語は少なくとも位置とハッシュ値の数を持つ
+    cursor.require(uint64_t(n) * 2 * sizeof(uint32_t));
+    std::vector<WordlistEntry> entries;
+    entries.reserve(n);
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t index = cursor.u32();
+      std::string_view geonlp_id, record, json;
+      int dictionary_id;
+      this->readGeoword(index, geonlp_id, dictionary_id, record, json);
+      entries.push_back(WordlistEntry(index, dictionary_id, std::string(geonlp_id)));
+      uint32_t n_hashes = cursor.u32();
+      cursor.require(uint64_t(n_hashes) * sizeof(uint64_t));
+      std::vector<unsigned long long>& hashes = entries.back().surface_hashes;
+      hashes.resize(n_hashes);
+      for (uint32_t j = 0; j < n_hashes; j++) hashes[j] = cursor.u64();
+    }
+    ret.set_entries(entries);
+    return ret.isValid();
+  }
+
+  /// @brief 見出し語に完全一致する Wordlist を取得する
+  /// @arg @c surface 見出し語
+  /// @arg ret        Wordlist、見つからない場合は get_surface() == ""
+  /// @return 見つかった場合 true
+  bool DictionaryBundle::findWordlistBySurface(const std::string& surface, Wordlist& ret) const
+  {
+#ifdef HAVE_LIBDAMS
+    std::string key(damswrapper::get_standardized_string(surface));
+#else
+    const std::string& key = surface;
+#endif /* HAVE_LIBDAMS */
+
+    ret.set_surface("");
+    if (this->da.size() == 0 || key.empty()) return false;
+    Darts::DoubleArray::value_type id = -1;
+    this->da.exactMatchSearch(key.c_str(), id, key.length());
+    if (id < 0) return false;
+    return this->findWordlistById((unsigned int)id, ret);
+  }
+
+  /// @brief Wordlist に含まれる地名語を取得する。
+  ///
+  /// バンドルの地名語は常にバイナリレコードを持つため、
+  /// record_only が true の場合は JSON を解析しない。
+  /// @arg @c wordlist    ID リストを含む Wordlist
+  /// @arg ret            地名語のリスト
+  /// @arg @c limit       取得する件数の上限、0 の場合全件
+  /// @arg @c record_only 主要項目だけでよい場合 true
+  /// @arg entry_indexes   [out] NULL でなければ、 ret の各地名語に対応する wordlist.get_entries() の位置
+  /// @return 取得した件数
+  int DictionaryBundle::getGeowordListFromWordlist(const Wordlist& wordlist, std::vector<Geoword>& ret, int limit, bool record_only, std::vector<size_t>* entry_indexes) const
+  {
+    Geoword geoword;
+
+    ret.clear();
+    if (entry_indexes) entry_indexes->clear();
+    const std::vector<WordlistEntry>& entries = wordlist.get_entries();
+    if (entries.size() > 0) {
+      for (size_t i = 0; i < entries.size(); i++) {
+        if (this->getGeowordAt(size_t(entries[i].rowid), geoword, record_only)) {
+          ret.push_back(geoword);
+          if (entry_indexes) entry_indexes->push_back(i);
+        }
+        if (limit > 0 && int(ret.size()) >= limit) break;
+      }
+      return ret.size();
+    }
+
+    // デコード済みの地名語IDリストを持たない場合は idlist 文字列から取得する
+    std::vector<std::string> geonlp_ids;
+    Wordlist::parseIdlist(wordlist.get_idlist(), geonlp_ids);
+    for (std::vector<std::string>::iterator it = geonlp_ids.begin(); it != geonlp_ids.end(); it++) {
+      if (this->findGeowordById(*it, geoword)) ret.push_back(geoword);
+      if (limit > 0 && int(ret.size()) >= limit) break;
+    }
+    return ret.size();
+  }
+
+  /// @brief 一時ファイルを作成し、ヘッダの領域を確保する。
+  /// @arg @c filename 書き出すファイル名
+  /// @exception BundleException 一時ファイルが作成できない
+  DictionaryBundleWriter::DictionaryBundleWriter(const std::string& filename):
+    filename(filename), tmp_fname(filename + ".tmp"), fp(NULL), pos(0), geoword_start(0), wordlist_start(0)
+  {
+    this->fp = fopen(this->tmp_fname.c_str(), "wb");
+    if (this->fp == NULL) throw BundleException(std::string("Cannot create a temporary file (") + this->tmp_fname + ")");
+    BundleHeader header;
+    memset(&header, 0, sizeof(header));
+    this->write(&header, sizeof(header));
+    this->geoword_start = this->pos;
+  }
+
+  /// @brief デストラクタ、close() していない場合は一時ファイルを削除する
+  DictionaryBundleWriter::~DictionaryBundleWriter()
+  {
+    if (this->fp) {
+      fclose(this->fp);
+      unlink(this->tmp_fname.c_str());
+    }
+  }
+
+  /// @brief データを一時ファイルに書き出す
+  /// @exception BundleException 書き込みに失敗
+  void DictionaryBundleWriter::write(const void* data, size_t size)
+  {
+    if (size > 0 && fwrite(data, 1, size, this->fp) != size) {
+      throw BundleException(std::string("Cannot write a temporary file (") + this->tmp_fname + ")");
+    }
+    this->pos += size;
+  }
+
+  /// @brief 次の領域が 8 バイト境界から始まるように 0 を書き出す
+  void DictionaryBundleWriter::align(void)
+  {
+    static const char zeros[8] = { 0 };
+    if (this->pos % 8 != 0) this->write(zeros, 8 - this->pos % 8);
+  }
+
+  /// @brief 辞書を追加する
+  /// @arg @c id          辞書の内部 ID
+  /// @arg @c identifier  辞書の identifier
+  /// @arg @c json        辞書の JSON
+  void DictionaryBundleWriter::addDictionary(int id, const std::string& identifier, const std::string& json)
+  {
+    this->dictionaries.push_back(std::make_pair(id, std::make_pair(identifier, json)));
+  }
+
+  /// @brief 地名語を追加する。
+  ///
+  /// 地名語は地名語IDの昇順に、見出し語より先に追加すること。
+  /// @arg @c geonlp_id      地名語ID
+  /// @arg @c dictionary_id  辞書の内部 ID
+  /// @arg @c record         主要項目のバイナリレコード、無い場合は空
+  /// @arg @c json           地名語の JSON
+  /// @exception BundleException 順序が正しくない、または書き込みに失敗
+  void DictionaryBundleWriter::addGeoword(const std::string& geonlp_id, int dictionary_id, const std::string& record, const std::string& json)
+  {
+    if (this->wordlist_start > 0) throw BundleException("Geowords must be added before wordlists.");
+    if (this->geonlp_ids.size() > 0 && !(this->geonlp_ids.back() < geonlp_id)) {
+      throw BundleException("Geowords must be added in ascending order of geonlp_id.");
+    }
+    this->geoword_offsets.push_back(this->pos - this->geoword_start);
+    this->geonlp_ids.push_back(geonlp_id);
+    this->geoword_dictionary_ids.push_back(dictionary_id);
+
+    this->buf.clear();
+    _appendString(this->buf, geonlp_id);
+    _append(this->buf, int32_t(dictionary_id));
+    _appendString(this->buf, record);
+    _appendString(this->buf, json);
+    this->write(this->buf.data(), this->buf.size());
+  }
+
+  /// @brief 見出し語を追加する。
+  ///
+  /// 地名語IDリストは追加済みの地名語の位置に変換する。
+  /// 追加されていない地名語は取り除く。
+  /// @arg @c wordlist 見出し語
+  /// @exception BundleException 見出し語IDが重複している、または書き込みに失敗
+  void DictionaryBundleWriter::addWordlist(const Wordlist& wordlist)
+  {
+    if (this->wordlist_start == 0) {
+      // ヘッダがあるため、見出し語の開始位置が 0 になることはない
+      this->align();
+      this->wordlist_start = this->pos;
+    }
+    unsigned int id = wordlist.get_id();
+    if (id >= this->wordlist_offsets.size()) this->wordlist_offsets.resize(id + 1, BUNDLE_NO_ENTRY);
+    if (this->wordlist_offsets[id] != BUNDLE_NO_ENTRY) throw BundleException("Duplicated wordlist id.");
+    this->wordlist_offsets[id] = this->pos - this->wordlist_start;
+
+    std::vector<WordlistEntry> entries = wordlist.get_entries();
+    if (entries.size() == 0) {
+      // 表記のハッシュ値は持たない
+      std::vector<std::string> ids;
+      Wordlist::parseIdlist(wordlist.get_idlist(), ids);
+      for (std::vector<std::string>::const_iterator it = ids.begin(); it != ids.end(); it++) {
+        entries.push_back(WordlistEntry(0, 0, *it));
+      }
+    }
+    std::vector<std::pair<uint32_t, const WordlistEntry*> > indexes;
+    for (std::vector<WordlistEntry>::const_iterator it = entries.begin(); it != entries.end(); it++) {
+      std::vector<std::string>::const_iterator found = std::lower_bound(this->geonlp_ids.begin(), this->geonlp_ids.end(), (*it).geonlp_id);
+      if (found != this->geonlp_ids.end() && *found == (*it).geonlp_id) {
+        indexes.push_back(std::make_pair(uint32_t(found - this->geonlp_ids.begin()), &(*it)));
+      }
+    }
+
+    this->buf.clear();
+    _appendString(this->buf, wordlist.get_key());
+    _appendString(this->buf, wordlist.get_surface());
+    _appendString(this->buf, wordlist.get_idlist());
+    _appendString(this->buf, wordlist.get_yomi());
+    _append(this->buf, uint32_t(indexes.size()));
+    for (std::vector<std::pair<uint32_t, const WordlistEntry*> >::const_iterator it = indexes.begin(); it != indexes.end(); it++) {
+      _append(this->buf, (*it).first);
+      const std::vector<unsigned long long>& hashes = (*it).second->surface_hashes;
+      _append(this->buf, uint32_t(hashes.size()));
+      for (std::vector<unsigned long long>::const_iterator h = hashes.begin(); h != hashes.end(); h++) {
+        _append(this->buf, uint64_t(*h));
+      }
+    }
+    this->write(this->buf.data(), this->buf.size());
+
+    if (wordlist.get_key().length() > 0) this->keys.push_back(std::make_pair(wordlist.get_key(), id));
+  }
+
+  /// @brief 索引、辞書、darts とヘッダを書き出し、一時ファイルを正規のファイル名に置き換える。
+  /// @exception BundleException 書き込みに失敗
+  /// @exception DartsException darts の構築に失敗
+  void DictionaryBundleWriter::close(void)
+  {
+    BundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC));
+    header.byte_order = BUNDLE_BYTE_ORDER;
+    header.version = DICTIONARY_BUNDLE_VERSION;
+
+    if (this->wordlist_start == 0) {
+      this->align();
+      this->wordlist_start = this->pos;
+    }
+    header.sections[SECTION_GEOWORD_DATA].offset = this->geoword_start;
+    header.sections[SECTION_GEOWORD_DATA].size = this->wordlist_start - this->geoword_start;
+    header.sections[SECTION_WORDLIST_DATA].offset = this->wordlist_start;
+    header.sections[SECTION_WORDLIST_DATA].size = this->pos - this->wordlist_start;
+
+    // 地名語の位置
+    this->align();
+    header.num_geowords = this->geoword_offsets.size();
+    header.sections[SECTION_GEOWORD_INDEX].offset = this->pos;
+    header.sections[SECTION_GEOWORD_INDEX].size = this->geoword_offsets.size() * sizeof(uint64_t);
+    if (this->geoword_offsets.size() > 0) this->write(&this->geoword_offsets[0], this->geoword_offsets.size() * sizeof(uint64_t));
+
+    // 見出し語の位置
+    this->align();
+    header.num_wordlists = this->wordlist_offsets.size();
+    header.sections[SECTION_WORDLIST_INDEX].offset = this->pos;
+    header.sections[SECTION_WORDLIST_INDEX].size = this->wordlist_offsets.size() * sizeof(uint64_t);
+    if (this->wordlist_offsets.size() > 0) this->write(&this->wordlist_offsets[0], this->wordlist_offsets.size() * sizeof(uint64_t));
+
+    // 辞書
+    this->align();
+    std::sort(this->dictionaries.begin(), this->dictionaries.end());
+    header.num_dictionaries = this->dictionaries.size();
+    header.sections[SECTION_DICTIONARY_DATA].offset = this->pos;
+    this->buf.clear();
+    for (size_t i = 0; i < this->dictionaries.size(); i++) {
+      _append(this->buf, int32_t(this->dictionaries[i].first));
+      _appendString(this->buf, this->dictionaries[i].second.first);
+      _appendString(this->buf, this->dictionaries[i].second.second);
+    }
+    this->write(this->buf.data(), this->buf.size());
+    header.sections[SECTION_DICTIONARY_DATA].size = this->buf.size();
+
+    // 差分更新で追加された見出し語も含めて一つの darts にまとめる
+    this->align();
+    header.sections[SECTION_DARTS].offset = this->pos;
+    std::sort(this->keys.begin(), this->keys.end());
+    std::vector<const char*> key_ptrs;
+    std::vector<Darts::DoubleArray::value_type> values;
+    for (size_t i = 0; i < this->keys.size(); i++) {
+      if (key_ptrs.size() > 0 && this->keys[i].first == this->keys[i - 1].first) continue;
+      key_ptrs.push_back(this->keys[i].first.c_str());
+      values.push_back(Darts::DoubleArray::value_type(this->keys[i].second));
+    }
+    if (key_ptrs.size() > 0) {
+      Darts::DoubleArray da;
+      if (da.build(key_ptrs.size(), &key_ptrs[0], 0, &values[0], 0) != 0) {
+        throw DartsException("Cannot build darts table.");
+      }
+      this->write(da.array(), da.total_size());
+      header.sections[SECTION_DARTS].size = da.total_size();
+    }
+    header.file_size = this->pos;
+
+    if (fseek(this->fp, 0, SEEK_SET) != 0) {
+      throw BundleException(std::string("Cannot write a temporary file (") + this->tmp_fname + ")");
+    }
+    this->write(&header, sizeof(header));
+    FILE* f = this->fp;
+    this->fp = NULL;
+    if (fclose(f) != 0) {
+      unlink(this->tmp_fname.c_str());
+      throw BundleException(std::string("Cannot write a temporary file (") + this->tmp_fname + ")");
+    }
+    // rename で置き換えるため、旧ファイルを mmap しているプロセスは影響を受けない
+    if (rename(this->tmp_fname.c_str(), this->filename.c_str()) != 0) {
+      unlink(this->tmp_fname.c_str());
+      throw BundleException(std::string("Cannot rename the temporary file to '") + this->filename + "'.");
+    }
+  }
+
+}
@@ -8,6 +8,15 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <thread>
+#include <exception>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <boost/regex.hpp>
 #include "Geoword.h"
 #include "Dictionary.h"
@@ -15,6 +24,9 @@
 #include "FileAccessor.h"
 #include "CSVReader.h"
 
+/// 辞書 CSV を一括で読み込む場合に一度に変換する行数
+#define FILE_IMPORT_CHUNK_ROWS  8192
+
 namespace geonlp
 {
   // Trim white characters from end in place.
@@ -23,14 +35,163 @@ namespace geonlp
     s.erase(pos + 1);
   }
   
-  /// @brief 辞書 CSV ファイルから地名語と辞書情報を読み込む
+  /// @brief 見出し行と CSV の 1 行から地名語を作る
   ///
-  /// @arg @c csvfilename   CSV ファイル名（地名語データ）
+  /// @arg @c fields      見出し行のフィールド名
+  /// @arg @c tokens      CSV の 1 行（末尾の空白は取り除かれる）
+  /// @arg @c dic_id      辞書の内部 ID
+  /// @arg @c dic_id_str  geonlp_id が無い場合に付ける接頭辞 '_<内部ID>_'
+  /// @arg @c geoword_in  [out] 地名語
+  static void _setGeowordFields(const std::vector<std::string>& fields, std::vector<std::string>& tokens, int dic_id, const std::string& dic_id_str, Geoword& geoword_in)
+  {
+    geoword_in.clear();
+    for (unsigned int i = 0; i < tokens.size(); i++) {
+      rtrim(tokens[i]);
+      // 複数可のフィールドはフィールド名を明示的に
+      // 指定することで、文字列が分割され、配列として登録される
+      if (fields[i] == "prefix") {
+        geoword_in.set_prefix(tokens[i]);
+      } else if (fields[i] == "suffix") {
+        geoword_in.set_suffix(tokens[i]);
+      } else if (fields[i] == "prefix_kana") {
+        geoword_in.set_prefix_kana(tokens[i]);
+      } else if (fields[i] == "suffix_kana") {
+        geoword_in.set_suffix_kana(tokens[i]);
+      } else if (fields[i] == "hypernym") {
+        geoword_in.set_hypernym(tokens[i]);
+      } else if (fields[i] == "code") {
+        geoword_in.set_code(tokens[i]);
+      } else {
+        geoword_in.set_value(fields[i], tokens[i]);
+      }
+    }
+    geoword_in.set_dictionary_id(dic_id);
+    if (!geoword_in.has_key("geonlp_id")) {
+      if (geoword_in.has_key("geolod_id")) {
+        // geolod_id がセットされているので geonlp_id に乗せ換える
+        geoword_in.set_geonlp_id(geoword_in._get_string("geolod_id"));
+        geoword_in.erase("geolod_id");
+      } else if (geoword_in.has_key("entry_id")) {
+        // geonlp_id がセットされていないので内部IDをセットする
+        std::string tmp_id = dic_id_str + geoword_in.get_entry_id();
+        geoword_in.set_geonlp_id(tmp_id);
+      }
+    }
+  }
+
+  /// @brief 読み込み専用で mmap したファイル
+  class MappedFile {
+  private:
+    void* addr;
+    size_t length;
+    bool opened;
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+  public:
+    /// @brief ファイルを mmap する、開けない場合は isOpen() が false になる
+    /// @exception std::runtime_error mmap に失敗
+    MappedFile(const std::string& filename): addr(MAP_FAILED), length(0), opened(false) {
+      int fd = ::open(filename.c_str(), O_RDONLY);
+      if (fd < 0) return;
+      this->opened = true;
+      struct stat st;
+      if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        this->length = static_cast<size_t>(st.st_size);
+        this->addr = mmap(NULL, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (this->addr == MAP_FAILED) {
+          ::close(fd);
+          throw std::runtime_error(std::string("Can't mmap CSV file '") + filename + "'.");
+        }
+#ifdef MADV_SEQUENTIAL
+        madvise(this->addr, this->length, MADV_SEQUENTIAL);
+#endif /* MADV_SEQUENTIAL */
+      }
+      ::close(fd);
+    }
+    ~MappedFile() {
+      if (this->addr != MAP_FAILED) munmap(this->addr, this->length);
+    }
+    inline bool isOpen(void) const { return this->opened; }
+    inline const char* data(void) const { return this->addr == MAP_FAILED ? NULL : static_cast<const char*>(this->addr); }
+    inline size_t size(void) const { return this->addr == MAP_FAILED ? 0 : this->length; }
+  };
+
+  /// @brief CSV の行を地名語に変換し、有効な地名語を JSON にして追加する
+  /// @arg @c begin, @c end  変換する CSV の行の範囲
+  /// @arg @c with_record    バイナリレコードも作る場合 true
+  /// @arg @c rows           [out] 変換した地名語
+  static void _convertGeowordRows(const std::vector<std::string>& fields,
+                                  std::vector<std::vector<std::string> >::iterator begin,
+                                  std::vector<std::vector<std::string> >::iterator end,
+                                  int dic_id, const std::string& dic_id_str, bool with_record, std::vector<GeowordImportRow>& rows)
+  {
+    std::string err;
+    Geoword geoword_in;
+    for (std::vector<std::vector<std::string> >::iterator it = begin; it != end; it++) {
+      _setGeowordFields(fields, *it, dic_id, dic_id_str, geoword_in);
+      if (!geoword_in.isValid(err)) continue;
+      rows.push_back(GeowordImportRow());
+      GeowordImportRow& row = rows.back();
+      row.geonlp_id = geoword_in.get_geonlp_id();
+      row.dictionary_id = geoword_in.get_dictionary_id();
+      row.entry_id = geoword_in.get_entry_id();
+      row.json = geoword_in.toJson();
+      if (with_record) geoword_in.toRecord(row.record);
+    }
+  }
+
+  /// @brief CSV の行をスレッドに分けて地名語に変換する
+  /// @arg @c lines        CSV の行、変換後は空になる
+  /// @arg @c with_record  バイナリレコードも作る場合 true
+  /// @arg @c n_threads    スレッド数
+  /// @return 行の順に並べた変換済みの地名語
+  static std::vector<GeowordImportRow> _convertGeowordChunk(const std::vector<std::string>& fields,
+                                                            std::vector<std::vector<std::string> >& lines,
+                                                            int dic_id, const std::string& dic_id_str, bool with_record, unsigned int n_threads)
+  {
+    size_t n = std::min(size_t(n_threads), lines.size());
+    std::vector<GeowordImportRow> rows;
+    if (n <= 1) {
+      _convertGeowordRows(fields, lines.begin(), lines.end(), dic_id, dic_id_str, with_record, rows);
+    } else {
+      std::vector<std::vector<GeowordImportRow> > results(n);
+      std::vector<std::exception_ptr> errors(n);
+      std::vector<std::thread> workers;
+      size_t chunk = (lines.size() + n - 1) / n;
+      for (size_t i = 0; i < n; i++) {
+        std::vector<std::vector<std::string> >::iterator begin = lines.begin() + std::min(lines.size(), i * chunk);
+        std::vector<std::vector<std::string> >::iterator end = lines.begin() + std::min(lines.size(), (i + 1) * chunk);
+        workers.push_back(std::thread([&fields, begin, end, dic_id, &dic_id_str, with_record, i, &results, &errors]() {
+              try {
+                _convertGeowordRows(fields, begin, end, dic_id, dic_id_str, with_record, results[i]);
+              } catch (...) {
+                errors[i] = std::current_exception();
+              }
+            }));
+      }
+      for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+      for (size_t i = 0; i < errors.size(); i++) {
+        if (errors[i]) std::rethrow_exception(errors[i]);
+      }
+      size_t total = 0;
+      for (size_t i = 0; i < n; i++) total += results[i].size();
+      rows.reserve(total);
+      for (size_t i = 0; i < n; i++) {
+        for (std::vector<GeowordImportRow>::iterator it = results[i].begin(); it != results[i].end(); it++) {
+          rows.push_back(GeowordImportRow());
+          std::swap(rows.back(), *it);
+        }
+      }
+    }
+    std::vector<std::vector<std::string> >().swap(lines);
+    return rows;
+  }
+
+  /// @brief 辞書データ (JSON) を読み込んで登録し、内部 ID を得る
   /// @arg @c jsonfilename  JSON ファイル名（辞書データ）
-  /// @return 読み込んだ地名語の件数
-  /// @exception SqliteNotInitaizliedException Sqlite3 が初期化されていない
-  /// @exception SqliteErrException Sqlite3 の処理中にエラーが発生
-  int FileAccessor::importDictionaryCSV(const std::string& csvfilename, const std::string& jsonfilename) const {
+  /// @arg @c dic_id_str    [out] geonlp_id が無い地名語に付ける接頭辞 '_<内部ID>_'
+  /// @return 辞書の内部 ID
+  int FileAccessor::importDictionaryJSON(const std::string& jsonfilename, std::string& dic_id_str) const {
     std::string err = "";
     
     // 辞書データ読み込み
@@ -65,9 +226,28 @@ namespace geonlp
     std::string dic_identifier = dic_in.get_identifier();
     int dic_id = this->_dbap->getDictionaryInternalId(dic_identifier); // 内部ID
     std::stringstream ss;
-    std::string dic_id_str;
     ss << "_" << dic_id << "_";
     ss >> dic_id_str;
+    return dic_id;
+  }
+
+  /// @brief 辞書 CSV ファイルから地名語と辞書情報を読み込む
+  ///
+  /// プロファイルで import_threads に 1 以外、または import_fast が指定されている場合は
+  /// importGeowordsBulk() で地名語を読み込む。
+  /// @arg @c csvfilename   CSV ファイル名（地名語データ）
+  /// @arg @c jsonfilename  JSON ファイル名（辞書データ）
+  /// @return 読み込んだ地名語の件数
+  /// @exception SqliteNotInitaizliedException Sqlite3 が初期化されていない
+  /// @exception SqliteErrException Sqlite3 の処理中にエラーが発生
+  int FileAccessor::importDictionaryCSV(const std::string& csvfilename, const std::string& jsonfilename) const {
+    std::string err = "";
+    std::string dic_id_str;
+    int dic_id = this->importDictionaryJSON(jsonfilename, dic_id_str);
+
+    if (this->_dbap->getImportThreads() != 1 || this->_dbap->getImportFast()) {
+      return this->importGeowordsBulk(csvfilename, dic_id, dic_id_str);
+    }
 
     // 地名語データ読み込み
     std::fstream fs_csv(csvfilename.c_str(), std::ios::in);
@@ -82,7 +262,6 @@ namespace geonlp
     tokens.clear();
     geowords.clear();
     while (!csv.Read(tokens)) {
-      geoword_in.clear();
       if (lineno == 0) {
         // 見出し行
         for (unsigned int i = 0; i < tokens.size(); i++) {
@@ -91,38 +270,7 @@ namespace geonlp
         }
       } else {
         // データ行
-        for (unsigned int i = 0; i < tokens.size(); i++) {
-          rtrim(tokens[i]);
-          // 複数可のフィールドはフィールド名を明示的に
-          // 指定することで、文字列が分割され、配列として登録される
-          if (fields[i] == "prefix") {
-            geoword_in.set_prefix(tokens[i]);
-          } else if (fields[i] == "suffix") {
-            geoword_in.set_suffix(tokens[i]);
-          } else if (fields[i] == "prefix_kana") {
-            geoword_in.set_prefix_kana(tokens[i]);
-          } else if (fields[i] == "suffix_kana") {
-            geoword_in.set_suffix_kana(tokens[i]);
-          } else if (fields[i] == "hypernym") {
-            geoword_in.set_hypernym(tokens[i]);
-          } else if (fields[i] == "code") {
-            geoword_in.set_code(tokens[i]);
-          } else {
-            geoword_in.set_value(fields[i], tokens[i]);
-          }
-        }
-        geoword_in.set_dictionary_id(dic_id);
-        if (!geoword_in.has_key("geonlp_id")) {
-          if (geoword_in.has_key("geolod_id")) {
-            // geolod_id がセットされているので geonlp_id に乗せ換える
-            geoword_in.set_geonlp_id(geoword_in._get_string("geolod_id"));
-            geoword_in.erase("geolod_id");
-          } else if (geoword_in.has_key("entry_id")) {
-            // geonlp_id がセットされていないので内部IDをセットする
-            std::string tmp_id = dic_id_str + geoword_in.get_entry_id();
-            geoword_in.set_geonlp_id(tmp_id);
-          }
-        }
+        _setGeowordFields(fields, tokens, dic_id, dic_id_str, geoword_in);
         if (geoword_in.isValid(err)) {
           geowords.push_back(geoword_in);
         }
@@ -136,4 +284,81 @@ namespace geonlp
     return geowords.size();
   }
 
+  /// @brief 辞書 CSV ファイルから地名語を一括で読み込む
+  ///
+  /// CSV ファイルは mmap して読み、 FILE_IMPORT_CHUNK_ROWS 行ずつ
+  /// import_threads のスレッドで地名語に変換する。
+  /// 変換済みの行を DB に登録している間に次の行を変換するため、
+  /// メモリ上に保持するのは高々 2 チャンク分の行になる。
+  /// 登録結果は 1 行ずつ読み込んだ場合と同じになる。
+  /// @arg @c csvfilename   CSV ファイル名（地名語データ）
+  /// @arg @c dic_id        辞書の内部 ID
+  /// @arg @c dic_id_str    geonlp_id が無い地名語に付ける接頭辞
+  /// @return 読み込んだ地名語の件数
+  /// @exception SqliteErrException Sqlite3 の処理中にエラーが発生
+  int FileAccessor::importGeowordsBulk(const std::string& csvfilename, int dic_id, const std::string& dic_id_str) const {
+    MappedFile mapped(csvfilename);
+    if (!mapped.isOpen()) return 0;
+    CSVReader csv(mapped.data(), mapped.size());
+
+    unsigned int n_threads = this->_dbap->getImportThreads();
+    if (n_threads == 0) n_threads = std::thread::hardware_concurrency();
+    if (n_threads == 0) n_threads = 1;
+    const bool with_record = this->_dbap->hasGeowordRecord();
+
+    // 見出し行
+    std::vector<std::string> fields;
+    std::vector<std::string> tokens;
+    if (!csv.Read(tokens)) {
+      for (unsigned int i = 0; i < tokens.size(); i++) {
+        rtrim(tokens[i]);
+        fields.push_back(tokens[i]);
+      }
+    }
+
+    // データ行をチャンクごとに読み込み、非同期に変換する
+    std::function<bool(std::vector<std::vector<std::string> >&)> read_chunk = [&csv](std::vector<std::vector<std::string> >& lines) {
+      std::vector<std::string> line;
+      while (lines.size() < FILE_IMPORT_CHUNK_ROWS && !csv.Read(line)) {
+        lines.push_back(std::vector<std::string>());
+        lines.back().swap(line);
+      }
+      return lines.size() > 0;
+    };
+    std::function<std::future<std::vector<GeowordImportRow> >(void)> convert_next = [&]() {
+      std::vector<std::vector<std::string> > lines;
+      if (!read_chunk(lines)) return std::future<std::vector<GeowordImportRow> >();
+      std::shared_ptr<std::vector<std::vector<std::string> > > chunk(new std::vector<std::vector<std::string> >());
+      chunk->swap(lines);
+      return std::async(std::launch::async, [&fields, chunk, dic_id, &dic_id_str, with_record, n_threads]() {
+          return _convertGeowordChunk(fields, *chunk, dic_id, dic_id_str, with_record, n_threads);
+        });
+    };
+
+    size_t stored = 0;
+    std::future<std::vector<GeowordImportRow> > next = convert_next();
+    GeowordImportSource source = [&](std::vector<GeowordImportRow>& rows) {
+      while (next.valid()) {
+        rows = next.get();
+        next = convert_next();
+        if (rows.size() > 0) {
+          stored += rows.size();
+          return true;
+        }
+      }
+      if (stored == 0) {
+        throw std::runtime_error("No geoword stored. Check the csv file format.");
+      }
+      return false;
+    };
+    try {
+      this->_dbap->bulkInsertGeowords(source);
+    } catch (...) {
+      // 変換中のチャンクの終了を待つ
+      if (next.valid()) next.wait();
+      throw;
+    }
+    return int(stored);
+  }
+
 }
@@ -8,9 +8,21 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <list>
+#include <deque>
+#include <algorithm>
+#include <iterator>
+#include <cmath>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <shared_mutex>
+#include <exception>
+#ifdef __GLIBCXX__
+#include <cxxabi.h>
+#endif /* __GLIBCXX__ */
 #include <boost/lexical_cast.hpp>
-#include <boost/regex.hpp>
+#include <boost/weak_ptr.hpp>
 #include <boost/algorithm/string.hpp>
 #include "config.h"
 #include "GeonlpMA.h"
@@ -20,16 +32,188 @@
 #include "Geoword.h"
 #include "MeCabAdapter.h"
 #include "DBAccessor.h"
+#include "WordlistBuilder.h"
+#include "DartsSearch.h"
+#include "DictionaryBundle.h"
+#include "WorkerPool.h"
 #include "Profile.h"
 #include "Suffix.h"
 #include "GeowordFormatter.h"
 #include "FileAccessor.h"
+#include "Util.h"
 #ifdef HAVE_LIBDAMS
 #include <dams.h>
 #endif /* HAVE_LIBDAMS */
 
 namespace geonlp
 {
+  /// @brief ActiveView を指定した解析・検索の実行中に、スレッドが利用する ActiveView
+  ///
+  /// owner の MAImpl から参照する場合だけ、MAImpl::activeFilter の代わりに view を利用する。
+  struct ViewBinding {
+    const MAImpl* owner;
+    const ActiveView* view;
+  };
+  static thread_local ViewBinding view_binding = { NULL, NULL };
+
+  /// @brief スコープの間だけ view_binding を設定し、終了時に元に戻す
+  class ScopedViewBinding {
+  private:
+    ViewBinding saved;
+  public:
+    ScopedViewBinding(const MAImpl* owner, const ActiveView& view): saved(view_binding) {
+      view_binding.owner = owner;
+      view_binding.view = &view;
+    }
+    ~ScopedViewBinding() { view_binding = saved; }
+  };
+
+  /// @brief MAImpl::threadReader() が作成した、スレッド専用の読み込み専用 DBAccessor
+  struct ThreadReader {
+    boost::weak_ptr<int> owner;   ///< 作成した MAImpl の readerToken
+    unsigned long serial;         ///< 作成時の MAImpl の readerSerial
+    DBAccessorPtr dbap;
+  };
+
+  /// @brief スレッドごとの ThreadReader の一覧、スレッドの終了時に接続を閉じる
+  struct ThreadReaders {
+    std::vector<ThreadReader> readers;
+    ~ThreadReaders() {
+      for (std::vector<ThreadReader>::iterator it = readers.begin(); it != readers.end(); it++) {
+        (*it).dbap->close();
+      }
+    }
+  };
+  static thread_local ThreadReaders thread_readers;
+
+  typedef std::shared_lock<std::shared_timed_mutex> ReadLock;
+  typedef std::unique_lock<std::shared_timed_mutex> WriteLock;
+
+  /// @brief スレッドごとに再利用する配列が、呼び出しの後も保持してよい要素数の上限
+  static const size_t THREAD_BUFFER_RETAIN_SIZE = 256;
+
+  /// @brief スレッドごとに再利用する配列が長い文のために確保した領域を解放する
+  ///
+  /// 作業スレッドはプロセスの終了まで残るため、一度だけ現れた長い文の領域を保持し続けないよう、
+  /// 上限を超える領域は呼び出しの終わりに解放する。
+  /// @arg buf 再利用する配列、要素は呼び出し側で使い終えていること
+  template <typename T>
+  static void _trimThreadBuffer(std::vector<T>& buf) {
+    if (buf.capacity() > THREAD_BUFFER_RETAIN_SIZE) std::vector<T>().swap(buf);
+  }
+
+  /// @brief Darts の検索結果を一致したバイト数で比較する
+  static bool _isShorterResult(const Darts::DoubleArray::result_pair_type& a, const Darts::DoubleArray::result_pair_type& b) {
+    return a.length < b.length;
+  }
+
+  /// @brief parseNodeBatch の呼び出したスレッドと作業スレッドで共有する状態
+  ///
+  /// 作業スレッドの処理は呼び出しが終わった後に開始されることがあるため、
+  /// 状態は処理と共有して保持し、 sentences と results は closed になる前に
+  /// 開始した処理だけが参照する。
+  struct ParseNodeBatchJob {
+    const std::vector<std::string>* sentences;
+    std::vector<std::vector<Node> >* results;
+    std::atomic<size_t> next;     ///< 次に解析する自然文の位置
+    std::atomic<bool> failed;     ///< いずれかのスレッドで例外が発生した
+    std::mutex mutex;
+    std::condition_variable idle;
+    size_t active;                ///< 解析を行っている作業スレッドの数、 mutex で保護する
+    bool closed;                  ///< 全ての自然文を取り出し終えた、 mutex で保護する
+    std::exception_ptr error;     ///< 最初に発生した例外、 mutex で保護する
+  };
+
+  /// @brief parseNodeBatch の自然文を順に取り出して解析する
+  ///
+  /// 例外は job に記録し、他のスレッドにも取り出しを止めさせる。
+  /// @arg @c ma   解析に利用する MAImpl
+  /// @arg @c job  スレッド間で共有する状態
+  static void _parseNodeBatchLoop(const MAImpl* ma, ParseNodeBatchJob* job) {
+    try {
+      const size_t n = job->sentences->size();
+      while (!job->failed) {
+        size_t i = job->next++;
+        if (i >= n) break;
+        ma->parseNode((*job->sentences)[i], (*job->results)[i]);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(job->mutex);
+      if (!job->failed) job->error = std::current_exception();
+      job->failed = true;
+    }
+  }
+
+  /// @brief parseNodeBatch の作業スレッドの処理、 WorkerPool::shared() で実行する
+  ///
+  /// 呼び出したスレッドが全ての自然文を取り出し終えた後に開始した場合は何もしない。
+  /// @arg @c ma   解析に利用する MAImpl
+  /// @arg @c job  スレッド間で共有する状態
+  static void _parseNodeBatchWorker(const MAImpl* ma, const boost::shared_ptr<ParseNodeBatchJob>& job) {
+    {
+      std::lock_guard<std::mutex> lock(job->mutex);
+      if (job->closed) return;
+      job->active++;
+    }
+    _parseNodeBatchLoop(ma, job.get());
+    std::lock_guard<std::mutex> lock(job->mutex);
+    if (--job->active == 0) job->idle.notify_all();
+  }
+
+  /// @brief parseNodeStream で先行して MeCab で解析しておく文の数の上限
+  static const size_t STREAM_QUEUE_SIZE = 64;
+
+  /// @brief parseNodeStream の読み込みスレッドと呼び出したスレッドで共有する状態
+  struct ParseNodeStreamJob {
+    /// MeCab で解析した文
+    struct Item {
+      size_t offset;                 ///< 入力の先頭からの文の開始位置（文字数）
+      MeCabAdapter::NodeList nodes;  ///< MeCab による解析結果
+    };
+    std::deque<Item> queue;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    bool done;                    ///< 読み込みスレッドが終了した
+    bool stop;                    ///< 呼び出したスレッドが解析を中止した
+    std::exception_ptr error;     ///< 読み込みスレッドで発生した例外
+
+    ParseNodeStreamJob(): done(false), stop(false) {}
+  };
+
+  /// @brief 文の区切り位置を探す
+  ///
+  /// 改行、「。」「！」「？」の直後を区切り位置とする。
+  /// 「。」「！」「？」の直後の改行は同じ文に含める。
+  /// 区切り文字が buf の末尾にあり、続く改行をまだ読み込んでいない場合は見つからないものとする。
+  /// @arg @c buf   読み込んだ入力
+  /// @arg @c start 探し始める位置
+  /// @arg @c eof   buf が入力の末尾まで含む場合 true
+  /// @return 区切り位置（区切り文字の次の位置）、見つからない場合は std::string::npos
+  static size_t _findSentenceEnd(const std::string& buf, size_t start, bool eof) {
+    const size_t len = buf.length();
+    for (size_t i = start; i < len; i++) {
+      unsigned char c = (unsigned char)buf[i];
+      if (c == '\n') return i + 1;
+      if (i + 2 >= len) continue;
+      unsigned char c1 = (unsigned char)buf[i + 1], c2 = (unsigned char)buf[i + 2];
+      if ((c == 0xE3 && c1 == 0x80 && c2 == 0x82)  // 。
+          || (c == 0xEF && c1 == 0xBC && (c2 == 0x81 || c2 == 0x9F))) {  // ！ ？
+        if (i + 3 < len) return (buf[i + 3] == '\n') ? i + 4 : i + 3;
+        return eof ? i + 3 : std::string::npos;
+      }
+    }
+    return std::string::npos;
+  }
+
+  /// @brief UTF-8 文字列の文字数を数える
+  static size_t _countCharacters(const char* p, size_t len) {
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+      if (((unsigned char)p[i] & 0xC0) != 0x80) n++;
+    }
+    return n;
+  }
 
   /// 設定項目で '-' から始まる場合に除外、それ以外は追加の形式の要素を処理し、
   /// 追加される項目だけもしくは除外される項目だけのリストを作る
@@ -83,9 +267,17 @@ namespace geonlp
   /// @arg @c profilesp  プロファイル読み込みクラスへのポインタ
   /// @exception std::runtime_error プロファイル定義ファイルにキーが存在しない。
   /// @note プロファイル定義ファイル中での出力形式定義クラス名が期待されていない文字列だった場合には"DefaultGeowordFormatter"が指定されたものとする。
-  MAImpl::MAImpl(ProfilePtr profilesp): formatter()
+  MAImpl::MAImpl(ProfilePtr profilesp): formatter(), geowordNodeCache(GEOWORD_NODE_CACHE_SIZE), standardizedCache(STANDARDIZED_CACHE_SIZE), asyncPending(0), ownerThread(std::this_thread::get_id()), readerToken(new int(0)), readerSerial(0)
   {
     this->profilep = profilesp;
+    if (profilesp->get_stats()) this->statsp = StatsCollectorPtr(new StatsCollector());
+    this->budgetp = MemoryBudgetPtr(new MemoryBudget(profilesp->get_memory_budget() * 1024 * 1024));
+    if (profilesp->get_parse_cache_size() > 0) {
+      this->parseCachep = ParseCachePtr(new ParseCache(profilesp->get_parse_cache_size()));
+      this->parseCachep->setMemoryBudget(this->budgetp.get());
+    }
+    this->geowordNodeCache.setMemoryBudget(this->budgetp.get());
+    this->standardizedCache.setMemoryBudget(this->budgetp.get());
     
     // MeCabAdapterの初期化
     try{
@@ -97,31 +289,35 @@ namespace geonlp
       if (!s_in) userdic = std::string("");
       this->mecabp = MeCabAdapterPtr(new MeCabAdapter());
       this->mecabp->initialize(userdic, system_dic_dir);
+      this->mecabp->setStatsCollector(this->statsp.get());
     } catch (std::runtime_error& e){
       throw ServiceCreateFailedException( e.what(), ServiceCreateFailedException::MECAB);
     }
 
     // DBAccessorの初期化
+    // 辞書バンドルが指定されている場合は SQLite の代わりにバンドルを開く
     // std::string dbfilename;
-    try{
-      this->dbap = DBAccessorPtr(new DBAccessor(*profilesp));
-      this->dbap->open();
-    }catch( std::runtime_error& e){
-      throw ServiceCreateFailedException( e.what(), ServiceCreateFailedException::SQLITE);
+    std::string bundle_file = profilesp->get_bundle_file();
+    if (bundle_file.length() > 0) {
+      try {
+        this->bundlep = DictionaryBundlePtr(new DictionaryBundle(bundle_file));
+      } catch (std::runtime_error& e) {
+        throw ServiceCreateFailedException(e.what(), ServiceCreateFailedException::BUNDLE);
+      }
+    } else {
+      try{
+        this->dbap = DBAccessorPtr(new DBAccessor(*profilesp));
+        this->dbap->open();
+        this->dbap->setStatsCollector(this->statsp.get());
+        this->dbap->setMemoryBudget(this->budgetp.get());
+      }catch( std::runtime_error& e){
+        throw ServiceCreateFailedException( e.what(), ServiceCreateFailedException::SQLITE);
+      }
     }
 
     // Dartsの初期化
-    std::string darts;
     try {
-      darts = profilesp->get_darts_file();
-      if (darts.length() > 0) {
-        FILE* fp = fopen(darts.c_str(), "r");
-        if (fp != NULL) {
-          fclose(fp);
-          this->dap = DoubleArrayPtr(new Darts::DoubleArray());
-          this->dap->open(darts.c_str());
-        }
-      }
+      this->openIndex();
     } catch (std::runtime_error& e) {
       throw ServiceCreateFailedException(e.what(), ServiceCreateFailedException::DARTS);
     }
@@ -134,6 +330,8 @@ namespace geonlp
       formatter = GeowordFormatterPtr(new DefaultGeowordFormatter());
     }else if ( formattername == "ChasenGeowordFormatter"){
       formatter = GeowordFormatterPtr(new ChasenGeowordFormatter());
+    }else if ( formattername == "JsonLinesGeowordFormatter"){
+      formatter = GeowordFormatterPtr(new JsonLinesGeowordFormatter());
     }else {
       // 期待されていない文字列だった場合には"DefaultGeowordFormatter"が指定されたものとする
       formatter = GeowordFormatterPtr(new DefaultGeowordFormatter());
@@ -177,6 +375,11 @@ namespace geonlp
   /// @brief デストラクタ。
   MAImpl::~MAImpl()
   {
+    // 実行中の parseNodeAsync の終了を待つ
+    {
+      std::unique_lock<std::mutex> lock(this->asyncMutex);
+      this->asyncDone.wait(lock, [this]() { return this->asyncPending == 0; });
+    }
     if ( mecabp.get()){
       this->mecabp->terminate();
     }
@@ -186,6 +389,10 @@ namespace geonlp
     if (dap.get()) {
       this->dap.reset(); // darts はクローズ処理不要？
     }
+    this->delta_dap.reset();
+    this->yomi_dap.reset();
+    this->yomi_delta_dap.reset();
+    this->bundlep.reset();
 #ifdef HAVE_LIBDAMS
     damswrapper::final();
 #endif /* HAVE_LIBDAMS */
@@ -194,12 +401,14 @@ namespace geonlp
 
   /// @brief ID で指定した辞書情報を取得する
   bool MAImpl::getDictionaryById(int dictionary_id, Dictionary& ret) const {
-    return this->dbap->getDictionaryById(dictionary_id, ret);
+    ReadLock lock(this->stateMutex);
+    return this->db()->getDictionaryById(dictionary_id, ret);
   }
 
   /// @brief identifier で指定した辞書情報を取得する
   bool MAImpl::getDictionary(const std::string&  identifier, Dictionary& ret) const {
-    return this->dbap->getDictionary(identifier, ret);
+    ReadLock lock(this->stateMutex);
+    return this->db()->getDictionary(identifier, ret);
   }
 
   /// @brief 内部 ID で指定した辞書の identifier を取得する
@@ -213,7 +422,8 @@ namespace geonlp
 
   /// @brief 辞書一覧を取得する
   int MAImpl::getDictionaryList(std::map<int, Dictionary>& ret) const {
-    this->dbap->getDictionaryList(ret);
+    ReadLock lock(this->stateMutex);
+    this->db()->getDictionaryList(ret);
     return ret.size();
   }
 
@@ -221,65 +431,116 @@ namespace geonlp
   /// @arg @c dics   利用する辞書のIDリスト
   ///                空の場合、登録されている全辞書を利用する
   void MAImpl::setActiveDictionaries(const std::vector<int>& dics) {
+    WriteLock lock(this->stateMutex);
     this->activeDictionaries.clear();
-    if (dics.size() == 0) {
-      ;
-      // this->getDictionaryList(this->activeDictionaries);
-    } else {
-      this->addActiveDictionaries(dics);
+    // dics が空の場合、全ての辞書が非アクティブになる
+    Dictionary dictionary;
+    for (std::vector<int>::const_iterator it = dics.begin(); it != dics.end(); it++) {
+      if (this->db()->getDictionaryById((*it), dictionary)) this->activeDictionaries[(*it)] = dictionary;
     }
+    this->activeFilter.setDictionaries(this->activeDictionaries);
   }
 
   /// @brief 利用する辞書をリセットする（デフォルトに戻す）
   void MAImpl::resetActiveDictionaries() {
+    WriteLock lock(this->stateMutex);
     this->activeDictionaries = this->defaultDictionaries;
+    this->activeFilter.setDictionaries(this->activeDictionaries);
   }
 
   /// @brief 利用する辞書を追加する
   /// @arg @c dics 追加する辞書IDのリスト
   void MAImpl::addActiveDictionaries(const std::vector<int>& dics) {
+    WriteLock lock(this->stateMutex);
     Dictionary dictionary;
     for (std::vector<int>::const_iterator it = dics.begin(); it != dics.end(); it++) {
-      if (this->getDictionaryById((*it), dictionary)) this->activeDictionaries[(*it)] = dictionary;
+      if (this->db()->getDictionaryById((*it), dictionary)) this->activeDictionaries[(*it)] = dictionary;
     }
+    this->activeFilter.setDictionaries(this->activeDictionaries);
   }
 
   /// @brief 利用する辞書から除外する
   /// @arg @c dics 除外する辞書IDのリスト
   void MAImpl::removeActiveDictionaries(const std::vector<int>& dics) {
+    WriteLock lock(this->stateMutex);
     for (std::vector<int>::const_iterator it = dics.begin(); it != dics.end(); it++) {
       this->activeDictionaries.erase((*it));
     }
+    this->activeFilter.setDictionaries(this->activeDictionaries);
   }
 
   /// @brief 利用している辞書を返す
-  const std::map<int, Dictionary>& MAImpl::getActiveDictionaries(void) const {
+  /// @return 呼び出した時点のアクティブな辞書のコピー
+  std::map<int, Dictionary> MAImpl::getActiveDictionaries(void) const {
+    ReadLock lock(this->stateMutex);
     return this->activeDictionaries;
   }
 
+  /// @brief parseNode() や getGeowordEntries() に渡す、アクティブな辞書/クラスの組を作成する。
+  ///
+  /// 見出し語IDごとの判定結果は作成時の DB の更新番号と共に記憶し、
+  /// DB が更新された後は記録を利用せずに判定する。
+  /// @arg @c dictionary_ids 利用する辞書IDのリスト、登録されていない ID は無視する
+  /// @arg @c ne_classes 利用するクラス名の正規表現リスト、- から始まる場合は除外する
+  /// @return 作成した ActiveView
+  /// @exception boost::regex_error 正規表現が不正
+  ActiveViewPtr MAImpl::createActiveView(const std::vector<int>& dictionary_ids, const std::vector<std::string>& ne_classes) const {
+    return this->createActiveView(dictionary_ids, ne_classes, GEOWORD_DATE_MIN, GEOWORD_DATE_MAX);
+  }
+
+  /// @brief 有効期間で候補を絞り込む、アクティブな辞書/クラス/期間の組を作成する。
+  ///
+  /// 有効期間は見出し語の地名語IDリストと補完候補表、空間インデックスに整数で記録してあり、
+  /// 期間外の地名語しか含まない見出し語は地名語を読み込まずに候補から除く。
+  /// @arg @c dictionary_ids 利用する辞書IDのリスト、登録されていない ID は無視する
+  /// @arg @c ne_classes 利用するクラス名の正規表現リスト、- から始まる場合は除外する
+  /// @arg @c date_from 期間の開始日（年 * 10000 + 月 * 100 + 日）
+  /// @arg @c date_to 期間の終了日
+  /// @return 作成した ActiveView
+  /// @exception boost::regex_error 正規表現が不正
+  ActiveViewPtr MAImpl::createActiveView(const std::vector<int>& dictionary_ids, const std::vector<std::string>& ne_classes,
+                                         int date_from, int date_to) const {
+    ReadLock lock(this->stateMutex);
+    std::map<int, Dictionary> dics;
+    Dictionary dictionary;
+    for (std::vector<int>::const_iterator it = dictionary_ids.begin(); it != dictionary_ids.end(); it++) {
+      if (this->db()->getDictionaryById((*it), dictionary)) dics[(*it)] = dictionary;
+    }
+    return ActiveViewPtr(new ActiveView(dics, ne_classes, date_from, date_to,
+                                        this->activeFilter.getWordlistCount(), this->readerSerial.load()));
+  }
+
   /// @brief 利用するクラス正規表現を指定する
   void MAImpl::setActiveClasses(const std::vector<std::string>& ne_classes) {
+    WriteLock lock(this->stateMutex);
+    this->activeFilter.setClasses(ne_classes);
     this->activeClasses = ne_classes;
   }
 
   /// @brief 利用する固有名クラスの正規表現を追加する
   /// @arg @c ne_classes 追加するクラスの正規表現リスト
   void MAImpl::addActiveClasses(const std::vector<std::string>& ne_classes) {
+    WriteLock lock(this->stateMutex);
+    std::vector<std::string> classes = this->activeClasses;
     for (std::vector<std::string>::const_iterator it = ne_classes.begin(); it != ne_classes.end(); it++) {
       bool is_exist = false;
-      for (std::vector<std::string>::iterator it2 = this->activeClasses.begin(); it2 != this->activeClasses.end(); it2++) {
+      for (std::vector<std::string>::iterator it2 = classes.begin(); it2 != classes.end(); it2++) {
         if (*it2 == *it) {
           is_exist = true;
           break;
         }
       }
-      if (!is_exist) this->activeClasses.push_back((*it));
+      if (!is_exist) classes.push_back((*it));
     }
+    // 不正な正規表現が含まれる場合は例外となり、設定は変更されない
+    this->activeFilter.setClasses(classes);
+    this->activeClasses.swap(classes);
   }
 
   /// @brief 利用する固有名クラスの正規表現を除外する
   /// @arg @c ne_classes 除外するクラスの正規表現リスト
   void MAImpl::removeActiveClasses(const std::vector<std::string>& ne_classes) {
+    WriteLock lock(this->stateMutex);
     for (std::vector<std::string>::const_iterator it = ne_classes.begin(); it != ne_classes.end(); it++) {
       for (std::vector<std::string>::iterator it2 = this->activeClasses.begin(); it2 != this->activeClasses.end(); it2++) {
         if (*it2 == *it) {
@@ -288,15 +549,20 @@ namespace geonlp
         }
       }
     }
+    this->activeFilter.setClasses(this->activeClasses);
   }
 
   /// @brief 利用するクラス正規表現をリセットする（デフォルトに戻す）
   void MAImpl::resetActiveClasses() {
+    WriteLock lock(this->stateMutex);
+    this->activeFilter.setClasses(this->defaultClasses);
     this->activeClasses = this->defaultClasses;
   }
 
   /// @brief 利用しているクラス正規表現のリストを返す
-  const std::vector<std::string>& MAImpl::getActiveClasses() const {
+  /// @return 呼び出した時点のクラス正規表現のリストのコピー
+  std::vector<std::string> MAImpl::getActiveClasses() const {
+    ReadLock lock(this->stateMutex);
     return this->activeClasses;
   }
 
@@ -311,10 +577,31 @@ namespace geonlp
   /// @exception MeCabErrException MeCabでエラー。
   std::string MAImpl::parse(const std::string & sentence) const
   {
-    std::ostringstream oss;
+    std::string out;
+    this->parse(sentence, out);
+    return out;
+  }
+
+  /// @brief 引数として渡された自然文を形態素解析し、解析結果のテキストをバッファの末尾に追加する。
+  ///
+  /// @arg @c sentence 解析対象の自然文。
+  /// @arg out 解析結果を追加するバッファ。
+  void MAImpl::parse(const std::string & sentence, std::string & out) const
+  {
+    std::vector<Node> nodelist; 
+    this->parseNode(sentence, nodelist);
+    formatter->appendNodeList(nodelist, out);
+  }
+
+  /// @brief 引数として渡された自然文を形態素解析し、解析結果のテキストをストリームに書き出す。
+  ///
+  /// @arg @c sentence 解析対象の自然文。
+  /// @arg os 解析結果を書き出すストリーム。
+  void MAImpl::parse(const std::string & sentence, std::ostream & os) const
+  {
     std::vector<Node> nodelist; 
     this->parseNode(sentence, nodelist);
-    return formatter->formatNodeList(nodelist);
+    formatter->writeNodeList(nodelist, os);
   }
 
   /// @brief 引数として渡された自然文を形態素解析し、解析結果の各行を要素とするノードの配列を返す。
@@ -327,55 +614,443 @@ namespace geonlp
   /// @exception SqliteErrException Sqlite3でエラー。
   /// @exception MeCabErrException MeCabでエラー。
   int MAImpl::parseNode(const std::string & sentence, std::vector<Node>& ret) const
+  {
+    StatsTimer timer(this->statsp.get(), STATS_PARSE_NODE);
+    // 同じ文を同じ辞書/クラスで解析した結果を記憶していれば複製して返す
+    if (this->parseCachep) {
+      ReadLock lock(this->stateMutex);
+      const bool found = this->isFilterCurrent()
+        && this->parseCachep->get(this->filter().getGeneration(), sentence, ret);
+      if (this->statsp) this->statsp->addCacheLookup(STATS_PARSE_CACHE, found);
+      if (found) {
+        timer.setRows(ret.size());
+        return ret.size();
+      }
+    }
+    // MeCabでパースする（解析結果の配列はスレッドごとに再利用する）
+    static thread_local NodeList nodes;
+    this->tokenize(sentence, nodes);
+    ret.clear();
+    ret.reserve(nodes.size()); 
+    // MeCabによるパース結果を地名語辞書を参照して変換する
+    ReadLock lock(this->stateMutex);
+    convertMeCabNodeToNodeList(nodes, ret);
+    _trimThreadBuffer(nodes);
+    // DB の更新前に作成した ActiveView の場合は世代番号が変わらないため記憶しない
+    if (this->parseCachep && this->isFilterCurrent()) {
+      this->parseCachep->put(this->filter().getGeneration(), sentence, ret);
+    }
+    timer.setRows(ret.size());
+    return ret.size();
+  }
+
+  /// @brief 引数として渡された自然文を、 view の辞書/クラスを利用して形態素解析する。
+  ///
+  /// view は現在のスレッドにだけ設定するため、共有のアクティブな辞書/クラスや
+  /// 他のスレッドの解析には影響しない。
+  /// @arg @c sentence 解析対象の自然文。
+  /// @arg ret 解析結果。形態素情報クラスの配列。
+  /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+  /// @return 結果のノード数
+  int MAImpl::parseNode(const std::string & sentence, std::vector<Node>& ret, const ActiveView& view) const
+  {
+    ScopedViewBinding binding(this, view);
+    return this->parseNode(sentence, ret);
+  }
+
+  /// @brief 引数として渡された自然文を形態素解析し、地名語ノードの候補の地名語エントリを合わせて返す。
+  ///
+  /// 候補は解析と同じロックの中で取得するため、ノードの idlist と必ず一致する。
+  /// @arg @c sentence 解析対象の自然文。
+  /// @arg nodes 解析結果。形態素情報クラスの配列。
+  /// @arg candidates nodes と同じ順に並んだ、ノードごとの地名語エントリの配列。
+  /// @return 結果のノード数
+  int MAImpl::parseLattice(const std::string & sentence, std::vector<Node>& nodes, std::vector<std::vector<Geoword> >& candidates) const
+  {
+    StatsTimer timer(this->statsp.get(), STATS_PARSE_NODE);
+    static thread_local NodeList mecab_nodes;
+    this->tokenize(sentence, mecab_nodes);
+    nodes.clear();
+    nodes.reserve(mecab_nodes.size());
+    ReadLock lock(this->stateMutex);
+    convertMeCabNodeToNodeList(mecab_nodes, nodes);
+    _trimThreadBuffer(mecab_nodes);
+
+    candidates.clear();
+    candidates.resize(nodes.size());
+    std::vector<std::string> geonlp_ids;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      const Node& node = nodes[i];
+      if (node.get_subclassification2() != "地名語" || node.get_subclassification1() == "接尾") continue;
+      this->getGeowordIds(node, geonlp_ids);
+      candidates[i].reserve(geonlp_ids.size());
+      for (size_t j = 0; j < geonlp_ids.size(); j++) {
+        if (std::find(geonlp_ids.begin(), geonlp_ids.begin() + j, geonlp_ids[j]) != geonlp_ids.begin() + j) continue; // 重複
+        Geoword geoword;
+        if (!this->db()->findGeowordById(geonlp_ids[j], geoword)) {
+          throw std::runtime_error("No geoword found with id='" + geonlp_ids[j] + "', word=" + node.get_surface());
+        }
+        candidates[i].push_back(geoword);
+      }
+    }
+    timer.setRows(nodes.size());
+    return nodes.size();
+  }
+
+  /// @brief 引数として渡された自然文を view の辞書/クラスを利用して形態素解析し、
+  /// 地名語ノードの候補の地名語エントリを合わせて返す。
+  /// @arg @c sentence 解析対象の自然文。
+  /// @arg nodes 解析結果。形態素情報クラスの配列。
+  /// @arg candidates nodes と同じ順に並んだ、ノードごとの地名語エントリの配列。
+  /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+  /// @return 結果のノード数
+  int MAImpl::parseLattice(const std::string & sentence, std::vector<Node>& nodes, std::vector<std::vector<Geoword> >& candidates, const ActiveView& view) const
+  {
+    ScopedViewBinding binding(this, view);
+    return this->parseLattice(sentence, nodes, candidates);
+  }
+
+  /// @brief 改行コードをエスケープして MeCab で解析し、改行を表すノードを復元する。
+  ///
+  /// 辞書を参照しないため、ロックを取得せずに実行してよい。
+  /// nodes は空にしてから結果を格納するので、呼び出し側は同じ配列を再利用できる。
+  /// @arg @c sentence 解析対象の自然文。
+  /// @arg nodes MeCab による解析結果
+  void MAImpl::tokenize(const std::string& sentence, NodeList& nodes) const
   {
     // 改行コードをエスケープする
-    std::string sentence_for_mecab("");
-    int pos = 0, offset = 0;
+    std::string sentence_for_mecab;
+    sentence_for_mecab.reserve(sentence.length() + 16);
+    size_t offset = 0;
     for (;;) {
-      pos = sentence.find("\n", offset);
-      if (pos == int(std::string::npos)) {
-        sentence_for_mecab += sentence.substr(offset, pos - offset);
+      size_t pos = sentence.find('\n', offset);
+      if (pos == std::string::npos) {
+        sentence_for_mecab.append(sentence, offset, std::string::npos);
         break;
-      } else {
-        sentence_for_mecab += sentence.substr(offset, pos - offset) + "\\n";
-        offset = pos + 1;
       }
+      sentence_for_mecab.append(sentence, offset, pos - offset);
+      sentence_for_mecab.append("\\n");
+      offset = pos + 1;
     }
     // MeCabでパースする
-    std::list<Node> nodes = mecabp->parse(sentence_for_mecab);
-    for (std::list<Node>::iterator it = nodes.begin(); it != nodes.end(); it++) {
-      std::string surface = (*it).get_surface();
-      if (surface != "\\") continue;
-      std::list<Node>::iterator it_next = it; it_next++;
-      if (it_next == nodes.end()) break;
-      std::string next_surface = (*it_next).get_surface();
+    mecabp->parse(sentence_for_mecab, nodes);
+    // 改行を表すノードを復元し、取り除くノードは後続のノードを詰めて上書きする
+    size_t n = 0;
+    for (size_t i = 0; i < nodes.size(); i++, n++) {
+      if (n != i) nodes[n] = std::move(nodes[i]);
+      if (nodes[n].get_surface_view() != "\\") continue;
+      if (i + 1 == nodes.size()) { n++; break; }
+      std::string next_surface = nodes[i + 1].get_surface();
       if (next_surface.at(0) == 'n') {
         if (next_surface.length() > 1) {
-          (*it_next).set_surface(next_surface.substr(1));
+          nodes[i + 1].set_surface(next_surface.substr(1));
         } else {
-          nodes.erase(it_next);
+          i++;  // 'n' だけのノードは取り除く
         }
-        (*it) = Node("\n", "記号,制御コード,改行,*,*,*");
-        //      (*it).set_partOfSpeech("記号");
-        //      (*it).set_subclassification1("制御コード");
-        //      (*it).set_subclassification2("改行");
+        nodes[n] = Node("\n", "記号,制御コード,改行,*,*,*");
       }
     }
+    nodes.erase(nodes.begin() + n, nodes.end());
+  }
+
+  /// @brief 引数として渡された複数の自然文を並列に形態素解析し、それぞれのノードの配列を返す。
+  ///
+  /// WorkerPool::shared() に作業スレッドの処理を登録し、呼び出したスレッドと合わせて
+  /// 自然文を先頭から順に取り出して parseNode() で解析する。
+  /// スレッドを起動したり DB 接続を開いたりしないため、少数の自然文でも負荷は小さい。
+  /// DB の参照には db() が返すスレッドごとの読み込み専用の接続を利用し、
+  /// MeCab::Model と Darts インデックス、地名語キャッシュは全スレッドで共有する。
+  /// ロックは parseNode() が自然文ごとに取得するため、ここでは取得しない。
+  /// 呼び出したスレッドは、取り出しを終えた後に解析中の作業スレッドの終了だけを待つ。
+  /// まだ開始していない処理は待たないため、プールの作業スレッドから呼び出してもよい。
+  /// @arg @c sentences 解析対象の自然文の配列。
+  /// @arg ret 解析結果。sentences と同じ順に並んだ、形態素情報クラスの配列の配列。
+  /// @arg @c n_threads 呼び出したスレッドを含む並列数、0 以下の場合はプールの作業スレッド数。
+  /// @return 解析した自然文の数
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception MeCabErrException MeCabでエラー。
+  int MAImpl::parseNodeBatch(const std::vector<std::string>& sentences, std::vector<std::vector<Node> >& ret, int n_threads) const
+  {
     ret.clear();
-    ret.reserve(nodes.size()); 
-    // MeCabによるパース結果を地名語辞書を参照して変換する
-    convertMeCabNodeToNodeList(nodes, ret);
+    ret.resize(sentences.size());
+    if (sentences.size() == 0) return 0;
+
+    WorkerPool& pool = WorkerPool::shared();
+    if (n_threads <= 0) n_threads = int(pool.size());
+    if (size_t(n_threads) > sentences.size()) n_threads = int(sentences.size());
+
+    boost::shared_ptr<ParseNodeBatchJob> job(new ParseNodeBatchJob());
+    job->sentences = &sentences;
+    job->results = &ret;
+    job->next = 0;
+    job->failed = false;
+    job->active = 0;
+    job->closed = false;
+
+    try {
+      for (int i = 1; i < n_threads; i++) {
+        pool.submit([this, job]() { _parseNodeBatchWorker(this, job); });
+      }
+    } catch (...) {
+      // 登録できなかった分は、登録できた処理と呼び出したスレッドで解析する
+    }
+    _parseNodeBatchLoop(this, job.get());
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->closed = true;
+    job->idle.wait(lock, [&]() { return job->active == 0; });
+    if (job->error) std::rethrow_exception(job->error);
     return ret.size();
   }
 
+  /// @brief 入力ストリームを文に区切り、文ごとに形態素解析した結果を callback に渡す。
+  ///
+  /// 読み込みスレッドが入力を文に区切って tokenize() で MeCab による解析を行い、
+  /// 呼び出したスレッドは解析済みの文を順に取り出して地名語に変換する。
+  /// 読み込みスレッドは STREAM_QUEUE_SIZE 文まで先行し、それ以上は変換を待つ。
+  /// ロックは文ごとに取得するため、解析中にアクティブな辞書やクラスを変更した場合、
+  /// 変更後に変換を開始した文から新しい設定が適用される。
+  /// @arg @c in 解析対象の入力ストリーム（UTF-8）。
+  /// @arg @c callback 文ごとに解析結果と文の開始位置（文字数）を受け取る関数。
+  /// @arg @c max_sentence_bytes 区切り文字が無い場合に文を区切るバイト数。
+  /// @arg @c read_size 入力ストリームから一度に読み込むバイト数。
+  /// @return 解析した文の数
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception MeCabErrException MeCabでエラー。
+  int MAImpl::parseNodeStream(std::istream& in, const NodeStreamCallback& callback, size_t max_sentence_bytes, size_t read_size) const
+  {
+    if (max_sentence_bytes < 4) max_sentence_bytes = 4;
+    if (read_size < 1) read_size = 1;
+    ParseNodeStreamJob job;
+
+    // 読み込みスレッド、入力を文に区切り MeCab で解析する
+    std::thread reader([&]() {
+        try {
+          std::string buf;
+          std::vector<char> block(read_size);
+          size_t pos = 0;       // buf 内の未処理の文の開始位置
+          size_t scanned = 0;   // 区切り文字を探し終えた位置
+          size_t offset = 0;    // 入力の先頭からの文字数
+          bool eof = false;
+          for (;;) {
+            size_t end = _findSentenceEnd(buf, scanned, eof);
+            if (end == std::string::npos) {
+              // 末尾の 3 バイトは読み込みの境界をまたぐ区切り文字の一部かもしれないので、
+              // 次に読み込んだ後に改めて調べる
+              scanned = std::max(pos, buf.length() < 3 ? size_t(0) : buf.length() - 3);
+              if (buf.length() - pos >= max_sentence_bytes) {
+                // 区切り文字が無いので、文字の境界で区切る
+                end = pos + max_sentence_bytes;
+                while (end > pos + 1 && ((unsigned char)buf[end] & 0xC0) == 0x80) end--;
+              } else if (eof) {
+                if (pos == buf.length()) break;
+                end = buf.length();
+              } else {
+                in.read(block.data(), block.size());
+                size_t n = size_t(in.gcount());
+                if (n < block.size()) eof = true;
+                // 処理済みの部分を捨ててから追加する
+                buf.erase(0, pos);
+                scanned -= pos;
+                pos = 0;
+                buf.append(block.data(), n);
+                continue;
+              }
+            }
+
+            ParseNodeStreamJob::Item item;
+            item.offset = offset;
+            this->tokenize(buf.substr(pos, end - pos), item.nodes);
+            offset += _countCharacters(buf.data() + pos, end - pos);
+            pos = scanned = end;
+
+            std::unique_lock<std::mutex> lock(job.mutex);
+            job.not_full.wait(lock, [&]() { return job.stop || job.queue.size() < STREAM_QUEUE_SIZE; });
+            if (job.stop) break;
+            job.queue.push_back(std::move(item));
+            job.not_empty.notify_one();
+          }
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(job.mutex);
+          job.error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.done = true;
+        job.not_empty.notify_one();
+      });
+
+    // 呼び出したスレッド、地名語に変換して callback に渡す
+    int count = 0;
+    try {
+      std::vector<Node> nodes;
+      for (;;) {
+        ParseNodeStreamJob::Item item;
+        {
+          std::unique_lock<std::mutex> lock(job.mutex);
+          job.not_empty.wait(lock, [&]() { return job.done || job.queue.size() > 0; });
+          if (job.queue.size() == 0) break;
+          item = std::move(job.queue.front());
+          job.queue.pop_front();
+          job.not_full.notify_one();
+        }
+        nodes.clear();
+        nodes.reserve(item.nodes.size());
+        {
+          ReadLock lock(this->stateMutex);
+          convertMeCabNodeToNodeList(item.nodes, nodes);
+        }
+        count++;
+        if (!callback(nodes, item.offset)) break;
+      }
+    } catch (...) {
+      {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.stop = true;
+        job.not_full.notify_one();
+      }
+      reader.join();
+      throw;
+    }
+    {
+      std::lock_guard<std::mutex> lock(job.mutex);
+      job.stop = true;
+      job.not_full.notify_one();
+    }
+    reader.join();
+
+    if (job.error) std::rethrow_exception(job.error);
+    return count;
+  }
+
+  /// @brief 破棄時に parseNodeAsync の終了を通知する
+  struct MAImpl::AsyncDoneNotifier {
+    const MAImpl* ma;
+    AsyncDoneNotifier(const MAImpl* ma): ma(ma) {}
+    ~AsyncDoneNotifier() {
+      std::lock_guard<std::mutex> lock(ma->asyncMutex);
+      if (--ma->asyncPending == 0) ma->asyncDone.notify_all();
+    }
+  };
+
+  /// @brief 引数として渡された自然文を作業スレッドで形態素解析し、終了時に解析結果を callback に渡す。
+  ///
+  /// WorkerPool::shared() の作業スレッドで parseNode() を実行する。
+  /// 作業スレッドは所有スレッドではないため、DB の参照にはスレッドごとのリーダを利用する。
+  /// parseNode() の例外は callback に渡し、callback の例外は無視する。
+  /// @arg @c sentence 解析対象の自然文。
+  /// @arg @c callback 解析結果と例外を受け取る関数。
+  void MAImpl::parseNodeAsync(const std::string& sentence, const NodeAsyncCallback& callback) const
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->asyncMutex);
+      this->asyncPending++;
+    }
+    try {
+      WorkerPool::shared().submit([this, sentence, callback]() {
+          std::vector<Node> nodes;
+          std::exception_ptr error;
+          try {
+            this->parseNode(sentence, nodes);
+          } catch (...) {
+            error = std::current_exception();
+            nodes.clear();
+          }
+          // callback の中でスレッドが終了させられた場合も終了を通知する
+          AsyncDoneNotifier notifier(this);
+          try {
+            callback(nodes, error);
+#ifdef __GLIBCXX__
+          } catch (abi::__forced_unwind&) {
+            throw;  // pthread_exit などによるスレッドの終了は止めない
+#endif /* __GLIBCXX__ */
+          } catch (...) {
+            // 呼び出し元に戻す方法がないため無視する
+          }
+          // notifier の破棄後は this を参照しない
+        });
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(this->asyncMutex);
+      if (--this->asyncPending == 0) this->asyncDone.notify_all();
+      throw;
+    }
+  }
+
+  /// @brief 入力ストリームを文に区切って形態素解析し、解析結果のテキストをストリームに書き出す。
+  ///
+  /// parseNodeStream() で解析し、文ごとに整形したテキストを書き出す。
+  /// 整形には文の間で再利用するバッファを利用する。
+  /// @arg @c in 解析対象の入力ストリーム（UTF-8）。
+  /// @arg os 解析結果を書き出すストリーム。
+  /// @arg @c max_sentence_bytes 区切り文字が無い場合に文を区切るバイト数。
+  /// @return 解析した文の数
+  int MAImpl::parseStream(std::istream& in, std::ostream& os, size_t max_sentence_bytes) const
+  {
+    std::string buf;
+    return this->parseNodeStream(in, [&](const std::vector<Node>& nodes, size_t) {
+        buf.clear();
+        formatter->appendNodeList(nodes, buf);
+        os.write(buf.data(), buf.length());
+        return bool(os);
+      }, max_sentence_bytes);
+  }
+
+  /// @brief 現在のスレッドで参照に利用する辞書を得る。
+  ///
+  /// 辞書バンドルを参照している場合は全てのスレッドでバンドルを返す。
+  /// それ以外の場合、インスタンスを作成したスレッドでは dbap を、
+  /// それ以外のスレッドでは threadReader() が作成した DBAccessor を返す。
+  /// @return DictionaryReader へのポインタ
+  const DictionaryReader* MAImpl::db(void) const
+  {
+    if (this->bundlep) return this->bundlep.get();
+    if (std::this_thread::get_id() == this->ownerThread) return this->dbap.get();
+    return this->threadReader();
+  }
+
+  /// @brief 現在のスレッド専用の読み込み専用 DBAccessor を得る。
+  ///
+  /// 初めて呼ばれたときに DBAccessor::openReader() で作成し、
+  /// スレッドが終了するまで再利用する。
+  /// DB が更新された後は開き直し、破棄された MAImpl の接続はここで閉じる。
+  /// @return DBAccessor へのポインタ
+  DBAccessor* MAImpl::threadReader(void) const
+  {
+    const unsigned long serial = this->readerSerial.load();
+    std::vector<ThreadReader>& readers = thread_readers.readers;
+    for (std::vector<ThreadReader>::iterator it = readers.begin(); it != readers.end(); ) {
+      boost::shared_ptr<int> owner = (*it).owner.lock();
+      if (!owner) {
+        (*it).dbap->close();
+        it = readers.erase(it);
+        continue;
+      }
+      if (owner == this->readerToken) {
+        if ((*it).serial == serial) return (*it).dbap.get();
+        (*it).dbap->close();
+        (*it).dbap = this->dbap->openReader();
+        (*it).serial = serial;
+        return (*it).dbap.get();
+      }
+      it++;
+    }
+    ThreadReader reader;
+    reader.owner = this->readerToken;
+    reader.serial = serial;
+    reader.dbap = this->dbap->openReader();
+    readers.push_back(reader);
+    return readers.back().dbap.get();
+  }
+
   /// @brief MeCabによるパース結果を地名語辞書を参照して変換する。
   ///
-  /// @arg @c nodes [in] MeCabによるパース結果としての、形態素情報リスト。
+  /// 形態素情報は nodes から形態素情報拡張クラスの配列、 nodelist へと順に移動し、複製しない。
+  /// 形態素情報拡張クラスの配列はスレッドごとに再利用し、長い文の後は _trimThreadBuffer() で解放する。
+  /// @arg @c nodes [in] MeCabによるパース結果としての、形態素情報リスト。内容は移動される。
   /// @arg @c nodelist [out] 地名語辞書を参照して地名語変換を行った後の形態素情報リスト。
   void MAImpl::convertMeCabNodeToNodeList( NodeList& nodes, std::vector<Node>& nodelist) const
   {
     nodelist.clear();
-    NodeExtList nodeExts;
+    static thread_local NodeExtList nodeExts;
     NodeExtList::iterator it;
     NodeExt* lastNode = NULL;
 
@@ -383,6 +1058,8 @@ namespace geonlp
     nodeListToNodeExtList( nodes, nodeExts);
 
     if ( nodeExts.size() > 0){
+      StatsTimer timer(this->statsp.get(), STATS_PHBS);
+      timer.setRows(nodeExts.size());
       it = nodeExts.end();
       bool nextIsHead = false;
       do {
@@ -403,9 +1080,10 @@ namespace geonlp
       getLongestGeowordCandidate( it, nodeExts.end(), ex, s, e);
 
       // 地名語候補にならないnodeはそのままpush_back
+      // 出力した素性は再び参照しないので、形態素情報を移動する
       if (ex != nodeExts.end()){
         for ( NodeExtList::iterator itex = it; ; itex++){
-          nodelist.push_back( *itex);
+          nodelist.push_back( std::move(static_cast<Node&>(*itex)));
           lastNode = &(*itex);
           if ( itex == ex) break;
         }
@@ -421,7 +1099,7 @@ namespace geonlp
 
       if (lastNode && lastNode->canBeAntileader()) {
         // std::cerr << "Antileader: " << lastNode->toString() << std::endl;
-        nodelist.push_back(*s);
+        nodelist.push_back( std::move(static_cast<Node&>(*s)));
         lastNode = &(*s);
         it = s;
         it ++;
@@ -443,47 +1121,50 @@ namespace geonlp
           Node n = geowords.at(l - 1); // 結果の最後の語
           if (n.get_partOfSpeech() == "名詞" && n.get_subclassification1() == "接尾" && n.get_subclassification2() == "地名語") {
             geowords.pop_back(); // 「南」を結果から除去
-            NodeExt odd(n);      // mecab 解析結果に挿入
-            odd.setBeHead(true); // この語は地名の先頭になり得る
-            odd.setBeAntileader(false); // この語に続く語は地名語の可能性がある
-            next = nodeExts.insert(next, odd);
+            // mecab 解析結果の next の前に挿入する
+            // 直前の素性は地名語として処理済みなので、挿入せずに上書きする
+            next--;
+            *next = NodeExt(n);
+            next->setBeHead(true); // この語は地名の先頭になり得る
+            next->setBeAntileader(false); // この語に続く語は地名語の可能性がある
           }
         }
         // 直前に登録した語が地名修飾語の場合、
         // 地名語の前には地名修飾語はこないので変更する
         // 「むかわ町花園」など
-        int nl = nodelist.size();
-        if (nl > 0) {
-          Node lastnode = nodelist.at(nl - 1);
-          if (lastnode.get_conjugatedForm() == "名詞-固有名詞-地名修飾語") {
+        if (nodelist.size() > 0) {
+          Node& lastnode = nodelist.back();
+          if (lastnode.get_conjugatedForm_view() == "名詞-固有名詞-地名修飾語") {
             lastnode.set_conjugatedForm("");
-            nodelist.pop_back();
-            nodelist.push_back(lastnode);
           }
         }
-        nodelist.insert( nodelist.end(), geowords.begin(), geowords.end());
+        nodelist.insert( nodelist.end(), std::make_move_iterator(geowords.begin()), std::make_move_iterator(geowords.end()));
         lastNode = NULL;
         it = next;
       } else {
         // 地名語候補の最初の素性をそのままpush_backし、次から再度処理する。
-        nodelist.push_back( *s);
+        nodelist.push_back( std::move(static_cast<Node&>(*s)));
         lastNode = &(*s);
         it = s;
         it ++;
       }
     }
-
+    // 配列の領域は次の呼び出しで再利用し、残った形態素情報だけを解放する
+    nodeExts.clear();
+    _trimThreadBuffer(nodeExts);
   }
 
   /// @brief 形態素情報クラスのリストを、形態素情報拡張クラスのリストに変換する。
   ///
-  /// @arg @c nodes [in] 形態素情報クラスのリスト
+  /// 形態素情報は複製せずに移動する。
+  /// @arg @c nodes [in] 形態素情報クラスのリスト。内容は移動される。
   /// @arg @c nodeextlist [out] 形態素情報拡張クラスのリスト
   void MAImpl::nodeListToNodeExtList( NodeList& nodes, NodeExtList& nodeextlist) const
   {
     nodeextlist.clear();
+    nodeextlist.reserve(nodes.size());
     for ( NodeList::iterator it = nodes.begin(); it != nodes.end(); it++){
-      nodeextlist.push_back( NodeExt( *it));
+      nodeextlist.push_back( NodeExt( std::move(*it)));
     }
   }
 
@@ -497,7 +1178,8 @@ namespace geonlp
   /// @exception SqliteErrException Sqlite3でエラー。
   bool MAImpl::getGeowordEntry(const std::string& geonlp_id, Geoword& ret) const
   {
-    return dbap->findGeowordById(geonlp_id, ret);
+    ReadLock lock(this->stateMutex);
+    return this->db()->findGeowordById(geonlp_id, ret);
   }
 
   /// @brief 引数に与えられた文字列に一致するGeoword候補を取得する。
@@ -509,10 +1191,11 @@ namespace geonlp
   /// @exception SqliteErrException Sqlite3でエラー。
   int MAImpl::getGeowordEntries(const std::string & surface, std::map<std::string, Geoword>& ret) const
   {
+    ReadLock lock(this->stateMutex);
     Wordlist wordlist;
-    if (!this->getWordlistBySurface(surface, wordlist)) return 0;
+    if (!this->findWordlistBySurface(surface, wordlist)) return 0;
     std::vector<Geoword> vec;
-    dbap->getGeowordListFromWordlist(wordlist, vec); //dbap->findGeowordListBySurface(surface);
+    this->db()->getGeowordListFromWordlist(wordlist, vec); //dbap->findGeowordListBySurface(surface);
     ret.clear();
     for (std::vector<Geoword>::iterator it = vec.begin(); it != vec.end(); it++) {
       if (this->isInActiveDictionaryAndClass(*it)) {
@@ -526,6 +1209,477 @@ namespace geonlp
     return ret.size();
   }
 
+  /// @brief 引数に与えられた文字列に一致し、 view の辞書/クラスに含まれるGeoword候補を取得する。
+  ///        読みでも検索する。
+  /// @arg @c surface
+  /// @arg ret 地名語エントリクラスのマップ。keyがgeonlp_id、valueがGeoword(地名語エントリクラス)オブジェクト。
+  /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+  /// @return 取得した地名語エントリの数
+  int MAImpl::getGeowordEntries(const std::string & surface, std::map<std::string, Geoword>& ret, const ActiveView& view) const
+  {
+    ScopedViewBinding binding(this, view);
+    return this->getGeowordEntries(surface, ret);
+  }
+
+  /// @brief 読みに完全一致する Geoword 候補を取得する。
+  ///
+  /// 読みの darts インデックスで検索し、表記にだけ一致する地名語は含めない。
+  /// @arg @c yomi 読み
+  /// @arg ret 地名語エントリクラスのマップ。keyがgeonlp_id、valueがGeoword(地名語エントリクラス)オブジェクト。
+  /// @return 取得した地名語エントリの数
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception IndexNotExistsException インデックスが存在しない。
+  int MAImpl::getGeowordEntriesByYomi(const std::string& yomi, std::map<std::string, Geoword>& ret) const
+  {
+    ReadLock lock(this->stateMutex);
+    std::vector<ResultPair> results;
+    ret.clear();
+    this->searchYomiDarts(yomi, results);
+    if (results.size() == 0 || size_t(results.back().length) != yomi.length()) return 0;
+    this->collectYomiGeowords(yomi, results.back().value, ret);
+    return ret.size();
+  }
+
+  /// @brief 文字列の先頭に一致する読みを全て探し、その読みを持つ Geoword 候補を取得する。
+  ///
+  /// アクティブな地名語を持たない読みは含めない。
+  /// @arg @c text 検索する文字列
+  /// @arg ret 一致した読みとアクティブな地名語の組のリスト、読みの短い順
+  /// @return 一致した読みの数
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception IndexNotExistsException インデックスが存在しない。
+  int MAImpl::getGeowordEntriesByYomiPrefix(const std::string& text, std::vector<YomiMatch>& ret) const
+  {
+    ReadLock lock(this->stateMutex);
+    std::vector<ResultPair> results;
+    ret.clear();
+    this->searchYomiDarts(text, results);
+    for (std::vector<ResultPair>::const_iterator it = results.begin(); it != results.end(); it++) {
+      YomiMatch match;
+      match.yomi = text.substr(0, (*it).length);
+      this->collectYomiGeowords(match.yomi, (*it).value, match.geowords);
+      if (match.geowords.size() > 0) ret.push_back(match);
+    }
+    return ret.size();
+  }
+
+  /// @brief 文字列の先頭に一致する読みの darts の結果を探す。
+  ///
+  /// 読みの darts ファイルが無い場合（辞書バンドルや、読みのインデックスを作る前のインデックス）は
+  /// 表記と読みの両方を含む本体の darts で代用する。
+  /// 読みは標準化せずに登録されているので、検索文字列も標準化しない。
+  /// @arg @c text [in] 検索する文字列
+  /// @arg results [out] 一致した result_pair のリスト（一致したバイト数の昇順）
+  void MAImpl::searchYomiDarts(const std::string& text, std::vector<ResultPair>& results) const
+  {
+    Darts::DoubleArray::result_pair_type result_pair[1024];
+    const size_t max_results = sizeof(result_pair) / sizeof(result_pair[0]);
+    const DoubleArrayPtr& base = this->yomi_dap ? this->yomi_dap : this->dap;
+    const DoubleArrayPtr& delta = this->yomi_dap ? this->yomi_delta_dap : this->delta_dap;
+
+    results.clear();
+    if (base == NULL) {
+      throw IndexNotExistsException();
+    }
+    StatsTimer timer(this->statsp.get(), STATS_DARTS);
+    size_t num = base->commonPrefixSearch(text.c_str(), result_pair, max_results);
+    if (num > max_results) num = max_results;
+    if (delta && num < max_results) {
+      size_t num_delta = delta->commonPrefixSearch(text.c_str(), result_pair + num, max_results - num);
+      if (num_delta > max_results - num) num_delta = max_results - num;
+      std::inplace_merge(result_pair, result_pair + num, result_pair + num + num_delta, _isShorterResult);
+      num += num_delta;
+    }
+    timer.setRows(num);
+    results.assign(result_pair, result_pair + num);
+  }
+
+  /// @brief 読みの見出し語から、読みを持つアクティブな地名語を得る。
+  ///
+  /// 見出し語には同じ文字列を表記に持つ地名語や、差分更新で取り除かれた地名語も含まれるので、
+  /// 地名語ごとに読みを確認する。
+  /// @arg @c yomi [in] 一致した読み
+  /// @arg @c wordlist_id [in] 読みの見出し語の ID
+  /// @arg ret [out] keyがgeonlp_id、valueがGeowordオブジェクトのマップ
+  void MAImpl::collectYomiGeowords(const std::string& yomi, int wordlist_id, std::map<std::string, Geoword>& ret) const
+  {
+    Wordlist wordlist;
+    std::vector<Geoword> geowords;
+    ret.clear();
+    if (!this->db()->findWordlistById(wordlist_id, wordlist)) return;
+    this->db()->getGeowordListFromWordlist(wordlist, geowords);
+    for (std::vector<Geoword>::const_iterator it = geowords.begin(); it != geowords.end(); it++) {
+      if (this->isInActiveDictionaryAndClass(*it) && hasGeowordYomi(*it, yomi)) {
+        ret.insert(std::make_pair((*it).get_geonlp_id(), (*it)));
+      }
+    }
+  }
+
+  /// @brief 補完候補を静的スコアの降順、同点の場合は見出し語の文字コード順に並べる
+  static bool _isBetterCompletion(const std::pair<unsigned int, size_t>& a, const std::pair<unsigned int, size_t>& b) {
+    if (a.first != b.first) return a.first > b.first;
+    return a.second < b.second;
+  }
+
+  /// @brief 前方一致する見出し語を静的スコアの高い順に k 件まで取得する。
+  ///
+  /// 本体と差分の darts で前方一致する見出し語を全て列挙し、
+  /// 補完候補表の静的スコアで並べてから、上位の候補から順に
+  /// アクティブな辞書/クラスで絞り込む。
+  /// 補完候補表に無い見出し語（差分更新で変更された見出し語、辞書バンドル）は
+  /// Wordlist を読み込んで判定する。
+  /// @arg @c prefix 入力中の文字列（表記または読みの先頭部分）
+  /// @arg @c k      取得する候補の最大数
+  /// @arg ret 補完候補のリスト、スコアの降順（同点の場合は見出し語の文字コード順）
+  /// @return 取得した候補の数
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception IndexNotExistsException インデックスが存在しない。
+  int MAImpl::getCompletions(const std::string& prefix, size_t k, std::vector<Completion>& ret) const
+  {
+    ReadLock lock(this->stateMutex);
+    ret.clear();
+    if (this->dap == NULL) {
+      throw IndexNotExistsException();
+    }
+    if (k == 0) return 0;
+
+    // 前方一致する見出し語IDを列挙する
+    const std::string key_standardized = this->standardize(prefix);
+    std::vector<int> ids;
+    {
+      StatsTimer timer(this->statsp.get(), STATS_DARTS);
+      predictiveSearch(*this->dap, key_standardized, ids);
+      if (this->delta_dap) {
+        std::vector<int> delta_ids;
+        predictiveSearch(*this->delta_dap, key_standardized, delta_ids);
+        ids.insert(ids.end(), delta_ids.begin(), delta_ids.end());
+      }
+      timer.setRows(ids.size());
+    }
+
+    // 静的スコアで並べる
+    // 有効期間を記録していない古い候補表は、期間を指定した場合には利用しない
+    const ActiveFilter& filter = this->filter();
+    const CompletionTable* table = this->completion_table.get();
+    if (table && filter.hasPeriod() && !table->hasPeriods()) table = NULL;
+    std::vector<std::pair<unsigned int, size_t> > candidates;  // スコア, ids 内の位置
+    std::map<int, Wordlist> loaded;  // 補完候補表に無い見出し語
+    candidates.reserve(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+      const CompletionRecord* record = table ? table->getRecord(ids[i]) : NULL;
+      if (record) {
+        candidates.push_back(std::make_pair(record->score, i));
+        continue;
+      }
+      Wordlist& wordlist = loaded[ids[i]];
+      if (!this->db()->findWordlistById(ids[i], wordlist)) continue;
+      candidates.push_back(std::make_pair((unsigned int)wordlist.get_entries().size(), i));
+    }
+    std::sort(candidates.begin(), candidates.end(), _isBetterCompletion);
+
+    // 上位の候補からアクティブな地名語を含むものを選ぶ
+    std::set<std::string> surfaces;
+    std::vector<Geoword> geowords;
+    for (size_t i = 0; i < candidates.size() && ret.size() < k; i++) {
+      const int id = ids[candidates[i].second];
+      const CompletionRecord* record = table ? table->getRecord(id) : NULL;
+      Completion completion;
+      completion.score = candidates[i].first;
+      if (record) {
+        completion.surface = record->surface;
+        if (surfaces.count(completion.surface) > 0) continue;
+        for (std::vector<CompletionEntry>::const_iterator it = record->entries.begin(); it != record->entries.end(); it++) {
+          if (filter.isActive((*it).dictionary_id, table->getClass((*it).ne_class), (*it).valid_from, (*it).valid_to)) {
+            completion.geonlp_ids.push_back((*it).geonlp_id);
+          }
+        }
+      } else {
+        const Wordlist& wordlist = loaded[id];
+        completion.surface = wordlist.get_surface();
+        if (surfaces.count(completion.surface) > 0) continue;
+        this->db()->getGeowordListFromWordlist(wordlist, geowords);
+        for (std::vector<Geoword>::const_iterator it = geowords.begin(); it != geowords.end(); it++) {
+          if (this->isInActiveDictionaryAndClass(*it)) completion.geonlp_ids.push_back((*it).get_geonlp_id());
+        }
+      }
+      if (completion.geonlp_ids.empty()) continue;
+      surfaces.insert(completion.surface);
+      ret.push_back(completion);
+    }
+    return ret.size();
+  }
+
+  /// @brief 前方一致し、 view の辞書/クラスに含まれる見出し語をスコアの高い順に k 件まで取得する。
+  /// @arg @c prefix 入力中の文字列（表記または読みの先頭部分）
+  /// @arg @c k      取得する候補の最大数
+  /// @arg ret 補完候補のリスト、スコアの降順
+  /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+  /// @return 取得した候補の数
+  int MAImpl::getCompletions(const std::string& prefix, size_t k, std::vector<Completion>& ret, const ActiveView& view) const
+  {
+    ScopedViewBinding binding(this, view);
+    return this->getCompletions(prefix, k, ret);
+  }
+
+  /// @brief 近似一致した見出し語を距離の昇順、同じ距離では見出し語の文字コード順に並べる
+  static bool _isCloserMatch(const FuzzyResult& a, const FuzzyResult& b) {
+    if (a.distance != b.distance) return a.distance < b.distance;
+    return a.key < b.key;
+  }
+
+  /// @brief 表記または読みとの編集距離が max_distance 以下の見出し語と、その Geoword 候補を取得する。
+  ///
+  /// 本体と差分の darts をそれぞれたどり、一致した見出し語からアクティブな地名語を取り出す。
+  /// アクティブな地名語を含まない見出し語は返さない。
+  /// @arg @c surface      検索する文字列
+  /// @arg @c max_distance 許容する編集距離
+  /// @arg ret 一致した見出し語とアクティブな地名語の組のリスト、距離の昇順（同じ距離では見出し語の文字コード順）
+  /// @return 一致した見出し語の数
+  /// @exception SqliteErrException Sqlite3でエラー。
+  /// @exception IndexNotExistsException インデックスが存在しない。
+  int MAImpl::getGeowordEntriesFuzzy(const std::string& surface, unsigned int max_distance, std::vector<FuzzyMatch>& ret) const
+  {
+    ReadLock lock(this->stateMutex);
+    ret.clear();
+    if (this->dap == NULL) {
+      throw IndexNotExistsException();
+    }
+
+    const std::string key_standardized = this->standardize(surface);
+    std::vector<FuzzyResult> results;
+    {
+      StatsTimer timer(this->statsp.get(), STATS_DARTS);
+      fuzzySearch(*this->dap, key_standardized, max_distance, results);
+      if (this->delta_dap) {
+        std::vector<FuzzyResult> delta_results;
+        fuzzySearch(*this->delta_dap, key_standardized, max_distance, delta_results);
+        results.insert(results.end(), delta_results.begin(), delta_results.end());
+      }
+      timer.setRows(results.size());
+    }
+    std::sort(results.begin(), results.end(), _isCloserMatch);
+
+    Wordlist wordlist;
+    std::vector<Geoword> geowords;
+    for (std::vector<FuzzyResult>::const_iterator it = results.begin(); it != results.end(); it++) {
+      if (!this->db()->findWordlistById((*it).value, wordlist)) continue;
+      this->db()->getGeowordListFromWordlist(wordlist, geowords);
+      FuzzyMatch match;
+      match.key = (*it).key;
+      match.distance = (*it).distance;
+      for (std::vector<Geoword>::const_iterator it2 = geowords.begin(); it2 != geowords.end(); it2++) {
+        if (this->isInActiveDictionaryAndClass(*it2)) {
+          match.geowords.insert(std::make_pair((*it2).get_geonlp_id(), (*it2)));
+        }
+      }
+      if (match.geowords.size() > 0) ret.push_back(match);
+    }
+    return ret.size();
+  }
+
+  /// @brief 編集距離が max_distance 以下の見出し語と、 view の辞書/クラスに含まれる Geoword 候補を取得する。
+  /// @arg @c surface      検索する文字列
+  /// @arg @c max_distance 許容する編集距離
+  /// @arg ret 一致した見出し語とアクティブな地名語の組のリスト、距離の昇順
+  /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+  /// @return 一致した見出し語の数
+  int MAImpl::getGeowordEntriesFuzzy(const std::string& surface, unsigned int max_distance, std::vector<FuzzyMatch>& ret, const ActiveView& view) const
+  {
+    ScopedViewBinding binding(this, view);
+    return this->getGeowordEntriesFuzzy(surface, max_distance, ret);
+  }
+
+  /// @brief 空間インデックスと差分の地点から、矩形に含まれるアクティブな地点を得る。
+  ///
+  /// 全体を再構築した時点の空間インデックスからは差分更新で変更された辞書の地点が除かれているので、
+  /// インデックスを開く際に集めた差分の地点も検索する。
+  void MAImpl::searchSpatialBox(double min_lat, double min_lon, double max_lat, double max_lon, std::vector<const SpatialPoint*>& ret) const
+  {
+    ret.clear();
+    if (!this->spatial_index) {
+      throw IndexNotExistsException("The spatial index does not exist, build it with updateIndex() (not available with the bundle).");
+    }
+    const ActiveFilter& filter = this->filter();
+    if (filter.hasPeriod() && !this->spatial_index->hasPeriods()) {
+      throw IndexNotExistsException("The spatial index has no validity periods, rebuild it with updateIndex() to search with a period.");
+    }
+    const SpatialIndex* indexes[] = { this->spatial_index.get(), this->spatial_delta.get() };
+    std::vector<const SpatialPoint*> points;
+    StatsTimer timer(this->statsp.get(), STATS_SPATIAL);
+    for (size_t i = 0; i < sizeof(indexes) / sizeof(indexes[0]); i++) {
+      if (!indexes[i]) continue;
+      indexes[i]->searchBox(min_lat, min_lon, max_lat, max_lon, points);
+      for (std::vector<const SpatialPoint*>::const_iterator it = points.begin(); it != points.end(); it++) {
+        if (filter.isActive((*it)->dictionary_id, indexes[i]->getClass((*it)->ne_class), (*it)->valid_from, (*it)->valid_to)) {
+          ret.push_back(*it);
+        }
+      }
+    }
+    timer.setRows(ret.size());
+  }
+
+  /// @brief 地点を地名語IDの順に並べる
+  static bool _isLessGeonlpId(const SpatialPoint* a, const SpatialPoint* b) {
+    return a->geonlp_id < b->geonlp_id;
+  }
+
+  /// @brief 中心からの距離と地点の組を距離の昇順、同じ距離では地名語IDの順に並べる
+  static bool _isNearerPoint(const std::pair<double, const SpatialPoint*>& a, const std::pair<double, const SpatialPoint*>& b) {
+    if (a.first != b.first) return a.first < b.first;
+    return a.second->geonlp_id < b.second->geonlp_id;
+  }
+
+  /// @brief 地点のリストから地名語IDのリストを作る
+  static void _pointsToGeonlpIds(const std::vector<const SpatialPoint*>& points, std::vector<std::string>& ret) {
+    ret.clear();
+    ret.reserve(points.size());
+    for (std::vector<const SpatialPoint*>::const_iterator it = points.begin(); it != points.end(); it++) {
+      ret.push_back((*it)->geonlp_id);
+    }
+  }
+
+  /// @brief 矩形に含まれる地点を持つ、アクティブな辞書/クラスの地名語IDを取得する。
+  /// @arg @c min_lat 南端の緯度
+  /// @arg @c min_lon 西端の経度
+  /// @arg @c max_lat 北端の緯度
+  /// @arg @c max_lon 東端の経度
+  /// @arg ret 地名語IDのリスト、地名語IDの順
+  /// @return 取得した地名語IDの数
+  /// @exception IndexNotExistsException 空間インデックスが存在しない。
+  int MAImpl::getGeowordIdsInBox(double min_lat, double min_lon, double max_lat, double max_lon, std::vector<std::string>& ret) const
+  {
+    ReadLock lock(this->stateMutex);
+    std::vector<const SpatialPoint*> points;
+    this->searchSpatialBox(min_lat, min_lon, max_lat, max_lon, points);
+    std::sort(points.begin(), points.end(), _isLessGeonlpId);
+    _pointsToGeonlpIds(points, ret);
+    return ret.size();
+  }
+
+  /// @brief 矩形に含まれる地点を持つ、 view の辞書/クラスの地名語IDを取得する。
+  /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+  int MAImpl::getGeowordIdsInBox(double min_lat, double min_lon, double max_lat, double max_lon, std::vector<std::string>& ret, const ActiveView& view) const
+  {
+    ScopedViewBinding binding(this, view);
+    return this->getGeowordIdsInBox(min_lat, min_lon, max_lat, max_lon, ret);
+  }
+
+  /// @brief 中心からの距離が radius 以下の地点を持つ、アクティブな辞書/クラスの地名語IDを取得する。
+  ///
+  /// 半径を含む矩形で空間インデックスを検索してから、 Util::latlonDist() で距離を確かめる。
+  /// 緯度 1 度は 110km 以上なので、矩形の幅はそれを下限として余裕を持たせる。
+  /// @arg @c lat    中心の緯度
+  /// @arg @c lon    中心の経度
+  /// @arg @c radius 半径（単位：km）
+  /// @arg ret 地名語IDのリスト、中心に近い順（同じ距離では地名語IDの順）
+  /// @return 取得した地名語IDの数
+  /// @exception ServiceRequestFormatException 中心の経緯度が範囲外。
+  /// @exception IndexNotExistsException 空間インデックスが存在しない。
+  int MAImpl::getGeowordIdsInRadius(double lat, double lon, double radius, std::vector<std::string>& ret) const
+  {
+    ReadLock lock(this->stateMutex);
+    ret.clear();
+    if (lat < -90.0 || lat > 90.0 || lon < -180.0 || lon > 180.0) {
+      throw ServiceRequestFormatException("The latitude or longitude of the center is out of range.");
+    }
+    if (radius < 0.0) return 0;
+
+    const double dlat = radius / 110.0;
+    const double max_abs_lat = std::min(90.0, fabs(lat) + dlat);
+    const double cos_lat = cos(max_abs_lat * M_PI / 180.0);
+    const double dlon = (cos_lat > 1e-6) ? radius / (110.0 * cos_lat) : 360.0;
+    std::vector<const SpatialPoint*> points;
+    if (lon - dlon < -180.0 || lon + dlon > 180.0) {
+      // 経度 180 度をまたぐ場合は経度の全範囲を検索する
+      this->searchSpatialBox(lat - dlat, -180.0, lat + dlat, 180.0, points);
+    } else {
+      this->searchSpatialBox(lat - dlat, lon - dlon, lat + dlat, lon + dlon, points);
+    }
+
+    std::vector<std::pair<double, const SpatialPoint*> > distances;
+    for (std::vector<const SpatialPoint*>::const_iterator it = points.begin(); it != points.end(); it++) {
+      double dist = Util::latlonDist(lat, lon, (*it)->latitude, (*it)->longitude);
+      if (dist <= radius) distances.push_back(std::make_pair(dist, *it));
+    }
+    std::sort(distances.begin(), distances.end(), _isNearerPoint);
+    ret.reserve(distances.size());
+    for (size_t i = 0; i < distances.size(); i++) ret.push_back(distances[i].second->geonlp_id);
+    return ret.size();
+  }
+
+  /// @brief 中心からの距離が radius 以下の地点を持つ、 view の辞書/クラスの地名語IDを取得する。
+  /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+  int MAImpl::getGeowordIdsInRadius(double lat, double lon, double radius, std::vector<std::string>& ret, const ActiveView& view) const
+  {
+    ScopedViewBinding binding(this, view);
+    return this->getGeowordIdsInRadius(lat, lon, radius, ret);
+  }
+
+  /// @brief GeoJSON の範囲に含まれる地点を持つ、アクティブな辞書/クラスの地名語IDを取得する。
+  ///
+  /// 範囲の外接矩形で空間インデックスを検索してから、ポリゴンに含まれるかどうかを判定する。
+  /// @arg @c geojson Polygon または MultiPolygon を表す GeoJSON（Feature, FeatureCollection も可）
+  /// @arg ret 地名語IDのリスト、地名語IDの順
+  /// @return 取得した地名語IDの数
+  /// @exception ServiceRequestFormatException GeoJSON の形式が正しくない。
+  /// @exception IndexNotExistsException 空間インデックスが存在しない。
+  int MAImpl::getGeowordIdsInGeometry(const picojson::value& geojson, std::vector<std::string>& ret) const
+  {
+    GeoRegion region;
+    region.setGeoJSON(geojson);
+    ReadLock lock(this->stateMutex);
+    std::vector<const SpatialPoint*> points, inside;
+    this->searchSpatialBox(region.getMinLatitude(), region.getMinLongitude(), region.getMaxLatitude(), region.getMaxLongitude(), points);
+    for (std::vector<const SpatialPoint*>::const_iterator it = points.begin(); it != points.end(); it++) {
+      if (region.contains((*it)->latitude, (*it)->longitude)) inside.push_back(*it);
+    }
+    std::sort(inside.begin(), inside.end(), _isLessGeonlpId);
+    _pointsToGeonlpIds(inside, ret);
+    return ret.size();
+  }
+
+  /// @brief GeoJSON の範囲に含まれる地点を持つ、 view の辞書/クラスの地名語IDを取得する。
+  /// @arg @c view createActiveView() で作成したアクティブな辞書/クラス。
+  int MAImpl::getGeowordIdsInGeometry(const picojson::value& geojson, std::vector<std::string>& ret, const ActiveView& view) const
+  {
+    ScopedViewBinding binding(this, view);
+    return this->getGeowordIdsInGeometry(geojson, ret);
+  }
+
+  /// @brief 地名語IDのリストを、地点が GeoJSON の範囲に含まれるかどうかで絞り込む。
+  ///
+  /// 地点は空間インデックス、差分の地点の順に探し、どちらにも無い場合は地名語テーブルから読み込む。
+  /// 辞書バンドルなど空間インデックスを持たない場合も地名語テーブルから読み込んで判定する。
+  /// 経緯度を持たない地名語と、存在しない地名語IDは常に残す。
+  /// @arg @c geonlp_ids 地名語IDのリスト
+  /// @arg @c geojson    Polygon または MultiPolygon を表す GeoJSON（Feature, FeatureCollection も可）
+  /// @arg @c inside     true の場合は範囲に含まれる地名語、 false の場合は含まれない地名語を残す
+  /// @arg ret 残した地名語IDのリスト、 geonlp_ids の順
+  /// @return 残した地名語IDの数
+  /// @exception ServiceRequestFormatException GeoJSON の形式が正しくない。
+  int MAImpl::filterGeowordIdsByGeometry(const std::vector<std::string>& geonlp_ids, const picojson::value& geojson, bool inside, std::vector<std::string>& ret) const
+  {
+    GeoRegion region;
+    region.setGeoJSON(geojson);
+    ReadLock lock(this->stateMutex);
+    ret.clear();
+    Geoword geo;
+    for (std::vector<std::string>::const_iterator it = geonlp_ids.begin(); it != geonlp_ids.end(); it++) {
+      const SpatialPoint* point = this->spatial_index ? this->spatial_index->findPoint(*it) : NULL;
+      if (!point && this->spatial_delta) point = this->spatial_delta->findPoint(*it);
+      double lat, lon;
+      if (point) {
+        lat = point->latitude;
+        lon = point->longitude;
+      } else if (!this->db()->findGeowordById(*it, geo) || !parseLatLon(geo.get_latitude(), geo.get_longitude(), lat, lon)) {
+        ret.push_back(*it);  // 座標を持たない地名語は残す
+        continue;
+      }
+      if (region.contains(lat, lon) == inside) ret.push_back(*it);
+    }
+    return ret.size();
+  }
+
   /// @brief 引数に与えられた文字列からGeoword候補を取得する。読みも対象とする。
   ///
   /// @arg @c geoword 語幹または全体の表記
@@ -533,15 +1687,26 @@ namespace geonlp
   /// @exception SqliteNotInitializedException Sqlite3が未初期化。
   /// @exception SqliteErrException Sqlite3でエラー。
   bool MAImpl::getWordlistBySurface(const std::string& key, Wordlist& ret) const
+  {
+    ReadLock lock(this->stateMutex);
+    return this->findWordlistBySurface(key, ret);
+  }
+
+  /// @brief 表記に完全一致する Wordlist を得る。
+  ///
+  /// getWordlistBySurface() と同じだがロックを取得しない。
+  /// @arg @c key 語幹または全体の表記
+  /// @arg @c ret [out] Wordlist オブジェクト
+  /// @return 見つかった場合 true
+  bool MAImpl::findWordlistBySurface(const std::string& key, Wordlist& ret) const
   {
     // 表記に一致する Wordlist を Darts で検索する
-    Darts::DoubleArray::result_pair_type lpair = this->getLongestResultWithDarts(key, false);
-#ifdef HAVE_LIBDAMS
-    if (lpair.length != damswrapper::get_standardized_string(key).length()) return false; // 見つからない
-#else
-    if (lpair.length != key.length()) return false; // 見つからない
-#endif /* HAVE_LIBDAMS */
-    return dbap->findWordlistById(lpair.value, ret);
+    // 標準化は一度だけ行い、前方一致検索と長さの比較の両方に利用する
+    const std::string key_standardized = this->standardize(key);
+    std::vector<ResultPair> results;
+    this->getActiveResultsWithStandardizedKey(key_standardized, results, false);
+    if (results.size() == 0 || size_t(results.back().length) != key_standardized.length()) return false; // 見つからない
+    return this->db()->findWordlistById(results.back().value, ret);
   }
 
   /// @brief 地名語候補を得る。
@@ -572,7 +1737,8 @@ namespace geonlp
       } else if ( (*it).canBePrefix()){
         NodeExtList::iterator nextnode = it;
         nextnode++;
-        if ( (*nextnode).canBeHead()) {
+        // 接頭辞が末尾の素性の場合は次の素性が無い
+        if ( nextnode != end && (*nextnode).canBeHead()) {
           // Pが見つかった
           // std::cout << "P found: " << it->get_surface() << std::endl;
           s = it;
@@ -612,56 +1778,52 @@ namespace geonlp
   {
     NodeExtList::iterator end = e;
     next = e; next++;
-    std::string surface, standardized;
+    std::string surface;
+    size_t standardized_length;
     Node node("","");
     Darts::DoubleArray::result_pair_type lpair;
     ret.clear();
 
     // Darts で最長一致する候補を絞り込む
-    std::string key = joinGeowords(s, end);
-    lpair = getLongestResultWithDarts(key);
+    // 区間全体で一度だけ前方一致検索を行い、末尾を削った場合も結果を再利用する
+    CandidateSpan span;
+    this->initCandidateSpan(s, e, span);
+    int k = int(span.lengths.size()) - 1;  // end の位置
+    const Darts::DoubleArray::result_pair_type lpair_key = this->getLongestResultInSpan(span, k);
+    lpair = lpair_key;
 
-    for (end = e; ; end--, next--) {
+    for (end = e; ; end--, next--, k--) {
 
       if (lpair.length == 0) {
         // 前方一致する候補が一つもないので、探さないで終了
         break;
       }
 
-      surface = joinGeowords(s, end);
-#ifdef HAVE_LIBDAMS
-      standardized = damswrapper::get_standardized_string(surface);
-#else
-      standardized = surface;
-#endif /* HAVE_LIBDAMS */
+      surface = span.key.substr(0, span.lengths[k]);
+      standardized_length = this->getStandardizedLength(span, k);
 #ifdef DEBUG
       std::cerr << "surface: '" << surface << "', lpair:[" << lpair.value << ", " << lpair.length << "]" <<std::endl;
 #endif /* DEBUG */
 
-      if (standardized.length() > lpair.length) {
+      if (standardized_length > lpair.length) {
         // この長さを持つ候補は存在しないので、最後の一単語を削って再チェック
-        for (unsigned int l = standardized.length(); l > lpair.length;) {
+        for (unsigned int l = standardized_length; l > lpair.length;) {
           if (s == end) {
             break; // これ以上削れない
           }
-          end--;
-          surface = joinGeowords(s, end);
-#ifdef HAVE_LIBDAMS
-          standardized = damswrapper::get_standardized_string(surface);
-#else
-          standardized = surface;
-#endif /* HAVE_LIBDAMS */
-          l = standardized.length();
+          end--; k--;
+          standardized_length = this->getStandardizedLength(span, k);
+          l = standardized_length;
           if (l < lpair.length) {
             next = end;
             next++;
             if (next->canBeSuffix()) {
               // 削りすぎた＆接尾辞の可能性があるので一単語戻す
-              end++;
+              // （standardized_length は削った状態のまま残し、表記の完全一致とはみなさない）
+              end++; k++;
             } else {
               // 短くなった文字列に対し、Darts の最長一致候補を再検索
-              surface = joinGeowords(s, end);
-              lpair = getLongestResultWithDarts(surface);
+              lpair = this->getLongestResultInSpan(span, k);
               if (lpair.length == 0) {
                 // これより短い地名語は存在しない
                 return ret.size();
@@ -671,7 +1833,7 @@ namespace geonlp
         }
         next = end;
         next++;
-        surface = joinGeowords(s, end);
+        surface = span.key.substr(0, span.lengths[k]);
 
 #ifdef DEBUG
         std::cerr << "  -> " << surface << std::endl;
@@ -686,7 +1848,7 @@ namespace geonlp
       // std::cerr << "surface = " << surface << std::endl;
 
       // 地名辞書を参照
-      if (standardized.length() == lpair.length) {
+      if (standardized_length == lpair.length) {
         std::string alternative = "*";
         // Darts の候補と一致する場合、地名語が存在する
         if (s == end) { // 1素性の場合
@@ -737,27 +1899,12 @@ namespace geonlp
       // 一素性になったら終了
       if (s == end) break;
 
-      // darts 候補の方が短いので、もう一度候補を取得しなおす
-      lpair = getLongestResultWithDarts(key);
+      // darts 候補の方が短いので、区間全体に対する候補に戻す
+      lpair = lpair_key;
     }
     return ret.size();
   }
 
-  /// @brief 素性の表層形を連結した文字列を得る。
-  /// 
-  /// @arg @c s [in] 地名語候補を構成する素性シーケンスの先頭
-  /// @arg @c e [in] 地名語候補を構成する素性シーケンスの末尾
-  /// @return 得られた地名語候補
-  std::string MAImpl::joinGeowords( NodeExtList::iterator s, NodeExtList::iterator e) const
-  {
-    std::string surface;
-    for ( ; ; s++){
-      surface += s->get_surface();
-      if ( s== e) break;
-    }
-    return surface;
-  }
-
   /// @brief 地名接尾辞を表すNodeを得る。
   ///
   /// @arg @c suffix 地名接尾辞
@@ -779,11 +1926,11 @@ namespace geonlp
   /// @retval false 地名語が見つからなかった。
   bool MAImpl::findGeowordNode(const std::string& surface, Node& node) const {
     Wordlist wordlist;
-    this->dbap->findWordlistBySurface(surface, wordlist);
+    this->db()->findWordlistBySurface(surface, wordlist);
     if (!wordlist.isValid()) return false; // 該当なし
 
     std::vector<Geoword> geowords;
-    this->dbap->getGeowordListFromWordlist(wordlist, geowords, 1);
+    this->db()->getGeowordListFromWordlist(wordlist, geowords, 1, true);
     Geoword geoword = geowords[0];
     Node newnode(surface, "名詞,固有名詞,地名語,-,*,*,-,-,-");
     node = newnode;
@@ -796,42 +1943,59 @@ namespace geonlp
 
   /// @brief darts 見出し語IDから、地名語Nodeを得る。
   ///              読みしか一致しない場合は結果に含めない。
+  ///
+  /// アクティブな地名語に限定した idlist は見出し語IDごとに記憶しておき、
+  /// アクティブな辞書/クラスやインデックスが変更されるまで再利用する。
   /// @arg @c lpair [in] darts 見出し語ID
   /// @retval 地名語Node
   Node MAImpl::getGeowordNode(unsigned int id, std::string& alternative) const
   {
-    std::string surface;
-    geonlp::Wordlist wordlist;
-    dbap->findWordlistById(id, wordlist);
-    surface = wordlist.get_surface();
-    if (!wordlist.isValid()) {
-      std::ostringstream oss;
-      oss << "No entry in wordlist with id=" << id;
-      throw std::runtime_error(oss.str());
+    GeowordNodeCache::Entry entry;
+    const unsigned long generation = this->filter().getGeneration();
+    // DB の更新前に作成した ActiveView の場合、見出し語IDが変わっているため記憶しない
+    const bool cacheable = this->isFilterCurrent();
+    bool found = false;
+    if (cacheable) {
+      found = this->geowordNodeCache.get(generation, id, entry);
+      if (this->statsp) this->statsp->addCacheLookup(STATS_GEOWORD_NODE_CACHE, found);
     }
-    std::string feature = "名詞,固有名詞,地名語,-," + alternative + ",*,-,-,-";
-    Node node( surface, feature);
-    node.set_originalForm(surface);
-    node.set_yomi(wordlist.get_yomi());
-    node.set_pronunciation(wordlist.get_yomi());
 
-    // アクティブな地名語に限定した idlist を再構築
-    std::vector<Geoword> geowords;
-    this->dbap->getGeowordListFromWordlist(wordlist, geowords);
-    std::string new_idlist = "";
-    for (std::vector<Geoword>::iterator it = geowords.begin(); it != geowords.end(); it++) {
-      if (this->isInActiveDictionaryAndClass(*it) && this->isSurfaceMatched(*it, surface)) { // アクティブ
-        Geoword geoword = (*it);
-        std::string elem = geoword.get_geonlp_id() + ":" + geoword.get_typical_name();
-        if (new_idlist.length() == 0) {
-          new_idlist = elem;
-        } else {
-          new_idlist += "/" + elem;
-        }
-      } // アクティブではない場合、追加しない
+    if (!found) {
+      geonlp::Wordlist wordlist;
+      this->db()->findWordlistById(id, wordlist);
+      if (!wordlist.isValid()) {
+        std::ostringstream oss;
+        oss << "No entry in wordlist with id=" << id;
+        throw std::runtime_error(oss.str());
+      }
+      entry.surface = wordlist.get_surface();
+      entry.yomi = wordlist.get_yomi();
+
+      // アクティブな地名語に限定した idlist を再構築
+      std::vector<Geoword> geowords;
+      std::vector<size_t> entry_indexes;
+      this->db()->getGeowordListFromWordlist(wordlist, geowords, 0, true, &entry_indexes);
+      const std::vector<WordlistEntry>& entries = wordlist.get_entries();
+      const unsigned long long surface_hash = this->getSurfaceHash(entries, entry.surface);
+      boost::shared_ptr<std::vector<GeowordCandidate> > candidates(new std::vector<GeowordCandidate>());
+      for (size_t i = 0; i < geowords.size(); i++) {
+        const Geoword& geo = geowords[i];
+        const WordlistEntry* e = (i < entry_indexes.size()) ? &entries[entry_indexes[i]] : NULL;
+        if (this->isInActiveDictionaryAndClass(geo) && this->isSurfaceMatched(geo, e, entry.surface, surface_hash)) { // アクティブ
+          candidates->push_back(GeowordCandidate(std::string(geo.get_geonlp_id_view()), geo.get_typical_name()));
+        } // アクティブではない場合、追加しない
+      }
+      entry.candidates = candidates;
     }
-    //    std::cerr << std::endl << "new_idlist = '" << new_idlist << "'" << std::endl;
-    node.set_subclassification3(new_idlist);
+
+    if (!found && cacheable) this->geowordNodeCache.put(generation, id, entry);
+
+    std::string feature = "名詞,固有名詞,地名語,-," + alternative + ",*,-,-,-";
+    Node node( entry.surface, feature);
+    node.set_originalForm(entry.surface);
+    node.set_yomi(entry.yomi);
+    node.set_pronunciation(entry.yomi);
+    node.set_geowordCandidates(entry.candidates);
     return node;
   }
 
@@ -853,92 +2017,315 @@ namespace geonlp
   /// @return 最長一致する lpair 構造体、 lpair.length に一致したバイト数、 lpair.value に wordlist_id
   Darts::DoubleArray::result_pair_type MAImpl::getLongestResultWithDarts(const std::string& key, bool bSurfaceOnly) const
   {
-    Darts::DoubleArray::result_pair_type result_pair[1024];
     Darts::DoubleArray::result_pair_type lpair;
-    geonlp::Wordlist wordlist;
-    std::vector<geonlp::Geoword> geowords;
-    std::string idlist;
+    std::vector<ResultPair> results;
 
     lpair.value = 0; lpair.length = 0;
+    this->getActiveResultsWithDarts(key, results, bSurfaceOnly);
+    if (results.size() > 0) lpair = results.back();
+    return lpair;
+  }
 
+  /// @brief darts を利用して与えられた文字列に前方一致し、アクティブな地名語を含む wordlist を全て探す。
+  /// @arg @c key [in] 先頭が地名の可能性のある検索対象文字列
+  /// @arg results [out] 一致した lpair 構造体のリスト（一致したバイト数の昇順）
+  /// @arg bSurfaceOnly true の時、読みしか一致しない地名語は含めない。
+  void MAImpl::getActiveResultsWithDarts(const std::string& key, std::vector<ResultPair>& results, bool bSurfaceOnly) const
+  {
 #ifdef HAVE_LIBDAMS
-    std::string key_standardized(damswrapper::get_standardized_string(key));
+    this->getActiveResultsWithStandardizedKey(this->standardize(key), results, bSurfaceOnly);
 #else  /* HAVE_LIBDAMS */
-    std::string key_standardized = key;
+    this->getActiveResultsWithStandardizedKey(key, results, bSurfaceOnly);
 #endif /* HAVE_LIBDAMS */
+  }
+
+  /// @brief 標準化済みの文字列に darts で前方一致し、アクティブな地名語を含む wordlist を全て探す。
+  /// @arg @c key_standardized [in] standardize() で標準化した検索対象文字列
+  /// @arg results [out] 一致した lpair 構造体のリスト（一致したバイト数の昇順）
+  /// @arg bSurfaceOnly true の時、読みしか一致しない地名語は含めない。
+  void MAImpl::getActiveResultsWithStandardizedKey(const std::string& key_standardized, std::vector<ResultPair>& results, bool bSurfaceOnly) const
+  {
+    Darts::DoubleArray::result_pair_type result_pair[1024];
+    geonlp::Wordlist wordlist;
+    std::vector<geonlp::Geoword> geowords;
+    std::vector<size_t> entry_indexes;
+
+    results.clear();
 
     if (this->dap == NULL) {
       throw IndexNotExistsException();
     }
-    size_t num = dap->commonPrefixSearch(key_standardized.c_str(), result_pair, sizeof(result_pair));
+    const size_t max_results = sizeof(result_pair) / sizeof(result_pair[0]);
+    size_t num = 0;
+    {
+      StatsTimer timer(this->statsp.get(), STATS_DARTS);
+      num = dap->commonPrefixSearch(key_standardized.c_str(), result_pair, max_results);
+      if (num > max_results) num = max_results;
+      if (this->delta_dap && num < max_results) {
+        // 差分インデックスの見出し語は本体に含まれないので、一致したバイト数の順に併合する
+        size_t num_delta = delta_dap->commonPrefixSearch(key_standardized.c_str(), result_pair + num, max_results - num);
+        if (num_delta > max_results - num) num_delta = max_results - num;
+        std::inplace_merge(result_pair, result_pair + num, result_pair + num + num_delta, _isShorterResult);
+        num += num_delta;
+      }
+      timer.setRows(num);
+    }
 
+    const ActiveFilter& filter = this->filter();
+    const bool use_states = this->isFilterCurrent();
     for (size_t i = 0; i < num; ++i) {
-      if (result_pair[i].length > lpair.length) {
-        std::string surface = key_standardized.substr(0, result_pair[i].length); // 一致した文字列
-        // wordlist を取得し、 idlist を展開する
-        if (dbap->findWordlistById(result_pair[i].value, wordlist)) {
-          this->dbap->getGeowordListFromWordlist(wordlist, geowords, 0);
-          // アクティブな辞書／クラスに含まれる地名語が一つでも存在するかチェック
-          for (std::vector<Geoword>::iterator it = geowords.begin(); it != geowords.end(); it++) {
-            if (bSurfaceOnly && !this->isSurfaceMatched(*it, surface)) continue;
-            if (this->isInActiveDictionaryAndClass(*it)) {
-              lpair = result_pair[i]; // アクティブな地名語を含む
-              break;
-            }
-          }
-        }
+      // 判定済みの見出し語は記録を利用する
+      int state = use_states ? filter.getWordlistState(result_pair[i].value, bSurfaceOnly) : -1;
+      if (state == 0) continue;
+      if (state > 0) {
+        results.push_back(result_pair[i]); // アクティブな地名語を含む
+        continue;
+      }
+
+      std::string surface = key_standardized.substr(0, result_pair[i].length); // 一致した文字列
+      bool has_active = false;
+      bool has_surface_active = false;
+      if (this->db()->findWordlistById(result_pair[i].value, wordlist)) {
+        this->checkActiveWordlist(wordlist, surface, geowords, entry_indexes, has_active, has_surface_active);
+      }
+      if (use_states) filter.setWordlistState(result_pair[i].value, has_active, has_surface_active);
+      if (bSurfaceOnly ? has_surface_active : has_active) {
+        results.push_back(result_pair[i]); // アクティブな地名語を含む
+      }
+    }
+  }
+
+  /// @brief 見出し語がアクティブな地名語を含むかどうか判定する。
+  ///
+  /// wordlist の idlist を展開し、表記一致を問わない場合と表記一致に限定する場合の両方を判定する。
+  /// 期間を指定した場合、期間外の地名語しか含まない見出し語は地名語を読み込まない。
+  /// @arg @c wordlist           判定する見出し語
+  /// @arg @c surface            一致した文字列（標準化済み）
+  /// @arg geowords              地名語の読み込みに利用する作業領域
+  /// @arg entry_indexes         地名語IDリストの位置の読み込みに利用する作業領域
+  /// @arg has_active            [out] アクティブな地名語を含む場合 true
+  /// @arg has_surface_active    [out] 表記が一致するアクティブな地名語を含む場合 true
+  void MAImpl::checkActiveWordlist(const Wordlist& wordlist, const std::string& surface,
+                                   std::vector<Geoword>& geowords, std::vector<size_t>& entry_indexes,
+                                   bool& has_active, bool& has_surface_active) const
+  {
+    has_active = false;
+    has_surface_active = false;
+    const ActiveFilter& filter = this->filter();
+    if (filter.hasPeriod() && !this->hasEntryInPeriod(wordlist.get_entries(), filter)) return;
+
+    this->db()->getGeowordListFromWordlist(wordlist, geowords, 0, true, &entry_indexes);
+    const std::vector<WordlistEntry>& entries = wordlist.get_entries();
+    const unsigned long long surface_hash = this->getSurfaceHash(entries, surface);
+    // アクティブな辞書／クラスに含まれる地名語が一つでも存在するかチェック
+    for (size_t j = 0; j < geowords.size(); j++) {
+      if (!this->isInActiveDictionaryAndClass(geowords[j])) continue;
+      has_active = true;
+      const WordlistEntry* e = (j < entry_indexes.size()) ? &entries[entry_indexes[j]] : NULL;
+      if (this->isSurfaceMatched(geowords[j], e, surface, surface_hash)) {
+        has_surface_active = true;
+        return;
+      }
+    }
+  }
+
+  /// @brief 地名語IDリストに、アクティブな辞書に含まれ有効期間が期間と重なる地名語があり得るかどうか
+  ///
+  /// 有効期間を記録していない要素がある場合は、地名語を読み込んで判定する必要があるため true を返す。
+  /// @arg @c entries 地名語IDリスト
+  /// @arg @c filter  判定に利用する ActiveFilter
+  /// @return 候補となり得る地名語がある場合 true
+  bool MAImpl::hasEntryInPeriod(const std::vector<WordlistEntry>& entries, const ActiveFilter& filter) const
+  {
+    if (entries.empty()) return true;
+    for (std::vector<WordlistEntry>::const_iterator it = entries.begin(); it != entries.end(); it++) {
+      if (!(*it).has_period) return true;
+      if (filter.isActiveDictionary((*it).dictionary_id) && filter.isInPeriod((*it).valid_from, (*it).valid_to)) return true;
+    }
+    return false;
+  }
+
+  /// @brief 地名語候補区間の表層形と Darts 検索結果を準備する。
+  /// @arg @c s    [in] 地名語候補を構成する素性シーケンスの先頭
+  /// @arg @c e    [in] 地名語候補を構成する素性シーケンスの末尾
+  /// @arg @c span [out] 区間の表層形、素性境界の位置、前方一致する候補
+  void MAImpl::initCandidateSpan(NodeExtList::iterator s, NodeExtList::iterator e, CandidateSpan& span) const
+  {
+    span.key = "";
+    span.lengths.clear();
+#ifdef HAVE_LIBDAMS
+    // 素性ごとの標準化文字列は素性に記録し、同じ素性を含む他の区間でも再利用する
+    span.standardized_key = "";
+    span.standardized_lengths.clear();
+#endif /* HAVE_LIBDAMS */
+    for ( ; ; s++){
+      span.key += s->get_surface();
+      span.lengths.push_back(span.key.length());
+#ifdef HAVE_LIBDAMS
+      if (!s->hasStandardizedSurface()) s->set_standardized_surface(this->standardize(s->get_surface()));
+      span.standardized_key += s->get_standardized_surface();
+      span.standardized_lengths.push_back(span.standardized_key.length());
+#endif /* HAVE_LIBDAMS */
+      if ( s== e) break;
+    }
+#ifdef HAVE_LIBDAMS
+    // 標準化は文脈によって結果が変わる場合があるため、複数の素性からなる区間では
+    // 連結した文字列を区間全体の標準化結果と照合する。
+    // 一致しない場合は素性境界ごとに個別に標準化する。
+    // 素性が一つの場合は素性の標準化文字列が区間全体の標準化結果なので照合しない
+    const std::string whole = span.lengths.size() > 1 ? this->standardize(span.key) : span.standardized_key;
+    span.composable = (whole == span.standardized_key);
+    if (!span.composable) {
+      span.standardized_key = whole;
+      span.standardized_lengths.assign(span.lengths.size(), -1);
+      span.standardized_lengths.back() = whole.length();
+    }
+    this->getActiveResultsWithStandardizedKey(span.standardized_key, span.results);
+    span.longest_results.resize(span.lengths.size());
+    span.has_longest_results.assign(span.lengths.size(), false);
+#else
+    this->getActiveResultsWithDarts(span.key, span.results);
+#endif /* HAVE_LIBDAMS */
+  }
+
+  /// @brief 地名語候補区間の先頭から k 番目の素性までを標準化した表層形の長さを得る。
+  /// @arg @c span [in] 区間
+  /// @arg @c k    [in] 末尾の素性の位置
+  /// @return 標準化した表層形のバイト数
+  size_t MAImpl::getStandardizedLength(CandidateSpan& span, int k) const
+  {
+#ifdef HAVE_LIBDAMS
+    if (span.standardized_lengths[k] < 0) {
+      span.standardized_lengths[k] = this->standardize(span.key.substr(0, span.lengths[k])).length();
+    }
+    return size_t(span.standardized_lengths[k]);
+#else
+    return span.lengths[k];
+#endif /* HAVE_LIBDAMS */
+  }
+
+  /// @brief 地名語候補区間の先頭から k 番目の素性までの表層形に DARTS で最長一致する候補を得る。
+  ///
+  /// getLongestResultWithDarts(表層形) と同じ結果を返す。
+  /// 標準化しない場合、または素性ごとの標準化文字列を連結したものが区間全体の
+  /// 標準化結果に一致する場合は、区間全体の前方一致結果から長さが表層形以下の最長のものを選ぶ。
+  /// @arg @c span [in] 区間
+  /// @arg @c k    [in] 末尾の素性の位置
+  /// @return 最長一致する lpair 構造体
+  MAImpl::ResultPair MAImpl::getLongestResultInSpan(CandidateSpan& span, int k) const
+  {
+    ResultPair lpair;
+    lpair.value = 0; lpair.length = 0;
+#ifdef HAVE_LIBDAMS
+    if (!span.composable) {
+      // 標準化した表層形は区間全体の標準化文字列の前方部分とは限らないため、個別に検索して記録する
+      if (k == int(span.lengths.size()) - 1) {
+        if (span.results.size() > 0) lpair = span.results.back();
+        return lpair;
+      }
+      if (!span.has_longest_results[k]) {
+        span.longest_results[k] = this->getLongestResultWithDarts(span.key.substr(0, span.lengths[k]));
+        span.has_longest_results[k] = true;
+      }
+      return span.longest_results[k];
+    }
+    size_t length = size_t(span.standardized_lengths[k]);
+#else
+    size_t length = span.lengths[k];
+#endif /* HAVE_LIBDAMS */
+    for (std::vector<ResultPair>::const_reverse_iterator it = span.results.rbegin(); it != span.results.rend(); it++) {
+      if (size_t((*it).length) <= length) {
+        lpair = (*it);
+        break;
       }
     }
     return lpair;
   }
 
+  /// @brief 表記を標準化した文字列を得る。
+  ///
+  /// 結果は STANDARDIZED_CACHE_SIZE 件まで LRU で記憶し、同じ表記の検索では標準化を省略する。
+  /// 標準化しない場合は表記をそのまま返す。
+  /// @arg @c surface 表記
+  /// @return 標準化した文字列
+  std::string MAImpl::standardize(const std::string& surface) const
+  {
+#ifdef HAVE_LIBDAMS
+    std::string standardized;
+    if (this->standardizedCache.get(surface, standardized)) return standardized;
+    standardized = damswrapper::get_standardized_string(surface);
+    this->standardizedCache.put(surface, standardized);
+    return standardized;
+#else
+    return surface;
+#endif /* HAVE_LIBDAMS */
+  }
+
   // アクティブな辞書/クラスに含まれているかチェックする
   // @arg @c geo  地名語
   // @return      アクティブな辞書、クラスに含まれていれば true を
   //              含まれていなければ false を返す
   bool MAImpl::isInActiveDictionaryAndClass(const Geoword& geo) const {
-    // 辞書チェック
-    bool is_in = false;
-    for (std::map<int, Dictionary>::const_iterator it = this->activeDictionaries.begin(); it != this->activeDictionaries.end(); it++) {
-      if ((*it).first == geo.get_dictionary_id()) {
-        is_in = true;
-        break;
-      }
-    }
-    if (!is_in) return false;
+    return this->filter().isActive(geo);
+  }
 
-    // クラスのチェック
-    is_in = false;
-    if (this->activeClasses.size() > 0) {
-      std::string ne_class = geo.get_ne_class();
-      boost::regex pattern;
-      for (std::vector<std::string>::const_iterator it = this->activeClasses.begin(); it != this->activeClasses.end(); it++) {
-        if ((*it).c_str()[0] == '-') { // 除外パターン指定
-          pattern = boost::regex((*it).substr(1), boost::regex_constants::egrep);
-          if (boost::regex_match(ne_class, pattern)) {
-            is_in = false; // 除外パターンに一致してもさらに調べる
-            // return false; // 除外パターンに一致したら常に不一致とする
-          }
-        } else if (!is_in) { // まだ一致するパターンが見つかっていない場合は探す
-          pattern = boost::regex((*it), boost::regex_constants::egrep);
-          if (boost::regex_match(geo.get_ne_class(), pattern)) {
-            is_in = true;
-          }
-        }
-      }
-      if (!is_in) return false;
-    }
-    return true;
+  /// @brief 現在のスレッドで判定に利用する ActiveFilter を得る
+  /// @return ActiveView を指定した解析・検索の実行中はその判定用データ、
+  ///         それ以外は共有のアクティブな辞書/クラスの判定用データ
+  const ActiveFilter& MAImpl::filter(void) const {
+    if (view_binding.owner == this) return view_binding.view->getFilter();
+    return this->activeFilter;
+  }
+
+  /// @brief filter() の見出し語IDごとの判定結果が現在の DB に対応しているか
+  /// @return 共有の判定用データ、または DB の更新後に作成した ActiveView の場合 true
+  bool MAImpl::isFilterCurrent(void) const {
+    if (view_binding.owner != this) return true;
+    return view_binding.view->getSerial() == this->readerSerial.load();
   }
 
   // 表記で一致しているかチェックする
-  bool MAImpl::isSurfaceMatched(const Geoword& geo, const std::string& surface) const {
-    std::string prefix_str, suffix_str;
-    if (geo.get_parts_for_surface(surface, prefix_str, suffix_str)) {
-      // 表記が一致した
-      return true;
+  // @arg @c geo          地名語
+  // @arg @c entry        地名語に対応する地名語IDリストの要素、対応が不明な場合は NULL
+  // @arg @c surface      検索表記
+  // @arg @c surface_hash 検索表記を標準化した文字列の Wordlist::hashSurface による値
+  // @return              地名語の表記のいずれかが検索表記と一致すれば true
+  bool MAImpl::isSurfaceMatched(const Geoword& geo, const WordlistEntry* entry, const std::string& surface, unsigned long long surface_hash) const {
+    // 見出し語の作成時に記録した表記のハッシュ値があれば、表記を組み立てずに判定する
+    if (entry && entry->hasSurfaceHashes()) return entry->hasSurfaceHash(surface_hash);
+    // 接頭辞、接尾辞を取り出さずに判定する
+    return geo.has_surface(surface);
+  }
+
+  // 検索表記を標準化した文字列のハッシュ値を得る
+  // @arg @c entries 地名語IDリスト
+  // @arg @c surface 検索表記
+  // @return         ハッシュ値、表記のハッシュ値を持つ要素が無い場合は標準化せずに 0 を返す
+  unsigned long long MAImpl::getSurfaceHash(const std::vector<WordlistEntry>& entries, const std::string& surface) const {
+    for (std::vector<WordlistEntry>::const_iterator it = entries.begin(); it != entries.end(); it++) {
+      if ((*it).hasSurfaceHashes()) return Wordlist::hashSurface(this->standardize(surface));
+    }
+    return 0;
+  }
+
+  /// @brief 地名語Nodeの候補の地名語IDを得る。
+  ///
+  /// 地名語候補を設定したノードは候補から得て、品詞細分類３の文字列を作成しない。
+  /// それ以外は品詞細分類３の "ID:代表表記/ID:代表表記" を分解する。
+  /// @arg @c node 地名語Node
+  /// @arg ret 地名語IDの配列
+  void MAImpl::getGeowordIds(const Node& node, std::vector<std::string>& ret)
+  {
+    if (!node.has_geowordCandidates()) {
+      Wordlist::parseIdlist(node.get_subclassification3(), ret);
+      return;
+    }
+    const std::vector<GeowordCandidate>& candidates = node.get_geowordCandidates();
+    ret.clear();
+    ret.reserve(candidates.size());
+    for (std::vector<GeowordCandidate>::const_iterator it = candidates.begin(); it != candidates.end(); it++) {
+      ret.push_back((*it).geonlp_id);
     }
-    return false;
   }
 
   /// @brief Node が地名語の場合、地名語のリストを得る
@@ -950,50 +2337,316 @@ namespace geonlp
     ret.clear();
     if (node.get_subclassification2() != "地名語") return 0;
 
-    std::string subclass3 = node.get_subclassification3();
-
-    boost::regex pattern = boost::regex("([^\\/:]+):([^\\/:]*)", boost::regex_constants::egrep);
-    for (boost::sregex_iterator it = boost::make_regex_iterator(subclass3, pattern); it != boost::sregex_iterator(); it++) {
-      std::string geonlp_id = (*it)[1]; // geonlp_id
-      // std::string typical_name = (*it)[2]; // typical name
-      // std::cerr << "geonlp_id:'" << geonlp_id << "', name:'" << typical_name << "'" << std::endl;
+    ReadLock lock(this->stateMutex);
+    std::vector<std::string> geonlp_ids;
+    getGeowordIds(node, geonlp_ids);
+    for (std::vector<std::string>::iterator it = geonlp_ids.begin(); it != geonlp_ids.end(); it++) {
       Geoword geoword;
-      if (this->getGeowordEntry(geonlp_id, geoword))
-        ret.insert(std::make_pair(geonlp_id, geoword));
+      if (this->db()->findGeowordById(*it, geoword))
+        ret.insert(std::make_pair(*it, geoword));
     }
     return ret.size();
   }
 
+  /// @brief 辞書バンドルまたは参照専用の DB を参照している場合は例外を投げる
+  /// @exception std::runtime_error 辞書バンドル、参照専用の DB は更新できない
+  void MAImpl::assertWritable(void) const {
+    if (this->bundlep) {
+      throw std::runtime_error(std::string("The dictionary bundle '") + this->bundlep->getFilename() + "' is read-only.");
+    }
+    if (this->profilep->get_read_only()) {
+      throw std::runtime_error(std::string("The database in '") + this->profilep->get_data_dir() + "' is opened read-only.");
+    }
+  }
+
   void MAImpl::clearDatabase(void) {
+    this->assertWritable();
+    std::lock_guard<std::mutex> update_lock(this->updateMutex);
+    WriteLock lock(this->stateMutex);
+    this->readerSerial++;
+    if (this->parseCachep) this->parseCachep->clear();
     this->dbap->clearGeowords();
     this->dbap->clearDictionaries();
+    // 辞書の内部 ID は再利用されるため、インデックスは差分更新できなくなる
+    this->dbap->clearWordlists();
   }
 
   int MAImpl::addDictionary(const std::string& jsonfile, const std::string& csvfile) const {
+    this->assertWritable();
+    std::lock_guard<std::mutex> update_lock(this->updateMutex);
+    WriteLock lock(this->stateMutex);
+    this->readerSerial++;
+    if (this->parseCachep) this->parseCachep->clear();
     return this->dbap->addDictionary(jsonfile, csvfile);
   }
 
   bool MAImpl::removeDictionary(const std::string& identifier) {
+    this->assertWritable();
+    std::lock_guard<std::mutex> update_lock(this->updateMutex);
+    WriteLock lock(this->stateMutex);
+    this->readerSerial++;
+    if (this->parseCachep) this->parseCachep->clear();
     int dic_id = this->dbap->getDictionaryInternalId(identifier);
+    // インデックスからも取り除く（差分更新に対応しないインデックスでは updateIndex() が必要）
+    if (dic_id >= 0) this->dbap->removeDictionaryFromWordlists(dic_id);
     this->dbap->removeDictionary(identifier);
     this->activeDictionaries.erase(dic_id);
+    this->activeFilter.setDictionaries(this->activeDictionaries);
     return true;
   }
 
   void MAImpl::updateIndex(void) {
-    this->dbap->updateWordlists();
-    // Darts ファイルが変更されている可能性があるので初期化が必要
-    std::string darts;
+    this->updateIndex(IndexProgressCallback());
+  }
+
+  /// @brief 地名語辞書をコンパイルしてインデックスを更新する（進捗を通知する）
+  ///
+  /// プロファイルの index_build_threads, index_build_memory を指定すると、
+  /// 地名語を並列に解析し、一時ファイルで併合しながら構築する。
+  /// 構築中も現在のインデックスで解析を続けられる。
+  /// @arg @c progress 段階名と処理済み件数、全体の件数を受け取る関数
+  void MAImpl::updateIndex(const IndexProgressCallback& progress) {
+    this->assertWritable();
+    std::lock_guard<std::mutex> update_lock(this->updateMutex);
+    this->rebuildIndex(progress);
+  }
+
+  /// @brief 次の世代のインデックスを構築して現在のインデックスと置き換える。
+  ///
+  /// wordlist と darts は DBAccessor::openIndexBuilder() が開いた別のファイルに
+  /// stateMutex を取得せずに構築するため、その間も解析は現在の世代で続けられる。
+  /// 置き換えは書き込みロックの下でファイルの rename と開き直しだけを行うので、
+  /// 解析中の呼び出しは終わるまで旧世代を参照し、以降の呼び出しは新しい世代を参照する。
+  /// 構築に失敗した場合は現在のインデックスをそのまま使い続ける。
+  /// 置き換えに失敗した場合も publishIndex() がファイルを元に戻すため、同様に使い続けられる。
+  /// updateMutex を取得してから呼び出すこと。
+  /// @arg @c progress 段階名と処理済み件数、全体の件数を受け取る関数
+  void MAImpl::rebuildIndex(const IndexProgressCallback& progress) {
+    DBAccessorPtr builder = this->dbap->openIndexBuilder();
+    try {
+      builder->updateWordlists(progress);
+    } catch (...) {
+      builder->close();
+      throw;
+    }
+
+    WriteLock lock(this->stateMutex);
+    this->readerSerial++;
+    if (this->parseCachep) this->parseCachep->clear();
+    this->dbap->publishIndex(*builder);
+    // Darts ファイルが置き換わったので開き直す
     if (this->dap) this->dap.reset();
     try {
-      darts = this->profilep->get_darts_file();
-      if (darts.length() > 0) {
-        this->dap = DoubleArrayPtr(new Darts::DoubleArray());
-        this->dap->open(darts.c_str());
-      }
+      this->openIndex();
     } catch (std::runtime_error& e) {
       throw ServiceCreateFailedException(e.what(), ServiceCreateFailedException::DARTS);
     }
   }
 
+  /// @brief インデックスに登録されていない辞書だけをインデックスに追加する。
+  ///
+  /// 追加する辞書の地名語数に比例する時間で更新できる。
+  /// 新しい見出し語は差分 darts ファイルに登録され、 updateIndex() で本体に統合される。
+  /// インデックスが差分更新に対応しない場合は updateIndex() と同じく全体を再構築する。
+  /// 追加する辞書の一覧は、追加と同じ書き込みロックの下で求める。
+  void MAImpl::updateIndexIncrementally(void) {
+    this->assertWritable();
+    std::lock_guard<std::mutex> update_lock(this->updateMutex);
+    {
+      WriteLock lock(this->stateMutex);
+      std::vector<int> dictionary_ids;
+      if (this->dbap->getUnindexedDictionaries(dictionary_ids)) {
+        if (dictionary_ids.size() == 0) return;
+        this->readerSerial++;
+        if (this->parseCachep) this->parseCachep->clear();
+        for (std::vector<int>::iterator it = dictionary_ids.begin(); it != dictionary_ids.end(); it++) {
+          this->dbap->addDictionaryToWordlists(*it);
+        }
+        try {
+          this->openIndex();
+        } catch (std::runtime_error& e) {
+          throw ServiceCreateFailedException(e.what(), ServiceCreateFailedException::DARTS);
+        }
+        return;
+      }
+    }
+    this->rebuildIndex(IndexProgressCallback());
+  }
+
+  /// @brief 辞書、地名語、インデックスを参照専用の辞書バンドルファイルに書き出す。
+  ///
+  /// 書き出したファイルは rename で置き換えるため、
+  /// 他プロセスが参照している旧ファイルの内容は影響を受けない。
+  /// @arg @c filename 書き出すファイル名
+  /// @exception std::runtime_error 辞書バンドルを参照している
+  /// @exception BundleException 書き込みに失敗
+  void MAImpl::exportBundle(const std::string& filename) const {
+    this->assertWritable();
+    std::lock_guard<std::mutex> update_lock(this->updateMutex);
+    WriteLock lock(this->stateMutex);
+    this->dbap->exportBundle(filename);
+  }
+
+  /// @brief 処理ごとの計測値を取得する
+  /// @arg ret 処理の名前をキーとする計測値
+  /// @return 計測値の数、プロファイルの stats が false の場合は 0
+  int MAImpl::getStats(std::map<std::string, StatsEntry>& ret) const {
+    ret.clear();
+    if (!this->statsp) return 0;
+    this->statsp->getAll(ret);
+    return ret.size();
+  }
+
+  /// @brief 処理ごとの計測値を 0 に戻す
+  void MAImpl::resetStats(void) {
+    if (this->statsp) this->statsp->reset();
+  }
+
+  /// @brief 全ての見出し語について、アクティブな地名語を含むかどうかを判定して記録する。
+  ///
+  /// 解析中に見出し語ごとに行う判定を事前に済ませ、 ActiveFilter の判定結果と地名語キャッシュを埋める。
+  /// 判定結果はアクティブな辞書／クラス・期間を変更すると未判定に戻る。
+  /// fork する前に呼び出すと、作業プロセスは判定結果とキャッシュを共有できる。
+  /// @return 判定した見出し語の数
+  int MAImpl::warmup(void) const {
+    ReadLock lock(this->stateMutex);
+    const ActiveFilter& filter = this->filter();
+    if (!this->isFilterCurrent()) return 0;
+
+    Wordlist wordlist;
+    std::vector<Geoword> geowords;
+    std::vector<size_t> entry_indexes;
+    int num = 0;
+    const size_t num_wordlists = filter.getWordlistCount();
+    for (size_t id = 0; id < num_wordlists; id++) {
+      if (filter.getWordlistState(id, true) >= 0) continue;  // 判定済み
+      if (!this->db()->findWordlistById(id, wordlist)) continue;
+      bool has_active, has_surface_active;
+      // darts の見出し語は標準化済みの表記なので、見出し語全体と一致した場合の判定になる
+      this->checkActiveWordlist(wordlist, wordlist.get_key(), geowords, entry_indexes, has_active, has_surface_active);
+      filter.setWordlistState(id, has_active, has_surface_active);
+      num++;
+    }
+    return num;
+  }
+
+  /// @brief darts の配列のバイト数、 darts が無い場合は 0
+  static size_t _dartsSize(const DoubleArrayPtr& dap)
+  {
+    return dap ? dap->total_size() : 0;
+  }
+
+  /// @brief 辞書やインデックス、キャッシュが確保しているメモリのバイト数を得る。
+  ///
+  /// 項目は次の通り。
+  /// - darts, yomi_darts: 見出し語と読みの darts （差分を含む）、mmap した場合はマップしたバイト数
+  /// - completion_table, spatial_index: 補完候補表と空間インデックスの推定バイト数
+  /// - geoword_cache, geoword_record_cache: DBAccessor の地名語キャッシュの推定バイト数
+  /// - geoword_node_cache, standardized_cache: 見出し語ごとの候補と標準化した表記のキャッシュの推定バイト数
+  /// - parse_cache: 文ごとの解析結果のキャッシュの推定バイト数
+  /// - sqlite: SQLite がプロセス全体で確保しているバイト数
+  /// - sqlite_cache_limit, sqlite_mmap_limit: 地名語 DB の接続に設定されたページキャッシュと mmap の上限
+  /// - in_memory_db: in_memory の場合に読み込んだデータベースファイルのバイト数
+  /// - mecab: MeCab の辞書ファイルのバイト数
+  /// - bundle: 辞書バンドルのバイト数（darts を含む）
+  /// - memory_budget, memory_budget_charged: キャッシュのメモリ予算と、この MA のキャッシュが計上したバイト数
+  ///   （sqlite は計上しない）
+  /// @arg ret [out] 項目の名前をキーとするバイト数
+  /// @return 項目の数
+  int MAImpl::getMemoryUsage(std::map<std::string, size_t>& ret) const {
+    ReadLock lock(this->stateMutex);
+    ret.clear();
+    ret["darts"] = _dartsSize(this->dap) + _dartsSize(this->delta_dap);
+    ret["yomi_darts"] = _dartsSize(this->yomi_dap) + _dartsSize(this->yomi_delta_dap);
+    ret["completion_table"] = this->completion_table ? this->completion_table->estimateMemorySize() : 0;
+    ret["spatial_index"] = (this->spatial_index ? this->spatial_index->estimateMemorySize() : 0)
+      + (this->spatial_delta ? this->spatial_delta->estimateMemorySize() : 0);
+    ret["geoword_cache"] = this->dbap ? this->dbap->getGeowordCacheStats().bytes : 0;
+    ret["geoword_record_cache"] = this->dbap ? this->dbap->getGeowordRecordCacheStats().bytes : 0;
+    ret["geoword_node_cache"] = this->geowordNodeCache.getStats().bytes;
+    ret["standardized_cache"] = this->standardizedCache.getStats().bytes;
+    ret["parse_cache"] = this->parseCachep ? this->parseCachep->getStats().bytes : 0;
+    ret["sqlite"] = DBAccessor::getSqliteMemoryUsed();
+    size_t sqlite_cache_limit = 0, sqlite_mmap_limit = 0;
+    if (this->dbap) this->dbap->getSqliteLimits(sqlite_cache_limit, sqlite_mmap_limit);
+    ret["sqlite_cache_limit"] = sqlite_cache_limit;
+    ret["sqlite_mmap_limit"] = sqlite_mmap_limit;
+    ret["in_memory_db"] = this->dbap ? this->dbap->getInMemoryImageSize() : 0;
+    ret["mecab"] = this->mecabp->getDictionarySize();
+    ret["bundle"] = this->bundlep ? this->bundlep->getMappedSize() : 0;
+    ret["memory_budget"] = this->budgetp->getLimit();
+    ret["memory_budget_charged"] = this->budgetp->getCharged();
+    return ret.size();
+  }
+
+  /// @brief 空間インデックスを読み込み、差分更新で追加された辞書の地点を集める。
+  ///
+  /// 差分更新で追加・削除された辞書の地点は空間インデックスから除外し、
+  /// 現在もインデックスに含まれる辞書の地点を地名語テーブルから読み込んで差分の地点とする。
+  /// 空間インデックスが無い古いインデックスの場合は空間検索を利用できない。
+  /// @exception DartsException ファイルの読み込みに失敗した
+  void MAImpl::openSpatialIndex(void) {
+    boost::shared_ptr<SpatialIndex> spatial(new SpatialIndex());
+    if (!spatial->load(this->dbap->getSpatialIndexFilename())) {
+      this->spatial_index.reset();
+      this->spatial_delta.reset();
+      return;
+    }
+    std::set<int> stale_dictionaries, indexed_dictionaries;
+    this->dbap->getSpatialStaleDictionaries(stale_dictionaries, indexed_dictionaries);
+    spatial->setStaleDictionaries(stale_dictionaries);
+    this->spatial_index = spatial;
+
+    boost::shared_ptr<SpatialIndex> delta(new SpatialIndex());
+    for (std::set<int>::const_iterator it = indexed_dictionaries.begin(); it != indexed_dictionaries.end(); it++) {
+      this->dbap->addSpatialPoints(*it, *delta);
+    }
+    if (delta->size() > 0) {
+      delta->build();
+      this->spatial_delta = delta;
+    } else {
+      this->spatial_delta.reset();
+    }
+  }
+
+  /// @brief 本体と差分の darts ファイルを開き、見出し語IDごとの判定状態を初期化する。
+  ///
+  /// darts ファイルは rename で置き換えられるため、
+  /// 他プロセスが mmap している旧ファイルの内容は影響を受けない。
+  /// 辞書バンドルを参照している場合はバンドル内の darts を利用する。
+  /// 辞書バンドルは読みの darts と補完候補表、空間インデックスを持たないので、読みの検索には本体の darts を利用し、
+  /// 補完の候補は地名語を読み込んで判定する。空間検索は利用できない。
+  /// @exception DartsException ファイルの読み込みに失敗した
+  void MAImpl::openIndex(void) {
+    if (this->bundlep) {
+      // darts はバンドルの mmap 領域を指すため、バンドルと寿命を共有する
+      Darts::DoubleArray* da = this->bundlep->getDoubleArray();
+      this->dap = da ? DoubleArrayPtr(this->bundlep, da) : DoubleArrayPtr();
+      this->delta_dap.reset();
+      this->yomi_dap.reset();
+      this->yomi_delta_dap.reset();
+      this->completion_table.reset();
+      this->spatial_index.reset();
+      this->spatial_delta.reset();
+      this->activeFilter.setWordlistCount(this->bundlep->getMaxWordlistId() + 1);
+      return;
+    }
+    bool use_mmap = this->profilep->get_darts_mmap();
+    this->dap = openDartsFile(this->profilep->get_darts_file(), use_mmap);
+    this->delta_dap = openDartsFile(this->dbap->getDeltaDartsFilename(), use_mmap);
+    this->yomi_dap = openDartsFile(this->dbap->getYomiDartsFilename(), use_mmap);
+    this->yomi_delta_dap = openDartsFile(this->dbap->getYomiDeltaDartsFilename(), use_mmap);
+    boost::shared_ptr<CompletionTable> table(new CompletionTable());
+    if (table->load(this->dbap->getCompletionFilename())) {
+      std::set<unsigned int> stale_ids;
+      this->dbap->getCompletionStaleIds(stale_ids);
+      table->setStaleIds(stale_ids);
+      this->completion_table = table;
+    } else {
+      this->completion_table.reset();
+    }
+    this->openSpatialIndex();
+    this->activeFilter.setWordlistCount(this->dbap->getMaxWordlistId() + 1);
+  }
+
 }
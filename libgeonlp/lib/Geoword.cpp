@@ -12,6 +12,70 @@
 #include <dams.h>
 #endif /* HAVE_LIBDAMS */
 
+/// バイナリレコードの形式バージョン
+#define GEOWORD_RECORD_FORMAT  1
+
+namespace
+{
+  /// バイナリレコードに含める項目の型
+  enum RecordFieldType { RECORD_STRING, RECORD_STRING_LIST, RECORD_INT };
+
+  /// バイナリレコードに含める項目、この順に並べる
+  const struct {
+    const char* key;
+    RecordFieldType type;
+  } record_fields[] = {
+    { "geonlp_id", RECORD_STRING },
+    { "dictionary_id", RECORD_INT },
+    { "body", RECORD_STRING },
+    { "prefix", RECORD_STRING_LIST },
+    { "suffix", RECORD_STRING_LIST },
+    { "body_kana", RECORD_STRING },
+    { "prefix_kana", RECORD_STRING_LIST },
+    { "suffix_kana", RECORD_STRING_LIST },
+    { "ne_class", RECORD_STRING },
+    { "priority_score", RECORD_INT },
+    { "latitude", RECORD_STRING },
+    { "longitude", RECORD_STRING },
+    { "valid_from", RECORD_STRING },
+    { "valid_to", RECORD_STRING },
+  };
+  const int num_record_fields = sizeof(record_fields) / sizeof(record_fields[0]);
+
+  // リトルエンディアンで整数を追加する
+  void append_le(std::string& out, unsigned long long v, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+      out.push_back(char((v >> (8 * i)) & 0xff));
+    }
+  }
+
+  // リトルエンディアンで整数を読み込む
+  unsigned long long read_le(const unsigned char* p, int bytes) {
+    unsigned long long v = 0;
+    for (int i = 0; i < bytes; i++) {
+      v |= ((unsigned long long)p[i]) << (8 * i);
+    }
+    return v;
+  }
+
+  // 長さ (4バイト) に続けて文字列を追加する
+  void append_string(std::string& out, const std::string& v) {
+    append_le(out, v.length(), 4);
+    out.append(v);
+  }
+
+  // 長さ (4バイト) に続く文字列を読み込む、範囲外の場合は false
+  bool read_string(const unsigned char*& p, const unsigned char* end, std::string& v) {
+    if (end - p < 4) return false;
+    size_t len = (size_t)read_le(p, 4);
+    p += 4;
+    if (size_t(end - p) < len) return false;
+    v.assign(reinterpret_cast<const char*>(p), len);
+    p += len;
+    return true;
+  }
+}
+
 namespace geonlp
 {
   boost::regex Geoword::_sep = boost::regex("/");
@@ -26,6 +90,15 @@ namespace geonlp
     return geonlp_id;
   }
 
+  /// geonlp_id を複製せずに参照する
+  std::string_view Geoword::get_geonlp_id_view() const {
+    std::string_view geonlp_id = this->_get_string_view("geonlp_id");
+    if (geonlp_id.length() == 0) {
+      geonlp_id = this->_get_string_view("geolod_id");
+    }
+    return geonlp_id;
+  }
+
   /// JSON からオブジェクトを復元する
   Geoword Geoword::fromJson(const std::string& json_str) {
     Geoword in;
@@ -33,6 +106,130 @@ namespace geonlp
     return in;
   }
 
+  /// @brief 形態素解析で参照する主要項目だけをバイナリレコードに変換する
+  ///
+  /// 形式は先頭 1 バイトのバージョン番号、 2 バイトの項目の有無を表すビット列に続いて、
+  /// record_fields の順に存在する項目の値を並べたもの。
+  /// 文字列は長さ (4バイト) と内容、文字列の配列は要素数 (4バイト) と各要素、
+  /// 整数は 4 バイトで表す。整数はすべてリトルエンディアン。
+  /// 全ての項目を得るには JSON テキストを利用すること。
+  /// @arg @c record [out] バイナリレコード
+  /// @return 変換できた場合 true, 主要項目の型が正しくない場合は false
+  bool Geoword::toRecord(std::string& record) const {
+    record.clear();
+    if (!this->_v.is<picojson::object>()) return false;
+    try {
+      std::string body;
+      unsigned int mask = 0;
+      for (int i = 0; i < num_record_fields; i++) {
+        const std::string key = record_fields[i].key;
+        if (i == 0) {
+          // geonlp_id が無い場合は geolod_id を利用する
+          std::string geonlp_id = this->get_geonlp_id();
+          if (geonlp_id.length() == 0) continue;
+          append_string(body, geonlp_id);
+        } else {
+          if (this->is_null(key)) continue;
+          switch (record_fields[i].type) {
+          case RECORD_STRING:
+            append_string(body, this->_get_string(key));
+            break;
+          case RECORD_STRING_LIST:
+            {
+              std::vector<std::string> values = this->_get_string_list(key);
+              append_le(body, values.size(), 4);
+              for (std::vector<std::string>::const_iterator it = values.begin(); it != values.end(); it++) {
+                append_string(body, *it);
+              }
+            }
+            break;
+          case RECORD_INT:
+            append_le(body, (unsigned long long)(unsigned int)this->_get_int(key), 4);
+            break;
+          }
+        }
+        mask |= (1u << i);
+      }
+      record.push_back(char(GEOWORD_RECORD_FORMAT));
+      append_le(record, mask, 2);
+      record.append(body);
+    } catch (picojson::PicojsonException&) {
+      record.clear();
+      return false;
+    }
+    return true;
+  }
+
+  /// @brief バイナリレコードから主要項目だけを持つオブジェクトを復元する
+  /// @arg @c data バイナリレコードの先頭
+  /// @arg @c size バイナリレコードのバイト数
+  /// @return 復元できた場合 true, 形式が正しくない場合は false（空のオブジェクトになる）
+  bool Geoword::initByRecord(const void* data, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    picojson::object obj;
+    std::string v;
+    if (p == NULL || size < 3 || *p != GEOWORD_RECORD_FORMAT) {
+      this->clear();
+      return false;
+    }
+    unsigned int mask = (unsigned int)read_le(p + 1, 2);
+    p += 3;
+    for (int i = 0; i < num_record_fields; i++) {
+      if ((mask & (1u << i)) == 0) continue;
+      bool ok = true;
+      switch (record_fields[i].type) {
+      case RECORD_STRING:
+        ok = read_string(p, end, v);
+        if (ok) obj.insert(std::make_pair(std::string(record_fields[i].key), picojson::value(v)));
+        break;
+      case RECORD_STRING_LIST:
+        {
+          ok = (end - p >= 4);
+          if (!ok) break;
+          size_t n = (size_t)read_le(p, 4);
+          p += 4;
+          picojson::array varray;
+          for (size_t j = 0; ok && j < n; j++) {
+            ok = read_string(p, end, v);
+            if (ok) varray.push_back(picojson::value(v));
+          }
+          if (ok) obj.insert(std::make_pair(std::string(record_fields[i].key), picojson::value(varray)));
+        }
+        break;
+      case RECORD_INT:
+        ok = (end - p >= 4);
+        if (ok) {
+          obj.insert(std::make_pair(std::string(record_fields[i].key), picojson::value((long)(int)(unsigned int)read_le(p, 4))));
+          p += 4;
+        }
+        break;
+      }
+      if (!ok) {
+        this->clear();
+        return false;
+      }
+    }
+    this->_v = picojson::value(obj);
+    return true;
+  }
+
+  /// @brief バイナリレコードまたは JSON テキストから復元する
+  ///
+  /// 先頭がバイナリレコードのバージョン番号であればバイナリレコード、
+  /// それ以外は JSON テキストとして扱う。
+  /// @arg @c data バイナリレコードまたは JSON テキストの先頭、 NULL の場合は空のオブジェクト
+  /// @arg @c size バイト数
+  void Geoword::initByRecordOrJson(const char* data, size_t size) {
+    if (data == NULL || size == 0) {
+      this->clear();
+    } else if (data[0] == char(GEOWORD_RECORD_FORMAT)) {
+      this->initByRecord(data, size);
+    } else {
+      this->initByJson(std::string(data, size));
+    }
+  }
+
   /// API 出力用の GeoJSON 表記を生成する
   picojson::ext Geoword::getGeoObject() const {
     ext geo, geometry, properties;
@@ -64,35 +261,83 @@ namespace geonlp
 
   /// 代表表記を生成する
   std::string Geoword::get_typical_name() const {
-    std::string name = "";
-    std::vector<std::string> prefix = this->get_prefix();
-    std::vector<std::string> suffix = this->get_suffix();
-    if (prefix.size() > 0) name += prefix[0];
-    name += this->get_body();
-    if (suffix.size() > 0) name += suffix[0];
+    picojson::string_list_view prefix = this->get_prefix_view();
+    picojson::string_list_view suffix = this->get_suffix_view();
+    std::string_view body = this->get_body_view();
+    std::string_view first_prefix = prefix.size() > 0 ? prefix[0] : std::string_view();
+    std::string_view first_suffix = suffix.size() > 0 ? suffix[0] : std::string_view();
+    std::string name;
+    name.reserve(first_prefix.length() + body.length() + first_suffix.length());
+    name.append(first_prefix).append(body).append(first_suffix);
     return name;
   }
 
   /// 代表カナを生成する
   std::string Geoword::get_typical_kana() const {
-    std::string name = "";
-    std::vector<std::string> prefix = this->get_prefix_kana();
-    std::vector<std::string> suffix = this->get_suffix_kana();
-    if (prefix.size() > 0) name += prefix[0];
-    name += this->get_body_kana();
-    if (suffix.size() > 0) name += suffix[0];
+    picojson::string_list_view prefix = this->get_prefix_kana_view();
+    picojson::string_list_view suffix = this->get_suffix_kana_view();
+    std::string_view body = this->get_body_kana_view();
+    std::string_view first_prefix = prefix.size() > 0 ? prefix[0] : std::string_view();
+    std::string_view first_suffix = suffix.size() > 0 ? suffix[0] : std::string_view();
+    std::string name;
+    name.reserve(first_prefix.length() + body.length() + first_suffix.length());
+    name.append(first_prefix).append(body).append(first_suffix);
     return name;
   }
 
   // 必須項目が揃っていることを確認する
   bool Geoword::isValid(const std::string& err) const {
-    if (this->get_geonlp_id().length() == 0) return false;
+    if (this->get_geonlp_id_view().length() == 0) return false;
     if (this->get_dictionary_id() == 0) return false;
-    if (this->get_body().length() == 0) return false;
-    if (this->get_ne_class().length() == 0) return false;
+    if (this->_get_string("body").length() == 0) return false;
+    if (this->get_ne_class_view().length() == 0) return false;
     return true;
   }
 
+  /// @brief 日付文字列を年 * 10000 + 月 * 100 + 日の整数に変換する
+  ///
+  /// 時間フィルタ（pygeonlp.api.temporal_filter）と同じく、
+  /// 先頭の "(\d{4})[/\-\s](\d{1,2})[/\-\s](\d{1,2})" に一致する部分を日付とする。
+  /// @arg @c datestr 日付または日時の文字列
+  /// @arg @c ymd     [out] 日付を表す整数
+  /// @return 日付として解析できた場合 true
+  bool Geoword::parseDate(std::string_view datestr, int& ymd) {
+    // 年 4 桁、月と日は 1～2 桁、区切りは '/', '-' または空白
+    const int max_digits[] = { 4, 2, 2 };
+    int parts[] = { 0, 0, 0 };
+    size_t pos = 0;
+    for (int i = 0; i < 3; i++) {
+      if (i > 0) {
+        if (pos >= datestr.length()) return false;
+        char c = datestr[pos++];
+        if (c != '/' && c != '-' && c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != '\f' && c != '\v') return false;
+      }
+      int n = 0;
+      while (pos < datestr.length() && n < max_digits[i] && datestr[pos] >= '0' && datestr[pos] <= '9') {
+        parts[i] = parts[i] * 10 + (datestr[pos++] - '0');
+        n++;
+      }
+      if (n == 0 || (i == 0 && n < 4)) return false;
+    }
+    if (parts[1] < 1 || parts[1] > 12 || parts[2] < 1 || parts[2] > 31) return false;
+    ymd = parts[0] * 10000 + parts[1] * 100 + parts[2];
+    return true;
+  }
+
+  /// @brief 有効期間を整数として取得する
+  /// @arg @c from [out] valid_from の日付、無い場合は GEOWORD_DATE_MIN
+  /// @arg @c to   [out] valid_to の日付、無い場合は GEOWORD_DATE_MAX
+  void Geoword::getValidPeriod(int& from, int& to) const {
+    from = GEOWORD_DATE_MIN;
+    to = GEOWORD_DATE_MAX;
+    try {
+      if (!Geoword::parseDate(this->_get_string_view("valid_from"), from)) from = GEOWORD_DATE_MIN;
+      if (!Geoword::parseDate(this->_get_string_view("valid_to"), to)) to = GEOWORD_DATE_MAX;
+    } catch (picojson::PicojsonException&) {
+      // 文字列以外の値は無期限とみなす
+    }
+  }
+
   // 経緯度を実数値として取得する
   /// 正常な値であれば true, 空欄または範囲外の場合は false を返す
   bool Geoword::getCoordinates(double& lat, double& lon) const {
@@ -113,33 +358,39 @@ namespace geonlp
   /// 指定した表記に一致する接頭辞、接尾辞を得る
   /// prefix_no, suffix_no には何番目の接頭辞、接尾辞を利用するかが入る
   /// 一致しない場合 false, 一致する組み合わせがあれば true を返す
+  /// 接頭辞、接尾辞、語幹は複製せずに参照する。
+  /// 標準化しない場合は連結せずに表記と比較するため、メモリを確保しない。
   bool Geoword::get_prefix_and_suffix_no(const std::string& surface, int& prefix_no, int& suffix_no) const {
-    bool is_prefix_omitted = false;
-    bool is_suffix_omitted = false;
-    std::vector<std::string> prefix = this->get_prefix();
-    std::vector<std::string> suffix = this->get_suffix();
-    std::string body = this->get_body();
-    std::string standardized = surface;
-    if (prefix.size() == 0) {
-      is_prefix_omitted = true;
-      prefix.push_back("");
-    }
-    if (suffix.size() == 0) {
-      is_suffix_omitted = true;
-      suffix.push_back("");
-    }
+    picojson::string_list_view prefix = this->get_prefix_view();
+    picojson::string_list_view suffix = this->get_suffix_view();
+    std::string_view body = this->get_body_view();
+    // 接頭辞、接尾辞が無い場合は "" が一つあるものとして扱う
+    const bool is_prefix_omitted = prefix.empty();
+    const bool is_suffix_omitted = suffix.empty();
+    const int n_prefix = is_prefix_omitted ? 1 : int(prefix.size());
+    const int n_suffix = is_suffix_omitted ? 1 : int(suffix.size());
 #ifdef HAVE_LIBDAMS
-    standardized = damswrapper::get_standardized_string(surface);
+    const std::string standardized = damswrapper::get_standardized_string(surface);
+    std::string str;
+#else
+    const std::string_view standardized(surface);
 #endif /* HAVE_LIBDAMS */
-    for (prefix_no = 0; prefix_no < int(prefix.size()); prefix_no++) {
-      std::string prefix_str = prefix[prefix_no];
-      for (suffix_no = 0; suffix_no < int(suffix.size()); suffix_no++) {
-	std::string suffix_str = suffix[suffix_no];
-	std::string str = prefix_str + body + suffix_str;
+    for (prefix_no = 0; prefix_no < n_prefix; prefix_no++) {
+      std::string_view prefix_str = is_prefix_omitted ? std::string_view() : prefix[prefix_no];
+      for (suffix_no = 0; suffix_no < n_suffix; suffix_no++) {
+	std::string_view suffix_str = is_suffix_omitted ? std::string_view() : suffix[suffix_no];
 #ifdef HAVE_LIBDAMS
-	str = damswrapper::get_standardized_string(str);
+	str.assign(prefix_str.data(), prefix_str.length());
+	str.append(body.data(), body.length());
+	str.append(suffix_str.data(), suffix_str.length());
+	bool matched = (damswrapper::get_standardized_string(str) == standardized);
+#else
+	bool matched = (prefix_str.length() + body.length() + suffix_str.length() == standardized.length()
+			&& standardized.compare(0, prefix_str.length(), prefix_str) == 0
+			&& standardized.compare(prefix_str.length(), body.length(), body) == 0
+			&& standardized.compare(prefix_str.length() + body.length(), suffix_str.length(), suffix_str) == 0);
 #endif /* HAVE_LIBDAMS */
-        if (str == standardized) {
+        if (matched) {
 	  if (is_prefix_omitted) prefix_no = -1;
 	  if (is_suffix_omitted) suffix_no = -1;
 	  return true;
@@ -158,8 +409,8 @@ namespace geonlp
     suffix = "";
     bool r = get_prefix_and_suffix_no(surface, prefix_no, suffix_no);
     if (!r) return false;
-    if (prefix_no >= 0) prefix = this->get_prefix()[prefix_no];
-    if (suffix_no >= 0) suffix = this->get_suffix()[suffix_no];
+    if (prefix_no >= 0) prefix = this->get_prefix_view()[prefix_no];
+    if (suffix_no >= 0) suffix = this->get_suffix_view()[suffix_no];
     return true;
   }
 
@@ -173,11 +424,11 @@ namespace geonlp
     bool r = get_prefix_and_suffix_no(surface, prefix_no, suffix_no);
     if (!r) return false;
     if (prefix_no >= 0) {
-      std::vector<std::string> prefixes = this->get_prefix_kana();
+      picojson::string_list_view prefixes = this->get_prefix_kana_view();
       if (prefix_no < int(prefixes.size())) prefix_kana = prefixes[prefix_no];
     }
     if (suffix_no >= 0) {
-      std::vector<std::string> suffixes = this->get_suffix_kana();
+      picojson::string_list_view suffixes = this->get_suffix_kana_view();
       if (suffix_no < int(suffixes.size())) suffix_kana = suffixes[suffix_no];
     }
     return true;
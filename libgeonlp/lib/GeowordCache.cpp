@@ -0,0 +1,222 @@
+///
+/// @file
+/// @brief 地名語キャッシュクラス GeowordCache の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include "GeowordCache.h"
+
+namespace geonlp
+{
+  /// @brief コンストラクタ
+  /// @arg @c capacity 最大保持数、0 の場合はキャッシュしない
+  GeowordCache::GeowordCache(size_t capacity): shard_capacity(0), budget(NULL) {
+    this->setCapacity(capacity);
+  }
+
+  /// @brief 地名語を保持する場合の推定バイト数
+  ///
+  /// 地名語の JSON 表現のオブジェクトに加え、 LRU リストと索引の要素の大きさを含む。
+  /// @arg @c geoword   地名語
+  /// @arg @c geonlp_id 索引のキーとする地名語ID
+  /// @return 推定バイト数
+  size_t GeowordCache::estimateEntrySize(const Geoword& geoword, const std::string& geonlp_id) {
+    return sizeof(Entry) + 2 * sizeof(void*)   // LRU リストのノード
+      + sizeof(LruIndex::value_type) + 2 * sizeof(void*) + stringMemorySize(geonlp_id)  // 索引のノード
+      + geoword.estimateMemorySize();
+  }
+
+  /// @brief シャードの指定した地名語を削除する
+  /// @arg @c shard シャード、ロックを取得済みであること
+  /// @arg @c it    削除する地名語
+  /// @return 削除した地名語の次の要素
+  GeowordCache::LruList::iterator GeowordCache::erase(Shard& shard, LruList::iterator it) {
+    shard.index.erase((*it).geoword.get_geonlp_id());
+    shard.bytes -= (*it).bytes;
+    if (this->budget) this->budget->release((*it).bytes);
+    return shard.lru.erase(it);
+  }
+
+  /// @brief シャードの最も長く参照されていない地名語を追い出す
+  /// @arg @c shard シャード、ロックを取得済みであること
+  void GeowordCache::evictOldest(Shard& shard) {
+    LruList::iterator it = shard.lru.end();
+    it--;
+    this->erase(shard, it);
+  }
+
+  /// @brief 推定バイト数を計上するメモリ予算を設定する
+  ///
+  /// 地名語を登録する前に設定すること。保持している地名語の推定バイト数も計上し直す。
+  /// @arg @c budget メモリ予算、 NULL の場合は計上しない
+  void GeowordCache::setMemoryBudget(MemoryBudget* budget) {
+    for (int i = 0; i < GEOWORD_CACHE_SHARDS; i++) {
+      Shard& shard = shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (this->budget) this->budget->release(shard.bytes);
+      if (budget) budget->charge(shard.bytes);
+    }
+    this->budget = budget;
+  }
+
+  /// @brief 最大保持数を変更する
+  ///
+  /// 上限はシャード数の倍数に切り上げる。
+  /// 各シャードの保持数が新しい上限を超えている場合、古いものから追い出す。
+  /// @arg @c capacity 最大保持数、0 の場合はキャッシュしない
+  void GeowordCache::setCapacity(size_t capacity) {
+    size_t per_shard = (capacity + GEOWORD_CACHE_SHARDS - 1) / GEOWORD_CACHE_SHARDS;
+    for (int i = 0; i < GEOWORD_CACHE_SHARDS; i++) {
+      Shard& shard = shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      while (shard.lru.size() > per_shard) this->evictOldest(shard);
+    }
+    this->shard_capacity = per_shard;
+  }
+
+  /// @brief 地名語をキャッシュから取得する
+  /// @arg @c geonlp_id 地名語ID
+  /// @arg @c geoword   [out] 見つかった地名語
+  /// @return 見つかった場合 true
+  bool GeowordCache::get(const std::string& geonlp_id, Geoword& geoword) {
+    Shard& shard = shardFor(geonlp_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    LruIndex::iterator it = shard.index.find(geonlp_id);
+    if (it == shard.index.end()) {
+      shard.misses++;
+      return false;
+    }
+    // 最近参照されたものとして先頭に移動する
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    geoword = (*(it->second)).geoword;
+    shard.hits++;
+    return true;
+  }
+
+  /// @brief 地名語をキャッシュに登録する
+  ///
+  /// 既に登録されている場合は内容を置き換える。
+  /// シャードの保持数が上限を超えた場合、最も長く参照されていない地名語を追い出す。
+  /// メモリ予算を超えている場合も、登録した地名語以外を同様に追い出す。
+  /// @arg @c geoword 登録する地名語、無効な地名語は登録しない
+  void GeowordCache::put(const Geoword& geoword) {
+    if (this->shard_capacity == 0 || !geoword.isValid()) return;
+    const std::string geonlp_id = geoword.get_geonlp_id();
+    const size_t bytes = estimateEntrySize(geoword, geonlp_id);
+    Shard& shard = shardFor(geonlp_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    LruIndex::iterator it = shard.index.find(geonlp_id);
+    if (it != shard.index.end()) {
+      Entry& entry = *(it->second);
+      shard.bytes = shard.bytes - entry.bytes + bytes;
+      if (this->budget) {
+        this->budget->release(entry.bytes);
+        this->budget->charge(bytes);
+      }
+      entry.geoword = geoword;
+      entry.bytes = bytes;
+      shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    } else {
+      shard.lru.push_front(Entry(geoword, bytes));
+      shard.index[geonlp_id] = shard.lru.begin();
+      shard.bytes += bytes;
+      if (this->budget) this->budget->charge(bytes);
+    }
+    while (shard.lru.size() > this->shard_capacity) this->evictOldest(shard);
+    if (this->budget) {
+      while (shard.lru.size() > 1 && this->budget->isExceeded()) this->evictOldest(shard);
+    }
+  }
+
+  /// @brief 既にキャッシュされている地名語だけを新しい内容で置き換える
+  ///
+  /// LRU の順序は変更しない。
+  /// @arg @c geoword 新しい内容の地名語
+  void GeowordCache::refresh(const Geoword& geoword) {
+    const std::string geonlp_id = geoword.get_geonlp_id();
+    Shard& shard = shardFor(geonlp_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    LruIndex::iterator it = shard.index.find(geonlp_id);
+    if (it == shard.index.end()) return;
+    Entry& entry = *(it->second);
+    const size_t bytes = estimateEntrySize(geoword, geonlp_id);
+    shard.bytes = shard.bytes - entry.bytes + bytes;
+    if (this->budget) {
+      this->budget->release(entry.bytes);
+      this->budget->charge(bytes);
+    }
+    entry.geoword = geoword;
+    entry.bytes = bytes;
+  }
+
+  /// @brief 指定した辞書に含まれる地名語をキャッシュから削除する
+  /// @arg @c dictionary_id 辞書の内部 ID
+  void GeowordCache::removeDictionary(int dictionary_id) {
+    for (int i = 0; i < GEOWORD_CACHE_SHARDS; i++) {
+      Shard& shard = shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (LruList::iterator it = shard.lru.begin(); it != shard.lru.end(); ) {
+        if ((*it).geoword.get_dictionary_id() == dictionary_id) {
+          it = this->erase(shard, it);
+        } else {
+          it++;
+        }
+      }
+    }
+  }
+
+  /// @brief 指定した辞書以外に含まれる地名語をキャッシュから削除する
+  /// @arg @c dictionary_ids 残す辞書の内部 ID の集合
+  void GeowordCache::retainDictionaries(const std::set<int>& dictionary_ids) {
+    for (int i = 0; i < GEOWORD_CACHE_SHARDS; i++) {
+      Shard& shard = shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (LruList::iterator it = shard.lru.begin(); it != shard.lru.end(); ) {
+        if (dictionary_ids.find((*it).geoword.get_dictionary_id()) == dictionary_ids.end()) {
+          it = this->erase(shard, it);
+        } else {
+          it++;
+        }
+      }
+    }
+  }
+
+  /// @brief キャッシュを空にする
+  void GeowordCache::clear(void) {
+    for (int i = 0; i < GEOWORD_CACHE_SHARDS; i++) {
+      Shard& shard = shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.lru.clear();
+      shard.index.clear();
+      if (this->budget) this->budget->release(shard.bytes);
+      shard.bytes = 0;
+    }
+  }
+
+  /// @brief 利用状況を取得する
+  /// @return 全シャードの合計
+  GeowordCache::Stats GeowordCache::getStats(void) {
+    Stats stats;
+    for (int i = 0; i < GEOWORD_CACHE_SHARDS; i++) {
+      Shard& shard = shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      stats.hits += shard.hits;
+      stats.misses += shard.misses;
+      stats.size += shard.lru.size();
+      stats.bytes += shard.bytes;
+    }
+    stats.capacity = this->shard_capacity * GEOWORD_CACHE_SHARDS;
+    return stats;
+  }
+
+  /// @brief ヒット数、ミス数を 0 に戻す
+  void GeowordCache::resetStats(void) {
+    for (int i = 0; i < GEOWORD_CACHE_SHARDS; i++) {
+      Shard& shard = shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.hits = 0;
+      shard.misses = 0;
+    }
+  }
+}
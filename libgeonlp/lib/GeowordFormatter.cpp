@@ -5,6 +5,7 @@
 ///
 /// Copyright (c)2010, NII
 ///
+#include <stdio.h>
 #include <sstream>
 #include "GeowordFormatter.h"
 
@@ -16,19 +17,42 @@ namespace geonlp
 	// @return 整形された形態素情報	
 	std::string AbstructGeowordFormatter::formatNodeList(const std::vector<Node> & nodelist) 
 	{
-		std::ostringstream oss;
+		std::string out;
+		appendNodeList(nodelist, out);
+		return out;
+	}
+
+	// 形態素情報リストを整形してバッファの末尾に追加する。
+	//
+	// @arg @c nodelist 形態素情報リスト
+	// @arg out 出力先のバッファ
+	void AbstructGeowordFormatter::appendNodeList(const std::vector<Node> & nodelist, std::string & out)
+	{
 		for (std::vector<Node>::const_iterator it = nodelist.begin(); it != nodelist.end(); it++) {
-			if ( it->get_partOfSpeech() == "BOS/EOS"){
+			if ( it->get_partOfSpeech_view() == "BOS/EOS"){
 				if ( it == nodelist.begin()){
-				  oss << BOS();
+				  out += BOS();
 				} else {
-				  oss << EOS();
+				  out += EOS();
 				}
 			} else {
-				oss << formatNode(*it) << std::endl;
+				appendNode(*it, out);
+				out += '\n';
 			}
 		}
-		return oss.str();
+	}
+
+	// 形態素情報リストを整形してストリームに書き出す。
+	//
+	// 整形はスレッドごとのバッファで行い、まとめて書き出す。
+	// @arg @c nodelist 形態素情報リスト
+	// @arg os 出力先のストリーム
+	void AbstructGeowordFormatter::writeNodeList(const std::vector<Node> & nodelist, std::ostream & os)
+	{
+		static thread_local std::string buf;
+		buf.clear();
+		appendNodeList(nodelist, buf);
+		os.write(buf.data(), buf.length());
 	}
 	
 	const char *DefaultGeowordFormatter::delim = ",";
@@ -39,18 +63,27 @@ namespace geonlp
 	/// @return 整形された形態素情報
 	std::string DefaultGeowordFormatter::formatNode(const Node & node) 
 	{
-		std::ostringstream oss;
-		oss << node.get_surface() << "\t";
-		oss << node.get_partOfSpeech() << delim;
-		oss << node.get_subclassification1() << delim;
-		oss << node.get_subclassification2() << delim;
-		oss << node.get_subclassification3() << delim;
-		oss << node.get_conjugatedForm() << delim;
-		oss << node.get_conjugationType() << delim;
-		oss << node.get_originalForm() << delim;
-		oss << node.get_yomi() << delim;
-		oss << node.get_pronunciation();
-		return oss.str();
+		std::string out;
+		appendNode(node, out);
+		return out;
+	}
+
+	/// @brief 形態素情報を整形してバッファの末尾に追加する。
+	///
+	/// @arg @c node 形態素情報
+	/// @arg out 出力先のバッファ
+	void DefaultGeowordFormatter::appendNode(const Node & node, std::string & out)
+	{
+		out += node.get_surface_view(); out += '\t';
+		out += node.get_partOfSpeech_view(); out += delim;
+		out += node.get_subclassification1_view(); out += delim;
+		out += node.get_subclassification2_view(); out += delim;
+		out += node.get_subclassification3_view(); out += delim;
+		out += node.get_conjugatedForm_view(); out += delim;
+		out += node.get_conjugationType_view(); out += delim;
+		out += node.get_originalForm_view(); out += delim;
+		out += node.get_yomi_view(); out += delim;
+		out += node.get_pronunciation_view();
 	}
 	
 	/// @brief BOSに対応する文字列を返す。
@@ -76,20 +109,32 @@ namespace geonlp
 	/// @note node-format-chasen = \%m\\t\%f[7]\\t\%f[6]\\t\%F-[0,1,2,3]\\t\%f[4]\\t\%f[5]\\n
 	/// @todo Chasenフォーマットにあっているか確認
 	std::string ChasenGeowordFormatter::formatNode(const Node & node) 
+	{
+		std::string out;
+		appendNode(node, out);
+		return out;
+	}
+
+	/// @brief 形態素情報を整形してバッファの末尾に追加する。
+	///
+	/// @arg @c node 形態素情報
+	/// @arg out 出力先のバッファ
+	void ChasenGeowordFormatter::appendNode(const Node & node, std::string & out)
 	{
 		// node-format-chasen = %m\t%f[7]\t%f[6]\t%F-[0,1,2,3]\t%f[4]\t%f[5]\n
-		std::ostringstream oss;
-		oss << node.get_surface() << "\t";          // %m\t
-		oss << (( node.get_yomi() != "*")? node.get_yomi(): "") << "\t";                // %f[7]\t
-		oss << (( node.get_originalForm() != "*")? node.get_originalForm():"") << "\t"; // %f[6]\t
-		oss << node.get_partOfSpeech();
-		if ( node.get_subclassification1() != "*") oss << "-" << node.get_subclassification1();
-		if ( node.get_subclassification2() != "*") oss << "-" << node.get_subclassification2();
-		if ( node.get_subclassification3() != "*") oss << "-" << node.get_subclassification3();
-		oss << "\t";                                // %F-[0,1,2,3]\t
-		oss << (( node.get_conjugatedForm() != "*")? node.get_conjugatedForm(): "") << "\t";  // %f[4]\t
-		oss << (( node.get_conjugationType() != "*")? node.get_conjugationType(): "");        // %f[5]
-		return oss.str();
+		out += node.get_surface_view(); out += '\t';          // %m\t
+		if ( node.get_yomi_view() != "*") out += node.get_yomi_view();                  // %f[7]
+		out += '\t';
+		if ( node.get_originalForm_view() != "*") out += node.get_originalForm_view();  // %f[6]
+		out += '\t';
+		out += node.get_partOfSpeech_view();
+		if ( node.get_subclassification1_view() != "*") { out += '-'; out += node.get_subclassification1_view(); }
+		if ( node.get_subclassification2_view() != "*") { out += '-'; out += node.get_subclassification2_view(); }
+		if ( node.get_subclassification3_view() != "*") { out += '-'; out += node.get_subclassification3_view(); }
+		out += '\t';                                // %F-[0,1,2,3]\t
+		if ( node.get_conjugatedForm_view() != "*") out += node.get_conjugatedForm_view();    // %f[4]
+		out += '\t';
+		if ( node.get_conjugationType_view() != "*") out += node.get_conjugationType_view();  // %f[5]
 	}
 
 	/// @brief BOSに対応する文字列を返す。
@@ -107,4 +152,98 @@ namespace geonlp
 	{
 		return "EOS";
 	}
+
+	/// @brief JSON 文字列としてエスケープしてバッファの末尾に追加する。
+	///
+	/// picojson::value::serialize() と同じ規則でエスケープする。
+	static void _appendJsonString(std::string_view s, std::string & out)
+	{
+		out += '"';
+		for (std::string_view::const_iterator i = s.begin(); i != s.end(); ++i) {
+			switch (*i) {
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '/': out += "\\/"; break;
+			case '\b': out += "\\b"; break;
+			case '\f': out += "\\f"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if ((unsigned char)*i < 0x20 || *i == 0x7f) {
+					char buf[7];
+					snprintf(buf, sizeof(buf), "\\u%04x", *i & 0xff);
+					out.append(buf, 6);
+				} else {
+					out += *i;
+				}
+				break;
+			}
+		}
+		out += '"';
+	}
+
+	/// @brief 形態素情報を JSON オブジェクトとして返す。
+	///
+	/// @arg @c node 形態素情報
+	/// @return 整形された形態素情報
+	std::string JsonLinesGeowordFormatter::formatNode(const Node & node)
+	{
+		std::string out;
+		appendNode(node, out);
+		return out;
+	}
+
+	/// @brief 形態素情報を JSON オブジェクトとしてバッファの末尾に追加する。
+	///
+	/// picojson::object と同じく、キーの辞書順に出力する。
+	/// @arg @c node 形態素情報
+	/// @arg out 出力先のバッファ
+	void JsonLinesGeowordFormatter::appendNode(const Node & node, std::string & out)
+	{
+		out += "{\"conjugated_form\":"; _appendJsonString(node.get_conjugatedForm_view(), out);
+		out += ",\"conjugation_type\":"; _appendJsonString(node.get_conjugationType_view(), out);
+		out += ",\"original_form\":"; _appendJsonString(node.get_originalForm_view(), out);
+		out += ",\"pos\":"; _appendJsonString(node.get_partOfSpeech_view(), out);
+		out += ",\"prononciation\":"; _appendJsonString(node.get_pronunciation_view(), out);
+		out += ",\"subclass1\":"; _appendJsonString(node.get_subclassification1_view(), out);
+		out += ",\"subclass2\":"; _appendJsonString(node.get_subclassification2_view(), out);
+		out += ",\"subclass3\":"; _appendJsonString(node.get_subclassification3_view(), out);
+		out += ",\"surface\":"; _appendJsonString(node.get_surface_view(), out);
+		out += ",\"yomi\":"; _appendJsonString(node.get_yomi_view(), out);
+		out += '}';
+	}
+
+	/// @brief 形態素情報リストを 1 行の JSON 配列としてバッファの末尾に追加する。
+	///
+	/// @arg @c nodelist 形態素情報リスト
+	/// @arg out 出力先のバッファ
+	void JsonLinesGeowordFormatter::appendNodeList(const std::vector<Node> & nodelist, std::string & out)
+	{
+		out += BOS();
+		bool first = true;
+		for (std::vector<Node>::const_iterator it = nodelist.begin(); it != nodelist.end(); it++) {
+			if ( it->get_partOfSpeech_view() == "BOS/EOS") continue;
+			if (!first) out += ',';
+			appendNode(*it, out);
+			first = false;
+		}
+		out += EOS();
+	}
+
+	/// @brief 文の開始を表す文字列を返す。
+	///
+	/// @return "["
+	std::string JsonLinesGeowordFormatter::BOS()
+	{
+		return "[";
+	}
+	
+	/// @brief 文の終了を表す文字列を返す。
+	///
+	/// @return "]\n"
+	std::string JsonLinesGeowordFormatter::EOS()
+	{
+		return "]\n";
+	}
 }
@@ -0,0 +1,123 @@
+///
+/// @file
+/// @brief 見出し語ごとの地名語ノードのキャッシュクラス GeowordNodeCache の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include "GeowordNodeCache.h"
+
+namespace geonlp
+{
+  /// @brief コンストラクタ
+  ///
+  /// 最大保持数はシャード数の倍数に切り上げる。
+  /// @arg @c capacity 最大保持数、0 の場合はキャッシュしない
+  GeowordNodeCache::GeowordNodeCache(size_t capacity): budget(NULL) {
+    this->shard_capacity = (capacity + GEOWORD_NODE_CACHE_SHARDS - 1) / GEOWORD_NODE_CACHE_SHARDS;
+  }
+
+  /// @brief 要素を保持する場合の推定バイト数
+  ///
+  /// 表記、読みと候補の大きさに加え、 LRU リストと索引の要素の大きさを含む。
+  /// @arg @c item 保持する要素
+  /// @return 推定バイト数
+  size_t GeowordNodeCache::estimateItemSize(const Item& item) {
+    const Entry& entry = item.entry;
+    size_t bytes = sizeof(Item) + 2 * sizeof(void*)   // LRU リストのノード
+      + sizeof(LruIndex::value_type) + 2 * sizeof(void*);  // 索引のノード
+    bytes += stringMemorySize(entry.surface) + stringMemorySize(entry.yomi);
+    if (entry.candidates) {
+      bytes += sizeof(std::vector<GeowordCandidate>) + entry.candidates->capacity() * sizeof(GeowordCandidate);
+      for (size_t i = 0; i < entry.candidates->size(); i++) {
+        bytes += stringMemorySize((*entry.candidates)[i].geonlp_id) + stringMemorySize((*entry.candidates)[i].typical_name);
+      }
+    }
+    return bytes;
+  }
+
+  /// @brief シャードの最も長く参照されていない要素を追い出す
+  /// @arg @c shard シャード、ロックを取得済みであること
+  void GeowordNodeCache::evictOldest(Shard& shard) {
+    LruList::iterator it = shard.lru.end();
+    it--;
+    shard.index.erase((*it).key);
+    shard.bytes -= (*it).bytes;
+    if (this->budget) this->budget->release((*it).bytes);
+    shard.lru.erase(it);
+  }
+
+  /// @brief 要素をキャッシュから取得する
+  /// @arg @c generation 解析に利用する ActiveFilter の世代番号
+  /// @arg @c id         darts の見出し語ID
+  /// @arg @c ret        [out] 見つかった要素、候補はキャッシュと共有する
+  /// @return 見つかった場合 true
+  bool GeowordNodeCache::get(unsigned long generation, unsigned int id, Entry& ret) {
+    if (this->shard_capacity == 0) return false;
+    const Key key(generation, id);
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    LruIndex::iterator it = shard.index.find(key);
+    if (it == shard.index.end()) return false;
+    // 最近参照されたものとして先頭に移動する
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    ret = (*(it->second)).entry;
+    return true;
+  }
+
+  /// @brief 要素をキャッシュに登録する
+  ///
+  /// 既に登録されている場合は何もしない。
+  /// シャードの保持数が上限を超えた場合、最も長く参照されていない要素を追い出す。
+  /// メモリ予算を超えている場合も、登録した要素以外を同様に追い出す。
+  /// @arg @c generation 解析に利用した ActiveFilter の世代番号
+  /// @arg @c id         darts の見出し語ID
+  /// @arg @c entry      登録する要素
+  void GeowordNodeCache::put(unsigned long generation, unsigned int id, const Entry& entry) {
+    if (this->shard_capacity == 0) return;
+    const Key key(generation, id);
+    // 複製と見積もりはロックの外で行う
+    LruList item;
+    item.push_back(Item(key, entry));
+    const size_t bytes = estimateItemSize(item.front());
+    item.front().bytes = bytes;
+
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.index.find(key) != shard.index.end()) return;
+    shard.lru.splice(shard.lru.begin(), item);
+    shard.index[key] = shard.lru.begin();
+    shard.bytes += bytes;
+    if (this->budget) this->budget->charge(bytes);
+    while (shard.lru.size() > this->shard_capacity) this->evictOldest(shard);
+    if (this->budget) {
+      while (shard.lru.size() > 1 && this->budget->isExceeded()) this->evictOldest(shard);
+    }
+  }
+
+  /// @brief キャッシュを空にする
+  void GeowordNodeCache::clear(void) {
+    for (int i = 0; i < GEOWORD_NODE_CACHE_SHARDS; i++) {
+      Shard& shard = shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.lru.clear();
+      shard.index.clear();
+      if (this->budget) this->budget->release(shard.bytes);
+      shard.bytes = 0;
+    }
+  }
+
+  /// @brief 利用状況を取得する
+  /// @return 全シャードの合計
+  GeowordNodeCache::Stats GeowordNodeCache::getStats(void) {
+    Stats stats;
+    for (int i = 0; i < GEOWORD_NODE_CACHE_SHARDS; i++) {
+      Shard& shard = shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      stats.size += shard.lru.size();
+      stats.bytes += shard.bytes;
+    }
+    stats.capacity = this->shard_capacity * GEOWORD_NODE_CACHE_SHARDS;
+    return stats;
+  }
+}
@@ -8,6 +8,9 @@
 #include <iostream>
 #include <fstream>
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/filesystem.hpp>
+
 #include "MeCabAdapter.h"
 #include "Node.h"
 #include <mecab.h>
@@ -38,8 +41,14 @@ namespace geonlp
       if (!initparam.empty()) initparam += " ";
       initparam += std::string("--dicdir=") + system_dic_dir;
     }
-    mecabp = MeCab::createTagger( initparam.c_str());
+    modelp = MeCab::createModel( initparam.c_str());
+    if ( modelp == NULL){
+      throw std::runtime_error( MeCab::getTaggerError());
+    }
+    mecabp = modelp->createTagger();
     if ( mecabp == NULL){
+      delete modelp;
+      modelp = NULL;
       throw std::runtime_error( MeCab::getTaggerError());
     }
   }
@@ -48,27 +57,50 @@ namespace geonlp
   void MeCabAdapter::terminate() {
     if (mecabp) delete mecabp;
     mecabp = NULL;
+    if (modelp) delete modelp;
+    modelp = NULL;
+  }
+	
+  /// @brief MeCab が読み込んだシステム辞書、ユーザ辞書などのファイルの合計バイト数を返す。
+  ///
+  /// MeCab は辞書ファイルを mmap するため、プロセスのメモリのうち辞書が占める量の目安になる。
+  /// @return 合計バイト数、未初期化の場合は 0
+  size_t MeCabAdapter::getDictionarySize() const {
+    size_t bytes = 0;
+    if (modelp == NULL) return bytes;
+    for (const MeCab::DictionaryInfo* info = modelp->dictionary_info(); info != NULL; info = info->next) {
+      boost::system::error_code ec;
+      boost::uintmax_t size = boost::filesystem::file_size(info->filename, ec);
+      if (!ec) bytes += size_t(size);
+    }
+    return bytes;
   }
 	
   /// @brief 引数として渡された自然文を形態素解析し、解析結果の各行を要素とするノードの配列を返す。
   ///
+  /// 解析ごとに MeCab::Lattice を作成するため、複数スレッドから同時に呼び出してもよい。
+  /// 結果は nodelist を空にしてから追加するので、呼び出し側は同じ配列を再利用できる。
   /// @arg @c sentence 解析対象の自然文。
-  /// @return 形態素情報のリスト。
+  /// @arg nodelist [out] 形態素情報の配列。
   /// @exception MeCabNotInitializedException MeCabが未初期化。
   /// @exception MeCabErrException MeCabでエラー。
-  MeCabAdapter::NodeList MeCabAdapter::parse(const std::string & sentence) {
+  void MeCabAdapter::parse(const std::string & sentence, MeCabAdapter::NodeList & nodelist) const {
 			
-    if ( mecabp ==NULL) throw MeCabNotInitializedException();
-    const MeCab::Node *mecab_node = mecabp->parseToNode( sentence.c_str());
-    if (! mecab_node) {
-      throw MeCabErrException( mecabp->what());
+    if ( mecabp ==NULL || modelp == NULL) throw MeCabNotInitializedException();
+    StatsTimer timer(this->stats, STATS_MECAB);
+    boost::scoped_ptr<MeCab::Lattice> lattice(modelp->createLattice());
+    if (! lattice) {
+      throw MeCabErrException( MeCab::getTaggerError());
+    }
+    lattice->set_sentence( sentence.c_str(), sentence.length());
+    if (! mecabp->parse(lattice.get())) {
+      throw MeCabErrException( lattice->what());
     }
 			
-    MeCabAdapter::NodeList nodelist;
-    for (;  mecab_node; mecab_node = mecab_node->next) {
-      Node node( std::string( mecab_node->surface, mecab_node->length), mecab_node->feature);
-      nodelist.push_back(node);
+    nodelist.clear();
+    for (const MeCab::Node *mecab_node = lattice->bos_node();  mecab_node; mecab_node = mecab_node->next) {
+      nodelist.push_back(Node( std::string( mecab_node->surface, mecab_node->length), mecab_node->feature, mecab_node->posid));
     }
-    return nodelist;
+    timer.setRows(nodelist.size());
   }
 }
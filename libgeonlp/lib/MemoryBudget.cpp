@@ -0,0 +1,24 @@
+///
+/// @file
+/// @brief キャッシュが共有するメモリ予算 MemoryBudget の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include "MemoryBudget.h"
+
+namespace geonlp
+{
+  /// @brief コンストラクタ
+  /// @arg @c limit 上限のバイト数、0 の場合は制限しない
+  MemoryBudget::MemoryBudget(size_t limit): limit(limit), charged(0) {}
+
+  /// @brief 計上したバイト数が上限を超えているかどうか
+  ///
+  /// 他の MA やプロセス全体のメモリは考慮しない。
+  /// @return 上限を超えている場合 true, 上限が 0 の場合は常に false
+  bool MemoryBudget::isExceeded(void) const {
+    if (this->limit == 0) return false;
+    return this->getCharged() > this->limit;
+  }
+}
@@ -7,9 +7,9 @@
 ///
 #include <sstream>
 #include <vector>
-#include <boost/algorithm/string.hpp>
 #include <boost/regex.hpp>
 #include "Node.h"
+#include "MemoryBudget.h"
 
 namespace geonlp
 {
@@ -17,30 +17,71 @@ namespace geonlp
   const std::string Node::delim = ",";
 	
   // コンストラクタ。
-  // 引数に与えられたfeatureを素性情報に分解し、各メンバに設定する。
+  // 引数に与えられたfeatureを素性情報に分解する。
   // @arg @c surface 形態素の文字列情報(表層形)
   // @arg @c feature MeCab::Nodeの持つfeature。CSV で表記された素性情報。
-  Node::Node( const std::string& surface, const std::string& feature)
+  // @arg @c posid MeCab::Nodeの持つ品詞ID
+  Node::Node( const std::string& surface, const std::string& feature, int posid): posid(posid), overridden(0), subclassification3Pending(false)
   {
     set_surface( surface);
     this->feature = feature;
-		
-    // featureを分解
-    std::vector<std::string> strlist;
-    boost::split(strlist, feature, boost::is_any_of(","));
-		
-    // nodeの各フィールドを設定
-    set_partOfSpeech( (strlist.size() > 0)? strlist[0]: "");
-    set_subclassification1( (strlist.size() > 1)? strlist[1]: "");
-    set_subclassification2( (strlist.size() > 2)? strlist[2]: "");
-    set_subclassification3( (strlist.size() > 3)? strlist[3]: "");
-    set_conjugatedForm( (strlist.size() > 4)? strlist[4]: "");
-    set_conjugationType( (strlist.size() > 5)? strlist[5]: "");
-    set_originalForm( (strlist.size() > 6)? strlist[6]: "");
-    set_yomi( (strlist.size() > 7)? strlist[7]: "");
-    set_pronunciation( (strlist.size() > 8)? strlist[8]: "");
+    splitFeature();
   }
-	
+
+  // feature をフィールドに分割した位置を ranges に記録する
+  // (boost::split と同様に "," で区切り、足りないフィールドは空文字列とする)
+  void Node::splitFeature()
+  {
+    size_t pos = 0;
+    for (int i = 0; i < NUM_FIELDS; i++) {
+      if (pos > feature.length()) {
+        ranges[i].offset = 0;
+        ranges[i].length = 0;
+        continue;
+      }
+      size_t next = feature.find(',', pos);
+      if (next == std::string::npos) next = feature.length();
+      ranges[i].offset = pos;
+      ranges[i].length = next - pos;
+      pos = next + 1;
+    }
+  }
+
+  // 素性情報を置き換える。
+  // 既存のフィールドの値は新しい素性情報の影響を受けないように values に移す。
+  void Node::replaceFeature(const std::string& value)
+  {
+    for (int i = 0; i < NUM_FIELDS; i++) {
+      if (overridden & (1u << i)) continue;
+      values[i] = std::string(feature, ranges[i].offset, ranges[i].length);
+      overridden |= (1u << i);
+    }
+    feature = value;
+    posid = -1;
+    splitFeature();
+  }
+
+  // geowordCandidates から "ID:代表表記/ID:代表表記" 形式の subclassification3 を作成する
+  void Node::materializeSubclassification3() const
+  {
+    std::string& subclassification3 = values[FIELD_SUBCLASS3];
+    subclassification3.clear();
+    const std::vector<GeowordCandidate>& candidates = get_geowordCandidates();
+    for (std::vector<GeowordCandidate>::const_iterator it = candidates.begin(); it != candidates.end(); it++) {
+      if (it != candidates.begin()) subclassification3 += "/";
+      subclassification3.append((*it).geonlp_id).append(":").append((*it).typical_name);
+    }
+    overridden |= (1u << FIELD_SUBCLASS3);
+    subclassification3Pending = false;
+  }
+
+  // set_geowordCandidates() で設定した地名語候補を得る。
+  const std::vector<GeowordCandidate>& Node::get_geowordCandidates() const
+  {
+    static const std::vector<GeowordCandidate> empty;
+    return geowordCandidates ? *geowordCandidates : empty;
+  }
+
   // picojson::object に変換する
   picojson::object Node::toObject() const
   {
@@ -58,6 +99,14 @@ namespace geonlp
     return obj;
   }
 
+  // 確保しているメモリのバイト数を見積もる。
+  size_t Node::estimateMemorySize() const
+  {
+    size_t bytes = sizeof(Node) + stringMemorySize(surface) + stringMemorySize(feature);
+    for (int i = 0; i < NUM_FIELDS; i++) bytes += stringMemorySize(values[i]);
+    return bytes;
+  }
+
   // デバグ用のテキスト表記を得る。
   // 書式はMeCabのデフォルトに準じる。
   std::string Node::toString() const
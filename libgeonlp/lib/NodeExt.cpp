@@ -81,95 +81,46 @@ namespace geonlp
         || this->surface.substr(0, 3) == "～"
         || this->surface.substr(0, 3) == "♪"
         || this->surface.length() == 1)) {
-      this->feature = "記号,一般,*,*,*,*,*";
+      this->replaceFeature("記号,一般,*,*,*,*,*");
       this->set_partOfSpeech("記号");
       this->set_subclassification1("一般");
       this->set_subclassification2("*");
     }
 
+    // 品詞集合による分類は品詞IDの表で一度に判定する
+    const unsigned int pos_class = phbsdef.classify(feature, this->get_posid());
+
     // H(head)：「名詞,固有名詞,*」：地名語の先頭となり得る品詞集合 判定
-    bHead = false;
-    for ( std::vector<std::string>::const_iterator it = phbsdef.heads.begin(); it != phbsdef.heads.end(); it++){
-      if ( 0 == feature.compare( 0, it->length(), *it)){
-        bHead = true;
-        break;
-      }
-    }
+    bHead = (pos_class & PHBSDefs::POS_HEAD) != 0;
     // B(body)：「名詞,固有名詞,*, 名詞,接尾,地域,*, 名詞,数, *,... 地名語の部分となり得る品詞集合 判定
-    bBody = false;
-    for ( std::vector<std::string>::const_iterator it = phbsdef.bodies.begin(); it != phbsdef.bodies.end(); it++){
-      if ( 0 == feature.compare( 0, it->length(), *it)){
-        bBody = true;
-        break;
-      }
-    }
+    bBody = (pos_class & PHBSDefs::POS_BODY) != 0;
     // 接尾辞の可能性判定
     bSuffix = false;
     if ( canBeBody()){
-      for ( std::vector<Suffix>::const_iterator it = phbsdef.suffixes.begin(); it != phbsdef.suffixes.end(); it++){
-        const std::string& s = it->get_surface();
-        // 文字列長の確認を行う。素性が接尾辞に一致するような場合は除外する
-        if ( s.length() >= surface.length()) continue;
-        
-        if ( 0 == surface.compare( surface.length() - s.length(), s.length(), s)){
-          bSuffix = true;
-          suffix = *it;
-          break;
-        }
+      int index = phbsdef.findSuffix(surface);
+      if (index >= 0) {
+        bSuffix = true;
+        suffix = phbsdef.suffixes[index];
       }
     }
     // 単独で地名語になり得ることの可能性判定
     bSingle = false;
     if ( canBeHead()){
-      bSingle = true;
-      for ( std::vector<std::string>::const_iterator it = phbsdef.extsingle.begin(); it != phbsdef.extsingle.end(); it++){
-        if ( 0 == feature.compare( 0, it->length(), *it)){
-          bSingle = false;
-          break;
-        }
-      }
-      if (bSingle) { // ブラックリストの地名語は単独で地名語にならない
-        for (std::vector<std::string>::const_iterator it = phbsdef.non_geowords.begin(); it != phbsdef.non_geowords.end(); it++) {
-          if (0 == surface.compare(0, it->length(), *it)) {
-            bSingle = false;
-            break;
-          }
-        }
+      bSingle = (pos_class & PHBSDefs::POS_EXTSINGLE) == 0;
+      if (bSingle && phbsdef.isNonGeoword(surface)) { // ブラックリストの地名語は単独で地名語にならない
+        bSingle = false;
       }
     }
     // 単独で地名語かそれ以外か併記する可能性判定
-    bAlternative = false;
-    for ( std::vector<std::string>::const_iterator it = phbsdef.alternatives.begin(); it != phbsdef.alternatives.end(); it++){
-      if ( 0 == feature.compare( 0, it->length(), *it)){
-        bAlternative = true;
-        break;
-      }
-    }
+    bAlternative = (pos_class & PHBSDefs::POS_ALTERNATIVE) != 0;
     // X(stopper)：「名詞,一般,*」：地名語に続かない品詞集合 判定
-    bStop = false;
-    for ( std::vector<std::string>::const_iterator it = phbsdef.stoppers.begin(); it != phbsdef.stoppers.end(); it++){
-      if ( 0 == feature.compare( 0, it->length(), *it)){
-        bStop = true;
-        break;
-      }
-    }
-    if (bStop) {
+    bStop = (pos_class & PHBSDefs::POS_STOPPER) != 0;
+    if (bStop && phbsdef.isSpatial(surface)) {
       // ただし素性が空間語に一致するような場合は除外する
-      for ( std::vector<std::string>::const_iterator it = phbsdef.spatials.begin(); it != phbsdef.spatials.end(); it++) {
-        if ( *it == surface) {
-          bStop = false;
-          break;
-        }
-      }
+      bStop = false;
     }
     // 地名語に先行しない語かどうかの判定
-    bAntileader = false;
-    for ( std::vector<std::string>::const_iterator it = phbsdef.antileaders.begin(); it != phbsdef.antileaders.end(); it++){
-      if ( 0 == feature.compare( 0, it->length(), *it)){
-        bAntileader = true;
-        break;
-      }
-    }
+    bAntileader = (pos_class & PHBSDefs::POS_ANTILEADER) != 0;
   }
   
 }
@@ -7,15 +7,146 @@
 ///
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 #include "PHBSDefs.h"
 
 namespace geonlp
 {
+	/// @brief IPA 辞書（mecab-ipadic）の pos-id.def の品詞、添字が品詞ID
+	static const char* ipadicPosNames[] = {
+		"その他,間投,*,*",  // 0
+		"フィラー,*,*,*",  // 1
+		"感動詞,*,*,*",  // 2
+		"記号,アルファベット,*,*",  // 3
+		"記号,一般,*,*",  // 4
+		"記号,括弧開,*,*",  // 5
+		"記号,括弧閉,*,*",  // 6
+		"記号,句点,*,*",  // 7
+		"記号,空白,*,*",  // 8
+		"記号,読点,*,*",  // 9
+		"形容詞,自立,*,*",  // 10
+		"形容詞,接尾,*,*",  // 11
+		"形容詞,非自立,*,*",  // 12
+		"助詞,格助詞,一般,*",  // 13
+		"助詞,格助詞,引用,*",  // 14
+		"助詞,格助詞,連語,*",  // 15
+		"助詞,係助詞,*,*",  // 16
+		"助詞,終助詞,*,*",  // 17
+		"助詞,接続助詞,*,*",  // 18
+		"助詞,特殊,*,*",  // 19
+		"助詞,副詞化,*,*",  // 20
+		"助詞,副助詞,*,*",  // 21
+		"助詞,副助詞／並立助詞／終助詞,*,*",  // 22
+		"助詞,並立助詞,*,*",  // 23
+		"助詞,連体化,*,*",  // 24
+		"助動詞,*,*,*",  // 25
+		"接続詞,*,*,*",  // 26
+		"接頭詞,形容詞接続,*,*",  // 27
+		"接頭詞,数接続,*,*",  // 28
+		"接頭詞,動詞接続,*,*",  // 29
+		"接頭詞,名詞接続,*,*",  // 30
+		"動詞,自立,*,*",  // 31
+		"動詞,接尾,*,*",  // 32
+		"動詞,非自立,*,*",  // 33
+		"副詞,一般,*,*",  // 34
+		"副詞,助詞類接続,*,*",  // 35
+		"名詞,サ変接続,*,*",  // 36
+		"名詞,ナイ形容詞語幹,*,*",  // 37
+		"名詞,一般,*,*",  // 38
+		"名詞,引用文字列,*,*",  // 39
+		"名詞,形容動詞語幹,*,*",  // 40
+		"名詞,固有名詞,一般,*",  // 41
+		"名詞,固有名詞,人名,一般",  // 42
+		"名詞,固有名詞,人名,姓",  // 43
+		"名詞,固有名詞,人名,名",  // 44
+		"名詞,固有名詞,組織,*",  // 45
+		"名詞,固有名詞,地域,一般",  // 46
+		"名詞,固有名詞,地域,国",  // 47
+		"名詞,数,*,*",  // 48
+		"名詞,接続詞的,*,*",  // 49
+		"名詞,接尾,サ変接続,*",  // 50
+		"名詞,接尾,一般,*",  // 51
+		"名詞,接尾,形容動詞語幹,*",  // 52
+		"名詞,接尾,助数詞,*",  // 53
+		"名詞,接尾,助動詞語幹,*",  // 54
+		"名詞,接尾,人名,*",  // 55
+		"名詞,接尾,地域,*",  // 56
+		"名詞,接尾,特殊,*",  // 57
+		"名詞,接尾,副詞可能,*",  // 58
+		"名詞,代名詞,一般,*",  // 59
+		"名詞,代名詞,縮約,*",  // 60
+		"名詞,動詞非自立的,*,*",  // 61
+		"名詞,特殊,助動詞語幹,*",  // 62
+		"名詞,非自立,一般,*",  // 63
+		"名詞,非自立,形容動詞語幹,*",  // 64
+		"名詞,非自立,助動詞語幹,*",  // 65
+		"名詞,非自立,副詞可能,*",  // 66
+		"名詞,副詞可能,*,*",  // 67
+		"連体詞,*,*,*",  // 68
+	};
+
+	/// @brief 素性が品詞集合のいずれかに前方一致するか判定する。
+	static bool _matchesAny(const std::string& feature, const std::vector<std::string>& patterns)
+	{
+		for (std::vector<std::string>::const_iterator it = patterns.begin(); it != patterns.end(); it++) {
+			if (0 == feature.compare(0, it->length(), *it)) return true;
+		}
+		return false;
+	}
+
+	/// @brief 品詞集合に、品詞より長く品詞から始まるものがあるか判定する。
+	static bool _hasLongerPattern(const std::string& prefix, const std::vector<std::string>& patterns)
+	{
+		for (std::vector<std::string>::const_iterator it = patterns.begin(); it != patterns.end(); it++) {
+			if (it->length() > prefix.length() && 0 == it->compare(0, prefix.length(), prefix)) return true;
+		}
+		return false;
+	}
+
+	/// @brief 見出し語のリストから darts を作成する。
+	///
+	/// 同じ見出し語が複数ある場合は最初のものの添字を値とする。
+	/// 空文字列は darts に登録できないので除外し、 has_empty に記録する。
+	/// @arg @c keys      見出し語のリスト
+	/// @arg @c has_empty [out] 空文字列の見出し語の添字、無い場合は -1
+	/// @return 作成した darts、空文字列以外の見出し語が無い場合は NULL
+	static boost::shared_ptr<Darts::DoubleArray> _buildTrie(const std::vector<std::string>& keys, int& has_empty)
+	{
+		has_empty = -1;
+		std::vector<std::pair<std::string, int> > entries;
+		for (size_t i = 0; i < keys.size(); i++) {
+			if (keys[i].empty()) {
+				if (has_empty < 0) has_empty = int(i);
+				continue;
+			}
+			entries.push_back(std::make_pair(keys[i], int(i)));
+		}
+		boost::shared_ptr<Darts::DoubleArray> trie;
+		if (entries.empty()) return trie;
+
+		// darts は見出し語を文字コード順に、重複なく与える必要がある
+		std::sort(entries.begin(), entries.end());
+		std::vector<const char*> key_ptrs;
+		std::vector<size_t> lengths;
+		std::vector<Darts::DoubleArray::value_type> values;
+		for (size_t i = 0; i < entries.size(); i++) {
+			if (i > 0 && entries[i].first == entries[i - 1].first) continue;
+			key_ptrs.push_back(entries[i].first.c_str());
+			lengths.push_back(entries[i].first.length());
+			values.push_back(entries[i].second);
+		}
+		trie.reset(new Darts::DoubleArray());
+		if (trie->build(key_ptrs.size(), &key_ptrs[0], &lengths[0], &values[0]) != 0) {
+			throw std::runtime_error("Cannot build a double array for the profile.");
+		}
+		return trie;
+	}
+
 	///
 	/// 地名語の先頭となり得る品詞集合、地名語の部分となり得る品詞集合、地名語の先頭となり得る品詞のうち、単独で地名語になり得ない品詞集合
 	/// を定義する。
 	/// @note それぞれの品詞集合を変更する場合は、この関数の実装を変更する。
-	PHBSDefs::PHBSDefs() 
+	PHBSDefs::PHBSDefs(): emptySuffix(-1), emptySpatial(false), emptyNonGeoword(false)
 	{
 		// H(head)：地名語の先頭となり得る品詞集合を定義
 		heads.push_back("名詞,固有名詞");
@@ -66,6 +197,7 @@ namespace geonlp
 		antileaders.push_back("名詞,形容動詞語幹");
 		// antileaders.push_back("名詞,接尾,地域"); // 接尾付きで地名語登録 -> 直前の地名が未登録の可能性もある
 		antileaders.push_back("名詞,接尾,一般");
+		buildPosClasses();
 	};
 	
 	/// @brief 地名接頭辞集合および地名接尾辞集合をプロファイルから読み込む。
@@ -75,6 +207,120 @@ namespace geonlp
 		suffixes = profile.get_suffix();
 		spatials = profile.get_spatial();
 		non_geowords = profile.get_non_geoword();
+		buildPosClasses();
+		buildTries();
+	}
+
+	/// @brief 地名接尾辞、空間語、単独で地名語にならない語の darts を作成する。
+	///
+	/// 地名接尾辞は末尾から一致させるため、表層形をバイト単位で逆順にして登録する。
+	void PHBSDefs::buildTries() {
+		std::vector<std::string> keys;
+		for (std::vector<Suffix>::const_iterator it = suffixes.begin(); it != suffixes.end(); it++) {
+			std::string s = it->get_surface();
+			std::reverse(s.begin(), s.end());
+			keys.push_back(s);
+		}
+		suffixTrie = _buildTrie(keys, emptySuffix);
+
+		int empty;
+		spatialTrie = _buildTrie(spatials, empty);
+		emptySpatial = (empty >= 0);
+		nonGeowordTrie = _buildTrie(non_geowords, empty);
+		emptyNonGeoword = (empty >= 0);
+	}
+
+	/// @brief 表層形の末尾に一致する地名接尾辞を探す。
+	///
+	/// 表層形を逆順にした一度の走査で、末尾に一致する全ての接尾辞を得る。
+	/// 表層形全体に一致する接尾辞は除く。複数の接尾辞が一致する場合は
+	/// suffixes で先に定義されたものを返す。
+	/// @arg @c surface 形態素の表層形
+	/// @return suffixes の添字、一致する接尾辞が無い場合は -1
+	int PHBSDefs::findSuffix(const std::string& surface) const {
+		if (surface.empty()) return -1;
+		int found = emptySuffix;
+		if (suffixTrie && surface.length() > 1) {
+			std::string reversed(surface.rbegin(), surface.rend());
+			std::vector<Darts::DoubleArray::result_pair_type> results(reversed.length());
+			size_t n = suffixTrie->commonPrefixSearch(reversed.c_str(), &results[0], results.size(), reversed.length() - 1);
+			if (n > results.size()) n = results.size();
+			for (size_t i = 0; i < n; i++) {
+				if (found < 0 || results[i].value < found) found = results[i].value;
+			}
+		}
+		return found;
+	}
+
+	/// @brief 表層形が空間語に一致するか判定する。
+	///
+	/// @arg @c surface 形態素の表層形
+	/// @return 一致する場合は true
+	bool PHBSDefs::isSpatial(const std::string& surface) const {
+		if (surface.empty()) return emptySpatial;
+		if (!spatialTrie) return false;
+		return spatialTrie->exactMatchSearch<Darts::DoubleArray::value_type>(surface.c_str(), surface.length()) >= 0;
+	}
+
+	/// @brief 表層形が単独で地名語にならない語から始まるか判定する。
+	///
+	/// @arg @c surface 形態素の表層形
+	/// @return 前方一致する語がある場合は true
+	bool PHBSDefs::isNonGeoword(const std::string& surface) const {
+		if (emptyNonGeoword) return true;
+		if (!nonGeowordTrie || surface.empty()) return false;
+		Darts::DoubleArray::result_pair_type result;
+		return nonGeowordTrie->commonPrefixSearch(surface.c_str(), &result, 1, surface.length()) > 0;
+	}
+
+	/// @brief IPA 辞書の品詞IDごとに、品詞集合による分類を事前に計算する。
+	///
+	/// 品詞集合は素性と前方一致で比較するため、品詞細分類３までの素性が同じであれば
+	/// 分類も同じになる。ただし品詞から始まり品詞より長いものが品詞集合にある場合は
+	/// 活用形以降の素性で分類が変わり得るので、その品詞IDには表を利用しない。
+	void PHBSDefs::buildPosClasses() {
+		const size_t n = sizeof(ipadicPosNames) / sizeof(ipadicPosNames[0]);
+		posClasses.clear();
+		posClasses.resize(n);
+		for (size_t i = 0; i < n; i++) {
+			std::string prefix = std::string(ipadicPosNames[i]) + ",";
+			posClasses[i].flags = classify(prefix);
+			if (_hasLongerPattern(prefix, heads) || _hasLongerPattern(prefix, bodies)
+					|| _hasLongerPattern(prefix, extsingle) || _hasLongerPattern(prefix, alternatives)
+					|| _hasLongerPattern(prefix, stoppers) || _hasLongerPattern(prefix, antileaders)) continue;
+			posClasses[i].prefix = prefix;
+		}
+	}
+
+	/// @brief 素性を品詞集合と前方一致で比較して分類する。
+	///
+	/// @arg @c feature MeCab の素性
+	/// @return 品詞集合による分類のビット
+	unsigned int PHBSDefs::classify(const std::string& feature) const {
+		unsigned int flags = 0;
+		if (_matchesAny(feature, heads)) flags |= POS_HEAD;
+		if (_matchesAny(feature, bodies)) flags |= POS_BODY;
+		if (_matchesAny(feature, extsingle)) flags |= POS_EXTSINGLE;
+		if (_matchesAny(feature, alternatives)) flags |= POS_ALTERNATIVE;
+		if (_matchesAny(feature, stoppers)) flags |= POS_STOPPER;
+		if (_matchesAny(feature, antileaders)) flags |= POS_ANTILEADER;
+		return flags;
+	}
+
+	/// @brief 品詞IDの表を利用して素性を分類する。
+	///
+	/// 表の品詞と素性の先頭が一致する場合は一度の比較で分類を返す。
+	/// 品詞IDが不明な場合や、ユーザ辞書や他のシステム辞書で品詞IDの割り当てが
+	/// 異なる場合は classify(feature) と同じ比較を行う。
+	/// @arg @c feature MeCab の素性
+	/// @arg @c posid MeCab の品詞ID、不明な場合は負の値
+	/// @return 品詞集合による分類のビット
+	unsigned int PHBSDefs::classify(const std::string& feature, int posid) const {
+		if (posid >= 0 && (size_t)posid < posClasses.size()) {
+			const PosClass& pc = posClasses[posid];
+			if (!pc.prefix.empty() && 0 == feature.compare(0, pc.prefix.length(), pc.prefix)) return pc.flags;
+		}
+		return classify(feature);
 	}
 }
 
@@ -0,0 +1,123 @@
+///
+/// @file
+/// @brief 文の解析結果のキャッシュクラス ParseCache の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include "ParseCache.h"
+
+namespace geonlp
+{
+  /// @brief コンストラクタ
+  ///
+  /// 最大保持数はシャード数の倍数に切り上げる。
+  /// @arg @c capacity 最大保持数、0 の場合はキャッシュしない
+  ParseCache::ParseCache(size_t capacity): budget(NULL) {
+    this->shard_capacity = (capacity + PARSE_CACHE_SHARDS - 1) / PARSE_CACHE_SHARDS;
+  }
+
+  /// @brief 結果を保持する場合の推定バイト数
+  ///
+  /// ノードと文の大きさに加え、 LRU リストと索引の要素の大きさを含む。
+  /// @arg @c entry 保持する結果
+  /// @return 推定バイト数
+  size_t ParseCache::estimateEntrySize(const Entry& entry) {
+    size_t bytes = sizeof(Entry) + 2 * sizeof(void*)   // LRU リストのノード
+      + sizeof(LruIndex::value_type) + 2 * sizeof(void*) + 2 * stringMemorySize(entry.key.second);  // 索引のノード
+    bytes += (entry.nodes.capacity() - entry.nodes.size()) * sizeof(Node);
+    for (std::vector<Node>::const_iterator it = entry.nodes.begin(); it != entry.nodes.end(); it++) {
+      bytes += (*it).estimateMemorySize();
+    }
+    return bytes;
+  }
+
+  /// @brief シャードの最も長く参照されていない結果を追い出す
+  /// @arg @c shard シャード、ロックを取得済みであること
+  void ParseCache::evictOldest(Shard& shard) {
+    LruList::iterator it = shard.lru.end();
+    it--;
+    shard.index.erase((*it).key);
+    shard.bytes -= (*it).bytes;
+    if (this->budget) this->budget->release((*it).bytes);
+    shard.lru.erase(it);
+  }
+
+  /// @brief 結果をキャッシュから取得する
+  /// @arg @c generation 解析に利用する ActiveFilter の世代番号
+  /// @arg @c sentence   文
+  /// @arg @c ret        [out] 解析結果の複製
+  /// @return 見つかった場合 true
+  bool ParseCache::get(unsigned long generation, const std::string& sentence, std::vector<Node>& ret) {
+    if (this->shard_capacity == 0) return false;
+    const Key key(generation, sentence);
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    LruIndex::iterator it = shard.index.find(key);
+    if (it == shard.index.end()) return false;
+    // 最近参照されたものとして先頭に移動する
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    ret = (*(it->second)).nodes;
+    return true;
+  }
+
+  /// @brief 結果をキャッシュに登録する
+  ///
+  /// 既に登録されている場合は何もしない。
+  /// シャードの保持数が上限を超えた場合、最も長く参照されていない結果を追い出す。
+  /// メモリ予算を超えている場合も、登録した結果以外を同様に追い出す。
+  /// @arg @c generation 解析に利用した ActiveFilter の世代番号
+  /// @arg @c sentence   文
+  /// @arg @c nodes      解析結果
+  void ParseCache::put(unsigned long generation, const std::string& sentence, const std::vector<Node>& nodes) {
+    if (this->shard_capacity == 0) return;
+    const Key key(generation, sentence);
+    Shard& shard = shardFor(key);
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (shard.index.find(key) != shard.index.end()) return;
+    }
+    // 複製と見積もりはロックの外で行う
+    LruList entry;
+    entry.push_back(Entry(key, nodes));
+    const size_t bytes = estimateEntrySize(entry.front());
+    entry.front().bytes = bytes;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.index.find(key) != shard.index.end()) return;
+    shard.lru.splice(shard.lru.begin(), entry);
+    shard.index[key] = shard.lru.begin();
+    shard.bytes += bytes;
+    if (this->budget) this->budget->charge(bytes);
+    while (shard.lru.size() > this->shard_capacity) this->evictOldest(shard);
+    if (this->budget) {
+      while (shard.lru.size() > 1 && this->budget->isExceeded()) this->evictOldest(shard);
+    }
+  }
+
+  /// @brief キャッシュを空にする
+  void ParseCache::clear(void) {
+    for (int i = 0; i < PARSE_CACHE_SHARDS; i++) {
+      Shard& shard = shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.lru.clear();
+      shard.index.clear();
+      if (this->budget) this->budget->release(shard.bytes);
+      shard.bytes = 0;
+    }
+  }
+
+  /// @brief 利用状況を取得する
+  /// @return 全シャードの合計
+  ParseCache::Stats ParseCache::getStats(void) {
+    Stats stats;
+    for (int i = 0; i < PARSE_CACHE_SHARDS; i++) {
+      Shard& shard = shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      stats.size += shard.lru.size();
+      stats.bytes += shard.bytes;
+    }
+    stats.capacity = this->shard_capacity * PARSE_CACHE_SHARDS;
+    return stats;
+  }
+}
@@ -0,0 +1,170 @@
+///
+/// @file
+/// @brief ラティス表現からスコアの高いパスをビームサーチで求める PathSearch の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include <algorithm>
+#include "PathSearch.h"
+
+namespace geonlp
+{
+  /// @brief 探索中の途中経過
+  struct PathSearch::State {
+    int score;    ///< 確定したスコア
+    int step;     ///< 最後の選択、何も選んでいない場合は -1
+    std::vector<std::pair<size_t, size_t> > head;  ///< 先頭から最大 nlookup 個の地名語・住所ノード
+    std::pair<size_t, size_t> last;                ///< 最後の地名語・住所ノード
+    int geo_count;                                 ///< 地名語・住所ノードの数
+    std::vector<std::pair<int, int> > classes;     ///< 固有名クラスの番号と出現回数、番号順
+
+    State(): score(0), step(-1), geo_count(0) {}
+  };
+
+  /// @brief 途中経過をスコアの降順に並べる
+  bool PathSearch::isBetterState(const State* a, const State* b)
+  {
+    return a->score > b->score;
+  }
+
+  /// @brief 記憶したスコアを利用してノード間のスコアを得る
+  /// @arg @c node0 (位置, 候補の番号) で表した前のノード
+  /// @arg @c node1 (位置, 候補の番号) で表した後のノード
+  int PathSearch::relationScore(const std::pair<size_t, size_t>& node0, const std::pair<size_t, size_t>& node1)
+  {
+    std::pair<std::pair<size_t, size_t>, std::pair<size_t, size_t> > key(node0, node1);
+    std::map<std::pair<std::pair<size_t, size_t>, std::pair<size_t, size_t> >, int>::const_iterator it = this->relation_memo.find(key);
+    if (it != this->relation_memo.end()) return (*it).second;
+    int score = this->relation(node0.first, node0.second, node1.first, node1.second);
+    this->relation_memo[key] = score;
+    return score;
+  }
+
+  /// @brief 途中経過にノードを追加する
+  ///
+  /// 隣り合う地名語・住所ノードの組と、先頭の地名語・住所ノードとの組のスコアはここで加算する。
+  /// @arg @c state 途中経過
+  /// @arg @c pos   追加するノードの位置
+  /// @arg @c index 追加するノードの候補の番号
+  /// @arg @c ret   [out] ノードを追加した途中経過
+  void PathSearch::extend(const State& state, size_t pos, size_t index, State& ret)
+  {
+    const PathNode& node = this->lattice[pos][index];
+    ret = state;
+    Step step = { pos, index, state.step };
+    ret.step = int(this->steps.size());
+    this->steps.push_back(step);
+
+    if (node.type == PathNode::NORMAL) {
+      ret.score += 1;
+      return;
+    }
+
+    if (node.type == PathNode::ADDRESS) {
+      ret.score += 10 * node.address_levels;
+    } else if (node.ne_class >= 0) {
+      // 2 回目の出現で 2 回分、 3 回目以降は 1 回分を加算する
+      std::vector<std::pair<int, int> >::iterator it =
+        std::lower_bound(ret.classes.begin(), ret.classes.end(), std::make_pair(node.ne_class, 0));
+      if (it != ret.classes.end() && (*it).first == node.ne_class) {
+        ret.score += ((*it).second == 1) ? 20 : 10;
+        (*it).second++;
+      } else {
+        ret.classes.insert(it, std::make_pair(node.ne_class, 1));
+      }
+    }
+
+    const std::pair<size_t, size_t> cur(pos, index);
+    const int k = ret.geo_count;
+    if (k >= 1) ret.score += this->relationScore(ret.last, cur);
+    if (k >= 2 && k <= this->nlookup) ret.score += this->relationScore(ret.head[0], cur);
+    if (int(ret.head.size()) < std::max(this->nlookup, 1)) ret.head.push_back(cur);
+    ret.last = cur;
+    ret.geo_count++;
+  }
+
+  /// @brief パスの末尾で、残りの組の関係によるスコアを計算する
+  ///
+  /// 地名語・住所ノードの数が nlookup 以下の場合、先頭のノードとの組を数えた残りの組数だけ
+  /// 二番目以降のノードから順に組を数える。隣り合う組は加算済みなので除く。
+  /// @arg @c state 末尾まで延ばした途中経過
+  /// @return 加算するスコア
+  int PathSearch::finalScore(const State& state)
+  {
+    const int g = state.geo_count;
+    int remains = this->nlookup - (g - 1);
+    if (g <= 2 || remains <= 0) return 0;
+    int score = 0;
+    for (int i = 1; i < g - 1 && remains > 0; i++) {
+      for (int j = i + 1; j < g && remains > 0; j++, remains--) {
+        if (j != i + 1) score += this->relationScore(state.head[i], state.head[j]);
+      }
+    }
+    return score;
+  }
+
+  /// @brief スコアの高いパスを求める
+  ///
+  /// 同点のパスは探索した順（先頭に近い位置で番号の小さい候補を選んだ順）に並べる。
+  /// @arg @c max_results 求めるパスの最大数
+  /// @arg @c results     [out] スコアの降順に並べたパス
+  void PathSearch::search(size_t max_results, std::vector<PathResult>& results)
+  {
+    results.clear();
+    this->steps.clear();
+    this->relation_memo.clear();
+    const size_t n = this->lattice.size();
+    if (n == 0 || max_results == 0) return;
+
+    // 位置ごとに、その位置から次のノードを選ぶ途中経過を集める
+    std::vector<std::vector<State> > beams(n + 1);
+    beams[0].push_back(State());
+    std::vector<const State*> order;
+    for (size_t pos = 0; pos < n; pos++) {
+      std::vector<State>& beam = beams[pos];
+      if (beam.empty()) continue;
+      if (this->lattice[pos].empty()) {
+        // 候補の無い位置は読み飛ばす
+        beams[pos + 1].insert(beams[pos + 1].end(), beam.begin(), beam.end());
+        std::vector<State>().swap(beam);
+        continue;
+      }
+      order.clear();
+      for (std::vector<State>::const_iterator it = beam.begin(); it != beam.end(); it++) order.push_back(&(*it));
+      std::stable_sort(order.begin(), order.end(), PathSearch::isBetterState);
+      if (order.size() > this->beam_width) order.resize(this->beam_width);
+
+      for (std::vector<const State*>::const_iterator it = order.begin(); it != order.end(); it++) {
+        for (size_t index = 0; index < this->lattice[pos].size(); index++) {
+          size_t next = this->lattice[pos][index].next;
+          if (next <= pos) next = pos + 1;
+          if (next > n) next = n;
+          State extended;
+          this->extend(*(*it), pos, index, extended);
+          beams[next].push_back(extended);
+        }
+      }
+      std::vector<State>().swap(beam);
+    }
+
+    std::vector<State>& finals = beams[n];
+    for (std::vector<State>::iterator it = finals.begin(); it != finals.end(); it++) {
+      (*it).score += this->finalScore(*it);
+    }
+    order.clear();
+    for (std::vector<State>::const_iterator it = finals.begin(); it != finals.end(); it++) order.push_back(&(*it));
+    std::stable_sort(order.begin(), order.end(), PathSearch::isBetterState);
+    if (order.size() > max_results) order.resize(max_results);
+
+    for (std::vector<const State*>::const_iterator it = order.begin(); it != order.end(); it++) {
+      PathResult result;
+      result.score = (*it)->score;
+      for (int s = (*it)->step; s >= 0; s = this->steps[s].parent) {
+        result.nodes.push_back(std::make_pair(this->steps[s].pos, this->steps[s].index));
+      }
+      std::reverse(result.nodes.begin(), result.nodes.end());
+      results.push_back(result);
+    }
+  }
+}
@@ -136,6 +136,66 @@ namespace geonlp {
       if (log_dir.empty()) log_dir = "";
       else if (log_dir.at(log_dir.length() - 1) != '/') log_dir += "/";
 
+      // darts_mmap
+      // darts ファイルを mmap で開くかどうか（false の場合はメモリに読み込む）
+      darts_mmap = prop.get<bool>("darts_mmap", true);
+
+      // geoword_cache_size
+      // 地名語キャッシュの最大保持数（0 の場合はキャッシュしない）
+      geoword_cache_size = prop.get<size_t>("geoword_cache_size", GEOWORD_CACHE_SIZE);
+
+      // parse_cache_size
+      // 解析結果を記憶する文の最大数（0 の場合は記憶しない）
+      parse_cache_size = prop.get<size_t>("parse_cache_size", 0);
+
+      // index_build_threads
+      // インデックス構築時に地名語を解析するスレッド数（0 の場合は CPU 数）
+      index_build_threads = prop.get<unsigned int>("index_build_threads", 1);
+
+      // index_build_memory
+      // インデックス構築時にメモリ上に保持する見出し語の上限 MB（0 の場合は無制限）
+      index_build_memory = prop.get<size_t>("index_build_memory", 0);
+
+      // import_threads
+      // 辞書 CSV の読み込み時に地名語を変換するスレッド数（0 の場合は CPU 数）
+      import_threads = prop.get<unsigned int>("import_threads", 1);
+
+      // import_fast
+      // 辞書の読み込み中はジャーナルと同期書き込みを止めるかどうか
+      import_fast = prop.get<bool>("import_fast", false);
+
+      // geoword_record
+      // 地名語の主要項目をバイナリレコードとしても保存するかどうか
+      geoword_record = prop.get<bool>("geoword_record", false);
+
+      // bundle
+      // 参照に利用する辞書バンドルファイル（空の場合は SQLite を参照する）
+      bundle = prop.get<std::string>("bundle", "");
+
+      // stats
+      // 処理ごとの呼び出し回数や時間を計測するかどうか
+      stats = prop.get<bool>("stats", false);
+
+      // read_only
+      // DB を変更しない参照専用のファイルとして開くかどうか
+      read_only = prop.get<bool>("read_only", false);
+
+      // in_memory
+      // DB ファイルの内容をメモリに読み込んで参照するかどうか（参照専用になる）
+      in_memory = prop.get<bool>("in_memory", false);
+
+      // sqlite_mmap_size
+      // 参照専用の場合に SQLite が mmap する大きさ MB（0 の場合は mmap しない）
+      sqlite_mmap_size = prop.get<size_t>("sqlite_mmap_size", SQLITE_MMAP_SIZE);
+
+      // sqlite_cache_size
+      // 参照専用の場合の SQLite のページキャッシュの大きさ MB
+      sqlite_cache_size = prop.get<size_t>("sqlite_cache_size", SQLITE_CACHE_SIZE);
+
+      // memory_budget
+      // キャッシュと SQLite が共有するメモリ予算 MB（0 の場合は制限しない）
+      memory_budget = prop.get<size_t>("memory_budget", 0);
+
 #ifdef HAVE_LIBDAMS
       // dams_path
       dams_path = prop.get<std::string>("dams_path", "");
@@ -190,6 +250,12 @@ namespace geonlp {
         boost::split(spatial, spatial_str, boost::is_any_of("|"));
       }
 
+      // formatter
+      v = options.get("formatter");
+      if (v.is<std::string>()) {
+        formatter = v.get<std::string>();
+      }
+
       // non_geoword
       v = options.get("non_geoword");
       if (v.is<std::string>()) {
@@ -220,6 +286,120 @@ namespace geonlp {
         else if (log_dir.at(log_dir.length() - 1) != '/') log_dir += "/";
       }
 
+      // darts_mmap
+      v = options.get("darts_mmap");
+      if (v.is<bool>()) {
+        darts_mmap = v.get<bool>();
+      }
+
+      // geoword_cache_size
+      v = options.get("geoword_cache_size");
+      if (v.is<long>()) {
+        if (v.get<long>() < 0) {
+          throw std::runtime_error("'geoword_cache_size' must not be negative.");
+        }
+        geoword_cache_size = size_t(v.get<long>());
+      }
+
+      // parse_cache_size
+      v = options.get("parse_cache_size");
+      if (v.is<long>()) {
+        if (v.get<long>() < 0) {
+          throw std::runtime_error("'parse_cache_size' must not be negative.");
+        }
+        parse_cache_size = size_t(v.get<long>());
+      }
+
+      // index_build_threads
+      v = options.get("index_build_threads");
+      if (v.is<long>()) {
+        if (v.get<long>() < 0) {
+          throw std::runtime_error("'index_build_threads' must not be negative.");
+        }
+        index_build_threads = (unsigned int)(v.get<long>());
+      }
+
+      // index_build_memory
+      v = options.get("index_build_memory");
+      if (v.is<long>()) {
+        if (v.get<long>() < 0) {
+          throw std::runtime_error("'index_build_memory' must not be negative.");
+        }
+        index_build_memory = size_t(v.get<long>());
+      }
+
+      // import_threads
+      v = options.get("import_threads");
+      if (v.is<long>()) {
+        if (v.get<long>() < 0) {
+          throw std::runtime_error("'import_threads' must not be negative.");
+        }
+        import_threads = (unsigned int)(v.get<long>());
+      }
+
+      // import_fast
+      v = options.get("import_fast");
+      if (v.is<bool>()) {
+        import_fast = v.get<bool>();
+      }
+
+      // geoword_record
+      v = options.get("geoword_record");
+      if (v.is<bool>()) {
+        geoword_record = v.get<bool>();
+      }
+
+      // bundle
+      v = options.get("bundle");
+      if (v.is<std::string>()) {
+        bundle = v.get<std::string>();
+      }
+
+      // stats
+      v = options.get("stats");
+      if (v.is<bool>()) {
+        stats = v.get<bool>();
+      }
+
+      // read_only
+      v = options.get("read_only");
+      if (v.is<bool>()) {
+        read_only = v.get<bool>();
+      }
+
+      // in_memory
+      v = options.get("in_memory");
+      if (v.is<bool>()) {
+        in_memory = v.get<bool>();
+      }
+
+      // sqlite_mmap_size
+      v = options.get("sqlite_mmap_size");
+      if (v.is<long>()) {
+        if (v.get<long>() < 0) {
+          throw std::runtime_error("'sqlite_mmap_size' must not be negative.");
+        }
+        sqlite_mmap_size = size_t(v.get<long>());
+      }
+
+      // sqlite_cache_size
+      v = options.get("sqlite_cache_size");
+      if (v.is<long>()) {
+        if (v.get<long>() < 0) {
+          throw std::runtime_error("'sqlite_cache_size' must not be negative.");
+        }
+        sqlite_cache_size = size_t(v.get<long>());
+      }
+
+      // memory_budget
+      v = options.get("memory_budget");
+      if (v.is<long>()) {
+        if (v.get<long>() < 0) {
+          throw std::runtime_error("'memory_budget' must not be negative.");
+        }
+        memory_budget = size_t(v.get<long>());
+      }
+
       // system_dic_dir
       v = options.get("system_dic_dir");
       if (v.is<std::string>()) {
@@ -287,6 +467,51 @@ namespace geonlp {
 
     // system_dic_dir
     this->system_dic_dir = "";
+
+    // darts_mmap
+    this->darts_mmap = true;
+
+    // geoword_cache_size
+    this->geoword_cache_size = GEOWORD_CACHE_SIZE;
+
+    // parse_cache_size
+    this->parse_cache_size = 0;
+
+    // index_build_threads
+    this->index_build_threads = 1;
+
+    // index_build_memory
+    this->index_build_memory = 0;
+
+    // import_threads
+    this->import_threads = 1;
+
+    // import_fast
+    this->import_fast = false;
+
+    // geoword_record
+    this->geoword_record = false;
+
+    // bundle
+    this->bundle = "";
+
+    // stats
+    this->stats = false;
+
+    // read_only
+    this->read_only = false;
+
+    // in_memory
+    this->in_memory = false;
+
+    // sqlite_mmap_size
+    this->sqlite_mmap_size = SQLITE_MMAP_SIZE;
+
+    // sqlite_cache_size
+    this->sqlite_cache_size = SQLITE_CACHE_SIZE;
+
+    // memory_budget
+    this->memory_budget = 0;
   }
 
 }
@@ -0,0 +1,365 @@
+///
+/// @file
+/// @brief 地名語の経緯度で空間検索する SpatialIndex と検索範囲 GeoRegion の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "SpatialIndex.h"
+#include "BinaryFile.h"
+#include "Exception.h"
+#include "MemoryBudget.h"
+
+namespace geonlp
+{
+  /// 空間インデックスファイルの先頭の識別子
+  const char SPATIAL_INDEX_MAGIC[8] = { 'G', 'E', 'O', 'N', 'L', 'P', 'S', '\0' };
+
+  /// @brief 地名語の緯度、経度の文字列を数値に変換する
+  /// @arg @c latitude  緯度の文字列
+  /// @arg @c longitude 経度の文字列
+  /// @arg @c lat       [out] 緯度
+  /// @arg @c lon       [out] 経度
+  /// @return 両方とも範囲内の数値の場合は true
+  bool parseLatLon(const std::string& latitude, const std::string& longitude, double& lat, double& lon)
+  {
+    if (latitude.empty() || longitude.empty()) return false;
+    char* end;
+    lat = strtod(latitude.c_str(), &end);
+    if (end == latitude.c_str() || *end != '\0') return false;
+    lon = strtod(longitude.c_str(), &end);
+    if (end == longitude.c_str() || *end != '\0') return false;
+    return lat >= -90.0 && lat <= 90.0 && lon >= -180.0 && lon <= 180.0;
+  }
+
+  /// @brief GeoJSON の座標配列からリングを読み込み、外接矩形を広げる
+  /// @arg @c coordinates [[経度, 緯度], ...] の配列
+  /// @arg @c polygon     [out] リングを追加するポリゴン
+  /// @exception ServiceRequestFormatException 座標配列の形式が正しくない
+  void GeoRegion::addRing(const picojson::value& coordinates, std::vector<Ring>& polygon)
+  {
+    if (!coordinates.is<picojson::array>()) throw ServiceRequestFormatException("The linear ring of the polygon must be an array.");
+    const picojson::array& positions = coordinates.get<picojson::array>();
+    Ring ring;
+    for (picojson::array::const_iterator it = positions.begin(); it != positions.end(); it++) {
+      if (!(*it).is<picojson::array>()) throw ServiceRequestFormatException("The position of the polygon must be an array.");
+      const picojson::array& position = (*it).get<picojson::array>();
+      if (position.size() < 2 || !position[0].is<double>() || !position[1].is<double>()) {
+        throw ServiceRequestFormatException("The position of the polygon must have longitude and latitude.");
+      }
+      double lon = position[0].get<double>();
+      double lat = position[1].get<double>();
+      if (this->max_lat < this->min_lat) {
+        this->min_lat = this->max_lat = lat;
+        this->min_lon = this->max_lon = lon;
+      } else {
+        this->min_lat = std::min(this->min_lat, lat);
+        this->max_lat = std::max(this->max_lat, lat);
+        this->min_lon = std::min(this->min_lon, lon);
+        this->max_lon = std::max(this->max_lon, lon);
+      }
+      ring.push_back(std::make_pair(lon, lat));
+    }
+    if (ring.size() < 3) throw ServiceRequestFormatException("The linear ring of the polygon must have at least 3 positions.");
+    polygon.push_back(ring);
+  }
+
+  /// @brief GeoJSON の座標配列からポリゴンを読み込む
+  /// @arg @c coordinates 外側のリングと内側のリングの配列
+  /// @exception ServiceRequestFormatException 座標配列の形式が正しくない
+  void GeoRegion::addPolygon(const picojson::value& coordinates)
+  {
+    if (!coordinates.is<picojson::array>()) throw ServiceRequestFormatException("The coordinates of the polygon must be an array.");
+    const picojson::array& rings = coordinates.get<picojson::array>();
+    if (rings.empty()) throw ServiceRequestFormatException("The polygon must have the exterior ring.");
+    std::vector<Ring> polygon;
+    for (picojson::array::const_iterator it = rings.begin(); it != rings.end(); it++) {
+      this->addRing(*it, polygon);
+    }
+    this->polygons.push_back(polygon);
+  }
+
+  /// @brief GeoJSON から範囲を設定する
+  ///
+  /// Polygon, MultiPolygon, GeometryCollection の geometry と、それを持つ Feature を受け付ける。
+  /// FeatureCollection は SpatialFilter と同じく最初の Feature の geometry を利用する。
+  /// @arg @c geojson GeoJSON をデコードした値
+  /// @exception ServiceRequestFormatException GeoJSON の形式が正しくない、または面を表さない
+  void GeoRegion::setGeoJSON(const picojson::value& geojson)
+  {
+    if (!geojson.is<picojson::object>() || !geojson.get("type").is<std::string>()) {
+      throw ServiceRequestFormatException("The geometry must be a GeoJSON object.");
+    }
+    const std::string& type = geojson.get("type").get<std::string>();
+    if (type == "FeatureCollection") {
+      const picojson::value& features = geojson.get("features");
+      if (!features.is<picojson::array>() || features.get<picojson::array>().empty()) {
+        throw ServiceRequestFormatException("The FeatureCollection has no features.");
+      }
+      this->setGeoJSON(features.get<picojson::array>()[0]);
+    } else if (type == "Feature") {
+      this->setGeoJSON(geojson.get("geometry"));
+    } else if (type == "GeometryCollection") {
+      const picojson::value& geometries = geojson.get("geometries");
+      if (!geometries.is<picojson::array>()) throw ServiceRequestFormatException("The GeometryCollection has no geometries.");
+      const picojson::array& members = geometries.get<picojson::array>();
+      for (picojson::array::const_iterator it = members.begin(); it != members.end(); it++) {
+        this->setGeoJSON(*it);
+      }
+    } else if (type == "Polygon") {
+      this->addPolygon(geojson.get("coordinates"));
+    } else if (type == "MultiPolygon") {
+      const picojson::value& coordinates = geojson.get("coordinates");
+      if (!coordinates.is<picojson::array>()) throw ServiceRequestFormatException("The coordinates of the MultiPolygon must be an array.");
+      const picojson::array& members = coordinates.get<picojson::array>();
+      for (picojson::array::const_iterator it = members.begin(); it != members.end(); it++) {
+        this->addPolygon(*it);
+      }
+    } else {
+      throw ServiceRequestFormatException(std::string("The geometry type '") + type + "' is not a Polygon or MultiPolygon.");
+    }
+  }
+
+  /// @brief 点が範囲に含まれるかどうか
+  ///
+  /// ポリゴンごとに全てのリングとの交差回数を数え、奇数ならば含まれるとする。
+  /// @arg @c lat 緯度
+  /// @arg @c lon 経度
+  /// @return いずれかのポリゴンに含まれる場合は true
+  bool GeoRegion::contains(double lat, double lon) const
+  {
+    if (lat < this->min_lat || lat > this->max_lat || lon < this->min_lon || lon > this->max_lon) return false;
+    for (std::vector<std::vector<Ring> >::const_iterator it = this->polygons.begin(); it != this->polygons.end(); it++) {
+      bool inside = false;
+      for (std::vector<Ring>::const_iterator ring = (*it).begin(); ring != (*it).end(); ring++) {
+        const Ring& r = *ring;
+        for (size_t i = 0, j = r.size() - 1; i < r.size(); j = i++) {
+          if ((r[i].second > lat) != (r[j].second > lat)
+              && lon < (r[j].first - r[i].first) * (lat - r[i].second) / (r[j].second - r[i].second) + r[i].first) {
+            inside = !inside;
+          }
+        }
+      }
+      if (inside) return true;
+    }
+    return false;
+  }
+
+  /// @brief 固有名クラスの番号を得る、新しいクラスの場合は番号を割り当てる
+  /// @arg @c ne_class 固有名クラス
+  /// @return 固有名クラスの番号
+  unsigned int SpatialIndex::internClass(const std::string& ne_class)
+  {
+    std::map<std::string, unsigned int>::const_iterator it = this->class_ids.find(ne_class);
+    if (it != this->class_ids.end()) return (*it).second;
+    unsigned int id = this->classes.size();
+    this->classes.push_back(ne_class);
+    this->class_ids.insert(std::make_pair(ne_class, id));
+    return id;
+  }
+
+  /// @brief 経度で比較する
+  static bool _lessLongitude(const SpatialPoint& a, const SpatialPoint& b) { return a.longitude < b.longitude; }
+
+  /// @brief 緯度で比較する
+  static bool _lessLatitude(const SpatialPoint& a, const SpatialPoint& b) { return a.latitude < b.latitude; }
+
+  /// @brief [begin, end) の地点を k-d 木の順に並べる
+  ///
+  /// 中央の要素を節とし、深さが偶数の節は経度、奇数の節は緯度で左右に分ける。
+  void SpatialIndex::buildTree(size_t begin, size_t end, unsigned int depth)
+  {
+    if (end - begin <= 1) return;
+    size_t mid = begin + (end - begin) / 2;
+    std::nth_element(this->points.begin() + begin, this->points.begin() + mid, this->points.begin() + end,
+      (depth % 2 == 0) ? _lessLongitude : _lessLatitude);
+    this->buildTree(begin, mid, depth + 1);
+    this->buildTree(mid + 1, end, depth + 1);
+  }
+
+  /// @brief k-d 木と地名語IDの添字を構築する
+  void SpatialIndex::build(void)
+  {
+    this->buildTree(0, this->points.size(), 0);
+    std::vector<std::pair<std::string, unsigned int> > ids;
+    ids.reserve(this->points.size());
+    for (size_t i = 0; i < this->points.size(); i++) {
+      ids.push_back(std::make_pair(this->points[i].geonlp_id, (unsigned int)i));
+    }
+    std::sort(ids.begin(), ids.end());
+    this->id_order.resize(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) this->id_order[i] = ids[i].second;
+  }
+
+  /// @brief k-d 木の [begin, end) をたどって矩形に含まれる地点を集める
+  void SpatialIndex::searchTree(size_t begin, size_t end, unsigned int depth,
+    double min_lat, double min_lon, double max_lat, double max_lon,
+    std::vector<const SpatialPoint*>& ret) const
+  {
+    while (begin < end) {
+      size_t mid = begin + (end - begin) / 2;
+      const SpatialPoint& p = this->points[mid];
+      if (p.latitude >= min_lat && p.latitude <= max_lat && p.longitude >= min_lon && p.longitude <= max_lon
+          && (this->stale_dictionaries.empty() || this->stale_dictionaries.count(p.dictionary_id) == 0)) {
+        ret.push_back(&p);
+      }
+      double v = (depth % 2 == 0) ? p.longitude : p.latitude;
+      double lo = (depth % 2 == 0) ? min_lon : min_lat;
+      double hi = (depth % 2 == 0) ? max_lon : max_lat;
+      // 右の部分木はループで、左の部分木は再帰でたどる
+      if (lo <= v) this->searchTree(begin, mid, depth + 1, min_lat, min_lon, max_lat, max_lon, ret);
+      if (v > hi) break;
+      begin = mid + 1;
+      depth++;
+    }
+  }
+
+  /// @brief 矩形に含まれる地点を取得する
+  ///
+  /// 差分更新で変更された辞書の地点は含まない。
+  /// @arg @c min_lat 南端の緯度
+  /// @arg @c min_lon 西端の経度
+  /// @arg @c max_lat 北端の緯度
+  /// @arg @c max_lon 東端の経度
+  /// @arg @c ret     [out] 地点へのポインタのリスト、順序は不定
+  void SpatialIndex::searchBox(double min_lat, double min_lon, double max_lat, double max_lon, std::vector<const SpatialPoint*>& ret) const
+  {
+    ret.clear();
+    if (min_lat > max_lat || min_lon > max_lon) return;
+    this->searchTree(0, this->points.size(), 0, min_lat, min_lon, max_lat, max_lon, ret);
+  }
+
+  /// @brief 地名語IDから地点を取得する
+  /// @arg @c geonlp_id 地名語ID
+  /// @return 地点、インデックスに無い場合や差分更新で変更された辞書の場合は NULL
+  const SpatialPoint* SpatialIndex::findPoint(const std::string& geonlp_id) const
+  {
+    size_t lo = 0, hi = this->id_order.size();
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (this->points[this->id_order[mid]].geonlp_id < geonlp_id) lo = mid + 1;
+      else hi = mid;
+    }
+    if (lo == this->id_order.size()) return NULL;
+    const SpatialPoint& p = this->points[this->id_order[lo]];
+    if (p.geonlp_id != geonlp_id) return NULL;
+    if (!this->stale_dictionaries.empty() && this->stale_dictionaries.count(p.dictionary_id) > 0) return NULL;
+    return &p;
+  }
+
+  /// @brief 確保しているメモリのバイト数を見積もる
+  ///
+  /// 地点と地名語IDの配列、地名語IDの文字列、固有名クラス、差分更新で変更された辞書を数える。
+  /// std::map, std::set の要素は 1 件あたり要素とポインタ 4 個分とする。
+  /// @return 推定バイト数
+  size_t SpatialIndex::estimateMemorySize(void) const
+  {
+    size_t bytes = sizeof(SpatialIndex);
+    bytes += this->points.capacity() * sizeof(SpatialPoint);
+    for (std::vector<SpatialPoint>::const_iterator it = this->points.begin(); it != this->points.end(); it++) {
+      bytes += stringMemorySize((*it).geonlp_id);
+    }
+    bytes += this->id_order.capacity() * sizeof(unsigned int);
+    bytes += this->classes.capacity() * sizeof(std::string);
+    for (std::vector<std::string>::const_iterator it = this->classes.begin(); it != this->classes.end(); it++) {
+      bytes += stringMemorySize(*it);
+    }
+    bytes += this->class_ids.size() * (sizeof(std::pair<const std::string, unsigned int>) + 4 * sizeof(void*));
+    bytes += this->stale_dictionaries.size() * (sizeof(int) + 4 * sizeof(void*));
+    return bytes;
+  }
+
+  /// @brief ファイルに保存する
+  ///
+  /// build() で並べた順に保存するので、読み込む際に木を構築し直す必要はない。
+  /// バイト順はホストのものを使う。 darts ファイルと同じく、作成したホストで読み込むこと。
+  /// @arg @c filename 保存するファイル名
+  /// @exception DartsException ファイルに書き込めない
+  void SpatialIndex::save(const std::string& filename) const
+  {
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (fp == NULL) throw DartsException(std::string("Cannot save spatial index to '") + filename + "'.");
+    FileCloser closer(fp);
+
+    fwrite(SPATIAL_INDEX_MAGIC, 1, sizeof(SPATIAL_INDEX_MAGIC), fp);
+    writeUint32(fp, SPATIAL_INDEX_VERSION);
+    writeUint32(fp, this->classes.size());
+    for (std::vector<std::string>::const_iterator it = this->classes.begin(); it != this->classes.end(); it++) {
+      writeString(fp, *it);
+    }
+    writeUint32(fp, this->points.size());
+    for (std::vector<SpatialPoint>::const_iterator it = this->points.begin(); it != this->points.end(); it++) {
+      writeDouble(fp, (*it).latitude);
+      writeDouble(fp, (*it).longitude);
+      writeUint32(fp, uint32_t((*it).dictionary_id));
+      writeUint32(fp, (*it).ne_class);
+      writeString(fp, (*it).geonlp_id);
+      writeUint32(fp, uint32_t((*it).valid_from));
+      writeUint32(fp, uint32_t((*it).valid_to));
+    }
+    for (std::vector<unsigned int>::const_iterator it = this->id_order.begin(); it != this->id_order.end(); it++) {
+      writeUint32(fp, *it);
+    }
+    if (ferror(fp)) throw DartsException(std::string("Cannot save spatial index to '") + filename + "'.");
+  }
+
+  /// @brief ファイルから読み込む
+  /// @arg @c filename 空間インデックスファイル名
+  /// @return ファイルが存在しない場合は false
+  /// @exception DartsException ファイルの形式が正しくない
+  bool SpatialIndex::load(const std::string& filename)
+  {
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (fp == NULL) return false;
+    FileCloser closer(fp);
+    const std::string errmsg = std::string("Spatial index '") + filename + "' is broken.";
+
+    char magic[sizeof(SPATIAL_INDEX_MAGIC)];
+    uint32_t version, num_classes, num_points;
+    if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || memcmp(magic, SPATIAL_INDEX_MAGIC, sizeof(magic)) != 0
+        || !readUint32(fp, version)) {
+      throw DartsException(errmsg);
+    }
+    if (version != SPATIAL_INDEX_VERSION && version != SPATIAL_INDEX_VERSION_V1) {
+      throw DartsException(std::string("The format version of spatial index '") + filename + "' is not supported.");
+    }
+
+    this->has_periods = (version != SPATIAL_INDEX_VERSION_V1);
+
+    if (!readUint32(fp, num_classes)) throw DartsException(errmsg);
+    this->classes.resize(num_classes);
+    for (uint32_t i = 0; i < num_classes; i++) {
+      if (!readString(fp, this->classes[i])) throw DartsException(errmsg);
+    }
+
+    if (!readUint32(fp, num_points)) throw DartsException(errmsg);
+    this->points.clear();
+    this->points.resize(num_points);
+    for (uint32_t i = 0; i < num_points; i++) {
+      SpatialPoint& p = this->points[i];
+      uint32_t dictionary_id;
+      if (!readDouble(fp, p.latitude) || !readDouble(fp, p.longitude) || !readUint32(fp, dictionary_id)
+          || !readUint32(fp, p.ne_class) || p.ne_class >= num_classes || !readString(fp, p.geonlp_id)) {
+        throw DartsException(errmsg);
+      }
+      p.dictionary_id = int(dictionary_id);
+      if (version != SPATIAL_INDEX_VERSION_V1) {
+        uint32_t valid_from, valid_to;
+        if (!readUint32(fp, valid_from) || !readUint32(fp, valid_to)) throw DartsException(errmsg);
+        p.valid_from = int(valid_from);
+        p.valid_to = int(valid_to);
+      }
+    }
+    this->id_order.resize(num_points);
+    for (uint32_t i = 0; i < num_points; i++) {
+      uint32_t index;
+      if (!readUint32(fp, index) || index >= num_points) throw DartsException(errmsg);
+      this->id_order[i] = index;
+    }
+    return true;
+  }
+
+}
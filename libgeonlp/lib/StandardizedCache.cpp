@@ -0,0 +1,111 @@
+///
+/// @file
+/// @brief 表記を標準化した文字列のキャッシュクラス StandardizedCache の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include "StandardizedCache.h"
+
+namespace geonlp
+{
+  /// @brief コンストラクタ
+  ///
+  /// 最大保持数はシャード数の倍数に切り上げる。
+  /// @arg @c capacity 最大保持数、0 の場合はキャッシュしない
+  StandardizedCache::StandardizedCache(size_t capacity): budget(NULL) {
+    this->shard_capacity = (capacity + STANDARDIZED_CACHE_SHARDS - 1) / STANDARDIZED_CACHE_SHARDS;
+  }
+
+  /// @brief 要素を保持する場合の推定バイト数
+  ///
+  /// 表記と標準化した文字列の大きさに加え、 LRU リストと索引の要素の大きさを含む。
+  /// @arg @c item 保持する要素
+  /// @return 推定バイト数
+  size_t StandardizedCache::estimateItemSize(const Item& item) {
+    return sizeof(Item) + 2 * sizeof(void*)               // LRU リストのノード
+      + sizeof(LruIndex::value_type) + 2 * sizeof(void*)  // 索引のノード
+      + stringMemorySize(item.surface) + stringMemorySize(item.standardized);
+  }
+
+  /// @brief シャードの最も長く参照されていない要素を追い出す
+  /// @arg @c shard シャード、ロックを取得済みであること
+  void StandardizedCache::evictOldest(Shard& shard) {
+    LruList::iterator it = shard.lru.end();
+    it--;
+    shard.index.erase((*it).surface);
+    shard.bytes -= (*it).bytes;
+    if (this->budget) this->budget->release((*it).bytes);
+    shard.lru.erase(it);
+  }
+
+  /// @brief 標準化した文字列をキャッシュから取得する
+  /// @arg @c surface 表記
+  /// @arg @c ret     [out] 標準化した文字列
+  /// @return 見つかった場合 true
+  bool StandardizedCache::get(const std::string& surface, std::string& ret) {
+    if (this->shard_capacity == 0) return false;
+    Shard& shard = shardFor(surface);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    LruIndex::iterator it = shard.index.find(surface);
+    if (it == shard.index.end()) return false;
+    // 最近参照されたものとして先頭に移動する
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    ret = (*(it->second)).standardized;
+    return true;
+  }
+
+  /// @brief 標準化した文字列をキャッシュに登録する
+  ///
+  /// 既に登録されている場合は何もしない。
+  /// シャードの保持数が上限を超えた場合、最も長く参照されていない要素を追い出す。
+  /// メモリ予算を超えている場合も、登録した要素以外を同様に追い出す。
+  /// @arg @c surface      表記
+  /// @arg @c standardized 標準化した文字列
+  void StandardizedCache::put(const std::string& surface, const std::string& standardized) {
+    if (this->shard_capacity == 0) return;
+    // 複製と見積もりはロックの外で行う
+    LruList item;
+    item.push_back(Item(surface, standardized));
+    const size_t bytes = estimateItemSize(item.front());
+    item.front().bytes = bytes;
+
+    Shard& shard = shardFor(surface);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.index.find(surface) != shard.index.end()) return;
+    shard.lru.splice(shard.lru.begin(), item);
+    shard.index[shard.lru.front().surface] = shard.lru.begin();
+    shard.bytes += bytes;
+    if (this->budget) this->budget->charge(bytes);
+    while (shard.lru.size() > this->shard_capacity) this->evictOldest(shard);
+    if (this->budget) {
+      while (shard.lru.size() > 1 && this->budget->isExceeded()) this->evictOldest(shard);
+    }
+  }
+
+  /// @brief キャッシュを空にする
+  void StandardizedCache::clear(void) {
+    for (int i = 0; i < STANDARDIZED_CACHE_SHARDS; i++) {
+      Shard& shard = shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.index.clear();
+      shard.lru.clear();
+      if (this->budget) this->budget->release(shard.bytes);
+      shard.bytes = 0;
+    }
+  }
+
+  /// @brief 利用状況を取得する
+  /// @return 全シャードの合計
+  StandardizedCache::Stats StandardizedCache::getStats(void) {
+    Stats stats;
+    for (int i = 0; i < STANDARDIZED_CACHE_SHARDS; i++) {
+      Shard& shard = shards[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      stats.size += shard.lru.size();
+      stats.bytes += shard.bytes;
+    }
+    stats.capacity = this->shard_capacity * STANDARDIZED_CACHE_SHARDS;
+    return stats;
+  }
+}
@@ -0,0 +1,64 @@
+///
+/// @file
+/// @brief 処理ごとの計測値を集計するクラス StatsCollector の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include "Stats.h"
+
+namespace geonlp
+{
+  /// @brief 処理の名前、 getAll() のキーとして利用する
+  const char* StatsCollector::getName(StatsCounter c)
+  {
+    static const char* names[NUM_STATS_COUNTERS] = {
+      "parse_node",
+      "mecab",
+      "phbs",
+      "darts",
+      "spatial",
+      "sqlite",
+      "json_decode",
+      "record_decode",
+      "geoword_cache",
+      "geoword_node_cache",
+      "parse_cache",
+      "python",
+    };
+    return (c >= 0 && c < NUM_STATS_COUNTERS) ? names[c] : "";
+  }
+
+  /// @brief 計測値を取得する
+  /// @arg @c c 処理の種類
+  /// @return 計測値
+  StatsEntry StatsCollector::get(StatsCounter c) const
+  {
+    StatsEntry e;
+    e.calls = values[c][CALLS].load(std::memory_order_relaxed);
+    e.ns = values[c][NS].load(std::memory_order_relaxed);
+    e.hits = values[c][HITS].load(std::memory_order_relaxed);
+    e.misses = values[c][MISSES].load(std::memory_order_relaxed);
+    e.rows = values[c][ROWS].load(std::memory_order_relaxed);
+    return e;
+  }
+
+  /// @brief 全ての計測値を処理の名前をキーとするマップとして取得する
+  /// @arg ret 処理の名前をキー、計測値を値とするマップ
+  void StatsCollector::getAll(std::map<std::string, StatsEntry>& ret) const
+  {
+    ret.clear();
+    for (int i = 0; i < NUM_STATS_COUNTERS; i++) {
+      StatsCounter c = StatsCounter(i);
+      ret[getName(c)] = this->get(c);
+    }
+  }
+
+  /// @brief 全ての計測値を 0 に戻す
+  void StatsCollector::reset(void)
+  {
+    for (int i = 0; i < NUM_STATS_COUNTERS; i++) {
+      for (int j = 0; j < NUM_FIELDS; j++) values[i][j].store(0, std::memory_order_relaxed);
+    }
+  }
+}
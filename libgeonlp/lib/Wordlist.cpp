@@ -0,0 +1,163 @@
+///
+/// @file
+/// @brief 見出し語IDに対応する地名語IDリストクラスWordListの実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include "Wordlist.h"
+
+/// バイナリ表現の形式バージョン
+#define WORDLIST_ENTRIES_FORMAT  3
+
+/// 有効期間を持たない古い形式のバージョン
+#define WORDLIST_ENTRIES_FORMAT_V2  2
+
+/// 表記のハッシュ値と有効期間を持たない古い形式のバージョン
+#define WORDLIST_ENTRIES_FORMAT_V1  1
+
+namespace
+{
+  // リトルエンディアンで整数を追加する
+  void append_le(std::string& out, unsigned long long v, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+      out.push_back(char((v >> (8 * i)) & 0xff));
+    }
+  }
+
+  // リトルエンディアンで整数を読み込む
+  unsigned long long read_le(const unsigned char* p, int bytes) {
+    unsigned long long v = 0;
+    for (int i = 0; i < bytes; i++) {
+      v |= ((unsigned long long)p[i]) << (8 * i);
+    }
+    return v;
+  }
+}
+
+namespace geonlp
+{
+  /// @brief デコード済みの地名語IDリストをDB保存用のバイナリ表現に変換する
+  ///
+  /// 形式は先頭 1 バイトのバージョン番号に続いて、要素ごとに
+  /// rowid (8バイト), 辞書ID (4バイト), geonlp_id の長さ (2バイト), geonlp_id,
+  /// 表記のハッシュ値の数 (2バイト), ハッシュ値 (各8バイト),
+  /// 有効期間の開始日と終了日 (各4バイト) を並べたもの。
+  /// 有効期間が不明な要素は開始日を -1 とする。
+  /// 整数はすべてリトルエンディアン。
+  /// @arg @c entries 地名語IDリスト
+  /// @arg @c blob    [out] バイナリ表現
+  void Wordlist::encodeEntries(const std::vector<WordlistEntry>& entries, std::string& blob) {
+    blob.clear();
+    blob.push_back(char(WORDLIST_ENTRIES_FORMAT));
+    for (std::vector<WordlistEntry>::const_iterator it = entries.begin(); it != entries.end(); it++) {
+      size_t len = (*it).geonlp_id.length();
+      if (len > 0xffff) len = 0xffff;
+      append_le(blob, (unsigned long long)(*it).rowid, 8);
+      append_le(blob, (unsigned long long)(unsigned int)(*it).dictionary_id, 4);
+      append_le(blob, len, 2);
+      blob.append((*it).geonlp_id, 0, len);
+      size_t n = (*it).surface_hashes.size();
+      if (n > 0xffff) n = 0; // 全てを記録できない場合は持たないものとする
+      append_le(blob, n, 2);
+      for (size_t i = 0; i < n; i++) append_le(blob, (*it).surface_hashes[i], 8);
+      append_le(blob, (unsigned long long)(unsigned int)((*it).has_period ? (*it).valid_from : -1), 4);
+      append_le(blob, (unsigned long long)(unsigned int)(*it).valid_to, 4);
+    }
+  }
+
+  /// @brief DB保存用のバイナリ表現から地名語IDリストを復元する
+  /// @arg @c blob    バイナリ表現の先頭
+  /// @arg @c size    バイナリ表現のバイト数
+  /// @arg @c entries [out] 地名語IDリスト
+  /// 有効期間を持たない古い形式（バージョン 2）、
+  /// 表記のハッシュ値も持たない古い形式（バージョン 1）も復元する。
+  /// @return 復元できた場合 true, 形式が正しくない場合は false（entries は空になる）
+  bool Wordlist::decodeEntries(const void* blob, size_t size, std::vector<WordlistEntry>& entries) {
+    const unsigned char* p = static_cast<const unsigned char*>(blob);
+    const unsigned char* end = p + size;
+    entries.clear();
+    if (p == NULL || size < 1) return false;
+    if (*p != WORDLIST_ENTRIES_FORMAT && *p != WORDLIST_ENTRIES_FORMAT_V2 && *p != WORDLIST_ENTRIES_FORMAT_V1) return false;
+    const bool has_hashes = (*p != WORDLIST_ENTRIES_FORMAT_V1);
+    const bool has_periods = (*p == WORDLIST_ENTRIES_FORMAT);
+    p++;
+    while (p < end) {
+      if (end - p < 14) {
+        entries.clear();
+        return false;
+      }
+      WordlistEntry entry;
+      entry.rowid = (long long)read_le(p, 8);
+      entry.dictionary_id = (int)(unsigned int)read_le(p + 8, 4);
+      size_t len = (size_t)read_le(p + 12, 2);
+      p += 14;
+      if (size_t(end - p) < len) {
+        entries.clear();
+        return false;
+      }
+      entry.geonlp_id.assign(reinterpret_cast<const char*>(p), len);
+      p += len;
+      if (has_hashes) {
+        if (end - p < 2) {
+          entries.clear();
+          return false;
+        }
+        size_t n = (size_t)read_le(p, 2);
+        p += 2;
+        if (size_t(end - p) < n * 8) {
+          entries.clear();
+          return false;
+        }
+        entry.surface_hashes.resize(n);
+        for (size_t i = 0; i < n; i++, p += 8) entry.surface_hashes[i] = read_le(p, 8);
+      }
+      if (has_periods) {
+        if (end - p < 8) {
+          entries.clear();
+          return false;
+        }
+        int from = (int)(unsigned int)read_le(p, 4);
+        int to = (int)(unsigned int)read_le(p + 4, 4);
+        p += 8;
+        if (from >= 0) entry.setPeriod(from, to);
+      }
+      entries.push_back(entry);
+    }
+    return true;
+  }
+
+  /// @brief 標準化した表記のハッシュ値を得る
+  ///
+  /// 見出し語の作成時にデータベースに保存し、形態素解析時に比較するため、
+  /// 処理系に依存しない FNV-1a (64ビット) を利用する。
+  /// @arg @c surface 標準化した表記
+  /// @return ハッシュ値
+  unsigned long long Wordlist::hashSurface(std::string_view surface) {
+    unsigned long long h = 14695981039346656037ULL;
+    for (std::string_view::const_iterator it = surface.begin(); it != surface.end(); it++) {
+      h ^= (unsigned long long)(unsigned char)(*it);
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  /// @brief geonlp_id:代表表記/geonlp_id:代表表記/... 形式の文字列から geonlp_id を取り出す
+  ///
+  /// ':' を含まない要素と geonlp_id が空の要素は無視する。
+  /// @arg @c idlist     地名語IDリスト文字列
+  /// @arg @c geonlp_ids [out] geonlp_id のリスト
+  void Wordlist::parseIdlist(const std::string& idlist, std::vector<std::string>& geonlp_ids) {
+    geonlp_ids.clear();
+    size_t pos = 0;
+    while (pos < idlist.length()) {
+      size_t next = idlist.find('/', pos);
+      if (next == std::string::npos) next = idlist.length();
+      size_t colon = idlist.find(':', pos);
+      if (colon != std::string::npos && colon < next && colon > pos) {
+        geonlp_ids.push_back(idlist.substr(pos, colon - pos));
+      }
+      pos = next + 1;
+    }
+  }
+}
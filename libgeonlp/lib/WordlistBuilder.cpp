@@ -0,0 +1,412 @@
+///
+/// @file
+/// @brief 見出し語一覧の構築クラス WordlistBuilder の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include <cstdio>
+#include <stdint.h>
+#include <algorithm>
+#include <queue>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include <boost/shared_ptr.hpp>
+#include <boost/filesystem.hpp>
+#include "config.h"
+#include "WordlistBuilder.h"
+#ifdef HAVE_LIBDAMS
+#include <dams.h>
+#endif /* HAVE_LIBDAMS */
+
+/// 併合の進捗を通知する間隔（レコード数）
+#define WORDLIST_MERGE_PROGRESS_INTERVAL  65536
+
+namespace geonlp
+{
+  /// @brief 見出し語, rowid, 地名語内の順序の順に比較する
+  bool operator<(const WordlistRecord& a, const WordlistRecord& b) {
+    int c = a.key.compare(b.key);
+    if (c != 0) return c < 0;
+    if (a.entry.rowid != b.entry.rowid) return a.entry.rowid < b.entry.rowid;
+    return a.seq < b.seq;
+  }
+
+  /// @brief 地名語の全ての表記と読みを見出し語レコードとして追加する
+  ///
+  /// 表記ごとに標準化した表記のレコードを、読みがある場合は続けて読みのレコードを追加する。
+  /// 全てのレコードの entry には、地名語の全ての表記を標準化した文字列のハッシュ値と有効期間を設定する。
+  /// @arg @c geo_in  地名語
+  /// @arg @c entry   地名語に対応する地名語IDリストの要素
+  /// @arg @c records [out] 見出し語レコードの追加先
+  void enumerateWordlistRecords(const Geoword& geo_in, const WordlistEntry& entry, std::vector<WordlistRecord>& records)
+  {
+    // 可能な全ての表記を登録
+    // 接頭辞、接尾辞が無い場合は "" が一つあるものとして扱う
+    picojson::string_list_view prefixes = geo_in.get_prefix_view();
+    picojson::string_list_view suffixes = geo_in.get_suffix_view();
+    picojson::string_list_view prefixes_kana = geo_in.get_prefix_kana_view();
+    picojson::string_list_view suffixes_kana = geo_in.get_suffix_kana_view();
+    const int n_prefix = prefixes.empty() ? 1 : int(prefixes.size());
+    const int n_suffix = suffixes.empty() ? 1 : int(suffixes.size());
+    const int n_prefix_kana = prefixes_kana.empty() ? 1 : int(prefixes_kana.size());
+    const int n_suffix_kana = suffixes_kana.empty() ? 1 : int(suffixes_kana.size());
+
+    const std::string_view body = geo_in.get_body_view();
+    const std::string_view body_kana = geo_in.get_body_kana_view();
+    const std::string id_name = entry.geonlp_id + ":" + geo_in.get_typical_name();
+    const size_t first = records.size();
+    std::vector<unsigned long long> hashes;
+    unsigned int seq = 0;
+    int i_suffix = 0;
+    for (int i_prefix = 0; i_prefix < n_prefix; i_prefix++) {
+      std::string_view prefix = prefixes.empty() ? std::string_view() : prefixes[i_prefix];
+      for (int j = 0; j < n_suffix; j++) {
+        std::string_view suffix = suffixes.empty() ? std::string_view() : suffixes[j];
+        std::string surface;
+        surface.reserve(prefix.length() + body.length() + suffix.length());
+        surface.append(prefix).append(body).append(suffix);
+        std::string yomi;
+        if (body_kana.length() > 0) {
+          if (i_prefix < n_prefix_kana && !prefixes_kana.empty()) yomi.append(prefixes_kana[i_prefix]);
+          yomi.append(body_kana);
+          if (i_suffix < n_suffix_kana && !suffixes_kana.empty()) yomi.append(suffixes_kana[i_suffix]);
+        }
+
+        records.push_back(WordlistRecord());
+        WordlistRecord& r = records.back();
+#ifdef HAVE_LIBDAMS
+        r.key = std::string(damswrapper::get_standardized_string(surface));
+#else
+        r.key = surface;
+#endif /* HAVE_LIBDAMS */
+        hashes.push_back(Wordlist::hashSurface(r.key));
+        r.surface = surface;
+        r.yomi = yomi;
+        r.id_name = id_name;
+        r.entry = entry;
+        r.seq = seq++;
+
+        if (yomi.length() > 0) {
+          records.push_back(WordlistRecord());
+          WordlistRecord& ry = records.back();
+          ry.key = yomi;
+          ry.surface = surface;
+          ry.yomi = yomi;
+          ry.id_name = id_name;
+          ry.entry = entry;
+          ry.seq = seq++;
+        }
+
+        i_suffix++;
+      }
+    }
+
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    int valid_from, valid_to;
+    geo_in.getValidPeriod(valid_from, valid_to);
+    for (size_t i = first; i < records.size(); i++) {
+      records[i].entry.surface_hashes = hashes;
+      records[i].entry.setPeriod(valid_from, valid_to);
+    }
+  }
+
+  /// @brief 地名語がその読みを持つかどうか
+  ///
+  /// enumerateWordlistRecords() が作る読みと比較する。
+  /// @arg @c geo_in  地名語
+  /// @arg @c yomi    読み
+  /// @return 地名語のいずれかの表記の読みが yomi と一致する場合 true
+  bool hasGeowordYomi(const Geoword& geo_in, const std::string& yomi)
+  {
+    if (yomi.empty()) return false;
+    std::vector<WordlistRecord> records;
+    enumerateWordlistRecords(geo_in, WordlistEntry(), records);
+    for (std::vector<WordlistRecord>::const_iterator it = records.begin(); it != records.end(); it++) {
+      if ((*it).yomi == yomi) return true;
+    }
+    return false;
+  }
+
+  /// @brief 長さ付きの文字列をランに書き出す
+  static void _writeString(FILE* fp, const std::string& str) {
+    uint32_t len = uint32_t(str.length());
+    if (fwrite(&len, sizeof(len), 1, fp) != 1 || (len > 0 && fwrite(str.data(), 1, len, fp) != len)) {
+      throw std::runtime_error("Cannot write a temporary file for building the index.");
+    }
+  }
+
+  /// @brief 長さ付きの文字列をランから読み込む
+  static bool _readString(FILE* fp, std::string& str) {
+    uint32_t len;
+    if (fread(&len, sizeof(len), 1, fp) != 1) return false;
+    str.resize(len);
+    if (len > 0 && fread(&str[0], 1, len, fp) != len) {
+      throw std::runtime_error("A temporary file for building the index is broken.");
+    }
+    return true;
+  }
+
+  /// @brief 見出し語レコードをランに書き出す
+  static void _writeRecord(FILE* fp, const WordlistRecord& r) {
+    _writeString(fp, r.key);
+    _writeString(fp, r.surface);
+    _writeString(fp, r.yomi);
+    _writeString(fp, r.id_name);
+    _writeString(fp, r.entry.geonlp_id);
+    int64_t rowid = r.entry.rowid;
+    int32_t dictionary_id = r.entry.dictionary_id;
+    uint32_t seq = r.seq;
+    uint32_t n_hashes = uint32_t(r.entry.surface_hashes.size());
+    int32_t valid_from = r.entry.has_period ? r.entry.valid_from : -1;
+    int32_t valid_to = r.entry.valid_to;
+    if (fwrite(&rowid, sizeof(rowid), 1, fp) != 1
+        || fwrite(&dictionary_id, sizeof(dictionary_id), 1, fp) != 1
+        || fwrite(&seq, sizeof(seq), 1, fp) != 1
+        || fwrite(&valid_from, sizeof(valid_from), 1, fp) != 1
+        || fwrite(&valid_to, sizeof(valid_to), 1, fp) != 1
+        || fwrite(&n_hashes, sizeof(n_hashes), 1, fp) != 1
+        || (n_hashes > 0 && fwrite(&r.entry.surface_hashes[0], sizeof(unsigned long long), n_hashes, fp) != n_hashes)) {
+      throw std::runtime_error("Cannot write a temporary file for building the index.");
+    }
+  }
+
+  /// @brief ランを先頭から順に読むクラス
+  class RunReader {
+  private:
+    FILE* fp;
+    RunReader(const RunReader&);
+    RunReader& operator=(const RunReader&);
+  public:
+    RunReader(const std::string& fname): fp(fopen(fname.c_str(), "rb")) {
+      if (fp == NULL) throw std::runtime_error(std::string("Cannot open a temporary file (") + fname + ")");
+    }
+    ~RunReader() { fclose(fp); }
+
+    /// @brief 次のレコードを読み込む、末尾に達した場合 false
+    bool next(WordlistRecord& r) {
+      if (!_readString(fp, r.key)) return false;
+      int64_t rowid;
+      int32_t dictionary_id;
+      uint32_t seq;
+      int32_t valid_from, valid_to;
+      uint32_t n_hashes;
+      if (!_readString(fp, r.surface) || !_readString(fp, r.yomi)
+          || !_readString(fp, r.id_name) || !_readString(fp, r.entry.geonlp_id)
+          || fread(&rowid, sizeof(rowid), 1, fp) != 1
+          || fread(&dictionary_id, sizeof(dictionary_id), 1, fp) != 1
+          || fread(&seq, sizeof(seq), 1, fp) != 1
+          || fread(&valid_from, sizeof(valid_from), 1, fp) != 1
+          || fread(&valid_to, sizeof(valid_to), 1, fp) != 1
+          || fread(&n_hashes, sizeof(n_hashes), 1, fp) != 1) {
+        throw std::runtime_error("A temporary file for building the index is broken.");
+      }
+      r.entry.surface_hashes.resize(n_hashes);
+      if (n_hashes > 0 && fread(&r.entry.surface_hashes[0], sizeof(unsigned long long), n_hashes, fp) != n_hashes) {
+        throw std::runtime_error("A temporary file for building the index is broken.");
+      }
+      r.entry.rowid = rowid;
+      r.entry.dictionary_id = dictionary_id;
+      if (valid_from >= 0) {
+        r.entry.setPeriod(valid_from, valid_to);
+      } else {
+        r.entry.valid_from = GEOWORD_DATE_MIN;
+        r.entry.valid_to = GEOWORD_DATE_MAX;
+        r.entry.has_period = false;
+      }
+      r.seq = seq;
+      return true;
+    }
+  };
+
+  /// @brief 地名語の一部を解析して見出し語レコードを作る
+  /// @arg @c begin, @c end    解析する地名語の範囲
+  /// @arg @c cache            キャッシュ済みの地名語を置き換えるキャッシュ、 NULL の場合は置き換えない
+  /// @arg @c records          [out] 見出し語レコード
+  /// @arg @c dictionary_ids   [out] 地名語を含む辞書の内部 ID
+  static void _parseGeowords(std::vector<WordlistBuilder::GeowordRow>::const_iterator begin,
+                             std::vector<WordlistBuilder::GeowordRow>::const_iterator end,
+                             GeowordCache* cache, std::vector<WordlistRecord>& records, std::set<int>& dictionary_ids)
+  {
+    Geoword geo_in;
+    for (std::vector<WordlistBuilder::GeowordRow>::const_iterator it = begin; it != end; it++) {
+      geo_in.initByRecordOrJson((*it).second.data(), (*it).second.length());
+      WordlistEntry entry((*it).first, geo_in.get_dictionary_id(), geo_in.get_geonlp_id());
+
+      // キャッシュ済みの地名語は最新の内容に置き換える
+      if (cache) cache->refresh(geo_in);
+      dictionary_ids.insert(geo_in.get_dictionary_id());
+
+      enumerateWordlistRecords(geo_in, entry, records);
+    }
+  }
+
+  /// @brief コンストラクタ
+  /// @arg @c tmp_prefix    ランの一時ファイル名の接頭辞
+  /// @arg @c memory_limit  メモリ上に保持するレコードの上限バイト数、0 の場合は一時ファイルを使わない
+  /// @arg @c n_threads     地名語の解析に利用するスレッド数、0 の場合は CPU 数
+  WordlistBuilder::WordlistBuilder(const std::string& tmp_prefix, size_t memory_limit, unsigned int n_threads):
+    tmp_prefix(tmp_prefix), memory_limit(memory_limit), n_threads(n_threads), records_size(0), num_records(0) {
+    if (this->n_threads == 0) this->n_threads = std::thread::hardware_concurrency();
+    if (this->n_threads == 0) this->n_threads = 1;
+  }
+
+  /// @brief デストラクタ、ランの一時ファイルを削除する
+  WordlistBuilder::~WordlistBuilder() {
+    for (std::vector<std::string>::const_iterator it = run_files.begin(); it != run_files.end(); it++) {
+      boost::system::error_code ec;
+      boost::filesystem::remove(boost::filesystem::path(*it), ec);
+    }
+  }
+
+  /// @brief 地名語をまとめて解析し、見出し語レコードを追加する
+  ///
+  /// 地名語をスレッド数に分割して並列に解析する。
+  /// 追加後にメモリ上限を超えている場合はランに書き出す。
+  /// @arg @c rows            地名語の rowid と JSON またはバイナリレコードの組
+  /// @arg @c cache           キャッシュ済みの地名語を置き換えるキャッシュ、 NULL の場合は置き換えない
+  /// @arg @c dictionary_ids  [in/out] 地名語を含む辞書の内部 ID を追加する
+  void WordlistBuilder::addGeowords(const std::vector<GeowordRow>& rows, GeowordCache* cache, std::set<int>& dictionary_ids)
+  {
+    size_t n = std::min(size_t(this->n_threads), rows.size());
+    std::vector<std::vector<WordlistRecord> > results(n > 1 ? n : 1);
+    std::vector<std::set<int> > ids(results.size());
+    if (n <= 1) {
+      _parseGeowords(rows.begin(), rows.end(), cache, results[0], ids[0]);
+    } else {
+      std::vector<std::exception_ptr> errors(n);
+      std::vector<std::thread> workers;
+      size_t chunk = (rows.size() + n - 1) / n;
+      for (size_t i = 0; i < n; i++) {
+        std::vector<GeowordRow>::const_iterator begin = rows.begin() + std::min(rows.size(), i * chunk);
+        std::vector<GeowordRow>::const_iterator end = rows.begin() + std::min(rows.size(), (i + 1) * chunk);
+        workers.push_back(std::thread([begin, end, cache, i, &results, &ids, &errors]() {
+              try {
+                _parseGeowords(begin, end, cache, results[i], ids[i]);
+              } catch (...) {
+                errors[i] = std::current_exception();
+              }
+            }));
+      }
+      for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+      for (size_t i = 0; i < errors.size(); i++) {
+        if (errors[i]) std::rethrow_exception(errors[i]);
+      }
+    }
+
+    for (size_t i = 0; i < results.size(); i++) {
+      dictionary_ids.insert(ids[i].begin(), ids[i].end());
+      for (std::vector<WordlistRecord>::iterator it = results[i].begin(); it != results[i].end(); it++) {
+        this->records_size += (*it).memorySize();
+        this->records.push_back(WordlistRecord());
+        std::swap(this->records.back(), *it);
+      }
+      this->num_records += results[i].size();
+      std::vector<WordlistRecord>().swap(results[i]);
+    }
+    if (this->memory_limit > 0 && this->records_size > this->memory_limit) this->spill();
+  }
+
+  /// @brief 保持しているレコードを整列してランに書き出す
+  void WordlistBuilder::spill(void)
+  {
+    std::sort(this->records.begin(), this->records.end());
+    std::ostringstream oss;
+    oss << this->tmp_prefix << ".run" << this->run_files.size();
+    std::string fname = oss.str();
+    FILE* fp = fopen(fname.c_str(), "wb");
+    if (fp == NULL) throw std::runtime_error(std::string("Cannot create a temporary file (") + fname + ")");
+    this->run_files.push_back(fname);
+    try {
+      for (std::vector<WordlistRecord>::const_iterator it = this->records.begin(); it != this->records.end(); it++) {
+        _writeRecord(fp, *it);
+      }
+    } catch (...) {
+      fclose(fp);
+      throw;
+    }
+    if (fclose(fp) != 0) throw std::runtime_error(std::string("Cannot write a temporary file (") + fname + ")");
+
+    // メモリを解放する
+    std::vector<WordlistRecord>().swap(this->records);
+    this->records_size = 0;
+  }
+
+  /// @brief 見出し語の順にレコードを併合し、見出し語ごとに Wordlist を出力する
+  ///
+  /// 見出し語IDは 0 から順に振る。表記と読みは見出し語の最初のレコードのものを使う。
+  /// 見出し語のいずれかのレコードが読み（WordlistRecord::isYomi()）の場合、 is_yomi を true にする。
+  /// @arg @c emit      Wordlist と読みかどうかを受け取る関数
+  /// @arg @c progress  進捗を受け取る関数（空でもよい）
+  void WordlistBuilder::merge(const std::function<void(const Wordlist&, bool is_yomi)>& emit, const IndexProgressCallback& progress)
+  {
+    unsigned int next_id = 0;
+    size_t done = 0;
+    bool has_current = false;
+    bool current_is_yomi = false;
+    Wordlist current;
+    std::string idlist;
+    std::vector<WordlistEntry> entries;
+
+    std::function<void(const WordlistRecord&)> add = [&](const WordlistRecord& r) {
+      if (has_current && r.key == current.get_key()) {
+        idlist += "/";
+        idlist += r.id_name;
+        entries.push_back(r.entry);
+        current_is_yomi = current_is_yomi || r.isYomi();
+      } else {
+        if (has_current) {
+          current.set_idlist(idlist);
+          current.set_entries(entries);
+          emit(current, current_is_yomi);
+        }
+        current = Wordlist(next_id++, r.key, r.surface, "", r.yomi);
+        idlist = r.id_name;
+        entries.clear();
+        entries.push_back(r.entry);
+        current_is_yomi = r.isYomi();
+        has_current = true;
+      }
+      done++;
+      if (progress && done % WORDLIST_MERGE_PROGRESS_INTERVAL == 0) progress("merge", done, this->num_records);
+    };
+
+    if (this->run_files.size() == 0) {
+      // 全てメモリ上にある
+      std::sort(this->records.begin(), this->records.end());
+      for (std::vector<WordlistRecord>::const_iterator it = this->records.begin(); it != this->records.end(); it++) {
+        add(*it);
+      }
+      std::vector<WordlistRecord>().swap(this->records);
+      this->records_size = 0;
+    } else {
+      if (this->records.size() > 0) this->spill();
+
+      // 各ランの先頭レコードをヒープで管理する
+      std::vector<boost::shared_ptr<RunReader> > readers;
+      std::vector<WordlistRecord> heads(this->run_files.size());
+      std::function<bool(size_t, size_t)> greater = [&heads](size_t a, size_t b) { return heads[b] < heads[a]; };
+      std::priority_queue<size_t, std::vector<size_t>, std::function<bool(size_t, size_t)> > heap(greater);
+      for (size_t i = 0; i < this->run_files.size(); i++) {
+        readers.push_back(boost::shared_ptr<RunReader>(new RunReader(this->run_files[i])));
+        if (readers[i]->next(heads[i])) heap.push(i);
+      }
+      while (!heap.empty()) {
+        size_t i = heap.top();
+        heap.pop();
+        add(heads[i]);
+        if (readers[i]->next(heads[i])) heap.push(i);
+      }
+    }
+
+    if (has_current) {
+      current.set_idlist(idlist);
+      current.set_entries(entries);
+      emit(current, current_is_yomi);
+    }
+    if (progress) progress("merge", done, this->num_records);
+  }
+
+}
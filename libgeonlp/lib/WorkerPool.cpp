@@ -0,0 +1,85 @@
+///
+/// @file
+/// @brief 非同期の解析を実行する作業スレッドのプール WorkerPool の実装。
+/// @author 国立情報学研究所
+///
+/// Copyright (c)2010-2013, NII
+///
+#include "WorkerPool.h"
+#ifdef __GLIBCXX__
+#include <cxxabi.h>
+#endif /* __GLIBCXX__ */
+
+namespace geonlp
+{
+  /// @brief 作業スレッドを起動する
+  /// @arg @c n_threads 作業スレッド数、0 の場合は CPU 数
+  WorkerPool::WorkerPool(unsigned int n_threads): stopping(false)
+  {
+    if (n_threads == 0) n_threads = std::thread::hardware_concurrency();
+    if (n_threads == 0) n_threads = 1;
+    for (unsigned int i = 0; i < n_threads; i++) {
+      this->workers.push_back(std::thread(&WorkerPool::run, this));
+    }
+  }
+
+  /// @brief 登録済みの処理を全て実行してから作業スレッドを終了する
+  WorkerPool::~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->stopping = true;
+    }
+    this->not_empty.notify_all();
+    for (std::vector<std::thread>::iterator it = this->workers.begin(); it != this->workers.end(); it++) {
+      (*it).join();
+    }
+  }
+
+  /// @brief 処理を登録する
+  /// @arg @c task 作業スレッドで実行する処理
+  void WorkerPool::submit(const std::function<void()>& task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->tasks.push_back(task);
+    }
+    this->not_empty.notify_one();
+  }
+
+  /// @brief 作業スレッドの本体、処理を取り出して実行する
+  void WorkerPool::run(void)
+  {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->not_empty.wait(lock, [this]() { return this->stopping || !this->tasks.empty(); });
+        if (this->tasks.empty()) return;  // stopping
+        task.swap(this->tasks.front());
+        this->tasks.pop_front();
+      }
+      try {
+        task();
+#ifdef __GLIBCXX__
+      } catch (abi::__forced_unwind&) {
+        throw;  // pthread_exit などによるスレッドの終了は止めない
+#endif /* __GLIBCXX__ */
+      } catch (...) {
+        // 処理の中で通知するため無視する
+      }
+    }
+  }
+
+  /// @brief プロセス全体で共有するプールを得る
+  ///
+  /// 最初に呼び出したときに CPU 数の作業スレッドで作成する。
+  /// プロセスの終了時に作業スレッドの終了を待たないよう、解放しない。
+  /// @return 共有するプール
+  WorkerPool& WorkerPool::shared(void)
+  {
+    static WorkerPool* pool = new WorkerPool();
+    return *pool;
+  }
+
+}
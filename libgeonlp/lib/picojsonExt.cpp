@@ -10,6 +10,45 @@
 
 namespace picojson
 {
+  // 存在しないキーの値として参照する null 値
+  static const picojson::value _null_value;
+
+  // 値の型が一致しない場合の例外を作る
+  static PicojsonException _type_error(const std::string& key, const char* type_name) {
+    return PicojsonException(std::string("'") + key + "' must be " + type_name + ".");
+  }
+
+  // 文字列がオブジェクトの外に確保しているバイト数を見積もる
+  static size_t _estimateStringSize(const std::string& s) {
+    static const size_t inline_capacity = std::string().capacity();
+    return s.capacity() > inline_capacity ? s.capacity() + 1 : 0;
+  }
+
+  // 値がオブジェクトの外に確保しているバイト数を見積もる
+  static size_t _estimateValueSize(const picojson::value& v) {
+    if (v.is<std::string>()) {
+      return sizeof(std::string) + _estimateStringSize(v.get<std::string>());
+    }
+    if (v.is<picojson::array>()) {
+      const picojson::array& a = v.get<picojson::array>();
+      size_t bytes = sizeof(picojson::array) + a.capacity() * sizeof(picojson::value);
+      for (picojson::array::const_iterator it = a.begin(); it != a.end(); it++) {
+        bytes += _estimateValueSize(*it);
+      }
+      return bytes;
+    }
+    if (v.is<picojson::object>()) {
+      const picojson::object& o = v.get<picojson::object>();
+      size_t bytes = sizeof(picojson::object);
+      for (picojson::object::const_iterator it = o.begin(); it != o.end(); it++) {
+        // 木のノードは要素と左右・親へのポインタ、色を持つ
+        bytes += sizeof(picojson::object::value_type) + 4 * sizeof(void*);
+        bytes += _estimateStringSize((*it).first) + _estimateValueSize((*it).second);
+      }
+      return bytes;
+    }
+    return 0;
+  }
 
   ext::ext() {
     initByJson("{}");
@@ -133,16 +172,55 @@ namespace picojson
 
   // picojson オブジェクトから、指定したキーの値を picojson::value として取得する
   picojson::value ext::get_value(const std::string& key) const {
-    picojson::object o = this->_v.get<picojson::object>();
-    const picojson::value v = o[key];
-    return v;
+    return this->_get_value_ref(key);
+  }
+
+  // picojson オブジェクトから、指定したキーの値を複製せずに参照する
+  // キーが存在しない場合は null 値への参照を返す
+  const picojson::value& ext::_get_value_ref(const std::string& key) const {
+    const picojson::object& o = this->_v.get<picojson::object>();
+    picojson::object::const_iterator it = o.find(key);
+    if (it == o.end()) return _null_value;
+    return (*it).second;
+  }
+
+  // picojson オブジェクトから、指定したキーの値を文字列として複製せずに参照する
+  // キーが存在しない場合、および null, false, 空文字列の場合は "" を返す
+  // 値が string 型以外の場合は PicojsonException 例外を発生する
+  // （数値を文字列として得る場合は _get_string を利用する）
+  std::string_view ext::_get_string_view(const std::string& key) const {
+    const picojson::value& v0 = this->_get_value_ref(key);
+    if (!v0) return std::string_view();
+    if (v0.is<std::string>()) return std::string_view(v0.get<std::string>());
+    throw _type_error(key, "a string");
+  }
+
+  // picojson オブジェクトから、指定したキーの値を文字列の配列として複製せずに参照する
+  // 結果は _get_string_list と同じ要素を持つ
+  // 値が object, double 型、または文字列以外の要素を含む場合は PicojsonException 例外を発生する
+  string_list_view ext::_get_string_list_view(const std::string& key) const {
+    const picojson::value& v0 = this->_get_value_ref(key);
+    if (v0.is<picojson::null>()) {
+      return string_list_view();
+    } else if (v0.is<std::string>()) {
+      return string_list_view(&v0);
+    } else if (v0.is<picojson::array>()) {
+      const picojson::array& v = v0.get<picojson::array>();
+      for (picojson::array::const_iterator it = v.begin(); it != v.end(); it++) {
+	if (!(*it).is<picojson::null>() && !(*it).is<bool>() && !(*it).is<std::string>()) {
+	  throw _type_error(key, "a list of string value");
+	}
+      }
+      return string_list_view(&v);
+    }
+    throw _type_error(key, "a list of string value");
   }
 
   // picojson オブジェクトから、指定したキーの値を文字列として取得する
   // キーが存在しない場合は "" を返す
   // 値が object, array 型の場合は PicojsonException 例外を発生する
   std::string ext::_get_string(const std::string& key) const {
-    const picojson::value v0 = this->get_value(key);
+    const picojson::value& v0 = this->_get_value_ref(key);
     if (!v0) return std::string("");
     if (v0.is<std::string>() || v0.is<long>() || v0.is<double>()) return v0.to_str();
     std::stringstream sstr;
@@ -155,12 +233,9 @@ namespace picojson
   // 値が object, double 型の場合は PicojsonException 例外を発生する
   // 値が string 型の場合は要素数１の文字列配列を返す
   std::vector<std::string> ext::_get_string_list(const std::string& key) const {
-    const picojson::value v0 = this->get_value(key);
-    picojson::value v1;
+    const picojson::value& v0 = this->_get_value_ref(key);
     std::vector<std::string> varray;
     varray.clear();
-    std::stringstream sstr;
-    sstr << "'" << key << "' must be a list of string value.";
 
     if (v0.is<picojson::null>()) {
       return varray;
@@ -168,55 +243,52 @@ namespace picojson
       varray.push_back(v0.to_str());
       return varray;
     } else if (v0.is<picojson::array>()) {
-      picojson::array v = v0.get<picojson::array>();
-      for (picojson::array::iterator it = v.begin(); it != v.end(); it++) {
+      const picojson::array& v = v0.get<picojson::array>();
+      for (picojson::array::const_iterator it = v.begin(); it != v.end(); it++) {
 	if ((*it).is<picojson::null>() || (*it).is<bool>()) {
 	  varray.push_back("");
 	} else if ((*it).is<std::string>()) {
 	  varray.push_back((*it).to_str());
 	} else {
-	  throw PicojsonException(sstr.str());
+	  throw _type_error(key, "a list of string value");
 	}
       }
       return varray;
     }
-    throw PicojsonException(sstr.str());
+    throw _type_error(key, "a list of string value");
   }
 
   // picojson オブジェクトから、指定したキーの値を文字列のハッシュとして取得する
   // キーが存在しない場合は [] を返す
   // 値が array, double, string 型の場合は PicojsonException 例外を発生する
   std::map<std::string, std::string> ext::_get_string_map(const std::string& key) const {
-    const picojson::value v0 = this->get_value(key);
-    picojson::value v1;
+    const picojson::value& v0 = this->_get_value_ref(key);
     std::map<std::string, std::string> varray;
     varray.clear();
-    std::stringstream sstr;
-    sstr << "'" << key << "' must be a map of string value.";
 
     if (v0.is<picojson::null>()) {
       return varray;
     } else if (v0.is<picojson::object>()) {
-      picojson::object v = v0.get<picojson::object>();
-      for (picojson::object::iterator it = v.begin(); it != v.end(); it++) {
+      const picojson::object& v = v0.get<picojson::object>();
+      for (picojson::object::const_iterator it = v.begin(); it != v.end(); it++) {
 	if ((*it).second.is<picojson::null>() || (*it).second.is<bool>()) {
 	  varray.insert(std::make_pair((*it).first, std::string("")));
 	} else if ((*it).second.is<std::string>()) {
 	  varray.insert(std::make_pair((*it).first, (*it).second.to_str()));
 	} else {
-	  throw PicojsonException(sstr.str());
+	  throw _type_error(key, "a map of string value");
 	}
       }
       return varray;
     }
-    throw PicojsonException(sstr.str());
+    throw _type_error(key, "a map of string value");
   }
 
   // picojson オブジェクトの指定したキーの値が null かどうか判定する
   // null の場合、およびキーが存在しない場合は true を返す
   // それ以外の場合は false を返す
   bool ext::is_null(const std::string& key) const {
-    const picojson::value v0 = this->get_value(key);
+    const picojson::value& v0 = this->_get_value_ref(key);
     if (!v0 || v0.is<picojson::null>()) return true;
     return false;
   }
@@ -225,7 +297,7 @@ namespace picojson
   // キーが存在しない場合は false を返す
   // 値が int, object, array, string 型の場合は PicojsonException 例外を発生する
   bool ext::_get_bool(const std::string& key) const {
-    const picojson::value v0 = this->get_value(key);
+    const picojson::value& v0 = this->_get_value_ref(key);
     if (!v0) return false;
     if (v0.is<bool>()) return v0.get<bool>();
     std::stringstream sstr;
@@ -237,7 +309,7 @@ namespace picojson
   // キーが存在しない場合は 0 を返す
   // 値が object, array, string 型の場合は PicojsonException 例外を発生する
   int ext::_get_int(const std::string& key) const {
-    const picojson::value v0 = this->get_value(key);
+    const picojson::value& v0 = this->_get_value_ref(key);
     if (!v0) return 0;
     if (v0.is<long>()) return (int)(v0.get<long>());
     if (v0.is<double>()) return (int)(v0.get<double>());
@@ -251,12 +323,9 @@ namespace picojson
   // 値が object, string 型の場合は PicojsonException 例外を発生する
   // 値が int 型の場合は要素数１の整数値配列を返す
   std::vector<int> ext::_get_int_list(const std::string& key) const {
-    const picojson::value v0 = this->get_value(key);
-    picojson::value v1;
+    const picojson::value& v0 = this->_get_value_ref(key);
     std::vector<int> varray;
     varray.clear();
-    std::stringstream sstr;
-    sstr << "'" << key << "' must be a list of int value.";
 
     if (v0.is<picojson::null>()) {
       return varray;
@@ -267,8 +336,8 @@ namespace picojson
       varray.push_back((int)(v0.get<double>()));
       return varray;
     } else if (v0.is<picojson::array>()) {
-      picojson::array v = v0.get<picojson::array>();
-      for (picojson::array::iterator it = v.begin(); it != v.end(); it++) {
+      const picojson::array& v = v0.get<picojson::array>();
+      for (picojson::array::const_iterator it = v.begin(); it != v.end(); it++) {
 	if ((*it).is<picojson::null>() || (*it).is<bool>()) {
 	  varray.push_back(0);
 	} else if ((*it).is<long>()) {
@@ -276,19 +345,19 @@ namespace picojson
 	} else if ((*it).is<double>()) {
 	  varray.push_back((int)((*it).get<double>()));
 	} else {
-	  throw PicojsonException(sstr.str());
+	  throw _type_error(key, "a list of int value");
 	}
       }
       return varray;
     }
-    throw PicojsonException(sstr.str());
+    throw _type_error(key, "a list of int value");
   }
 
   // picojson オブジェクトから、指定したキーの値を実数値として取得する
   // キーが存在しない場合は 0 を返す
   // 値が object, array, string 型の場合は PicojsonException 例外を発生する
   double ext::_get_double(const std::string& key) const {
-    const picojson::value v0 = this->get_value(key);
+    const picojson::value& v0 = this->_get_value_ref(key);
     if (!v0) return 0.0;
     if (v0.is<long>()) return (double)(v0.get<long>());
     if (v0.is<double>()) return v0.get<double>();
@@ -302,12 +371,9 @@ namespace picojson
   // 値が object, string 型の場合は PicojsonException 例外を発生する
   // 値が double 型の場合は要素数１の実数値配列を返す
   std::vector<double> ext::_get_double_list(const std::string& key) const {
-    const picojson::value v0 = this->get_value(key);
-    picojson::value v1;
+    const picojson::value& v0 = this->_get_value_ref(key);
     std::vector<double> varray;
     varray.clear();
-    std::stringstream sstr;
-    sstr << "'" << key << "' must be a list of double value.";
 
     if (v0.is<picojson::null>()) {
       return varray;
@@ -318,8 +384,8 @@ namespace picojson
       varray.push_back(v0.get<double>());
       return varray;
     } else if (v0.is<picojson::array>()) {
-      picojson::array v = v0.get<picojson::array>();
-      for (picojson::array::iterator it = v.begin(); it != v.end(); it++) {
+      const picojson::array& v = v0.get<picojson::array>();
+      for (picojson::array::const_iterator it = v.begin(); it != v.end(); it++) {
 	if ((*it).is<picojson::null>() || (*it).is<bool>()) {
 	  varray.push_back(0.0);
 	} else if ((*it).is<long>()) {
@@ -327,12 +393,12 @@ namespace picojson
 	} else if ((*it).is<double>()) {
 	  varray.push_back((*it).get<double>());
 	} else {
-	  throw PicojsonException(sstr.str());
+	  throw _type_error(key, "a list of double value");
 	}
       }
       return varray;
     }
-    throw PicojsonException(sstr.str());
+    throw _type_error(key, "a list of double value");
   }
 
   // JSON 表現を得る
@@ -340,6 +406,13 @@ namespace picojson
   {
     return this->_v.serialize();
   }
+
+  // オブジェクトが確保しているメモリのバイト数を見積もる
+  // 値そのものの大きさと、文字列、配列、オブジェクトの要素が確保している領域の合計
+  size_t ext::estimateMemorySize() const
+  {
+    return sizeof(picojson::value) + _estimateValueSize(this->_v);
+  }
 	
   // JSON から復元する, static function
   ext ext::fromJson(const std::string& json_str) {
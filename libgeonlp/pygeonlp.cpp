@@ -1,6 +1,12 @@
 #include <Python.h>
 #include <cstdio>
+#include <istream>
+#include <streambuf>
+#include <vector>
+#include <algorithm>
 #include "GeonlpMA.h"
+#include "PathSearch.h"
+#include "AddressSpan.h"
 
 /*
 For creation of C-Exteion, refer;
@@ -99,33 +105,694 @@ static PyObject * geonlp_ma_parse(GeonlpMA *self, PyObject *args)
   char* str;
 
   PyArg_ParseTuple(args, "s", &str);
-  std::string result = (self->_ptrObj)->parse(str);
-  return Py_BuildValue("s", result.c_str(), 1);
+  std::string sentence(str);
+  // The output buffer is reused across calls in the same thread
+  static thread_local std::string result;
+  std::string errmsg;
+  bool failed = false;
+
+  // MA は複数スレッドから同時に利用できるので、解析中は GIL を解放する
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    result.clear();
+    (self->_ptrObj)->parse(sentence, result);
+  } catch (std::exception & e) {
+    errmsg = e.what();
+    failed = true;
+  }
+  Py_END_ALLOW_THREADS
+
+  if (failed) {
+    PyErr_SetString(PyExc_RuntimeError, errmsg.c_str());
+    return NULL;
+  }
+  return PyUnicode_DecodeUTF8(result.data(), result.length(), NULL);
+}
+
+/**
+ * Node fields, in the same order as the keys of Node::toObject()
+ */
+
+typedef const std::string (geonlp::Node::*NodeGetter)() const;
+
+static const struct {
+  const char *name;
+  NodeGetter getter;
+} __node_fields[] = {
+  {"conjugated_form", &geonlp::Node::get_conjugatedForm},
+  {"conjugation_type", &geonlp::Node::get_conjugationType},
+  {"original_form", &geonlp::Node::get_originalForm},
+  {"pos", &geonlp::Node::get_partOfSpeech},
+  {"prononciation", &geonlp::Node::get_pronunciation},
+  {"subclass1", &geonlp::Node::get_subclassification1},
+  {"subclass2", &geonlp::Node::get_subclassification2},
+  {"subclass3", &geonlp::Node::get_subclassification3},
+  {"surface", &geonlp::Node::get_surface},
+  {"yomi", &geonlp::Node::get_yomi},
+};
+
+#define NUM_NODE_FIELDS ((Py_ssize_t)(sizeof(__node_fields) / sizeof(__node_fields[0])))
+
+// Interned key objects, created in PyInit_capi
+static PyObject *__node_field_keys[NUM_NODE_FIELDS];
+
+static PyObject * __node_field_value(const geonlp::Node& node, Py_ssize_t field)
+// Get the field value of the node as a str
+{
+  const std::string value = (node.*(__node_fields[field].getter))();
+  return PyUnicode_DecodeUTF8(value.c_str(), value.length(), NULL);
+}
+
+static PyObject * __node_to_pydict(const geonlp::Node& node)
+// Convert the node to a dict directly, without picojson
+{
+  PyObject *pydict = PyDict_New();
+  if (pydict == NULL) return NULL;
+
+  for (Py_ssize_t i = 0; i < NUM_NODE_FIELDS; i++) {
+    PyObject *val = __node_field_value(node, i);
+    if (val == NULL || PyDict_SetItem(pydict, __node_field_keys[i], val) < 0) {
+      Py_XDECREF(val);
+      Py_DECREF(pydict);
+      return NULL;
+    }
+    Py_DECREF(val);
+  }
+  return pydict;
+}
+
+static PyObject * __nodes_to_pylist(const std::vector<geonlp::Node>& nodes)
+// Convert the list of nodes to a list of dict
+{
+  Py_ssize_t n = (Py_ssize_t) nodes.size();
+  PyObject *pylist = PyList_New(n);
+  if (pylist == NULL) return NULL;
+
+  for (Py_ssize_t i = 0; i < n; i++) {
+    PyObject *pydict = __node_to_pydict(nodes[i]);
+    if (pydict == NULL) {
+      Py_DECREF(pylist);
+      return NULL;
+    }
+    PyList_SET_ITEM(pylist, i, pydict);
+  }
+  return pylist;
+}
+
+static PyObject * __nodes_to_columns(const std::vector<geonlp::Node>& nodes)
+// Convert the list of nodes to a tuple of lists, one list per field
+// in the order of capi.NODE_FIELDS
+{
+  Py_ssize_t n = (Py_ssize_t) nodes.size();
+  PyObject *columns = PyTuple_New(NUM_NODE_FIELDS);
+  if (columns == NULL) return NULL;
+
+  for (Py_ssize_t f = 0; f < NUM_NODE_FIELDS; f++) {
+    PyObject *column = PyList_New(n);
+    if (column == NULL) {
+      Py_DECREF(columns);
+      return NULL;
+    }
+    PyTuple_SET_ITEM(columns, f, column);
+    for (Py_ssize_t i = 0; i < n; i++) {
+      PyObject *val = __node_field_value(nodes[i], f);
+      if (val == NULL) {
+        Py_DECREF(columns);
+        return NULL;
+      }
+      PyList_SET_ITEM(column, i, val);
+    }
+  }
+  return columns;
+}
+
+static PyObject * __nodes_to_pyobject(const std::vector<geonlp::Node>& nodes, int columnar, geonlp::StatsCollector* stats)
+// Convert the list of nodes to a list of dict, or a tuple of lists if columnar
+// The conversion time is added to stats unless it is NULL
+{
+  geonlp::StatsTimer timer(stats, geonlp::STATS_PYTHON);
+  timer.setRows(nodes.size());
+  if (columnar) return __nodes_to_columns(nodes);
+  return __nodes_to_pylist(nodes);
+}
+
+#define ACTIVE_VIEW_CAPSULE_NAME "pygeonlp.capi.ActiveView"
+
+static void __active_view_capsule_destructor(PyObject *capsule)
+// Release the ActiveView held by the capsule
+{
+  delete (geonlp::ActiveViewPtr*)PyCapsule_GetPointer(capsule, ACTIVE_VIEW_CAPSULE_NAME);
 }
 
-static PyObject * geonlp_ma_parse_node(GeonlpMA *self, PyObject *args)
+static bool __pyobject_to_active_view(PyObject *pyobj, geonlp::ActiveViewPtr& view)
+// Get the ActiveView from the capsule returned by createActiveView
+// None gives an empty pointer; returns false with TypeError for other objects
+{
+  view.reset();
+  if (pyobj == NULL || pyobj == Py_None) return true;
+  if (!PyCapsule_IsValid(pyobj, ACTIVE_VIEW_CAPSULE_NAME)) {
+    PyErr_SetString(PyExc_TypeError, "view must be an object returned by createActiveView().");
+    return false;
+  }
+  view = *(geonlp::ActiveViewPtr*)PyCapsule_GetPointer(pyobj, ACTIVE_VIEW_CAPSULE_NAME);
+  return true;
+}
+
+static PyObject * geonlp_ma_parse_node(GeonlpMA *self, PyObject *args, PyObject *kwds)
 // Parse the sentence and return list of objects
 {
+  static const char *kwlist[] = {"sentence", "columnar", "view", NULL};
   char* str;
+  int columnar = 0;
+  PyObject *pyview = NULL;
+  geonlp::ActiveViewPtr view;
 
-  PyArg_ParseTuple(args, "s", &str);
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|pO", (char **)kwlist, &str, &columnar, &pyview)) {
+    return NULL;
+  }
+  if (!__pyobject_to_active_view(pyview, view)) return NULL;
+  std::string sentence(str);
 
   std::vector<geonlp::Node> ret;
+  std::string errmsg;
+  bool failed = false;
+
+  // MA は複数スレッドから同時に利用できるので、解析中は GIL を解放する
+  Py_BEGIN_ALLOW_THREADS
   try {
-    Py_ssize_t n = (Py_ssize_t) (self->_ptrObj)->parseNode(str, ret);
-    PyObject *pylist = PyList_New(n);
+    if (view) {
+      (self->_ptrObj)->parseNode(sentence, ret, *view);
+    } else {
+      (self->_ptrObj)->parseNode(sentence, ret);
+    }
+  } catch (std::exception & e) {
+    errmsg = e.what();
+    failed = true;
+  }
+  Py_END_ALLOW_THREADS
 
-    for (Py_ssize_t i = 0; i < n; i++) {
-      picojson::object pico_obj = ret[i].toObject();
-      picojson::value v(pico_obj);
-      PyList_SetItem(pylist, i, picojson_to_pyobject(v));
+  if (failed) {
+    PyErr_SetString(PyExc_RuntimeError, errmsg.c_str());
+    return NULL;
+  }
+  return __nodes_to_pyobject(ret, columnar, (self->_ptrObj)->getStatsCollector());
+}
+
+static PyObject * geonlp_ma_parse_lattice(GeonlpMA *self, PyObject *args, PyObject *kwds)
+// Parse the sentence and return the nodes with the geowords of their candidates
+{
+  static const char *kwlist[] = {"sentence", "view", NULL};
+  char* str;
+  PyObject *pyview = NULL;
+  geonlp::ActiveViewPtr view;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O", (char **)kwlist, &str, &pyview)) {
+    return NULL;
+  }
+  if (!__pyobject_to_active_view(pyview, view)) return NULL;
+  std::string sentence(str);
+
+  std::vector<geonlp::Node> nodes;
+  std::vector<std::vector<geonlp::Geoword> > candidates;
+  std::map<int, std::string> identifiers;
+  std::string errmsg;
+  bool failed = false;
+
+  // 解析と候補の取得、辞書の識別子の取得の間は GIL を解放する
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    if (view) {
+      (self->_ptrObj)->parseLattice(sentence, nodes, candidates, *view);
+    } else {
+      (self->_ptrObj)->parseLattice(sentence, nodes, candidates);
+    }
+    for (size_t i = 0; i < candidates.size(); i++) {
+      for (size_t j = 0; j < candidates[i].size(); j++) {
+        geonlp::Geoword& geoword = candidates[i][j];
+        __alter_geonlpid_fieldname(geoword);
+        if (!geoword.has_key("dictionary_id")) continue;
+        int dictionary_id = geoword.get_dictionary_id();
+        if (identifiers.find(dictionary_id) == identifiers.end()) {
+          identifiers[dictionary_id] = (self->_ptrObj)->getDictionaryIdentifierById(dictionary_id);
+        }
+        geoword.set_value("dictionary_identifier", identifiers[dictionary_id]);
+      }
     }
+  } catch (std::exception & e) {
+    errmsg = e.what();
+    failed = true;
+  }
+  Py_END_ALLOW_THREADS
 
-    return pylist;
+  if (failed) {
+    PyErr_SetString(PyExc_RuntimeError, errmsg.c_str());
+    return NULL;
+  }
+
+  // (nodes, candidates) の形で返す、 candidates[i] は nodes[i] の地名語候補の dict のリスト
+  PyObject *pynodes = __nodes_to_pyobject(nodes, 0, (self->_ptrObj)->getStatsCollector());
+  if (pynodes == NULL) return NULL;
+  PyObject *pycandidates = PyList_New(candidates.size());
+  if (pycandidates == NULL) {
+    Py_DECREF(pynodes);
+    return NULL;
+  }
+  for (size_t i = 0; i < candidates.size(); i++) {
+    PyObject *pygeowords = PyList_New(candidates[i].size());
+    if (pygeowords == NULL) {
+      Py_DECREF(pynodes);
+      Py_DECREF(pycandidates);
+      return NULL;
+    }
+    PyList_SET_ITEM(pycandidates, i, pygeowords);
+    for (size_t j = 0; j < candidates[i].size(); j++) {
+      PyObject *pygeoword = picojson_to_pyobject(candidates[i][j]);
+      if (pygeoword == NULL) {
+        Py_DECREF(pynodes);
+        Py_DECREF(pycandidates);
+        return NULL;
+      }
+      PyList_SET_ITEM(pygeowords, j, pygeoword);
+    }
+  }
+  return Py_BuildValue("(NN)", pynodes, pycandidates);
+}
+
+static PyObject * geonlp_ma_parse_node_batch(GeonlpMA *self, PyObject *args, PyObject *kwds)
+// Parse the list of sentences in worker threads and return list of lists
+{
+  static const char *kwlist[] = {"sentences", "n_threads", "columnar", NULL};
+  PyObject *pyobj;
+  int n_threads = 0;
+  int columnar = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|ip", (char **)kwlist, &pyobj, &n_threads, &columnar)) {
+    return NULL;
+  }
+
+  std::vector<std::string> sentences;
+  PyObject *iter = PyObject_GetIter(pyobj);
+  if (!iter) {
+    PyErr_SetString(PyExc_TypeError, "Param must be a list of str.");
+    return NULL;
+  }
+  while (true) {
+    PyObject *next = PyIter_Next(iter);
+    if (!next) break;
+    if (!PyUnicode_Check(next)) {
+      Py_DECREF(next);
+      Py_DECREF(iter);
+      PyErr_SetString(PyExc_TypeError, "Param must be a list of str.");
+      return NULL;
+    }
+    Py_ssize_t len = 0;
+    const char *str = PyUnicode_AsUTF8AndSize(next, &len);
+    if (str == NULL) {
+      // e.g. a lone surrogate which cannot be encoded in UTF-8
+      Py_DECREF(next);
+      Py_DECREF(iter);
+      return NULL;
+    }
+    sentences.push_back(std::string(str, len));
+    Py_DECREF(next);
+  }
+  Py_DECREF(iter);
+  if (PyErr_Occurred()) return NULL;
+
+  // Release the GIL while the worker threads are running
+  geonlp::MAPtr ma = self->_ptrObj;
+  std::vector<std::vector<geonlp::Node> > results;
+  std::string errmsg;
+  bool failed = false;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    ma->parseNodeBatch(sentences, results, n_threads);
   } catch (std::exception & e) {
+    failed = true;
+    errmsg = e.what();
+  }
+  Py_END_ALLOW_THREADS
+
+  if (failed) {
+    PyErr_SetString(PyExc_RuntimeError, errmsg.c_str());
+    return NULL;
+  }
+
+  Py_ssize_t n = (Py_ssize_t) results.size();
+  PyObject *pylist = PyList_New(n);
+  if (pylist == NULL) return NULL;
+  geonlp::StatsCollector* stats = ma->getStatsCollector();
+  for (Py_ssize_t i = 0; i < n; i++) {
+    PyObject *nodes = __nodes_to_pyobject(results[i], columnar, stats);
+    if (nodes == NULL) {
+      Py_DECREF(pylist);
+      return NULL;
+    }
+    PyList_SET_ITEM(pylist, i, nodes);
+  }
+  return pylist;
+}
+
+/**
+ * Input stream reading str or bytes chunks from a Python iterator
+ */
+
+class __PyIterStreambuf : public std::streambuf {
+  // Read from a thread without the GIL, acquiring the GIL for each chunk.
+  // An exception raised by the iterator is kept and restored by restoreError().
+private:
+  PyObject *iter;
+  std::string chunk;
+  PyObject *err_type, *err_value, *err_traceback;
+
+public:
+  __PyIterStreambuf(PyObject *it): iter(it), err_type(NULL), err_value(NULL), err_traceback(NULL) {}
+
+  bool hasError(void) const { return err_type != NULL; }
+
+  void restoreError(void) {
+    // Call with the GIL held
+    PyErr_Restore(err_type, err_value, err_traceback);
+    err_type = err_value = err_traceback = NULL;
+  }
+
+protected:
+  int_type underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    if (iter == NULL) return traits_type::eof();
+
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    chunk.clear();
+    while (chunk.empty() && iter != NULL) {
+      PyObject *next = PyIter_Next(iter);
+      if (next == NULL) {
+        if (PyErr_Occurred()) PyErr_Fetch(&err_type, &err_value, &err_traceback);
+        iter = NULL;
+        break;
+      }
+      if (PyUnicode_Check(next)) {
+        Py_ssize_t len = 0;
+        const char *str = PyUnicode_AsUTF8AndSize(next, &len);
+        if (str) chunk.assign(str, len);
+      } else if (PyBytes_Check(next)) {
+        chunk.assign(PyBytes_AS_STRING(next), PyBytes_GET_SIZE(next));
+      } else {
+        PyErr_SetString(PyExc_TypeError, "Chunks must be str or bytes.");
+      }
+      Py_DECREF(next);
+      if (PyErr_Occurred()) {
+        PyErr_Fetch(&err_type, &err_value, &err_traceback);
+        iter = NULL;
+      }
+    }
+    PyGILState_Release(gstate);
+
+    if (chunk.empty()) return traits_type::eof();
+    char *p = &chunk[0];
+    setg(p, p, p + chunk.length());
+    return traits_type::to_int_type(*gptr());
+  }
+};
+
+/**
+ * Output stream writing str to a Python callable such as file.write
+ */
+
+class __PyWriteStreambuf : public std::streambuf {
+  // Buffer the output and pass it to write(str) with the GIL acquired
+  // when the buffer is full or flushed.
+  // An exception raised by write is kept and restored by restoreError().
+private:
+  PyObject *write;
+  std::vector<char> buf;
+  PyObject *err_type, *err_value, *err_traceback;
+
+  bool flushBuffer(void) {
+    Py_ssize_t n = (Py_ssize_t)(pptr() - pbase());
+    if (n == 0) return true;
+    if (err_type != NULL) return false;
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    // Keep an incomplete UTF-8 character at the end for the next write
+    Py_ssize_t len = n;
+    Py_ssize_t last = n - 1;
+    while (last > 0 && ((unsigned char)pbase()[last] & 0xC0) == 0x80) last--;
+    unsigned char lead = (unsigned char)pbase()[last];
+    if (lead >= 0xC0) {
+      Py_ssize_t need = lead >= 0xF0 ? 4 : (lead >= 0xE0 ? 3 : 2);
+      if (last + need > n) len = last;
+    }
+    PyObject *str = PyUnicode_DecodeUTF8(pbase(), len, "replace");
+    PyObject *result = str ? PyObject_CallFunctionObjArgs(write, str, NULL) : NULL;
+    Py_XDECREF(str);
+    Py_XDECREF(result);
+    if (result == NULL) PyErr_Fetch(&err_type, &err_value, &err_traceback);
+    PyGILState_Release(gstate);
+    if (err_type != NULL) return false;
+    std::copy(pbase() + len, pptr(), pbase());
+    setp(buf.data(), buf.data() + buf.size());
+    pbump(int(n - len));
+    return true;
+  }
+
+public:
+  __PyWriteStreambuf(PyObject *w, size_t size = 65536): write(w), buf(size), err_type(NULL), err_value(NULL), err_traceback(NULL) {
+    setp(buf.data(), buf.data() + buf.size());
+  }
+
+  bool hasError(void) const { return err_type != NULL; }
+
+  void restoreError(void) {
+    // Call with the GIL held
+    PyErr_Restore(err_type, err_value, err_traceback);
+    err_type = err_value = err_traceback = NULL;
+  }
+
+protected:
+  int_type overflow(int_type c) {
+    if (!flushBuffer()) return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      if (pptr() == epptr()) return traits_type::eof();
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  int sync() {
+    return flushBuffer() ? 0 : -1;
+  }
+};
+
+static PyObject * geonlp_ma_parse_node_stream(GeonlpMA *self, PyObject *args, PyObject *kwds)
+// Parse the text read from an iterator of chunks sentence by sentence,
+// calling callback(nodes, offset) for each sentence
+{
+  static const char *kwlist[] = {"chunks", "callback", "columnar", "max_sentence_bytes", "read_size", NULL};
+  PyObject *pyobj;
+  PyObject *pycallback;
+  int columnar = 0;
+  Py_ssize_t max_sentence_bytes = (Py_ssize_t)geonlp::STREAM_MAX_SENTENCE_BYTES;
+  Py_ssize_t read_size = (Py_ssize_t)geonlp::STREAM_READ_SIZE;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|pnn", (char **)kwlist, &pyobj, &pycallback, &columnar, &max_sentence_bytes, &read_size)) {
+    return NULL;
+  }
+  if (!PyCallable_Check(pycallback)) {
+    PyErr_SetString(PyExc_TypeError, "callback must be callable.");
+    return NULL;
+  }
+  if (max_sentence_bytes <= 0) {
+    PyErr_SetString(PyExc_ValueError, "max_sentence_bytes must be positive.");
+    return NULL;
+  }
+  if (read_size <= 0) {
+    PyErr_SetString(PyExc_ValueError, "read_size must be positive.");
+    return NULL;
+  }
+  PyObject *iter = PyObject_GetIter(pyobj);
+  if (!iter) {
+    PyErr_SetString(PyExc_TypeError, "Param must be an iterable of str.");
+    return NULL;
+  }
+
+  geonlp::MAPtr ma = self->_ptrObj;
+  geonlp::StatsCollector* stats = ma->getStatsCollector();
+  __PyIterStreambuf streambuf(iter);
+  std::istream in(&streambuf);
+  bool callback_failed = false;
+
+  // 解析中は GIL を解放し、 callback(nodes, offset) を呼び出すときだけ取得する
+  geonlp::NodeStreamCallback callback = [&](const std::vector<geonlp::Node>& nodes, size_t offset) {
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    bool cont = false;
+    PyObject *pynodes = __nodes_to_pyobject(nodes, columnar, stats);
+    if (pynodes != NULL) {
+      PyObject *result = PyObject_CallFunction(pycallback, "On", pynodes, (Py_ssize_t)offset);
+      Py_DECREF(pynodes);
+      if (result != NULL) {
+        cont = (result != Py_False);
+        Py_DECREF(result);
+      }
+    }
+    if (PyErr_Occurred()) {
+      // The error indicator is kept until this function returns
+      callback_failed = true;
+      cont = false;
+    }
+    PyGILState_Release(gstate);
+    return cont;
+  };
+
+  std::string errmsg;
+  bool failed = false;
+  int count = 0;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    count = ma->parseNodeStream(in, callback, size_t(max_sentence_bytes), size_t(read_size));
+  } catch (std::exception & e) {
+    failed = true;
+    errmsg = e.what();
+  }
+  Py_END_ALLOW_THREADS
+  Py_DECREF(iter);
+
+  if (callback_failed) return NULL;
+  if (streambuf.hasError()) {
+    streambuf.restoreError();
+    return NULL;
+  }
+  if (failed) {
+    PyErr_SetString(PyExc_RuntimeError, errmsg.c_str());
+    return NULL;
+  }
+  return PyLong_FromLong(count);
+}
+
+static PyObject * geonlp_ma_parse_node_async(GeonlpMA *self, PyObject *args, PyObject *kwds)
+// Parse the sentence in the shared worker pool, then call
+// callback(nodes, None) or callback(None, exception) from the worker thread
+{
+  static const char *kwlist[] = {"sentence", "callback", "columnar", NULL};
+  char* str;
+  PyObject *pycallback;
+  int columnar = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "sO|p", (char **)kwlist, &str, &pycallback, &columnar)) {
+    return NULL;
+  }
+  if (!PyCallable_Check(pycallback)) {
+    PyErr_SetString(PyExc_TypeError, "callback must be callable.");
+    return NULL;
+  }
+  std::string sentence(str);
+
+  // callback は作業スレッドで呼び出した後に解放する
+  Py_INCREF(pycallback);
+  geonlp::MAPtr ma = self->_ptrObj;
+  geonlp::StatsCollector* stats = ma->getStatsCollector();
+  geonlp::NodeAsyncCallback callback = [ma, pycallback, columnar, stats](const std::vector<geonlp::Node>& nodes, std::exception_ptr error) {
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    PyObject *result = NULL;
+    if (error) {
+      std::string errmsg("Unknown error.");
+      try {
+        std::rethrow_exception(error);
+      } catch (std::exception & e) {
+        errmsg = e.what();
+      } catch (...) {
+      }
+      PyObject *exc = PyObject_CallFunction(PyExc_RuntimeError, "s", errmsg.c_str());
+      if (exc != NULL) {
+        result = PyObject_CallFunctionObjArgs(pycallback, Py_None, exc, NULL);
+        Py_DECREF(exc);
+      }
+    } else {
+      PyObject *pynodes = __nodes_to_pyobject(nodes, columnar, stats);
+      if (pynodes != NULL) {
+        result = PyObject_CallFunctionObjArgs(pycallback, pynodes, Py_None, NULL);
+        Py_DECREF(pynodes);
+      }
+    }
+    if (result != NULL) {
+      Py_DECREF(result);
+    } else {
+      // There is no caller to receive the exception
+      PyErr_WriteUnraisable(pycallback);
+    }
+    Py_DECREF(pycallback);
+    PyGILState_Release(gstate);
+  };
+
+  try {
+    ma->parseNodeAsync(sentence, callback);
+  } catch (std::exception & e) {
+    Py_DECREF(pycallback);
     PyErr_SetString(PyExc_RuntimeError, e.what());
+    return NULL;
   }
-  return NULL;
+  Py_RETURN_NONE;
+}
+
+static PyObject * geonlp_ma_parse_stream(GeonlpMA *self, PyObject *args, PyObject *kwds)
+// Parse the text read from an iterator of chunks sentence by sentence,
+// passing the formatted text to write(str)
+{
+  static const char *kwlist[] = {"chunks", "write", "max_sentence_bytes", NULL};
+  PyObject *pyobj;
+  PyObject *pywrite;
+  Py_ssize_t max_sentence_bytes = (Py_ssize_t)geonlp::STREAM_MAX_SENTENCE_BYTES;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|n", (char **)kwlist, &pyobj, &pywrite, &max_sentence_bytes)) {
+    return NULL;
+  }
+  if (!PyCallable_Check(pywrite)) {
+    PyErr_SetString(PyExc_TypeError, "write must be callable.");
+    return NULL;
+  }
+  if (max_sentence_bytes <= 0) {
+    PyErr_SetString(PyExc_ValueError, "max_sentence_bytes must be positive.");
+    return NULL;
+  }
+  PyObject *iter = PyObject_GetIter(pyobj);
+  if (!iter) {
+    PyErr_SetString(PyExc_TypeError, "Param must be an iterable of str.");
+    return NULL;
+  }
+
+  geonlp::MAPtr ma = self->_ptrObj;
+  __PyIterStreambuf inbuf(iter);
+  __PyWriteStreambuf outbuf(pywrite);
+  std::istream in(&inbuf);
+  std::ostream os(&outbuf);
+
+  std::string errmsg;
+  bool failed = false;
+  int count = 0;
+  // 解析中は GIL を解放し、入力の読み込みと write の呼び出しのときだけ取得する
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    count = ma->parseStream(in, os, size_t(max_sentence_bytes));
+    os.flush();
+  } catch (std::exception & e) {
+    failed = true;
+    errmsg = e.what();
+  }
+  Py_END_ALLOW_THREADS
+  Py_DECREF(iter);
+
+  if (outbuf.hasError()) {
+    outbuf.restoreError();
+    return NULL;
+  }
+  if (inbuf.hasError()) {
+    inbuf.restoreError();
+    return NULL;
+  }
+  if (failed) {
+    PyErr_SetString(PyExc_RuntimeError, errmsg.c_str());
+    return NULL;
+  }
+  return PyLong_FromLong(count);
 }
 
 static PyObject * geonlp_ma_get_word_info(GeonlpMA *self, PyObject *args)
@@ -133,38 +800,209 @@ static PyObject * geonlp_ma_get_word_info(GeonlpMA *self, PyObject *args)
 {
   char* str;
 
-  PyArg_ParseTuple(args, "s", &str);
+  PyArg_ParseTuple(args, "s", &str);
+  try {
+    picojson::ext json_obj;
+    geonlp::Geoword geoword;
+    if ((self->_ptrObj)->getGeowordEntry(str, geoword)) {
+      __alter_geonlpid_fieldname(geoword);
+      return picojson_to_pyobject(geoword);
+    }
+    Py_INCREF(Py_None);
+    return Py_None;
+  } catch (geonlp::ServiceRequestFormatException &e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  }
+  return NULL;
+}
+
+static PyObject * geonlp_ma_search_word(GeonlpMA *self, PyObject *args, PyObject *kwds)
+// Search the dictionary by word spelling or reading.
+{
+  static const char *kwlist[] = {"key", "view", NULL};
+  char* str;
+  PyObject *pyview = NULL;
+  geonlp::ActiveViewPtr view;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O", (char **)kwlist, &str, &pyview)) {
+    return NULL;
+  }
+  if (!__pyobject_to_active_view(pyview, view)) return NULL;
+  try {
+    picojson::ext json_obj;
+    std::map<std::string, geonlp::Geoword> results;
+    if (view) {
+      (self->_ptrObj)->getGeowordEntries(str, results, *view);
+    } else {
+      (self->_ptrObj)->getGeowordEntries(str, results);
+    }
+    for (std::map<std::string, geonlp::Geoword>::iterator it = results.begin();
+      it != results.end(); it++) {
+      __alter_geonlpid_fieldname((*it).second);
+      json_obj.set_value((*it).first, (*it).second);
+    }
+    return picojson_to_pyobject(json_obj);
+  } catch (geonlp::ServiceRequestFormatException& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  } catch (geonlp::IndexNotExistsException& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  }
+  return NULL;
+}
+
+static PyObject * geonlp_ma_search_yomi(GeonlpMA *self, PyObject *args)
+// Search the dictionary by word reading.
+{
+  char* str;
+
+  if (!PyArg_ParseTuple(args, "s", &str)) {
+    return NULL;
+  }
+  try {
+    picojson::ext json_obj;
+    std::map<std::string, geonlp::Geoword> results;
+    (self->_ptrObj)->getGeowordEntriesByYomi(str, results);
+    for (std::map<std::string, geonlp::Geoword>::iterator it = results.begin();
+      it != results.end(); it++) {
+      __alter_geonlpid_fieldname((*it).second);
+      json_obj.set_value((*it).first, (*it).second);
+    }
+    return picojson_to_pyobject(json_obj);
+  } catch (geonlp::ServiceRequestFormatException& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  } catch (geonlp::IndexNotExistsException& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  }
+  return NULL;
+}
+
+static PyObject * geonlp_ma_search_yomi_prefix(GeonlpMA *self, PyObject *args)
+// Search the dictionary for all the readings matching the beginning of the text.
+{
+  char* str;
+
+  if (!PyArg_ParseTuple(args, "s", &str)) {
+    return NULL;
+  }
+  try {
+    std::vector<geonlp::YomiMatch> matches;
+    (self->_ptrObj)->getGeowordEntriesByYomiPrefix(str, matches);
+    PyObject* list = PyList_New(matches.size());
+    if (list == NULL) return NULL;
+    for (size_t i = 0; i < matches.size(); i++) {
+      picojson::ext json_obj;
+      std::map<std::string, geonlp::Geoword>& geowords = matches[i].geowords;
+      for (std::map<std::string, geonlp::Geoword>::iterator it = geowords.begin();
+        it != geowords.end(); it++) {
+        __alter_geonlpid_fieldname((*it).second);
+        json_obj.set_value((*it).first, (*it).second);
+      }
+      PyObject* item = Py_BuildValue("(sN)", matches[i].yomi.c_str(), picojson_to_pyobject(json_obj));
+      if (item == NULL) {
+        Py_DECREF(list);
+        return NULL;
+      }
+      PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+  } catch (geonlp::ServiceRequestFormatException& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  } catch (geonlp::IndexNotExistsException& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  }
+  return NULL;
+}
+
+static PyObject * geonlp_ma_complete(GeonlpMA *self, PyObject *args, PyObject *kwds)
+// Get the top-k completions of the prefix.
+{
+  static const char *kwlist[] = {"prefix", "k", "view", NULL};
+  char* str;
+  Py_ssize_t k = 10;
+  PyObject *pyview = NULL;
+  geonlp::ActiveViewPtr view;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|nO", (char **)kwlist, &str, &k, &pyview)) {
+    return NULL;
+  }
+  if (k < 0) {
+    PyErr_SetString(PyExc_ValueError, "k must not be negative.");
+    return NULL;
+  }
+  if (!__pyobject_to_active_view(pyview, view)) return NULL;
   try {
-    picojson::ext json_obj;
-    geonlp::Geoword geoword;
-    if ((self->_ptrObj)->getGeowordEntry(str, geoword)) {
-      __alter_geonlpid_fieldname(geoword);
-      return picojson_to_pyobject(geoword);
+    std::vector<geonlp::Completion> completions;
+    if (view) {
+      (self->_ptrObj)->getCompletions(str, size_t(k), completions, *view);
+    } else {
+      (self->_ptrObj)->getCompletions(str, size_t(k), completions);
     }
-    Py_INCREF(Py_None);
-    return Py_None;
-  } catch (geonlp::ServiceRequestFormatException &e) {
+    PyObject* list = PyList_New(completions.size());
+    if (list == NULL) return NULL;
+    for (size_t i = 0; i < completions.size(); i++) {
+      const geonlp::Completion& c = completions[i];
+      PyObject* ids = PyList_New(c.geonlp_ids.size());
+      if (ids == NULL) {
+        Py_DECREF(list);
+        return NULL;
+      }
+      for (size_t j = 0; j < c.geonlp_ids.size(); j++) {
+        PyList_SET_ITEM(ids, j, PyUnicode_FromString(c.geonlp_ids[j].c_str()));
+      }
+      PyObject* item = Py_BuildValue("{s:s,s:I,s:N}", "surface", c.surface.c_str(), "score", c.score, "geolod_ids", ids);
+      if (item == NULL) {
+        Py_DECREF(list);
+        return NULL;
+      }
+      PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+  } catch (geonlp::ServiceRequestFormatException& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  } catch (geonlp::IndexNotExistsException& e) {
     PyErr_SetString(PyExc_RuntimeError, e.what());
   }
   return NULL;
 }
 
-static PyObject * geonlp_ma_search_word(GeonlpMA *self, PyObject *args)
-// Search the dictionary by word spelling or reading.
+static PyObject * geonlp_ma_search_word_fuzzy(GeonlpMA *self, PyObject *args, PyObject *kwds)
+// Search the dictionary for the words within the edit distance.
 {
+  static const char *kwlist[] = {"key", "max_distance", "view", NULL};
   char* str;
+  unsigned int max_distance = 1;
+  PyObject *pyview = NULL;
+  geonlp::ActiveViewPtr view;
 
-  PyArg_ParseTuple(args, "s", &str);
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|IO", (char **)kwlist, &str, &max_distance, &pyview)) {
+    return NULL;
+  }
+  if (!__pyobject_to_active_view(pyview, view)) return NULL;
   try {
-    picojson::ext json_obj;
-    std::map<std::string, geonlp::Geoword> results;
-    (self->_ptrObj)->getGeowordEntries(str, results);
-    for (std::map<std::string, geonlp::Geoword>::iterator it = results.begin();
-      it != results.end(); it++) {
-      __alter_geonlpid_fieldname((*it).second);
-      json_obj.set_value((*it).first, (*it).second);
+    std::vector<geonlp::FuzzyMatch> matches;
+    if (view) {
+      (self->_ptrObj)->getGeowordEntriesFuzzy(str, max_distance, matches, *view);
+    } else {
+      (self->_ptrObj)->getGeowordEntriesFuzzy(str, max_distance, matches);
     }
-    return picojson_to_pyobject(json_obj);
+    PyObject* list = PyList_New(matches.size());
+    if (list == NULL) return NULL;
+    for (size_t i = 0; i < matches.size(); i++) {
+      picojson::ext json_obj;
+      std::map<std::string, geonlp::Geoword>& geowords = matches[i].geowords;
+      for (std::map<std::string, geonlp::Geoword>::iterator it = geowords.begin();
+        it != geowords.end(); it++) {
+        __alter_geonlpid_fieldname((*it).second);
+        json_obj.set_value((*it).first, (*it).second);
+      }
+      PyObject* item = Py_BuildValue("(sIN)", matches[i].key.c_str(), matches[i].distance, picojson_to_pyobject(json_obj));
+      if (item == NULL) {
+        Py_DECREF(list);
+        return NULL;
+      }
+      PyList_SET_ITEM(list, i, item);
+    }
+    return list;
   } catch (geonlp::ServiceRequestFormatException& e) {
     PyErr_SetString(PyExc_RuntimeError, e.what());
   } catch (geonlp::IndexNotExistsException& e) {
@@ -320,11 +1158,80 @@ static PyObject * geonlp_ma_set_active_classes(GeonlpMA *self, PyObject *args)
   return Py_None;
 }
 
+static PyObject * geonlp_ma_create_active_view(GeonlpMA *self, PyObject *args, PyObject *kwds)
+// Create an immutable set of active dictionaries and classes
+// from a list of dictionary id (int) and a list of class names,
+// optionally with the period ("YYYY-MM-DD") the geowords must overlap
+{
+  PyObject *pydics, *pyclasses;
+  const char *date_from = NULL, *date_to = NULL;
+  static const char *kwlist[] = {"dictionaries", "classes", "date_from", "date_to", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|zz", (char **)kwlist, &pydics, &pyclasses, &date_from, &date_to)) {
+    return NULL;
+  }
+  int period_from = GEOWORD_DATE_MIN, period_to = GEOWORD_DATE_MAX;
+  if ((date_from && !geonlp::Geoword::parseDate(date_from, period_from))
+      || (date_to && !geonlp::Geoword::parseDate(date_to, period_to))) {
+    PyErr_SetString(PyExc_ValueError, "date_from and date_to must be dates like 'YYYY-MM-DD'.");
+    return NULL;
+  }
+
+  std::vector<int> dic_ids;
+  PyObject *iter = PyObject_GetIter(pydics);
+  if (!iter) {
+    PyErr_SetString(PyExc_TypeError, "dictionaries must be a list of int.");
+    return NULL;
+  }
+  PyObject *next;
+  while ((next = PyIter_Next(iter)) != NULL) {
+    bool is_long = PyLong_Check(next);
+    if (is_long) dic_ids.push_back(int(PyLong_AsLong(next)));
+    Py_DECREF(next);
+    if (!is_long) {
+      Py_DECREF(iter);
+      PyErr_SetString(PyExc_TypeError, "dictionaries must be a list of int values.");
+      return NULL;
+    }
+  }
+  Py_DECREF(iter);
+
+  std::vector<std::string> ne_classes;
+  iter = PyObject_GetIter(pyclasses);
+  if (!iter) {
+    PyErr_SetString(PyExc_TypeError, "classes must be a list of str.");
+    return NULL;
+  }
+  while ((next = PyIter_Next(iter)) != NULL) {
+    const char *str = PyUnicode_Check(next) ? PyUnicode_AsUTF8AndSize(next, NULL) : NULL;
+    if (str) ne_classes.push_back(std::string(str));
+    Py_DECREF(next);
+    if (!str) {
+      Py_DECREF(iter);
+      if (!PyErr_Occurred()) PyErr_SetString(PyExc_TypeError, "classes must be a list of str values.");
+      return NULL;
+    }
+  }
+  Py_DECREF(iter);
+  if (PyErr_Occurred()) return NULL;
+
+  geonlp::ActiveViewPtr view;
+  try {
+    view = (self->_ptrObj)->createActiveView(dic_ids, ne_classes, period_from, period_to);
+  } catch (std::exception & e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return NULL;
+  }
+  geonlp::ActiveViewPtr* holder = new geonlp::ActiveViewPtr(view);
+  PyObject *capsule = PyCapsule_New(holder, ACTIVE_VIEW_CAPSULE_NAME, __active_view_capsule_destructor);
+  if (capsule == NULL) delete holder;
+  return capsule;
+}
+
 static PyObject * geonlp_ma_clear_database(GeonlpMA *self, PyObject *args)
 {
   try {
     (self->_ptrObj)->clearDatabase();
-    return Py_True;
+    Py_RETURN_TRUE;
   } catch (std::exception& e) {
     PyErr_SetString(PyExc_RuntimeError, e.what());
   }
@@ -340,7 +1247,7 @@ static PyObject * geonlp_ma_add_dictionary(GeonlpMA *self, PyObject *args)
   
   try {
     (self->_ptrObj)->addDictionary(jsonfile, csvfile);
-    return Py_True;
+    Py_RETURN_TRUE;
   } catch (std::exception& e) {
     PyErr_SetString(PyExc_RuntimeError, e.what());
   }
@@ -355,24 +1262,185 @@ static PyObject * geonlp_ma_remove_dictionary(GeonlpMA *self, PyObject *args)
   
   try {
     (self->_ptrObj)->removeDictionary(identifier);
-    return Py_True;
+    Py_RETURN_TRUE;
   } catch (std::exception& e) {
     PyErr_SetString(PyExc_RuntimeError, e.what());
   }
   return NULL;
 }
 
-static PyObject * geonlp_ma_update_index(GeonlpMA *self, PyObject *args)
+// 進捗を受け取る Python 関数が例外を送出したことを表す
+class __ProgressCallbackError : public std::runtime_error {
+public:
+  __ProgressCallbackError(): std::runtime_error("The progress callback raised an exception.") {}
+};
+
+static PyObject * geonlp_ma_update_index(GeonlpMA *self, PyObject *args, PyObject *kwds)
+{
+  static const char *kwlist[] = {"progress", NULL};
+  PyObject* progress = Py_None;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", (char **)kwlist, &progress)) {
+    return NULL;
+  }
+  if (progress != Py_None && !PyCallable_Check(progress)) {
+    PyErr_SetString(PyExc_TypeError, "progress must be callable.");
+    return NULL;
+  }
+
+  // 構築中は GIL を解放して他のスレッドの解析を止めず、
+  // progress(phase, done, total) を呼び出すときだけ取得する
+  bool callback_failed = false;
+  geonlp::IndexProgressCallback callback;
+  if (progress != Py_None) {
+    callback = [progress, &callback_failed](const std::string& phase, size_t done, size_t total) {
+      PyGILState_STATE gstate = PyGILState_Ensure();
+      PyObject* result = PyObject_CallFunction(progress, "snn", phase.c_str(), (Py_ssize_t)done, (Py_ssize_t)total);
+      // The error indicator is kept until this function returns
+      if (result == NULL) callback_failed = true;
+      Py_XDECREF(result);
+      PyGILState_Release(gstate);
+      if (callback_failed) throw __ProgressCallbackError();
+    };
+  }
+
+  geonlp::MAPtr ma = self->_ptrObj;
+  std::string errmsg;
+  bool failed = false;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    ma->updateIndex(callback);
+  } catch (std::exception &e) {
+    failed = true;
+    errmsg = e.what();
+  }
+  Py_END_ALLOW_THREADS
+
+  if (callback_failed && PyErr_Occurred()) return NULL;
+  if (failed) {
+    PyErr_SetString(PyExc_RuntimeError, errmsg.c_str());
+    return NULL;
+  }
+  Py_RETURN_TRUE;
+}
+
+static PyObject * geonlp_ma_update_index_incrementally(GeonlpMA *self, PyObject *args)
+{
+  try {
+    (self->_ptrObj)->updateIndexIncrementally();
+    Py_RETURN_TRUE;
+  } catch (std::exception &e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  }
+  return NULL;
+}
+
+static PyObject * geonlp_ma_export_bundle(GeonlpMA *self, PyObject *args)
+{
+  char* filename = NULL;
+
+  if (!PyArg_ParseTuple(args, "s", &filename)) {
+    return NULL;
+  }
+
+  try {
+    (self->_ptrObj)->exportBundle(filename);
+    Py_RETURN_TRUE;
+  } catch (std::exception &e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  }
+  return NULL;
+}
+
+static PyObject * geonlp_ma_get_stats(GeonlpMA *self, PyObject *args)
+// Get the per-stage counters as a dict of dicts
+{
+  std::map<std::string, geonlp::StatsEntry> stats;
+  try {
+    (self->_ptrObj)->getStats(stats);
+  } catch (std::exception &e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return NULL;
+  }
+
+  PyObject *pydict = PyDict_New();
+  if (pydict == NULL) return NULL;
+  for (std::map<std::string, geonlp::StatsEntry>::const_iterator it = stats.begin(); it != stats.end(); it++) {
+    const geonlp::StatsEntry& e = (*it).second;
+    PyObject *entry = Py_BuildValue("{s:K,s:K,s:K,s:K,s:K}",
+                                    "calls", e.calls, "ns", e.ns,
+                                    "hits", e.hits, "misses", e.misses,
+                                    "rows", e.rows);
+    if (entry == NULL || PyDict_SetItemString(pydict, (*it).first.c_str(), entry) < 0) {
+      Py_XDECREF(entry);
+      Py_DECREF(pydict);
+      return NULL;
+    }
+    Py_DECREF(entry);
+  }
+  return pydict;
+}
+
+static PyObject * geonlp_ma_reset_stats(GeonlpMA *self, PyObject *args)
 {
   try {
-    (self->_ptrObj)->updateIndex();
-    return Py_True;
+    (self->_ptrObj)->resetStats();
+    Py_RETURN_NONE;
   } catch (std::exception &e) {
     PyErr_SetString(PyExc_RuntimeError, e.what());
   }
   return NULL;
 }
 
+static PyObject * geonlp_ma_warmup(GeonlpMA *self, PyObject *args)
+// Check all wordlists in advance and return the number of checked wordlists
+{
+  int num = 0;
+  std::string errmsg;
+  bool failed = false;
+
+  // 全ての見出し語を判定する間は GIL を解放する
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    num = (self->_ptrObj)->warmup();
+  } catch (std::exception &e) {
+    errmsg = e.what();
+    failed = true;
+  }
+  Py_END_ALLOW_THREADS
+
+  if (failed) {
+    PyErr_SetString(PyExc_RuntimeError, errmsg.c_str());
+    return NULL;
+  }
+  return PyLong_FromLong(num);
+}
+
+static PyObject * geonlp_ma_get_memory_usage(GeonlpMA *self, PyObject *args)
+// Get the memory usage in bytes of the indexes and caches as a dict
+{
+  std::map<std::string, size_t> usage;
+  try {
+    (self->_ptrObj)->getMemoryUsage(usage);
+  } catch (std::exception &e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return NULL;
+  }
+
+  PyObject *pydict = PyDict_New();
+  if (pydict == NULL) return NULL;
+  for (std::map<std::string, size_t>::const_iterator it = usage.begin(); it != usage.end(); it++) {
+    PyObject *value = PyLong_FromSize_t((*it).second);
+    if (value == NULL || PyDict_SetItemString(pydict, (*it).first.c_str(), value) < 0) {
+      Py_XDECREF(value);
+      Py_DECREF(pydict);
+      return NULL;
+    }
+    Py_DECREF(value);
+  }
+  return pydict;
+}
+
 static PyObject * geonlp_ma_get_dictionary_identifier_by_id(GeonlpMA *self, PyObject *args)
 {
   long dic_id;
@@ -391,21 +1459,213 @@ static PyObject * geonlp_ma_get_dictionary_identifier_by_id(GeonlpMA *self, PyOb
 }
 
 // GeonlpMA object methods
+static bool __pyobject_to_geojson(PyObject *pyobj, picojson::value& geojson)
+// Get the GeoJSON from a str or a decoded dict
+// returns false with TypeError or ValueError if not valid
+{
+  if (PyUnicode_Check(pyobj)) {
+    Py_ssize_t len;
+    const char* str = PyUnicode_AsUTF8AndSize(pyobj, &len);
+    if (str == NULL) return false;
+    std::string err;
+    picojson::parse(geojson, str, str + len, &err);
+    if (!err.empty()) {
+      PyErr_SetString(PyExc_ValueError, (std::string("Cannot parse the geojson: ") + err).c_str());
+      return false;
+    }
+    return true;
+  }
+  if (!PyDict_Check(pyobj)) {
+    PyErr_SetString(PyExc_TypeError, "geojson must be a str or a dict.");
+    return false;
+  }
+  geojson = pyobject_to_picojson(pyobj);
+  return true;
+}
+
+static PyObject * __strings_to_pylist(const std::vector<std::string>& strings)
+// Convert the vector of strings to a list of str
+{
+  PyObject* list = PyList_New(strings.size());
+  if (list == NULL) return NULL;
+  for (size_t i = 0; i < strings.size(); i++) {
+    PyList_SET_ITEM(list, i, PyUnicode_FromString(strings[i].c_str()));
+  }
+  return list;
+}
+
+static PyObject * geonlp_ma_search_box(GeonlpMA *self, PyObject *args, PyObject *kwds)
+// Get the geolod_ids of the words located in the bounding box.
+{
+  static const char *kwlist[] = {"min_lat", "min_lon", "max_lat", "max_lon", "view", NULL};
+  double min_lat, min_lon, max_lat, max_lon;
+  PyObject *pyview = NULL;
+  geonlp::ActiveViewPtr view;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "dddd|O", (char **)kwlist, &min_lat, &min_lon, &max_lat, &max_lon, &pyview)) {
+    return NULL;
+  }
+  if (!__pyobject_to_active_view(pyview, view)) return NULL;
+  try {
+    std::vector<std::string> ids;
+    if (view) {
+      (self->_ptrObj)->getGeowordIdsInBox(min_lat, min_lon, max_lat, max_lon, ids, *view);
+    } else {
+      (self->_ptrObj)->getGeowordIdsInBox(min_lat, min_lon, max_lat, max_lon, ids);
+    }
+    return __strings_to_pylist(ids);
+  } catch (geonlp::ServiceRequestFormatException& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  } catch (geonlp::IndexNotExistsException& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  }
+  return NULL;
+}
+
+static PyObject * geonlp_ma_search_radius(GeonlpMA *self, PyObject *args, PyObject *kwds)
+// Get the geolod_ids of the words located within the radius (km), nearest first.
+{
+  static const char *kwlist[] = {"lat", "lon", "radius", "view", NULL};
+  double lat, lon, radius;
+  PyObject *pyview = NULL;
+  geonlp::ActiveViewPtr view;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "ddd|O", (char **)kwlist, &lat, &lon, &radius, &pyview)) {
+    return NULL;
+  }
+  if (!__pyobject_to_active_view(pyview, view)) return NULL;
+  try {
+    std::vector<std::string> ids;
+    if (view) {
+      (self->_ptrObj)->getGeowordIdsInRadius(lat, lon, radius, ids, *view);
+    } else {
+      (self->_ptrObj)->getGeowordIdsInRadius(lat, lon, radius, ids);
+    }
+    return __strings_to_pylist(ids);
+  } catch (geonlp::ServiceRequestFormatException& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  } catch (geonlp::IndexNotExistsException& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  }
+  return NULL;
+}
+
+static PyObject * geonlp_ma_search_geometry(GeonlpMA *self, PyObject *args, PyObject *kwds)
+// Get the geolod_ids of the words located in the polygon given as GeoJSON.
+{
+  static const char *kwlist[] = {"geojson", "view", NULL};
+  PyObject *pygeojson;
+  PyObject *pyview = NULL;
+  picojson::value geojson;
+  geonlp::ActiveViewPtr view;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", (char **)kwlist, &pygeojson, &pyview)) {
+    return NULL;
+  }
+  if (!__pyobject_to_geojson(pygeojson, geojson)) return NULL;
+  if (!__pyobject_to_active_view(pyview, view)) return NULL;
+  try {
+    std::vector<std::string> ids;
+    if (view) {
+      (self->_ptrObj)->getGeowordIdsInGeometry(geojson, ids, *view);
+    } else {
+      (self->_ptrObj)->getGeowordIdsInGeometry(geojson, ids);
+    }
+    return __strings_to_pylist(ids);
+  } catch (geonlp::ServiceRequestFormatException& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  } catch (geonlp::IndexNotExistsException& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  }
+  return NULL;
+}
+
+static PyObject * geonlp_ma_filter_by_geometry(GeonlpMA *self, PyObject *args, PyObject *kwds)
+// Keep the geolod_ids located inside (or outside) the polygon given as GeoJSON.
+{
+  static const char *kwlist[] = {"geolod_ids", "geojson", "inside", NULL};
+  PyObject *pyids;
+  PyObject *pygeojson;
+  int inside = 1;
+  picojson::value geojson;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|p", (char **)kwlist, &pyids, &pygeojson, &inside)) {
+    return NULL;
+  }
+  if (!__pyobject_to_geojson(pygeojson, geojson)) return NULL;
+  PyObject *seq = PySequence_Fast(pyids, "geolod_ids must be a sequence of str.");
+  if (seq == NULL) return NULL;
+  std::vector<std::string> ids;
+  Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+  ids.reserve(n);
+  for (Py_ssize_t i = 0; i < n; i++) {
+    PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+    const char* str = PyUnicode_Check(item) ? PyUnicode_AsUTF8AndSize(item, NULL) : NULL;
+    if (str == NULL) {
+      Py_DECREF(seq);
+      if (!PyErr_Occurred()) PyErr_SetString(PyExc_TypeError, "geolod_ids must be a sequence of str.");
+      return NULL;
+    }
+    ids.push_back(str);
+  }
+  Py_DECREF(seq);
+
+  std::vector<std::string> passed;
+  std::string errmsg;
+  bool failed = false;
+
+  // 地名語テーブルを参照することがあるので、判定中は GIL を解放する
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    (self->_ptrObj)->filterGeowordIdsByGeometry(ids, geojson, inside != 0, passed);
+  } catch (std::exception & e) {
+    errmsg = e.what();
+    failed = true;
+  }
+  Py_END_ALLOW_THREADS
+
+  if (failed) {
+    PyErr_SetString(PyExc_RuntimeError, errmsg.c_str());
+    return NULL;
+  }
+  return __strings_to_pylist(passed);
+}
+
 static PyMethodDef GeonlpMAMethods[] = {
   {"parse", (PyCFunction)geonlp_ma_parse, METH_VARARGS, "Parse the sentence and return a formatted text."},
-  {"parseNode", (PyCFunction)geonlp_ma_parse_node, METH_VARARGS, "Parse the sentece and return list of dict."},
+  {"parseNode", (PyCFunction)(void(*)(void))geonlp_ma_parse_node, METH_VARARGS | METH_KEYWORDS, "Parse the sentece and return list of dict, or a tuple of lists if columnar=True, using the view if given."},
+  {"parseLattice", (PyCFunction)(void(*)(void))geonlp_ma_parse_lattice, METH_VARARGS | METH_KEYWORDS, "Parse the sentence and return a tuple of the list of nodes and the list of their candidate geowords, in the active dictionaries and classes or in the view."},
+  {"parseNodeBatch", (PyCFunction)(void(*)(void))geonlp_ma_parse_node_batch, METH_VARARGS | METH_KEYWORDS, "Parse the list of sentences in worker threads and return list of lists of dict."},
+  {"parseNodeStream", (PyCFunction)(void(*)(void))geonlp_ma_parse_node_stream, METH_VARARGS | METH_KEYWORDS, "Parse the text from an iterable of chunks sentence by sentence, calling callback(nodes, offset)."},
+  {"parseNodeAsync", (PyCFunction)(void(*)(void))geonlp_ma_parse_node_async, METH_VARARGS | METH_KEYWORDS, "Parse the sentence in the worker pool, then call callback(nodes, error) from the worker thread."},
+  {"parseStream", (PyCFunction)(void(*)(void))geonlp_ma_parse_stream, METH_VARARGS | METH_KEYWORDS, "Parse the text from an iterable of chunks and pass the formatted text to write(str)."},
   {"getWordInfo", (PyCFunction)geonlp_ma_get_word_info, METH_VARARGS, "Get word information."},
-  {"searchWord", (PyCFunction)geonlp_ma_search_word, METH_VARARGS, "Search word by its spelling or reading."},
+  {"searchWord", (PyCFunction)(void(*)(void))geonlp_ma_search_word, METH_VARARGS | METH_KEYWORDS, "Search word by its spelling or reading, in the active dictionaries and classes or in the view."},
+  {"searchYomi", (PyCFunction)geonlp_ma_search_yomi, METH_VARARGS, "Search word by its reading, in the active dictionaries and classes."},
+  {"searchYomiPrefix", (PyCFunction)geonlp_ma_search_yomi_prefix, METH_VARARGS, "Search all the readings matching the beginning of the text, and return list of (reading, dict) tuples."},
+  {"searchWordFuzzy", (PyCFunction)(void(*)(void))geonlp_ma_search_word_fuzzy, METH_VARARGS | METH_KEYWORDS, "Search words within max_distance edits of the key, and return list of (key, distance, dict) tuples."},
+  {"searchBox", (PyCFunction)(void(*)(void))geonlp_ma_search_box, METH_VARARGS | METH_KEYWORDS, "Get list of geolod_ids of the words located in the bounding box, in the active dictionaries and classes or in the view."},
+  {"searchRadius", (PyCFunction)(void(*)(void))geonlp_ma_search_radius, METH_VARARGS | METH_KEYWORDS, "Get list of geolod_ids of the words within the radius (km) from the point, nearest first."},
+  {"searchGeometry", (PyCFunction)(void(*)(void))geonlp_ma_search_geometry, METH_VARARGS | METH_KEYWORDS, "Get list of geolod_ids of the words located in the Polygon or MultiPolygon given as GeoJSON."},
+  {"filterByGeometry", (PyCFunction)(void(*)(void))geonlp_ma_filter_by_geometry, METH_VARARGS | METH_KEYWORDS, "Keep the geolod_ids located inside the GeoJSON polygon, or outside if inside=False."},
+  {"complete", (PyCFunction)(void(*)(void))geonlp_ma_complete, METH_VARARGS | METH_KEYWORDS, "Get the top-k completions of the prefix as list of dict with surface, score and geolod_ids."},
   {"getDictionaryList", (PyCFunction)geonlp_ma_list_dictionary, METH_NOARGS, "Get installed dictionary list."},
   {"getDictionaryInfo", (PyCFunction)geonlp_ma_get_dictionary_info, METH_VARARGS, "Get dictionary information."},
   {"getActiveDictionaries", (PyCFunction)geonlp_ma_get_active_dictionaries, METH_NOARGS, "Get active dictionaries."},
   {"setActiveDictionaries", (PyCFunction)geonlp_ma_set_active_dictionaries, METH_VARARGS, "Set active dictionaries."},
   {"getActiveClasses", (PyCFunction)geonlp_ma_get_active_classes, METH_NOARGS, "Get active NE classes."},
   {"setActiveClasses", (PyCFunction)geonlp_ma_set_active_classes, METH_VARARGS, "Set active NE classes."},
+  {"createActiveView", (PyCFunction)(void(*)(void))geonlp_ma_create_active_view, METH_VARARGS | METH_KEYWORDS, "Create an immutable view of dictionaries, NE classes and an optional period to pass to parseNode and searchWord as view."},
   {"clearDatabase", (PyCFunction)geonlp_ma_clear_database, METH_NOARGS, "Clear database."},
   {"addDictionary", (PyCFunction)geonlp_ma_add_dictionary, METH_VARARGS, "Add a dictionary to the database by importing files containing JSON metadata and CSV data."},
   {"removeDictionary", (PyCFunction)geonlp_ma_remove_dictionary, METH_VARARGS, "Remove the dictionary from the database specified by its identifier."},
-  {"updateIndex", (PyCFunction)geonlp_ma_update_index, METH_NOARGS, "Update index of the database."},
+  {"updateIndex", (PyCFunction)geonlp_ma_update_index, METH_VARARGS|METH_KEYWORDS, "Update index of the database, calling progress(phase, done, total) if given."},
+  {"updateIndexIncrementally", (PyCFunction)geonlp_ma_update_index_incrementally, METH_NOARGS, "Add dictionaries not yet indexed to the index."},
+  {"exportBundle", (PyCFunction)geonlp_ma_export_bundle, METH_VARARGS, "Export the dictionaries and the index to a read-only bundle file."},
+  {"getStats", (PyCFunction)geonlp_ma_get_stats, METH_NOARGS, "Get the per-stage counters as a dict, empty unless the stats option is true."},
+  {"resetStats", (PyCFunction)geonlp_ma_reset_stats, METH_NOARGS, "Reset the per-stage counters to zero."},
+  {"warmup", (PyCFunction)geonlp_ma_warmup, METH_NOARGS, "Check all wordlists for active geowords in advance."},
+  {"getMemoryUsage", (PyCFunction)geonlp_ma_get_memory_usage, METH_NOARGS, "Get the memory usage in bytes of the indexes and caches as a dict."},
   {"getDictionaryIdentifierById", (PyCFunction)geonlp_ma_get_dictionary_identifier_by_id, METH_VARARGS, "Get dictionary identifier from its internel id."},
   {NULL, NULL, 0, NULL} // Sentinel
 };
@@ -420,8 +1680,138 @@ static PyObject * geonlp_module_version(PyObject *self)
   return Py_BuildValue("s", PACKAGE_VERSION, 1);
 }
 
+// ノード間のスコアを計算する Python 関数が例外を送出したことを表す
+class __RelationCallbackError : public std::runtime_error {
+public:
+  __RelationCallbackError(): std::runtime_error("The relation callback raised an exception.") {}
+};
+
+static PyObject * geonlp_module_search_best_paths(PyObject *self, PyObject *args, PyObject *kwds)
+// Search the top-N paths in the lattice features by beam search.
+{
+  static const char *kwlist[] = {"lattice", "relation", "nlookup", "beam_width", "max_results", NULL};
+  PyObject *pylattice, *relation;
+  int nlookup = 5;
+  Py_ssize_t beam_width = 32, max_results = 5;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|inn", (char **)kwlist, &pylattice, &relation, &nlookup, &beam_width, &max_results)) {
+    return NULL;
+  }
+  if (!PyCallable_Check(relation)) {
+    PyErr_SetString(PyExc_TypeError, "relation must be callable.");
+    return NULL;
+  }
+  if (beam_width < 1 || max_results < 0) {
+    PyErr_SetString(PyExc_ValueError, "beam_width must be positive and max_results must not be negative.");
+    return NULL;
+  }
+
+  // 位置ごとの (node_type, next, ne_class, address_levels) の列をラティスに変換する
+  std::vector<std::vector<geonlp::PathNode> > lattice;
+  PyObject* positions = PySequence_Fast(pylattice, "lattice must be a sequence.");
+  if (positions == NULL) return NULL;
+  for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(positions); i++) {
+    PyObject* candidates = PySequence_Fast(PySequence_Fast_GET_ITEM(positions, i), "Each position must be a sequence.");
+    if (candidates == NULL) {
+      Py_DECREF(positions);
+      return NULL;
+    }
+    std::vector<geonlp::PathNode> nodes;
+    for (Py_ssize_t j = 0; j < PySequence_Fast_GET_SIZE(candidates); j++) {
+      int type, ne_class, levels;
+      Py_ssize_t next;
+      if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(candidates, j), "inii", &type, &next, &ne_class, &levels)) {
+        Py_DECREF(candidates);
+        Py_DECREF(positions);
+        return NULL;
+      }
+      nodes.push_back(geonlp::PathNode(type, next < 0 ? 0 : (size_t)next, ne_class, levels));
+    }
+    Py_DECREF(candidates);
+    lattice.push_back(nodes);
+  }
+  Py_DECREF(positions);
+
+  // 探索中は GIL を保持したまま、 relation(pos0, index0, pos1, index1) を呼び出す
+  geonlp::RelationScoreFunc func = [relation](size_t pos0, size_t index0, size_t pos1, size_t index1) {
+    PyObject* result = PyObject_CallFunction(relation, "nnnn", (Py_ssize_t)pos0, (Py_ssize_t)index0, (Py_ssize_t)pos1, (Py_ssize_t)index1);
+    if (result == NULL) throw __RelationCallbackError();
+    long score = PyLong_AsLong(result);
+    Py_DECREF(result);
+    if (score == -1 && PyErr_Occurred()) throw __RelationCallbackError();
+    return (int)score;
+  };
+
+  std::vector<geonlp::PathResult> results;
+  try {
+    geonlp::PathSearch search(lattice, func, nlookup, (size_t)beam_width);
+    search.search((size_t)max_results, results);
+  } catch (__RelationCallbackError &e) {
+    if (!PyErr_Occurred()) PyErr_SetString(PyExc_RuntimeError, e.what());
+    return NULL;
+  } catch (std::exception &e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return NULL;
+  }
+
+  // [(score, [(pos, index), ...]), ...] の形で返す
+  PyObject* list = PyList_New(results.size());
+  if (list == NULL) return NULL;
+  for (size_t i = 0; i < results.size(); i++) {
+    PyObject* nodes = PyList_New(results[i].nodes.size());
+    if (nodes == NULL) {
+      Py_DECREF(list);
+      return NULL;
+    }
+    for (size_t j = 0; j < results[i].nodes.size(); j++) {
+      PyList_SET_ITEM(nodes, j, Py_BuildValue("(nn)", (Py_ssize_t)results[i].nodes[j].first, (Py_ssize_t)results[i].nodes[j].second));
+    }
+    PyList_SET_ITEM(list, i, Py_BuildValue("(iN)", results[i].score, nodes));
+  }
+  return list;
+}
+
+static PyObject * geonlp_module_find_address_spans(PyObject *self, PyObject *args, PyObject *kwds)
+// Find the spans of the lattice that can be addresses.
+{
+  static const char *kwlist[] = {"tokens", NULL};
+  PyObject *pytokens;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", (char **)kwlist, &pytokens)) {
+    return NULL;
+  }
+
+  // 位置ごとの (surface, pos, subclass1, geoword, head) の列を変換する
+  std::vector<geonlp::AddressToken> tokens;
+  PyObject* positions = PySequence_Fast(pytokens, "tokens must be a sequence.");
+  if (positions == NULL) return NULL;
+  for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(positions); i++) {
+    const char *surface, *pos, *subclass1;
+    int geoword, head;
+    if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(positions, i), "sssii", &surface, &pos, &subclass1, &geoword, &head)) {
+      Py_DECREF(positions);
+      return NULL;
+    }
+    tokens.push_back(geonlp::AddressToken(surface, pos, subclass1, geoword != 0, head));
+  }
+  Py_DECREF(positions);
+
+  std::vector<geonlp::AddressSpan> spans;
+  geonlp::findAddressSpans(tokens, spans);
+
+  // [(begin, end), ...] の形で返す
+  PyObject* list = PyList_New(spans.size());
+  if (list == NULL) return NULL;
+  for (size_t i = 0; i < spans.size(); i++) {
+    PyList_SET_ITEM(list, i, Py_BuildValue("(nn)", (Py_ssize_t)spans[i].begin, (Py_ssize_t)spans[i].end));
+  }
+  return list;
+}
+
 static PyMethodDef GeonlpModuleMethods[] = {
   {"version", (PyCFunction)geonlp_module_version, METH_NOARGS, "Show the version"},
+  {"searchBestPaths", (PyCFunction)(void(*)(void))geonlp_module_search_best_paths, METH_VARARGS | METH_KEYWORDS, "Get the top-N paths of the lattice features by beam search as list of (score, [(pos, index), ...])."},
+  {"findAddressSpans", (PyCFunction)(void(*)(void))geonlp_module_find_address_spans, METH_VARARGS | METH_KEYWORDS, "Get the spans of the lattice tokens that can be addresses as list of (begin, end)."},
   {NULL, NULL, 0, NULL} // Sentinel
 };
 
@@ -472,6 +1862,20 @@ PyInit_capi (void)
   // Add GeonlpMA Object to the module
   Py_INCREF(&GeonlpMAType);
   PyModule_AddObject(m, "MA", (PyObject *)&GeonlpMAType);
+
+  // Intern the keys of the node dict, and publish the field order
+  // of the columnar results as NODE_FIELDS
+  PyObject *node_fields = PyTuple_New(NUM_NODE_FIELDS);
+  if (node_fields == NULL)
+    return NULL;
+  for (Py_ssize_t i = 0; i < NUM_NODE_FIELDS; i++) {
+    __node_field_keys[i] = PyUnicode_InternFromString(__node_fields[i].name);
+    if (__node_field_keys[i] == NULL)
+      return NULL;
+    Py_INCREF(__node_field_keys[i]);
+    PyTuple_SET_ITEM(node_fields, i, __node_field_keys[i]);
+  }
+  PyModule_AddObject(m, "NODE_FIELDS", node_fields);
   
   return m;
 }
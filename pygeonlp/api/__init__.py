@@ -504,6 +504,35 @@ def analyze(sentence, **kwargs):
     return _default_workflow.parser.analyze(sentence, **kwargs)
 
 
+async def analyze_async(sentence, **kwargs):
+    """
+    analyze の非同期版です。形態素解析を待つ間はイベントループに
+    制御を戻すため、複数の文を ``asyncio.gather`` で同時に解析できます。
+
+    Parameters
+    ----------
+    sentence : str
+        解析するテキスト。
+
+    Returns
+    -------
+    list
+        analyze と同じラティス表現。
+
+    Examples
+    --------
+    >>> import asyncio
+    >>> import pygeonlp.api as api
+    >>> api.init()
+    >>> lattice = asyncio.run(api.analyze_async('和歌山市は晴れ。'))
+    >>> [[x.as_dict() for x in nodes] for nodes in lattice] == [
+    ...     [x.as_dict() for x in nodes] for nodes in api.analyze('和歌山市は晴れ。')]
+    True
+    """
+    _check_initialized()
+    return await _default_workflow.parser.analyze_async(sentence, **kwargs)
+
+
 def geoparse(sentence):
     """
     Default Workflow を利用して文を解析した結果を、
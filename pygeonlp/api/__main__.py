@@ -23,10 +23,16 @@ Usage:
   {p} remove-dictionary [--db-dir=<dir>] <id>
   {p} download-dictionary [--db-dir=<dir>] <url> <json-path> <csv-path>
   {p} setup [--db-dir=<dir>] [<dict-src-dir>]
+  {p} bench [--db-dir=<dir>] [--workers=<n>] [--mode=<mode>] [--repeat=<n>] [--no-geocoder] [--output=<path>] <corpus-path>
 
 Options:
   -h --help           Show this help.
   --db-dir=<dir>      Specify the database directory.
+  --workers=<n>       Number of worker threads or processes [default: 1].
+  --mode=<mode>       'thread' or 'process' [default: thread].
+  --repeat=<n>        Number of times to process the corpus [default: 1].
+  --no-geocoder       Do not use jageocoder for address geocoding.
+  --output=<path>     Save the results as JSON ('-' for stdout).
 
 Examples:
 
@@ -50,6 +56,9 @@ Examples:
 
 - ウェブから辞書をダウンロードし、JSONおよびCSVファイルに保存します
   python -m {p} download-dictionary https://geonlp.ex.nii.ac.jp/dictionary/geoshape-city/ geoshape.json geoshape.csv
+
+- 1 行 1 文のコーパスを 4 プロセスでジオパースし、処理性能を JSON に保存します
+  python -m {p} bench --workers=4 --mode=process --output=bench.json corpus.txt
 """.format(p='pygeonlp.api')
 
 
@@ -182,4 +191,21 @@ if __name__ == '__main__':
         manager.setupBasicDatabase(src_dir=src_dir)
         exit(0)
 
+    if args['bench']:
+        from pygeonlp.api import bench
+        report = bench.run_benchmark(
+            bench.read_corpus(args['<corpus-path>']),
+            db_dir=db_dir,
+            workers=int(args['--workers']),
+            mode=args['--mode'],
+            repeat=int(args['--repeat']),
+            jageocoder=False if args['--no-geocoder'] else None)
+        if args['--output'] != '-':
+            bench.print_report(report)
+
+        if args['--output']:
+            bench.save_report(report, args['--output'])
+
+        exit(0)
+
     raise RuntimeError('Unexpected args: {}'.format(args))
@@ -0,0 +1,346 @@
+import json
+import logging
+import math
+import multiprocessing
+import platform
+import resource
+import sys
+import threading
+import time
+
+from pygeonlp import capi
+from pygeonlp.api.workflow import Workflow
+
+logger = logging.getLogger(__name__)
+
+# 計測する処理段階、 Workflow.geoparse() の処理順
+STAGES = ('parse', 'filter', 'address', 'link', 'output')
+
+
+def read_corpus(path):
+    """
+    コーパスファイルを読み込み、空行を除いた文のリストを返します。
+
+    Parameters
+    ----------
+    path : PathLike
+        1 行に 1 文を記述した UTF-8 のテキストファイル。
+
+    Returns
+    -------
+    list
+        文字列のリスト。
+    """
+    with open(path, 'r', encoding='utf-8') as f:
+        return [line.rstrip('\r\n') for line in f if line.strip() != '']
+
+
+def geoparse_with_timings(workflow, sentence):
+    """
+    ``Workflow.geoparse()`` と同じ処理を行い、処理段階ごとの時間を計測します。
+
+    Parameters
+    ----------
+    workflow : pygeonlp.api.workflow.Workflow
+        利用するワークフロー。
+    sentence : str
+        解析する文字列。
+
+    Returns
+    -------
+    (list, dict)
+        GeoJSON Feature 形式に変換可能な dict のリストと、
+        処理段階の名前をキー、経過時間（秒）を値とする dict。
+    """
+    timings = {}
+    t0 = time.perf_counter()
+    lattice = workflow.parser.analyze_sentence(sentence)
+    t1 = time.perf_counter()
+    timings['parse'] = t1 - t0
+
+    for f in workflow.filters:
+        lattice = f(lattice)
+
+    t2 = time.perf_counter()
+    timings['filter'] = t2 - t1
+
+    lattice = workflow.parser.add_address_candidates(lattice)
+    t3 = time.perf_counter()
+    timings['address'] = t3 - t2
+
+    results = []
+    for lattice_part in workflow.get_processible_lattice_part(lattice):
+        if len(lattice_part) < 1:
+            continue
+
+        results += workflow.evaluator.get(lattice_part)
+
+    t4 = time.perf_counter()
+    timings['link'] = t4 - t3
+
+    features = []
+    for result in results:
+        for node in result['result']:
+            features.append(node.as_geojson())
+
+    timings['output'] = time.perf_counter() - t4
+    return features, timings
+
+
+def _peak_rss_kb():
+    """
+    このプロセスの最大常駐セットサイズ（KB）を返します。
+    """
+    rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    if sys.platform == 'darwin':
+        rss //= 1024  # macOS ではバイト単位
+
+    return rss
+
+
+def _run_sentences(workflow, sentences, repeat):
+    """
+    文のリストを解析し、文ごとの処理時間を計測します。
+
+    Returns
+    -------
+    dict
+        latencies （文ごとの経過時間、秒）, stages （処理段階ごとの
+        累積時間、秒）, start, end （処理を開始・終了した時刻）を持つ dict。
+    """
+    latencies = []
+    stages = dict((name, 0.0) for name in STAGES)
+    start = time.time()
+    for _ in range(repeat):
+        for sentence in sentences:
+            t = time.perf_counter()
+            _, timings = geoparse_with_timings(workflow, sentence)
+            latencies.append(time.perf_counter() - t)
+            for name, sec in timings.items():
+                stages[name] += sec
+
+    return {
+        'latencies': latencies,
+        'stages': stages,
+        'start': start,
+        'end': time.time(),
+    }
+
+
+def _create_workflow(db_dir, jageocoder):
+    """
+    計測を有効にしたワークフローを作成します。
+    """
+    workflow = Workflow(db_dir=db_dir, jageocoder=jageocoder, stats=True)
+    workflow.parser.service.resetStats()
+    return workflow
+
+
+def _process_worker(args):
+    """
+    作業プロセスでワークフローを作成し、割り当てられた文を解析します。
+    """
+    db_dir, jageocoder, sentences, repeat = args
+    t = time.perf_counter()
+    workflow = _create_workflow(db_dir, jageocoder)
+    init_sec = time.perf_counter() - t
+    result = _run_sentences(workflow, sentences, repeat)
+    result['init_sec'] = init_sec
+    result['native_stats'] = workflow.parser.service.getStats()
+    result['peak_rss_kb'] = _peak_rss_kb()
+    return result
+
+
+def _merge_native_stats(stats_list):
+    """
+    プロセスごとの ``Service.getStats()`` の値を合計します。
+    """
+    merged = {}
+    for stats in stats_list:
+        for name, entry in stats.items():
+            total = merged.setdefault(name, {})
+            for key, value in entry.items():
+                total[key] = total.get(key, 0) + value
+
+    return merged
+
+
+def _percentile(sorted_values, p):
+    """
+    昇順に並べた値の p パーセンタイル（最近傍法）を返します。
+    """
+    if len(sorted_values) == 0:
+        return 0.0
+
+    k = int(math.ceil(p / 100.0 * len(sorted_values))) - 1
+    return sorted_values[max(0, min(len(sorted_values) - 1, k))]
+
+
+def run_benchmark(sentences, db_dir=None, workers=1, mode='thread',
+                  repeat=1, jageocoder=None):
+    """
+    文のリストをジオパースのパイプライン全体で処理し、性能を計測します。
+
+    Parameters
+    ----------
+    sentences : list
+        解析する文字列のリスト。
+    db_dir : PathLike, optional
+        データベースディレクトリ。
+        省略した場合は ``api.init.get_db_dir()`` が返す値を利用します。
+    workers : int, optional
+        並行して処理するスレッドまたはプロセスの数。デフォルトは 1 です。
+    mode : str, optional
+        'thread' の場合は一つのワークフローを複数のスレッドで共有し、
+        'process' の場合はプロセスごとにワークフローを作成します。
+    repeat : int, optional
+        文のリストを処理する回数。デフォルトは 1 です。
+    jageocoder : jageocoder.tree.AddressTree, optional
+        ``Workflow`` に渡す住所ジオコーダー。
+        False を指定した場合、住所ジオコーディングを行いません。
+
+    Returns
+    -------
+    dict
+        計測結果。 JSON に変換できる値だけを含みます。
+        sentences_per_sec （スループット）, latency_ms （文ごとの経過時間の
+        平均、 50/90/99 パーセンタイル、最大）, stages （処理段階ごとの
+        累積時間と平均）, native_stats （``Service.getStats()`` の合計）,
+        peak_rss_kb （最大常駐セットサイズ）などを持ちます。
+    """
+    if workers < 1:
+        raise ValueError("workers には 1 以上の値を指定してください。")
+
+    if mode not in ('thread', 'process'):
+        raise ValueError("mode には 'thread' または 'process' を指定してください。")
+
+    chunks = [sentences[i::workers] for i in range(workers)]
+    if mode == 'process':
+        with multiprocessing.Pool(workers) as pool:
+            results = pool.map(
+                _process_worker,
+                [(db_dir, jageocoder, chunk, repeat) for chunk in chunks])
+
+        init_sec = max(r['init_sec'] for r in results)
+        native_stats = _merge_native_stats(
+            [r['native_stats'] for r in results])
+        peak_rss_kb = max(r['peak_rss_kb'] for r in results)
+    else:
+        t = time.perf_counter()
+        workflow = _create_workflow(db_dir, jageocoder)
+        init_sec = time.perf_counter() - t
+        results = [None] * workers
+
+        def run(i):
+            results[i] = _run_sentences(workflow, chunks[i], repeat)
+
+        threads = [threading.Thread(target=run, args=(i,))
+                   for i in range(workers)]
+        for thread in threads:
+            thread.start()
+
+        for thread in threads:
+            thread.join()
+
+        if any(r is None for r in results):
+            raise RuntimeError("スレッドの処理中に例外が発生しました。")
+
+        native_stats = workflow.parser.service.getStats()
+        peak_rss_kb = _peak_rss_kb()
+
+    latencies = sorted(x for r in results for x in r['latencies'])
+    elapsed = max(r['end'] for r in results) - min(r['start'] for r in results)
+    count = len(latencies)
+    stages = {}
+    for name in STAGES:
+        total = sum(r['stages'][name] for r in results)
+        stages[name] = {
+            'total_sec': total,
+            'mean_ms': total * 1000.0 / count if count > 0 else 0.0,
+        }
+
+    return {
+        'version': capi.version(),
+        'python': platform.python_version(),
+        'mode': mode,
+        'workers': workers,
+        'repeat': repeat,
+        'sentences': count,
+        'init_sec': init_sec,
+        'elapsed_sec': elapsed,
+        'sentences_per_sec': count / elapsed if elapsed > 0 else 0.0,
+        'latency_ms': {
+            'mean': sum(latencies) * 1000.0 / count if count > 0 else 0.0,
+            'p50': _percentile(latencies, 50) * 1000.0,
+            'p90': _percentile(latencies, 90) * 1000.0,
+            'p99': _percentile(latencies, 99) * 1000.0,
+            'max': (latencies[-1] if count > 0 else 0.0) * 1000.0,
+        },
+        'stages': stages,
+        'native_stats': native_stats,
+        'peak_rss_kb': peak_rss_kb,
+    }
+
+
+def print_report(report, file=None):
+    """
+    ``run_benchmark()`` の計測結果を読みやすい形式で出力します。
+
+    Parameters
+    ----------
+    report : dict
+        ``run_benchmark()`` が返す計測結果。
+    file : file descriptor, optional
+        出力先のファイルデスクリプタ。デフォルトは None です。
+    """
+    print("pygeonlp {} (Python {}), {} x {}".format(
+        report['version'], report['python'],
+        report['workers'], report['mode']), file=file)
+    print("sentences: {}, elapsed: {:.3f} sec, init: {:.3f} sec".format(
+        report['sentences'], report['elapsed_sec'], report['init_sec']),
+        file=file)
+    print("throughput: {:.1f} sentences/sec".format(
+        report['sentences_per_sec']), file=file)
+    latency = report['latency_ms']
+    print("latency (ms): mean {:.3f}, p50 {:.3f}, p90 {:.3f}, "
+          "p99 {:.3f}, max {:.3f}".format(
+              latency['mean'], latency['p50'], latency['p90'],
+              latency['p99'], latency['max']), file=file)
+    print("stages:", file=file)
+    for name in STAGES:
+        stage = report['stages'][name]
+        print("  {:<8} {:10.3f} sec {:10.3f} ms/sentence".format(
+            name, stage['total_sec'], stage['mean_ms']), file=file)
+
+    if report['native_stats']:
+        print("native stats:", file=file)
+        for name in sorted(report['native_stats'].keys()):
+            entry = report['native_stats'][name]
+            print("  {:<24} calls {:8d} {:10.3f} ms "
+                  "hits {:8d} misses {:8d} rows {:8d}".format(
+                      name, entry['calls'], entry['ns'] / 1e6,
+                      entry['hits'], entry['misses'], entry['rows']),
+                  file=file)
+
+    print("peak RSS: {} KB".format(report['peak_rss_kb']), file=file)
+
+
+def save_report(report, path):
+    """
+    ``run_benchmark()`` の計測結果を JSON ファイルに保存します。
+    リリース間の比較などに利用します。
+
+    Parameters
+    ----------
+    report : dict
+        ``run_benchmark()`` が返す計測結果。
+    path : PathLike
+        出力先のファイル。 '-' の場合は標準出力に出力します。
+    """
+    if path == '-':
+        json.dump(report, sys.stdout, ensure_ascii=False, indent=2)
+        print()
+        return
+
+    with open(path, 'w', encoding='utf-8') as f:
+        json.dump(report, f, ensure_ascii=False, indent=2)
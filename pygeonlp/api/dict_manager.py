@@ -28,7 +28,8 @@ class DictManager(object):
     """
 
     def __init__(self,
-                 db_dir: Union[str, bytes, os.PathLike, None] = None):
+                 db_dir: Union[str, bytes, os.PathLike, None] = None,
+                 options: Union[dict, None] = None):
         """
         このサービスが利用する辞書や、各種設定を初期化します。
 
@@ -37,9 +38,69 @@ class DictManager(object):
         db_dir : PathLike, optional
             利用するデータベースディレクトリのパス。
             省略した場合は ``api.get_db_dir()`` で決定します。
+        options : dict, optional
+            インデックス構築方法を指定します。
+
+            index_build_threads : int
+                地名語を解析するスレッド数を指定します。
+                0 を指定すると CPU 数のスレッドを利用します。
+                デフォルト値は 1 です。
+
+            index_build_memory : int
+                構築中にメモリ上に保持する見出し語の上限を MB で指定します。
+                上限を超えた分は一時ファイルに書き出して最後に併合するため、
+                大量の地名語を登録してもメモリ消費が増えません。
+                デフォルト値は 0 （無制限）です。
+
+            どちらかを指定した場合、並列・一時ファイル併合で構築します。
+            構築結果は指定しない場合と同じです。
+
+            import_threads : int
+                辞書 CSV の行を地名語に変換するスレッド数を指定します。
+                0 を指定すると CPU 数のスレッドを利用します。
+                デフォルト値は 1 です。
+
+            import_fast : bool
+                True の場合、辞書の読み込み中はデータベースのジャーナルと
+                同期書き込みを止め、索引を最後に作り直します。
+                読み込み中に中断すると途中までの地名語が残ることがあります。
+                デフォルト値は False です。
+
+            どちらかを指定した場合、 CSV ファイルを mmap で読み込み、
+            行の変換とデータベースへの登録を並行して行います。
+            登録結果は指定しない場合と同じです。
+
+            geoword_record : bool
+                True の場合、地名語の JSON に加えて、表記・読み・辞書・
+                固有名クラス・経緯度・有効期間などの主要項目を
+                バイナリレコードとして保存します。
+                既存のデータベースは開いた時に変換されます。
+                形態素解析中はバイナリレコードを参照するため、
+                JSON の解析が不要になります。
+                一度変換したデータベースは、このオプションを指定しなくても
+                バイナリレコードを維持します。
+                デフォルト値は False です。
         """
         self._dict_cache = {}
         self.capi_ma = None
+        self.options = {}
+
+        for key, value in (options or {}).items():
+            if key in ('index_build_threads', 'index_build_memory',
+                       'import_threads'):
+                if not isinstance(value, int) or isinstance(value, bool) \
+                        or value < 0:
+                    raise TypeError(
+                        "'{}' は 0 以上の整数で指定してください。".format(key))
+            elif key in ('import_fast', 'geoword_record'):
+                if not isinstance(value, bool):
+                    raise TypeError(
+                        "'{}' は True または False で指定してください。".format(
+                            key))
+            else:
+                raise ValueError("オプション '{}' は指定できません。".format(key))
+
+            self.options[key] = value
 
         if db_dir is None:
             from . import get_db_dir
@@ -55,6 +116,7 @@ class DictManager(object):
         # capi_ma オブジェクトを作成
         if self.capi_ma is None:
             capi_options = {'data_dir': str(self.db_dir)}
+            capi_options.update(self.options)
             self.capi_ma = capi.MA(capi_options)
 
     def getDictionary(self, id_or_identifier):
@@ -346,10 +408,23 @@ class DictManager(object):
         ret = self.capi_ma.removeDictionary(identifier)
         return ret
 
-    def updateIndex(self):
+    def updateIndex(self, incremental=False, progress=None):
         """
         辞書のインデックスを更新して検索可能にします。
 
+        Parameters
+        ----------
+        incremental : bool, optional
+            True の場合、まだインデックスに登録されていない辞書だけを追加します。
+            追加する辞書の大きさに比例する時間で更新できますが、
+            インデックスが差分更新に対応しない場合は全体を再構築します。
+            差分はここで False を指定して更新した時に本体に統合されます。
+        progress : callable, optional
+            全体を再構築する場合の進捗を受け取る関数を指定します。
+            段階名（'scan', 'merge', 'darts'）、処理済みの件数、
+            全体の件数を引数として呼び出されます。
+            関数が例外を送出すると更新を中止します。
+
         Examples
         --------
         >>> from pygeonlp.api.dict_manager import DictManager
@@ -362,7 +437,39 @@ class DictManager(object):
         True
         """
         self._check_initialized()
-        return self.capi_ma.updateIndex()
+        if incremental:
+            return self.capi_ma.updateIndexIncrementally()
+
+        return self.capi_ma.updateIndex(progress=progress)
+
+    def exportBundle(self, filename):
+        """
+        辞書、地名語、インデックスを一つの参照専用バンドルファイルに
+        書き出します。
+
+        バンドルファイルは mmap で開くため、解析サービスの起動が速く、
+        解析中にデータベースを参照しません。 ``Service`` の
+        ``bundle`` オプションにファイル名を指定すると利用できます。
+        辞書を更新した場合は ``updateIndex()`` の後に書き出し直してください。
+
+        Parameters
+        ----------
+        filename : PathLike
+            書き出すファイル名。既存のファイルは置き換えられますが、
+            置き換え前に開いているプロセスは旧ファイルを参照し続けます。
+
+        Examples
+        --------
+        >>> import os
+        >>> import tempfile
+        >>> from pygeonlp.api.dict_manager import DictManager
+        >>> manager = DictManager()
+        >>> with tempfile.TemporaryDirectory() as tmpdir:
+        ...     manager.exportBundle(os.path.join(tmpdir, 'geonlp.bundle'))
+        True
+        """
+        self._check_initialized()
+        return self.capi_ma.exportBundle(str(filename))
 
     @staticmethod
     def get_package_files():
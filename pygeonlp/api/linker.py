@@ -1,11 +1,13 @@
 from logging import getLogger
 
+from pygeonlp import capi
 from pygeonlp.api.node import Node
 
 logger = getLogger(__name__)
 
 
 MAX_COMBINATIONS = 256
+BEAM_WIDTH = 32
 
 
 class LinkerError(RuntimeError):
@@ -199,10 +201,12 @@ class Evaluator(object):
         スコアリングを行なうクラスインスタンス。
     max_results : int
         保持する結果の最大数。
+    beam_width : int
+        ビームサーチで位置ごとに残すパスの候補数。
     """
 
     def __init__(self, scoring_class=None, scoring_options=None,
-                 max_results=5, max_combinations=None):
+                 max_results=5, max_combinations=None, beam_width=None):
         """
         Parameters
         ----------
@@ -217,14 +221,20 @@ class Evaluator(object):
             保持する結果の最大数を指定します（デフォルト = 5）。
         max_combinations : int, optional
             ノード候補の組み合わせ数の上限値。これを超える組み合わせが
-            可能な入力が与えられた場合は例外 LinkerError を発生します。
+            可能な入力が与えられた場合は、ビームサーチで上位のパスを求めます。
+            ビームサーチを利用できない場合は例外 LinkerError を発生します。
             デフォルト値は linker.MAX_COMBINATIONS です。
+        beam_width : int, optional
+            ビームサーチで位置ごとに残すパスの候補数。
+            デフォルト値は linker.BEAM_WIDTH です。
+            0 を指定するとビームサーチを利用しません。
         """
         from .scoring import ScoringClass
         self.scoring_class = scoring_class
         self.scoring_options = scoring_options
         self.max_results = max_results
         self.max_combinations = max_combinations
+        self.beam_width = beam_width
 
         if self.scoring_class is None:
             self.scorer = ScoringClass(scoring_options)
@@ -236,6 +246,9 @@ class Evaluator(object):
         if self.max_combinations is None:
             self.max_combinations = MAX_COMBINATIONS
 
+        if self.beam_width is None:
+            self.beam_width = BEAM_WIDTH
+
     def count_combinations(self, lattice):
         """
         ラティス形式の入力に対し、組み合わせたパス表現の個数を計算します。
@@ -277,6 +290,9 @@ class Evaluator(object):
         results = []
         combination = self.count_combinations(lattice)
         if combination > self.max_combinations:
+            if self.can_search_paths():
+                return self.search_paths(lattice)
+
             raise LinkerError(
                 "組み合わせ数 {} がしきい値 {} を超えています。".format(
                     combination, self.max_combinations))
@@ -311,6 +327,99 @@ class Evaluator(object):
 
         return results
 
+    def can_search_paths(self):
+        """
+        ビームサーチで上位のパスを求められるかどうかを返します。
+
+        Return
+        ------
+        bool
+            beam_width が正で、スコアリングクラスが ``path_score()`` を
+            オーバーライドしていない場合に True を返します。
+        """
+        from .scoring import ScoringClass
+        return self.beam_width > 0 and \
+            type(self.scorer).path_score is ScoringClass.path_score
+
+    def search_paths(self, lattice):
+        """
+        ラティス表現を入力として、全ての組み合わせを列挙せずに
+        ビームサーチでスコアの高いパス表現を求めます。
+
+        パスのスコアは ``ScoringClass.path_score()`` と同じ規則で計算し、
+        ノード間のスコアは ``node_relation_score()`` を必要な組に対してのみ
+        呼び出して計算します。
+        計算時間はラティスの長さ × beam_width × 候補数に比例します。
+
+        Parameters
+        ----------
+        lattice : list
+            入力となるラティス表現。
+
+        Return
+        ------
+        list
+            ``get()`` と同じ形式の dict のリスト。
+            位置ごとに beam_width 個の候補だけを残すので、
+            全ての組み合わせを評価した場合の上位と一致するとは限りません。
+        """
+        if self.scorer.options:
+            nlookup = self.scorer.options
+        else:
+            nlookup = 5
+
+        if not isinstance(nlookup, int):
+            raise RuntimeError(
+                "オプションパラメータは整数値で指定してください。")
+
+        # 位置ごとの候補を (種別, 次の位置, 固有名クラス番号, 住所階層数) に変換
+        features = []
+        ne_classes = {}
+        for n, nodes in enumerate(lattice):
+            has_non_address_node = False
+            for node in nodes:
+                if node.node_type != Node.ADDRESS:
+                    has_non_address_node = True
+                    break
+
+            candidates = []
+            for node in nodes:
+                if isinstance(node.morphemes, (list, tuple,)) and \
+                        has_non_address_node:
+                    next_pos = n + len(node.morphemes)
+                else:
+                    next_pos = n + 1
+
+                ne_class = -1
+                levels = 0
+                if node.node_type == Node.GEOWORD:
+                    ne_class = ne_classes.setdefault(
+                        node.prop['ne_class'], len(ne_classes))
+                elif node.node_type == Node.ADDRESS:
+                    levels = len(node.morphemes)
+
+                candidates.append((node.node_type, next_pos, ne_class, levels))
+
+            features.append(candidates)
+
+        def relation(pos0, index0, pos1, index1):
+            return self.scorer.node_relation_score(
+                lattice[pos0][index0], lattice[pos1][index1])
+
+        results = []
+        for score, nodes in capi.searchBestPaths(
+                features, relation, nlookup=nlookup,
+                beam_width=self.beam_width, max_results=self.max_results):
+            path = [lattice[pos][index] for pos, index in nodes]
+            logger.debug("{} => {}".format(
+                ''.join([x.simple() for x in path]), score))
+            results.append({
+                "score": score,
+                "result": path,
+            })
+
+        return results
+
     def as_dict(self, lattice):
         """
         ``get()`` と同じ処理を行ないますが、結果に含まれるノードの情報を
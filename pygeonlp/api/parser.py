@@ -5,6 +5,7 @@ import re
 import jageocoder as _jageocoder
 from jageocoder.itaiji import converter as itaiji_converter
 
+from pygeonlp import capi
 from pygeonlp.api.node import Node
 from pygeonlp.api.service import Service
 
@@ -182,8 +183,48 @@ class Parser(object):
         ['。(NORMAL)']
         """
 
+        words, candidates = self.service.ma_parseLattice(sentence)
+        return self._words_to_lattice(words, candidates)
+
+    async def analyze_sentence_async(self, sentence, **kwargs):
+        """
+        analyze_sentence の非同期版です。
+
+        形態素解析は C++ の作業スレッドで行い、その間はイベントループに
+        制御を戻します。解析結果からラティス表現を作る処理は
+        呼び出したイベントループのスレッドで行います。
+
+        Parameters
+        ----------
+        sentence : str
+            解析対象の文字列。
+
+        Returns
+        -------
+        list
+            analyze_sentence と同じラティス表現。
+        """
+        words = await self.service.ma_parseNode_async(sentence)
+        return self._words_to_lattice(words)
+
+    def _words_to_lattice(self, words, candidates=None):
+        """
+        形態素解析の結果から、全ての地名語候補を含むラティス表現を作ります。
+
+        Parameters
+        ----------
+        words : list
+            Service.ma_parseNode が返す形態素のリスト。
+        candidates : list, optional
+            Service.ma_parseLattice が返す、形態素ごとの地名語候補のリスト。
+            省略した場合は地名語候補を Service.getWordInfo で取得します。
+
+        Returns
+        -------
+        list
+            ラティス表現。
+        """
         lattice = []
-        words = self.service.ma_parseNode(sentence)
 
         i = 0  # 処理中の単語のインデックス
         while i < len(words):
@@ -308,8 +349,12 @@ class Parser(object):
                 geolod_id = x.split(':')[0]
                 geolod_ids[geolod_id] = x
 
-            for geolod_id, geoword in self.service.getWordInfo(
-                    geolod_ids.keys()).items():
+            if candidates is not None:
+                geowords = [(x['geolod_id'], x) for x in candidates[i]]
+            else:
+                geowords = self.service.getWordInfo(geolod_ids.keys()).items()
+
+            for geolod_id, geoword in geowords:
                 if geoword is None:
                     raise RuntimeError(
                         "No geoword found with id='{}', word={}".format(
@@ -406,93 +451,153 @@ class Parser(object):
         if not self.jageocoder_tree:
             return lattice
 
-        i = 0  # 処理中のノードインデックス
-        while i < len(lattice):
-            nodes = lattice[i]
+        # 住所ジオコーディングは住所表記になり得る範囲の先頭だけで試みる
+        spans = self.get_address_spans(lattice)
+        shift = 0  # 住所ノードに置き換えて減ったノードの数
+        i = 0  # 住所の先頭とみなせる最初のノードインデックス
+        for begin, end in spans:
+            if begin - shift < i:
+                # 直前の住所に含まれる
+                continue
+
+            i = begin - shift
+            if not self._can_be_address(lattice[i]):
+                continue
+
+            res = self.get_addresses(lattice[0:end - shift], i)
+            if res['address']:
+                new_nodes = []
+                for address in res['address']:
+                    morphemes = self._get_address_morphemes(
+                        address, lattice[i:res['pos']])
+                    if len(morphemes) == 0:
+                        # 一致する形態素列が見つからなかった
+                        continue
+
+                    geometry = {
+                        'type': 'Point',
+                        'coordinates': [
+                            address['x'],
+                            address['y'], ]
+                    }
+                    new_node = Node(
+                        surface=res['surface'],
+                        node_type=Node.ADDRESS,
+                        morphemes=morphemes,
+                        geometry=geometry,
+                        prop=address,
+                    )
+                    new_nodes.append(new_node)
+
+                if len(new_nodes) > 0:
+                    if keep_nodes:
+                        lattice[i] += new_nodes
+                        i = res['pos']
+                    else:
+                        lattice = lattice[0:i] + \
+                            [new_nodes] + lattice[res['pos']:]
+                        shift += res['pos'] - i - 1
+                        i += 1
+
+        # センテンス終了
+        return lattice
+
+    def get_address_spans(self, lattice):
+        """
+        ラティス表現から住所ジオコーディングを試みる範囲を求めます。
+
+        住所表記の先頭になり得るノードごとに、数字・漢数字・ハイフン、
+        丁目・番地・番・号、地名語や名詞など住所表記の一部になり得る
+        ノードが続く範囲を C++ の処理で求めます。
+        地名語だけで後に続くノードが無い位置は範囲に含めません。
 
-            can_be_address = False
+        Parameters
+        ----------
+        lattice : list
+            analyze_sentence の結果のラティス表現。
+
+        Returns
+        -------
+        list
+            範囲の先頭のノードインデックスと、末尾の次のノードインデックスの
+            組 (begin, end) のリスト。先頭の昇順に並びます。
+        """
+        tokens = []
+        for nodes in lattice:
+            geoword = False
+            head = 0
             for node in nodes:
-                if node.node_type == Node.GEOWORD and \
-                   self.address_regex.match(node.prop.get('ne_class', '')):
-                    can_be_address = True
-                    break
-                # 地域・一般の場合でも、都道府県または市区町村名から始まる場合は
-                # 住所ジオコーディングの対象とする（NEologdで結合しているケース）
+                if node.node_type == Node.GEOWORD:
+                    geoword = True
+                    if self.address_regex.match(node.prop.get('ne_class', '')):
+                        head |= 1
                 elif node.node_type == Node.NORMAL and \
                     self.check_word(node.morphemes, {
                         'pos': '名詞',
                         'subclass1': '固有名詞',
                         'subclass2': '地域',
                         'subclass3': '一般'}):
-                    # jageocoder の trie を利用して語の候補を得る
-                    prefixes = self.jageocoder_tree.trie.common_prefixes(
-                        itaiji_converter.standardize(node.surface))
-                    if node.morphemes['original_form'] != '':
-                        prefixes.update(
-                            self.jageocoder_tree.trie.common_prefixes(
-                                itaiji_converter.standardize(
-                                    node.morphemes['original_form'])))
-
-                    for prefix in prefixes.keys():
-                        if can_be_address is True:
-                            break
+                    head |= 2
 
-                        # prefix と一致する正規化前の部分文字列を得る
-                        surface = ''
-                        for c in node.surface:
-                            surface += c
-                            if itaiji_converter.standardize(surface) == prefix:
-                                break
-
-                        words = self.service.searchWord(surface)
-                        for word in words.values():
-                            if self.address_regex.match(word['ne_class']):
-                                can_be_address = True
-                                break
-
-                    break
-
-            if can_be_address:
-                res = self.get_addresses(lattice, i)
-                if res['address']:
-                    new_nodes = []
-                    for address in res['address']:
-                        morphemes = self._get_address_morphemes(
-                            address, lattice[i:res['pos']])
-                        if len(morphemes) == 0:
-                            # 一致する形態素列が見つからなかった
-                            continue
-
-                        geometry = {
-                            'type': 'Point',
-                            'coordinates': [
-                                address['x'],
-                                address['y'], ]
-                        }
-                        new_node = Node(
-                            surface=res['surface'],
-                            node_type=Node.ADDRESS,
-                            morphemes=morphemes,
-                            geometry=geometry,
-                            prop=address,
-                        )
-                        new_nodes.append(new_node)
-
-                    if len(new_nodes) > 0:
-                        if keep_nodes:
-                            lattice[i] += new_nodes
-                            i = res['pos']
-                        else:
-                            lattice = lattice[0:i] + \
-                                [new_nodes] + lattice[res['pos']:]
-                            i += 1
+            morphemes = nodes[0].morphemes or {}
+            tokens.append((
+                nodes[0].surface, morphemes.get('pos', ''),
+                morphemes.get('subclass1', ''), geoword, head))
 
-                        continue
+        return capi.findAddressSpans(tokens)
 
-            i += 1
+    def _can_be_address(self, nodes):
+        """
+        ラティス表現の一つの位置のノードが住所表記の先頭になり得るか
+        判定します。
 
-        # センテンス終了
-        return lattice
+        Parameters
+        ----------
+        nodes : list
+            ラティス表現の一つの位置のノードのリスト。
+
+        Returns
+        -------
+        bool
+            住所表記の先頭になり得る場合は True。
+        """
+        for node in nodes:
+            if node.node_type == Node.GEOWORD and \
+               self.address_regex.match(node.prop.get('ne_class', '')):
+                return True
+            # 地域・一般の場合でも、都道府県または市区町村名から始まる場合は
+            # 住所ジオコーディングの対象とする（NEologdで結合しているケース）
+            elif node.node_type == Node.NORMAL and \
+                self.check_word(node.morphemes, {
+                    'pos': '名詞',
+                    'subclass1': '固有名詞',
+                    'subclass2': '地域',
+                    'subclass3': '一般'}):
+                # jageocoder の trie を利用して語の候補を得る
+                prefixes = self.jageocoder_tree.trie.common_prefixes(
+                    itaiji_converter.standardize(node.surface))
+                if node.morphemes['original_form'] != '':
+                    prefixes.update(
+                        self.jageocoder_tree.trie.common_prefixes(
+                            itaiji_converter.standardize(
+                                node.morphemes['original_form'])))
+
+                for prefix in prefixes.keys():
+                    # prefix と一致する正規化前の部分文字列を得る
+                    surface = ''
+                    for c in node.surface:
+                        surface += c
+                        if itaiji_converter.standardize(surface) == prefix:
+                            break
+
+                    words = self.service.searchWord(surface)
+                    for word in words.values():
+                        if self.address_regex.match(word['ne_class']):
+                            return True
+
+                break
+
+        return False
 
     def _get_address_morphemes(self, address_element, lattice_part):
         """
@@ -764,3 +869,38 @@ class Parser(object):
             varray = self.add_address_candidates(varray, **kwargs)
 
         return varray
+
+    async def analyze_async(self, sentence, **kwargs):
+        """
+        analyze の非同期版です。
+
+        形態素解析を待つ間はイベントループに制御を戻します。
+        住所ジオコーディングの結果の追加は analyze と同じく
+        呼び出したスレッドで行います。
+
+        Parameters
+        ----------
+        sentence : str
+            解析するテキスト。
+
+        Returns
+        -------
+        list
+            analyze と同じラティス表現。
+
+        Examples
+        --------
+        >>> import asyncio
+        >>> from pygeonlp.api.parser import Parser
+        >>> parser = Parser()
+        >>> lattice = asyncio.run(parser.analyze_async('和歌山市は晴れ。'))
+        >>> [[x.as_dict() for x in nodes] for nodes in lattice] == [
+        ...     [x.as_dict() for x in nodes] for nodes in parser.analyze('和歌山市は晴れ。')]
+        True
+        """
+        varray = await self.analyze_sentence_async(sentence, **kwargs)
+
+        if self.jageocoder_tree:
+            varray = self.add_address_candidates(varray, **kwargs)
+
+        return varray
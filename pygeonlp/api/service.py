@@ -1,7 +1,11 @@
+import asyncio
+import datetime
 from collections.abc import Iterable
 from logging import getLogger
 import os
+import queue
 import re
+import threading
 from typing import Union
 
 from pygeonlp import capi
@@ -89,6 +93,90 @@ class Service(object):
             MeCab システム辞書のディレクトリを指定します。
             省略した場合はデフォルトのシステム辞書を利用します。
 
+        darts_mmap : bool
+            地名語インデックス（darts ファイル）を mmap で開くかどうかを
+            指定します。 True の場合、複数のプロセスがページキャッシュ上の
+            同じインデックスを共有するため、起動が速くメモリ消費も減ります。
+            False の場合は各プロセスがインデックスをメモリに読み込みます。
+            デフォルト値は True です。
+
+        geoword_cache_size : int
+            地名語キャッシュに保持する地名語の最大数を指定します。
+            最も長く参照されていない地名語から追い出されます。
+            0 を指定するとキャッシュを利用しません。
+            デフォルト値は 10000 です。
+
+        parse_cache_size : int
+            ``ma_parseNode()`` などの解析結果を記憶する文の最大数を
+            指定します。同じ文をアクティブな辞書・固有名クラスを
+            変えずに解析した場合、記憶した結果の複製を返します。
+            最も長く参照されていない文から追い出され、辞書の追加・削除や
+            インデックスの更新で全て破棄されます。
+            0 を指定すると記憶しません。デフォルト値は 0 です。
+
+        bundle : PathLike
+            ``DictManager.exportBundle()`` で書き出したバンドルファイルを
+            指定します。相対パスの場合はデータベースディレクトリからの
+            相対パスとみなします。指定した場合はデータベースの代わりに
+            mmap したバンドルファイルを参照するため、起動が速く、
+            解析中に SQLite を利用しません。
+            辞書の追加・削除やインデックスの更新はできません。
+            デフォルト値は None （データベースを参照する）です。
+
+        formatter : str
+            ma_parse() と ma_parseStream() の出力形式を指定します。
+            "DefaultGeowordFormatter" （MeCab 互換）、
+            "ChasenGeowordFormatter" （ChaSen 互換）、
+            "JsonLinesGeowordFormatter" （一文を一行の JSON 配列とする
+            JSON Lines）のいずれかです。
+            デフォルト値は "DefaultGeowordFormatter" です。
+
+        stats : bool
+            True を指定すると、形態素解析、地名語候補の評価、 darts の検索、
+            空間インデックスの検索、 SQLite の参照などの処理ごとに
+            呼び出し回数と累積時間、
+            キャッシュのヒット数を計測します。
+            計測値は ``getStats()`` で取得できます。
+            デフォルト値は False （計測しない）です。
+
+        read_only : bool
+            True を指定すると、データベースを変更されないファイルとして
+            読み込み専用で開きます。 SQLite はファイルのロックや
+            ジャーナルを利用せず、 mmap でファイルを参照するため、
+            複数のプロセスが同じページキャッシュを共有できます。
+            辞書の追加・削除やインデックスの更新はできません。
+            開いている間に他のプロセスがデータベースを更新しないでください。
+            デフォルト値は False です。
+
+        in_memory : bool
+            True を指定すると、データベースファイルの内容を全てメモリに
+            読み込み、ファイルの代わりに参照します。 read_only も True に
+            なります。地名語の参照でファイルやページキャッシュを経由しません。
+            読み込んだ内容は全てのスレッドで共有し、 fork した子プロセスとも
+            コピーオンライトで共有されます。 ``warmup()`` と組み合わせると、
+            作業プロセスを fork するサーバで初期化を一度だけ行えます。
+            デフォルト値は False です。
+
+        sqlite_mmap_size : int
+            read_only が True の場合に SQLite が mmap する大きさ（MB）を
+            指定します。 0 を指定すると mmap を利用しません。
+            デフォルト値は 256 です。
+
+        sqlite_cache_size : int
+            read_only が True の場合の SQLite の接続ごとのページキャッシュの
+            大きさ（MB）を指定します。
+            デフォルト値は 64 です。
+
+        memory_budget : int
+            地名語キャッシュ、見出し語ごとの候補のキャッシュ、表記の
+            標準化のキャッシュが共有するメモリの上限（MB）を指定します。
+            parse_cache_size を指定した場合は解析結果のキャッシュも共有します。
+            上限を超えるとキャッシュは古い要素から追い出します。
+            SQLite のページキャッシュは接続ごとに、 sqlite_cache_size と
+            指定した値の半分の小さい方に制限します。
+            0 を指定すると制限しません。デフォルト値は 0 です。
+            利用状況は ``getMemoryUsage()`` で確認できます。
+
         """
         self._dict_cache = {}
         self.options = options
@@ -154,6 +242,66 @@ class Service(object):
                 raise TypeError(
                     "'system_dic_dir' は文字列で指定してください。")
 
+        if 'darts_mmap' in self.options:
+            if isinstance(self.options['darts_mmap'], bool):
+                capi_options['darts_mmap'] = self.options['darts_mmap']
+            else:
+                raise TypeError(
+                    "'darts_mmap' は True または False で指定してください。")
+
+        if 'geoword_cache_size' in self.options:
+            cache_size = self.options['geoword_cache_size']
+            if isinstance(cache_size, int) and \
+                    not isinstance(cache_size, bool) and cache_size >= 0:
+                capi_options['geoword_cache_size'] = cache_size
+            else:
+                raise TypeError(
+                    "'geoword_cache_size' は 0 以上の整数で指定してください。")
+
+        if self.options.get('bundle') is not None:
+            bundle = self.options['bundle']
+            if isinstance(bundle, (str, os.PathLike)):
+                capi_options['bundle'] = str(bundle)
+            else:
+                raise TypeError(
+                    "'bundle' はファイル名で指定してください。")
+
+        if 'formatter' in self.options:
+            if self.options['formatter'] in (
+                    'DefaultGeowordFormatter', 'ChasenGeowordFormatter',
+                    'JsonLinesGeowordFormatter'):
+                capi_options['formatter'] = self.options['formatter']
+            else:
+                raise ValueError(
+                    "'formatter' に指定できない出力形式です。")
+
+        if 'stats' in self.options:
+            if isinstance(self.options['stats'], bool):
+                capi_options['stats'] = self.options['stats']
+            else:
+                raise TypeError(
+                    "'stats' は True または False で指定してください。")
+
+        for key in ('read_only', 'in_memory'):
+            if key in self.options:
+                if isinstance(self.options[key], bool):
+                    capi_options[key] = self.options[key]
+                else:
+                    raise TypeError(
+                        "'{}' は True または False で指定してください。".format(
+                            key))
+
+        for key in ('parse_cache_size', 'sqlite_mmap_size',
+                    'sqlite_cache_size', 'memory_budget'):
+            if key in self.options:
+                size = self.options[key]
+                if isinstance(size, int) and \
+                        not isinstance(size, bool) and size >= 0:
+                    capi_options[key] = size
+                else:
+                    raise TypeError(
+                        "'{}' は 0 以上の整数で指定してください。".format(key))
+
         self.capi_ma = capi.MA(capi_options)
 
     def ma_parse(self, sentence):
@@ -190,7 +338,51 @@ class Service(object):
         self._check_initialized()
         return self.capi_ma.parse(sentence)
 
-    def ma_parseNode(self, sentence):
+    def ma_parseStream(self, source, out, max_sentence_bytes=65536):
+        """
+        テキストを文に区切りながら形態素解析し、解析結果を
+        MeCab 互換の文字列として out に書き出します。
+
+        文の区切り方は ma_parseNodeStream と同じです。
+        解析結果は文ごとに C++ で整形し、まとめて out.write() に渡すため、
+        大きなファイルの解析結果もメモリに保持せずにファイルや
+        ソケットに書き出せます。
+        出力形式はオプション formatter で指定します。
+
+        Parameters
+        ----------
+        source : str, file object or iterable of str
+            解析するテキスト。テキストモードで開いたファイルや、
+            文字列（または UTF-8 の bytes）を返すイテレータを指定できます。
+        out : file object or callable
+            解析結果を書き出す、テキストモードのファイルオブジェクト、
+            または文字列を受け取る関数。
+        max_sentence_bytes : int, optional
+            区切り文字が現れない場合に文を区切るバイト数。
+
+        Returns
+        -------
+        int
+            解析した文の数。
+
+        Examples
+        --------
+        >>> import io
+        >>> from pygeonlp.api.service import Service
+        >>> service = Service(formatter='JsonLinesGeowordFormatter')
+        >>> out = io.StringIO()
+        >>> service.ma_parseStream('和歌山市は晴れ。', out)
+        1
+        """
+        self._check_initialized()
+        if isinstance(source, (str, bytes)):
+            source = [source]
+
+        write = out if callable(out) else out.write
+        return self.capi_ma.parseStream(
+            source, write, max_sentence_bytes=max_sentence_bytes)
+
+    def ma_parseNode(self, sentence, columnar=False, view=None):
         """
         センテンスを形態素解析した結果を MeCab 互換のノード配列として返します。
 
@@ -198,11 +390,19 @@ class Service(object):
         ----------
         sentence : str
             解析する文字列。
+        columnar : bool, optional
+            True の場合、ノードごとの dict を作らず、
+            ``pygeonlp.capi.NODE_FIELDS`` の順に並んだ
+            フィールドごとの値のリストのタプルを返します。
+        view : object, optional
+            ``createActiveView()`` で作成した辞書と固有名クラスの組。
+            指定した場合、アクティブな辞書とクラスの代わりに利用します。
 
         Returns
         -------
-        list
-            解析結果のリスト。
+        list or tuple
+            解析結果のリスト。 columnar が True の場合は
+            フィールドごとのリストのタプル。
 
         Examples
         --------
@@ -212,7 +412,226 @@ class Service(object):
         [{'conjugated_form': '*', 'conjugation_type': '*', 'original_form': '*', 'pos': 'BOS/EOS', 'prononciation': '*', 'subclass1': '*', 'subclass2': '*', 'subclass3': '*', 'surface': '', 'yomi': '*'}, {'conjugated_form': '*', 'conjugation_type': '*', 'original_form': '今日', 'pos': '名詞', 'prononciation': 'キョー', 'subclass1': '副詞可能', 'subclass2': '*', 'subclass3': '*', 'surface': '今日', 'yomi': 'キョウ'}, {'conjugated_form': '*', 'conjugation_type': '*', 'original_form': 'は', 'pos': '助詞', 'prononciation': 'ワ', 'subclass1': '係助詞', 'subclass2': '*', 'subclass3': '*', 'surface': 'は', 'yomi': 'ハ'}, {'conjugated_form': '*', 'conjugation_type': '*', 'original_form': '国会議事堂前', 'pos': '名詞', 'prononciation': '', 'subclass1': '固有名詞', 'subclass2': '地名語', 'subclass3': 'Bn4q6d:国会議事堂前駅/cE8W4w:国会議事堂前駅', 'surface': '国会議事堂前', 'yomi': ''}, {'conjugated_form': '*', 'conjugation_type': '*', 'original_form': 'まで', 'pos': '助詞', 'prononciation': 'マデ', 'subclass1': '副助詞', 'subclass2': '*', 'subclass3': '*', 'surface': 'まで', 'yomi': 'マデ'}, {'conjugated_form': '五段・カ行イ音便', 'conjugation_type': '連用形', 'original_form': '歩く', 'pos': '動詞', 'prononciation': 'アルキ', 'subclass1': '自立', 'subclass2': '*', 'subclass3': '*', 'surface': '歩き', 'yomi': 'アルキ'}, {'conjugated_form': '特殊・マス', 'conjugation_type': '連用形', 'original_form': 'ます', 'pos': '助動詞', 'prononciation': 'マシ', 'subclass1': '*', 'subclass2': '*', 'subclass3': '*', 'surface': 'まし', 'yomi': 'マシ'}, {'conjugated_form': '特殊・タ', 'conjugation_type': '基本形', 'original_form': 'た', 'pos': '助動詞', 'prononciation': 'タ', 'subclass1': '*', 'subclass2': '*', 'subclass3': '*', 'surface': 'た', 'yomi': 'タ'}, {'conjugated_form': '*', 'conjugation_type': '*', 'original_form': '。', 'pos': '記号', 'prononciation': '。', 'subclass1': '句点', 'subclass2': '*', 'subclass3': '*', 'surface': '。', 'yomi': '。'}, {'conjugated_form': '*', 'conjugation_type': '*', 'original_form': '*', 'pos': 'BOS/EOS', 'prononciation': '*', 'subclass1': '*', 'subclass2': '*', 'subclass3': '*', 'surface': '', 'yomi': '*'}]
         """
         self._check_initialized()
-        return self.capi_ma.parseNode(sentence)
+        return self.capi_ma.parseNode(sentence, columnar=columnar, view=view)
+
+    def ma_parseLattice(self, sentence, view=None):
+        """
+        センテンスを形態素解析した結果と、地名語ノードの候補の語の情報を
+        一度の呼び出しで返します。
+
+        地名語ノードの subclass3 に含まれる geolod_id ごとに
+        ``getWordInfo()`` を呼び出す代わりに利用します。
+
+        Parameters
+        ----------
+        sentence : str
+            解析する文字列。
+        view : object, optional
+            ``createActiveView()`` で作成した辞書と固有名クラスの組。
+            指定した場合、アクティブな辞書とクラスの代わりに利用します。
+
+        Returns
+        -------
+        tuple
+            ma_parseNode と同じ解析結果のリストと、それと同じ順に並んだ
+            ノードごとの候補の語の情報（getWordInfo() が返す dict）の
+            リストのタプル。地名語以外のノードの候補は空のリストです。
+
+        Examples
+        --------
+        >>> from pygeonlp.api.service import Service
+        >>> service = Service()
+        >>> nodes, candidates = service.ma_parseLattice('国会議事堂前まで歩きました。')
+        >>> [(x['surface'], [w['geolod_id'] for w in c]) for x, c in zip(nodes, candidates) if c]
+        [('国会議事堂前', ['Bn4q6d', 'cE8W4w'])]
+        """
+        self._check_initialized()
+        return self.capi_ma.parseLattice(sentence, view=view)
+
+    def ma_parseNodeBatch(self, sentences, n_threads=0, columnar=False):
+        """
+        複数のセンテンスを並列に形態素解析し、それぞれの結果を
+        MeCab 互換のノード配列として返します。
+
+        解析は C++ の作業スレッドで行い、その間は GIL を解放します。
+
+        Parameters
+        ----------
+        sentences : list of str
+            解析する文字列のリスト。
+        n_threads : int, optional
+            呼び出したスレッドを含む並列数。0 の場合は CPU 数を利用します。
+            作業スレッドはプロセス全体で共有するプールのものを再利用します。
+        columnar : bool, optional
+            True の場合、それぞれの解析結果を ma_parseNode と同じ
+            フィールドごとのリストのタプルで返します。
+
+        Returns
+        -------
+        list
+            sentences と同じ順に並んだ、解析結果のリストのリスト。
+
+        Examples
+        --------
+        >>> from pygeonlp.api.service import Service
+        >>> service = Service()
+        >>> results = service.ma_parseNodeBatch(['国会議事堂前まで歩きました。', '和歌山市は晴れ。'], n_threads=2)
+        >>> [[x['surface'] for x in r if x['subclass2'] == '地名語'] for r in results]
+        [['国会議事堂前'], ['和歌山市']]
+        """
+        self._check_initialized()
+        if not isinstance(n_threads, int) or isinstance(n_threads, bool):
+            raise TypeError("'n_threads' must be an integer.")
+
+        return self.capi_ma.parseNodeBatch(
+            list(sentences), n_threads=n_threads, columnar=columnar)
+
+    async def ma_parseNode_async(self, sentence, columnar=False):
+        """
+        ma_parseNode の非同期版です。解析が終わるまで待たずに
+        イベントループに制御を戻します。
+
+        解析は C++ の共有の作業スレッドで行い、その間は GIL を解放します。
+        終了はイベントループに ``call_soon_threadsafe`` で通知するため、
+        イベントループのスレッドやスレッドプールを占有しません。
+
+        Parameters
+        ----------
+        sentence : str
+            解析する文字列。
+        columnar : bool, optional
+            True の場合、 ma_parseNode と同じ
+            フィールドごとのリストのタプルを返します。
+
+        Returns
+        -------
+        list or tuple
+            ma_parseNode と同じ解析結果。
+
+        Examples
+        --------
+        >>> import asyncio
+        >>> from pygeonlp.api.service import Service
+        >>> service = Service()
+        >>> async def main():
+        ...     return await asyncio.gather(
+        ...         service.ma_parseNode_async('国会議事堂前まで歩きました。'),
+        ...         service.ma_parseNode_async('和歌山市は晴れ。'))
+        >>> results = asyncio.run(main())
+        >>> [[x['surface'] for x in r if x['subclass2'] == '地名語'] for r in results]
+        [['国会議事堂前'], ['和歌山市']]
+        """
+        self._check_initialized()
+        loop = asyncio.get_running_loop()
+        future = loop.create_future()
+
+        def set_result(nodes, error):
+            if future.cancelled():
+                return
+
+            if error is not None:
+                future.set_exception(error)
+            else:
+                future.set_result(nodes)
+
+        def callback(nodes, error):
+            # 作業スレッドから呼び出される
+            try:
+                loop.call_soon_threadsafe(set_result, nodes, error)
+            except RuntimeError:
+                # イベントループが終了している
+                pass
+
+        self.capi_ma.parseNodeAsync(sentence, callback, columnar=columnar)
+        return await future
+
+    def ma_parseNodeStream(self, source, columnar=False,
+                           max_sentence_bytes=65536):
+        """
+        テキストを文に区切りながら形態素解析し、文ごとの結果を
+        順に返すジェネレータです。
+
+        改行、「。」「！」「？」の直後で文を区切ります。
+        「。」「！」「？」の直後の改行は同じ文に含めます。
+        入力の読み込みと MeCab による解析、地名語の変換を
+        C++ のスレッドで並行して行い、先行して解析する文の数には
+        上限があるため、大きなファイルも全体をメモリに読み込まずに
+        解析できます。
+
+        Parameters
+        ----------
+        source : str, file object or iterable of str
+            解析するテキスト。テキストモードで開いたファイルや、
+            文字列（または UTF-8 の bytes）を返すイテレータを指定できます。
+        columnar : bool, optional
+            True の場合、それぞれの解析結果を ma_parseNode と同じ
+            フィールドごとのリストのタプルで返します。
+        max_sentence_bytes : int, optional
+            区切り文字が現れない場合に文を区切るバイト数。
+
+        Yields
+        ------
+        tuple
+            入力の先頭からの文の開始位置（文字数）と、
+            その文の解析結果のタプル。
+
+        Examples
+        --------
+        >>> from pygeonlp.api.service import Service
+        >>> service = Service()
+        >>> for offset, nodes in service.ma_parseNodeStream('国会議事堂前まで歩きました。和歌山市は晴れ。'):
+        ...     print(offset, [x['surface'] for x in nodes if x['subclass2'] == '地名語'])
+        0 ['国会議事堂前']
+        14 ['和歌山市']
+        """
+        self._check_initialized()
+        if isinstance(source, (str, bytes)):
+            source = [source]
+
+        results = queue.Queue(maxsize=64)
+        stopped = threading.Event()
+        end = object()
+
+        def callback(nodes, offset):
+            while not stopped.is_set():
+                try:
+                    results.put((offset, nodes), timeout=0.1)
+                    return True
+                except queue.Full:
+                    pass
+
+            return False
+
+        def worker():
+            try:
+                self.capi_ma.parseNodeStream(
+                    source, callback, columnar=columnar,
+                    max_sentence_bytes=max_sentence_bytes)
+                item = end
+            except BaseException as e:
+                item = e
+
+            while not stopped.is_set():
+                try:
+                    results.put(item, timeout=0.1)
+                    break
+                except queue.Full:
+                    pass
+
+        thread = threading.Thread(target=worker, daemon=True)
+        thread.start()
+        try:
+            while True:
+                item = results.get()
+                if item is end:
+                    break
+                elif isinstance(item, BaseException):
+                    raise item
+
+                yield item
+        finally:
+            stopped.set()
+            thread.join()
 
     def getWordInfo(self, geolod_id):
         """
@@ -251,7 +670,7 @@ class Service(object):
 
         return results
 
-    def searchWord(self, key):
+    def searchWord(self, key, view=None):
         """
         指定した表記または読みを持つ語の情報を返します。
         一致する語が辞書に存在しない場合は None を返します。
@@ -260,6 +679,9 @@ class Service(object):
         ----------
         key : str
             語の表記または読み。
+        view : object, optional
+            ``createActiveView()`` で作成した辞書と固有名クラスの組。
+            指定した場合、アクティブな辞書とクラスの代わりに利用します。
 
         Returns
         -------
@@ -275,11 +697,219 @@ class Service(object):
         """
         self._check_initialized()
         results = {}
-        for k, w in self.capi_ma.searchWord(key).items():
+        for k, w in self.capi_ma.searchWord(key, view=view).items():
+            results[k] = self._add_dict_identifier(w)
+
+        return results
+
+    def searchYomi(self, key):
+        """
+        指定した読みを持つ語の情報を返します。
+        ``searchWord()`` と異なり、表記だけが一致する語は含みません。
+        読みは辞書に登録されている通りに比較します。
+
+        Parameters
+        ----------
+        key : str
+            語の読み。
+
+        Returns
+        -------
+        dict
+            geolod_id をキー、語の情報を値に持つ dict。
+        """
+        self._check_initialized()
+        results = {}
+        for k, w in self.capi_ma.searchYomi(key).items():
             results[k] = self._add_dict_identifier(w)
 
         return results
 
+    def searchYomiPrefix(self, text):
+        """
+        テキストの先頭に一致する読みを全て探し、
+        読みとその読みを持つ語の情報の組を返します。
+        かな入力の補完などに利用できます。
+
+        Parameters
+        ----------
+        text : str
+            検索するテキスト。
+
+        Returns
+        -------
+        list
+            (読み, geolod_id をキー、語の情報を値に持つ dict) の list。
+            読みの短い順に並びます。
+        """
+        self._check_initialized()
+        results = []
+        for yomi, words in self.capi_ma.searchYomiPrefix(text):
+            results.append((yomi, {
+                k: self._add_dict_identifier(w) for k, w in words.items()}))
+
+        return results
+
+    def searchWordFuzzy(self, key, max_distance=1, view=None):
+        """
+        表記または読みとの編集距離が max_distance 以下の語を探し、
+        一致した見出し語、距離、語の情報の組を返します。
+        OCR の誤りや旧字体など、 ``searchWord()`` で見つからない表記の揺れを許容します。
+
+        Parameters
+        ----------
+        key : str
+            語の表記または読み。
+        max_distance : int, optional
+            許容する編集距離（置換、挿入、削除した文字数）。
+            大きくすると検索に時間がかかるため、通常は 1 か 2 を指定します。
+        view : object, optional
+            ``createActiveView()`` で作成した辞書と固有名クラスの組。
+            指定した場合、アクティブな辞書とクラスの代わりに利用します。
+
+        Returns
+        -------
+        list
+            (見出し語, 距離, geolod_id をキー、語の情報を値に持つ dict) の list。
+            距離の小さい順に並びます。
+        """
+        self._check_initialized()
+        results = []
+        for surface, distance, words in self.capi_ma.searchWordFuzzy(
+                key, max_distance=max_distance, view=view):
+            results.append((surface, distance, {
+                k: self._add_dict_identifier(w) for k, w in words.items()}))
+
+        return results
+
+    def searchBox(self, min_lat, min_lon, max_lat, max_lon, view=None):
+        """
+        指定した矩形の範囲に地点を持つ語の geolod_id を返します。
+
+        インデックス更新時に作成した空間インデックスを利用するため、
+        語の情報を読み込まずに高速に検索できます。
+
+        Parameters
+        ----------
+        min_lat, min_lon : float
+            矩形の南端の緯度と西端の経度。
+        max_lat, max_lon : float
+            矩形の北端の緯度と東端の経度。
+        view : object, optional
+            ``createActiveView()`` で作成した辞書と固有名クラスの組。
+            指定した場合、アクティブな辞書とクラスの代わりに利用します。
+
+        Returns
+        -------
+        list
+            geolod_id の list。 geolod_id の順に並びます。
+        """
+        self._check_initialized()
+        return self.capi_ma.searchBox(
+            min_lat, min_lon, max_lat, max_lon, view=view)
+
+    def searchRadius(self, lat, lon, radius, view=None):
+        """
+        指定した地点からの距離が radius km 以内の地点を持つ語の
+        geolod_id を返します。
+
+        Parameters
+        ----------
+        lat, lon : float
+            中心の緯度と経度。
+        radius : float
+            半径（km）。
+        view : object, optional
+            ``createActiveView()`` で作成した辞書と固有名クラスの組。
+            指定した場合、アクティブな辞書とクラスの代わりに利用します。
+
+        Returns
+        -------
+        list
+            geolod_id の list。中心に近い順に並びます。
+        """
+        self._check_initialized()
+        return self.capi_ma.searchRadius(lat, lon, radius, view=view)
+
+    def searchGeometry(self, geojson, view=None):
+        """
+        GeoJSON で指定した Polygon または MultiPolygon の範囲に
+        地点を持つ語の geolod_id を返します。
+
+        Parameters
+        ----------
+        geojson : str or dict
+            範囲を表す GeoJSON 文字列またはデコードした dict。
+            Feature, FeatureCollection の場合は（最初の） Feature の
+            geometry を利用します。
+        view : object, optional
+            ``createActiveView()`` で作成した辞書と固有名クラスの組。
+            指定した場合、アクティブな辞書とクラスの代わりに利用します。
+
+        Returns
+        -------
+        list
+            geolod_id の list。 geolod_id の順に並びます。
+        """
+        self._check_initialized()
+        return self.capi_ma.searchGeometry(geojson, view=view)
+
+    def filterByGeometry(self, geolod_ids, geojson, inside=True):
+        """
+        geolod_id のリストから、地点が GeoJSON の範囲に含まれる
+        （inside=False の場合は含まれない）ものを残します。
+        経緯度を持たない語は常に残ります。
+
+        空間フィルタが候補ごとに空間演算を行う代わりに、
+        候補をまとめて判定するために利用します。
+
+        Parameters
+        ----------
+        geolod_ids : list
+            geolod_id の list。
+        geojson : str or dict
+            範囲を表す GeoJSON 文字列またはデコードした dict。
+        inside : bool, optional
+            False の場合は範囲に含まれない語を残します。
+
+        Returns
+        -------
+        list
+            残した geolod_id の list。 geolod_ids の順に並びます。
+        """
+        self._check_initialized()
+        return self.capi_ma.filterByGeometry(
+            geolod_ids, geojson, inside=inside)
+
+    def complete(self, prefix, k=10, view=None):
+        """
+        指定した文字列で始まる語を、含まれる地名語の多い順に最大 k 件返します。
+        検索窓での入力補完などに利用できます。
+
+        インデックス更新時に作成した補完候補表を利用するため、
+        SQLite を参照せずに高速に検索できます。
+        同じ表記の候補は一つにまとめます。
+
+        Parameters
+        ----------
+        prefix : str
+            語の表記または読みの先頭部分。
+        k : int, optional
+            返す候補の最大数。
+        view : object, optional
+            ``createActiveView()`` で作成した辞書と固有名クラスの組。
+            指定した場合、アクティブな辞書とクラスの代わりに利用します。
+
+        Returns
+        -------
+        list
+            'surface' (表記), 'score' (スコア), 'geolod_ids'
+            (アクティブな辞書とクラスに含まれる語の geolod_id の list)
+            を持つ dict の list。スコアの高い順に並びます。
+        """
+        self._check_initialized()
+        return self.capi_ma.complete(prefix, k=k, view=view)
+
     def getActiveDictionaries(self):
         """
         インストール済み辞書のうち、解析に利用する辞書のメタデータ一覧を返します。
@@ -331,6 +961,14 @@ class Service(object):
         idlist と pattern のどちらかは指定する必要があります。
         """
         self._check_initialized()
+        active_dictionaries = self._select_dictionaries(idlist, pattern)
+        self.capi_ma.setActiveDictionaries(active_dictionaries)
+
+    def _select_dictionaries(self, idlist, pattern):
+        """
+        インストール済み辞書のうち、 idlist または pattern に一致する
+        辞書の内部 id のリストを返します。
+        """
         if idlist is not None and not isinstance(idlist, (list, set, tuple)):
             raise TypeError("idlist は None またはリストで指定してください。")
 
@@ -357,7 +995,7 @@ class Service(object):
         if len(active_dictionaries) == 0:
             logger.debug("条件に一致する辞書がありません。")
 
-        self.capi_ma.setActiveDictionaries(active_dictionaries)
+        return active_dictionaries
 
     def disactivateDictionaries(self, idlist=None, pattern=None):
         """
@@ -562,6 +1200,177 @@ class Service(object):
 
         self.capi_ma.setActiveClasses(patterns)
 
+    def createActiveView(self, idlist=None, pattern=None, classes=None,
+                         date_from=None, date_to=None):
+        """
+        ``ma_parseNode()`` や ``searchWord()`` に view として渡す、
+        解析に利用する辞書と固有名クラスの組を作成します。
+
+        アクティブな辞書やクラスを変更せずに、呼び出しごとに異なる
+        辞書とクラスで解析できます。正規表現は作成時にコンパイルするため、
+        同じ組を繰り返し利用する場合は一度だけ作成してください。
+        作成した組は変更できません。
+
+        期間を指定すると、 valid_from, valid_to で表す有効期間が
+        期間と重ならない地名語を解析や検索の候補から除きます。
+        ``TimeExistsFilter`` と同じ条件を、候補を作る前に適用します。
+
+        Parameters
+        ----------
+        idlist : list, optional
+            利用する辞書の id または identifier のリスト。
+        pattern : str, optional
+            利用する辞書の identifier の正規表現。
+        classes : list, optional
+            利用する固有名クラス（str）の正規表現リスト。
+            '-' から始まる場合、一致する固有名クラスは対象外となります。
+        date_from : str, datetime.date, datetime.datetime, optional
+            期間の開始日。
+        date_to : str, datetime.date, datetime.datetime, optional
+            期間の終了日。
+
+        Returns
+        -------
+        object
+            辞書と固有名クラスの組。
+
+        Examples
+        --------
+        >>> from pygeonlp.api.service import Service
+        >>> service = Service()
+        >>> view = service.createActiveView(classes=['.*', '-都道府県'])
+        >>> service.searchWord('東京都', view=view)
+        {}
+        >>> service.getActiveClasses()
+        ['.*']
+
+        Note
+        ----
+        idlist と pattern を両方省略した場合は現在のアクティブな辞書を、
+        classes を省略した場合は現在のアクティブなクラスを利用します。
+        date_to を省略した場合は date_from が表す一時点が期間になり、
+        両方を省略した場合は期間を問いません。
+        """
+        self._check_initialized()
+        if idlist is None and pattern is None:
+            dictionaries = [
+                int(x) for x in self.capi_ma.getActiveDictionaries().keys()]
+        else:
+            dictionaries = self._select_dictionaries(idlist, pattern)
+
+        if classes is None:
+            classes = self.capi_ma.getActiveClasses()
+        elif isinstance(classes, str):
+            classes = [classes]
+
+        if date_from is not None and date_to is None:
+            date_to = date_from
+
+        return self.capi_ma.createActiveView(
+            dictionaries, classes,
+            date_from=self._datestr(date_from),
+            date_to=self._datestr(date_to))
+
+    @staticmethod
+    def _datestr(date):
+        """
+        日付を ``createActiveView()`` に渡す文字列に変換します。
+        """
+        if date is None or isinstance(date, str):
+            return date
+
+        if isinstance(date, (datetime.date, datetime.datetime)):
+            return date.strftime('%Y-%m-%d')
+
+        raise TypeError(("日付の型は "
+                         "str, datetime.date, datetime.datetime"
+                         " のいずれかで指定してください。"))
+
+    def getStats(self):
+        """
+        処理ごとの計測値を返します。
+        オプション stats に True を指定した場合だけ計測します。
+
+        Returns
+        -------
+        dict
+            処理の名前をキー、計測値の dict を値とする dict。
+            計測値は calls （呼び出し回数）、 ns （累積時間、ナノ秒）、
+            hits, misses （キャッシュのヒット数、ミス数）、
+            rows （処理した件数）を持ちます。
+            計測していない場合は空の dict を返します。
+
+        Examples
+        --------
+        >>> from pygeonlp.api.service import Service
+        >>> service = Service(stats=True)
+        >>> service.resetStats()
+        >>> nodes = service.ma_parseNode('国会議事堂前まで歩きました。')
+        >>> service.getStats()['parse_node']['calls']
+        1
+        """
+        self._check_initialized()
+        return self.capi_ma.getStats()
+
+    def resetStats(self):
+        """
+        処理ごとの計測値を 0 に戻します。
+        """
+        self._check_initialized()
+        self.capi_ma.resetStats()
+
+    def warmup(self):
+        """
+        全ての見出し語について、アクティブな辞書・固有名クラスの地名語を
+        含むかどうかを事前に判定します。
+        解析中に見出し語ごとに行う判定と地名語の読み込みを省略できます。
+        作業プロセスを fork するサーバでは、 fork の前に呼び出すと
+        判定結果を全ての作業プロセスで共有できます。
+        アクティブな辞書・固有名クラスを変更すると判定結果は破棄されます。
+
+        Returns
+        -------
+        int
+            判定した見出し語の数。
+
+        Examples
+        --------
+        >>> from pygeonlp.api.service import Service
+        >>> service = Service(in_memory=True)
+        >>> service.warmup() > 0
+        True
+        """
+        self._check_initialized()
+        return self.capi_ma.warmup()
+
+    def getMemoryUsage(self):
+        """
+        辞書やインデックス、キャッシュが確保しているメモリの大きさを
+        項目ごとに返します。キャッシュやインデックスの値は推定値です。
+
+        Returns
+        -------
+        dict
+            項目の名前をキー、バイト数を値とする dict。
+            darts, yomi_darts, completion_table, spatial_index,
+            geoword_cache, geoword_record_cache, geoword_node_cache,
+            standardized_cache, parse_cache, sqlite, in_memory_db, mecab,
+            bundle と、メモリの上限 memory_budget とキャッシュが計上した
+            memory_budget_charged、地名語データベースの接続に設定された
+            ページキャッシュと mmap の上限 sqlite_cache_limit,
+            sqlite_mmap_limit を持ちます。
+
+        Examples
+        --------
+        >>> from pygeonlp.api.service import Service
+        >>> service = Service()
+        >>> usage = service.getMemoryUsage()
+        >>> usage['darts'] > 0
+        True
+        """
+        self._check_initialized()
+        return self.capi_ma.getMemoryUsage()
+
     def _check_initialized(self):
         """
         capi オブジェクトが初期化されていることを確認します。
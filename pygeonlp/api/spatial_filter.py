@@ -15,6 +15,7 @@ from logging import getLogger
 import urllib
 
 from pygeonlp.api.filter import Filter, FilterError
+from pygeonlp.api.node import Node
 
 try:
     from osgeo import ogr
@@ -37,9 +38,16 @@ class SpatialFilter(Filter):
 
     空間フィルタでは、地名語ノードと住所ノードの geometry が持つ GeoJSON を
     そのノードの地点とします。
+
+    service を指定した場合、地名語ノードの候補はラティス全体で
+    まとめて ``Service.filterByGeometry()`` に渡し、空間インデックスを
+    利用して判定します。住所ノードなど地名語以外の候補は GDAL で判定します。
     """
 
-    def __init__(self, geojson_or_url, **kwargs):
+    # 範囲に含まれる候補を合格とする場合は True
+    inside = True
+
+    def __init__(self, geojson_or_url, service=None, **kwargs):
         """
         フィルタを初期化します。
 
@@ -47,10 +55,65 @@ class SpatialFilter(Filter):
         ----------
         geojson_or_url : str
             空間範囲を表す GeoJSON　または GeoJSON ファイルを取得できる URL。
+        service : pygeonlp.api.service.Service, optional
+            地名語の候補を判定する Service。
+            指定しない場合は全ての候補を GDAL で判定します。
         """
         super().__init__()
         self.when_all_failed = 'convert_to_normal'
         self.geo = self.__class__.get_geometry(geojson_or_url)
+        self.service = service
+        self._geojson = self.geo.ExportToJson() if service else None
+        self._passed_ids = None
+
+    def apply(self, input, **kwargs):
+        """
+        service が指定されている場合、ラティスに含まれる地名語の候補を
+        まとめて判定してから ``Filter.apply()`` を適用します。
+        service が範囲を扱えない場合（Polygon, MultiPolygon 以外）は
+        GDAL で判定します。
+        """
+        if self.service is None:
+            return super().apply(input, **kwargs)
+
+        geolod_ids = []
+        for candidates in input:
+            for node in candidates:
+                if node.node_type == Node.GEOWORD and 'geolod_id' in node.prop:
+                    geolod_ids.append(node.prop['geolod_id'])
+
+        try:
+            self._passed_ids = set(self.service.filterByGeometry(
+                geolod_ids, self._geojson, inside=self.inside))
+        except RuntimeError as e:
+            logger.debug("Native spatial filter is not available: {}".format(e))
+            self._passed_ids = None
+
+        try:
+            return super().apply(input, **kwargs)
+        finally:
+            self._passed_ids = None
+
+    def passed_natively(self, candidate):
+        """
+        ``apply()`` でまとめて判定した結果を返します。
+
+        Parameters
+        ----------
+        candidate : pygeonlp.api.node.Node
+            候補ノード。
+
+        Returns
+        -------
+        bool or None
+            合格した場合は True、不合格の場合は False、
+            まとめて判定していない候補の場合は None。
+        """
+        if self._passed_ids is None or candidate.node_type != Node.GEOWORD \
+                or 'geolod_id' not in candidate.prop:
+            return None
+
+        return candidate.prop['geolod_id'] in self._passed_ids
 
     @classmethod
     def get_geometry_from_geojson_url(cls, url):
@@ -253,10 +316,16 @@ class GeoContainsFilter(SpatialFilter):
 
     """
 
-    def __init__(self, geojson_or_url):
-        super().__init__(geojson_or_url)
+    inside = True
+
+    def __init__(self, geojson_or_url, service=None):
+        super().__init__(geojson_or_url, service=service)
 
     def filter_func(self, candidate):
+        passed = self.passed_natively(candidate)
+        if passed is not None:
+            return passed
+
         point = self.__class__.point_from_candidate(candidate)
         if point is None:
             return True   # 座標を持たない候補は合格
@@ -314,10 +383,16 @@ class GeoDisjointFilter(SpatialFilter):
     ['。(NORMAL)']
     """
 
-    def __init__(self, geojson_or_url):
-        super().__init__(geojson_or_url)
+    inside = False
+
+    def __init__(self, geojson_or_url, service=None):
+        super().__init__(geojson_or_url, service=service)
 
     def filter_func(self, candidate):
+        passed = self.passed_natively(candidate)
+        if passed is not None:
+            return passed
+
         point = self.__class__.point_from_candidate(candidate)
         if point is None:
             return True  # 座標を持たない候補は合格
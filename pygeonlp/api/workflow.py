@@ -124,6 +124,8 @@ class Workflow(object):
         """
         組み合わせの候補数が MAX_COMBINATIONS 未満になるように
         ラティスの先頭部分から区切りの良い一部分を抽出するジェネレータ。
+        区切り文字で分割できず、 evaluator がビームサーチを利用できる場合は
+        組み合わせ数を超えていてもそのまま返します。
 
         Parameters
         ----------
@@ -221,6 +223,16 @@ class Workflow(object):
             if eliminated:
                 continue
 
+            # ビームサーチで処理できる場合はそのまま返す
+            if self.evaluator.can_search_paths():
+                logger.debug("--- pos {} - {} (beam search)".format(
+                    pos_from, pos_to))
+                yield lattice_part
+
+                pos_from = pos_to
+                pos_to = len(lattice)
+                continue
+
             # 半分にする、ただし住所表現は分割しない
             i = pos_from
             while i < pos_to:
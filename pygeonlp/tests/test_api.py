@@ -1,5 +1,7 @@
+import glob
 import logging
 import os
+import tempfile
 import unittest
 
 import pygeonlp.api as api
@@ -24,11 +26,103 @@ class TestModuleMethods(unittest.TestCase):
         api.setup_basic_database(db_dir=testdir)
         api.init(db_dir=testdir)
 
+    def _new_manager(self, options=None):
+        # Create a DictManager on an empty temporary database directory
+        from pygeonlp.api.dict_manager import DictManager
+        tmpdir = tempfile.TemporaryDirectory()
+        self.addCleanup(tmpdir.cleanup)
+        return DictManager(db_dir=tmpdir.name, options=options)
+
+    def _add_dictionary(self, manager, name, csvname=None):
+        base_dir = os.path.join(os.getcwd(), 'base_data')
+        manager.addDictionaryFromFile(
+            jsonfile=os.path.join(base_dir, name + '.json'),
+            csvfile=os.path.join(base_dir, (csvname or name) + '.csv'))
+
+    def _snapshot(self, manager):
+        # Search and parse results to compare two databases
+        from pygeonlp.api.service import Service
+        service = Service(db_dir=manager.db_dir)
+        words = ['新宿', '東京', '和歌山市', '神保町', '国会議事堂前']
+        sentences = ['国会議事堂前まで歩きました。', '和歌山市は晴れ。',
+                     '新宿駅から渋谷駅まで']
+        return ([service.searchWord(x) for x in words],
+                [service.ma_parseNode(x) for x in sentences])
+
+    def _geonlp_ids(self, manager):
+        import sqlite3
+        con = sqlite3.connect(os.path.join(manager.db_dir, 'geodic.sq3'))
+        ids = [r[0] for r in con.execute(
+            'SELECT geonlp_id FROM geoword ORDER BY geonlp_id')]
+        con.close()
+        return ids
+
     def test_search_word(self):
         words = api.searchWord('神保町')
         self.assertIsInstance(words, dict)
         self.assertIn('AGGwyc', words)  # 新宿線神保町駅
 
+    def test_search_yomi(self):
+        # Reading search must return only the words with the reading
+        service = api.default_workflow().parser.service
+        words = service.searchYomi('トウキョウト')
+        self.assertGreater(len(words), 0)
+        self.assertEqual(words.keys(), service.searchWord('トウキョウト').keys())
+        self.assertEqual(service.searchYomi('東京都'), {})
+        matches = service.searchYomiPrefix('トウキョウトニイキマス')
+        self.assertEqual([x[0] for x in matches], ['トウキョウ', 'トウキョウト'])
+        self.assertEqual(matches[1][1], words)
+
+    def test_complete(self):
+        # Completions must be ordered by score and found by searchWord
+        service = api.default_workflow().parser.service
+        completions = service.complete('和歌山', k=5)
+        self.assertGreater(len(completions), 0)
+        self.assertLessEqual(len(completions), 5)
+        scores = [x['score'] for x in completions]
+        self.assertEqual(scores, sorted(scores, reverse=True))
+        for x in completions:
+            self.assertTrue(x['surface'].startswith('和歌山'))
+            words = service.searchWord(x['surface'])
+            self.assertTrue(set(x['geolod_ids']) <= set(words.keys()))
+
+    def test_search_word_fuzzy(self):
+        # One-character typo must find the word within distance 1
+        service = api.default_workflow().parser.service
+        matches = service.searchWordFuzzy('和哥山市', max_distance=1)
+        self.assertIn('和歌山市', [x[0] for x in matches])
+        self.assertTrue(all(x[1] <= 1 for x in matches))
+        exact = service.searchWordFuzzy('和歌山市', max_distance=0)
+        self.assertEqual(exact[0][2], service.searchWord('和歌山市'))
+
+    def test_search_spatial(self):
+        # Spatial queries must agree with the coordinates of the words
+        service = api.default_workflow().parser.service
+        word = service.searchWord('国会議事堂前')
+        geolod_id, info = next(iter(word.items()))
+        lat, lon = float(info['latitude']), float(info['longitude'])
+        self.assertIn(geolod_id, service.searchBox(
+            lat - 0.01, lon - 0.01, lat + 0.01, lon + 0.01))
+        self.assertIn(geolod_id, service.searchRadius(lat, lon, 0.5))
+        polygon = {'type': 'Polygon', 'coordinates': [[
+            [lon - 0.01, lat - 0.01], [lon + 0.01, lat - 0.01],
+            [lon + 0.01, lat + 0.01], [lon - 0.01, lat + 0.01],
+            [lon - 0.01, lat - 0.01]]]}
+        self.assertIn(geolod_id, service.searchGeometry(polygon))
+        self.assertEqual(service.filterByGeometry(
+            [geolod_id], polygon, inside=False), [])
+
+        # The queries must be counted apart from the darts lookups
+        from pygeonlp.api.service import Service
+        stats_service = Service(db_dir=service.db_dir, stats=True)
+        stats_service.resetStats()
+        ids = stats_service.searchBox(
+            lat - 0.01, lon - 0.01, lat + 0.01, lon + 0.01)
+        stats = stats_service.getStats()
+        self.assertEqual(stats['spatial']['calls'], 1)
+        self.assertEqual(stats['spatial']['rows'], len(ids))
+        self.assertEqual(stats['darts']['calls'], 0)
+
     def test_set_dictionaries(self):
         # Set active dictionaries and check the results
         api.setActiveDictionaries(pattern=r'.*')
@@ -62,6 +156,668 @@ class TestModuleMethods(unittest.TestCase):
         self.assertIsInstance(words, dict)
         self.assertIn('AGGwyc', words)  # 新宿線神保町駅
 
+    def test_active_view(self):
+        # The view must give the same results as setActiveClasses
+        # without changing the shared active classes
+        service = api.default_workflow().parser.service
+        sentence = '神保町から渋谷まで'
+        view = service.createActiveView(classes=[".*", "-鉄道施設/.*"])
+        self.assertNotIn('AGGwyc', service.searchWord('神保町', view=view))
+        self.assertIn('AGGwyc', service.searchWord('神保町'))
+        nodes = service.ma_parseNode(sentence, view=view)
+        service.setActiveClasses([".*", "-鉄道施設/.*"])
+        self.assertEqual(nodes, service.ma_parseNode(sentence))
+        service.setActiveClasses()
+
+        # A class which cannot be encoded in UTF-8 must raise an error
+        with self.assertRaises(UnicodeEncodeError):
+            service.createActiveView(classes=['\ud800'])
+
+    def test_active_view_period(self):
+        # The view with a period must drop the words out of the period
+        # as TimeExistsFilter does
+        service = api.default_workflow().parser.service
+        view = service.createActiveView(
+            date_from='2000-01-01', date_to='2001-01-01')
+        self.assertEqual(service.searchWord('西東京市', view=view), {})
+        self.assertNotEqual(service.searchWord('田無市', view=view), {})
+        view = service.createActiveView(date_from='2001-01-21')
+        self.assertEqual(service.searchWord('西東京市', view=view),
+                         service.searchWord('西東京市'))
+
+    def test_parse_node_batch(self):
+        # The batch results must be the same as parsing one by one
+        service = api.default_workflow().parser.service
+        sentences = [
+            '国会議事堂前まで歩きました。',
+            '和歌山市は晴れ。',
+            '神保町から渋谷まで',
+            '',
+        ] * 5
+        results = service.ma_parseNodeBatch(sentences, n_threads=4)
+        self.assertEqual(len(results), len(sentences))
+        for sentence, result in zip(sentences, results):
+            self.assertEqual(result, service.ma_parseNode(sentence))
+
+        # A sentence which cannot be encoded in UTF-8 must raise an error
+        with self.assertRaises(UnicodeEncodeError):
+            service.ma_parseNodeBatch(['国会議事堂前', '\ud800'])
+
+    def test_parse_node_columnar(self):
+        # The columnar results must hold the same values as the dicts
+        from pygeonlp import capi
+        service = api.default_workflow().parser.service
+        sentence = '国会議事堂前まで歩きました。'
+        columns = service.ma_parseNode(sentence, columnar=True)
+        self.assertEqual(len(columns), len(capi.NODE_FIELDS))
+        nodes = [dict(zip(capi.NODE_FIELDS, row)) for row in zip(*columns)]
+        self.assertEqual(nodes, service.ma_parseNode(sentence))
+
+    def test_parse_lattice(self):
+        # The candidates must be the geowords of the ids in subclass3
+        service = api.default_workflow().parser.service
+        sentence = '国会議事堂前まで歩きました。'
+        nodes, candidates = service.ma_parseLattice(sentence)
+        self.assertEqual(nodes, service.ma_parseNode(sentence))
+        self.assertEqual(len(candidates), len(nodes))
+        for node, geowords in zip(nodes, candidates):
+            if node['subclass2'] != '地名語' or node['subclass1'] == '接尾':
+                self.assertEqual(geowords, [])
+                continue
+
+            ids = [x.split(':')[0] for x in node['subclass3'].split('/')]
+            self.assertEqual(geowords, [service.getWordInfo(x) for x in ids])
+
+    def test_parse_node_threads(self):
+        # One service can be used from several threads at the same time
+        from concurrent.futures import ThreadPoolExecutor
+        service = api.default_workflow().parser.service
+        sentences = [
+            '国会議事堂前まで歩きました。',
+            '和歌山市は晴れ。',
+            '神保町から渋谷まで',
+        ] * 10
+        expected = [service.ma_parseNode(s) for s in sentences]
+        with ThreadPoolExecutor(max_workers=4) as executor:
+            results = list(executor.map(service.ma_parseNode, sentences))
+        self.assertEqual(results, expected)
+
+    def test_parse_node_async(self):
+        # Awaiting concurrent parses must give the same results as parseNode
+        import asyncio
+        service = api.default_workflow().parser.service
+        sentences = [
+            '国会議事堂前まで歩きました。',
+            '和歌山市は晴れ。',
+            '神保町から渋谷まで',
+        ] * 10
+        expected = [service.ma_parseNode(s) for s in sentences]
+
+        async def parse_all():
+            return await asyncio.gather(
+                *[service.ma_parseNode_async(s) for s in sentences])
+
+        self.assertEqual(asyncio.run(parse_all()), expected)
+
+    def test_update_index_incrementally(self):
+        # Adding and removing dictionaries incrementally must give
+        # the same results as rebuilding the whole index
+        full = self._new_manager()
+        inc = self._new_manager()
+        for manager in (full, inc):
+            self._add_dictionary(manager, 'geoshape-pref')
+            self._add_dictionary(manager, 'geoshape-city')
+            manager.updateIndex()
+
+        for manager in (full, inc):
+            self._add_dictionary(manager, 'ksj-station-N02')
+        full.updateIndex()
+        inc.updateIndex(incremental=True)
+        snapshot = self._snapshot(inc)
+        self.assertIn('AGGwyc', snapshot[0][3])
+        self.assertEqual(snapshot, self._snapshot(full))
+
+        # Nothing to add
+        inc.updateIndex(incremental=True)
+        self.assertEqual(self._snapshot(inc), self._snapshot(full))
+
+        for manager in (full, inc):
+            manager.removeDictionary('geonlp:ksj-station-N02')
+        full.updateIndex()
+        snapshot = self._snapshot(inc)
+        self.assertNotIn('AGGwyc', snapshot[0][3])
+        self.assertEqual(snapshot, self._snapshot(full))
+
+        # Merging the delta into the index must keep the results
+        inc.updateIndex()
+        self.assertEqual(self._snapshot(inc), self._snapshot(full))
+
+    def test_update_index_externally(self):
+        # Building the index in parallel through temporary files must
+        # give the same results as the default build
+        default = self._new_manager()
+        external = self._new_manager(
+            options={'index_build_threads': 2, 'index_build_memory': 1})
+        for manager in (default, external):
+            for name in ('geoshape-pref', 'geoshape-city', 'ksj-station-N02'):
+                self._add_dictionary(manager, name)
+
+        default.updateIndex()
+        stages, runs = [], set()
+
+        def progress(stage, done, total):
+            # The records must be spilled into several sorted runs
+            stages.append(stage)
+            runs.update(glob.glob(os.path.join(external.db_dir, '*.run*')))
+
+        external.updateIndex(progress=progress)
+        self.assertIn('merge', stages)
+        self.assertGreater(len(runs), 1)
+        self.assertEqual(self._snapshot(external), self._snapshot(default))
+
+    def _indexed_manager(self):
+        # A database whose index lacks the station dictionary
+        manager = self._new_manager()
+        self._add_dictionary(manager, 'geoshape-city')
+        manager.updateIndex()
+        self._add_dictionary(manager, 'ksj-station-N02')
+        return manager
+
+    def _node_ids(self, nodes):
+        return [x.split(':')[0] for node in nodes
+                if node['subclass2'] == '地名語'
+                for x in node['subclass3'].split('/')]
+
+    def test_update_index_while_parsing(self):
+        # Parsing in another thread must go on with the current index
+        # while the next one is built, and use the new one after that
+        import threading
+        from pygeonlp.api.service import Service
+        manager = self._indexed_manager()
+        ma = manager.capi_ma
+        sentence = '神保町から渋谷まで'
+        before = ma.parseNode(sentence)
+        self.assertNotIn('AGGwyc', self._node_ids(before))
+        during = []
+
+        def progress(stage, done, total):
+            if during:
+                return
+
+            thread = threading.Thread(
+                target=lambda: during.append(ma.parseNode(sentence)))
+            thread.start()
+            thread.join(timeout=60)
+            self.assertFalse(thread.is_alive())
+
+        manager.updateIndex(progress=progress)
+        self.assertEqual(during, [before])
+        # The added dictionary is active in a new service
+        service = Service(db_dir=manager.db_dir)
+        self.assertIn('AGGwyc', self._node_ids(service.ma_parseNode(sentence)))
+
+    def test_update_index_failure(self):
+        # A failed build must leave the current index in use
+        from pygeonlp.api.service import Service
+        manager = self._indexed_manager()
+        ma = manager.capi_ma
+        sentence = '神保町から渋谷まで'
+        before = ma.parseNode(sentence)
+        words = ma.searchWord('和歌山市')
+        self.assertNotEqual(words, {})
+
+        def progress(stage, done, total):
+            raise ValueError('stop the build')
+
+        with self.assertRaises(ValueError):
+            manager.updateIndex(progress=progress)
+
+        self.assertEqual(ma.parseNode(sentence), before)
+        self.assertEqual(ma.searchWord('和歌山市'), words)
+        self.assertEqual(glob.glob(os.path.join(manager.db_dir, '*.old')), [])
+
+        # The next build must publish the new index
+        manager.updateIndex()
+        service = Service(db_dir=manager.db_dir)
+        self.assertIn('AGGwyc', self._node_ids(service.ma_parseNode(sentence)))
+
+    def test_import_fast(self):
+        # The bulk import must register the same dictionaries and words
+        # as the default import
+        default = self._new_manager()
+        fast = self._new_manager(
+            options={'import_threads': 2, 'import_fast': True})
+        for manager in (default, fast):
+            for name in ('geoshape-pref', 'ksj-station-N02'):
+                self._add_dictionary(manager, name)
+
+            manager.updateIndex()
+
+        for identifier in ('geonlp:geoshape-pref', 'geonlp:ksj-station-N02'):
+            self.assertEqual(str(fast.getDictionary(identifier)),
+                             str(default.getDictionary(identifier)))
+
+        self.assertEqual(fast.capi_ma.getDictionaryList(),
+                         default.capi_ma.getDictionaryList())
+        ids = self._geonlp_ids(default)
+        self.assertEqual(self._geonlp_ids(fast), ids)
+        self.assertEqual([fast.capi_ma.getWordInfo(x) for x in ids],
+                         [default.capi_ma.getWordInfo(x) for x in ids])
+        self.assertEqual(self._snapshot(fast), self._snapshot(default))
+
+    def test_geoword_record(self):
+        # The binary records must give the same results as the JSON,
+        # and the words they cannot hold must fall back to the JSON
+        tmpdir = tempfile.TemporaryDirectory()
+        self.addCleanup(tmpdir.cleanup)
+        csvfile = os.path.join(tmpdir.name, 'record-test.csv')
+        with open(csvfile, 'w', encoding='utf-8') as f:
+            f.write('geolod_id,entry_id,body,body_kana,suffix,suffix_kana,'
+                    'ne_class,priority_score,latitude,longitude,color\n')
+            f.write('rEcOd1,1,試験,シケン,岳,ダケ,山,,35.1,139.1,赤\n')
+            f.write('rEcOd2,2,検査,ケンサ,岳,ダケ,山,high,35.2,139.2,青\n')
+
+        default = self._new_manager()
+        record = self._new_manager(options={'geoword_record': True})
+        for manager in (default, record):
+            self._add_dictionary(manager, 'geoshape-pref')
+            manager.addDictionaryFromCsv(csvfile)
+            manager.updateIndex()
+
+        ids = self._geonlp_ids(default)
+        self.assertEqual([record.capi_ma.getWordInfo(x) for x in ids],
+                         [default.capi_ma.getWordInfo(x) for x in ids])
+        self.assertEqual(self._snapshot(record), self._snapshot(default))
+
+        word = record.capi_ma.getWordInfo('rEcOd2')
+        self.assertEqual(word['priority_score'], 'high')
+        self.assertEqual(word['color'], '青')
+        self.assertEqual(record.capi_ma.getWordInfo('rEcOd1')['color'], '赤')
+
+        # The word with a non-numeric priority_score has no record
+        import sqlite3
+        con = sqlite3.connect(os.path.join(record.db_dir, 'geodic.sq3'))
+        self.assertEqual(dict(con.execute(
+            "SELECT geonlp_id, record IS NOT NULL FROM geoword "
+            "WHERE geonlp_id IN ('rEcOd1', 'rEcOd2')")),
+            {'rEcOd1': 1, 'rEcOd2': 0})
+        con.close()
+
+        from pygeonlp.api.service import Service
+        sentence = '試験岳から検査岳へ登りました。'
+        nodes = Service(db_dir=record.db_dir).ma_parseNode(sentence)
+        self.assertEqual(
+            nodes, Service(db_dir=default.db_dir).ma_parseNode(sentence))
+        self.assertEqual(
+            [x['subclass3'].split(':')[0] for x in nodes
+             if x['subclass2'] == '地名語'], ['rEcOd1', 'rEcOd2'])
+
+    def test_bundle(self):
+        # The service on the bundle must not read the database, and
+        # exporting again must not change the bundle already opened
+        import shutil
+        from pygeonlp.api.dict_manager import DictManager
+        from pygeonlp.api.service import Service
+        service = api.default_workflow().parser.service
+        tmpdir = tempfile.TemporaryDirectory()
+        self.addCleanup(tmpdir.cleanup)
+        db_dir = os.path.join(tmpdir.name, 'db')
+        shutil.copytree(service.db_dir, db_dir)
+        bundle = os.path.join(tmpdir.name, 'test.bundle')
+        manager = DictManager(db_dir=db_dir)
+        manager.exportBundle(bundle)
+        bundle_service = Service(db_dir=db_dir, bundle=bundle)
+        self.assertEqual(bundle_service.getMemoryUsage()['bundle'],
+                         os.path.getsize(bundle))
+        with self.assertRaises(RuntimeError):
+            bundle_service.capi_ma.updateIndex()
+
+        manager.removeDictionary('geonlp:ksj-station-N02')
+        manager.updateIndex()
+        manager.exportBundle(bundle)
+        new_service = Service(db_dir=db_dir, bundle=bundle)
+        for name in ('geodic.sq3', 'wordlist.sq3'):
+            open(os.path.join(db_dir, name), 'wb').close()
+
+        sentence = '国会議事堂前まで歩きました。'
+        self.assertEqual(bundle_service.ma_parseNode(sentence),
+                         service.ma_parseNode(sentence))
+        self.assertEqual(bundle_service.searchWord('神保町'),
+                         service.searchWord('神保町'))
+        self.assertEqual(bundle_service.getWordInfo('AGGwyc'),
+                         service.getWordInfo('AGGwyc'))
+        self.assertNotIn('AGGwyc', new_service.searchWord('神保町'))
+        self.assertNotEqual(new_service.ma_parseNode(sentence),
+                            service.ma_parseNode(sentence))
+
+    def test_read_only(self):
+        # The read-only service must open the files as immutable with
+        # the given pragmas and never write to the database directory
+        import filecmp
+        import shutil
+        import sqlite3
+        from pygeonlp.api.service import Service
+        service = api.default_workflow().parser.service
+        tmpdir = tempfile.TemporaryDirectory()
+        self.addCleanup(tmpdir.cleanup)
+        db_dir = os.path.join(tmpdir.name, 'db')
+        shutil.copytree(service.db_dir, db_dir)
+        files = sorted(os.listdir(db_dir))
+
+        # Immutable files are read without locking, so an exclusive lock
+        # held by another connection must not block the service
+        locks = []
+        for name in ('geodic.sq3', 'wordlist.sq3'):
+            con = sqlite3.connect(
+                os.path.join(db_dir, name), isolation_level=None)
+            con.execute('BEGIN EXCLUSIVE')
+            locks.append(con)
+
+        ro_service = Service(db_dir=db_dir, read_only=True,
+                             sqlite_mmap_size=8, sqlite_cache_size=2)
+        sentence = '国会議事堂前まで歩きました。'
+        self.assertEqual(ro_service.ma_parseNode(sentence),
+                         service.ma_parseNode(sentence))
+        self.assertEqual(ro_service.searchWord('神保町'),
+                         service.searchWord('神保町'))
+        usage = ro_service.getMemoryUsage()
+        self.assertEqual(usage['sqlite_mmap_limit'], 8 * 1024 * 1024)
+        self.assertEqual(usage['sqlite_cache_limit'], 2 * 1024 * 1024)
+        with self.assertRaises(RuntimeError):
+            ro_service.capi_ma.updateIndex()
+
+        for con in locks:
+            con.execute('ROLLBACK')
+            con.close()
+
+        # No files nor tables must be created
+        self.assertEqual(sorted(os.listdir(db_dir)), files)
+        _, mismatch, errors = filecmp.cmpfiles(
+            service.db_dir, db_dir, files, shallow=False)
+        self.assertEqual((mismatch, errors), ([], []))
+
+    def test_darts_mmap(self):
+        # The index opened with mmap must give the same results as the
+        # index read into memory
+        from pygeonlp.api.service import Service
+        service = api.default_workflow().parser.service
+        mmap_service = Service(db_dir=service.db_dir, darts_mmap=True)
+        load_service = Service(db_dir=service.db_dir, darts_mmap=False)
+        sentences = ['国会議事堂前まで歩きました。', '和歌山市は晴れ。',
+                     '新宿駅から渋谷駅まで', '神保町から渋谷まで']
+        for sentence in sentences:
+            expected = load_service.ma_parseNode(sentence)
+            self.assertEqual(mmap_service.ma_parseNode(sentence), expected)
+            self.assertEqual(service.ma_parseNode(sentence), expected)
+        self.assertEqual(
+            mmap_service.ma_parseNodeBatch(sentences, n_threads=2),
+            [load_service.ma_parseNode(x) for x in sentences])
+        for word in ('新宿', '神保町', '和歌山市'):
+            self.assertEqual(mmap_service.searchWord(word),
+                             load_service.searchWord(word))
+
+    def test_in_memory(self):
+        # The in-memory service must keep working without the database
+        # files once it has read them
+        import shutil
+        from pygeonlp.api.service import Service
+        service = api.default_workflow().parser.service
+        tmpdir = tempfile.TemporaryDirectory()
+        self.addCleanup(tmpdir.cleanup)
+        db_dir = os.path.join(tmpdir.name, 'db')
+        shutil.copytree(service.db_dir, db_dir)
+        db_files = [os.path.join(db_dir, x)
+                    for x in ('geodic.sq3', 'wordlist.sq3')]
+        mem_service = Service(db_dir=db_dir, in_memory=True)
+        self.assertEqual(mem_service.getMemoryUsage()['in_memory_db'],
+                         sum(os.path.getsize(x) for x in db_files))
+
+        # Empty the files, the service must not read them again
+        for path in db_files:
+            open(path, 'wb').close()
+
+        self.assertGreater(mem_service.warmup(), 0)
+        self.assertEqual(mem_service.warmup(), 0)
+        sentence = '国会議事堂前まで歩きました。'
+        self.assertEqual(mem_service.ma_parseNode(sentence),
+                         service.ma_parseNode(sentence))
+        self.assertEqual(
+            mem_service.ma_parseNodeBatch([sentence] * 4, n_threads=2),
+            [service.ma_parseNode(sentence)] * 4)
+        self.assertEqual(mem_service.searchWord('神保町'),
+                         service.searchWord('神保町'))
+        self.assertEqual(mem_service.getWordInfo('AGGwyc'),
+                         service.getWordInfo('AGGwyc'))
+        with self.assertRaises(RuntimeError):
+            mem_service.capi_ma.updateIndex()
+
+    def test_in_memory_wal(self):
+        # The changes left in the WAL file must be read in memory too
+        import shutil
+        import sqlite3
+        from pygeonlp.api.service import Service
+        service = api.default_workflow().parser.service
+        tmpdir = tempfile.TemporaryDirectory()
+        self.addCleanup(tmpdir.cleanup)
+        db_dir = os.path.join(tmpdir.name, 'db')
+        shutil.copytree(service.db_dir, db_dir)
+        path = os.path.join(db_dir, 'geodic.sq3')
+        con = sqlite3.connect(path, isolation_level=None)
+        self.addCleanup(con.close)
+        con.execute('PRAGMA journal_mode = WAL')
+        con.execute('PRAGMA wal_autocheckpoint = 0')
+        con.execute(
+            "UPDATE geoword SET json = json_set(json, '$.note', 'wal') "
+            "WHERE geonlp_id = 'AGGwyc'")
+        self.assertGreater(os.path.getsize(path + '-wal'), 0)
+
+        mem_service = Service(db_dir=db_dir, in_memory=True)
+        self.assertEqual(mem_service.getWordInfo('AGGwyc')['note'], 'wal')
+        self.assertEqual(mem_service.searchWord('神保町').keys(),
+                         service.searchWord('神保町').keys())
+
+    def test_memory_usage(self):
+        # A small memory budget must evict the cached words and bound
+        # the SQLite page cache without changing the results
+        from pygeonlp.api.service import Service
+        service = api.default_workflow().parser.service
+        ids = self._geonlp_ids(service)[:5000]
+        usages = []
+        for budget in (0, 1):
+            s = Service(db_dir=service.db_dir, memory_budget=budget,
+                        geoword_cache_size=len(ids))
+            words = [s.getWordInfo(x) for x in ids]
+            usages.append(s.getMemoryUsage())
+            self.assertEqual(words, [service.getWordInfo(x) for x in ids])
+
+        limit = 1024 * 1024
+        self.assertEqual(usages[1]['memory_budget'], limit)
+        self.assertGreater(usages[0]['memory_budget_charged'], limit)
+        self.assertLessEqual(usages[1]['memory_budget_charged'], limit)
+        self.assertLess(usages[1]['geoword_cache'],
+                        usages[0]['geoword_cache'])
+        # The SQLite page cache of each connection gets half of the budget
+        self.assertEqual(usages[1]['sqlite_cache_limit'], limit // 2)
+        self.assertGreater(usages[0]['sqlite_cache_limit'], limit)
+        with self.assertRaises(TypeError):
+            Service(db_dir=service.db_dir, memory_budget=-1)
+
+    def test_memory_budget_shared(self):
+        # When another cache fills the budget, the geoword node cache must
+        # evict its own old entries and keep the recent ones
+        from pygeonlp.api.service import Service
+        service = api.default_workflow().parser.service
+        ids = self._geonlp_ids(service)[:5000]
+        s = Service(db_dir=service.db_dir, memory_budget=1,
+                    geoword_cache_size=len(ids), stats=True)
+        for x in ids:
+            s.getWordInfo(x)
+
+        usage = s.getMemoryUsage()
+        self.assertGreater(usage['memory_budget_charged'],
+                           usage['memory_budget'] // 2)
+
+        sentence = '国会議事堂前まで歩きました。'
+        expected = service.ma_parseNode(sentence)
+        self.assertEqual(s.ma_parseNode(sentence), expected)
+        first = s.getStats()['geoword_node_cache']
+        for _ in range(3):
+            self.assertEqual(s.ma_parseNode(sentence), expected)
+
+        second = s.getStats()['geoword_node_cache']
+        self.assertGreater(second['hits'], first['hits'])
+        self.assertGreater(s.getMemoryUsage()['geoword_node_cache'], 0)
+
+    def test_parse_cache(self):
+        # A repeated sentence must be answered from the cache without
+        # running MeCab, and changing the settings must miss the cache
+        from pygeonlp.api.service import Service
+        service = api.default_workflow().parser.service
+        cache_service = Service(
+            db_dir=service.db_dir, parse_cache_size=100, stats=True)
+        sentence = '国会議事堂前まで歩きました。'
+        expected = service.ma_parseNode(sentence)
+        first = cache_service.ma_parseNode(sentence)
+        self.assertEqual(first, expected)
+        self.assertGreater(cache_service.getMemoryUsage()['parse_cache'], 0)
+
+        # The cached result is a copy, changing it must not affect the cache
+        first[0]['surface'] = 'changed'
+        self.assertEqual(cache_service.ma_parseNode(sentence), expected)
+        stats = cache_service.getStats()
+        self.assertEqual(
+            (stats['parse_cache']['hits'], stats['parse_cache']['misses']),
+            (1, 1))
+        self.assertEqual(stats['mecab']['calls'], 1)
+
+        cache_service.ma_parseNode('和歌山市は晴れ。')
+        self.assertEqual(cache_service.getStats()['parse_cache']['misses'], 2)
+
+        # Changing the active classes must not return the cached result
+        cache_service.setActiveClasses(['鉄道施設/.*'])
+        service.setActiveClasses(['鉄道施設/.*'])
+        try:
+            self.assertEqual(cache_service.ma_parseNode(sentence),
+                             service.ma_parseNode(sentence))
+        finally:
+            service.setActiveClasses()
+
+        stats = cache_service.getStats()
+        self.assertEqual(
+            (stats['parse_cache']['hits'], stats['parse_cache']['misses']),
+            (1, 3))
+
+    def test_parse_node_stream(self):
+        # Each sentence must be parsed as parseNode does, with its offset
+        service = api.default_workflow().parser.service
+        text = '国会議事堂前まで歩きました。和歌山市は晴れ。\n東京都千代田区'
+        chunks = [text[i:i + 4] for i in range(0, len(text), 4)]
+        results = list(service.ma_parseNodeStream(chunks))
+        sentences = ['国会議事堂前まで歩きました。', '和歌山市は晴れ。\n', '東京都千代田区']
+        self.assertEqual([x[0] for x in results], [0, 14, 23])
+        self.assertEqual([x[1] for x in results],
+                         [service.ma_parseNode(s) for s in sentences])
+
+    def test_parse_node_stream_read_size(self):
+        # A delimiter split between read blocks must still end the sentence
+        service = api.default_workflow().parser.service
+        for text, offsets in (('あいう。かきく。', [0, 4]),
+                              ('あいう。\nかきく！', [0, 5])):
+            for read_size in range(1, len(text.encode('utf-8')) + 2):
+                found = []
+                service.capi_ma.parseNodeStream(
+                    [text], lambda nodes, offset: found.append(offset) or True,
+                    read_size=read_size)
+                self.assertEqual(found, offsets, (text, read_size))
+
+    def test_parse_stream_jsonl(self):
+        # JSON Lines output has one line per sentence without BOS/EOS
+        import io
+        import json
+        from pygeonlp.api.service import Service
+        service = api.default_workflow().parser.service
+        jsonl_service = Service(
+            db_dir=service.db_dir, formatter='JsonLinesGeowordFormatter')
+        out = io.StringIO()
+        n = jsonl_service.ma_parseStream(
+            '国会議事堂前まで歩きました。和歌山市は晴れ。', out)
+        self.assertEqual(n, 2)
+        lines = out.getvalue().splitlines()
+        self.assertEqual(json.loads(lines[1]), [
+            x for x in service.ma_parseNode('和歌山市は晴れ。')
+            if x['pos'] != 'BOS/EOS'])
+
+    def test_stats(self):
+        # The counters must follow the calls, the caches and the worker
+        # threads, and only when the stats option is true
+        from pygeonlp.api.service import Service
+        service = api.default_workflow().parser.service
+        self.assertEqual(service.getStats(), {})
+        stats_service = Service(db_dir=service.db_dir, stats=True)
+        sentence = '国会議事堂前まで歩きました。'
+        nodes = stats_service.ma_parseNode(sentence)
+        first = stats_service.getStats()
+        self.assertEqual(first['parse_node']['calls'], 1)
+        self.assertEqual(first['parse_node']['rows'], len(nodes))
+        self.assertGreater(first['parse_node']['ns'], 0)
+        self.assertEqual(first['mecab']['calls'], 1)
+        self.assertGreater(first['sqlite']['calls'], 0)
+
+        # The second parse must find the words in the caches
+        stats_service.ma_parseNode(sentence)
+        second = stats_service.getStats()
+        self.assertEqual(second['parse_node']['calls'], 2)
+        self.assertEqual(second['sqlite']['calls'], first['sqlite']['calls'])
+        self.assertGreater(second['geoword_node_cache']['hits'],
+                           first['geoword_node_cache']['hits'])
+
+        stats_service.resetStats()
+        self.assertTrue(all(v == 0 for x in stats_service.getStats().values()
+                            for v in x.values()))
+        stats_service.ma_parseNodeBatch([sentence] * 4, n_threads=2)
+        self.assertEqual(stats_service.getStats()['parse_node']['calls'], 4)
+
+    def test_beam_search(self):
+        # Beam search must find the best path when the combinations exceed the limit
+        from pygeonlp.api.linker import Evaluator
+        lattice = api.analyze('福島は大阪から2分です。')
+        exhaustive = Evaluator(max_results=1).get(lattice)
+        beam = Evaluator(max_results=1, max_combinations=1).get(lattice)
+        self.assertEqual(beam[0]['score'], exhaustive[0]['score'])
+        lattice = api.analyze('福島から大阪、京都、奈良、神戸、名古屋を巡りました')
+        results = Evaluator(max_results=3, max_combinations=1).get(lattice)
+        self.assertEqual(len(results), 3)
+
+    def test_address_spans(self):
+        # Address geocoding is attempted only on the spans starting at address heads
+        from pygeonlp import capi
+        tokens = [
+            ('東京', '名詞', '固有名詞', True, 1),
+            ('に', '助詞', '格助詞', False, 0),
+            ('港区', '名詞', '固有名詞', True, 1),
+            ('赤坂', '名詞', '固有名詞', True, 0),
+            ('1', '名詞', '数', False, 0),
+            ('-', '記号', '一般', False, 0),
+            ('10', '名詞', '数', False, 0),
+            ('。', '記号', '句点', False, 0),
+        ]
+        self.assertEqual(capi.findAddressSpans(tokens), [(2, 7)])
+        parser = api.default_workflow().parser
+        lattice = parser.analyze_sentence('NIIは千代田区一ツ橋2-1-2にあります。')
+        self.assertEqual(parser.get_address_spans(lattice), [(2, 9)])
+
+    def test_benchmark(self):
+        # The benchmark must process every sentence and report per-stage timings
+        from pygeonlp.api import bench
+        sentences = ['国会議事堂前まで歩きました。', '和歌山市は晴れ。'] * 3
+        report = bench.run_benchmark(
+            sentences, db_dir=os.environ['GEONLP_DB_DIR'], workers=2,
+            jageocoder=False)
+        self.assertEqual(report['sentences'], 6)
+        self.assertEqual(set(report['stages'].keys()), set(bench.STAGES))
+        self.assertEqual(report['native_stats']['parse_node']['calls'], 6)
+        self.assertGreater(report['peak_rss_kb'], 0)
+
     def test_geo_contains_filter(self):
         from pygeonlp.api.spatial_filter import SpatialFilter, GeoContainsFilter
         geojson = SpatialFilter.get_geometry(
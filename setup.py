@@ -113,6 +113,8 @@ def get_libgeonlp():
         include_dirs=[LIBGEONLP_INCLUDE_DIR],
         sources=LIBGEONLP_FILES + CPYGEONLP_FILES,
         libraries=['sqlite3', 'mecab'] + libraries,
+        # std::string_view, std::shared_timed_mutex などを利用するため
+        extra_compile_args=['-std=c++17'],
     )
     return libgeonlp
 